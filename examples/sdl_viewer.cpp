@@ -194,6 +194,10 @@ namespace {
                     media_type = openvrml::vrml_media_type;
                 } else if (iequals(ext, "x3dv")) {
                     media_type = openvrml::x3d_vrml_media_type;
+                } else if (iequals(ext, "x3d")) {
+                    media_type = openvrml::x3d_xml_media_type;
+                } else if (iequals(ext, "x3db")) {
+                    media_type = openvrml::x3d_fast_infoset_media_type;
                 } else if (iequals(ext, "png")) {
                     media_type = "image/png";
                 } else if (iequals(ext, "jpg") || iequals(ext, "jpeg")) {
@@ -0,0 +1,684 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Have <GL/gl.h> declare the OpenGL 1.5 buffer object functions where it
+// can.  (The Windows headers never do; there they are looked up at run time.)
+//
+# define GL_GLEXT_PROTOTYPES 1
+
+# include "geometry_buffer.h"
+# include <boost/scoped_ptr.hpp>
+# include <algorithm>
+# include <cassert>
+# include <cstdio>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+# ifndef GL_ARRAY_BUFFER
+#   define GL_ARRAY_BUFFER         0x8892
+#   define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#   define GL_STATIC_DRAW          0x88E4
+#   define GL_DYNAMIC_DRAW         0x88E8
+# endif
+
+# ifdef _WIN32
+#   define OPENVRML_GL_APIENTRY_ APIENTRY
+# else
+#   define OPENVRML_GL_APIENTRY_
+# endif
+
+namespace {
+
+# ifdef _WIN32
+    typedef std::ptrdiff_t buffer_size_t;
+    typedef std::ptrdiff_t buffer_offset_t;
+# else
+    typedef GLsizeiptr buffer_size_t;
+    typedef GLintptr buffer_offset_t;
+# endif
+
+    extern "C" {
+        typedef void (OPENVRML_GL_APIENTRY_ * gen_buffers_t)(GLsizei,
+                                                            GLuint *);
+        typedef void (OPENVRML_GL_APIENTRY_ * delete_buffers_t)(
+            GLsizei, const GLuint *);
+        typedef void (OPENVRML_GL_APIENTRY_ * bind_buffer_t)(GLenum, GLuint);
+        typedef void (OPENVRML_GL_APIENTRY_ * buffer_data_t)(GLenum,
+                                                            buffer_size_t,
+                                                            const GLvoid *,
+                                                            GLenum);
+        typedef void (OPENVRML_GL_APIENTRY_ * buffer_sub_data_t)(
+            GLenum, buffer_offset_t, buffer_size_t, const GLvoid *);
+    }
+
+    //
+    // The OpenGL 1.5 buffer object entry points.  instance returns null if
+    // the current context does not provide them; geometry is then drawn
+    // from client-side vertex arrays.
+    //
+    class OPENVRML_GL_LOCAL buffer_functions {
+    public:
+        gen_buffers_t gen_buffers;
+        delete_buffers_t delete_buffers;
+        bind_buffer_t bind_buffer;
+        buffer_data_t buffer_data;
+        buffer_sub_data_t buffer_sub_data;
+
+        static const buffer_functions * instance()
+            OPENVRML_THROW1(std::bad_alloc);
+
+    private:
+        static bool initialized_;
+        static boost::scoped_ptr<const buffer_functions> instance_;
+
+        buffer_functions();
+        bool valid() const;
+    };
+
+    bool buffer_functions::initialized_ = false;
+    boost::scoped_ptr<const buffer_functions> buffer_functions::instance_;
+
+    const buffer_functions * buffer_functions::instance()
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        if (!buffer_functions::initialized_) {
+            const char * const version =
+                reinterpret_cast<const char *>(glGetString(GL_VERSION));
+            if (!version) { return 0; } // No current context.
+            buffer_functions::initialized_ = true;
+
+            int major = 0, minor = 0;
+            if (std::sscanf(version, "%d.%d", &major, &minor) == 2
+                && (major > 1 || (major == 1 && minor >= 5))) {
+                buffer_functions::instance_.reset(new buffer_functions);
+                if (!buffer_functions::instance_->valid()) {
+                    buffer_functions::instance_.reset();
+                }
+            }
+        }
+        return buffer_functions::instance_.get();
+    }
+
+    buffer_functions::buffer_functions()
+    {
+# ifdef _WIN32
+        this->gen_buffers =
+            reinterpret_cast<gen_buffers_t>(
+                wglGetProcAddress("glGenBuffers"));
+        this->delete_buffers =
+            reinterpret_cast<delete_buffers_t>(
+                wglGetProcAddress("glDeleteBuffers"));
+        this->bind_buffer =
+            reinterpret_cast<bind_buffer_t>(
+                wglGetProcAddress("glBindBuffer"));
+        this->buffer_data =
+            reinterpret_cast<buffer_data_t>(
+                wglGetProcAddress("glBufferData"));
+        this->buffer_sub_data =
+            reinterpret_cast<buffer_sub_data_t>(
+                wglGetProcAddress("glBufferSubData"));
+# else
+        this->gen_buffers = &glGenBuffers;
+        this->delete_buffers = &glDeleteBuffers;
+        this->bind_buffer = &glBindBuffer;
+        this->buffer_data = &glBufferData;
+        this->buffer_sub_data = &glBufferSubData;
+# endif
+    }
+
+    bool buffer_functions::valid() const
+    {
+        return this->gen_buffers && this->delete_buffers && this->bind_buffer
+            && this->buffer_data && this->buffer_sub_data;
+    }
+
+    //
+    // Ranges of changed elements closer together than this are uploaded
+    // with a single call.
+    //
+    const std::size_t coalesce_distance = 256;
+
+    template <typename T>
+    OPENVRML_GL_LOCAL std::size_t
+    upload(const buffer_functions & gl,
+           const GLenum target,
+           const GLuint buffer,
+           const GLenum usage,
+           const std::vector<T> & previous,
+           const std::vector<T> & current)
+    {
+        typedef typename std::vector<T>::size_type size_type;
+
+        gl.bind_buffer(target, buffer);
+        if (previous.size() != current.size()) {
+            gl.buffer_data(target,
+                           buffer_size_t(current.size() * sizeof (T)),
+                           current.empty() ? 0 : &current[0],
+                           usage);
+            return current.size() * sizeof (T);
+        }
+
+        std::size_t uploaded = 0;
+        const size_type size = current.size();
+        size_type first = 0;
+        while (first < size) {
+            first = size_type(std::mismatch(previous.begin() + first,
+                                            previous.end(),
+                                            current.begin() + first).first
+                              - previous.begin());
+            if (first == size) { break; }
+            size_type last = first;
+            for (size_type i = first + 1;
+                 i < size && i - last <= coalesce_distance;
+                 ++i) {
+                if (previous[i] != current[i]) { last = i; }
+            }
+            const std::size_t bytes = (last + 1 - first) * sizeof (T);
+            gl.buffer_sub_data(target,
+                               buffer_offset_t(first * sizeof (T)),
+                               buffer_size_t(bytes),
+                               &current[first]);
+            uploaded += bytes;
+            first = last + 1;
+        }
+        return uploaded;
+    }
+}
+
+/**
+ * @internal
+ *
+ * @struct openvrml::gl::local::geometry_batch
+ *
+ * @brief A run of primitives in a @c geometry_data.
+ */
+
+/**
+ * @var GLenum openvrml::gl::local::geometry_batch::mode
+ *
+ * @brief The primitive type.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::geometry_batch::first
+ *
+ * @brief Offset of the batch's first index in @c geometry_data::indices.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::geometry_batch::count
+ *
+ * @brief The number of indices in the batch.
+ */
+
+
+/**
+ * @internal
+ *
+ * @class openvrml::gl::local::geometry_data
+ *
+ * @brief Vertex and index arrays describing a piece of geometry.
+ *
+ * Vertex attributes are interleaved: each vertex is a coordinate, followed
+ * by a normal, a color and a texture coordinate, each of which is present
+ * only if the corresponding bit is set in @c #format.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data::normal_attribute
+ *
+ * @brief Vertices include a normal.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data::color_attribute
+ *
+ * @brief Vertices include a color.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data::tex_coord_attribute
+ *
+ * @brief Vertices include a texture coordinate.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data::ccw_flag
+ *
+ * @brief Front faces are wound counterclockwise.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data::solid_flag
+ *
+ * @brief Back faces can be culled.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data::unlit_flag
+ *
+ * @brief Lighting and texturing do not apply.
+ */
+
+/**
+ * @var unsigned int openvrml::gl::local::geometry_data::format
+ *
+ * @brief Bit mask of @c attribute%s present in each vertex.
+ */
+
+/**
+ * @var unsigned int openvrml::gl::local::geometry_data::flags
+ *
+ * @brief Bit mask of rendering flags.
+ */
+
+/**
+ * @var std::vector<GLfloat> openvrml::gl::local::geometry_data::vertices
+ *
+ * @brief Interleaved vertex attributes.
+ */
+
+/**
+ * @var std::vector<GLuint> openvrml::gl::local::geometry_data::indices
+ *
+ * @brief Vertex indices.
+ */
+
+/**
+ * @var std::vector<openvrml::gl::local::geometry_batch> openvrml::gl::local::geometry_data::batches
+ *
+ * @brief Primitive batches.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * @param[in] format    bit mask of @c attribute%s.
+ * @param[in] flags     rendering flags.
+ */
+openvrml::gl::local::geometry_data::geometry_data(const unsigned int format,
+                                                  const unsigned int flags):
+    format(format),
+    flags(flags)
+{}
+
+/**
+ * @brief The number of @c GLfloat%s in each vertex.
+ *
+ * @return the number of @c GLfloat%s in each vertex.
+ */
+std::size_t openvrml::gl::local::geometry_data::stride() const
+    OPENVRML_NOTHROW
+{
+    return 3
+        + ((this->format & normal_attribute) ? 3 : 0)
+        + ((this->format & color_attribute) ? 3 : 0)
+        + ((this->format & tex_coord_attribute) ? 2 : 0);
+}
+
+/**
+ * @brief The number of vertices.
+ *
+ * @return the number of vertices.
+ */
+std::size_t openvrml::gl::local::geometry_data::vertex_count() const
+    OPENVRML_NOTHROW
+{
+    return this->vertices.size() / this->stride();
+}
+
+/**
+ * @brief Append a vertex.
+ *
+ * Attributes not included in @c #format are ignored.
+ *
+ * @param[in] coord     coordinate.
+ * @param[in] normal    normal.
+ * @param[in] color     color.
+ * @param[in] tex_coord texture coordinate.
+ *
+ * @return the index of the new vertex.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+GLuint
+openvrml::gl::local::geometry_data::add_vertex(const vec3f & coord,
+                                               const vec3f & normal,
+                                               const color & color,
+                                               const vec2f & tex_coord)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    const GLuint index = GLuint(this->vertex_count());
+    this->vertices.insert(this->vertices.end(), &coord[0], &coord[0] + 3);
+    if (this->format & normal_attribute) {
+        this->vertices.insert(this->vertices.end(),
+                              &normal[0], &normal[0] + 3);
+    }
+    if (this->format & color_attribute) {
+        this->vertices.insert(this->vertices.end(), &color[0], &color[0] + 3);
+    }
+    if (this->format & tex_coord_attribute) {
+        this->vertices.insert(this->vertices.end(),
+                              &tex_coord[0], &tex_coord[0] + 2);
+    }
+    return index;
+}
+
+/**
+ * @brief Append a vertex.
+ *
+ * @param[in] vertex    @c #stride interleaved attribute values.
+ *
+ * @return the index of the new vertex.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+GLuint openvrml::gl::local::geometry_data::add_vertex(const GLfloat * vertex)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    const GLuint index = GLuint(this->vertex_count());
+    this->vertices.insert(this->vertices.end(),
+                          vertex, vertex + this->stride());
+    return index;
+}
+
+/**
+ * @brief The attributes of a vertex.
+ *
+ * @param[in] index a vertex index.
+ *
+ * @return a pointer to the first of the @c #stride attribute values of the
+ *         vertex at @p index.
+ */
+const GLfloat *
+openvrml::gl::local::geometry_data::vertex(const GLuint index) const
+    OPENVRML_NOTHROW
+{
+    assert(index < this->vertex_count());
+    return &this->vertices[index * this->stride()];
+}
+
+/**
+ * @brief Start a batch of primitives.
+ *
+ * The batch includes the indices appended before the matching call to @c
+ * #end_batch.
+ *
+ * @param[in] mode  the primitive type.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::gl::local::geometry_data::begin_batch(const GLenum mode)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    const geometry_batch batch = { mode, this->indices.size(), 0 };
+    this->batches.push_back(batch);
+}
+
+/**
+ * @brief End the current batch of primitives.
+ *
+ * Empty batches are discarded.
+ */
+void openvrml::gl::local::geometry_data::end_batch() OPENVRML_NOTHROW
+{
+    assert(!this->batches.empty());
+    geometry_batch & batch = this->batches.back();
+    batch.count = this->indices.size() - batch.first;
+    if (batch.count == 0) { this->batches.pop_back(); }
+}
+
+/**
+ * @brief Swap contents with @p data.
+ *
+ * @param[in,out] data  geometry.
+ */
+void openvrml::gl::local::geometry_data::swap(geometry_data & data)
+    OPENVRML_NOTHROW
+{
+    std::swap(this->format, data.format);
+    std::swap(this->flags, data.flags);
+    this->vertices.swap(data.vertices);
+    this->indices.swap(data.indices);
+    this->batches.swap(data.batches);
+}
+
+
+/**
+ * @internal
+ *
+ * @class openvrml::gl::local::geometry_buffer
+ *
+ * @brief Retained geometry for a @c geometry_node.
+ *
+ * If the OpenGL context supports buffer objects, the vertex and index arrays
+ * are stored in them; otherwise they are drawn from client memory.  A copy
+ * of the arrays is kept so that, when the geometry is rebuilt, only the
+ * ranges that differ from the previous revision are uploaded again.
+ *
+ * Functions that make OpenGL calls must be called with the context in which
+ * the buffer was created current.
+ */
+
+/**
+ * @var openvrml::gl::local::geometry_data openvrml::gl::local::geometry_buffer::data_
+ *
+ * @brief The current revision of the geometry.
+ */
+
+/**
+ * @var GLuint openvrml::gl::local::geometry_buffer::vertex_buffer_
+ *
+ * @brief Vertex buffer object, or 0.
+ */
+
+/**
+ * @var GLuint openvrml::gl::local::geometry_buffer::index_buffer_
+ *
+ * @brief Index buffer object, or 0.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::geometry_buffer::revision_
+ *
+ * @brief The number of times the geometry has been updated.
+ */
+
+/**
+ * @var bool openvrml::gl::local::geometry_buffer::stale_
+ *
+ * @brief Whether the geometry must be rebuilt before it is drawn again.
+ */
+
+/**
+ * @brief Construct.
+ */
+openvrml::gl::local::geometry_buffer::geometry_buffer() OPENVRML_NOTHROW:
+    vertex_buffer_(0),
+    index_buffer_(0),
+    revision_(0),
+    stale_(true)
+{}
+
+/**
+ * @brief The current geometry.
+ *
+ * @return the current geometry.
+ */
+const openvrml::gl::local::geometry_data &
+openvrml::gl::local::geometry_buffer::data() const OPENVRML_NOTHROW
+{
+    return this->data_;
+}
+
+/**
+ * @brief Whether the geometry must be rebuilt before it is drawn again.
+ *
+ * @return @c true if the geometry is out of date; @c false otherwise.
+ */
+bool openvrml::gl::local::geometry_buffer::stale() const OPENVRML_NOTHROW
+{
+    return this->stale_;
+}
+
+/**
+ * @brief Set whether the geometry must be rebuilt before it is drawn again.
+ *
+ * @param[in] value @c true if the geometry is out of date; @c false
+ *                  otherwise.
+ */
+void openvrml::gl::local::geometry_buffer::stale(const bool value)
+    OPENVRML_NOTHROW
+{
+    this->stale_ = value;
+}
+
+/**
+ * @brief Replace the geometry.
+ *
+ * If the vertex and index arrays are the same size as those of the previous
+ * revision, only the ranges that have changed are uploaded.  On return, @p
+ * data holds the previous revision and the buffer is no longer stale.
+ *
+ * @param[in,out] data  the new geometry.
+ *
+ * @return the number of bytes uploaded to buffer objects.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+std::size_t
+openvrml::gl::local::geometry_buffer::update(geometry_data & data)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    std::size_t uploaded = 0;
+    const buffer_functions * const gl = buffer_functions::instance();
+    if (gl) {
+        const bool created = !this->vertex_buffer_;
+        if (created) {
+            GLuint buffers[2];
+            gl->gen_buffers(2, buffers);
+            this->vertex_buffer_ = buffers[0];
+            this->index_buffer_ = buffers[1];
+        }
+        static const std::vector<GLfloat> no_vertices;
+        static const std::vector<GLuint> no_indices;
+        const GLenum usage = (this->revision_ > 0) ? GL_DYNAMIC_DRAW
+                                                   : GL_STATIC_DRAW;
+        uploaded += upload(*gl, GL_ARRAY_BUFFER, this->vertex_buffer_, usage,
+                           (created || data.format != this->data_.format)
+                           ? no_vertices
+                           : this->data_.vertices,
+                           data.vertices);
+        uploaded += upload(*gl, GL_ELEMENT_ARRAY_BUFFER, this->index_buffer_,
+                           usage,
+                           created ? no_indices : this->data_.indices,
+                           data.indices);
+        gl->bind_buffer(GL_ARRAY_BUFFER, 0);
+        gl->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    this->data_.swap(data);
+    ++this->revision_;
+    this->stale_ = false;
+    return uploaded;
+}
+
+/**
+ * @brief Draw the geometry.
+ *
+ * The caller is responsible for any state implied by @c geometry_data::flags.
+ */
+void openvrml::gl::local::geometry_buffer::draw() const OPENVRML_NOTHROW
+{
+    const geometry_data & data = this->data_;
+    if (data.batches.empty()) { return; }
+
+    const buffer_functions * const gl =
+        this->vertex_buffer_ ? buffer_functions::instance() : 0;
+
+    const GLsizei stride = GLsizei(data.stride() * sizeof (GLfloat));
+    const GLfloat * vertices = 0;
+    const GLuint * indices = 0;
+    if (gl) {
+        gl->bind_buffer(GL_ARRAY_BUFFER, this->vertex_buffer_);
+        gl->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, this->index_buffer_);
+    } else {
+        vertices = &data.vertices[0];
+        indices = &data.indices[0];
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, vertices);
+    vertices += 3;
+    if (data.format & geometry_data::normal_attribute) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, stride, vertices);
+        vertices += 3;
+    }
+    if (data.format & geometry_data::color_attribute) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(3, GL_FLOAT, stride, vertices);
+        vertices += 3;
+    }
+    if (data.format & geometry_data::tex_coord_attribute) {
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, stride, vertices);
+    }
+
+    for (std::vector<geometry_batch>::const_iterator batch =
+             data.batches.begin();
+         batch != data.batches.end();
+         ++batch) {
+        glDrawElements(batch->mode,
+                       GLsizei(batch->count),
+                       GL_UNSIGNED_INT,
+                       indices + batch->first);
+    }
+
+    glPopClientAttrib();
+
+    if (gl) {
+        gl->bind_buffer(GL_ARRAY_BUFFER, 0);
+        gl->bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+/**
+ * @brief Delete any buffer objects.
+ *
+ * The geometry is marked stale.
+ */
+void openvrml::gl::local::geometry_buffer::release() OPENVRML_NOTHROW
+{
+    if (this->vertex_buffer_) {
+        const buffer_functions * const gl = buffer_functions::instance();
+        assert(gl);
+        const GLuint buffers[2] = { this->vertex_buffer_,
+                                    this->index_buffer_ };
+        gl->delete_buffers(2, buffers);
+        this->vertex_buffer_ = 0;
+        this->index_buffer_ = 0;
+    }
+    this->stale_ = true;
+}
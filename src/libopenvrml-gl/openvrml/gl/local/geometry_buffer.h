@@ -0,0 +1,105 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_GL_LOCAL_GEOMETRY_BUFFER_H
+#   define OPENVRML_GL_LOCAL_GEOMETRY_BUFFER_H
+
+#   include <openvrml/gl/viewer.h>
+#   include <boost/noncopyable.hpp>
+#   include <vector>
+
+namespace openvrml {
+
+    namespace gl {
+
+        namespace local {
+
+            struct OPENVRML_GL_LOCAL geometry_batch {
+                GLenum mode;
+                std::size_t first;
+                std::size_t count;
+            };
+
+
+            class OPENVRML_GL_LOCAL geometry_data {
+            public:
+                enum attribute {
+                    normal_attribute    = 0x1,
+                    color_attribute     = 0x2,
+                    tex_coord_attribute = 0x4
+                };
+
+                enum {
+                    ccw_flag   = 0x1,
+                    solid_flag = 0x2,
+                    unlit_flag = 0x4
+                };
+
+                unsigned int format;
+                unsigned int flags;
+                std::vector<GLfloat> vertices;
+                std::vector<GLuint> indices;
+                std::vector<geometry_batch> batches;
+
+                explicit geometry_data(unsigned int format = 0,
+                                       unsigned int flags = 0);
+
+                std::size_t stride() const OPENVRML_NOTHROW;
+                std::size_t vertex_count() const OPENVRML_NOTHROW;
+
+                GLuint add_vertex(const vec3f & coord,
+                                  const vec3f & normal,
+                                  const color & color,
+                                  const vec2f & tex_coord)
+                    OPENVRML_THROW1(std::bad_alloc);
+                GLuint add_vertex(const GLfloat * vertex)
+                    OPENVRML_THROW1(std::bad_alloc);
+                const GLfloat * vertex(GLuint index) const OPENVRML_NOTHROW;
+
+                void begin_batch(GLenum mode) OPENVRML_THROW1(std::bad_alloc);
+                void end_batch() OPENVRML_NOTHROW;
+
+                void swap(geometry_data & data) OPENVRML_NOTHROW;
+            };
+
+
+            class OPENVRML_GL_LOCAL geometry_buffer : boost::noncopyable {
+                geometry_data data_;
+                GLuint vertex_buffer_, index_buffer_;
+                std::size_t revision_;
+                bool stale_;
+
+            public:
+                geometry_buffer() OPENVRML_NOTHROW;
+
+                const geometry_data & data() const OPENVRML_NOTHROW;
+                bool stale() const OPENVRML_NOTHROW;
+                void stale(bool value) OPENVRML_NOTHROW;
+
+                std::size_t update(geometry_data & data)
+                    OPENVRML_THROW1(std::bad_alloc);
+                void draw() const OPENVRML_NOTHROW;
+                void release() OPENVRML_NOTHROW;
+            };
+        }
+    }
+}
+
+# endif // ifndef OPENVRML_GL_LOCAL_GEOMETRY_BUFFER_H
@@ -0,0 +1,603 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "render_queue.h"
+# include <algorithm>
+# include <cstring>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    const GLfloat identity[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+
+    OPENVRML_GL_LOCAL inline void enable(const GLenum capability,
+                                         const bool value)
+    {
+        if (value) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+    }
+
+    //
+    // Opaque items come first, grouped by texture and then by the rest of
+    // their state, and front to back within a group.  Blended items follow,
+    // back to front.
+    //
+    class OPENVRML_GL_LOCAL draw_order {
+        const std::vector<const openvrml::gl::local::render_state *> &
+            states_;
+
+    public:
+        explicit draw_order(
+            const std::vector<const openvrml::gl::local::render_state *> &
+            states):
+            states_(states)
+        {}
+
+        bool operator()(const openvrml::gl::local::render_queue::item & lhs,
+                        const openvrml::gl::local::render_queue::item & rhs)
+            const
+        {
+            const openvrml::gl::local::render_state & l =
+                *this->states_[lhs.state];
+            const openvrml::gl::local::render_state & r =
+                *this->states_[rhs.state];
+            if (l.mode.blend != r.mode.blend) { return !l.mode.blend; }
+            if (l.mode.blend) { return lhs.distance > rhs.distance; }
+            if (l.texture.name != r.texture.name) {
+                return l.texture.name < r.texture.name;
+            }
+            if (lhs.state != rhs.state) { return lhs.state < rhs.state; }
+            return lhs.distance < rhs.distance;
+        }
+    };
+}
+
+/**
+ * @internal
+ *
+ * @struct openvrml::gl::local::render_state
+ *
+ * @brief The OpenGL state a queued draw is made with.
+ *
+ * Every member is four bytes wide, so the structure has no padding and
+ * states can be compared bytewise.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::gl::local::render_state::material_state
+ *
+ * @brief Material parameters and the current color.
+ *
+ * The components are those passed to @c glMaterial and @c glColor.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::gl::local::render_state::texture_state
+ *
+ * @brief The bound texture.
+ */
+
+/**
+ * @var GLuint openvrml::gl::local::render_state::texture_state::name
+ *
+ * @brief The texture object; 0 if texturing is disabled.
+ */
+
+/**
+ * @var GLint openvrml::gl::local::render_state::texture_state::env_mode
+ *
+ * @brief The texture environment mode; 0 if texturing is disabled.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::gl::local::render_state::mode_state
+ *
+ * @brief Capabilities enabled for the draw.
+ *
+ * Each member is nonzero if the corresponding capability is enabled.
+ */
+
+/**
+ * @var openvrml::gl::local::render_state::material_state openvrml::gl::local::render_state::material
+ *
+ * @brief Material parameters and the current color.
+ */
+
+/**
+ * @var openvrml::gl::local::render_state::texture_state openvrml::gl::local::render_state::texture
+ *
+ * @brief The bound texture.
+ */
+
+/**
+ * @var openvrml::gl::local::render_state::mode_state openvrml::gl::local::render_state::mode
+ *
+ * @brief Capabilities enabled for the draw.
+ */
+
+/**
+ * @var GLint openvrml::gl::local::render_state::geometry_color
+ *
+ * @brief Nonzero if the geometry has its own colors.
+ *
+ * Drawing such geometry leaves the current color (and, with
+ * @c GL_COLOR_MATERIAL, the material) indeterminate.
+ */
+
+/**
+ * @var GLint openvrml::gl::local::render_state::texture_transform
+ *
+ * @brief Nonzero if @c #texture_matrix is not the identity.
+ */
+
+/**
+ * @var GLfloat openvrml::gl::local::render_state::texture_matrix[16]
+ *
+ * @brief The texture matrix.
+ */
+
+/**
+ * @brief Construct the state at the start of a frame.
+ */
+openvrml::gl::local::render_state::render_state() OPENVRML_NOTHROW
+{
+    std::memset(this, 0, sizeof *this);
+    std::fill(this->material.color, this->material.color + 4, 1.0f);
+    std::copy(identity, identity + 16, this->texture_matrix);
+    this->mode.lighting = 1;
+}
+
+/**
+ * @internal
+ *
+ * @brief Order @c render_state%s bytewise.
+ *
+ * @param[in] lhs   a @c render_state.
+ * @param[in] rhs   a @c render_state.
+ *
+ * @return @c true if @p lhs precedes @p rhs; @c false otherwise.
+ */
+bool openvrml::gl::local::operator<(const render_state & lhs,
+                                    const render_state & rhs)
+    OPENVRML_NOTHROW
+{
+    return std::memcmp(&lhs, &rhs, sizeof (render_state)) < 0;
+}
+
+
+/**
+ * @internal
+ *
+ * @class openvrml::gl::local::render_queue
+ *
+ * @brief Draws collected during a scene graph traversal, to be sorted and
+ *        submitted with as few state changes as possible.
+ *
+ * The viewer records the state set by the appearance and material calls in
+ * @c #pending, and @c #push%es a draw with that state and the current
+ * modelview matrix.  When the queue is flushed, opaque draws are made
+ * first, grouped by texture and then by material and front to back within
+ * a group; then blended draws, back to front.  State that is already
+ * current is not set again.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::gl::local::render_queue::item
+ *
+ * @brief A queued draw.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::item::state
+ *
+ * @brief Index of the draw's @c render_state.
+ */
+
+/**
+ * @var openvrml::mat4f openvrml::gl::local::render_queue::item::modelview
+ *
+ * @brief The modelview matrix.
+ */
+
+/**
+ * @var float openvrml::gl::local::render_queue::item::distance
+ *
+ * @brief The distance of the geometry's origin in front of the eye.
+ */
+
+/**
+ * @var const openvrml::gl::local::geometry_buffer * openvrml::gl::local::render_queue::item::buffer
+ *
+ * @brief Retained geometry to draw; or null if @c #list is to be called.
+ */
+
+/**
+ * @var GLuint openvrml::gl::local::render_queue::item::list
+ *
+ * @brief A display list to call if @c #buffer is null.
+ */
+
+/**
+ * @var openvrml::gl::local::render_state openvrml::gl::local::render_queue::pending
+ *
+ * @brief The state the next draw @c #push%ed is made with.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::draws
+ *
+ * @brief The number of draws queued in the current frame.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::blended
+ *
+ * @brief The number of blended draws queued in the current frame.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::flushes
+ *
+ * @brief The number of times the queue has been flushed in the current
+ *        frame.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::texture_changes
+ *
+ * @brief The number of times the texture binding was set.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::texture_changes_elided
+ *
+ * @brief The number of draws for which the texture binding was already
+ *        current.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::material_changes
+ *
+ * @brief The number of times the material and color were set.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::material_changes_elided
+ *
+ * @brief The number of draws for which the material and color were already
+ *        current.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::mode_changes
+ *
+ * @brief The number of times lighting, blending and color material were
+ *        set.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::local::render_queue::mode_changes_elided
+ *
+ * @brief The number of draws for which lighting, blending and color
+ *        material were already current.
+ */
+
+/**
+ * @var openvrml::gl::local::render_queue::texture_applied
+ *
+ * @brief @c render_state::texture is current.
+ */
+
+/**
+ * @var openvrml::gl::local::render_queue::material_applied
+ *
+ * @brief @c render_state::material is current.
+ */
+
+/**
+ * @var openvrml::gl::local::render_queue::mode_applied
+ *
+ * @brief @c render_state::mode is current.
+ */
+
+/**
+ * @typedef openvrml::gl::local::render_queue::state_map_t
+ *
+ * @brief Map of distinct states to their indices.
+ */
+
+/**
+ * @var openvrml::gl::local::render_queue::state_map_t openvrml::gl::local::render_queue::state_index_
+ *
+ * @brief The distinct states of the queued draws.
+ */
+
+/**
+ * @var std::vector<const openvrml::gl::local::render_state *> openvrml::gl::local::render_queue::states_
+ *
+ * @brief The keys of @c #state_index_, by index.
+ */
+
+/**
+ * @var std::vector<openvrml::gl::local::render_queue::item> openvrml::gl::local::render_queue::items_
+ *
+ * @brief The queued draws.
+ */
+
+/**
+ * @var openvrml::gl::local::render_state openvrml::gl::local::render_queue::applied_
+ *
+ * @brief The state most recently applied.
+ */
+
+/**
+ * @var unsigned int openvrml::gl::local::render_queue::applied_valid_
+ *
+ * @brief Bit mask of the parts of @c #applied_ that are known to be
+ *        current.
+ */
+
+/**
+ * @brief Construct.
+ */
+openvrml::gl::local::render_queue::render_queue() OPENVRML_NOTHROW:
+    draws(0),
+    blended(0),
+    flushes(0),
+    texture_changes(0),
+    texture_changes_elided(0),
+    material_changes(0),
+    material_changes_elided(0),
+    mode_changes(0),
+    mode_changes_elided(0),
+    applied_valid_(0)
+{}
+
+/**
+ * @brief Reset the pending state and the counts for a new frame.
+ *
+ * @param[in] lighting  whether lighting is enabled.
+ */
+void openvrml::gl::local::render_queue::begin_frame(const bool lighting)
+    OPENVRML_NOTHROW
+{
+    this->end_flush();
+    this->pending = render_state();
+    this->pending.mode.lighting = lighting;
+    this->draws = 0;
+    this->blended = 0;
+    this->flushes = 0;
+    this->texture_changes = 0;
+    this->texture_changes_elided = 0;
+    this->material_changes = 0;
+    this->material_changes_elided = 0;
+    this->mode_changes = 0;
+    this->mode_changes_elided = 0;
+}
+
+/**
+ * @brief Whether any draws are queued.
+ *
+ * @return @c true if no draws are queued; @c false otherwise.
+ */
+bool openvrml::gl::local::render_queue::empty() const OPENVRML_NOTHROW
+{
+    return this->items_.empty();
+}
+
+/**
+ * @brief Queue a draw with the @c #pending state and the current modelview
+ *        matrix.
+ *
+ * As with the texture matrix in immediate drawing, a texture transform
+ * applies only to the next draw.
+ *
+ * @param[in] buffer    retained geometry to draw; or null.
+ * @param[in] list      a display list to call if @p buffer is null.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::gl::local::render_queue::push(const geometry_buffer * buffer,
+                                             const GLuint list)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    render_state state = this->pending;
+    if (!state.texture.env_mode) { state.texture.name = 0; }
+
+    state_map_t::iterator pos = this->state_index_.lower_bound(state);
+    if (pos == this->state_index_.end() || state < pos->first) {
+        pos = this->state_index_.insert(
+            pos, state_map_t::value_type(state, this->states_.size()));
+        try {
+            this->states_.push_back(&pos->first);
+        } catch (std::bad_alloc &) {
+            this->state_index_.erase(pos);
+            throw;
+        }
+    }
+
+    item i;
+    i.state = pos->second;
+    glGetFloatv(GL_MODELVIEW_MATRIX, &i.modelview[0][0]);
+    i.distance = -i.modelview[3][2];
+    i.buffer = buffer;
+    i.list = list;
+    this->items_.push_back(i);
+
+    ++this->draws;
+    if (state.mode.blend) { ++this->blended; }
+
+    this->pending.texture_transform = 0;
+    std::copy(identity, identity + 16, this->pending.texture_matrix);
+}
+
+/**
+ * @brief Note that a texture has been bound outside the queue.
+ *
+ * @param[in] name  the texture object bound.
+ */
+void openvrml::gl::local::render_queue::texture_bound(const GLuint name)
+    OPENVRML_NOTHROW
+{
+    if (this->applied_.texture.name != name) {
+        this->applied_valid_ &= ~texture_applied;
+    }
+}
+
+/**
+ * @brief Begin drawing the queued items.
+ *
+ * The caller must call @c #apply and @c #drawn for each item in order, and
+ * then @c #end_flush.  Any state set since the last flush is assumed to
+ * have changed.
+ *
+ * @return the queued items, in the order they are to be drawn.
+ */
+const std::vector<openvrml::gl::local::render_queue::item> &
+openvrml::gl::local::render_queue::begin_flush() OPENVRML_NOTHROW
+{
+    ++this->flushes;
+    this->applied_valid_ = 0;
+    std::stable_sort(this->items_.begin(), this->items_.end(),
+                     draw_order(this->states_));
+    return this->items_;
+}
+
+/**
+ * @brief Make the state and modelview matrix of a queued item current.
+ *
+ * @param[in] i a queued item.
+ */
+void openvrml::gl::local::render_queue::apply(const item & i)
+    OPENVRML_NOTHROW
+{
+    using std::memcmp;
+
+    const render_state & s = *this->states_[i.state];
+
+    //
+    // Capabilities are set first, so that GL_COLOR_MATERIAL is disabled
+    // before the material is set if it is not used.
+    //
+    if ((this->applied_valid_ & mode_applied)
+        && memcmp(&this->applied_.mode, &s.mode, sizeof s.mode) == 0) {
+        ++this->mode_changes_elided;
+    } else {
+        enable(GL_LIGHTING, s.mode.lighting != 0);
+        enable(GL_BLEND, s.mode.blend != 0);
+        enable(GL_COLOR_MATERIAL, s.mode.color_material != 0);
+        ++this->mode_changes;
+    }
+
+    //
+    // With GL_COLOR_MATERIAL enabled, glColor changes the material; so the
+    // material is only known to be current if it is disabled.
+    //
+    const bool material_current =
+        (this->applied_valid_ & material_applied)
+        && !s.mode.color_material
+        && memcmp(&this->applied_.material, &s.material,
+                  sizeof s.material) == 0;
+    if (material_current) {
+        ++this->material_changes_elided;
+    } else {
+        glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, s.material.ambient);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, s.material.diffuse);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, s.material.emission);
+        glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, s.material.shininess);
+        glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, s.material.specular);
+        ++this->material_changes;
+    }
+
+    if ((this->applied_valid_ & texture_applied)
+        && memcmp(&this->applied_.texture, &s.texture,
+                  sizeof s.texture) == 0) {
+        ++this->texture_changes_elided;
+    } else {
+        if (s.texture.env_mode) {
+            glEnable(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, s.texture.name);
+            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE,
+                      s.texture.env_mode);
+        } else {
+            glDisable(GL_TEXTURE_2D);
+        }
+        ++this->texture_changes;
+    }
+
+    if (!material_current) { glColor4fv(s.material.color); }
+
+    //
+    // The texture matrix is left as it is after a flush; so it is loaded
+    // if either this item or the last one drawn has a texture transform.
+    //
+    if (s.texture_transform || this->applied_.texture_transform) {
+        glMatrixMode(GL_TEXTURE);
+        glLoadMatrixf(s.texture_matrix);
+        glMatrixMode(GL_MODELVIEW);
+    }
+    glLoadMatrixf(&i.modelview[0][0]);
+
+    this->applied_ = s;
+    this->applied_valid_ = texture_applied | material_applied | mode_applied;
+}
+
+/**
+ * @brief Note that a queued item has been drawn.
+ *
+ * @param[in] i a queued item.
+ */
+void openvrml::gl::local::render_queue::drawn(const item & i)
+    OPENVRML_NOTHROW
+{
+    const render_state & s = *this->states_[i.state];
+    if (s.geometry_color || s.mode.color_material) {
+        this->applied_valid_ &= ~material_applied;
+    }
+}
+
+/**
+ * @brief Discard the queued items.
+ */
+void openvrml::gl::local::render_queue::end_flush() OPENVRML_NOTHROW
+{
+    this->items_.clear();
+    this->states_.clear();
+    this->state_index_.clear();
+}
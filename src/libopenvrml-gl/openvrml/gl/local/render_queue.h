@@ -0,0 +1,127 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_GL_LOCAL_RENDER_QUEUE_H
+#   define OPENVRML_GL_LOCAL_RENDER_QUEUE_H
+
+#   include <openvrml/gl/viewer.h>
+#   include <boost/noncopyable.hpp>
+#   include <map>
+#   include <vector>
+
+namespace openvrml {
+
+    namespace gl {
+
+        namespace local {
+
+            class geometry_buffer;
+
+            struct OPENVRML_GL_LOCAL render_state {
+                struct material_state {
+                    GLfloat ambient[4];
+                    GLfloat diffuse[4];
+                    GLfloat emission[4];
+                    GLfloat specular[4];
+                    GLfloat shininess;
+                    GLfloat color[4];
+                };
+
+                struct texture_state {
+                    GLuint name;
+                    GLint env_mode;
+                };
+
+                struct mode_state {
+                    GLint lighting;
+                    GLint color_material;
+                    GLint blend;
+                };
+
+                material_state material;
+                texture_state texture;
+                mode_state mode;
+                GLint geometry_color;
+                GLint texture_transform;
+                GLfloat texture_matrix[16];
+
+                render_state() OPENVRML_NOTHROW;
+            };
+
+            OPENVRML_GL_LOCAL bool operator<(const render_state & lhs,
+                                             const render_state & rhs)
+                OPENVRML_NOTHROW;
+
+
+            class OPENVRML_GL_LOCAL render_queue : boost::noncopyable {
+            public:
+                struct item {
+                    std::size_t state;
+                    mat4f modelview;
+                    float distance;
+                    const geometry_buffer * buffer;
+                    GLuint list;
+                };
+
+                render_state pending;
+
+                std::size_t draws;
+                std::size_t blended;
+                std::size_t flushes;
+                std::size_t texture_changes;
+                std::size_t texture_changes_elided;
+                std::size_t material_changes;
+                std::size_t material_changes_elided;
+                std::size_t mode_changes;
+                std::size_t mode_changes_elided;
+
+            private:
+                enum {
+                    texture_applied  = 0x1,
+                    material_applied = 0x2,
+                    mode_applied     = 0x4
+                };
+
+                typedef std::map<render_state, std::size_t> state_map_t;
+                state_map_t state_index_;
+                std::vector<const render_state *> states_;
+                std::vector<item> items_;
+                render_state applied_;
+                unsigned int applied_valid_;
+
+            public:
+                render_queue() OPENVRML_NOTHROW;
+
+                void begin_frame(bool lighting) OPENVRML_NOTHROW;
+                bool empty() const OPENVRML_NOTHROW;
+                void push(const geometry_buffer * buffer, GLuint list)
+                    OPENVRML_THROW1(std::bad_alloc);
+                void texture_bound(GLuint name) OPENVRML_NOTHROW;
+
+                const std::vector<item> & begin_flush() OPENVRML_NOTHROW;
+                void apply(const item & i) OPENVRML_NOTHROW;
+                void drawn(const item & i) OPENVRML_NOTHROW;
+                void end_flush() OPENVRML_NOTHROW;
+            };
+        }
+    }
+}
+
+# endif // ifndef OPENVRML_GL_LOCAL_RENDER_QUEUE_H
@@ -26,9 +26,14 @@
  */
 
 # include "viewer.h"
+# include "local/geometry_buffer.h"
+# include "local/render_queue.h"
 # include <openvrml/browser.h>
+# include <openvrml/compiled_mesh.h>
+# include <algorithm>
 # include <cmath>
 # include <limits>
+# include <memory>
 # ifndef NDEBUG
 #   include <iostream>
 # endif
@@ -59,14 +64,6 @@
             } while (false)
 #   endif
 
-# if (defined(__CYGWIN__) && defined(X_DISPLAY_MISSING)) || defined(__MINGW32__)
-#   define OPENVRML_GL_CALLBACK_ __attribute__ ((__stdcall__))
-# elif defined (_WIN32)
-#   define OPENVRML_GL_CALLBACK_ CALLBACK
-# else
-#   define OPENVRML_GL_CALLBACK_
-# endif
-
 namespace {
 
     const double pi     = 3.14159265358979323846;
@@ -124,208 +121,15 @@ namespace {
     }
 
 
-    struct OPENVRML_GL_LOCAL vertex_data {
-        GLdouble coord[3];
-        const openvrml::color * color;
-        const openvrml::vec3f * normal;
-        const openvrml::vec2f * tex_coord;
-
-        vertex_data();
-    };
-
-    vertex_data::vertex_data():
-        color(0),
-        normal(0),
-        tex_coord(0)
-    {}
-
-
-    struct OPENVRML_GL_LOCAL combined_vertex_data_ {
-        openvrml::color color;
-        openvrml::vec3f normal;
-        openvrml::vec2f tex_coord;
-    };
-
-
-    struct OPENVRML_GL_LOCAL shell_tess_user_data {
-        size_t face_index;
-        const std::vector<openvrml::color> * face_color;
-        const std::vector<openvrml::int32> * face_color_index;
-        const std::vector<openvrml::vec3f> * face_normal;
-        const std::vector<openvrml::int32> * face_normal_index;
-        std::list<vertex_data> combined_vertices;
-        std::list<combined_vertex_data_> combined_vertex_data;
-
-        shell_tess_user_data();
-    };
-
-    shell_tess_user_data::shell_tess_user_data():
-        face_index(0),
-        face_color(0),
-        face_color_index(0),
-        face_normal(0),
-        face_normal_index(0)
-    {}
-
-
-    /**
-     * @internal
-     */
-    struct OPENVRML_GL_LOCAL ShellData {
-        unsigned int mask;
-        const std::vector<openvrml::vec3f> & coord;
-        const std::vector<openvrml::int32> & coordIndex;
-        const std::vector<openvrml::color> & color;
-        const std::vector<openvrml::int32> & colorIndex;
-        const std::vector<openvrml::vec3f> & normal;
-        const std::vector<openvrml::int32> & normalIndex;
-        const std::vector<openvrml::vec2f> & texCoord;
-        const std::vector<openvrml::int32> & texCoordIndex;
-        int (&texAxes)[2];
-        float *texParams;
-        size_t nf, i;
-
-        ShellData(unsigned int mask,
-                  const std::vector<openvrml::vec3f> & coord,
-                  const std::vector<openvrml::int32> & coordIndex,
-                  const std::vector<openvrml::color> & color,
-                  const std::vector<openvrml::int32> & colorIndex,
-                  const std::vector<openvrml::vec3f> & normal,
-                  const std::vector<openvrml::int32> & normalIndex,
-                  const std::vector<openvrml::vec2f> & texCoord,
-                  const std::vector<openvrml::int32> & texCoordIndex,
-                  int (&texAxes)[2], float * texParams, size_t nf, size_t i);
-    };
-
-    ShellData::ShellData(unsigned int mask,
-                         const std::vector<openvrml::vec3f> & coord,
-                         const std::vector<openvrml::int32> & coordIndex,
-                         const std::vector<openvrml::color> & color,
-                         const std::vector<openvrml::int32> & colorIndex,
-                         const std::vector<openvrml::vec3f> & normal,
-                         const std::vector<openvrml::int32> & normalIndex,
-                         const std::vector<openvrml::vec2f> & texCoord,
-                         const std::vector<openvrml::int32> & texCoordIndex,
-                         int (&texAxes)[2],
-                         float * texParams,
-                         size_t nf,
-                         size_t i):
-        mask(mask),
-        coord(coord),
-        coordIndex(coordIndex),
-        color(color),
-        colorIndex(colorIndex),
-        normal(normal),
-        normalIndex(normalIndex),
-        texCoord(texCoord),
-        texCoordIndex(texCoordIndex),
-        texAxes(texAxes),
-        texParams(texParams),
-        nf(nf),
-        i(i)
-    {}
-
-    // Generate a normal from 3 indexed points.
-    OPENVRML_GL_LOCAL const openvrml::vec3f
-    indexFaceNormal(const size_t i1,
-                    const size_t i2,
-                    const size_t i3,
-                    const std::vector<openvrml::vec3f> & points)
+    OPENVRML_GL_LOCAL unsigned int face_flags(const unsigned int mask)
     {
-        using openvrml::vec3f;
-        const vec3f v1 = points[i2] - points[i3];
-        const vec3f v2 = points[i2] - points[i1];
-        return (v1 * v2).normalize();
-    }
-}
-
-extern "C" void OPENVRML_GL_CALLBACK_ shell_tess_begin(const GLenum type,
-                                                       void * const user_data)
-{
-    shell_tess_user_data & user_data_ =
-        *static_cast<shell_tess_user_data *>(user_data);
-
-    glBegin(type);
-
-    if (user_data_.face_color) {
-        const size_t color_index =
-            (user_data_.face_color_index
-             && user_data_.face_index < user_data_.face_color_index->size())
-            ? (*user_data_.face_color_index)[user_data_.face_index]
-            : user_data_.face_index;
-        if (color_index < user_data_.face_color->size()) {
-            glColor3fv(&(*user_data_.face_color)[color_index][0]);
-        }
-    }
-
-    if (user_data_.face_normal) {
-        const size_t normal_index =
-            (user_data_.face_normal_index
-             && user_data_.face_index < user_data_.face_normal_index->size())
-            ? (*user_data_.face_normal_index)[user_data_.face_index]
-            : user_data_.face_index;
-        if (normal_index < user_data_.face_normal->size()) {
-            glNormal3fv(&(*user_data_.face_normal)[normal_index][0]);
-        }
-    }
-}
-
-extern "C" void OPENVRML_GL_CALLBACK_ shell_tess_vertex(void * vertex_data)
-{
-    ::vertex_data & vertex_data_ = *static_cast< ::vertex_data *>(vertex_data);
-
-    if (vertex_data_.color) {
-        glColor3fv(&(*vertex_data_.color)[0]);
-    }
-    if (vertex_data_.normal) {
-        glNormal3fv(&(*vertex_data_.normal)[0]);
-    }
-    if (vertex_data_.tex_coord) {
-        glTexCoord2fv(&(*vertex_data_.tex_coord)[0]);
-    }
-
-    glVertex3dv(vertex_data_.coord);
-}
-
-extern "C" void OPENVRML_GL_CALLBACK_
-shell_tess_combine(GLdouble coords[3],
-                   void *[4],
-                   GLfloat[4],
-                   void ** outData,
-                   void * user_data)
-{
-    try {
-        using std::list;
-        assert(user_data);
-        shell_tess_user_data & user_data_ =
-            *static_cast<shell_tess_user_data *>(user_data);
-        user_data_.combined_vertices.push_back(::vertex_data());
-        ::vertex_data & new_vertex = user_data_.combined_vertices.back();
-        new_vertex.coord[0] = coords[0];
-        new_vertex.coord[1] = coords[1];
-        new_vertex.coord[2] = coords[2];
-        *outData = &new_vertex;
-    } catch (std::bad_alloc &) {
-        *outData = 0;
+        using openvrml::gl::viewer;
+        using openvrml::gl::local::geometry_data;
+        return ((mask & viewer::mask_ccw) ? geometry_data::ccw_flag : 0)
+            | ((mask & viewer::mask_solid) ? geometry_data::solid_flag : 0);
     }
 }
 
-extern "C" void OPENVRML_GL_CALLBACK_ shell_tess_end(void * user_data)
-{
-    shell_tess_user_data & user_data_ =
-        *static_cast<shell_tess_user_data *>(user_data);
-    ++user_data_.face_index;
-    glEnd();
-}
-
-extern "C" void OPENVRML_GL_CALLBACK_ tess_error(const GLenum error_code)
-{
-    const GLubyte * const error_str = gluErrorString(error_code);
-    const GLubyte * end;
-    for (end = error_str; *end; ++end) {}
-    OPENVRML_GL_PRINT_MESSAGE_(std::string(error_str, end));
-}
-
 
 /**
  * @namespace openvrml::gl
@@ -438,6 +242,81 @@ extern "C" void OPENVRML_GL_CALLBACK_ tess_error(const GLenum error_code)
  * @brief y-coordinate (for mouse events).
  */
 
+/**
+ * @struct openvrml::gl::viewer::state_statistics
+ *
+ * @brief Draw and state change counts for a frame.
+ *
+ * Draws are queued as the scene graph is traversed, and submitted sorted
+ * by texture and material so that state already current need not be set
+ * again.  A state change is counted as elided for each draw that did not
+ * need it.
+ *
+ * @sa #frame_state_statistics
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::draws
+ *
+ * @brief The number of geometry draws.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::blended
+ *
+ * @brief The number of draws made with blending, back to front after the
+ *        opaque draws.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::flushes
+ *
+ * @brief The number of times the queued draws were submitted.
+ *
+ * Draws are submitted at the end of the frame, and before the lights
+ * change.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::texture_changes
+ *
+ * @brief The number of times the texture binding was set.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::texture_changes_elided
+ *
+ * @brief The number of draws for which the texture binding was already
+ *        current.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::material_changes
+ *
+ * @brief The number of times the material and color were set.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::material_changes_elided
+ *
+ * @brief The number of draws for which the material and color were already
+ *        current.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::mode_changes
+ *
+ * @brief The number of times lighting, blending and color material were
+ *        set.
+ */
+
+/**
+ * @var std::size_t openvrml::gl::viewer::state_statistics::mode_changes_elided
+ *
+ * @brief The number of draws for which lighting, blending and color
+ *        material were already current.
+ */
+
 /**
  * @enum openvrml::gl::viewer::cursor_style
  *
@@ -654,18 +533,6 @@ void openvrml::gl::viewer::modelview_matrix_stack::pop()
  * @brief Number of nested objects.
  */
 
-/**
- * @var GLUtesselator * openvrml::gl::viewer::tesselator
- *
- * @brief GLU tesselation object.
- */
-
-/**
- * @var size_t openvrml::gl::viewer::sensitive
- *
- * @brief Count of sensitive @link openvrml::node nodes@endlink.
- */
-
 /**
  * @var size_t openvrml::gl::viewer::active_sensitive
  *
@@ -680,27 +547,16 @@ void openvrml::gl::viewer::modelview_matrix_stack::pop()
  */
 
 /**
- * @var openvrml::gl::viewer::maxsensitive
- *
- * @brief Maximum number of sensitive @link openvrml::node nodes@endlink.
- */
-
-/**
- * @var openvrml::node * openvrml::gl::viewer::sensitive_object[openvrml::gl::viewer::maxsensitive]
+ * @var std::vector<openvrml::node *> openvrml::gl::viewer::sensitive_object
  *
- * @brief Sensitive @link openvrml::node nodes@endlink.
- */
-
-/**
- * @var bool openvrml::gl::viewer::select_mode
- *
- * @brief Indicate whether the renderer is in select mode.
+ * @brief Sensitive @link openvrml::node nodes@endlink of the last frame, in
+ *        the order they were set.
  */
 
 /**
  * @var double openvrml::gl::viewer::select_z
  *
- * @brief Window z-coordinate of last selection.
+ * @brief Eye-space z-coordinate of last selection.
  */
 
 /**
@@ -757,6 +613,13 @@ void openvrml::gl::viewer::modelview_matrix_stack::pop()
  * @brief Rendering time for the previous cycle.
  */
 
+/**
+ * @var openvrml::gl::viewer::state_statistics openvrml::gl::viewer::state_statistics_
+ *
+ * @brief Draw and state change counts for the most recent call to
+ *        @c #redraw.
+ */
+
 namespace {
     //
     // The functions trackball and tb_project_to_sphere are derived from code
@@ -900,6 +763,7 @@ namespace {
  * @brief Construct a viewer for the specified browser.
  */
 openvrml::gl::viewer::viewer():
+    render_queue_(new local::render_queue),
     gl_initialized(false),
     blend(true),
     lit(true),
@@ -909,11 +773,8 @@ openvrml::gl::viewer::viewer():
     win_height(1),
     objects(0),
     nested_objects(0),
-    tesselator(0),
-    sensitive(0),
     active_sensitive(0),
     over_sensitive(0),
-    select_mode(false),
     select_z(0.0),
     rotating(false),
     scaling(false),
@@ -927,6 +788,8 @@ openvrml::gl::viewer::viewer():
     for (size_t i = 0; i < max_lights; ++i) {
         this->light_info_[i].type = viewer::light_unused;
     }
+    const state_statistics no_draws = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    this->state_statistics_ = no_draws;
 }
 
 /**
@@ -935,6 +798,7 @@ openvrml::gl::viewer::viewer():
 openvrml::gl::viewer::~viewer() OPENVRML_NOTHROW
 {
     this->shutdown();
+    delete this->render_queue_;
 }
 
 /**
@@ -944,9 +808,6 @@ void openvrml::gl::viewer::initialize()
 {
     if (this->gl_initialized) { return; }
 
-    assert(!this->tesselator);
-    this->tesselator = gluNewTess();
-
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
 
@@ -976,6 +837,14 @@ struct OPENVRML_LOCAL openvrml::gl::viewer::delete_list {
     }
 };
 
+struct OPENVRML_LOCAL openvrml::gl::viewer::delete_geometry {
+    void operator()(const geometry_map_t::value_type & value) const
+    {
+        value.second->release();
+        delete value.second;
+    }
+};
+
 struct OPENVRML_LOCAL openvrml::gl::viewer::delete_texture {
     void operator()(const texture_map_t::value_type & value) const
     {
@@ -988,17 +857,20 @@ struct OPENVRML_LOCAL openvrml::gl::viewer::delete_texture {
  */
 void openvrml::gl::viewer::shutdown()
 {
+    this->render_queue_->end_flush();
+
     std::for_each(this->list_map_.begin(), this->list_map_.end(),
                   delete_list());
     this->list_map_.clear();
 
+    std::for_each(this->geometry_map_.begin(), this->geometry_map_.end(),
+                  delete_geometry());
+    this->geometry_map_.clear();
+
     std::for_each(this->texture_map_.begin(), this->texture_map_.end(),
                   delete_texture());
     this->texture_map_.clear();
 
-    if (this->tesselator) { gluDeleteTess(this->tesselator); }
-    this->tesselator = 0;
-
     this->gl_initialized = false;
 }
 
@@ -1072,6 +944,7 @@ void openvrml::gl::viewer::do_end_object()
     for (size_t i = 0; i < max_lights; ++i) {
         if (this->light_info_[i].type == viewer::light_directional) {
             if (--this->light_info_[i].nesting_level < 0) {
+                this->flush_render_queue();
                 glDisable(GLenum(GL_LIGHT0 + i));
                 this->light_info_[i].type = viewer::light_unused;
             }
@@ -1127,9 +1000,7 @@ void openvrml::gl::viewer::end_geometry()
  */
 openvrml::gl::viewer::rendering_mode openvrml::gl::viewer::do_mode()
 {
-    return this->select_mode
-        ? viewer::pick_mode
-        : viewer::draw_mode;
+    return viewer::draw_mode;
 }
 
 /**
@@ -1153,6 +1024,145 @@ void openvrml::gl::viewer::do_reset_user_navigation()
     this->post_redraw();
 }
 
+/**
+ * @brief Draw the retained geometry for a node.
+ *
+ * @param[in] n a @c geometry_node.
+ *
+ * @return @c true if @p n has retained geometry that is not stale, which has
+ *         been drawn; @c false if the geometry for @p n must be built and
+ *         passed to @c #insert_geometry.
+ */
+bool openvrml::gl::viewer::draw_retained_geometry(const node & n)
+{
+    const geometry_map_t::const_iterator geometry =
+        this->geometry_map_.find(&n);
+    if (geometry == this->geometry_map_.end()
+        || geometry->second->stale()) {
+        return false;
+    }
+    this->queue_geometry(*geometry->second);
+    return true;
+}
+
+/**
+ * @brief Retain and draw the geometry for a node.
+ *
+ * If @p n already has (stale) retained geometry, its buffers are updated in
+ * place.
+ *
+ * @param[in] n         a @c geometry_node.
+ * @param[in,out] data  the geometry for @p n.  On return, the contents are
+ *                      unspecified.
+ */
+void openvrml::gl::viewer::insert_geometry(const node & n,
+                                           local::geometry_data & data)
+{
+    geometry_map_t::iterator geometry = this->geometry_map_.find(&n);
+    if (geometry == this->geometry_map_.end()) {
+        std::auto_ptr<local::geometry_buffer> buffer(
+            new local::geometry_buffer);
+        geometry =
+            this->geometry_map_.insert(
+                geometry_map_t::value_type(&n, buffer.get())).first;
+        buffer.release();
+    }
+    geometry->second->update(data);
+    this->queue_geometry(*geometry->second);
+}
+
+/**
+ * @brief Draw retained geometry.
+ *
+ * @param[in] buffer    retained geometry.
+ */
+void
+openvrml::gl::viewer::draw_geometry(const local::geometry_buffer & buffer)
+{
+    using local::geometry_data;
+    const geometry_data & data = buffer.data();
+
+    this->begin_geometry();
+
+    // Face orientation & culling
+    glFrontFace((data.flags & geometry_data::ccw_flag) ? GL_CCW : GL_CW);
+    if (!(data.flags & geometry_data::solid_flag)) {
+        glDisable(GL_CULL_FACE);
+    }
+
+    if (data.flags & geometry_data::unlit_flag) {
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+    }
+
+    buffer.draw();
+
+    this->end_geometry();
+}
+
+/**
+ * @brief Queue retained geometry to be drawn with the current state.
+ *
+ * @param[in] buffer    retained geometry.
+ */
+void
+openvrml::gl::viewer::queue_geometry(const local::geometry_buffer & buffer)
+{
+    this->render_queue_->push(&buffer, 0);
+}
+
+/**
+ * @brief Queue a display list to be called with the current state.
+ *
+ * @param[in] list  a display list.
+ */
+void openvrml::gl::viewer::queue_list(const GLuint list)
+{
+    this->render_queue_->push(0, list);
+}
+
+/**
+ * @brief Draw the queued geometry.
+ *
+ * Opaque geometry is drawn first, grouped by texture and material; then
+ * blended geometry, back to front.  State that is already current is not
+ * set again.
+ *
+ * The queue must be flushed before any state that is not recorded with the
+ * queued draws (such as the lights) changes.
+ */
+void openvrml::gl::viewer::flush_render_queue()
+{
+    using local::render_queue;
+
+    if (this->render_queue_->empty()) { return; }
+
+    //
+    // The modelview matrix stack may be full; so save the matrix rather
+    // than pushing it.
+    //
+    mat4f modelview;
+    glGetFloatv(GL_MODELVIEW_MATRIX, &modelview[0][0]);
+
+    const std::vector<render_queue::item> & items =
+        this->render_queue_->begin_flush();
+    for (std::vector<render_queue::item>::const_iterator item =
+             items.begin();
+         item != items.end();
+         ++item) {
+        this->render_queue_->apply(*item);
+        if (item->buffer) {
+            this->draw_geometry(*item->buffer);
+        } else {
+            glCallList(item->list);
+        }
+        this->render_queue_->drawn(*item);
+    }
+    this->render_queue_->end_flush();
+
+    glLoadMatrixf(&modelview[0][0]);
+}
+
 /**
  * @brief Insert a background into a display list.
  *
@@ -1171,15 +1181,14 @@ void openvrml::gl::viewer::do_insert_background(const background_node & n)
     // Need to separate the geometry from the transformation so the
     // dlist doesn't have to get rebuilt for every mouse movement...
     // Don't bother with a dlist if we aren't drawing anything
-    if (!this->select_mode
-        && (!n.sky_angle().empty()
-            || !n.ground_angle().empty()
-            || (n.front() && !n.front()->image().array().empty())
-            || (n.back() && !n.back()->image().array().empty())
-            || (n.left() && !n.left()->image().array().empty())
-            || (n.right() && !n.right()->image().array().empty())
-            || (n.top() && !n.top()->image().array().empty())
-            || (n.bottom() && !n.bottom()->image().array().empty()))) {
+    if (!n.sky_angle().empty()
+        || !n.ground_angle().empty()
+        || (n.front() && !n.front()->image().array().empty())
+        || (n.back() && !n.back()->image().array().empty())
+        || (n.left() && !n.left()->image().array().empty())
+        || (n.right() && !n.right()->image().array().empty())
+        || (n.top() && !n.top()->image().array().empty())
+        || (n.bottom() && !n.bottom()->image().array().empty())) {
         glid = glGenLists(1);
         glNewList(glid, GL_COMPILE_AND_EXECUTE);
     }
@@ -1204,8 +1213,7 @@ void openvrml::gl::viewer::do_insert_background(const background_node & n)
     glClear(mask);
 
     // Draw the background as big spheres centered at the view position
-    if (!this->select_mode
-        && (!n.sky_angle().empty() || !n.ground_angle().empty())) {
+    if (!n.sky_angle().empty() || !n.ground_angle().empty()) {
         using std::vector;
 
         glDisable(GL_DEPTH_TEST);
@@ -1442,16 +1450,12 @@ void openvrml::gl::viewer::do_insert_box(const geometry_node & n,
 {
     const list_map_t::const_iterator list = this->list_map_.find(&n);
     if (list != this->list_map_.end()) {
-        glCallList(list->second);
+        this->queue_list(list->second);
         return;
     }
 
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
+    const GLuint glid = glGenLists(1);
+    glNewList(glid, GL_COMPILE);
 
     static const GLint faces[6][4] =
     {
@@ -1512,6 +1516,7 @@ void openvrml::gl::viewer::do_insert_box(const geometry_node & n,
     if (glid) {
         glEndList();
         this->list_map_.insert(std::make_pair(&n, glid));
+        this->queue_list(glid);
     }
 }
 
@@ -1594,16 +1599,12 @@ void openvrml::gl::viewer::do_insert_cone(const geometry_node & n,
 {
     const list_map_t::const_iterator list = this->list_map_.find(&n);
     if (list != this->list_map_.end()) {
-        glCallList(list->second);
+        this->queue_list(list->second);
         return;
     }
 
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList( glid, GL_COMPILE_AND_EXECUTE );
-    }
+    const GLuint glid = glGenLists(1);
+    glNewList(glid, GL_COMPILE);
 
     begin_geometry();
     if (!bottom || !side) { glDisable(GL_CULL_FACE); }
@@ -1665,6 +1666,7 @@ void openvrml::gl::viewer::do_insert_cone(const geometry_node & n,
     if (glid) {
         glEndList();
         this->list_map_.insert(std::make_pair(&n, glid));
+        this->queue_list(glid);
     }
 }
 
@@ -1687,16 +1689,12 @@ void openvrml::gl::viewer::do_insert_cylinder(const geometry_node & n,
 {
     const list_map_t::const_iterator list = this->list_map_.find(&n);
     if (list != this->list_map_.end()) {
-        glCallList(list->second);
+        this->queue_list(list->second);
         return;
     }
 
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
+    const GLuint glid = glGenLists(1);
+    glNewList(glid, GL_COMPILE);
 
     begin_geometry();
     if (!bottom || !side || !top) { glDisable(GL_CULL_FACE); }
@@ -1774,6 +1772,7 @@ void openvrml::gl::viewer::do_insert_cylinder(const geometry_node & n,
     if (glid) {
         glEndList();
         this->list_map_.insert(std::make_pair(&n, glid));
+        this->queue_list(glid);
     }
 }
 
@@ -1815,11 +1814,174 @@ namespace {
 
         return Vz * Vx;
     }
+
+    //
+    // Triangulate an ElevationGrid.  Vertices are shared between adjacent
+    // quads unless a color or normal is given per quad.
+    //
+    class OPENVRML_GL_LOCAL elevation_grid_builder {
+        const unsigned int mask_;
+        const std::vector<float> & height_;
+        const size_t x_dimension_, z_dimension_;
+        const float x_spacing_, z_spacing_;
+        const std::vector<openvrml::color> & color_;
+        const std::vector<openvrml::vec3f> & normal_;
+        const std::vector<openvrml::vec2f> & tex_coord_;
+
+    public:
+        elevation_grid_builder(unsigned int mask,
+                               const std::vector<float> & height,
+                               size_t x_dimension,
+                               size_t z_dimension,
+                               float x_spacing,
+                               float z_spacing,
+                               const std::vector<openvrml::color> & color,
+                               const std::vector<openvrml::vec3f> & normal,
+                               const std::vector<openvrml::vec2f> & tex_coord);
+
+        void build(openvrml::gl::local::geometry_data & data) const;
+
+    private:
+        GLuint add_vertex(openvrml::gl::local::geometry_data & data,
+                          size_t i, size_t j, size_t quad) const;
+        const openvrml::vec3f quad_normal(size_t quad) const;
+    };
+
+    elevation_grid_builder::
+    elevation_grid_builder(const unsigned int mask,
+                           const std::vector<float> & height,
+                           const size_t x_dimension,
+                           const size_t z_dimension,
+                           const float x_spacing,
+                           const float z_spacing,
+                           const std::vector<openvrml::color> & color,
+                           const std::vector<openvrml::vec3f> & normal,
+                           const std::vector<openvrml::vec2f> & tex_coord):
+        mask_(mask),
+        height_(height),
+        x_dimension_(x_dimension),
+        z_dimension_(z_dimension),
+        x_spacing_(x_spacing),
+        z_spacing_(z_spacing),
+        color_(color),
+        normal_(normal),
+        tex_coord_(tex_coord)
+    {}
+
+    void
+    elevation_grid_builder::build(openvrml::gl::local::geometry_data & data)
+        const
+    {
+        using openvrml::gl::viewer;
+
+        const size_t nx = this->x_dimension_, nz = this->z_dimension_;
+        const bool shared = (this->mask_ & viewer::mask_normal_per_vertex)
+            && (this->color_.empty()
+                || (this->mask_ & viewer::mask_color_per_vertex));
+
+        data.begin_batch(GL_TRIANGLES);
+        if (shared) {
+            for (size_t j = 0; j < nz; ++j) {
+                for (size_t i = 0; i < nx; ++i) {
+                    this->add_vertex(data, i, j, 0);
+                }
+            }
+        }
+
+        // x varies fastest
+        for (size_t j = 0; j < nz - 1; ++j) {
+            for (size_t i = 0; i < nx - 1; ++i) {
+                const size_t quad = j * (nx - 1) + i;
+                GLuint a, b, c, d;
+                if (shared) {
+                    a = GLuint(j * nx + i);
+                    b = GLuint(a + nx);
+                    c = a + 1;
+                    d = b + 1;
+                } else {
+                    a = this->add_vertex(data, i,     j,     quad);
+                    b = this->add_vertex(data, i,     j + 1, quad);
+                    c = this->add_vertex(data, i + 1, j,     quad);
+                    d = this->add_vertex(data, i + 1, j + 1, quad);
+                }
+                const GLuint triangles[] = { a, b, c, c, b, d };
+                data.indices.insert(data.indices.end(),
+                                    triangles, triangles + 6);
+            }
+        }
+        data.end_batch();
+    }
+
+    GLuint
+    elevation_grid_builder::
+    add_vertex(openvrml::gl::local::geometry_data & data,
+               const size_t i,
+               const size_t j,
+               const size_t quad) const
+    {
+        using openvrml::gl::viewer;
+        using openvrml::make_vec2f;
+        using openvrml::make_vec3f;
+
+        const size_t k = j * this->x_dimension_ + i;
+
+        openvrml::vec3f normal;
+        if (this->mask_ & viewer::mask_normal_per_vertex) {
+            normal = (k < this->normal_.size())
+                   ? this->normal_[k]
+                   : elevationVertexNormal(int(i), int(j),
+                                           int(this->x_dimension_),
+                                           int(this->z_dimension_),
+                                           this->x_spacing_,
+                                           this->z_spacing_,
+                                           this->height_.begin() + k);
+        } else {
+            normal = (quad < this->normal_.size())
+                   ? this->normal_[quad]
+                   : this->quad_normal(quad);
+        }
+
+        const size_t color_index =
+            (this->mask_ & viewer::mask_color_per_vertex) ? k : quad;
+        const openvrml::color color = (color_index < this->color_.size())
+                                    ? this->color_[color_index]
+                                    : openvrml::make_color(1.0, 1.0, 1.0);
+
+        const openvrml::vec2f tex_coord =
+            (k < this->tex_coord_.size())
+            ? this->tex_coord_[k]
+            : make_vec2f(float(i) / (this->x_dimension_ - 1),
+                         float(j) / (this->z_dimension_ - 1));
+
+        return data.add_vertex(make_vec3f(this->x_spacing_ * i,
+                                          this->height_[k],
+                                          this->z_spacing_ * j),
+                               normal,
+                               color,
+                               tex_coord);
+    }
+
+    const openvrml::vec3f
+    elevation_grid_builder::quad_normal(const size_t quad) const
+    {
+        using openvrml::vec3f;
+        using openvrml::make_vec3f;
+
+        const size_t i = quad % (this->x_dimension_ - 1),
+                     j = quad / (this->x_dimension_ - 1);
+        const std::vector<float>::const_iterator h =
+            this->height_.begin() + j * this->x_dimension_ + i;
+        const vec3f vx = make_vec3f(this->x_spacing_, *(h + 1) - *h, 0.0);
+        const vec3f vz = make_vec3f(0.0,
+                                    *(h + this->x_dimension_) - *h,
+                                    this->z_spacing_);
+        return vz * vx;
+    }
 }
 
 
 /**
- * @brief Insert an elevation grid into a display list.
+ * @brief Insert an elevation grid.
  *
  * @param[in] node          the @c geometry_node corresponding to the elevation
  *                          grid.
@@ -1846,732 +2008,37 @@ do_insert_elevation_grid(const geometry_node & node,
                          const std::vector<vec3f> & normal,
                          const std::vector<vec2f> & texCoord)
 {
-    const list_map_t::const_iterator list = this->list_map_.find(&node);
-    if (list != this->list_map_.end()) {
-        glCallList(list->second);
-        return;
-    }
-
-    int32 i, j;
-    float x, z;
-
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList( glid, GL_COMPILE_AND_EXECUTE );
-    }
-
-    this->begin_geometry();
-
-    // Face orientation & culling
-    glFrontFace((mask & mask_ccw) ? GL_CCW : GL_CW);
-    if (!(mask & mask_solid)) { glDisable(GL_CULL_FACE); }
-
-    std::vector<float>::const_iterator h = height.begin();
-    std::vector<openvrml::color>::const_iterator c = color.begin();
-    std::vector<vec3f>::const_iterator n = normal.begin();
-    std::vector<vec2f>::const_iterator tc = texCoord.begin();
-
-    // x varies fastest
-    for (j = 0; j < zDimension - 1; ++j) {
-        float s0, s1, t0 = 0.0, t1 = 0.0;
-
-        z = zSpacing * j;
-        if (texCoord.empty()) {
-            t0 = float(j)     / (zDimension - 1);
-            t1 = float(j + 1) / (zDimension - 1);
-        }
-
-        glBegin(GL_QUAD_STRIP);
-
-        for (i = 0; i < xDimension; ++i) {
-            x = xSpacing * i;
-
-            if (!color.empty() && ((mask & mask_color_per_vertex)
-                                    || (i < xDimension - 1))) {
-                glColor3fv(&(*c)[0]);
-            }
-
-            if (!normal.empty() && ((mask & mask_normal_per_vertex)
-                                    || (i < xDimension - 1))) {
-                glNormal3fv(&(*n)[0]);
-            } else if (normal.empty()) {
-                if (mask & mask_normal_per_vertex) {
-                    const vec3f N =
-                            elevationVertexNormal(i, j,
-                                                  xDimension, zDimension,
-                                                  xSpacing, zSpacing,
-                                                  h);
-                    glNormal3fv(&N[0]);
-                } else if (i < xDimension - 1) {
-                    //
-                    // Normal per face.
-                    //
-                    const vec3f vx = make_vec3f(xSpacing, *(h + 1) - *h, 0.0);
-                    const vec3f vz = make_vec3f(0.0,
-                                                *(h + xDimension) - *h,
-                                                zSpacing);
-                    glNormal3fv(&(vx * vz)[0]);
-                }
-            }
-
-            if (!texCoord.empty()) {
-                s0 = tc->x();
-                t0 = tc->y();
-                s1 = (tc + xDimension * 2)->x();
-                t1 = (tc + xDimension * 2)->y();
-                ++tc;
-            } else {
-                s0 = s1 = float(i) / (xDimension - 1);
-            }
-
-            glTexCoord2f(s0, t0);
-            glVertex3f(x, *h, z);
-
-            // Vertex from next row
-            if (!color.empty() && (mask & mask_color_per_vertex)) {
-                glColor3fv(&(*(c + xDimension))[0]);
-            }
-
-            if (mask & mask_normal_per_vertex) {
-                if (!normal.empty()) {
-                    glNormal3fv(&(*(n + xDimension))[0]);
-                } else {
-                    const vec3f N =
-                            elevationVertexNormal(i, j + 1,
-                                                  xDimension, zDimension,
-                                                  xSpacing, zSpacing,
-                                                  h + xDimension);
-                    glNormal3fv(&N[0]);
-                }
-            }
-
-            glTexCoord2f(s1, t1);
-            glVertex3f(x, *(h + xDimension), z + zSpacing);
-
-            ++h;
-            if (!color.empty()) { ++c; }
-            if (!normal.empty()) { ++n; }
-        }
-
-        glEnd();
-    }
-
-    this->end_geometry();
-    if (glid) {
-        glEndList();
-        this->list_map_.insert(list_map_t::value_type(&node, glid));
-    }
-}
-
-
-namespace {
-
-    // Extrusion cap tessellation for non-convex shapes
-
-    struct OPENVRML_GL_LOCAL TessExtrusion {
-        const float * c; // coordinates array [nVerts * 3]
-        const float * crossSection; // crossSection coordinates [nCrossSection * 2]
-        float tcDeltaU, tcDeltaV;
-        float tcScaleU, tcScaleV;
-        size_t vOffset;
-        openvrml::vec3f N; // Normal
-
-        TessExtrusion(const float * c, const float * crossSection,
-                      float tcDeltaU, float tcDeltaV,
-                      float tcScaleU, float tcScaleV,
-                      size_t vOffset, const openvrml::vec3f & N);
-    };
-
-    TessExtrusion::TessExtrusion(const float * const c,
-                                 const float * const crossSection,
-                                 const float tcDeltaU,
-                                 const float tcDeltaV,
-                                 const float tcScaleU,
-                                 const float tcScaleV,
-                                 const size_t vOffset,
-                                 const openvrml::vec3f & N):
-        c(c),
-        crossSection(crossSection),
-        tcDeltaU(tcDeltaU),
-        tcDeltaV(tcDeltaV),
-        tcScaleU(tcScaleU),
-        tcScaleV(tcScaleV),
-        vOffset(vOffset),
-        N(N)
-    {}
-}
+    if (this->draw_retained_geometry(node)) { return; }
 
-extern "C" {
-    /**
-     * @internal
-     *
-     * @brief Tesselator callback.
-     *
-     * As the type of callback functions given to OpenGL, this type must have
-     * C linkage.
-     */
-# ifdef HAVE_VARARGS_GLU_TESSCB
-    typedef GLvoid (OPENVRML_GL_CALLBACK_* TessCB)(...);
-# else
-    typedef GLvoid (OPENVRML_GL_CALLBACK_* TessCB)();
-# endif
+    using local::geometry_data;
+    geometry_data data(geometry_data::normal_attribute
+                       | (color.empty() ? 0 : geometry_data::color_attribute)
+                       | geometry_data::tex_coord_attribute,
+                       face_flags(mask));
 
-    /**
-     * @internal
-     */
-    void OPENVRML_GL_CALLBACK_ tessExtrusionBegin(const GLenum type,
-                                                  void * const pdata)
-    {
-        const TessExtrusion & p = *static_cast<TessExtrusion *>(pdata);
-        glBegin(type);
-        glNormal3fv(&p.N[0]);
+    if (xDimension > 1 && zDimension > 1
+        && height.size() >= size_t(xDimension) * size_t(zDimension)) {
+        const elevation_grid_builder builder(mask,
+                                             height,
+                                             size_t(xDimension),
+                                             size_t(zDimension),
+                                             xSpacing,
+                                             zSpacing,
+                                             color,
+                                             normal,
+                                             texCoord);
+        builder.build(data);
     }
 
-    /**
-     * @internal
-     */
-    void OPENVRML_GL_CALLBACK_ tessExtrusionVertex(void * const vdata,
-                                                   void * const pdata)
-    {
-        const size_t j = *static_cast<size_t *>(vdata);
-        const TessExtrusion & p = *static_cast<TessExtrusion *>(pdata);
-
-        glTexCoord2f((p.crossSection[2 * j] - p.tcDeltaU) * p.tcScaleU,
-                     (p.crossSection[2 * j + 1] - p.tcDeltaV) * p.tcScaleV);
-        glVertex3fv(&(p.c[3 * (j + p.vOffset)]));
-    }
+    this->insert_geometry(node, data);
 }
 
-namespace {
-
-    OPENVRML_GL_LOCAL void
-    insertExtrusionCaps(GLUtesselator & tesselator,
-                        const unsigned int mask,
-                        const size_t nSpine,
-                        const std::vector<openvrml::vec3f> & c,
-                        const std::vector<openvrml::vec2f> & cs)
-    {
-        using std::vector;
-        using openvrml::vec2f;
-        using openvrml::vec3f;
-        using openvrml::gl::viewer;
-
-        // Determine x,z ranges for top & bottom tex coords
-        float xz[4] = { cs[0].x(), cs[0].x(), cs[0].y(), cs[0].y() };
-        vector<vec2f>::const_iterator csp = cs.begin();
-        for (vector<vec2f>::size_type nn = 1; nn < cs.size(); ++nn, ++csp) {
-            if (csp->x() < xz[0]) {
-                xz[0] = csp->x();
-            } else if (csp->x() > xz[1]) {
-                xz[1] = csp->x();
-            }
-            if (csp->y() < xz[2]) {
-                xz[2] = csp->y();
-            } else if (csp->y() > xz[3]) {
-                xz[3] = csp->y();
-            }
-        }
-
-        float dx = xz[1] - xz[0];
-        float dz = xz[3] - xz[2];
-        if (!fequal(dx, 0.0f)) { dx = float(1.0 / dx); }
-        if (!fequal(dz, 0.0f)) { dz = float(1.0 / dz); }
-
-        // If geometry is in dlists, should just always use the tesselator...
-
-        const bool equalEndpts = cs.front() == cs.back();
-
-        if (!(mask & viewer::mask_convex)) {
-            gluTessCallback(&tesselator, GLU_TESS_BEGIN_DATA,
-                            reinterpret_cast<TessCB>(tessExtrusionBegin));
-            gluTessCallback(&tesselator, GLU_TESS_VERTEX_DATA,
-                            reinterpret_cast<TessCB>(tessExtrusionVertex));
-            gluTessCallback(&tesselator, GLU_TESS_END,
-                            reinterpret_cast<TessCB>(glEnd));
-
-            if (mask & viewer::mask_bottom) {
-                TessExtrusion bottom(&c[0][0],
-                                     &cs[0][0],
-                                     xz[0], xz[2],
-                                     dx, dz,
-                                     0,
-                                     indexFaceNormal(0, 1, 2, c));
-
-                gluTessBeginPolygon(&tesselator, &bottom);
-                gluTessBeginContour(&tesselator);
-                GLdouble v[3];
-                // Mesa tesselator doesn;t like closed polys
-                size_t j = equalEndpts ? cs.size() - 2 : cs.size() - 1;
-                for (; j > 0; --j) {
-                    const size_t index = j - 1;
-                    v[0] = c[index].x();
-                    v[1] = c[index].y();
-                    v[2] = c[index].z();
-                    gluTessVertex(&tesselator,
-                                  v,
-                                  const_cast<GLvoid *>(
-                                      static_cast<const GLvoid *>(&index)));
-                }
-                gluTessEndContour(&tesselator);
-                gluTessEndPolygon(&tesselator);
-            }
-
-            if (mask & viewer::mask_top) {
-                size_t n = (nSpine - 1) * cs.size();
-                TessExtrusion top(&c[0][0],
-                                  &cs[0][0],
-                                  xz[0], xz[2],
-                                  dx, dz,
-                                  n,
-                                  indexFaceNormal(n + 2, n + 1, n, c));
-
-                gluTessBeginPolygon(&tesselator, &top);
-                gluTessBeginContour(&tesselator);
-
-                GLdouble v[3];
-                // Mesa tesselator doesn;t like closed polys
-                size_t j = equalEndpts ? 1ul : 0ul;
-                for (; j < cs.size(); ++j) {
-                    v[0] = c[j + n].x();
-                    v[1] = c[j + n].y();
-                    v[2] = c[j + n].z();
-                    gluTessVertex(&tesselator, v, &j);
-                }
-                gluTessEndContour(&tesselator);
-                gluTessEndPolygon(&tesselator);
-            }
-        } else {
-            //
-            // Convex (or not GLU1.2 ...)
-            //
-            vec3f N; // Normal
-
-            if (mask & viewer::mask_bottom) {
-                glBegin(GL_POLYGON);
-                N = indexFaceNormal(0, 1, 2, c);
-                glNormal3fv(&N[0]);
-
-                for (size_t j = cs.size(); j > 0; --j) {
-                    const size_t index = j - 1;
-                    glTexCoord2f((cs[index].x() - xz[0]) * dx,
-                                 (cs[index].y() - xz[2]) * dz);
-                    glVertex3fv(&c[index][0]);
-                }
-                glEnd();
-            }
-
-            if (mask & viewer::mask_top) {
-                size_t n = (nSpine - 1) * cs.size();
-                glBegin(GL_POLYGON);
-                N = indexFaceNormal(n + 2, n + 1, n, c);
-                glNormal3fv(&N[0]);
-
-                for (size_t j = 0; j < cs.size(); ++j) {
-                    glTexCoord2f((cs[j].x() - xz[0]) * dx,
-                                 (cs[j].y() - xz[2]) * dz);
-                    glVertex3fv(&c[j + n][0]);
-                }
-                glEnd();
-            }
-        }
-    }
-
-    /**
-     * @brief Get the length of an Extrusion spine.
-     *
-     * The length of the spine is used in computing texture coordinates for an
-     * Extrusion.  In order to determine the texture coordinates at a given
-     * point on the Extrusion cross-section, the distance from the start of
-     * the spine is divided by its total length.  As such, this function
-     * returns 1.0 if the length of the spine is 0 (to avoid dividing by
-     * zero).
-     *
-     * @param[in] spine Extrusion spine.
-     *
-     * @return the length of the Extrusion spine described by @p spine; or 1.0
-     *         if the length is 0.
-     */
-    OPENVRML_GL_LOCAL
-    float get_spine_length(const std::vector<openvrml::vec3f> & spine)
-    {
-        using std::vector;
-        using openvrml::vec3f;
-
-        float result = 0.0;
-        for (vector<vec3f>::const_iterator point = spine.begin();
-             point < spine.end() - 1;
-             ++point) {
-            result += (*(point + 1) - *point).length();
-        }
-        return result == 0.0f ? 1.0f : result;
-    }
-
-    /**
-     * @brief Get the length of an Extrusion cross-section.
-     *
-     * The length of the cross-section is used in computing texture
-     * coordinates for an Extrusion.  In order to determine the texture
-     * coordinates at a given point on the Extrusion cross-section, the
-     * distance from the start of the cross-section is divided by its total
-     * length.  As such, this function returns 1.0 if the length of the
-     * cross-section is 0 (to avoid dividing by zero).
-     *
-     * @param[in] cross_section Extrusion cross-section.
-     *
-     * @return the length of the Extrusion cross-section described by
-     *         @p cross_section; or 1.0 if the length is 0.
-     */
-    OPENVRML_GL_LOCAL
-    float
-    get_cross_section_length(
-        const std::vector<openvrml::vec2f> & cross_section)
-    {
-        using std::vector;
-        using openvrml::vec2f;
-
-        float result = 0.0;
-        for (vector<vec2f>::const_iterator point = cross_section.begin();
-             point != cross_section.end() - 1;
-             ++point) {
-            result += (*(point + 1) - *point).length();
-        }
-        return result == 0.0f ? 1.0f : result;
-    }
-
-    /**
-     * @brief Compute the <var>y</var>-axis of the spine-aligned cross-section
-     *        plane.
-     *
-     * @param[in] point an arbitrary point in the extrusion spine.
-     * @param[in] first the first point in the extrusion spine.
-     * @param[in] last  the last point in the extrusion spine.
-     *
-     * @return the <var>y</var>-axis of the spine-aligned cross-section plane
-     *         at @p point.
-     */
-    OPENVRML_GL_LOCAL
-    const openvrml::vec3f
-    compute_scp_y_axis(
-        const std::vector<openvrml::vec3f>::const_iterator & point,
-        const std::vector<openvrml::vec3f>::const_iterator & first,
-        const std::vector<openvrml::vec3f>::const_iterator & last,
-        const openvrml::vec3f & prev)
-    {
-        if (point != first && point != last) {
-            if (*point == *(point - 1)) { return prev; }
-            return (*(point + 1) - *(point - 1)).normalize();
-        }
-
-        //
-        // From here on, we're dealing with the first or last point.
-        //
-        const bool spine_closed = (*first == *last);
-
-        if (spine_closed) {
-            return (*(first + 1) - *(last - 1)).normalize();
-        }
-
-        //
-        // The spine is not closed.
-        //
-        if (point == first) {
-            return (*(first + 1) - *first).normalize();
-        }
-
-        assert(point == last);
-        assert(last - first > 0);
-        return (*last - *(last - 1)).normalize();
-    }
-
-    /**
-     * @brief Compute the <var>z</var>-axis of the spine-aligned cross-section
-     *        plane.
-     *
-     * @param[in] point an arbitrary point in the extrusion spine.
-     * @param[in] first the first point in the extrusion spine.
-     * @param[in] last  the last point in the extrusion spine.
-     * @param[in] prev  the <var>z</var>-axis of the spine-aligned
-     *                  cross-section plane for the previous spine point.
-     *
-     * @return the <var>z</var>axis of the spine-aligned cross-section plane
-     *         at @p point.
-     */
-    OPENVRML_GL_LOCAL
-    const openvrml::vec3f
-    compute_scp_z_axis(
-        const std::vector<openvrml::vec3f>::const_iterator & point,
-        const std::vector<openvrml::vec3f>::const_iterator & first,
-        const std::vector<openvrml::vec3f>::const_iterator & last,
-        const openvrml::vec3f & prev)
-    {
-        using openvrml::vec3f;
-        using openvrml::make_vec3f;
-
-        vec3f z0, z1;
-
-        if (point != first && point != last) {
-            if (*point == *(point - 1)) { return prev; }
-            z0 = *(point + 1) - *point;
-            z1 = *(point - 1) - *point;
-        } else {
-
-            //
-            // From here on, we're dealing with the first or last point.
-            //
-            const bool spine_closed = (*first == *last);
-
-            if (spine_closed) {
-                z0 = *(first + 1) - *first;
-                z1 = *(last - 1) - *first;
-            } else {
-                if (last - first == 1) { return prev; }
-                if (point == first) {
-                    //
-                    // The spine is not closed.
-                    //
-                    z0 = *(first + 2) - *(first + 1);
-                    z1 = *first - *(first + 1);
-                } else {
-                    assert(point == last);
-                    assert(last - first > 0);
-                    z0 = *(last - 2) - *(last - 1);
-                    z1 = *last - *(last - 1);
-                }
-            }
-        }
-
-        if (fequal(z0.dot(z1), 1.0f)) { return prev; }
-
-        const vec3f z = (z0 * z1).normalize();
-        if (z == make_vec3f(0.0, 0.0, 0.0)) { return prev; }
-
-        return (z.dot(prev) < 0) ? -z : z;
-    }
-
-    /**
-     * @brief Determine if the extrusion spine points are collinear.
-     *
-     * If this function returns @c true, @p scp_x, @p scp_y, and @p scp_z are
-     * the axes of the spine-aligned cross-section plane that should be used
-     * for the extent of the extrusion.
-     *
-     * @param[in] spine     the extrusion spine.
-     * @param[out] scp_x    the initial spine-aligned cross-section plane
-     *                      <var>x</var>-axis.
-     * @param[out] scp_y    the initial spine-aligned cross-section plane
-     *                      <var>y</var>-axis.
-     * @param[out] scp_z    the initial spine-aligned cross-section plane
-     *                      <var>z</var>-axis.
-     *
-     * @return @c true if the points in @p spine are collinear; @c false
-     *         otherwise.
-     */
-    OPENVRML_GL_LOCAL
-    bool
-    check_spine_points_collinear(const std::vector<openvrml::vec3f> & spine,
-                                 openvrml::vec3f & scp_x,
-                                 openvrml::vec3f & scp_y,
-                                 openvrml::vec3f & scp_z)
-    {
-        using std::vector;
-        using openvrml::mat4f;
-        using openvrml::make_rotation_mat4f;
-        using openvrml::make_scale_mat4f;
-        using openvrml::rotation;
-        using openvrml::make_rotation;
-        using openvrml::vec3f;
-        using openvrml::make_vec3f;
-
-        //
-        // First, iterate over the spine points until either the y- or z-axis
-        // for the spine-aligned cross-section plane (SCP) is valid (i.e.,
-        // nonzero).  We bail out of the loop as soon as we get a valid y- or
-        // z-axis; because that means we've hit the first noncollinear point.
-        // If the points are all collinear, we won't have a valid z-axis (or
-        // y-axis) when we're done.
-        //
-        static const vec3f zero = make_vec3f();
-        scp_y = zero;
-        scp_z = zero;
-        vec3f prev_scp_y = zero, prev_scp_z = zero;
-        for (vector<vec3f>::const_iterator point = spine.begin();
-             point < spine.end() && (prev_scp_y == zero || prev_scp_z == zero);
-             ++point) {
-            if (prev_scp_y == zero) {
-                scp_y = compute_scp_y_axis(point,
-                                           spine.begin(),
-                                           spine.end() - 1,
-                                           prev_scp_y);
-                if (scp_y != zero) { prev_scp_y = scp_y; }
-            }
-            if (prev_scp_z == zero) {
-                scp_z = compute_scp_z_axis(point,
-                                           spine.begin(),
-                                           spine.end() - 1,
-                                           prev_scp_z);
-                if (scp_z != zero) { prev_scp_z = scp_z; }
-            }
-        }
-
-        //
-        // If all the points are coincident, prev_scp_y will be invalid
-        // (zero).  Set it to (0 1 0).
-        //
-        if (prev_scp_y == zero) { prev_scp_y = make_vec3f(0.0, 1.0, 0.0); }
-
-        //
-        // If all the points are collinear, prev_scp_z will be invalid (zero).
-        // Default it to (0 0 1); then, per 6.18.3 of VRML97:
-        //
-        //   If the entire spine is collinear, the SCP is computed by finding
-        //   the rotation of a vector along the positive Y-axis (v1) to the
-        //   vector formed by the spine points (v2).  The Y=0 plane is then
-        //   rotated by this value.
-        //
-        bool spine_points_collinear = false;
-        if (prev_scp_z == zero) {
-            spine_points_collinear = true;
-            prev_scp_z = make_vec3f(0.0, 0.0, 1.0);
-            if (prev_scp_y != make_vec3f(0.0, 1.0, 0.0)) {
-                const mat4f rot_mat =
-                    make_rotation_mat4f(
-                        make_rotation(make_vec3f(0.0, 1.0, 0.0),
-                                      prev_scp_y));
-                prev_scp_z *= rot_mat;
-            }
-        }
-
-        if (spine_points_collinear) {
-            scp_y = prev_scp_y;
-            scp_z = prev_scp_z;
-            scp_x = (scp_y * scp_z).normalize();
-        }
-
-        return spine_points_collinear;
-    }
-
-    /**
-     * @brief Compute the coordinates and texture coordinates for an extrusion.
-     *
-     * @param[in] cross_section
-     * @param[in] spine
-     * @param[in] scale
-     * @param[in] orientation
-     * @param[out] coord
-     * @param[out] texcoord
-     */
-    OPENVRML_GL_LOCAL void
-    compute_extrusion_coords_(
-        const std::vector<openvrml::vec2f> & cross_section,
-        const std::vector<openvrml::vec3f> & spine,
-        const std::vector<openvrml::vec2f> & scale,
-        const std::vector<openvrml::rotation> & orientation,
-        std::vector<openvrml::vec3f> & coord,
-        std::vector<openvrml::vec2f> & texcoord)
-    {
-        using std::vector;
-        using openvrml::rotation;
-        using openvrml::vec2f;
-        using openvrml::make_vec2f;
-        using openvrml::vec3f;
-        using openvrml::make_vec3f;
-        using openvrml::mat4f;
-        using openvrml::make_mat4f;
-
-        coord.resize(spine.size() * cross_section.size());
-        texcoord.resize(spine.size() * cross_section.size());
-
-        //
-        // Check if the spine points are collinear.  If they are collinear,
-        // the spine-aligned cross-section plane computed for the first point
-        // will be used for the entire extrusion.
-        //
-        vec3f scp_x = make_vec3f(), scp_y = make_vec3f(), scp_z = make_vec3f();
-        const bool spine_points_collinear =
-            check_spine_points_collinear(spine, scp_x, scp_y, scp_z);
-
-        const float spine_length = get_spine_length(spine);
-        const float cross_section_length =
-            get_cross_section_length(cross_section);
-        float current_spine_length = 0.0;
-        for (vector<vec3f>::const_iterator spine_point = spine.begin();
-             spine_point != spine.end();
-             ++spine_point) {
-            if (!spine_points_collinear) {
-                scp_y = compute_scp_y_axis(spine_point,
-                                           spine.begin(),
-                                           spine.end() - 1,
-                                           scp_y);
-                scp_z = compute_scp_z_axis(spine_point,
-                                           spine.begin(),
-                                           spine.end() - 1,
-                                           scp_z);
-                scp_x = (scp_y * scp_z).normalize();
-            }
-
-            mat4f mat =
-                make_mat4f(
-                    scp_x.x(),        scp_x.y(),        scp_x.z(),        0.0,
-                    scp_y.x(),        scp_y.y(),        scp_y.z(),        0.0,
-                    scp_z.x(),        scp_z.y(),        scp_z.z(),        0.0,
-                    spine_point->x(), spine_point->y(), spine_point->z(), 1.0);
-
-            const vector<vec3f>::size_type spine_index =
-                static_cast<std::size_t>(std::distance(spine.begin(),
-                                                       spine_point));
-
-            if (!orientation.empty()) {
-                const vector<rotation>::size_type index =
-                    spine_index < orientation.size()
-                    ? spine_index
-                    : orientation.size() - 1;
-                mat = make_rotation_mat4f(orientation[index]) * mat;
-            }
-
-            if (!scale.empty()) {
-                const vector<vec2f>::size_type index =
-                    spine_index < scale.size()
-                    ? spine_index
-                    : scale.size() - 1;
-                mat = (make_scale_mat4f(make_vec3f(scale[index].x(),
-                                                   1.0,
-                                                   scale[index].y()))
-                       * mat);
-            }
-
-            float current_cross_section_length = 0.0;
-            for (vector<vec2f>::size_type i = 0;
-                 i < cross_section.size();
-                 ++i) {
-                vec3f cross_section_point = make_vec3f(cross_section[i].x(),
-                                                       0.0,
-                                                       cross_section[i].y());
-                cross_section_point *= mat;
-                const size_t coord_index =
-                    spine_index * cross_section.size() + i;
-                coord[coord_index] = cross_section_point;
-                texcoord[coord_index] =
-                    make_vec2f(
-                        current_cross_section_length / cross_section_length,
-                        current_spine_length / spine_length);
-
-                if (i < cross_section.size() - 1) {
-                    current_cross_section_length +=
-                        (cross_section[i + 1] - cross_section[i]).length();
-                }
-            }
-            if (spine_point < spine.end() - 1) {
-                current_spine_length +=
-                    (*(spine_point + 1) - *spine_point).length();
-            }
-        }
-    }
-}
 
 /**
- * @brief Insert an extrusion into a display list.
+ * @brief Insert an extrusion.
+ *
+ * The extrusion is compiled with @c make_extrusion_mesh and drawn as a
+ * mesh.
  *
  * @param[in] n             the @c geometry_node corresponding to the extrusion.
  * @param[in] mask
@@ -2589,72 +2056,14 @@ do_insert_extrusion(const geometry_node & n,
                     const std::vector<openvrml::rotation> & orientation,
                     const std::vector<vec2f> & scale)
 {
-    const list_map_t::const_iterator list = this->list_map_.find(&n);
-    if (list != this->list_map_.end()) {
-        glCallList(list->second);
-        return;
-    }
-
-    using std::vector;
-    vector<vec3f> c(crossSection.size() * spine.size());
-    vector<vec2f> tc(crossSection.size() * spine.size());
-
-    compute_extrusion_coords_(crossSection, spine, scale, orientation, c, tc);
-
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
-
-    this->begin_geometry();
-
-    // Face orientation & culling
-    glFrontFace((mask & mask_ccw) ? GL_CCW : GL_CW);
-    if (!(mask & mask_solid)) { glDisable(GL_CULL_FACE); }
-
-    // Handle creaseAngle, correct normals, ...
-    size_t section = 0;
-    for (vector<vec3f>::size_type i = 0;
-         i < spine.size() - 1;
-         ++i, section += crossSection.size()) {
-        glBegin(GL_QUAD_STRIP);
-        for (size_t j = 0; j < crossSection.size(); ++j) {
-            // Compute normals
-            vec3f v1 = j < crossSection.size() - 1
-                     ? c[section + j + 1] - c[section + j]
-                     : c[section + j] - c[section + j - 1];
-            vec3f v2 = c[section + j + crossSection.size()] - c[section + j];
-            v1 *= v2;
-            glNormal3fv(&v1[0]);
-
-            glTexCoord2fv(&tc[section + j + crossSection.size()][0]);
-            glVertex3fv(&c[section + j + crossSection.size()][0]);
-            glTexCoord2fv(&tc[section + j][0]);
-            glVertex3fv(&c[section + j][0]);
-        }
-        glEnd();
-    }
-
-    // Draw caps. Convex can only impact the caps of an extrusion.
-    if (mask & (mask_bottom | mask_top)) {
-        insertExtrusionCaps(*this->tesselator,
-                            mask,
-                            spine.size(),
-                            c,
-                            crossSection);
-    }
+    if (this->draw_retained_geometry(n)) { return; }
 
-    this->end_geometry();
-    if (glid) {
-        glEndList();
-        this->list_map_.insert(list_map_t::value_type(&n, glid));
-    }
+    this->do_insert_mesh(n, make_extrusion_mesh(mask, spine, crossSection,
+                                                orientation, scale));
 }
 
 /**
- * @brief Insert a line set into a display list.
+ * @brief Insert a line set.
  *
  * @param[in] n                 the @c geometry_node corresponding to the line
  *                              set.
@@ -2673,79 +2082,62 @@ openvrml::gl::viewer::do_insert_line_set(const geometry_node & n,
                                          const std::vector<color> & color,
                                          const std::vector<int32> & colorIndex)
 {
-    const list_map_t::const_iterator list = this->list_map_.find(&n);
-    if (list != this->list_map_.end()) {
-        glCallList(list->second);
-        return;
-    }
-
-    GLuint glid = 0;
-
-    if (coord.size() < 2) { return; }
+    if (this->draw_retained_geometry(n)) { return; }
 
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
-
-    this->begin_geometry();
+    using local::geometry_data;
 
     // Lighting, texturing don't apply to line sets
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
-    const bool color_per_face = (!color.empty() && !colorPerVertex);
-    if (color_per_face) { glShadeModel(GL_FLAT); }
-
-    glBegin(GL_LINE_STRIP);
-    if (!color.empty() && color_per_face) {
-        const size_t color_index = !colorIndex.empty()
-                                 ? static_cast<std::size_t>(colorIndex.front())
-                                 : 0ul;
-        glColor3fv(&color[color_index][0]);
-    }
-
-    size_t nl = 0;
-    for (size_t i = 0; i < coordIndex.size(); ++i) {
-        if (coordIndex[i] == -1) {
-            glEnd();
-            glBegin(GL_LINE_STRIP);
-            ++nl;
-            if (i < coordIndex.size() - 1 && color_per_face) {
-                const int32 index = !colorIndex.empty()
-                                  ? int32(colorIndex[nl])
-                                  : int32(nl);
-                if (size_t(index) < color.size()) {
-                    glColor3fv(&color[static_cast<std::size_t>(index)][0]);
-                }
+    geometry_data data(color.empty() ? 0 : geometry_data::color_attribute,
+                       geometry_data::unlit_flag);
+
+    if (coord.size() >= 2) {
+        const bool color_per_face = (!color.empty() && !colorPerVertex);
+        const vec3f no_normal = make_vec3f();
+        const vec2f no_tex_coord = make_vec2f();
+        openvrml::color current_color = make_color(1.0, 1.0, 1.0);
+
+        data.begin_batch(GL_LINES);
+
+        size_t nl = 0;
+        bool line_start = true;
+        for (size_t i = 0; i < coordIndex.size(); ++i) {
+            if (coordIndex[i] == -1) {
+                ++nl;
+                line_start = true;
+                continue;
             }
-        } else {
-            if (!color.empty() && colorPerVertex) {
-                const int32 index = !colorIndex.empty()
-                                  ? colorIndex[i]
-                                  : coordIndex[i];
+            if (!(size_t(coordIndex[i]) < coord.size())) { continue; }
+
+            if (!color.empty()) {
+                const int32 index = color_per_face
+                    ? (nl < colorIndex.size() ? colorIndex[nl] : int32(nl))
+                    : (i < colorIndex.size() ? colorIndex[i] : coordIndex[i]);
                 if (size_t(index) < color.size()) {
-                    glColor3fv(&color[static_cast<std::size_t>(index)][0]);
+                    current_color = color[static_cast<std::size_t>(index)];
                 }
             }
-            if (size_t(coordIndex[i]) < coord.size()) {
-                glVertex3fv(
-                    &coord[static_cast<std::size_t>(coordIndex[i])][0]);
+
+            const GLuint vertex =
+                data.add_vertex(
+                    coord[static_cast<std::size_t>(coordIndex[i])],
+                    no_normal,
+                    current_color,
+                    no_tex_coord);
+            if (!line_start) {
+                data.indices.push_back(vertex - 1);
+                data.indices.push_back(vertex);
             }
+            line_start = false;
         }
-    }
-
-    glEnd();
-
-    this->end_geometry();
 
-    if (glid) {
-        glEndList();
-        this->list_map_.insert(list_map_t::value_type(&n, glid));
+        data.end_batch();
     }
+
+    this->insert_geometry(n, data);
 }
 
 /**
- * @brief Insert a point set into a display list.
+ * @brief Insert a point set.
  *
  * @param[in] n         the @c geometry_node corresponding to the point set.
  * @param[in] coord     points.
@@ -2756,294 +2148,35 @@ openvrml::gl::viewer::do_insert_point_set(const geometry_node & n,
                                           const std::vector<vec3f> & coord,
                                           const std::vector<color> & color)
 {
-    const list_map_t::const_iterator list = this->list_map_.find(&n);
-    if (list != this->list_map_.end()) {
-        glCallList(list->second);
-        return;
-    }
-
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
+    if (this->draw_retained_geometry(n)) { return; }
 
-    this->begin_geometry();
+    using local::geometry_data;
 
     // Lighting, texturing don't apply to points
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
+    geometry_data data(color.empty() ? 0 : geometry_data::color_attribute,
+                       geometry_data::unlit_flag);
 
-    glBegin(GL_POINTS);
+    const vec3f no_normal = make_vec3f();
+    const vec2f no_tex_coord = make_vec2f();
+    openvrml::color current_color = make_color(1.0, 1.0, 1.0);
 
+    data.begin_batch(GL_POINTS);
     for (size_t i = 0; i < coord.size(); ++i) {
-        if (i < color.size()) { glColor3fv(&color[i][0]); }
-        glVertex3fv(&coord[i][0]);
-    }
-
-    glEnd();
-    this->end_geometry();
-    if (glid) {
-        glEndList();
-        this->list_map_.insert(list_map_t::value_type(&n, glid));
-    }
-}
-
-namespace {
-
-    OPENVRML_GL_LOCAL void computeBounds(size_t npoints,
-                                         const float * points,
-                                         float (&bounds)[6])
-    {
-        if (npoints == 0) {
-            std::fill(bounds, bounds + 6, 0.0f);
-        } else {
-            bounds[0] = bounds[1] = points[0]; // xmin, xmax
-            bounds[2] = bounds[3] = points[1]; // ymin, ymax
-            bounds[4] = bounds[5] = points[2]; // zmin, zmax
-
-            for (size_t i = 1; i < npoints; ++i) {
-                points += 3;
-                if (points[0] < bounds[0])      bounds[0] = points[0];
-                else if (points[0] > bounds[1]) bounds[1] = points[0];
-                if (points[1] < bounds[2])      bounds[2] = points[1];
-                else if (points[1] > bounds[3]) bounds[3] = points[1];
-                if (points[2] < bounds[4])      bounds[4] = points[2];
-                else if (points[2] > bounds[5]) bounds[5] = points[2];
-            }
-        }
-    }
-
-    OPENVRML_GL_LOCAL void texGenParams(float (&bounds)[6],  // xmin,xmax, ymin,ymax, zmin,zmax
-                                        int (&axes)[2],     // s, t
-                                        float (&params)[4]) // s0, 1/sSize, t0, 1/tSize
-    {
-        axes[0] = 0;
-        axes[1] = 1;
-        params[0] = params[1] = params[2] = params[3] = 0.0;
-
-        for (int nb = 0; nb < 3; ++nb) {
-            float db = bounds[2 * nb + 1] - bounds[2 * nb];
-            if (db > params[1]) {
-                axes[1] = axes[0];
-                axes[0] = nb;
-                params[2] = params[0];
-                params[3] = params[1];
-                params[0] = bounds[2 * nb];
-                params[1] = db;
-            } else if (db > params[3]) {
-                axes[1] = nb;
-                params[2] = bounds[2 * nb];
-                params[3] = db;
-            }
-        }
-
-        // If two of the dimensions are zero, give up.
-        if (fequal(params[1], 0.0f) || fequal(params[3], 0.0f)) { return; }
-
-        params[1] = float(1.0 / params[1]);
-        params[3] = float(1.0 / params[3]);
-    }
-
-    OPENVRML_GL_LOCAL void insertShellConvex(ShellData * const s)
-    {
-        using openvrml::vec3f;
-        using openvrml::gl::viewer;
-
-        vec3f N;
-        size_t i, nf = 0;                        // Number of faces
-
-        for (i = 0; i < s->coordIndex.size(); ++i) {
-            if (i == 0 || s->coordIndex[i] == -1) {
-                if (i > 0) { glEnd(); }
-                if (i == s->coordIndex.size() - 1) { break; }
-
-                glBegin(GL_POLYGON);
-
-                // Per-face attributes
-                const size_t color_index = (nf < s->colorIndex.size())
-                                         ? s->colorIndex[nf]
-                                         : nf;
-                if (color_index < s->color.size()
-                    && !(s->mask & viewer::mask_color_per_vertex)) {
-                    glColor3fv(&s->color[color_index][0]);
-                }
-
-                if (! (s->mask & viewer::mask_normal_per_vertex)) {
-                    size_t i1 = (i == 0)
-                           ? 0
-                           : i + 1;
-                    const size_t normal_index = (nf < s->normalIndex.size())
-                                              ? s->normalIndex[nf]
-                                              : nf;
-                    if (normal_index < s->normal.size()) {
-                        glNormal3fv(&s->normal[normal_index][0]);
-                    } else if (i < s->coordIndex.size() - 4
-                        && s->coordIndex[i1] >= 0
-                        && s->coordIndex[i1 + 1] >= 0
-                        && s->coordIndex[i1 + 2] >= 0) {
-                        N =
-                            indexFaceNormal(
-                                static_cast<std::size_t>(s->coordIndex[i1]),
-                                static_cast<std::size_t>(s->coordIndex[i1 + 1]),
-                                static_cast<std::size_t>(s->coordIndex[i1 + 2]),
-                                s->coord);
-
-                        // Flip normal if primitiv-orientation is clockwise
-                        if (!(s->mask & viewer::mask_ccw)) { N = -N; }
-                        glNormal3fv(&N[0]);
-                    }
-                }
-
-                ++nf;
-            }
-
-            if (s->coordIndex[i] >= 0) {
-                // Per-vertex attributes
-                const size_t color_index =
-                    static_cast<std::size_t>(
-                        (i < s->colorIndex.size()) ? s->colorIndex[i]
-                                                   : s->coordIndex[i]);
-                if (color_index < s->color.size()
-                    && (s->mask & viewer::mask_color_per_vertex)) {
-                    glColor3fv(&s->color[color_index][0]);
-                }
-
-                if (s->mask & viewer::mask_normal_per_vertex) {
-                    const size_t normal_index =
-                        static_cast<std::size_t>(
-                            (i < s->normalIndex.size()) ? s->normalIndex[i]
-                                                        : s->coordIndex[i]);
-                    if (normal_index < s->normal.size()) {
-                        glNormal3fv(&s->normal[normal_index][0]);
-                    } else {
-                        ; // Generate per-vertex normal here...
-                    }
-                }
-
-                const vec3f & v =
-                    s->coord[static_cast<std::size_t>(s->coordIndex[i])];
-                const size_t tex_coord_index =
-                    static_cast<std::size_t>(
-                        (i < s->texCoordIndex.size()) ? s->texCoordIndex[i]
-                                                      : s->coordIndex[i]);
-                if (tex_coord_index < s->texCoord.size()) {
-                    glTexCoord2fv(&s->texCoord[tex_coord_index][0]);
-                } else {
-                    float c0, c1;
-                    c0 = (v[static_cast<std::size_t>(s->texAxes[0])]
-                          - s->texParams[0])
-                        * s->texParams[1];
-                    c1 = (v[static_cast<std::size_t>(s->texAxes[1])]
-                          - s->texParams[2])
-                        * s->texParams[3];
-                    glTexCoord2f(c0, c1);
-                }
-
-                glVertex3fv(&v[0]);
-            }
-        }
-
-        // Watch out for no terminating -1 in face list
-        // two ways to break out:
-        //   i > 0 && i == coordIndex.size() - 1 && coordIndex[i] == -1
-        //   i == coordIndex.size()
-        //
-        if (i >= s->coordIndex.size()) {
-            if (s->coordIndex[i - 1] >= 0) { glEnd(); }
-        } else {
-            if (s->coordIndex[i] >= 0) { glEnd(); }
-        }
+        if (i < color.size()) { current_color = color[i]; }
+        data.indices.push_back(
+            data.add_vertex(coord[i], no_normal, current_color,
+                            no_tex_coord));
     }
+    data.end_batch();
 
-    OPENVRML_GL_LOCAL void
-    insertShellTess(GLUtesselator & tessobj,
-                    const std::vector<vertex_data> & vertices,
-                    const std::vector<openvrml::int32> & coord_index,
-                    const bool color_per_face,
-                    const std::vector<openvrml::color> & color,
-                    const std::vector<openvrml::int32> & color_index,
-                    const bool normal_per_face,
-                    const std::vector<openvrml::vec3f> & normal,
-                    const std::vector<openvrml::int32> & normal_index)
-    {
-        using std::vector;
-        gluTessCallback(&tessobj,
-                        GLU_TESS_BEGIN_DATA,
-                        reinterpret_cast<TessCB>(shell_tess_begin));
-        gluTessCallback(&tessobj,
-                        GLU_TESS_VERTEX,
-                        reinterpret_cast<TessCB>(shell_tess_vertex));
-        gluTessCallback(&tessobj,
-                        GLU_TESS_COMBINE_DATA,
-                        reinterpret_cast<TessCB>(shell_tess_combine));
-        gluTessCallback(&tessobj,
-                        GLU_TESS_END_DATA,
-                        reinterpret_cast<TessCB>(shell_tess_end));
-        gluTessCallback(&tessobj, GLU_TESS_ERROR,
-                        reinterpret_cast<TessCB>(tess_error));
-
-        shell_tess_user_data user_data;
-        if (color_per_face) {
-            if (!color.empty()) {
-                user_data.face_color = &color;
-            }
-            if (!color_index.empty()) {
-                user_data.face_color_index = &color_index;
-            }
-        }
-        if (normal_per_face) {
-            if (!normal.empty()) {
-                user_data.face_normal = &normal;
-            }
-            if (!normal_index.empty()) {
-                user_data.face_normal_index = &normal_index;
-            }
-        }
-
-        gluTessBeginPolygon(&tessobj, &user_data);
-        gluTessBeginContour(&tessobj);
-        for (vector<openvrml::int32>::size_type i = 0;
-             i < coord_index.size();
-             ++i) {
-            using openvrml::int32;
-            if (!(coord_index[i] < int32(vertices.size()))) {
-                //
-                // We've encountered an invalid coordinate index.  Advance to
-                // the next polygon.
-                //
-                while (coord_index[i + 1] != -1) { ++i; }
-            } else if (coord_index[i] != -1) {
-                gluTessVertex(
-                    &tessobj,
-                    const_cast<GLdouble *>(
-                        vertices[
-                            static_cast<std::size_t>(coord_index[i])].coord),
-                    &const_cast<vertex_data &>(
-                        vertices[
-                            static_cast<std::size_t>(coord_index[i])]));
-            } else {
-                gluTessEndContour(&tessobj);
-                gluTessEndPolygon(&tessobj);
-                if (i != coord_index.size() - 1) {
-                    gluTessBeginPolygon(&tessobj, &user_data);
-                    gluTessBeginContour(&tessobj);
-                }
-            }
-        }
-
-        // Watch out for no terminating -1 in face list
-        if (coord_index.back() != -1) {
-            gluTessEndContour(&tessobj);
-            gluTessEndPolygon(&tessobj);
-        }
-    }
+    this->insert_geometry(n, data);
 }
 
-
 /**
- * @brief Insert a shell into a display list.
+ * @brief Insert a shell.
+ *
+ * The shell is compiled to a @c compiled_mesh and inserted with
+ * @c #do_insert_mesh.
  *
  * @param[in] n                 the @c geometry_node corresponding to the shell.
  * @param[in] mask
@@ -3059,7 +2192,7 @@ namespace {
 void
 openvrml::gl::viewer::
 do_insert_shell(const geometry_node & n,
-                unsigned int mask,
+                const unsigned int mask,
                 const std::vector<vec3f> & coord,
                 const std::vector<int32> & coord_index,
                 const std::vector<color> & color,
@@ -3069,148 +2202,50 @@ do_insert_shell(const geometry_node & n,
                 const std::vector<vec2f> & tex_coord,
                 const std::vector<int32> & tex_coord_index)
 {
-    const list_map_t::const_iterator list = this->list_map_.find(&n);
-    if (list != this->list_map_.end()) {
-        glCallList(list->second);
-        return;
-    }
-
-    using std::vector;
-    if (coord_index.size() < 4) { return; } // 3 pts and a trailing -1
-
-    // Texture coordinate generation parameters.
-    int texAxes[2] = { 0, 1 };         // Map s,t to x,y,z
-    float texParams[4] = {};           // s0, 1/sSize, t0, 1/tSize
-
-    // Compute bounding box for texture coord generation and lighting.
-    if (tex_coord.empty()) { // || any positional lights are active...
-        float bounds[6]; // xmin,xmax, ymin,ymax, zmin,zmax
-        computeBounds(coord.size(), &coord[0][0], bounds);
-
-        // do the bounds intersect the radius of any active positional lights.
-        texGenParams(bounds, texAxes, texParams);
-        if (fequal(texParams[1], 0.0f) || fequal(texParams[3], 0.0f)) {
-            return;
-        }
-    }
-
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
-
-    this->begin_geometry();
-
-    // Face orientation & culling
-    glFrontFace((mask & mask_ccw) ? GL_CCW : GL_CW);
-    if (!(mask & mask_solid)) { glDisable(GL_CULL_FACE); }
-
-    // Color per face
-    if (!color.empty() && ! (mask & mask_color_per_vertex)) {
-        glShadeModel(GL_FLAT);
-    }
-
-    // -------------------------------------------------------
-
-    // Generation of per vertex normals isn't implemented yet...
-    if (normal.empty() && (mask & mask_normal_per_vertex)) {
-        mask &= ~mask_normal_per_vertex;
-    }
-
-    // Handle non-convex polys
-    if (mask & mask_convex) {
-        ShellData s(mask,
-                    coord, coord_index,
-                    color, color_index,
-                    normal, normal_index,
-                    tex_coord, tex_coord_index,
-                    texAxes, texParams, 0, 0);
+    if (this->draw_retained_geometry(n)) { return; }
 
-        insertShellConvex(&s);
-    } else {
-        vector<vertex_data> vertices(coord.size()); // Throws std::bad_alloc.
-        for (vector<vertex_data>::size_type i = 0; i < vertices.size(); ++i) {
-            vertices[i].coord[0] = coord[i].x();
-            vertices[i].coord[1] = coord[i].y();
-            vertices[i].coord[2] = coord[i].z();
-        }
+    const compiled_mesh mesh(mask,
+                             coord, coord_index,
+                             color, color_index,
+                             normal, normal_index,
+                             tex_coord, tex_coord_index);
+    this->do_insert_mesh(n, mesh);
+}
 
-        if (mask & mask_color_per_vertex) {
-            if (color_index.empty()) {
-                for (vector<openvrml::color>::size_type i = 0;
-                     i < color.size();
-                     ++i) {
-                    vertices[i].color = &color[i];
-                }
-            } else if (color_index.size() == coord_index.size()) {
-                for (vector<int32>::size_type i = 0;
-                     i < color_index.size();
-                     ++i) {
-                    if (color_index[i] < 0) { continue; }
-                    if (!(size_t(coord_index[i]) < coord.size())) { continue; }
-                    vertices[static_cast<std::size_t>(coord_index[i])].color =
-                        &color[static_cast<std::size_t>(color_index[i])];
-                }
-            }
-        }
-        if (mask & mask_normal_per_vertex) {
-            if (normal_index.empty()) {
-                for (vector<openvrml::vec3f>::size_type i = 0;
-                     i < normal.size();
-                     ++i) {
-                    vertices[i].normal = &normal[i];
-                }
-            } else if (normal_index.size() == coord_index.size()) {
-                for (vector<int32>::size_type i = 0;
-                     i < normal_index.size();
-                     ++i) {
-                    if (normal_index[i] < 0) { continue; }
-                    if (!(size_t(coord_index[i]) < coord.size())) { continue; }
-                    vertices[static_cast<std::size_t>(coord_index[i])].normal =
-                        &normal[static_cast<std::size_t>(normal_index[i])];
-                }
-            }
-        }
+/**
+ * @brief Insert a compiled mesh.
+ *
+ * The vertex streams of @p mesh are interleaved into a single buffer.
+ *
+ * @param[in] n     the @c geometry_node corresponding to the mesh.
+ * @param[in] mesh  a compiled mesh.
+ */
+void openvrml::gl::viewer::do_insert_mesh(const geometry_node & n,
+                                          const compiled_mesh & mesh)
+{
+    if (this->draw_retained_geometry(n)) { return; }
 
-        if (tex_coord_index.empty()) {
-            for (vector<openvrml::vec2f>::size_type i = 0;
-                 i < tex_coord.size();
-                 ++i) {
-                vertices[i].tex_coord = &tex_coord[i];
-            }
-        } else {
-            for (vector<int32>::size_type i = 0;
-                 i < tex_coord_index.size();
-                 ++i) {
-                if (tex_coord_index[i] < 0) { continue; }
-                vertices[static_cast<std::size_t>(tex_coord_index[i])]
-                    .tex_coord =
-                        &tex_coord[static_cast<std::size_t>(
-                            tex_coord_index[i])];
-            }
-        }
+    using local::geometry_data;
+    const bool has_color = !mesh.color().empty();
+    geometry_data data(geometry_data::normal_attribute
+                       | (has_color ? geometry_data::color_attribute : 0)
+                       | geometry_data::tex_coord_attribute,
+                       face_flags(mesh.mask()));
 
-        const bool color_per_face = !(mask & mask_color_per_vertex);
-        const bool normal_per_face = !(mask & mask_color_per_vertex);
-        insertShellTess(*this->tesselator,
-                        vertices,
-                        coord_index,
-                        color_per_face,
-                        color,
-                        color_index,
-                        normal_per_face,
-                        normal,
-                        normal_index);
+    const openvrml::color white = make_color(1.0, 1.0, 1.0);
+    data.vertices.reserve(data.stride() * mesh.coord().size());
+    for (size_t i = 0; i < mesh.coord().size(); ++i) {
+        data.add_vertex(mesh.coord()[i],
+                        mesh.normal()[i],
+                        has_color ? mesh.color()[i] : white,
+                        mesh.tex_coord()[i]);
     }
 
-    this->end_geometry();
+    data.begin_batch(GL_TRIANGLES);
+    data.indices.assign(mesh.index().begin(), mesh.index().end());
+    data.end_batch();
 
-    if (glid) {
-        glEndList();
-        this->list_map_.insert(list_map_t::value_type(&n, glid));
-    }
+    this->insert_geometry(n, data);
 }
 
 namespace {
@@ -3275,16 +2310,12 @@ openvrml::gl::viewer::do_insert_sphere(const geometry_node & n,
 {
     const list_map_t::const_iterator list = this->list_map_.find(&n);
     if (list != this->list_map_.end()) {
-        glCallList(list->second);
+        this->queue_list(list->second);
         return;
     }
 
-    GLuint glid = 0;
-
-    if (!this->select_mode) {
-        glid = glGenLists(1);
-        glNewList(glid, GL_COMPILE_AND_EXECUTE);
-    }
+    const GLuint glid = glGenLists(1);
+    glNewList(glid, GL_COMPILE);
 
     static const size_t numLatLong = 10;
     static const size_t npts = numLatLong * numLatLong;
@@ -3327,6 +2358,7 @@ openvrml::gl::viewer::do_insert_sphere(const geometry_node & n,
     if (glid) {
         glEndList();
         this->list_map_.insert(list_map_t::value_type(&n, glid));
+        this->queue_list(glid);
     }
 }
 
@@ -3364,6 +2396,7 @@ void openvrml::gl::viewer::do_insert_dir_light(const float ambientIntensity,
     this->light_info_[i].nesting_level = 0;
     GLenum light = GLenum(GL_LIGHT0 + i);
 
+    this->flush_render_queue();
     glEnable(light);
     glLightfv(light, GL_AMBIENT, amb);
     glLightfv(light, GL_DIFFUSE, dif);
@@ -3423,6 +2456,7 @@ void openvrml::gl::viewer::do_insert_point_light(const float ambientIntensity,
 
     GLenum light(GL_LIGHT0 + i);
 
+    this->flush_render_queue();
     // should be enabled/disabled per geometry based on distance & radius...
     glEnable(light);
     glLightfv(light, GL_AMBIENT, amb);
@@ -3487,6 +2521,7 @@ void openvrml::gl::viewer::do_insert_spot_light(const float ambientIntensity,
 
     GLenum light(GL_LIGHT0 + i);
 
+    this->flush_render_queue();
     // should be enabled/disabled per geometry based on distance & radius...
     glEnable(light);
     glLightfv(light, GL_AMBIENT, amb);
@@ -3506,12 +2541,23 @@ void openvrml::gl::viewer::do_insert_spot_light(const float ambientIntensity,
 /**
  * @brief Remove an object from the display list.
  *
+ * Retained geometry for @p ref is only marked stale; its buffers are reused
+ * when the geometry is next inserted, so that only the parts that have
+ * changed need to be uploaded.
+ *
  * @param[in] ref   object handle.
  */
 void openvrml::gl::viewer::do_remove_object(const node & ref)
 {
+    const geometry_map_t::const_iterator geometry =
+        this->geometry_map_.find(&ref);
+    if (geometry != this->geometry_map_.end()) {
+        geometry->second->stale(true);
+    }
+
     const list_map_t::const_iterator list = this->list_map_.find(&ref);
     if (list == this->list_map_.end()) { return; }
+    this->flush_render_queue();
     glDeleteLists(list->second, 1);
     this->list_map_.erase(&ref);
 }
@@ -3523,13 +2569,7 @@ void openvrml::gl::viewer::do_remove_object(const node & ref)
  */
 void openvrml::gl::viewer::do_enable_lighting(const bool val)
 {
-    if (val) {
-        if (this->lit) {
-            glEnable(GL_LIGHTING);
-        }
-    } else {
-        glDisable(GL_LIGHTING);
-    }
+    this->render_queue_->pending.mode.lighting = val && this->lit;
 }
 
 /**
@@ -3540,7 +2580,11 @@ void openvrml::gl::viewer::do_enable_lighting(const bool val)
  */
 void openvrml::gl::viewer::do_set_color(const color & rgb, const float a)
 {
-    glColor4f(rgb.r(), rgb.g(), rgb.b(), a);
+    GLfloat * const c = this->render_queue_->pending.material.color;
+    c[0] = rgb.r();
+    c[1] = rgb.g();
+    c[2] = rgb.b();
+    c[3] = a;
 }
 
 /**
@@ -3561,6 +2605,7 @@ void openvrml::gl::viewer::do_set_fog(const color & color,
                         ? GL_EXP
                         : GL_LINEAR;
 
+    this->flush_render_queue();
     glEnable(GL_FOG);
     glFogf(GL_FOG_START, 1.5); // XXX What should this be?
     glFogf(GL_FOG_END, visibilityRange);
@@ -3587,6 +2632,8 @@ void openvrml::gl::viewer::do_set_material(const float ambientIntensity,
 {
     const float alpha = 1.0f - transparency;
 
+    local::render_state & state = this->render_queue_->pending;
+
     const float ambient[4] = { ambientIntensity * diffuseColor.r(),
                                ambientIntensity * diffuseColor.g(),
                                ambientIntensity * diffuseColor.b(),
@@ -3604,20 +2651,20 @@ void openvrml::gl::viewer::do_set_material(const float ambientIntensity,
                                 specularColor.b(),
                                 alpha };
 
-    // XXX doesn't work right yet (need alpha render pass...)
-    if (this->blend && !fequal(transparency, 0.0f)) {
-        glEnable(GL_BLEND);
-    }
+    //
+    // Blended geometry is drawn after the opaque geometry, back to front.
+    //
+    state.mode.blend = this->blend && !fequal(transparency, 0.0f);
 
-    glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, ambient);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, diffuse);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emission);
+    std::copy(ambient, ambient + 4, state.material.ambient);
+    std::copy(diffuse, diffuse + 4, state.material.diffuse);
+    std::copy(emission, emission + 4, state.material.emission);
     //
     // In OGL standard range of shininess is [0.0,128.0]
     // In VRML97 the range is [0.0,1.0]
     //
-    glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, shininess * 128);
-    glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, specular);
+    state.material.shininess = shininess * 128;
+    std::copy(specular, specular + 4, state.material.specular);
 }
 
 /**
@@ -3635,26 +2682,27 @@ void openvrml::gl::viewer::do_set_material(const float ambientIntensity,
 void openvrml::gl::viewer::do_set_material_mode(const size_t tex_components,
                                                 const bool geometry_color)
 {
-    if (tex_components && this->texture && !this->wireframe) {
-        glEnable(GL_TEXTURE_2D);
+    local::render_state & state = this->render_queue_->pending;
 
+    if (tex_components && this->texture && !this->wireframe) {
         // This is a hack: if per-{face,vertex} colors are specified,
         // they take precedence over textures with GL_MODULATE. The
         // textures won't be lit this way but at least they show up...
-        if (tex_components > 2 && geometry_color) {
-            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-        } else {
-            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-        }
+        state.texture.env_mode = (tex_components > 2 && geometry_color)
+                               ? GL_REPLACE
+                               : GL_MODULATE;
     } else {
-        glDisable(GL_TEXTURE_2D);
+        state.texture.env_mode = 0;
     }
 
-    if (geometry_color && tex_components < 3 /* && lighting enabled... */ ) {
-        glEnable(GL_COLOR_MATERIAL);
-    } else {
-        glDisable(GL_COLOR_MATERIAL);
+    // Enable blending if needed.
+    if (this->blend && (tex_components == 2 || tex_components == 4)) {
+        state.mode.blend = true;
     }
+
+    state.mode.color_material =
+        geometry_color && tex_components < 3 /* && lighting enabled... */;
+    state.geometry_color = geometry_color;
 }
 
 /**
@@ -3664,20 +2712,7 @@ void openvrml::gl::viewer::do_set_material_mode(const size_t tex_components,
  */
 void openvrml::gl::viewer::do_set_sensitive(node * object)
 {
-    if (object) {
-        // should make this dynamic...
-        if (this->sensitive == viewer::maxsensitive) {
-            OPENVRML_GL_PRINT_MESSAGE_("Internal Error: too many sensitive "
-                                       "objects.");
-            return;
-        }
-
-        // push name, increment object count
-        this->sensitive_object[this->sensitive] = object;
-        glPushName(GLuint(++this->sensitive)); // array index + 1
-    } else {
-        glPopName();
-    }
+    if (object) { this->sensitive_object.push_back(object); }
 }
 
 namespace {
@@ -3708,10 +2743,7 @@ void openvrml::gl::viewer::do_insert_texture(const texture_node & n,
 
     const texture_map_t::const_iterator texture = this->texture_map_.find(&n);
     if (texture != this->texture_map_.end()) {
-        // Enable blending if needed.
-        const int32 comp = static_cast<int32>(n.image().comp());
-        if (this->blend && (comp == 2 || comp == 4)) { glEnable(GL_BLEND); }
-        glBindTexture(GL_TEXTURE_2D, texture->second);
+        this->render_queue_->pending.texture.name = texture->second;
         return;
     }
 
@@ -3762,17 +2794,18 @@ void openvrml::gl::viewer::do_insert_texture(const texture_node & n,
     GLuint glid = 0;
 
     if (pixels) {
-        if (this->select_mode) { return; }
-
-        // Enable blending if needed
-        if (this->blend && (n.image().comp() == 2 || n.image().comp() == 4)) {
-            glEnable(GL_BLEND);
-        }
+        //
+        // A texture that is not retained is loaded into the default
+        // texture object; so any draws queued with it must be made first.
+        //
+        this->flush_render_queue();
 
         if (retainHint) {
             glGenTextures(1, &glid);
-            glBindTexture(GL_TEXTURE_2D, glid);
         }
+        glBindTexture(GL_TEXTURE_2D, glid);
+        this->render_queue_->texture_bound(glid);
+        this->render_queue_->pending.texture.name = glid;
 
         // Texturing is enabled in setMaterialMode
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
@@ -3835,7 +2868,14 @@ void openvrml::gl::viewer::do_set_texture_transform(const vec2f & center,
                                                     const vec2f & scale,
                                                     const vec2f & translation)
 {
+    local::render_state & state = this->render_queue_->pending;
+
+    //
+    // The matrix is composed on the texture matrix stack, and applied with
+    // the next draw.
+    //
     glMatrixMode(GL_TEXTURE);
+    glPushMatrix();
     glLoadIdentity();
 
     glTranslatef(-center.x(), -center.y(), 0.0);
@@ -3847,7 +2887,18 @@ void openvrml::gl::viewer::do_set_texture_transform(const vec2f & center,
     glTranslatef(center.x(), center.y(), 0.0);
     glTranslatef(translation.x(), translation.y(), 0.0);
 
+    glGetFloatv(GL_TEXTURE_MATRIX, state.texture_matrix);
+    glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
+
+    static const GLfloat identity[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    state.texture_transform =
+        !std::equal(identity, identity + 16, state.texture_matrix);
 }
 
 void openvrml::gl::viewer::do_set_frustum(float field_of_view,
@@ -3855,7 +2906,7 @@ void openvrml::gl::viewer::do_set_frustum(float field_of_view,
                                           const float visibility_limit)
 {
     glMatrixMode(GL_PROJECTION);
-    if (!this->select_mode) { glLoadIdentity(); }
+    glLoadIdentity();
 
     (field_of_view *= 180.0f) /= float(pi);
     const float aspect = float(this->win_width) / this->win_height;
@@ -4014,7 +3065,7 @@ void openvrml::gl::viewer::redraw()
     this->objects = 0;
     this->nested_objects = 0;
 
-    this->sensitive = 0;
+    this->sensitive_object.clear();
 
     // Clean out any defined lights
     for (size_t i = 0; i < viewer::max_lights; ++i) {
@@ -4026,7 +3077,22 @@ void openvrml::gl::viewer::redraw()
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 
+    this->render_queue_->begin_frame(this->lit);
     this->browser()->render();
+    this->flush_render_queue();
+
+    const local::render_queue & queue = *this->render_queue_;
+    this->state_statistics_.draws = queue.draws;
+    this->state_statistics_.blended = queue.blended;
+    this->state_statistics_.flushes = queue.flushes;
+    this->state_statistics_.texture_changes = queue.texture_changes;
+    this->state_statistics_.texture_changes_elided =
+        queue.texture_changes_elided;
+    this->state_statistics_.material_changes = queue.material_changes;
+    this->state_statistics_.material_changes_elided =
+        queue.material_changes_elided;
+    this->state_statistics_.mode_changes = queue.mode_changes;
+    this->state_statistics_.mode_changes_elided = queue.mode_changes_elided;
 
     this->swap_buffers();
 
@@ -4082,6 +3148,18 @@ void openvrml::gl::viewer::input(event_info * e)
     }
 }
 
+/**
+ * @brief Draw and state change counts for the most recent call to
+ *        @c #redraw.
+ *
+ * @return draw and state change counts for the most recent frame.
+ */
+const openvrml::gl::viewer::state_statistics &
+openvrml::gl::viewer::frame_state_statistics() const
+{
+    return this->state_statistics_;
+}
+
 /**
  * @brief Rotate the user view.
  *
@@ -4132,10 +3210,7 @@ void openvrml::gl::viewer::step(const float x, const float y, const float z)
 {
     assert(this->browser());
 
-    mat4f t = make_translation_mat4f(make_vec3f(x, y, z));
-    viewpoint_node & activeViewpoint = this->browser()->active_viewpoint();
-    activeViewpoint
-        .user_view_transform(t * activeViewpoint.user_view_transform());
+    this->translate_user_view(make_vec3f(x, y, z));
     post_redraw();
 }
 
@@ -4188,13 +3263,32 @@ void openvrml::gl::viewer::zoom(const float z)
     const vec3f translation = make_vec3f(static_cast<float>(dx),
                                          static_cast<float>(dy),
                                          static_cast<float>(dz));
-    mat4f t = make_translation_mat4f(translation);
-    viewpoint_node & activeViewpoint = this->browser()->active_viewpoint();
-    const mat4f & userViewTransform = activeViewpoint.user_view_transform();
-    activeViewpoint.user_view_transform(t * userViewTransform);
+    this->translate_user_view(translation);
     post_redraw();
 }
 
+/**
+ * @brief Move the user view, colliding with the geometry in the way.
+ *
+ * @param[in] translation   the translation, in eye coordinates.
+ *
+ * @see browser::move_avatar
+ */
+void openvrml::gl::viewer::translate_user_view(const vec3f & translation)
+{
+    assert(this->browser());
+
+    viewpoint_node & activeViewpoint = this->browser()->active_viewpoint();
+    const mat4f camera = activeViewpoint.user_view_transform()
+        * activeViewpoint.transformation();
+    const vec3f position = make_vec3f(0.0, 0.0, 0.0) * camera;
+    const vec3f reached =
+        this->browser()->move_avatar(position, translation * camera);
+    const mat4f t = make_translation_mat4f(reached * camera.inverse());
+    activeViewpoint
+        .user_view_transform(t * activeViewpoint.user_view_transform());
+}
+
 /**
  * @brief Handle keypresses.
  *
@@ -4440,7 +3534,17 @@ void openvrml::gl::viewer::handleMouseDrag(int x, int y)
 
 
 /**
- * Check for pickable objects.
+ * @brief Check for pickable objects.
+ *
+ * A ray from the eye through the cursor is cast against the geometry drawn
+ * in the last frame (see @c browser::pick); the scene is not rendered
+ * again unless it has changed since.
+ *
+ * @param[in] x             window x-coordinate of the cursor.
+ * @param[in] y             window y-coordinate of the cursor.
+ * @param[in] mouseEvent    the mouse event.
+ *
+ * @return @c true if the event was handled; @c false otherwise.
  */
 bool openvrml::gl::viewer::checkSensitive(const int x,
                                           const int y,
@@ -4450,75 +3554,57 @@ bool openvrml::gl::viewer::checkSensitive(const int x,
 
     this->initialize();
 
+    //
+    // The sensitive nodes and the geometry to pick must be those of the
+    // current scene.
+    //
+    if (this->browser()->modified()) { this->redraw(); }
+
     double timeNow = browser::current_time();
     GLint viewport[4];
+    GLdouble modelview[16], projection[16];
     glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
 
-    GLuint selectBuffer[4 * viewer::maxsensitive];
-    glSelectBuffer(4 * viewer::maxsensitive, selectBuffer);
-
-    glRenderMode(GL_SELECT);
-    this->select_mode = true;
-
-    glInitNames();
-    glPushName(0);
-
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    gluPickMatrix(GLdouble(x), GLdouble(viewport[3] - y),
-                  2.0, 2.0, viewport);
-
-    // Set up the global attributes
-    glDisable(GL_FOG);
-    glDisable(GL_TEXTURE_2D);
-
-    glFrontFace(GL_CCW);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-
-    glDisable(GL_LIGHTING);
-    glDisable(GL_COLOR_MATERIAL);
-
-    glShadeModel(GL_FLAT);
-
-    this->objects = 0;
-    this->nested_objects = 0;
-
-    this->sensitive = 0;
-
-    // Clean out any defined lights
-    for (size_t i = 0; i < max_lights; ++i) {
-        this->light_info_[i].type = viewer::light_unused;
-        GLenum light = GLenum(GL_LIGHT0 + i);
-        glDisable(light);
+    //
+    // make modelview as a unit matrix as this is taken care in the core
+    // side during render traversal.
+    //
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            modelview[4 * i + j] = (i == j) ? 1.0 : 0.0;
+        }
     }
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    this->browser()->render();
-
-    this->select_mode = false;
-
-    // select closest hit
-    GLuint closest = 0, minz = 0xffffffff;
+    //
+    // The ray through the cursor, in eye coordinates.
+    //
+    GLdouble nx, ny, nz, fx, fy, fz;
+    gluUnProject(GLdouble(x), GLdouble(viewport[3] - y), 0.0,
+                 modelview, projection, viewport,
+                 &nx, &ny, &nz);
+    gluUnProject(GLdouble(x), GLdouble(viewport[3] - y), 1.0,
+                 modelview, projection, viewport,
+                 &fx, &fy, &fz);
+    const vec3f eye_near = make_vec3f(float(nx), float(ny), float(nz));
+    const vec3f eye_far = make_vec3f(float(fx), float(fy), float(fz));
+
+    const viewpoint_node & viewpoint = this->browser()->active_viewpoint();
+    const mat4f camera = viewpoint.user_view_transform()
+        * viewpoint.transformation();
+    const vec3f origin = eye_near * camera;
 
     size_t selected = 0;   // nothing selected
-    GLint hits = glRenderMode(GL_RENDER);
-    if (hits > 0) {
-        // selectBuffer[] = { N1, z1, z2, name1, ..., nameN1, N2, ... }
-        GLuint * sel = selectBuffer;
-
-        for (GLint nh = 0; nh < hits; ++nh, sel += (3 + sel[0])) {
-            if (sel[1] <= minz) {
-                minz = sel[1];  // z1
-                closest = sel[2 + sel[0]];  // nameN (most deeply nested)
-            }
-        }
-
-        if (closest > 0 && closest <= GLuint(this->sensitive)) {
-            selected = closest;
+    browser::pick_result hit;
+    const bool picked =
+        this->browser()->pick(origin, eye_far * camera - origin, hit);
+    if (picked && hit.sensitive) {
+        const std::vector<node *>::const_iterator sensitive =
+            std::find(this->sensitive_object.begin(),
+                      this->sensitive_object.end(),
+                      hit.sensitive);
+        if (sensitive != this->sensitive_object.end()) {
+            selected = sensitive - this->sensitive_object.begin() + 1;
         }
     }
 
@@ -4526,7 +3612,7 @@ bool openvrml::gl::viewer::checkSensitive(const int x,
 
     //
     // Compute & store the world coords of the pick if something
-    // was already active or is about to become active. The window
+    // was already active or is about to become active. The eye
     // Z coord is retained when a drag is started on a sensitive
     // so the drag stays in the same plane even if the mouse moves
     // off the original sensitive object.
@@ -4535,47 +3621,28 @@ bool openvrml::gl::viewer::checkSensitive(const int x,
 
     if (this->active_sensitive || selected) {
         if (!this->active_sensitive) {
-            this->select_z = minz / double(0xffffffff);
+            this->select_z = (hit.point * camera.inverse()).z();
         }
 
-        GLint viewport[4];
-        GLdouble modelview[16], projection[16];
-        glGetIntegerv(GL_VIEWPORT, viewport);
-        glGetDoublev(GL_PROJECTION_MATRIX, projection);
-  //      glGetDoublev (GL_MODELVIEW_MATRIX, modelview);
-
         //
-        // make modelview as a unit matrix as this is taken care in the core
-        // side during render traversal.
+        // The point on the ray through the cursor at select_z.
         //
-        for (int i = 0; i < 4; ++i) {
-            for (int j = 0; j < 4; ++j) {
-                modelview[4 * i + j] = (i == j) ? 1.0 : 0.0;
-            }
-        }
-
-        GLdouble dx, dy, dz;
-        gluUnProject(GLdouble(x), GLdouble(viewport[3] - y), this->select_z,
-                     modelview, projection, viewport,
-                     &dx, &dy, &dz);
-
-        selectCoord[0] = dx;
-        selectCoord[1] = dy;
-        selectCoord[2] = dz;
+        const double dz = fz - nz;
+        const double s = (dz != 0.0) ? (this->select_z - nz) / dz : 0.0;
+        selectCoord[0] = nx + s * (fx - nx);
+        selectCoord[1] = ny + s * (fy - ny);
+        selectCoord[2] = this->select_z;
     }
 
     bool wasActive = false;
-  // To unset PickMatrix...
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
 
     // Sanity check. This can happen when the world gets replaced
     // by clicking on an anchor - the current sensitive object goes
     // away, but these variables are not reset.
-    if (this->active_sensitive > this->sensitive) {
+    if (this->active_sensitive > this->sensitive_object.size()) {
         this->active_sensitive = 0;
     }
-    if (this->over_sensitive > this->sensitive) {
+    if (this->over_sensitive > this->sensitive_object.size()) {
         this->over_sensitive = 0;
     }
 
@@ -38,20 +38,34 @@
 #   endif
 #   include <map>
 #   include <stack>
+#   include <vector>
 
 namespace openvrml {
 
     namespace gl {
 
+        namespace local {
+            class geometry_data;
+            class geometry_buffer;
+            class render_queue;
+        }
+
         class OPENVRML_GL_API viewer : public openvrml::viewer {
             typedef std::map<const node *, GLuint> list_map_t;
             struct delete_list;
             list_map_t list_map_;
 
+            typedef std::map<const node *, local::geometry_buffer *>
+                geometry_map_t;
+            struct delete_geometry;
+            geometry_map_t geometry_map_;
+
             typedef std::map<const texture_node *, GLuint> texture_map_t;
             struct delete_texture;
             texture_map_t texture_map_;
 
+            local::render_queue * const render_queue_;
+
         public:
             enum { max_lights = 8 };
 
@@ -85,6 +99,18 @@ namespace openvrml {
                 int x, y;
             };
 
+            struct state_statistics {
+                std::size_t draws;
+                std::size_t blended;
+                std::size_t flushes;
+                std::size_t texture_changes;
+                std::size_t texture_changes_elided;
+                std::size_t material_changes;
+                std::size_t material_changes_elided;
+                std::size_t mode_changes;
+                std::size_t mode_changes_elided;
+            };
+
         protected:
             enum cursor_style {
                 cursor_inherit,
@@ -126,16 +152,12 @@ namespace openvrml {
 
             size_t objects, nested_objects;
 
-            GLUtesselator * tesselator;
 
-            size_t sensitive;
             size_t active_sensitive;
             size_t over_sensitive;
 
-            enum { maxsensitive = 1000 };
-            node * sensitive_object[maxsensitive];
+            std::vector<node *> sensitive_object;
 
-            bool select_mode;
             double select_z;
 
             light_info light_info_[max_lights];
@@ -148,6 +170,8 @@ namespace openvrml {
             double render_time;
             double render_time1;
 
+            state_statistics state_statistics_;
+
             void initialize();
             void shutdown();
 
@@ -156,6 +180,7 @@ namespace openvrml {
 
             void step(float, float, float);
             void zoom(float);
+            void translate_user_view(const vec3f & translation);
             void rotate(const openvrml::rotation & rot) OPENVRML_NOTHROW;
 
             void handleKey(int);
@@ -188,12 +213,21 @@ namespace openvrml {
 
             void input(event_info * e);
 
+            const state_statistics & frame_state_statistics() const;
+
         private:
             virtual rendering_mode do_mode();
             virtual double do_frame_rate();
 
             virtual void do_reset_user_navigation();
 
+            bool draw_retained_geometry(const node & n);
+            void insert_geometry(const node & n, local::geometry_data & data);
+            void draw_geometry(const local::geometry_buffer & buffer);
+            void queue_geometry(const local::geometry_buffer & buffer);
+            void queue_list(GLuint list);
+            void flush_render_queue();
+
             // Scope dirlights, open/close display lists
             virtual void do_begin_object(const char * id, bool retain);
             virtual void do_end_object();
@@ -256,6 +290,8 @@ namespace openvrml {
                                  const std::vector<int32> & normalIndex,
                                  const std::vector<vec2f> & texCoord,
                                  const std::vector<int32> & texCoordIndex);
+            virtual void do_insert_mesh(const geometry_node & n,
+                                        const compiled_mesh & mesh);
 
             virtual void do_insert_sphere(const geometry_node & n,
                                           float radius);
@@ -18,8 +18,11 @@
 // along with this library; if not, see <http://www.gnu.org/licenses/>.
 //
 
+# include <algorithm>
+# include <cmath>
 # include <limits>
 # include <openvrml/local/float.h>
+# include <openvrml/local/bounding_kernels.h>
 # include "bounding_volume.h"
 # include "field_value.h"
 # include "frustum.h"
@@ -494,13 +497,25 @@ void openvrml::bounding_sphere::do_extend(const vec3f & p)
 /**
  * @brief Extend the bounding volume to enclose @p bbox.
  *
- * @todo Implement me!
- *
  * @param[in] bbox  an axis-aligned bounding box
  */
 void
-openvrml::bounding_sphere::do_extend(const axis_aligned_bounding_box &)
-{}
+openvrml::bounding_sphere::do_extend(const axis_aligned_bounding_box & bbox)
+{
+    if (this->maximized()) { return; }
+
+    if (bbox.maximized()) {
+        this->maximize();
+        return;
+    }
+
+    if (bbox.empty()) { return; }
+
+    bounding_sphere bs;
+    bs.center_ = bbox.center();
+    bs.radius_ = (bbox.maximum() - bbox.center()).length();
+    this->do_extend(bs);
+}
 
 /**
  * @brief Extend this bvolume to enclose the given sphere.
@@ -577,66 +592,52 @@ void openvrml::bounding_sphere::do_extend(const bounding_sphere & b)
  */
 void openvrml::bounding_sphere::do_enclose(const std::vector<vec3f> & points)
 {
-    // doing an extend() for each point is ok, but there are
-    // faster algorithms reference "An Efficient Bounding Sphere"
-    // Graphics Gems pg 301. it depends on being able to make multiple
-    // passes over the points, so it isn't appropriate for incremental
-    // updates, but it would be good here...
-    // for(int i=0; i<n; ++i)
-    // this->extend(&p[i]);
+    //
+    // This is the algorithm from "An Efficient Bounding Sphere", Graphics
+    // Gems pg 301: start with the sphere spanning the most distant pair of
+    // extreme points, then extend it to each point outside.  Most points
+    // are inside the initial sphere; local::find_outside skips over those
+    // without the square root in do_extend.
     //
 
     *this = bounding_sphere();
 
     if (points.size() < 1) { return; }
 
-    const vec3f * min_p[3] = { &points[0], &points[0], &points[0] };
-    const vec3f * max_p[3] = { &points[0], &points[0], &points[0] };
+    std::size_t min_p[3], max_p[3];
+    local::extreme_points(&points[0], points.size(), min_p, max_p);
 
     //
-    // Find the 6 points with: minx, maxx, miny, maxy, minz, maxz.
+    // Pick the two points most distant from one another.
     //
-    size_t i;
-    for (i = 1; i < points.size(); ++i) {
-        const vec3f & pi = points[i];
-        if (pi.x() < min_p[0]->x()) { min_p[0] = &pi; }
-        if (pi.y() < min_p[1]->y()) { min_p[1] = &pi; }
-        if (pi.z() < min_p[2]->z()) { min_p[2] = &pi; }
-
-        if (pi.x() > max_p[0]->x()) { max_p[0] = &pi; }
-        if (pi.y() > max_p[1]->y()) { max_p[1] = &pi; }
-        if (pi.z() > max_p[2]->z()) { max_p[2] = &pi; }
+    std::size_t max_span0 = min_p[0], max_span1 = max_p[0];
+    float max_span_dist = -1.0f;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        const vec3f span = points[max_p[axis]] - points[min_p[axis]];
+        const float dist = span.dot(span);
+        if (dist > max_span_dist) {
+            max_span0 = min_p[axis];
+            max_span1 = max_p[axis];
+            max_span_dist = dist;
+        }
     }
 
+    this->center_ = (points[max_span0] + points[max_span1]) / 2.0;
+    this->radius_ = float(sqrt(max_span_dist)) / 2.0f;
+
     //
-    // Pick the two points most distant from one another.
+    // Points within a small tolerance of the surface are passed to
+    // do_extend, which makes the exact test.
     //
-    vec3f span = *max_p[0] - *min_p[0];
-    float dx = span.dot(span);
-    span = *max_p[1] - *min_p[1];
-    float dy = span.dot(span);
-    span = *max_p[2] - *min_p[2];
-    float dz = span.dot(span);
-
-    const vec3f * max_span0 = min_p[0];
-    const vec3f * max_span1 = max_p[0];
-    float max_span_dist = dx;
-    if (dy > max_span_dist) {
-        max_span0 = min_p[1];
-        max_span1 = max_p[1];
-        max_span_dist = dy;
+    static const float tolerance = 1.0f - 1.0e-5f;
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        i += local::find_outside(&points[i],
+                                 points.size() - i,
+                                 this->center_,
+                                 this->radius_ * this->radius_ * tolerance);
+        if (i == points.size()) { break; }
+        this->extend(points[i]);
     }
-    if (dz > max_span_dist) {
-        max_span0 = min_p[2];
-        max_span1 = max_p[2];
-        max_span_dist = dz;
-    }
-
-    this->center_ = (*max_span0 + *max_span1) / 2.0;
-
-    this->radius_ = float(sqrt(this->center_.dot(this->center_)));
-
-    for (i = 0; i < points.size(); ++i) { this->extend(points[i]); }
 }
 
 /**
@@ -744,15 +745,136 @@ void openvrml::bounding_sphere::do_transform(const mat4f & t)
     this->radius_ *= max_scale;
 }
 
+namespace {
+
+    //
+    // The batch functions below work on spheres in blocks of this many.
+    //
+    const std::size_t sphere_block = 64;
+
+    //
+    // The factor by which a transformation scales a sphere's radius.
+    //
+    float radius_scale(const openvrml::mat4f & t)
+    {
+        using openvrml::make_vec3f;
+        const float scale_x = make_vec3f(t[0][0], t[1][0], t[2][0]).length();
+        const float scale_y = make_vec3f(t[0][1], t[1][1], t[2][1]).length();
+        const float scale_z = make_vec3f(t[0][2], t[1][2], t[2][2]).length();
+
+        float max_scale = scale_x;
+        if (scale_y > max_scale) { max_scale = scale_y; }
+        if (scale_z > max_scale) { max_scale = scale_z; }
+        return max_scale;
+    }
+}
+
+/**
+ * @brief Transform each of @p spheres by @p M.
+ *
+ * The result is the same as calling @c #transform on each sphere; but the
+ * centers are transformed several at a time.
+ *
+ * @param[in]     M         transformation matrix.
+ * @param[in,out] spheres   bounding spheres.
+ */
+void
+openvrml::bounding_sphere::
+transform_all(const mat4f & M, std::vector<bounding_sphere> & spheres)
+{
+    const float scale = radius_scale(M);
+    float x[sphere_block], y[sphere_block], z[sphere_block];
+    for (std::size_t begin = 0; begin < spheres.size();
+         begin += sphere_block) {
+        const std::size_t n =
+            std::min(sphere_block, spheres.size() - begin);
+        bounding_sphere * const bs = &spheres[begin];
+        for (std::size_t i = 0; i < n; ++i) {
+            x[i] = bs[i].center_.x();
+            y[i] = bs[i].center_.y();
+            z[i] = bs[i].center_.z();
+        }
+        local::transform_points(M, x, y, z, n);
+        for (std::size_t i = 0; i < n; ++i) {
+            if (bs[i].maximized() || bs[i].radius_ == -1) { continue; }
+            bs[i].center_ = make_vec3f(x[i], y[i], z[i]);
+            bs[i].radius_ *= scale;
+        }
+    }
+}
+
+/**
+ * @brief Intersect each of @p spheres with the view volume.
+ *
+ * The result is the same as calling @c #intersect_frustum on each sphere;
+ * but several spheres are tested against each plane at a time.
+ *
+ * @param[in]  frustum  the view frustum.
+ * @param[in]  spheres  bounding spheres.
+ * @param[out] result   the intersection of each sphere with the view
+ *                      volume.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::bounding_sphere::
+intersect_frustum_all(const openvrml::frustum & frustum,
+                      const std::vector<bounding_sphere> & spheres,
+                      std::vector<intersection> & result)
+{
+    result.resize(spheres.size());
+    float plane[6][4];
+    frustum.planes(plane);
+    float x[sphere_block], y[sphere_block], z[sphere_block],
+        r[sphere_block];
+    for (std::size_t begin = 0; begin < spheres.size();
+         begin += sphere_block) {
+        const std::size_t n =
+            std::min(sphere_block, spheres.size() - begin);
+        const bounding_sphere * const bs = &spheres[begin];
+        for (std::size_t i = 0; i < n; ++i) {
+            x[i] = bs[i].center_.x();
+            y[i] = bs[i].center_.y();
+            z[i] = bs[i].center_.z();
+            r[i] = bs[i].radius_;
+        }
+        local::intersect_spheres(plane, x, y, z, r, n, &result[begin]);
+    }
+}
 
 /**
  * @class openvrml::axis_aligned_bounding_box
  *
  * @brief An axis-aligned bounding box.
  *
- * @todo This class is currently just a placeholder.
+ * An empty box has a minimum greater than its maximum; a maximized box
+ * spans the range of @c float.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::axis_aligned_bounding_box::minimum_
+ *
+ * @brief The least coordinates of the box.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::axis_aligned_bounding_box::maximum_
+ *
+ * @brief The greatest coordinates of the box.
  */
 
+/**
+ * @brief Construct an empty box.
+ */
+openvrml::axis_aligned_bounding_box::axis_aligned_bounding_box():
+    minimum_(make_vec3f(std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max())),
+    maximum_(make_vec3f(-std::numeric_limits<float>::max(),
+                        -std::numeric_limits<float>::max(),
+                        -std::numeric_limits<float>::max()))
+{}
+
 /**
  * @brief Destroy.
  */
@@ -761,34 +883,139 @@ openvrml::axis_aligned_bounding_box::~axis_aligned_bounding_box()
 {}
 
 /**
- * @todo Implement me!
+ * @brief Whether the box is empty.
+ *
+ * @return @c true if the box encloses nothing; @c false otherwise.
+ */
+bool openvrml::axis_aligned_bounding_box::empty() const
+{
+    return this->minimum_.x() > this->maximum_.x();
+}
+
+/**
+ * @brief The least coordinates of the box.
+ *
+ * @return the least coordinates of the box.
+ */
+const openvrml::vec3f & openvrml::axis_aligned_bounding_box::minimum() const
+{
+    return this->minimum_;
+}
+
+/**
+ * @brief The greatest coordinates of the box.
+ *
+ * @return the greatest coordinates of the box.
+ */
+const openvrml::vec3f & openvrml::axis_aligned_bounding_box::maximum() const
+{
+    return this->maximum_;
+}
+
+/**
+ * @brief The center of the box.
+ *
+ * @return the center of the box.
+ */
+const openvrml::vec3f openvrml::axis_aligned_bounding_box::center() const
+{
+    return (this->minimum_ + this->maximum_) / 2.0f;
+}
+
+/**
+ * @brief Intersect this bounding volume with a frustum.
+ *
+ * The box is assumed to be in the frustum's object coordinate space.
+ *
+ * @param[in] frustum   the frustum.
+ *
+ * @return inside, outside, or partial.
  */
 openvrml::bounding_volume::intersection
 openvrml::axis_aligned_bounding_box::
-do_intersect_frustum(const openvrml::frustum &) const
+do_intersect_frustum(const openvrml::frustum & frustum) const
 {
-    return bounding_volume::partial;
+    if (this->maximized() || this->empty()) {
+        return bounding_volume::partial;
+    }
+
+    const vec3f c = this->center();
+    const vec3f e = this->maximum_ - c;
+    float plane[6][4];
+    frustum.planes(plane);
+
+    bounding_volume::intersection code = bounding_volume::inside;
+    for (std::size_t i = 0; i < 6; ++i) {
+        const float * const p = plane[i];
+        const float d = p[0] * c.x() + p[1] * c.y() + p[2] * c.z() + p[3];
+        const float r = std::fabs(p[0]) * e.x() + std::fabs(p[1]) * e.y()
+            + std::fabs(p[2]) * e.z();
+        if (d < -r) { return bounding_volume::outside; }
+        if (d < r) { code = bounding_volume::partial; }
+    }
+    return code;
 }
 
 /**
- * @todo Implement me!
+ * @brief Extend the bounding volume to enclose @p p.
+ *
+ * @param[in] p a point
  */
-void openvrml::axis_aligned_bounding_box::do_extend(const vec3f &)
-{}
+void openvrml::axis_aligned_bounding_box::do_extend(const vec3f & p)
+{
+    if (this->maximized()) { return; }
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        if (p[axis] < this->minimum_[axis]) {
+            this->minimum_.vec[axis] = p[axis];
+        }
+        if (p[axis] > this->maximum_[axis]) {
+            this->maximum_.vec[axis] = p[axis];
+        }
+    }
+}
 
 /**
- * @todo Implement me!
+ * @brief Extend the bounding volume to enclose @p b.
+ *
+ * @param[in] b an axis-aligned bounding box
  */
 void
 openvrml::axis_aligned_bounding_box::
-do_extend(const axis_aligned_bounding_box &)
-{}
+do_extend(const axis_aligned_bounding_box & b)
+{
+    if (this->maximized()) { return; }
+
+    if (b.maximized()) {
+        this->maximize();
+        return;
+    }
+
+    if (b.empty()) { return; }
+
+    this->do_extend(b.minimum_);
+    this->do_extend(b.maximum_);
+}
 
 /**
- * @todo Implement me!
+ * @brief Extend the bounding volume to enclose @p b.
+ *
+ * @param[in] b a bounding sphere
  */
-void openvrml::axis_aligned_bounding_box::do_extend(const bounding_sphere &)
-{}
+void openvrml::axis_aligned_bounding_box::do_extend(const bounding_sphere & b)
+{
+    if (this->maximized()) { return; }
+
+    if (b.maximized()) {
+        this->maximize();
+        return;
+    }
+
+    if (b.radius() == -1.0f) { return; }
+
+    const vec3f r = make_vec3f(b.radius(), b.radius(), b.radius());
+    this->do_extend(b.center() - r);
+    this->do_extend(b.center() + r);
+}
 
 /**
  * @brief Enclose the given set of points.
@@ -796,36 +1023,70 @@ void openvrml::axis_aligned_bounding_box::do_extend(const bounding_sphere &)
  * This resets the volume from any previous values.
  *
  * @param[in] points    points.
- *
- * @todo Implement me!
  */
 void
 openvrml::axis_aligned_bounding_box::
-do_enclose(const std::vector<vec3f> &)
-{}
+do_enclose(const std::vector<vec3f> & points)
+{
+    *this = axis_aligned_bounding_box();
+
+    if (points.empty()) { return; }
+
+    local::point_bounds(&points[0], points.size(),
+                        this->minimum_, this->maximum_);
+}
 
 /**
- * @brief Implement me!
+ * @brief Maximize the bounding volume.
  */
 void openvrml::axis_aligned_bounding_box::do_maximize()
-{}
+{
+    static const float max = std::numeric_limits<float>::max();
+    this->minimum_ = make_vec3f(-max, -max, -max);
+    this->maximum_ = make_vec3f(max, max, max);
+}
 
 /**
- * @brief Implement me!
+ * @brief Whether the bounding volume is maximized.
+ *
+ * @return @c true if the bounding volume is maximized; @c false otherwise.
  */
 bool openvrml::axis_aligned_bounding_box::do_maximized() const
 {
-    return true;
+    return this->maximum_.x() == std::numeric_limits<float>::max()
+        && this->minimum_.x() == -std::numeric_limits<float>::max();
 }
 
 /**
- * @brief Implement me!
+ * @brief Orthographically transform the bounding volume by @p M.
+ *
+ * @param[in] M transformation matrix.
  */
-void openvrml::axis_aligned_bounding_box::do_ortho_transform(const mat4f &)
-{}
+void openvrml::axis_aligned_bounding_box::do_ortho_transform(const mat4f & M)
+{
+    this->do_transform(M);
+}
 
 /**
- * @brief Implement me!
+ * @brief Transform the bounding volume by @p M.
+ *
+ * The result is the smallest axis-aligned box enclosing the transformed
+ * box.
+ *
+ * @param[in] M affine transformation matrix.
  */
-void openvrml::axis_aligned_bounding_box::do_transform(const mat4f &)
-{}
+void openvrml::axis_aligned_bounding_box::do_transform(const mat4f & M)
+{
+    if (this->maximized() || this->empty()) { return; }
+
+    const vec3f c = this->center() * M;
+    const vec3f e = this->maximum_ - this->center();
+    vec3f extent;
+    for (std::size_t j = 0; j < 3; ++j) {
+        extent.vec[j] = std::fabs(M[0][j]) * e.x()
+            + std::fabs(M[1][j]) * e.y()
+            + std::fabs(M[2][j]) * e.z();
+    }
+    this->minimum_ = c - extent;
+    this->maximum_ = c + extent;
+}
@@ -76,6 +76,13 @@ namespace openvrml {
         void radius(float r);
         float radius() const;
 
+        static void transform_all(const mat4f & M,
+                                  std::vector<bounding_sphere> & spheres);
+        static void
+        intersect_frustum_all(const openvrml::frustum & frustum,
+                              const std::vector<bounding_sphere> & spheres,
+                              std::vector<intersection> & result);
+
     private:
         virtual void do_maximize();
         virtual bool do_maximized() const;
@@ -91,9 +98,18 @@ namespace openvrml {
 
 
     class OPENVRML_API axis_aligned_bounding_box : public bounding_volume {
+        vec3f minimum_;
+        vec3f maximum_;
+
     public:
+        axis_aligned_bounding_box();
         virtual ~axis_aligned_bounding_box() OPENVRML_NOTHROW;
 
+        bool empty() const;
+        const vec3f & minimum() const;
+        const vec3f & maximum() const;
+        const vec3f center() const;
+
     private:
         virtual void do_maximize();
         virtual bool do_maximized() const;
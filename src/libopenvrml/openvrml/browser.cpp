@@ -24,10 +24,19 @@
 # include "scene.h"
 # include "scope.h"
 # include "viewer.h"
+# include "tessellation_service.h"
 # include <openvrml/local/uri.h>
 # include <openvrml/local/node_metatype_registry_impl.h>
 # include <openvrml/local/component.h>
 # include <openvrml/local/parse_vrml.h>
+# include <openvrml/local/event_queue.h>
+# include <openvrml/local/bounding_volume_hierarchy.h>
+# include <openvrml/local/occlusion_buffer.h>
+# include <openvrml/local/pick_engine.h>
+# include <openvrml/local/avatar_collision.h>
+# include <openvrml/local/thread_pool.h>
+# include <openvrml/local/io_pool.h>
+# include <openvrml/local/timer_scheduler.h>
 # include <private.h>
 # include <boost/bind.hpp>
 # include <boost/function.hpp>
@@ -382,6 +391,175 @@ namespace {
         throw openvrml::unsupported_interface(this->type(), id);
         return *static_cast<openvrml::event_emitter *>(0);
     }
+
+
+    //
+    // The viewer the browser renders to when gathering the geometry the
+    // avatar can collide with.  It draws nothing; geometry inserted into it
+    // is recorded by the browser's pick engine.
+    //
+    class OPENVRML_LOCAL collision_viewer : public openvrml::viewer {
+        virtual rendering_mode do_mode() { return pick_mode; }
+        virtual double do_frame_rate() { return 0.0; }
+        virtual void do_reset_user_navigation() {}
+        virtual void do_begin_object(const char *, bool) {}
+        virtual void do_end_object() {}
+        virtual void
+        do_insert_background(const openvrml::background_node &)
+        {}
+        virtual void do_insert_box(const openvrml::geometry_node &,
+                                   const openvrml::vec3f &)
+        {}
+        virtual void do_insert_cone(const openvrml::geometry_node &,
+                                    float, float, bool, bool)
+        {}
+        virtual void do_insert_cylinder(const openvrml::geometry_node &,
+                                        float, float, bool, bool, bool)
+        {}
+        virtual void
+        do_insert_elevation_grid(const openvrml::geometry_node &,
+                                 unsigned int,
+                                 const std::vector<float> &,
+                                 openvrml::int32, openvrml::int32,
+                                 float, float,
+                                 const std::vector<openvrml::color> &,
+                                 const std::vector<openvrml::vec3f> &,
+                                 const std::vector<openvrml::vec2f> &)
+        {}
+        virtual void
+        do_insert_extrusion(const openvrml::geometry_node &,
+                            unsigned int,
+                            const std::vector<openvrml::vec3f> &,
+                            const std::vector<openvrml::vec2f> &,
+                            const std::vector<openvrml::rotation> &,
+                            const std::vector<openvrml::vec2f> &)
+        {}
+        virtual void
+        do_insert_line_set(const openvrml::geometry_node &,
+                           const std::vector<openvrml::vec3f> &,
+                           const std::vector<openvrml::int32> &,
+                           bool,
+                           const std::vector<openvrml::color> &,
+                           const std::vector<openvrml::int32> &)
+        {}
+        virtual void
+        do_insert_point_set(const openvrml::geometry_node &,
+                            const std::vector<openvrml::vec3f> &,
+                            const std::vector<openvrml::color> &)
+        {}
+        virtual void
+        do_insert_shell(const openvrml::geometry_node &,
+                        unsigned int,
+                        const std::vector<openvrml::vec3f> &,
+                        const std::vector<openvrml::int32> &,
+                        const std::vector<openvrml::color> &,
+                        const std::vector<openvrml::int32> &,
+                        const std::vector<openvrml::vec3f> &,
+                        const std::vector<openvrml::int32> &,
+                        const std::vector<openvrml::vec2f> &,
+                        const std::vector<openvrml::int32> &)
+        {}
+        virtual void do_insert_mesh(const openvrml::geometry_node &,
+                                    const openvrml::compiled_mesh &)
+        {}
+        virtual void do_insert_sphere(const openvrml::geometry_node &, float)
+        {}
+        virtual void do_insert_dir_light(float, float,
+                                         const openvrml::color &,
+                                         const openvrml::vec3f &)
+        {}
+        virtual void do_insert_point_light(float,
+                                           const openvrml::vec3f &,
+                                           const openvrml::color &,
+                                           float,
+                                           const openvrml::vec3f &,
+                                           float)
+        {}
+        virtual void do_insert_spot_light(float,
+                                          const openvrml::vec3f &,
+                                          float,
+                                          const openvrml::color &,
+                                          float,
+                                          const openvrml::vec3f &,
+                                          float,
+                                          const openvrml::vec3f &,
+                                          float)
+        {}
+        virtual void do_remove_object(const openvrml::node &) {}
+        virtual void do_enable_lighting(bool) {}
+        virtual void do_set_fog(const openvrml::color &, float, const char *)
+        {}
+        virtual void do_set_color(const openvrml::color &, float) {}
+        virtual void do_set_material(float,
+                                     const openvrml::color &,
+                                     const openvrml::color &,
+                                     float,
+                                     const openvrml::color &,
+                                     float)
+        {}
+        virtual void do_set_material_mode(size_t, bool) {}
+        virtual void do_set_sensitive(openvrml::node *) {}
+        virtual void do_insert_texture(const openvrml::texture_node &, bool)
+        {}
+        virtual void
+        do_remove_texture_object(const openvrml::texture_node &)
+        {}
+        virtual void do_set_texture_transform(const openvrml::vec2f &,
+                                              float,
+                                              const openvrml::vec2f &,
+                                              const openvrml::vec2f &)
+        {}
+        virtual void do_set_frustum(float, float, float) {}
+        virtual void do_set_viewpoint(const openvrml::vec3f &,
+                                      const openvrml::rotation &,
+                                      float, float)
+        {}
+        virtual void do_transform(const openvrml::mat4f &) {}
+        virtual void do_transform_points(size_t, openvrml::vec3f *) const {}
+        virtual void
+        do_draw_bounding_sphere(const openvrml::bounding_sphere &,
+                                openvrml::bounding_volume::intersection)
+        {}
+    };
+
+
+    //
+    // The avatar of the active NavigationInfo.  Returns false if the
+    // navigation type does not collide with geometry: a type of EXAMINE or
+    // NONE before any WALK or FLY.  The avatar walks on the ground only if
+    // WALK comes first.
+    //
+    OPENVRML_LOCAL bool
+    collision_avatar(const openvrml::navigation_info_node & nav_info,
+                     const openvrml::viewpoint_node & viewpoint,
+                     openvrml::local::avatar & a)
+    {
+        using openvrml::make_vec3f;
+
+        const std::vector<std::string> & type = nav_info.type();
+        a.terrain_following = false;
+        std::vector<std::string>::const_iterator t = type.begin();
+        for (; t != type.end(); ++t) {
+            if (*t == "WALK" || *t == "FLY") {
+                a.terrain_following = *t == "WALK";
+                break;
+            }
+            if (*t == "EXAMINE" || *t == "NONE") { return false; }
+        }
+
+        const std::vector<float> & size = nav_info.avatar_size();
+        a.radius = size.size() > 0 ? size[0] : 0.25f;
+        a.height = size.size() > 1 ? size[1] : 1.6f;
+        a.step   = size.size() > 2 ? size[2] : 0.75f;
+
+        //
+        // Up is the y-axis of the viewpoint's coordinate system.
+        //
+        const openvrml::mat4f & transformation = viewpoint.transformation();
+        a.up = (make_vec3f(0.0, 1.0, 0.0) * transformation
+                - make_vec3f(0.0, 0.0, 0.0) * transformation).normalize();
+        return true;
+    }
 }
 
 /**
@@ -465,6 +643,17 @@ const char openvrml::x_vrml_media_type[15] = "x-world/x-vrml";
  */
 const char openvrml::x3d_vrml_media_type[15] = "model/x3d-vrml";
 
+/**
+ * @brief X3D XML MIME media type.
+ */
+const char openvrml::x3d_xml_media_type[14] = "model/x3d+xml";
+
+/**
+ * @brief X3D compressed binary encoding MIME media type.
+ */
+const char openvrml::x3d_fast_infoset_media_type[22] =
+    "model/x3d+fastinfoset";
+
 /**
  * @class openvrml::resource_istream openvrml/browser.h
  *
@@ -1089,6 +1278,43 @@ openvrml::node_metatype_registry::register_node_metatype(
  * @brief The scene.
  */
 
+/**
+ * @internal
+ *
+ * @var const boost::scoped_ptr<openvrml::local::bounding_volume_hierarchy> openvrml::browser::bounding_volume_hierarchy_
+ *
+ * @brief World-space bounds of the nodes rendered by @c #render.
+ *
+ * This is declared first so that it outlives every node in the browser.
+ */
+
+/**
+ * @internal
+ *
+ * @var const boost::scoped_ptr<openvrml::local::occlusion_buffer> openvrml::browser::occlusion_buffer_
+ *
+ * @brief Occluders rendered by @c #render, and the culling counts for the
+ *        frame.
+ */
+
+/**
+ * @internal
+ *
+ * @var const boost::scoped_ptr<openvrml::local::pick_engine> openvrml::browser::pick_engine_
+ *
+ * @brief Triangles of the geometry inserted into the @c viewer, and where
+ *        @c #render last drew them; used by @c #pick.
+ */
+
+/**
+ * @internal
+ *
+ * @var const boost::scoped_ptr<openvrml::viewer> openvrml::browser::collision_viewer_
+ *
+ * @brief The @c viewer @c #render renders the geometry near the avatar to,
+ *        for @c #move_avatar.
+ */
+
 /**
  * @internal
  *
@@ -1152,6 +1378,61 @@ openvrml::node_metatype_registry::register_node_metatype(
  * These threads @b must be joined by the @c browser before it is destroyed.
  */
 
+/**
+ * @internal
+ *
+ * @var boost::mutex openvrml::browser::load_pool_mutex_
+ *
+ * @brief Mutex protecting @c #load_pool_.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::scoped_ptr<openvrml::local::thread_pool> openvrml::browser::load_pool_
+ *
+ * @brief The threads that fetch and parse scenes loaded with
+ *        @c scene::load_async.
+ *
+ * The pool is created when it is first needed.
+ */
+
+/**
+ * @internal
+ *
+ * @var const boost::scoped_ptr<openvrml::local::io_pool> openvrml::browser::io_pool_
+ *
+ * @brief The threads that read resources for @c scene::read_stream and
+ *        @c scene::create_vrml_from_url.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::mutex openvrml::browser::loaded_scenes_mutex_
+ *
+ * @brief Mutex protecting @c #loaded_scenes_.
+ */
+
+/**
+ * @internal
+ *
+ * @var std::list<openvrml::scene *> openvrml::browser::loaded_scenes_
+ *
+ * @brief Scenes that have been parsed by @c scene::load_async and are
+ *        waiting to be committed by @c #update.
+ */
+
+/**
+ * @internal
+ *
+ * @var const boost::scoped_ptr<openvrml::tessellation_service> openvrml::browser::tessellation_service_
+ *
+ * @brief Compiles the meshes of geometry nodes in the background.
+ *
+ * @sa #tessellation_service
+ */
+
 /**
  * @internal
  *
@@ -1299,6 +1580,313 @@ openvrml::node_metatype_registry::register_node_metatype(
  * @brief A list of all the TimeSensor @c node%s in the @c browser.
  */
 
+/**
+ * @internal
+ *
+ * @var boost::shared_mutex openvrml::browser::event_queue_mutex_
+ *
+ * @brief Mutex protecting @c #event_queue_.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::scoped_ptr<openvrml::local::event_queue> openvrml::browser::event_queue_
+ *
+ * @brief The queue used by @c #update when the queued event cascade is
+ *        enabled; null otherwise.
+ *
+ * @sa #queued_event_cascade
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::shared_mutex openvrml::browser::update_pool_mutex_
+ *
+ * @brief Mutex protecting @c #update_pool_ and @c #timer_scheduler_.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::scoped_ptr<openvrml::local::thread_pool> openvrml::browser::update_pool_
+ *
+ * @brief The worker threads used by @c #update to update independent
+ *        timers concurrently; null if timers are updated serially.
+ *
+ * @sa #update_threads
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::scoped_ptr<openvrml::local::timer_scheduler> openvrml::browser::timer_scheduler_
+ *
+ * @brief Partitions @c #timers_ for @c #update_pool_; null if timers are
+ *        updated serially.
+ */
+
+/**
+ * @struct openvrml::browser::event_statistics
+ *
+ * @brief Event counts for a call to @c browser::update.
+ *
+ * @sa #frame_event_statistics
+ */
+
+/**
+ * @var std::size_t openvrml::browser::event_statistics::enqueued
+ *
+ * @brief The number of events emitted.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::event_statistics::coalesced
+ *
+ * @brief The number of events that were superseded by a later event for the
+ *        same eventOut or eventIn and therefore not delivered.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::event_statistics::delivered
+ *
+ * @brief The number of events delivered to listeners.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::shared_mutex openvrml::browser::event_statistics_mutex_
+ *
+ * @brief Mutex protecting @c #event_statistics_.
+ */
+
+/**
+ * @internal
+ *
+ * @var openvrml::browser::event_statistics openvrml::browser::event_statistics_
+ *
+ * @brief Event counts for the most recent call to @c #update.
+ */
+
+/**
+ * @struct openvrml::browser::render_statistics
+ *
+ * @brief Culling counts for a call to @c browser::render.
+ *
+ * @sa #frame_render_statistics
+ */
+
+/**
+ * @var std::size_t openvrml::browser::render_statistics::culled
+ *
+ * @brief The number of nodes skipped because they were outside the view
+ *        volume.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::render_statistics::tested
+ *
+ * @brief The number of nodes tested against the occluders.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::render_statistics::occluded
+ *
+ * @brief The number of nodes skipped because they were hidden behind the
+ *        occluders.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::render_statistics::occluders
+ *
+ * @brief The number of occluders rendered.
+ */
+
+/**
+ * @struct openvrml::browser::pick_result
+ *
+ * @brief The nearest geometry hit by a ray passed to @c browser::pick.
+ */
+
+/**
+ * @var openvrml::node * openvrml::browser::pick_result::sensitive
+ *
+ * @brief The innermost sensitive node (see @c viewer::set_sensitive) the
+ *        geometry was drawn under; or 0 if it is not sensitive.
+ */
+
+/**
+ * @var const openvrml::geometry_node * openvrml::browser::pick_result::geometry
+ *
+ * @brief The geometry hit.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::browser::pick_result::point
+ *
+ * @brief The point hit, in world coordinates.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::browser::pick_result::normal
+ *
+ * @brief The unit surface normal at the point hit, in world coordinates.
+ */
+
+/**
+ * @var openvrml::vec2f openvrml::browser::pick_result::tex_coord
+ *
+ * @brief The texture coordinate at the point hit.
+ */
+
+/**
+ * @var float openvrml::browser::pick_result::distance
+ *
+ * @brief The distance from the origin of the ray to the point hit.
+ */
+
+/**
+ * @struct openvrml::browser::stream_statistics
+ *
+ * @brief The progress of a stream read by @c scene::read_stream.
+ *
+ * The stream's throughput is @c #bytes / @c #seconds.
+ */
+
+/**
+ * @var std::string openvrml::browser::stream_statistics::url
+ *
+ * @brief The URI of the stream.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::stream_statistics::bytes
+ *
+ * @brief The number of bytes read.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::stream_statistics::chunks
+ *
+ * @brief The number of chunks passed to the @c stream_listener.
+ */
+
+/**
+ * @var double openvrml::browser::stream_statistics::seconds
+ *
+ * @brief The time since reading started; or, if the stream is complete,
+ *        the time reading took.
+ */
+
+/**
+ * @var bool openvrml::browser::stream_statistics::complete
+ *
+ * @brief Whether the stream has been read.
+ */
+
+/**
+ * @struct openvrml::browser::io_statistics
+ *
+ * @brief The activity of the threads that read resources for
+ *        @c scene::read_stream and @c scene::create_vrml_from_url.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::io_statistics::threads
+ *
+ * @brief The number of threads.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::io_statistics::queued
+ *
+ * @brief The number of requests waiting for a thread.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::io_statistics::max_queued
+ *
+ * @brief The most requests that have waited for a thread at once.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::io_statistics::active
+ *
+ * @brief The number of requests being served.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::io_statistics::completed
+ *
+ * @brief The number of requests that have been served.
+ */
+
+/**
+ * @var std::size_t openvrml::browser::io_statistics::bytes
+ *
+ * @brief The number of bytes read by all streams.
+ */
+
+/**
+ * @var std::vector<openvrml::browser::stream_statistics> openvrml::browser::io_statistics::streams
+ *
+ * @brief The streams being read, followed by the most recent streams that
+ *        have been read; in the order they were opened.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::shared_mutex openvrml::browser::occlusion_culling_mutex_
+ *
+ * @brief Mutex protecting @c #occlusion_culling_.
+ */
+
+/**
+ * @internal
+ *
+ * @var bool openvrml::browser::occlusion_culling_
+ *
+ * @brief Whether @c #render culls nodes hidden behind occluders.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::shared_mutex openvrml::browser::render_statistics_mutex_
+ *
+ * @brief Mutex protecting @c #render_statistics_.
+ */
+
+/**
+ * @internal
+ *
+ * @var openvrml::browser::render_statistics openvrml::browser::render_statistics_
+ *
+ * @brief Culling counts for the most recent call to @c #render.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::shared_mutex openvrml::browser::scene_cache_directory_mutex_
+ *
+ * @brief Mutex protecting @c #scene_cache_directory_.
+ */
+
+/**
+ * @internal
+ *
+ * @var std::string openvrml::browser::scene_cache_directory_
+ *
+ * @brief The directory where scene snapshots are kept; empty if scene
+ *        snapshots are not used.
+ *
+ * @sa #scene_cache_directory
+ */
+
 /**
  * @internal
  *
@@ -1470,9 +2058,15 @@ openvrml::browser::browser(resource_fetcher & fetcher,
                            std::ostream & out,
                            std::ostream & err)
     OPENVRML_THROW1(std::bad_alloc):
+    bounding_volume_hierarchy_(new local::bounding_volume_hierarchy),
+    occlusion_buffer_(new local::occlusion_buffer),
+    pick_engine_(new local::pick_engine),
+    collision_viewer_(new collision_viewer),
     node_metatype_registry_(new node_metatype_registry(*this)),
     null_node_metatype_(new null_node_metatype(*this)),
     null_node_type_(new null_node_type(*null_node_metatype_)),
+    io_pool_(new local::io_pool),
+    tessellation_service_(new openvrml::tessellation_service),
     script_node_metatype_(*this),
     fetcher_(fetcher),
     scene_(new scene(*this)),
@@ -1488,10 +2082,16 @@ openvrml::browser::browser(resource_fetcher & fetcher,
     frame_rate_(0.0),
     out_(&out),
     err_(&err),
+    occlusion_culling_(false),
     flags_need_updating(false)
 {
     assert(this->active_viewpoint_);
     assert(this->active_navigation_info_);
+    const event_statistics no_events = { 0, 0, 0 };
+    this->event_statistics_ = no_events;
+    const render_statistics no_render = { 0, 0, 0, 0 };
+    this->render_statistics_ = no_render;
+    this->collision_viewer_->browser_ = this;
 }
 
 /**
@@ -1509,6 +2109,19 @@ openvrml::browser::~browser() OPENVRML_NOTHROW
 
     this->load_proto_thread_group_.join_all();
 
+    {
+        boost::lock_guard<boost::mutex> load_pool_lock(this->load_pool_mutex_);
+        if (this->load_pool_) {
+            this->load_pool_->wait();
+            this->load_pool_.reset();
+        }
+    }
+    {
+        boost::lock_guard<boost::mutex>
+            loaded_scenes_lock(this->loaded_scenes_mutex_);
+        this->loaded_scenes_.clear();
+    }
+
     const double now = browser::current_time();
 
     shared_lock<shared_mutex> scene_lock(this->scene_mutex_);
@@ -1906,7 +2519,9 @@ const std::string openvrml::browser::world_url() const
  * @param[in,out] in    an input stream.
  *
  * @exception bad_media_type    if @p in.type() is not @c model/vrml,
- *                              @c x-world/x-vrml, or @c model/x3d-vrml.
+ *                              @c x-world/x-vrml, @c model/x3d-vrml,
+ *                              @c model/x3d+xml, or
+ *                              @c model/x3d+fastinfoset.
  * @exception invalid_vrml      if @p in has invalid syntax.
  */
 void openvrml::browser::set_world(resource_istream & in)
@@ -2313,33 +2928,180 @@ void openvrml::browser::sensitive_event(node * const n,
     }
 }
 
+/**
+ * @brief Find the nearest geometry under a ray.
+ *
+ * Only geometry drawn by the last call to @c #render is considered; it is
+ * tested in the state it was drawn in, without rendering.  Geometry that
+ * has no surface (PointSet and IndexedLineSet) cannot be picked.
+ *
+ * @param[in] origin    the origin of the ray, in world coordinates.
+ * @param[in] direction the direction of the ray, in world coordinates.
+ * @param[out] result   the nearest geometry hit, if any.
+ *
+ * @return @c true if geometry was hit; @c false otherwise.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+bool openvrml::browser::pick(const vec3f & origin,
+                             const vec3f & direction,
+                             pick_result & result) const
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    local::pick_engine::hit hit;
+    if (!this->pick_engine_->pick(origin, direction, hit)) { return false; }
+    result.sensitive = hit.sensitive;
+    result.geometry = hit.geometry;
+    result.point = hit.point;
+    result.normal = hit.normal;
+    result.tex_coord = hit.tex_coord;
+    result.distance = hit.distance;
+    return true;
+}
+
+/**
+ * @brief Move the avatar, colliding with the geometry in its way.
+ *
+ * If the type of the active NavigationInfo is @c "WALK" or @c "FLY" (or
+ * @c "ANY", which is treated as @c "FLY"), the avatar described by its
+ * @c avatarSize is moved as far toward @p destination as the geometry near
+ * it lets it, sliding along what it hits.  Walking, the avatar also follows
+ * the terrain: it climbs onto anything no taller than the step height and
+ * falls onto anything lower.  Otherwise, @p destination is returned.
+ *
+ * Only geometry within the avatar's reach when @c #render last ran is
+ * considered.  Geometry under a Collision node whose @c collide field is
+ * @c FALSE is passed through; the @c proxy of a Collision node is collided
+ * with instead of its children.  Each Collision node whose geometry the
+ * avatar hits emits @c collideTime.
+ *
+ * The geometry is tested in the state @c #render left it in, without
+ * rendering or locking the scene; so this function may be called from a
+ * thread other than the one that renders.
+ *
+ * @param[in] position      the eye position, in world coordinates.
+ * @param[in] destination   where the eye is moving to, in world
+ *                          coordinates.
+ *
+ * @return the eye position the avatar reaches, in world coordinates.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const openvrml::vec3f
+openvrml::browser::move_avatar(const vec3f & position,
+                               const vec3f & destination)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    local::avatar a;
+    {
+        boost::shared_lock<boost::shared_mutex>
+            active_viewpoint_lock(this->active_viewpoint_mutex_);
+        if (!collision_avatar(this->active_navigation_info(),
+                              *this->active_viewpoint_,
+                              a)) {
+            return destination;
+        }
+    }
+
+    //
+    // The box around the move, the avatar's body, and the ground below it.
+    //
+    const float extent = a.radius + 2 * a.height;
+    vec3f minimum, maximum;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        minimum.vec[axis] =
+            std::min(position[axis], destination[axis]) - extent;
+        maximum.vec[axis] =
+            std::max(position[axis], destination[axis]) + extent;
+    }
+    std::vector<local::collision_triangle> triangles;
+    this->pick_engine_->collidable_triangles(minimum, maximum, triangles);
+
+    std::vector<grouping_node *> collisions;
+    const vec3f result = local::move_avatar(triangles, a,
+                                            position, destination,
+                                            collisions);
+    const double timestamp = browser::current_time();
+    for (std::vector<grouping_node *>::const_iterator group =
+             collisions.begin();
+         group != collisions.end();
+         ++group) {
+        (*group)->collide(timestamp);
+    }
+    if (!collisions.empty()) { this->modified(true); }
+    return result;
+}
+
 /**
  * @brief Process events (update the @c browser).
  *
  * This method should be called after each frame is rendered.
  *
+ * Scenes that have finished loading asynchronously (see
+ * @c scene::load_async) are attached first.  If any meshes have been
+ * compiled by the @c #tessellation_service since the last call, the
+ * @c browser is marked modified.
+ *
+ * If the queued event cascade is enabled, events emitted by the
+ * time-dependent nodes and then by the Script nodes are each queued and
+ * delivered breadth-first; otherwise they propagate depth-first as they are
+ * emitted.
+ *
  * @return @c true if the @c browser needs to be rerendered, @c false otherwise.
+ *
+ * @sa #queued_event_cascade
  */
 bool openvrml::browser::update(double current_time)
 {
     using std::for_each;
     using boost::shared_lock;
+    using boost::unique_lock;
     using boost::shared_mutex;
 
+    //
+    // Attach any scenes that have finished loading.  This must happen before
+    // the timers and scripts are locked, since initializing the new nodes
+    // may add to them.
+    //
+    this->commit_loaded_scenes();
+
+    //
+    // Meshes that have been compiled in the background since the last
+    // update replace the ones being drawn in the next frame.
+    //
+    if (this->tessellation_service_->take_ready()) { this->modified(true); }
+
     shared_lock<shared_mutex>
         timers_lock(this->timers_mutex_),
         scripts_lock(this->scripts_mutex_);
+    unique_lock<shared_mutex>
+        event_queue_lock(this->event_queue_mutex_),
+        update_pool_lock(this->update_pool_mutex_);
 
     if (current_time <= 0.0) { current_time = browser::current_time(); }
 
     this->delta_time = DEFAULT_DELTA;
 
+    local::event_queue * const queue = this->event_queue_.get();
+    local::event_queue::scope queue_scope(queue);
+    if (queue) { queue->reset_counters(); }
+
     //
-    // Update each of the timers.
+    // Update each of the timers.  Timers in components of the ROUTE graph
+    // that are independent of one another may be updated concurrently;
+    // either way, all of them have been updated before the scripts are.
     //
-    for_each(this->timers_.begin(), this->timers_.end(),
-             boost::bind2nd(boost::mem_fun(&time_dependent_node::update),
-                            current_time));
+    if (this->update_pool_) {
+        this->timer_scheduler_->update(this->timers_,
+                                       current_time,
+                                       *this->update_pool_,
+                                       queue);
+    } else {
+        for_each(this->timers_.begin(), this->timers_.end(),
+                 boost::bind2nd(boost::mem_fun(&time_dependent_node::update),
+                                current_time));
+    }
+    if (queue) { queue->drain(); }
 
     //
     // Update each of the scripts.
@@ -2347,11 +3109,417 @@ bool openvrml::browser::update(double current_time)
     for_each(this->scripts_.begin(), this->scripts_.end(),
              boost::bind2nd(boost::mem_fun(&script_node::update),
                             current_time));
+    if (queue) { queue->drain(); }
+
+    {
+        unique_lock<shared_mutex>
+            statistics_lock(this->event_statistics_mutex_);
+        if (queue) {
+            this->event_statistics_.enqueued = queue->enqueued();
+            this->event_statistics_.coalesced = queue->coalesced();
+            this->event_statistics_.delivered = queue->delivered();
+        } else {
+            const event_statistics no_events = { 0, 0, 0 };
+            this->event_statistics_ = no_events;
+        }
+    }
 
     // Signal a redisplay if necessary
     return this->modified();
 }
 
+/**
+ * @brief Enable or disable the queued event cascade.
+ *
+ * By default, an event emitted during @c #update is delivered to its
+ * listeners immediately; and any events they emit in turn are delivered
+ * recursively.  With the queued event cascade enabled, @c #update instead
+ * queues events per timestamp and delivers them breadth-first.  An eventOut
+ * that fires more than once before it is delivered sends only its last
+ * value; and when several events in the same generation are routed to the
+ * same eventIn, only the last is delivered.  This bounds the stack depth and
+ * avoids evaluating a node downstream of a deep fan-in once per incoming
+ * path.
+ *
+ * Events emitted outside @c #update (for example, by pointing device
+ * sensors) are always delivered immediately.
+ *
+ * @param[in] value @c true to enable the queued event cascade; @c false to
+ *                  disable it.
+ *
+ * @sa #frame_event_statistics
+ */
+void openvrml::browser::queued_event_cascade(const bool value)
+{
+    using boost::unique_lock;
+    using boost::shared_mutex;
+    unique_lock<shared_mutex> lock(this->event_queue_mutex_);
+    if (value == (this->event_queue_.get() != 0)) { return; }
+    if (value) {
+        this->event_queue_.reset(new local::event_queue);
+    } else {
+        //
+        // Deliver anything left over from an update that was interrupted by
+        // an exception.
+        //
+        local::event_queue::scope queue_scope(this->event_queue_.get());
+        this->event_queue_->drain();
+        this->event_queue_.reset();
+    }
+}
+
+/**
+ * @brief Whether the queued event cascade is enabled.
+ *
+ * @return @c true if the queued event cascade is enabled; @c false
+ *         otherwise.
+ *
+ * @sa #queued_event_cascade(bool)
+ */
+bool openvrml::browser::queued_event_cascade() const
+{
+    using boost::shared_lock;
+    using boost::shared_mutex;
+    shared_lock<shared_mutex> lock(this->event_queue_mutex_);
+    return this->event_queue_.get() != 0;
+}
+
+/**
+ * @brief Set the number of threads used to update time-dependent nodes.
+ *
+ * By default, @c #update updates time-dependent nodes (such as TimeSensors)
+ * one at a time on the calling thread.  When @p threads is greater than 1,
+ * @c #update partitions them into groups that are not connected by ROUTEs
+ * (directly or through other nodes) and updates the groups concurrently on
+ * a pool of <code>threads - 1</code> worker threads and the calling thread.
+ * Within a group, timers are updated in the same order as they would be
+ * serially; and @c #update does not return until every group has been
+ * updated.
+ *
+ * Groups that include a Script node, a PROTO instance, a bindable node or
+ * an Inline node are always updated on the calling thread, as are groups
+ * with an eventOut that has a listener that is not a node.
+ *
+ * @param[in] threads   the number of threads; 0 or 1 selects serial
+ *                      updates.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if a thread cannot be started.
+ */
+void openvrml::browser::update_threads(const std::size_t threads)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error)
+{
+    using boost::unique_lock;
+    using boost::shared_mutex;
+    unique_lock<shared_mutex> lock(this->update_pool_mutex_);
+    if (threads <= 1) {
+        this->update_pool_.reset();
+        this->timer_scheduler_.reset();
+        return;
+    }
+    if (this->update_pool_ && this->update_pool_->size() == threads - 1) {
+        return;
+    }
+    if (!this->timer_scheduler_) {
+        this->timer_scheduler_.reset(new local::timer_scheduler);
+    }
+    this->update_pool_.reset();
+    this->update_pool_.reset(new local::thread_pool(threads - 1));
+}
+
+/**
+ * @brief The number of threads used to update time-dependent nodes.
+ *
+ * @return the number of threads used to update time-dependent nodes.
+ *
+ * @sa #update_threads(std::size_t)
+ */
+std::size_t openvrml::browser::update_threads() const
+{
+    using boost::shared_lock;
+    using boost::shared_mutex;
+    shared_lock<shared_mutex> lock(this->update_pool_mutex_);
+    return this->update_pool_ ? this->update_pool_->size() + 1 : 1;
+}
+
+/**
+ * @brief Set the number of threads that read resources.
+ *
+ * Streams passed to @c scene::read_stream (such as the images of
+ * ImageTexture nodes) and the URIs passed to @c #create_vrml_from_url are
+ * read on a fixed pool of threads.  Requests beyond that many wait for a
+ * thread to become free.  The default is 8.
+ *
+ * Requests that have already been made are completed on the old threads;
+ * this function does not return until they have been.
+ *
+ * @param[in] threads   the number of threads; 0 is taken as 1.
+ */
+void openvrml::browser::io_threads(const std::size_t threads)
+    OPENVRML_NOTHROW
+{
+    this->io_pool_->threads(threads);
+}
+
+/**
+ * @brief The number of threads that read resources.
+ *
+ * @return the number of threads that read resources.
+ *
+ * @sa #io_threads(std::size_t)
+ */
+std::size_t openvrml::browser::io_threads() const OPENVRML_NOTHROW
+{
+    return this->io_pool_->threads();
+}
+
+/**
+ * @brief The activity of the threads that read resources.
+ *
+ * @return the depth of the request queue and the progress of the streams
+ *         being read and recently read.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ *
+ * @sa #io_threads(std::size_t)
+ */
+const openvrml::browser::io_statistics
+openvrml::browser::stream_io_statistics() const
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    return this->io_pool_->statistics();
+}
+
+/**
+ * @brief Reset the counters returned by @c #stream_io_statistics.
+ *
+ * The statistics of streams that have been read are discarded; and the
+ * most requests queued is reset to the number queued now.
+ */
+void openvrml::browser::reset_io_statistics() OPENVRML_NOTHROW
+{
+    this->io_pool_->reset_statistics();
+}
+
+/**
+ * @brief Set the directory where scene snapshots are kept.
+ *
+ * When a world, an Inline or an EXTERNPROTO in the VRML97 or X3D VRML
+ * encoding is parsed, the sequence of parse actions (including PROTO and
+ * EXTERNPROTO definitions, DEF names and ROUTEs) is saved to a compact
+ * binary snapshot in @p directory.  The next time the same resource is
+ * loaded, if its size and checksums match those recorded in the snapshot,
+ * the snapshot is memory-mapped and replayed instead of parsing the
+ * resource again.  Snapshots are also specific to the library version and
+ * to the machine byte order.
+ *
+ * Snapshots are not made for data passed to @c #create_vrml_from_stream.
+ *
+ * @param[in] directory the snapshot directory; if empty, snapshots are
+ *                      neither read nor written.  The directory is created
+ *                      when the first snapshot is written.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::browser::scene_cache_directory(const std::string & directory)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    using boost::unique_lock;
+    using boost::shared_mutex;
+    unique_lock<shared_mutex> lock(this->scene_cache_directory_mutex_);
+    this->scene_cache_directory_ = directory;
+}
+
+/**
+ * @brief The directory where scene snapshots are kept.
+ *
+ * @return the directory where scene snapshots are kept; or an empty string
+ *         if scene snapshots are not used.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ *
+ * @sa #scene_cache_directory(const std::string &)
+ */
+const std::string openvrml::browser::scene_cache_directory() const
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    using boost::shared_lock;
+    using boost::shared_mutex;
+    shared_lock<shared_mutex> lock(this->scene_cache_directory_mutex_);
+    return this->scene_cache_directory_;
+}
+
+/**
+ * @brief The service that compiles the meshes of geometry nodes in the
+ *        background.
+ *
+ * Geometry nodes whose meshes are expensive to compile pass them to this
+ * service when their fields change; so that the rendering thread does not
+ * wait for them.  Applications may adjust its
+ * @c tessellation_service::async_threshold and read its latency statistics.
+ *
+ * @return the @c tessellation_service.
+ */
+openvrml::tessellation_service &
+openvrml::browser::tessellation_service() const OPENVRML_NOTHROW
+{
+    return *this->tessellation_service_;
+}
+
+/**
+ * @internal
+ *
+ * @brief Run @p load on a loader thread.
+ *
+ * @param[in] load  a function that fetches and parses a scene.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if the loader threads cannot be
+ *                                          created.
+ */
+void openvrml::browser::load_async(const boost::function0<void> & load)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error)
+{
+    boost::lock_guard<boost::mutex> lock(this->load_pool_mutex_);
+    if (!this->load_pool_) {
+        //
+        // Fetching is largely I/O-bound; so use at least two threads even on
+        // a single processor.
+        //
+        this->load_pool_.reset(
+            new local::thread_pool(
+                (std::max)(boost::thread::hardware_concurrency(), 2U)));
+    }
+    this->load_pool_->submit(load);
+}
+
+/**
+ * @internal
+ *
+ * @brief Note that @p s has been parsed and should be committed by the next
+ *        call to @c #update.
+ *
+ * @param[in] s a @c scene.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::browser::scene_parsed(scene & s) OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::lock_guard<boost::mutex> lock(this->loaded_scenes_mutex_);
+    this->loaded_scenes_.push_back(&s);
+}
+
+/**
+ * @internal
+ *
+ * @brief Forget @p s if it is waiting to be committed.
+ *
+ * @param[in] s a @c scene that is being destroyed.
+ */
+void openvrml::browser::discard_loaded_scene(scene & s) OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->loaded_scenes_mutex_);
+    this->loaded_scenes_.remove(&s);
+}
+
+/**
+ * @internal
+ *
+ * @brief Commit the scenes that have been parsed since the last call.
+ *
+ * The parsed @c node%s of each @c scene are attached and the @c scene is
+ * initialized on the calling thread.
+ */
+void openvrml::browser::commit_loaded_scenes() OPENVRML_NOTHROW
+{
+    std::list<scene *> loaded;
+    {
+        boost::lock_guard<boost::mutex> lock(this->loaded_scenes_mutex_);
+        loaded.swap(this->loaded_scenes_);
+    }
+    if (loaded.empty()) { return; }
+    for (std::list<scene *>::const_iterator s = loaded.begin();
+         s != loaded.end();
+         ++s) {
+        (*s)->commit_load();
+    }
+    this->modified(true);
+}
+
+/**
+ * @brief Event counts for the most recent call to @c #update.
+ *
+ * The counts are zero if the queued event cascade was not enabled.
+ *
+ * @return event counts for the most recent call to @c #update.
+ *
+ * @sa #queued_event_cascade(bool)
+ */
+const openvrml::browser::event_statistics
+openvrml::browser::frame_event_statistics() const
+{
+    using boost::shared_lock;
+    using boost::shared_mutex;
+    shared_lock<shared_mutex> lock(this->event_statistics_mutex_);
+    return this->event_statistics_;
+}
+
+/**
+ * @brief Enable or disable occlusion culling.
+ *
+ * When occlusion culling is enabled, @c #render skips nodes whose bounding
+ * volumes are hidden behind opaque occluders (such as Box geometry) rendered
+ * before them.  The occluders are rasterized into a low-resolution depth
+ * buffer in software, so no graphics hardware support is needed.  It is
+ * most effective in dense, enclosed scenes such as building interiors.
+ *
+ * Occlusion culling is disabled by default.  A node can disable it for its
+ * descendants with @c rendering_context::occlusion_culling.
+ *
+ * @param[in] enable    @c true to enable occlusion culling; @c false to
+ *                      disable it.
+ *
+ * @sa #frame_render_statistics
+ */
+void openvrml::browser::occlusion_culling(const bool enable)
+{
+    using boost::unique_lock;
+    using boost::shared_mutex;
+    unique_lock<shared_mutex> lock(this->occlusion_culling_mutex_);
+    this->occlusion_culling_ = enable;
+}
+
+/**
+ * @brief Whether occlusion culling is enabled.
+ *
+ * @return @c true if occlusion culling is enabled; @c false otherwise.
+ *
+ * @sa #occlusion_culling(bool)
+ */
+bool openvrml::browser::occlusion_culling() const
+{
+    using boost::shared_lock;
+    using boost::shared_mutex;
+    shared_lock<shared_mutex> lock(this->occlusion_culling_mutex_);
+    return this->occlusion_culling_;
+}
+
+/**
+ * @brief Culling counts for the most recent call to @c #render.
+ *
+ * @return culling counts for the most recent call to @c #render.
+ *
+ * @sa #occlusion_culling(bool)
+ */
+const openvrml::browser::render_statistics
+openvrml::browser::frame_render_statistics() const
+{
+    using boost::shared_lock;
+    using boost::shared_mutex;
+    shared_lock<shared_mutex> lock(this->render_statistics_mutex_);
+    return this->render_statistics_;
+}
+
 /**
  * @brief Indicate whether the headlight is on.
  *
@@ -2378,6 +3546,8 @@ void openvrml::browser::render()
 
     if (!this->viewer_) { return; }
 
+    this->update_flags();
+
     if (this->new_view) {
         this->viewer_->reset_user_navigation();
         this->new_view = false;
@@ -2431,6 +3601,15 @@ void openvrml::browser::render()
     mat4f modelview = t.inverse();
     rendering_context rc(bounding_volume::partial, modelview);
     rc.draw_bounding_spheres = true;
+    rc.hierarchy_ = this->bounding_volume_hierarchy_.get();
+    rc.entry_ = &this->bounding_volume_hierarchy_->begin_frame(
+        this->viewer_->frustum(), modelview);
+    rc.entered_modelview_ = &modelview;
+    rc.occlusion_ = this->occlusion_buffer_.get();
+    rc.occlusion_culling(this->occlusion_culling());
+    this->occlusion_buffer_->begin_frame(this->viewer_->frustum());
+    rc.picks_ = this->pick_engine_.get();
+    this->pick_engine_->begin_frame(t);
 
     // Do the browser-level lights (Points and Spots)
     {
@@ -2449,6 +3628,35 @@ void openvrml::browser::render()
     if (this->scene_) {
         this->scene_->render(*this->viewer_, rc);
     }
+    rc.leave();
+
+    //
+    // Gather the geometry within the avatar's reach, drawn or not, for
+    // move_avatar.
+    //
+    local::avatar a;
+    if (this->scene_
+        && collision_avatar(nav_info, *this->active_viewpoint_, a)) {
+        mat4f collision_modelview = t.inverse();
+        rendering_context collision_rc(bounding_volume::partial,
+                                       collision_modelview);
+        collision_rc.picks_ = this->pick_engine_.get();
+        collision_rc.collision_only_ = true;
+        collision_rc.collision_reach_ =
+            a.radius + 2 * a.height + nav_info.speed();
+        this->scene_->render(*this->collision_viewer_, collision_rc);
+    }
+    this->pick_engine_->end_frame();
+
+    {
+        boost::unique_lock<shared_mutex>
+            statistics_lock(this->render_statistics_mutex_);
+        this->render_statistics_.culled = this->occlusion_buffer_->culled;
+        this->render_statistics_.tested = this->occlusion_buffer_->tested;
+        this->render_statistics_.occluded = this->occlusion_buffer_->occluded;
+        this->render_statistics_.occluders =
+            this->occlusion_buffer_->occluders;
+    }
 
     this->viewer_->end_object();
 
@@ -2634,17 +3842,19 @@ openvrml::browser::remove_time_dependent(time_dependent_node & n)
  *
  * The invariant is that if a <code>node</code>'s bounding volume is out of
  * date, then the bounding volumes of all that <code>node</code>'s ancestors
- * must be out of date.  However, @c node does not maintain a parent pointer.
- * So we must do a traversal of the entire browser graph to do the
- * propagation.
+ * must be out of date.  @c node does not maintain a parent pointer; but the
+ * bounding volume hierarchy built by @c #render records where each node was
+ * last rendered.  Nodes that have not been rendered have no ancestors whose
+ * cached bounding volumes could be out of date.
+ *
+ * This is called at the start of @c #render.
  *
- * @see node::setBVolumeDirty
- * @see node::isBVolumeDirty
+ * @see bounded_volume_node::bounding_volume_dirty
  */
 void openvrml::browser::update_flags()
 {
-//  Node* root = this->getRoot();
-//  root->updateModified(0x002);
+    this->flags_need_updating = false;
+    this->bounding_volume_hierarchy_->update();
 }
 
 /**
@@ -23,12 +23,15 @@
 #   define OPENVRML_BROWSER_H
 
 #   include <openvrml/script.h>
+#   include <boost/function.hpp>
 
 namespace openvrml {
 
     OPENVRML_API extern const char vrml_media_type[11];
     OPENVRML_API extern const char x_vrml_media_type[15];
     OPENVRML_API extern const char x3d_vrml_media_type[15];
+    OPENVRML_API extern const char x3d_xml_media_type[14];
+    OPENVRML_API extern const char x3d_fast_infoset_media_type[22];
 
     OPENVRML_API
     std::auto_ptr<node_type_decls> profile(const std::string & profile_id)
@@ -175,6 +178,7 @@ namespace openvrml {
 
     class viewer;
     class scene;
+    class tessellation_service;
 
     namespace local {
         struct vrml97_parse_actions;
@@ -190,11 +194,20 @@ namespace openvrml {
         class externproto_node;
         class externproto_node_type;
         class externproto_node_metatype;
+        class event_queue;
+        class thread_pool;
+        class timer_scheduler;
+        class bounding_volume_hierarchy;
+        class occlusion_buffer;
+        class pick_engine;
+        class io_pool;
     }
 
     class OPENVRML_API browser : boost::noncopyable {
         friend class scene;
         friend class script_node;
+        friend class bounded_volume_node;
+        friend class viewer;
         friend bool OPENVRML_API operator==(const node_type &,
                                             const node_type &)
             OPENVRML_NOTHROW;
@@ -215,6 +228,12 @@ namespace openvrml {
                           std::vector<boost::intrusive_ptr<node> > & nodes,
                           std::map<std::string, std::string> & meta);
 
+        const boost::scoped_ptr<local::bounding_volume_hierarchy>
+            bounding_volume_hierarchy_;
+        const boost::scoped_ptr<local::occlusion_buffer> occlusion_buffer_;
+        const boost::scoped_ptr<local::pick_engine> pick_engine_;
+        const boost::scoped_ptr<openvrml::viewer> collision_viewer_;
+
         mutable boost::shared_mutex node_metatype_registry_mutex_;
         boost::scoped_ptr<node_metatype_registry> node_metatype_registry_;
 
@@ -225,6 +244,18 @@ namespace openvrml {
         boost::scoped_ptr<boost::thread> load_root_scene_thread_;
 
         boost::thread_group load_proto_thread_group_;
+
+        boost::mutex load_pool_mutex_;
+        boost::scoped_ptr<local::thread_pool> load_pool_;
+
+        const boost::scoped_ptr<local::io_pool> io_pool_;
+
+        boost::mutex loaded_scenes_mutex_;
+        std::list<scene *> loaded_scenes_;
+
+        const boost::scoped_ptr<openvrml::tessellation_service>
+            tessellation_service_;
+
         script_node_metatype script_node_metatype_;
         resource_fetcher & fetcher_;
 
@@ -254,6 +285,13 @@ namespace openvrml {
         boost::shared_mutex timers_mutex_;
         std::list<time_dependent_node *> timers_;
 
+        mutable boost::shared_mutex event_queue_mutex_;
+        boost::scoped_ptr<local::event_queue> event_queue_;
+
+        mutable boost::shared_mutex update_pool_mutex_;
+        boost::scoped_ptr<local::thread_pool> update_pool_;
+        boost::scoped_ptr<local::timer_scheduler> timer_scheduler_;
+
         boost::shared_mutex listeners_mutex_;
         std::set<browser_listener *> listeners_;
 
@@ -277,6 +315,66 @@ namespace openvrml {
         mutable boost::mutex err_mutex_;
         std::ostream * const err_;
 
+    public:
+        struct event_statistics {
+            std::size_t enqueued;
+            std::size_t coalesced;
+            std::size_t delivered;
+        };
+
+        struct render_statistics {
+            std::size_t culled;
+            std::size_t tested;
+            std::size_t occluded;
+            std::size_t occluders;
+        };
+
+        struct pick_result {
+            node * sensitive;
+            const geometry_node * geometry;
+            vec3f point;
+            vec3f normal;
+            vec2f tex_coord;
+            float distance;
+        };
+
+        struct stream_statistics {
+            std::string url;
+            std::size_t bytes;
+            std::size_t chunks;
+            double seconds;
+            bool complete;
+        };
+
+        struct io_statistics {
+            std::size_t threads;
+            std::size_t queued;
+            std::size_t max_queued;
+            std::size_t active;
+            std::size_t completed;
+            std::size_t bytes;
+            std::vector<stream_statistics> streams;
+        };
+
+    private:
+        mutable boost::shared_mutex event_statistics_mutex_;
+        event_statistics event_statistics_;
+
+        mutable boost::shared_mutex occlusion_culling_mutex_;
+        bool occlusion_culling_;
+
+        mutable boost::shared_mutex render_statistics_mutex_;
+        render_statistics render_statistics_;
+
+        mutable boost::shared_mutex scene_cache_directory_mutex_;
+        std::string scene_cache_directory_;
+
+        void load_async(const boost::function0<void> & load)
+            OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error);
+        void scene_parsed(scene & s) OPENVRML_THROW1(std::bad_alloc);
+        void discard_loaded_scene(scene & s) OPENVRML_NOTHROW;
+        void commit_loaded_scenes() OPENVRML_NOTHROW;
+
     public:
         static double current_time() OPENVRML_NOTHROW;
 
@@ -339,11 +437,38 @@ namespace openvrml {
         void sensitive_event(node * object, double timestamp,
                              bool is_over, bool is_active,
                              const double (&point)[3]);
+        bool pick(const vec3f & origin, const vec3f & direction,
+                  pick_result & result) const
+            OPENVRML_THROW1(std::bad_alloc);
+        const vec3f move_avatar(const vec3f & position,
+                                const vec3f & destination)
+            OPENVRML_THROW1(std::bad_alloc);
 
         double frame_rate() const;
 
         bool update(double current_time = -1.0);
 
+        void queued_event_cascade(bool value);
+        bool queued_event_cascade() const;
+        const event_statistics frame_event_statistics() const;
+        void occlusion_culling(bool enable);
+        bool occlusion_culling() const;
+        const render_statistics frame_render_statistics() const;
+        void update_threads(std::size_t threads)
+            OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error);
+        std::size_t update_threads() const;
+        void io_threads(std::size_t threads) OPENVRML_NOTHROW;
+        std::size_t io_threads() const OPENVRML_NOTHROW;
+        const io_statistics stream_io_statistics() const
+            OPENVRML_THROW1(std::bad_alloc);
+        void reset_io_statistics() OPENVRML_NOTHROW;
+        void scene_cache_directory(const std::string & directory)
+            OPENVRML_THROW1(std::bad_alloc);
+        const std::string scene_cache_directory() const
+            OPENVRML_THROW1(std::bad_alloc);
+        openvrml::tessellation_service & tessellation_service() const
+            OPENVRML_NOTHROW;
+
         void render();
 
         void modified(bool value);
@@ -0,0 +1,1216 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "compiled_mesh.h"
+# include "viewer.h"
+# include <openvrml/local/float.h>
+# include <algorithm>
+# include <cassert>
+# include <cmath>
+# include <iterator>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+/**
+ * @file openvrml/compiled_mesh.h
+ *
+ * @brief Definition of @c openvrml::compiled_mesh.
+ */
+
+namespace {
+
+    using openvrml::int32;
+    using openvrml::vec2f;
+    using openvrml::vec3f;
+
+    //
+    // Texture coordinates are generated from the bounding box of the
+    // coordinates: s along its longest side and t along the second longest.
+    //
+    class OPENVRML_LOCAL tex_coord_generator {
+        size_t axis_[2];
+        float origin_[2];
+        float scale_[2];
+
+    public:
+        explicit tex_coord_generator(const std::vector<vec3f> & coord);
+
+        bool degenerate() const OPENVRML_NOTHROW;
+        const vec2f operator()(const vec3f & coord) const OPENVRML_NOTHROW;
+    };
+
+    tex_coord_generator::
+    tex_coord_generator(const std::vector<vec3f> & coord)
+    {
+        float bounds[6] = {}; // xmin, xmax, ymin, ymax, zmin, zmax
+        if (!coord.empty()) {
+            for (size_t i = 0; i < 3; ++i) {
+                bounds[2 * i] = bounds[2 * i + 1] = coord.front()[i];
+            }
+        }
+        for (std::vector<vec3f>::const_iterator c = coord.begin();
+             c != coord.end();
+             ++c) {
+            for (size_t i = 0; i < 3; ++i) {
+                if ((*c)[i] < bounds[2 * i]) {
+                    bounds[2 * i] = (*c)[i];
+                } else if ((*c)[i] > bounds[2 * i + 1]) {
+                    bounds[2 * i + 1] = (*c)[i];
+                }
+            }
+        }
+
+        this->axis_[0] = 0;
+        this->axis_[1] = 1;
+        float size[2] = { 0.0f, 0.0f };
+        this->origin_[0] = this->origin_[1] = 0.0f;
+        for (size_t i = 0; i < 3; ++i) {
+            const float extent = bounds[2 * i + 1] - bounds[2 * i];
+            if (extent > size[0]) {
+                this->axis_[1] = this->axis_[0];
+                this->origin_[1] = this->origin_[0];
+                size[1] = size[0];
+                this->axis_[0] = i;
+                this->origin_[0] = bounds[2 * i];
+                size[0] = extent;
+            } else if (extent > size[1]) {
+                this->axis_[1] = i;
+                this->origin_[1] = bounds[2 * i];
+                size[1] = extent;
+            }
+        }
+
+        using openvrml::local::fequal;
+        for (size_t i = 0; i < 2; ++i) {
+            this->scale_[i] = fequal(size[i], 0.0f) ? 0.0f : 1.0f / size[i];
+        }
+    }
+
+    //
+    // If two of the dimensions are zero, there is nothing to draw.
+    //
+    bool tex_coord_generator::degenerate() const OPENVRML_NOTHROW
+    {
+        return this->scale_[0] == 0.0f || this->scale_[1] == 0.0f;
+    }
+
+    const vec2f
+    tex_coord_generator::operator()(const vec3f & coord) const
+        OPENVRML_NOTHROW
+    {
+        return openvrml::make_vec2f(
+            (coord[this->axis_[0]] - this->origin_[0]) * this->scale_[0],
+            (coord[this->axis_[1]] - this->origin_[1]) * this->scale_[1]);
+    }
+
+
+    //
+    // Split the faces of an IndexedFaceSet into triangles.  Faces share a
+    // vertex where its coordinate and all of its other attributes are the
+    // same.
+    //
+    class OPENVRML_LOCAL mesh_builder {
+        struct vertex_key {
+            long normal, color, tex_coord;
+        };
+
+        static const int32 no_vertex = -1;
+
+        const unsigned int mask_;
+        const std::vector<vec3f> & coord_;
+        const std::vector<int32> & coord_index_;
+        const std::vector<openvrml::color> & color_;
+        const std::vector<int32> & color_index_;
+        const std::vector<vec3f> & normal_;
+        const std::vector<int32> & normal_index_;
+        const std::vector<vec2f> & tex_coord_;
+        const std::vector<int32> & tex_coord_index_;
+        const float crease_angle_;
+        const tex_coord_generator generate_tex_coord_;
+
+        //
+        // The corners of face f are
+        // corners_[face_begin_[f], face_begin_[f + 1]).
+        //
+        std::vector<size_t> corners_;
+        std::vector<size_t> face_begin_;
+        std::vector<vec3f> face_normal_;
+
+        //
+        // The faces adjacent to coordinate c are
+        // coord_faces_[coord_face_begin_[c], coord_face_begin_[c + 1]).
+        //
+        std::vector<size_t> coord_face_begin_;
+        std::vector<size_t> coord_faces_;
+
+        std::vector<int32> first_vertex_; // For each coordinate.
+        std::vector<int32> next_vertex_;  // For each vertex.
+        std::vector<vertex_key> keys_;    // For each vertex.
+
+        std::vector<vec3f> & mesh_coord_;
+        std::vector<vec3f> & mesh_normal_;
+        std::vector<openvrml::color> & mesh_color_;
+        std::vector<vec2f> & mesh_tex_coord_;
+        std::vector<int32> & mesh_index_;
+
+    public:
+        mesh_builder(unsigned int mask,
+                     const std::vector<vec3f> & coord,
+                     const std::vector<int32> & coord_index,
+                     const std::vector<openvrml::color> & color,
+                     const std::vector<int32> & color_index,
+                     const std::vector<vec3f> & normal,
+                     const std::vector<int32> & normal_index,
+                     const std::vector<vec2f> & tex_coord,
+                     const std::vector<int32> & tex_coord_index,
+                     float crease_angle,
+                     std::vector<vec3f> & mesh_coord,
+                     std::vector<vec3f> & mesh_normal,
+                     std::vector<openvrml::color> & mesh_color,
+                     std::vector<vec2f> & mesh_tex_coord,
+                     std::vector<int32> & mesh_index);
+
+        void build() OPENVRML_THROW1(std::bad_alloc);
+
+    private:
+        void collect_faces() OPENVRML_THROW1(std::bad_alloc);
+        void collect_coord_faces() OPENVRML_THROW1(std::bad_alloc);
+        const vec3f face_normal(size_t face) const OPENVRML_NOTHROW;
+        const vec3f smooth_normal(size_t face, size_t coord_index) const
+            OPENVRML_NOTHROW;
+        int32 add_vertex(size_t face, size_t corner)
+            OPENVRML_THROW1(std::bad_alloc);
+        void add_polygon(const std::vector<int32> & polygon,
+                         const vec3f & normal)
+            OPENVRML_THROW1(std::bad_alloc);
+    };
+
+    const int32 mesh_builder::no_vertex;
+
+    mesh_builder::
+    mesh_builder(const unsigned int mask,
+                 const std::vector<vec3f> & coord,
+                 const std::vector<int32> & coord_index,
+                 const std::vector<openvrml::color> & color,
+                 const std::vector<int32> & color_index,
+                 const std::vector<vec3f> & normal,
+                 const std::vector<int32> & normal_index,
+                 const std::vector<vec2f> & tex_coord,
+                 const std::vector<int32> & tex_coord_index,
+                 const float crease_angle,
+                 std::vector<vec3f> & mesh_coord,
+                 std::vector<vec3f> & mesh_normal,
+                 std::vector<openvrml::color> & mesh_color,
+                 std::vector<vec2f> & mesh_tex_coord,
+                 std::vector<int32> & mesh_index):
+        mask_(mask),
+        coord_(coord),
+        coord_index_(coord_index),
+        color_(color),
+        color_index_(color_index),
+        normal_(normal),
+        normal_index_(normal_index),
+        tex_coord_(tex_coord),
+        tex_coord_index_(tex_coord_index),
+        crease_angle_(crease_angle),
+        generate_tex_coord_(tex_coord.empty() ? coord
+                                              : std::vector<vec3f>()),
+        mesh_coord_(mesh_coord),
+        mesh_normal_(mesh_normal),
+        mesh_color_(mesh_color),
+        mesh_tex_coord_(mesh_tex_coord),
+        mesh_index_(mesh_index)
+    {}
+
+    void mesh_builder::build() OPENVRML_THROW1(std::bad_alloc)
+    {
+        // 3 points and a trailing -1.
+        if (this->coord_.empty() || this->coord_index_.size() < 4) { return; }
+        if (this->tex_coord_.empty()
+            && this->generate_tex_coord_.degenerate()) {
+            return;
+        }
+
+        this->collect_faces();
+        if (this->normal_.empty() && this->crease_angle_ > 0.0f) {
+            this->collect_coord_faces();
+        }
+
+        this->first_vertex_.assign(this->coord_.size(), no_vertex);
+        this->mesh_index_.reserve(this->coord_index_.size()
+                                  + this->coord_index_.size() / 4);
+
+        std::vector<int32> polygon;
+        for (size_t face = 0; face + 1 < this->face_begin_.size(); ++face) {
+            const size_t begin = this->face_begin_[face],
+                end = this->face_begin_[face + 1];
+            if (end - begin < 3) { continue; }
+            polygon.clear();
+            for (size_t corner = begin; corner != end; ++corner) {
+                polygon.push_back(this->add_vertex(face, corner));
+            }
+            this->add_polygon(polygon, this->face_normal_[face]);
+        }
+    }
+
+    void mesh_builder::collect_faces() OPENVRML_THROW1(std::bad_alloc)
+    {
+        this->corners_.reserve(this->coord_index_.size());
+        this->face_begin_.push_back(0);
+        for (size_t i = 0; i < this->coord_index_.size(); ++i) {
+            const int32 index = this->coord_index_[i];
+            if (index >= 0) {
+                if (size_t(index) < this->coord_.size()) {
+                    this->corners_.push_back(i);
+                }
+                //
+                // Watch out for no terminating -1 in face list.
+                //
+                if (i < this->coord_index_.size() - 1) { continue; }
+            }
+            this->face_begin_.push_back(this->corners_.size());
+        }
+
+        this->face_normal_.resize(this->face_begin_.size() - 1);
+        for (size_t face = 0; face < this->face_normal_.size(); ++face) {
+            this->face_normal_[face] = this->face_normal(face);
+        }
+    }
+
+    void mesh_builder::collect_coord_faces() OPENVRML_THROW1(std::bad_alloc)
+    {
+        this->coord_face_begin_.assign(this->coord_.size() + 1, 0);
+        for (size_t face = 0; face + 1 < this->face_begin_.size(); ++face) {
+            for (size_t corner = this->face_begin_[face];
+                 corner != this->face_begin_[face + 1];
+                 ++corner) {
+                ++this->coord_face_begin_[
+                    size_t(this->coord_index_[this->corners_[corner]]) + 1];
+            }
+        }
+        for (size_t c = 1; c < this->coord_face_begin_.size(); ++c) {
+            this->coord_face_begin_[c] += this->coord_face_begin_[c - 1];
+        }
+
+        std::vector<size_t> next(this->coord_face_begin_.begin(),
+                                 this->coord_face_begin_.end() - 1);
+        this->coord_faces_.resize(this->coord_face_begin_.back());
+        for (size_t face = 0; face + 1 < this->face_begin_.size(); ++face) {
+            for (size_t corner = this->face_begin_[face];
+                 corner != this->face_begin_[face + 1];
+                 ++corner) {
+                const size_t c =
+                    size_t(this->coord_index_[this->corners_[corner]]);
+                this->coord_faces_[next[c]++] = face;
+            }
+        }
+    }
+
+    //
+    // Newell's method is used so that the normal of a nonconvex face is
+    // correct.  The normal is flipped if the faces are wound clockwise.
+    //
+    const vec3f mesh_builder::face_normal(const size_t face) const
+        OPENVRML_NOTHROW
+    {
+        const size_t begin = this->face_begin_[face],
+            end = this->face_begin_[face + 1];
+        vec3f normal = openvrml::make_vec3f();
+        for (size_t i = begin; i != end; ++i) {
+            const vec3f & a =
+                this->coord_[size_t(this->coord_index_[this->corners_[i]])];
+            const vec3f & b =
+                this->coord_[
+                    size_t(this->coord_index_[
+                               this->corners_[(i + 1 == end) ? begin
+                                                             : i + 1]])];
+            normal.x(normal.x() + (a.y() - b.y()) * (a.z() + b.z()));
+            normal.y(normal.y() + (a.z() - b.z()) * (a.x() + b.x()));
+            normal.z(normal.z() + (a.x() - b.x()) * (a.y() + b.y()));
+        }
+        normal = normal.normalize();
+        if (!(this->mask_ & openvrml::viewer::mask_ccw)) {
+            normal = -normal;
+        }
+        return normal;
+    }
+
+    //
+    // Average the normals of the faces adjacent to a coordinate that meet
+    // face at an angle no greater than the crease angle.
+    //
+    const vec3f mesh_builder::smooth_normal(const size_t face,
+                                            const size_t coord_index) const
+        OPENVRML_NOTHROW
+    {
+        const vec3f & normal = this->face_normal_[face];
+        const float cos_crease = float(std::cos(this->crease_angle_));
+        vec3f sum = openvrml::make_vec3f();
+        for (size_t i = this->coord_face_begin_[coord_index];
+             i != this->coord_face_begin_[coord_index + 1];
+             ++i) {
+            const vec3f & adjacent =
+                this->face_normal_[this->coord_faces_[i]];
+            if (normal.dot(adjacent) >= cos_crease
+                || this->coord_faces_[i] == face) {
+                sum += adjacent;
+            }
+        }
+        return sum.normalize();
+    }
+
+    int32 mesh_builder::add_vertex(const size_t face, const size_t corner)
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        using openvrml::viewer;
+
+        const size_t coord_index =
+            size_t(this->coord_index_[this->corners_[corner]]);
+        const size_t index_pos = this->corners_[corner];
+        const vec3f & coord = this->coord_[coord_index];
+        vertex_key key;
+        long index;
+
+        vec3f normal = this->face_normal_[face];
+        key.normal = -1;
+        index = -1;
+        if (this->normal_.empty()) {
+            if (!this->coord_faces_.empty()) {
+                normal = this->smooth_normal(face, coord_index);
+            }
+        } else if (this->mask_ & viewer::mask_normal_per_vertex) {
+            index = (index_pos < this->normal_index_.size())
+                  ? this->normal_index_[index_pos]
+                  : long(coord_index);
+        } else {
+            index = (face < this->normal_index_.size())
+                  ? this->normal_index_[face]
+                  : long(face);
+        }
+        if (index >= 0 && size_t(index) < this->normal_.size()) {
+            normal = this->normal_[size_t(index)];
+            key.normal = index;
+        }
+
+        openvrml::color color = openvrml::make_color(1.0, 1.0, 1.0);
+        key.color = -1;
+        if (!this->color_.empty()) {
+            index = (this->mask_ & viewer::mask_color_per_vertex)
+                  ? ((index_pos < this->color_index_.size())
+                     ? this->color_index_[index_pos]
+                     : long(coord_index))
+                  : ((face < this->color_index_.size())
+                     ? this->color_index_[face]
+                     : long(face));
+            if (index >= 0 && size_t(index) < this->color_.size()) {
+                color = this->color_[size_t(index)];
+                key.color = index;
+            }
+        }
+
+        vec2f tex_coord;
+        key.tex_coord = -1;
+        index = (index_pos < this->tex_coord_index_.size())
+              ? this->tex_coord_index_[index_pos]
+              : long(coord_index);
+        if (index >= 0 && size_t(index) < this->tex_coord_.size()) {
+            tex_coord = this->tex_coord_[size_t(index)];
+            key.tex_coord = index;
+        } else {
+            tex_coord = this->generate_tex_coord_(coord);
+        }
+
+        //
+        // A generated normal is compared by value, so that faces that are
+        // smoothed (or coplanar) share vertices.
+        //
+        for (int32 vertex = this->first_vertex_[coord_index];
+             vertex != no_vertex;
+             vertex = this->next_vertex_[size_t(vertex)]) {
+            const vertex_key & k = this->keys_[size_t(vertex)];
+            if (k.normal == key.normal && k.color == key.color
+                && k.tex_coord == key.tex_coord
+                && (key.normal >= 0
+                    || this->mesh_normal_[size_t(vertex)] == normal)) {
+                return vertex;
+            }
+        }
+
+        const int32 vertex = int32(this->mesh_coord_.size());
+        this->mesh_coord_.push_back(coord);
+        this->mesh_normal_.push_back(normal);
+        if (!this->color_.empty()) { this->mesh_color_.push_back(color); }
+        this->mesh_tex_coord_.push_back(tex_coord);
+        this->keys_.push_back(key);
+        this->next_vertex_.push_back(this->first_vertex_[coord_index]);
+        this->first_vertex_[coord_index] = vertex;
+        return vertex;
+    }
+
+    OPENVRML_LOCAL inline float cross(const vec2f & a,
+                                      const vec2f & b,
+                                      const vec2f & c)
+    {
+        return (b.x() - a.x()) * (c.y() - a.y())
+            - (b.y() - a.y()) * (c.x() - a.x());
+    }
+
+    //
+    // Convex faces (and triangles) are split into a fan; other faces are
+    // projected onto the coordinate plane most nearly parallel to them and
+    // split by clipping ears.  Vertices that coincide with a corner of an ear
+    // (as where the contours of a glyph with holes are bridged) do not
+    // prevent it from being clipped.
+    //
+    void mesh_builder::add_polygon(const std::vector<int32> & polygon,
+                                   const vec3f & normal)
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        using openvrml::local::fabs;
+
+        const size_t n = polygon.size();
+        if (n == 3 || (this->mask_ & openvrml::viewer::mask_convex)) {
+            for (size_t i = 1; i + 1 < n; ++i) {
+                this->mesh_index_.push_back(polygon[0]);
+                this->mesh_index_.push_back(polygon[i]);
+                this->mesh_index_.push_back(polygon[i + 1]);
+            }
+            return;
+        }
+
+        size_t u = 0, v = 1;
+        if (fabs(normal.x()) >= fabs(normal.y())
+            && fabs(normal.x()) >= fabs(normal.z())) {
+            u = 1; v = 2;
+        } else if (fabs(normal.y()) >= fabs(normal.z())) {
+            u = 2; v = 0;
+        }
+
+        std::vector<vec2f> point(n);
+        float area = 0.0f;
+        for (size_t i = 0; i < n; ++i) {
+            const vec3f & c = this->mesh_coord_[size_t(polygon[i])];
+            point[i] = openvrml::make_vec2f(c[u], c[v]);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            const vec2f & a = point[i], & b = point[(i + 1) % n];
+            area += a.x() * b.y() - b.x() * a.y();
+        }
+        const float orientation = (area < 0.0f) ? -1.0f : 1.0f;
+
+        std::vector<size_t> prev(n), next(n);
+        for (size_t i = 0; i < n; ++i) {
+            prev[i] = (i + n - 1) % n;
+            next[i] = (i + 1) % n;
+        }
+
+        size_t remaining = n, i = 0, misses = 0;
+        while (remaining > 3) {
+            const size_t a = prev[i], c = next[i];
+            bool ear =
+                orientation * cross(point[a], point[i], point[c]) > 0.0f;
+            for (size_t j = next[c]; ear && j != a; j = next[j]) {
+                const vec2f & p = point[j];
+                if (p == point[a] || p == point[i] || p == point[c]) {
+                    continue;
+                }
+                ear = !(orientation * cross(point[a], point[i], p) >= 0.0f
+                        && orientation * cross(point[i], point[c], p) >= 0.0f
+                        && orientation * cross(point[c], point[a], p)
+                           >= 0.0f);
+            }
+
+            //
+            // If no ear is found in a full pass, the polygon is degenerate
+            // or self-intersecting; clip a vertex anyway.
+            //
+            if (ear || misses > remaining) {
+                this->mesh_index_.push_back(polygon[a]);
+                this->mesh_index_.push_back(polygon[i]);
+                this->mesh_index_.push_back(polygon[c]);
+                next[a] = c;
+                prev[c] = a;
+                --remaining;
+                misses = 0;
+            } else {
+                ++misses;
+            }
+            i = c;
+        }
+        this->mesh_index_.push_back(polygon[prev[i]]);
+        this->mesh_index_.push_back(polygon[i]);
+        this->mesh_index_.push_back(polygon[next[i]]);
+    }
+}
+
+/**
+ * @class openvrml::compiled_mesh openvrml/compiled_mesh.h
+ *
+ * @brief Triangulated vertex streams for a shell.
+ *
+ * A @c compiled_mesh is the result of splitting the faces of an
+ * IndexedFaceSet into triangles, generating any normals and texture
+ * coordinates that are not given, and merging corners that share all of
+ * their attributes into a single vertex.  Every vertex has a coordinate, a
+ * normal and a texture coordinate; it has a color if the shell has colors.
+ *
+ * Compiling a mesh does not depend on a @c viewer or on any rendering
+ * context; so it may be done on any thread, and the result may be shared
+ * by any number of viewers.  A @c geometry_node typically keeps the mesh for
+ * the current revision of its fields and passes it to
+ * @c viewer::insert_mesh.
+ *
+ * @sa openvrml::viewer::insert_mesh
+ */
+
+/**
+ * @var unsigned int openvrml::compiled_mesh::mask_
+ *
+ * @brief The @c viewer mask the mesh was compiled with.
+ */
+
+/**
+ * @var std::vector<openvrml::vec3f> openvrml::compiled_mesh::coord_
+ *
+ * @brief Vertex coordinates.
+ */
+
+/**
+ * @var std::vector<openvrml::vec3f> openvrml::compiled_mesh::normal_
+ *
+ * @brief Vertex normals.
+ */
+
+/**
+ * @var std::vector<openvrml::color> openvrml::compiled_mesh::color_
+ *
+ * @brief Vertex colors.
+ */
+
+/**
+ * @var std::vector<openvrml::vec2f> openvrml::compiled_mesh::tex_coord_
+ *
+ * @brief Vertex texture coordinates.
+ */
+
+/**
+ * @var std::vector<openvrml::int32> openvrml::compiled_mesh::index_
+ *
+ * @brief Triangle vertex indices.
+ */
+
+/**
+ * @brief Construct an empty mesh.
+ */
+openvrml::compiled_mesh::compiled_mesh() OPENVRML_NOTHROW:
+    mask_(0)
+{}
+
+/**
+ * @brief Compile a shell.
+ *
+ * The arguments are those of @c viewer::insert_shell.  Where @p normal is
+ * empty, normals are generated; those of faces that meet at an angle no
+ * greater than @p crease_angle are averaged.
+ *
+ * @param[in] mask              a combination of the @c viewer mask values.
+ * @param[in] coord             coordinates.
+ * @param[in] coord_index       coordinate indices.
+ * @param[in] color             colors.
+ * @param[in] color_index       color indices.
+ * @param[in] normal            normals.
+ * @param[in] normal_index      normal indices.
+ * @param[in] tex_coord         texture coordinates.
+ * @param[in] tex_coord_index   texture coordinate indices.
+ * @param[in] crease_angle      crease angle in radians.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::compiled_mesh::
+compiled_mesh(const unsigned int mask,
+              const std::vector<vec3f> & coord,
+              const std::vector<int32> & coord_index,
+              const std::vector<openvrml::color> & color,
+              const std::vector<int32> & color_index,
+              const std::vector<vec3f> & normal,
+              const std::vector<int32> & normal_index,
+              const std::vector<vec2f> & tex_coord,
+              const std::vector<int32> & tex_coord_index,
+              const float crease_angle)
+    OPENVRML_THROW1(std::bad_alloc):
+    mask_(mask)
+{
+    mesh_builder builder(mask,
+                         coord, coord_index,
+                         color, color_index,
+                         normal, normal_index,
+                         tex_coord, tex_coord_index,
+                         crease_angle,
+                         this->coord_, this->normal_, this->color_,
+                         this->tex_coord_, this->index_);
+    builder.build();
+}
+
+/**
+ * @brief The @c viewer mask the mesh was compiled with.
+ *
+ * Only @c viewer::mask_ccw and @c viewer::mask_solid are significant when
+ * the triangles are drawn.
+ *
+ * @return the @c viewer mask the mesh was compiled with.
+ */
+unsigned int openvrml::compiled_mesh::mask() const OPENVRML_NOTHROW
+{
+    return this->mask_;
+}
+
+/**
+ * @brief Vertex coordinates.
+ *
+ * @return the vertex coordinates.
+ */
+const std::vector<openvrml::vec3f> &
+openvrml::compiled_mesh::coord() const OPENVRML_NOTHROW
+{
+    return this->coord_;
+}
+
+/**
+ * @brief Vertex normals.
+ *
+ * @return the vertex normals.
+ */
+const std::vector<openvrml::vec3f> &
+openvrml::compiled_mesh::normal() const OPENVRML_NOTHROW
+{
+    return this->normal_;
+}
+
+/**
+ * @brief Vertex colors.
+ *
+ * @return the vertex colors; or an empty vector if the mesh has no colors.
+ */
+const std::vector<openvrml::color> &
+openvrml::compiled_mesh::color() const OPENVRML_NOTHROW
+{
+    return this->color_;
+}
+
+/**
+ * @brief Vertex texture coordinates.
+ *
+ * @return the vertex texture coordinates.
+ */
+const std::vector<openvrml::vec2f> &
+openvrml::compiled_mesh::tex_coord() const OPENVRML_NOTHROW
+{
+    return this->tex_coord_;
+}
+
+/**
+ * @brief Triangle vertex indices.
+ *
+ * @return the vertex indices, three for each triangle.
+ */
+const std::vector<openvrml::int32> &
+openvrml::compiled_mesh::index() const OPENVRML_NOTHROW
+{
+    return this->index_;
+}
+
+/**
+ * @brief Whether the mesh has any triangles.
+ *
+ * @return @c true if the mesh has no triangles; @c false otherwise.
+ */
+bool openvrml::compiled_mesh::empty() const OPENVRML_NOTHROW
+{
+    return this->index_.empty();
+}
+
+/**
+ * @brief Swap.
+ *
+ * @param[in,out] mesh  the mesh to swap with this one.
+ */
+void openvrml::compiled_mesh::swap(compiled_mesh & mesh) OPENVRML_NOTHROW
+{
+    std::swap(this->mask_, mesh.mask_);
+    this->coord_.swap(mesh.coord_);
+    this->normal_.swap(mesh.normal_);
+    this->color_.swap(mesh.color_);
+    this->tex_coord_.swap(mesh.tex_coord_);
+    this->index_.swap(mesh.index_);
+}
+
+/**
+ * @relatesalso openvrml::compiled_mesh
+ *
+ * @brief Compile a mesh for the bounding box of a set of points.
+ *
+ * The result is typically drawn in place of a mesh that is not yet ready.
+ *
+ * @param[in] points    points.
+ *
+ * @return a box enclosing @p points; or an empty mesh if @p points is
+ *         empty.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::compiled_mesh
+openvrml::make_bounding_box_mesh(const std::vector<vec3f> & points)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (points.empty()) { return compiled_mesh(); }
+
+    vec3f min = points.front(), max = points.front();
+    for (std::vector<vec3f>::const_iterator p = points.begin() + 1;
+         p != points.end();
+         ++p) {
+        min.x(std::min(min.x(), p->x()));
+        min.y(std::min(min.y(), p->y()));
+        min.z(std::min(min.z(), p->z()));
+        max.x(std::max(max.x(), p->x()));
+        max.y(std::max(max.y(), p->y()));
+        max.z(std::max(max.z(), p->z()));
+    }
+
+    //
+    // Corner i is at max along each axis whose bit is set in i.
+    //
+    std::vector<vec3f> coord(8);
+    for (size_t i = 0; i < 8; ++i) {
+        coord[i] = make_vec3f((i & 1) ? max.x() : min.x(),
+                              (i & 2) ? max.y() : min.y(),
+                              (i & 4) ? max.z() : min.z());
+    }
+    static const int32 faces[] = {
+        0, 2, 3, 1, -1,
+        4, 5, 7, 6, -1,
+        0, 1, 5, 4, -1,
+        2, 6, 7, 3, -1,
+        0, 4, 6, 2, -1,
+        1, 3, 7, 5, -1
+    };
+    return compiled_mesh(viewer::mask_ccw | viewer::mask_solid
+                         | viewer::mask_convex,
+                         coord,
+                         std::vector<int32>(faces,
+                                            faces + sizeof faces
+                                                    / sizeof faces[0]),
+                         std::vector<color>(), std::vector<int32>(),
+                         std::vector<vec3f>(), std::vector<int32>(),
+                         std::vector<vec2f>(), std::vector<int32>());
+}
+
+namespace {
+
+    //
+    // The length of an Extrusion spine, used in computing texture
+    // coordinates; or 1 if the length is 0 (to avoid dividing by zero).
+    //
+    OPENVRML_LOCAL float spine_length(const std::vector<vec3f> & spine)
+    {
+        float result = 0.0;
+        for (std::vector<vec3f>::const_iterator point = spine.begin();
+             point < spine.end() - 1;
+             ++point) {
+            result += (*(point + 1) - *point).length();
+        }
+        return result == 0.0f ? 1.0f : result;
+    }
+
+    //
+    // The length of an Extrusion cross-section, used in computing texture
+    // coordinates; or 1 if the length is 0.
+    //
+    OPENVRML_LOCAL float
+    cross_section_length(const std::vector<vec2f> & cross_section)
+    {
+        float result = 0.0;
+        for (std::vector<vec2f>::const_iterator point =
+                 cross_section.begin();
+             point != cross_section.end() - 1;
+             ++point) {
+            result += (*(point + 1) - *point).length();
+        }
+        return result == 0.0f ? 1.0f : result;
+    }
+
+    //
+    // The y-axis of the spine-aligned cross-section plane (SCP) at point.
+    //
+    OPENVRML_LOCAL const vec3f
+    scp_y_axis(const std::vector<vec3f>::const_iterator & point,
+               const std::vector<vec3f>::const_iterator & first,
+               const std::vector<vec3f>::const_iterator & last,
+               const vec3f & prev)
+    {
+        if (point != first && point != last) {
+            if (*point == *(point - 1)) { return prev; }
+            return (*(point + 1) - *(point - 1)).normalize();
+        }
+
+        //
+        // From here on, we're dealing with the first or last point.
+        //
+        const bool spine_closed = (*first == *last);
+
+        if (spine_closed) {
+            return (*(first + 1) - *(last - 1)).normalize();
+        }
+
+        //
+        // The spine is not closed.
+        //
+        if (point == first) {
+            return (*(first + 1) - *first).normalize();
+        }
+
+        assert(point == last);
+        assert(last - first > 0);
+        return (*last - *(last - 1)).normalize();
+    }
+
+    //
+    // The z-axis of the SCP at point; prev is that at the previous spine
+    // point.
+    //
+    OPENVRML_LOCAL const vec3f
+    scp_z_axis(const std::vector<vec3f>::const_iterator & point,
+               const std::vector<vec3f>::const_iterator & first,
+               const std::vector<vec3f>::const_iterator & last,
+               const vec3f & prev)
+    {
+        using openvrml::local::fequal;
+
+        vec3f z0, z1;
+
+        if (point != first && point != last) {
+            if (*point == *(point - 1)) { return prev; }
+            z0 = *(point + 1) - *point;
+            z1 = *(point - 1) - *point;
+        } else {
+            //
+            // From here on, we're dealing with the first or last point.
+            //
+            const bool spine_closed = (*first == *last);
+
+            if (spine_closed) {
+                z0 = *(first + 1) - *first;
+                z1 = *(last - 1) - *first;
+            } else {
+                if (last - first == 1) { return prev; }
+                if (point == first) {
+                    z0 = *(first + 2) - *(first + 1);
+                    z1 = *first - *(first + 1);
+                } else {
+                    assert(point == last);
+                    assert(last - first > 0);
+                    z0 = *(last - 2) - *(last - 1);
+                    z1 = *last - *(last - 1);
+                }
+            }
+        }
+
+        if (fequal(z0.dot(z1), 1.0f)) { return prev; }
+
+        const vec3f z = (z0 * z1).normalize();
+        if (z == openvrml::make_vec3f(0.0, 0.0, 0.0)) { return prev; }
+
+        return (z.dot(prev) < 0) ? -z : z;
+    }
+
+    //
+    // Determine whether the spine points are collinear.  If they are,
+    // scp_x, scp_y and scp_z are set to the axes of the SCP to be used for
+    // the whole extrusion.
+    //
+    OPENVRML_LOCAL bool spine_collinear(const std::vector<vec3f> & spine,
+                                        vec3f & scp_x,
+                                        vec3f & scp_y,
+                                        vec3f & scp_z)
+    {
+        using openvrml::make_vec3f;
+
+        //
+        // Iterate over the spine points until both the y- and z-axes of the
+        // SCP are valid (nonzero); that happens at the first noncollinear
+        // point.  If the points are all collinear, the z-axis (or the
+        // y-axis) is never valid.
+        //
+        static const vec3f zero = make_vec3f();
+        scp_y = zero;
+        scp_z = zero;
+        vec3f prev_scp_y = zero, prev_scp_z = zero;
+        for (std::vector<vec3f>::const_iterator point = spine.begin();
+             point < spine.end() && (prev_scp_y == zero || prev_scp_z == zero);
+             ++point) {
+            if (prev_scp_y == zero) {
+                scp_y = scp_y_axis(point, spine.begin(), spine.end() - 1,
+                                   prev_scp_y);
+                if (scp_y != zero) { prev_scp_y = scp_y; }
+            }
+            if (prev_scp_z == zero) {
+                scp_z = scp_z_axis(point, spine.begin(), spine.end() - 1,
+                                   prev_scp_z);
+                if (scp_z != zero) { prev_scp_z = scp_z; }
+            }
+        }
+
+        //
+        // If all the points are coincident, prev_scp_y is still zero.  Set
+        // it to (0 1 0).
+        //
+        if (prev_scp_y == zero) { prev_scp_y = make_vec3f(0.0, 1.0, 0.0); }
+
+        //
+        // If all the points are collinear, prev_scp_z is still zero.
+        // Default it to (0 0 1); then, per 6.18.3 of VRML97:
+        //
+        //   If the entire spine is collinear, the SCP is computed by finding
+        //   the rotation of a vector along the positive Y-axis (v1) to the
+        //   vector formed by the spine points (v2).  The Y=0 plane is then
+        //   rotated by this value.
+        //
+        if (prev_scp_z != zero) { return false; }
+
+        prev_scp_z = make_vec3f(0.0, 0.0, 1.0);
+        if (prev_scp_y != make_vec3f(0.0, 1.0, 0.0)) {
+            prev_scp_z *= openvrml::make_rotation_mat4f(
+                openvrml::make_rotation(make_vec3f(0.0, 1.0, 0.0),
+                                        prev_scp_y));
+        }
+        scp_y = prev_scp_y;
+        scp_z = prev_scp_z;
+        scp_x = (scp_y * scp_z).normalize();
+        return true;
+    }
+
+    //
+    // Sweep the cross-section along the spine.  The points of the
+    // cross-section at spine point i are
+    // coord[i * cross_section.size(), (i + 1) * cross_section.size()).
+    //
+    OPENVRML_LOCAL void
+    sweep(const std::vector<vec2f> & cross_section,
+          const std::vector<vec3f> & spine,
+          const std::vector<vec2f> & scale,
+          const std::vector<openvrml::rotation> & orientation,
+          std::vector<vec3f> & coord,
+          std::vector<vec2f> & tex_coord)
+    {
+        using openvrml::make_vec2f;
+        using openvrml::make_vec3f;
+        using openvrml::mat4f;
+
+        coord.resize(spine.size() * cross_section.size());
+        tex_coord.resize(spine.size() * cross_section.size());
+
+        vec3f scp_x = make_vec3f(), scp_y = make_vec3f(),
+            scp_z = make_vec3f();
+        const bool collinear = spine_collinear(spine, scp_x, scp_y, scp_z);
+
+        const float spine_len = spine_length(spine);
+        const float cross_section_len = cross_section_length(cross_section);
+        float current_spine_length = 0.0;
+        for (std::vector<vec3f>::const_iterator spine_point = spine.begin();
+             spine_point != spine.end();
+             ++spine_point) {
+            if (!collinear) {
+                scp_y = scp_y_axis(spine_point, spine.begin(),
+                                   spine.end() - 1, scp_y);
+                scp_z = scp_z_axis(spine_point, spine.begin(),
+                                   spine.end() - 1, scp_z);
+                scp_x = (scp_y * scp_z).normalize();
+            }
+
+            mat4f mat =
+                openvrml::make_mat4f(
+                    scp_x.x(),        scp_x.y(),        scp_x.z(),        0.0,
+                    scp_y.x(),        scp_y.y(),        scp_y.z(),        0.0,
+                    scp_z.x(),        scp_z.y(),        scp_z.z(),        0.0,
+                    spine_point->x(), spine_point->y(), spine_point->z(), 1.0);
+
+            const size_t spine_index =
+                size_t(std::distance(spine.begin(), spine_point));
+
+            if (!orientation.empty()) {
+                const size_t index = spine_index < orientation.size()
+                                   ? spine_index
+                                   : orientation.size() - 1;
+                mat = openvrml::make_rotation_mat4f(orientation[index]) * mat;
+            }
+
+            if (!scale.empty()) {
+                const size_t index = spine_index < scale.size()
+                                   ? spine_index
+                                   : scale.size() - 1;
+                mat = openvrml::make_scale_mat4f(
+                          make_vec3f(scale[index].x(), 1.0, scale[index].y()))
+                    * mat;
+            }
+
+            float current_cross_section_length = 0.0;
+            for (size_t i = 0; i < cross_section.size(); ++i) {
+                const size_t index = spine_index * cross_section.size() + i;
+                coord[index] = make_vec3f(cross_section[i].x(),
+                                          0.0,
+                                          cross_section[i].y()) * mat;
+                tex_coord[index] =
+                    make_vec2f(
+                        current_cross_section_length / cross_section_len,
+                        current_spine_length / spine_len);
+
+                if (i < cross_section.size() - 1) {
+                    current_cross_section_length +=
+                        (cross_section[i + 1] - cross_section[i]).length();
+                }
+            }
+            if (spine_point < spine.end() - 1) {
+                current_spine_length +=
+                    (*(spine_point + 1) - *spine_point).length();
+            }
+        }
+    }
+}
+
+/**
+ * @relatesalso openvrml::compiled_mesh
+ *
+ * @brief Compile an extrusion.
+ *
+ * The arguments are those of @c viewer::insert_extrusion, with the addition
+ * of @p crease_angle.  Each segment of the sweep between adjacent spine
+ * points is made of one quadrilateral face per cross-section segment; the
+ * caps are faces with a corner at each point of the cross-section.
+ *
+ * @param[in] mask          a combination of the @c viewer mask values.
+ * @param[in] spine         spine points.
+ * @param[in] cross_section cross-section points.
+ * @param[in] orientation   cross-section orientations.
+ * @param[in] scale         cross-section scales.
+ * @param[in] crease_angle  the angle below which normals are smoothed.
+ *
+ * @return the compiled mesh; empty if @p spine or @p cross_section has
+ *         fewer than 2 points.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::compiled_mesh
+openvrml::make_extrusion_mesh(const unsigned int mask,
+                              const std::vector<vec3f> & spine,
+                              const std::vector<vec2f> & cross_section,
+                              const std::vector<rotation> & orientation,
+                              const std::vector<vec2f> & scale,
+                              const float crease_angle)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    using std::vector;
+
+    if (spine.size() < 2 || cross_section.size() < 2) {
+        return compiled_mesh();
+    }
+
+    vector<vec3f> coord;
+    vector<vec2f> tex_coord;
+    sweep(cross_section, spine, scale, orientation, coord, tex_coord);
+
+    const size_t cs = cross_section.size();
+    vector<int32> coord_index;
+    coord_index.reserve((spine.size() - 1) * (cs - 1) * 5 + 2 * (cs + 1));
+    for (size_t section = 0;
+         section < (spine.size() - 1) * cs;
+         section += cs) {
+        for (size_t j = 0; j < cs - 1; ++j) {
+            const int32 bottom = int32(section + j),
+                top = int32(section + j + cs);
+            coord_index.push_back(top);
+            coord_index.push_back(bottom);
+            coord_index.push_back(bottom + 1);
+            coord_index.push_back(top + 1);
+            coord_index.push_back(-1);
+        }
+    }
+
+    //
+    // The sides use the swept texture coordinates; the caps, which are
+    // mapped onto the cross-section's bounding rectangle, get their own.
+    //
+    vector<int32> tex_coord_index(coord_index);
+
+    //
+    // A closed cross-section repeats its first point; the caps leave it out.
+    //
+    if (mask & (viewer::mask_bottom | viewer::mask_top)) {
+        using openvrml::local::fequal;
+
+        float xz[4] = {
+            cross_section[0].x(), cross_section[0].x(),
+            cross_section[0].y(), cross_section[0].y()
+        };
+        for (vector<vec2f>::const_iterator p = cross_section.begin() + 1;
+             p != cross_section.end();
+             ++p) {
+            xz[0] = (std::min)(xz[0], p->x());
+            xz[1] = (std::max)(xz[1], p->x());
+            xz[2] = (std::min)(xz[2], p->y());
+            xz[3] = (std::max)(xz[3], p->y());
+        }
+        float dx = xz[1] - xz[0];
+        float dz = xz[3] - xz[2];
+        if (!fequal(dx, 0.0f)) { dx = 1.0f / dx; }
+        if (!fequal(dz, 0.0f)) { dz = 1.0f / dz; }
+
+        const size_t points =
+            (cross_section.front() == cross_section.back()) ? cs - 1 : cs;
+        const size_t top = (spine.size() - 1) * cs;
+        for (int cap = 0; cap < 2; ++cap) {
+            if (!(mask & (cap == 0 ? viewer::mask_bottom
+                                   : viewer::mask_top))) {
+                continue;
+            }
+            for (size_t k = 0; k < points; ++k) {
+                //
+                // The bottom cap faces backward along the spine.
+                //
+                const size_t j = (cap == 0) ? points - 1 - k : k;
+                coord_index.push_back(int32((cap == 0) ? j : top + j));
+                tex_coord_index.push_back(int32(tex_coord.size()));
+                tex_coord.push_back(
+                    make_vec2f((cross_section[j].x() - xz[0]) * dx,
+                               (cross_section[j].y() - xz[2]) * dz));
+            }
+            coord_index.push_back(-1);
+            tex_coord_index.push_back(-1);
+        }
+    }
+
+    return compiled_mesh(mask & (viewer::mask_ccw | viewer::mask_convex
+                                 | viewer::mask_solid),
+                         coord, coord_index,
+                         vector<color>(), vector<int32>(),
+                         vector<vec3f>(), vector<int32>(),
+                         tex_coord, tex_coord_index,
+                         crease_angle);
+}
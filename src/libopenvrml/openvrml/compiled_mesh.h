@@ -0,0 +1,76 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_COMPILED_MESH_H
+#   define OPENVRML_COMPILED_MESH_H
+
+#   include <openvrml/basetypes.h>
+#   include <vector>
+
+namespace openvrml {
+
+    class OPENVRML_API compiled_mesh {
+        unsigned int mask_;
+        std::vector<vec3f> coord_;
+        std::vector<vec3f> normal_;
+        std::vector<openvrml::color> color_;
+        std::vector<vec2f> tex_coord_;
+        std::vector<int32> index_;
+
+    public:
+        compiled_mesh() OPENVRML_NOTHROW;
+        compiled_mesh(unsigned int mask,
+                      const std::vector<vec3f> & coord,
+                      const std::vector<int32> & coord_index,
+                      const std::vector<openvrml::color> & color,
+                      const std::vector<int32> & color_index,
+                      const std::vector<vec3f> & normal,
+                      const std::vector<int32> & normal_index,
+                      const std::vector<vec2f> & tex_coord,
+                      const std::vector<int32> & tex_coord_index,
+                      float crease_angle = 0.0f)
+            OPENVRML_THROW1(std::bad_alloc);
+
+        unsigned int mask() const OPENVRML_NOTHROW;
+        const std::vector<vec3f> & coord() const OPENVRML_NOTHROW;
+        const std::vector<vec3f> & normal() const OPENVRML_NOTHROW;
+        const std::vector<openvrml::color> & color() const OPENVRML_NOTHROW;
+        const std::vector<vec2f> & tex_coord() const OPENVRML_NOTHROW;
+        const std::vector<int32> & index() const OPENVRML_NOTHROW;
+        bool empty() const OPENVRML_NOTHROW;
+
+        void swap(compiled_mesh & mesh) OPENVRML_NOTHROW;
+    };
+
+    OPENVRML_API compiled_mesh
+    make_bounding_box_mesh(const std::vector<vec3f> & points)
+        OPENVRML_THROW1(std::bad_alloc);
+
+    OPENVRML_API compiled_mesh
+    make_extrusion_mesh(unsigned int mask,
+                        const std::vector<vec3f> & spine,
+                        const std::vector<vec2f> & cross_section,
+                        const std::vector<rotation> & orientation,
+                        const std::vector<vec2f> & scale,
+                        float crease_angle = 0.0f)
+        OPENVRML_THROW1(std::bad_alloc);
+}
+
+# endif // OPENVRML_COMPILED_MESH_H
@@ -23,6 +23,8 @@
 # endif
 
 # include "event.h"
+# include <openvrml/local/event_queue.h>
+# include <openvrml/local/timer_scheduler.h>
 
 /**
  * @file openvrml/event.h
@@ -439,23 +441,66 @@ const std::string openvrml::node_event_listener::eventin_id() const
  *
  * @var boost::shared_mutex openvrml::event_emitter::listeners_mutex_
  *
- * @brief Mutex guarding @c #listeners_.
+ * @brief Mutex guarding @c #listeners_ and @c #retired_dispatch_lists_.
+ *
+ * This mutex serializes changes to the set of listeners; @c #emit_event does
+ * not acquire it.
  */
 
 /**
  * @internal
  *
- * @var double openvrml::event_emitter::last_time_
+ * @typedef openvrml::event_emitter::dispatch_list
  *
- * @brief The timestamp of the last event emitted.
+ * @brief Contiguous array of listeners walked by @c #emit_event.
+ *
+ * Each element is a <code>field_value_listener<FieldValue> *</code> for the
+ * emitter's @c FieldValue type, converted to <code>void *</code> by @c #add.
+ * Converting it back with @c static_cast in @c #emit_event is safe because an
+ * emitter only ever accepts listeners of its own type; and it spares
+ * @c #emit_event a @c dynamic_cast per listener per event.
+ *
+ * A @c dispatch_list is not modified once it has been published to
+ * @c #dispatch_list_; @c #add and @c #remove copy it, change the copy, and
+ * @c #publish the result.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::atomic<const openvrml::event_emitter::dispatch_list *> openvrml::event_emitter::dispatch_list_
+ *
+ * @brief The current @c dispatch_list.
+ *
+ * This is null until the first listener is added.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::atomic<std::size_t> openvrml::event_emitter::dispatching_
+ *
+ * @brief The number of calls to @c #emit_event in progress.
+ *
+ * A superseded @c dispatch_list can be destroyed once this count has been
+ * observed to be zero after the list was superseded.
  */
 
 /**
  * @internal
  *
- * @var boost::shared_mutex openvrml::event_emitter::last_time_mutex_
+ * @var std::vector<const openvrml::event_emitter::dispatch_list *> openvrml::event_emitter::retired_dispatch_lists_
  *
- * @brief Mutex guarding @c #last_time_.
+ * @brief Superseded @c dispatch_list%s that may still be in use by an
+ *        emission.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::atomic<double> openvrml::event_emitter::last_time_
+ *
+ * @brief The timestamp of the last event emitted.
  */
 
 /**
@@ -466,6 +511,8 @@ const std::string openvrml::node_event_listener::eventin_id() const
 openvrml::event_emitter::event_emitter(const field_value & value)
     OPENVRML_NOTHROW:
     value_(value),
+    dispatch_list_(0),
+    dispatching_(0),
     last_time_(0.0)
 {}
 
@@ -473,7 +520,19 @@ openvrml::event_emitter::event_emitter(const field_value & value)
  * @brief Destroy.
  */
 openvrml::event_emitter::~event_emitter() OPENVRML_NOTHROW
-{}
+{
+    if (local::event_queue * const queue = local::event_queue::current()) {
+        queue->cancel(*this);
+    }
+    assert(this->dispatching_.load() == 0);
+    delete this->dispatch_list_.load();
+    for (std::vector<const dispatch_list *>::const_iterator list =
+             this->retired_dispatch_lists_.begin();
+         list != this->retired_dispatch_lists_.end();
+         ++list) {
+        delete *list;
+    }
+}
 
 /**
  * @brief A reference to the @c field_value for the @c event_emitter.
@@ -516,10 +575,7 @@ const std::string openvrml::event_emitter::eventout_id() const
  */
 double openvrml::event_emitter::last_time() const OPENVRML_NOTHROW
 {
-    using boost::shared_lock;
-    using boost::shared_mutex;
-    shared_lock<shared_mutex> lock(this->last_time_mutex_);
-    return this->last_time_;
+    return this->last_time_.load();
 }
 
 /**
@@ -539,6 +595,9 @@ double openvrml::event_emitter::last_time() const OPENVRML_NOTHROW
  *
  * @brief Remove an event listener.
  *
+ * When this function returns, @p listener will not receive any more events
+ * from this emitter; it waits for emissions in progress to complete.
+ *
  * @tparam FieldValue   a @link FieldValueConcept Field Value@endlink.
  *
  * @param[in] listener  an event listener.
@@ -559,6 +618,12 @@ double openvrml::event_emitter::last_time() const OPENVRML_NOTHROW
  *
  * @brief Emit an event.
  *
+ * Emission does not acquire any locks, use RTTI, or allocate memory: the
+ * current @c #dispatch_list_ is loaded atomically and walked while
+ * @c #dispatching_ is incremented.  Concurrent calls to @c #add take effect
+ * for subsequent emissions; @c #remove waits for emissions in progress to
+ * complete.
+ *
  * @tparam FieldValue   a @link FieldValueConcept Field Value@endlink.
  *
  * @param[in] timestamp the current time.
@@ -578,6 +643,166 @@ double openvrml::event_emitter::last_time() const OPENVRML_NOTHROW
  * This function is called by @c node::emit_event.
  */
 
+/**
+ * @fn std::size_t openvrml::event_emitter::emit_coalesced_event(double timestamp, const delivery_map & deliveries)
+ *
+ * @brief Emit an event to the listeners for which this emitter is the
+ *        selected source in @p deliveries.
+ *
+ * This function is called by @c local::event_queue when it drains a batch
+ * of coalesced events.
+ *
+ * @param[in] timestamp     the current time.
+ * @param[in] deliveries    map of listeners to the emitter that should
+ *                          deliver their event.
+ *
+ * @return the number of listeners that received the event.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+
+/**
+ * @typedef openvrml::event_emitter::delivery_map
+ *
+ * @brief Map of listeners to the emitter that should deliver their event.
+ *
+ * Keys are listener pointers as stored in a @c #dispatch_list.
+ */
+
+/**
+ * @fn std::size_t openvrml::event_emitter::dispatch<FieldValue>(double timestamp, const delivery_map * deliveries)
+ *
+ * @brief Send an event to the listeners.
+ *
+ * If @p deliveries is not null, listeners it maps to a different emitter are
+ * skipped.
+ *
+ * @tparam FieldValue   a @link FieldValueConcept Field Value@endlink.
+ *
+ * @param[in] timestamp     the current time.
+ * @param[in] deliveries    map of listeners to the emitter that should
+ *                          deliver their event, or null.
+ *
+ * @return the number of listeners that received the event.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+
+/**
+ * @internal
+ *
+ * @class openvrml::event_emitter::dispatch_guard
+ *
+ * @brief Counts a traversal of the current @c dispatch_list in
+ *        @c #dispatching_ for as long as it is in scope.
+ */
+
+/**
+ * @internal
+ *
+ * @brief Make @p list the current @c dispatch_list.
+ *
+ * The caller must hold a unique lock on @c #listeners_mutex_.
+ *
+ * The superseded list is destroyed immediately if no emission is in
+ * progress; otherwise it is retired and destroyed by a later call to
+ * @c #publish or @c #synchronize (or by the destructor).
+ *
+ * Since the set of listeners has changed, this also invalidates any cached
+ * partition of the ROUTE graph.
+ *
+ * @param[in] list  the new @c dispatch_list.
+ */
+void
+openvrml::event_emitter::publish(std::auto_ptr<const dispatch_list> list)
+    OPENVRML_NOTHROW
+{
+    const dispatch_list * const old = this->dispatch_list_.exchange(list.get());
+    list.release();
+    local::timer_scheduler::routes_changed();
+    if (!old) { return; }
+    try {
+        this->retired_dispatch_lists_.push_back(old);
+    } catch (std::bad_alloc &) {
+        this->synchronize();
+        delete old;
+        return;
+    }
+    //
+    // An emission that starts after the exchange above sees the new list; so
+    // if none is in progress now, nothing can be using the retired ones.
+    //
+    if (this->dispatching_.load() == 0) {
+        for (std::vector<const dispatch_list *>::const_iterator retired =
+                 this->retired_dispatch_lists_.begin();
+             retired != this->retired_dispatch_lists_.end();
+             ++retired) {
+            delete *retired;
+        }
+        this->retired_dispatch_lists_.clear();
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Wait for emissions in progress to finish.
+ *
+ * The caller must hold a unique lock on @c #listeners_mutex_.  When this
+ * function returns, no emission is using a retired @c dispatch_list; and
+ * they are destroyed.
+ *
+ * Calling this function from a listener of this emitter (i.e., while it is
+ * emitting on the same thread) deadlocks.
+ */
+void openvrml::event_emitter::synchronize() OPENVRML_NOTHROW
+{
+    while (this->dispatching_.load() != 0) { boost::this_thread::yield(); }
+    for (std::vector<const dispatch_list *>::const_iterator retired =
+             this->retired_dispatch_lists_.begin();
+         retired != this->retired_dispatch_lists_.end();
+         ++retired) {
+        delete *retired;
+    }
+    this->retired_dispatch_lists_.clear();
+}
+
+/**
+ * @internal
+ *
+ * @brief Record this emitter as the source of the next event for each of
+ *        its listeners.
+ *
+ * This is used by @c local::event_queue to coalesce events destined for the
+ * same listener: after this function has been called for each emitter in a
+ * batch, @p deliveries maps each listener to the last emitter in the batch
+ * that targets it.
+ *
+ * @param[in,out] deliveries    map of listeners to emitters.
+ *
+ * @return the number of listeners recorded.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+std::size_t
+openvrml::event_emitter::collect_deliveries(delivery_map & deliveries)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    dispatch_guard guard(this->dispatching_);
+    std::size_t count = 0;
+    const dispatch_list * const list = this->dispatch_list_.load();
+    if (!list) { return count; }
+    for (dispatch_list::const_iterator listener = list->begin();
+         listener != list->end();
+         ++listener) {
+        if (*listener) {
+            deliveries[*listener] = this;
+            ++count;
+        }
+    }
+    return count;
+}
+
 
 /**
  * @class openvrml::field_value_emitter openvrml/event.h
@@ -617,6 +842,23 @@ double openvrml::event_emitter::last_time() const OPENVRML_NOTHROW
  * @exception std::bad_alloc    if memory allocation fails.
  */
 
+/**
+ * @fn std::size_t openvrml::field_value_emitter::emit_coalesced_event(double timestamp, const delivery_map & deliveries)
+ *
+ * @brief Emit an event to the listeners for which this emitter is the
+ *        selected source in @p deliveries.
+ *
+ * @tparam FieldValue   a @link FieldValueConcept Field Value@endlink.
+ *
+ * @param[in] timestamp     the current time.
+ * @param[in] deliveries    map of listeners to the emitter that should
+ *                          deliver their event.
+ *
+ * @return the number of listeners that received the event.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+
 /**
  * @fn bool openvrml::field_value_emitter::add(field_value_listener<FieldValue> & listener)
  *
@@ -21,13 +21,23 @@
 # ifndef OPENVRML_EVENT_H
 #   define OPENVRML_EVENT_H
 
+#   include <algorithm>
+#   include <iterator>
+#   include <map>
 #   include <set>
+#   include <vector>
+#   include <boost/atomic.hpp>
 #   include <openvrml/field_value.h>
 
 namespace openvrml {
 
     class node;
 
+    namespace local {
+        class event_queue;
+        class timer_scheduler;
+    }
+
     class OPENVRML_API event_listener : boost::noncopyable {
     public:
         virtual ~event_listener() OPENVRML_NOTHROW = 0;
@@ -159,14 +169,21 @@ namespace openvrml {
 
     class OPENVRML_API event_emitter : boost::noncopyable {
         friend class node;
+        friend class local::event_queue;
+        friend class local::timer_scheduler;
+
+        typedef std::vector<void *> dispatch_list;
 
         const field_value & value_;
 
         std::set<event_listener *> listeners_;
         mutable boost::shared_mutex listeners_mutex_;
 
-        double last_time_;
-        mutable boost::shared_mutex last_time_mutex_;
+        boost::atomic<const dispatch_list *> dispatch_list_;
+        boost::atomic<std::size_t> dispatching_;
+        std::vector<const dispatch_list *> retired_dispatch_lists_;
+
+        boost::atomic<double> last_time_;
 
     public:
         typedef std::set<event_listener *> listener_set;
@@ -178,6 +195,8 @@ namespace openvrml {
         double last_time() const OPENVRML_NOTHROW;
 
     protected:
+        typedef std::map<const void *, const event_emitter *> delivery_map;
+
         explicit event_emitter(const field_value & value) OPENVRML_NOTHROW;
 
         template <typename FieldValue>
@@ -193,11 +212,39 @@ namespace openvrml {
 
         template <typename FieldValue>
         void emit_event(double timestamp) OPENVRML_THROW1(std::bad_alloc);
+        template <typename FieldValue>
+        std::size_t dispatch(double timestamp, const delivery_map * deliveries)
+            OPENVRML_THROW1(std::bad_alloc);
 
     private:
         virtual const std::string do_eventout_id() const OPENVRML_NOTHROW = 0;
         virtual void emit_event(double timestamp)
             OPENVRML_THROW1(std::bad_alloc) = 0;
+        virtual std::size_t
+        emit_coalesced_event(double timestamp, const delivery_map & deliveries)
+            OPENVRML_THROW1(std::bad_alloc) = 0;
+
+        class dispatch_guard : boost::noncopyable {
+            boost::atomic<std::size_t> & dispatching_;
+
+        public:
+            explicit dispatch_guard(boost::atomic<std::size_t> & dispatching)
+                OPENVRML_NOTHROW:
+                dispatching_(dispatching)
+            {
+                ++this->dispatching_;
+            }
+
+            ~dispatch_guard() OPENVRML_NOTHROW
+            {
+                --this->dispatching_;
+            }
+        };
+
+        void publish(std::auto_ptr<const dispatch_list> list) OPENVRML_NOTHROW;
+        void synchronize() OPENVRML_NOTHROW;
+        std::size_t collect_deliveries(delivery_map & deliveries)
+            OPENVRML_THROW1(std::bad_alloc);
     };
 
     template <typename FieldValue>
@@ -207,7 +254,17 @@ namespace openvrml {
         using boost::unique_lock;
         using boost::shared_mutex;
         unique_lock<shared_mutex> lock(this->listeners_mutex_);
-        return this->listeners_.insert(&listener).second;
+        if (this->listeners_.find(&listener) != this->listeners_.end()) {
+            return false;
+        }
+        const dispatch_list * const current = this->dispatch_list_.load();
+        std::auto_ptr<dispatch_list> list(current
+                                          ? new dispatch_list(*current)
+                                          : new dispatch_list);
+        list->push_back(static_cast<void *>(&listener));
+        this->listeners_.insert(&listener);
+        this->publish(std::auto_ptr<const dispatch_list>(list));
+        return true;
     }
 
     template <typename FieldValue>
@@ -217,7 +274,33 @@ namespace openvrml {
         using boost::unique_lock;
         using boost::shared_mutex;
         unique_lock<shared_mutex> lock(this->listeners_mutex_);
-        return (this->listeners_.erase(&listener) > 0);
+        if (this->listeners_.erase(&listener) == 0) { return false; }
+        const dispatch_list * const current = this->dispatch_list_.load();
+        assert(current);
+        void * const entry = static_cast<void *>(&listener);
+        try {
+            std::auto_ptr<dispatch_list> list(new dispatch_list);
+            list->reserve(current->size() - 1);
+            std::remove_copy(current->begin(), current->end(),
+                             std::back_inserter(*list),
+                             entry);
+            this->publish(std::auto_ptr<const dispatch_list>(list));
+        } catch (std::bad_alloc &) {
+            //
+            // If we can't allocate a replacement list, clear the entry in
+            // the published one; emit_event skips null entries.
+            //
+            dispatch_list & in_place = const_cast<dispatch_list &>(*current);
+            std::replace(in_place.begin(), in_place.end(),
+                         entry, static_cast<void *>(0));
+        }
+        //
+        // Once remove returns, the listener must not receive any more events
+        // from this emitter; wait for any emission still walking an older
+        // list.
+        //
+        this->synchronize();
+        return true;
     }
 
     template <typename FieldValue>
@@ -247,22 +330,42 @@ namespace openvrml {
     void event_emitter::emit_event(const double timestamp)
         OPENVRML_THROW1(std::bad_alloc)
     {
-        using boost::shared_lock;
-        using boost::shared_mutex;
-        shared_lock<shared_mutex> listeners_lock(this->listeners_mutex_);
-        shared_lock<shared_mutex> last_time_lock(this->last_time_mutex_);
-        for (typename listener_set::iterator listener =
-                 this->listeners_.begin();
-             listener != this->listeners_.end();
-             ++listener) {
+        this->dispatch<FieldValue>(timestamp, 0);
+    }
+
+    template <typename FieldValue>
+    std::size_t
+    event_emitter::dispatch(const double timestamp,
+                            const delivery_map * const deliveries)
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        dispatch_guard guard(this->dispatching_);
+
+        std::size_t delivered = 0;
+        const dispatch_list * const list = this->dispatch_list_.load();
+        if (list) {
             using boost::polymorphic_downcast;
-            assert(*listener);
-            dynamic_cast<field_value_listener<FieldValue> &>(**listener)
-                .process_event(
-                    *polymorphic_downcast<const FieldValue *>(&this->value()),
-                    timestamp);
+            const FieldValue & value =
+                *polymorphic_downcast<const FieldValue *>(&this->value());
+            for (dispatch_list::const_iterator listener = list->begin();
+                 listener != list->end();
+                 ++listener) {
+                if (!*listener) { continue; }
+                if (deliveries) {
+                    const delivery_map::const_iterator delivery =
+                        deliveries->find(*listener);
+                    if (delivery != deliveries->end()
+                        && delivery->second != this) {
+                        continue;
+                    }
+                }
+                static_cast<field_value_listener<FieldValue> *>(*listener)
+                    ->process_event(value, timestamp);
+                ++delivered;
+            }
         }
-        this->last_time_ = timestamp;
+        this->last_time_.store(timestamp);
+        return delivered;
     }
 
 
@@ -286,6 +389,9 @@ namespace openvrml {
     private:
         virtual void emit_event(double timestamp)
             OPENVRML_THROW1(std::bad_alloc);
+        virtual std::size_t
+        emit_coalesced_event(double timestamp, const delivery_map & deliveries)
+            OPENVRML_THROW1(std::bad_alloc);
     };
 
     template <typename FieldValue>
@@ -308,6 +414,17 @@ namespace openvrml {
         this->event_emitter::template emit_event<FieldValue>(timestamp);
     }
 
+    template <typename FieldValue>
+    std::size_t
+    field_value_emitter<FieldValue>::
+    emit_coalesced_event(const double timestamp,
+                         const delivery_map & deliveries)
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        return this->event_emitter::template dispatch<FieldValue>(timestamp,
+                                                                 &deliveries);
+    }
+
     template <typename FieldValue>
     inline bool
     field_value_emitter<FieldValue>::
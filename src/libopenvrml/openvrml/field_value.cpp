@@ -104,30 +104,88 @@ openvrml::field_value::counted_impl_base::clone() const OPENVRML_THROW1(std::bad
  * @exception std::bad_alloc    if memory allocation fails.
  */
 
+/**
+ * @internal
+ *
+ * @struct openvrml::field_value::inline_value openvrml/field_value.h
+ *
+ * @brief Whether @c counted_impl stores a @p ValueType directly.
+ *
+ * This is true for the small, fixed-size @c value_type%s of the scalar
+ * single-value fields (e.g., @c float and @c vec3f).  Copying one of these
+ * is cheaper than sharing it; so they are held without indirection or
+ * synchronization.
+ *
+ * @tparam ValueType    a @link FieldValueConcept Field Value@endlink
+ *                      @c value_type.
+ */
+
 /**
  * @internal
  *
  * @class openvrml::field_value::counted_impl openvrml/field_value.h
  *
- * @brief Concrete reference-counted implementation.
+ * @brief Concrete implementation.
+ *
+ * The primary template, used when @p Inline is @c true, holds the value
+ * directly.  Reads do not lock; as with any @c field_value, concurrent
+ * reads and writes of the same instance must be synchronized by the
+ * caller.
+ *
+ * The partial specialization for @p Inline @c false (used for the
+ * multi-value fields and for @c sfimage, @c sfnode and @c sfstring) holds
+ * an immutable, reference-counted @c buffer that is shared among copies.
+ * @c #value returns a reference into the current @c buffer without
+ * locking; the reference remains valid until the instance is next
+ * modified or destroyed.  A write constructs a new @c buffer and publishes
+ * it with an atomic exchange.  A spin lock (a single flag) serializes
+ * taking a reference to the current @c buffer when copying against
+ * replacing it, so a copy never references a @c buffer that has been
+ * freed.
  *
  * @tparam ValueType    a @link FieldValueConcept Field Value@endlink
  *                      @c value_type.
+ * @tparam Inline       whether @p ValueType is stored directly.
+ */
+
+/**
+ * @var ValueType openvrml::field_value::counted_impl::value_
+ *
+ * @brief The value.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::field_value::counted_impl<ValueType, false>::buffer
+ *
+ * @brief An immutable, reference-counted value.
+ */
+
+/**
+ * @var boost::atomic<std::size_t> openvrml::field_value::counted_impl<ValueType, false>::buffer::refs
+ *
+ * @brief The number of @c counted_impl instances that refer to the
+ *        @c buffer.
  */
 
 /**
- * @var boost::shared_mutex openvrml::field_value::counted_impl::mutex_
+ * @var const ValueType openvrml::field_value::counted_impl<ValueType, false>::buffer::value
  *
- * @brief Mutex protecting @c #value_.
+ * @brief The value.
  */
 
 /**
- * @var boost::shared_ptr<ValueType> openvrml::field_value::counted_impl::value_
+ * @var boost::atomic<buffer *> openvrml::field_value::counted_impl<ValueType, false>::buffer_
  *
- * @brief A @c shared_ptr to an instance of the @c value_type of a
- *        @link openvrml::FieldValueConcept Field Value@endlink.
+ * @brief The current @c buffer.
+ */
+
+/**
+ * @var boost::atomic<bool> openvrml::field_value::counted_impl<ValueType, false>::locked_
  *
- * @sa http://boost.org/libs/smart_ptr/shared_ptr.htm
+ * @brief Spin lock serializing @c #acquire and the exchange in
+ *        @c #value(const ValueType &).
  */
 
 /**
@@ -144,10 +202,12 @@ openvrml::field_value::counted_impl_base::clone() const OPENVRML_THROW1(std::bad
  */
 
 /**
- * @fn openvrml::field_value::counted_impl::counted_impl(const counted_impl<ValueType> & ci)
+ * @fn openvrml::field_value::counted_impl::counted_impl(const counted_impl & ci)
  *
  * @brief Construct a copy.
  *
+ * A shared @c buffer is referenced rather than copied.
+ *
  * @tparam ValueType    a @link FieldValueConcept Field Value@endlink
  *                      @c value_type.
  *
@@ -164,7 +224,7 @@ openvrml::field_value::counted_impl_base::clone() const OPENVRML_THROW1(std::bad
  */
 
 /**
- * @fn openvrml::field_value::counted_impl<ValueType> & openvrml::field_value::counted_impl::operator=(const counted_impl<ValueType> &)
+ * @fn openvrml::field_value::counted_impl & openvrml::field_value::counted_impl::operator=(const counted_impl &)
  *
  * @brief Not implemented.
  */
@@ -206,6 +266,34 @@ openvrml::field_value::counted_impl_base::clone() const OPENVRML_THROW1(std::bad
  * @exception std::bad_alloc    if memory allocation fails.
  */
 
+/**
+ * @fn void openvrml::field_value::counted_impl<ValueType, false>::lock() const
+ *
+ * @brief Acquire @c #locked_.
+ */
+
+/**
+ * @fn void openvrml::field_value::counted_impl<ValueType, false>::unlock() const
+ *
+ * @brief Release @c #locked_.
+ */
+
+/**
+ * @fn openvrml::field_value::counted_impl<ValueType, false>::buffer * openvrml::field_value::counted_impl<ValueType, false>::acquire() const
+ *
+ * @brief Take a reference to the current @c buffer.
+ *
+ * @return the current @c buffer.
+ */
+
+/**
+ * @fn void openvrml::field_value::counted_impl<ValueType, false>::release(buffer * b)
+ *
+ * @brief Drop a reference to @p b, destroying it if it was the last.
+ *
+ * @param[in] b a @c buffer.
+ */
+
 /**
  * @internal
  *
@@ -25,11 +25,13 @@
 #   include <memory>
 #   include <string>
 #   include <typeinfo>
+#   include <boost/atomic.hpp>
 #   include <boost/cast.hpp>
 #   include <boost/concept_check.hpp>
 #   include <boost/intrusive_ptr.hpp>
 #   include <boost/scoped_ptr.hpp>
 #   include <boost/shared_ptr.hpp>
+#   include <boost/type_traits/integral_constant.hpp>
 #   include <boost/utility.hpp>
 #   include <boost/thread.hpp>
 #   include <openvrml/basetypes.h>
@@ -58,27 +60,65 @@ namespace openvrml {
         };
 
         template <typename ValueType>
+        struct inline_value : boost::false_type {};
+
+        template <typename ValueType,
+                  bool Inline = inline_value<ValueType>::value>
         class counted_impl : public counted_impl_base {
-            mutable boost::shared_mutex mutex_;
-            boost::shared_ptr<ValueType> value_;
+            ValueType value_;
 
         public:
             explicit counted_impl(const ValueType & value)
                 OPENVRML_THROW1(std::bad_alloc);
-            counted_impl(const counted_impl<ValueType> & ci) OPENVRML_NOTHROW;
+            counted_impl(const counted_impl & ci) OPENVRML_NOTHROW;
             virtual ~counted_impl() OPENVRML_NOTHROW;
 
             const ValueType & value() const OPENVRML_NOTHROW;
             void value(const ValueType & val) OPENVRML_THROW1(std::bad_alloc);
 
         private:
-            counted_impl<ValueType> &
-            operator=(const counted_impl<ValueType> &);
+            counted_impl & operator=(const counted_impl &);
 
             virtual std::auto_ptr<counted_impl_base> do_clone() const
                 OPENVRML_THROW1(std::bad_alloc);
         };
 
+        template <typename ValueType>
+        class counted_impl<ValueType, false> : public counted_impl_base {
+            struct buffer : boost::noncopyable {
+                boost::atomic<std::size_t> refs;
+                const ValueType value;
+
+                explicit buffer(const ValueType & value):
+                    refs(1),
+                    value(value)
+                {}
+            };
+
+            boost::atomic<buffer *> buffer_;
+            mutable boost::atomic<bool> locked_;
+
+        public:
+            explicit counted_impl(const ValueType & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            counted_impl(const counted_impl & ci) OPENVRML_NOTHROW;
+            virtual ~counted_impl() OPENVRML_NOTHROW;
+
+            const ValueType & value() const OPENVRML_NOTHROW;
+            void value(const ValueType & val) OPENVRML_THROW1(std::bad_alloc);
+
+        private:
+            counted_impl & operator=(const counted_impl &);
+
+            virtual std::auto_ptr<counted_impl_base> do_clone() const
+                OPENVRML_THROW1(std::bad_alloc);
+
+            void lock() const OPENVRML_NOTHROW;
+            void unlock() const OPENVRML_NOTHROW;
+            buffer * acquire() const OPENVRML_NOTHROW;
+            static void release(buffer * b) OPENVRML_NOTHROW;
+        };
+
     private:
         boost::scoped_ptr<counted_impl_base> counted_impl_;
 
@@ -164,60 +204,160 @@ namespace openvrml {
         virtual void print(std::ostream & out) const = 0;
     };
 
-    template <typename ValueType>
-    field_value::counted_impl<ValueType>::
+    template <>
+    struct field_value::inline_value<bool> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<color> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<color_rgba> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<float> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<double> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<int32> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<rotation> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<vec2f> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<vec2d> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<vec3f> : boost::true_type {};
+    template <>
+    struct field_value::inline_value<vec3d> : boost::true_type {};
+
+    template <typename ValueType, bool Inline>
+    field_value::counted_impl<ValueType, Inline>::
     counted_impl(const ValueType & value) OPENVRML_THROW1(std::bad_alloc):
-        value_(new ValueType(value))
+        value_(value)
     {}
 
-    template <typename ValueType>
-    field_value::counted_impl<ValueType>::
-    counted_impl(const counted_impl<ValueType> & ci) OPENVRML_NOTHROW:
-        counted_impl_base()
+    template <typename ValueType, bool Inline>
+    field_value::counted_impl<ValueType, Inline>::
+    counted_impl(const counted_impl & ci) OPENVRML_NOTHROW:
+        counted_impl_base(),
+        value_(ci.value_)
+    {}
+
+    template <typename ValueType, bool Inline>
+    field_value::counted_impl<ValueType, Inline>::~counted_impl()
+        OPENVRML_NOTHROW
+    {}
+
+    template <typename ValueType, bool Inline>
+    const ValueType &
+    field_value::counted_impl<ValueType, Inline>::value() const
+        OPENVRML_NOTHROW
     {
-        using boost::shared_lock;
-        using boost::shared_mutex;
-        shared_lock<shared_mutex> lock(ci.mutex_);
-        value_ = ci.value_;
+        return this->value_;
     }
 
+    template <typename ValueType, bool Inline>
+    void
+    field_value::counted_impl<ValueType, Inline>::value(const ValueType & val)
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        this->value_ = val;
+    }
+
+    template <typename ValueType, bool Inline>
+    std::auto_ptr<field_value::counted_impl_base>
+    field_value::counted_impl<ValueType, Inline>::do_clone() const
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        return std::auto_ptr<counted_impl_base>(new counted_impl(*this));
+    }
+
+    template <typename ValueType>
+    field_value::counted_impl<ValueType, false>::
+    counted_impl(const ValueType & value) OPENVRML_THROW1(std::bad_alloc):
+        buffer_(new buffer(value)),
+        locked_(false)
+    {}
+
     template <typename ValueType>
-    field_value::counted_impl<ValueType>::~counted_impl() OPENVRML_NOTHROW
+    field_value::counted_impl<ValueType, false>::
+    counted_impl(const counted_impl & ci) OPENVRML_NOTHROW:
+        counted_impl_base(),
+        buffer_(ci.acquire()),
+        locked_(false)
     {}
 
     template <typename ValueType>
-    const ValueType & field_value::counted_impl<ValueType>::value() const
+    field_value::counted_impl<ValueType, false>::~counted_impl()
+        OPENVRML_NOTHROW
+    {
+        release(this->buffer_.load(boost::memory_order_relaxed));
+    }
+
+    template <typename ValueType>
+    const ValueType &
+    field_value::counted_impl<ValueType, false>::value() const
         OPENVRML_NOTHROW
     {
-        using boost::shared_lock;
-        using boost::shared_mutex;
-        shared_lock<shared_mutex> lock(this->mutex_);
-        assert(this->value_);
-        return *this->value_;
+        const buffer * const b =
+            this->buffer_.load(boost::memory_order_acquire);
+        assert(b);
+        return b->value;
     }
 
     template <typename ValueType>
-    void field_value::counted_impl<ValueType>::value(const ValueType & val)
+    void
+    field_value::counted_impl<ValueType, false>::value(const ValueType & val)
         OPENVRML_THROW1(std::bad_alloc)
     {
-        using boost::unique_lock;
-        using boost::shared_mutex;
-        unique_lock<shared_mutex> lock(this->mutex_);
-        assert(this->value_);
-        if (!this->value_.unique()) {
-            this->value_.reset(new ValueType(val));
-        } else {
-            *this->value_ = val;
-        }
+        buffer * const replacement = new buffer(val);
+        this->lock();
+        buffer * const old =
+            this->buffer_.exchange(replacement, boost::memory_order_acq_rel);
+        this->unlock();
+        release(old);
     }
 
     template <typename ValueType>
     std::auto_ptr<field_value::counted_impl_base>
-    field_value::counted_impl<ValueType>::do_clone() const
+    field_value::counted_impl<ValueType, false>::do_clone() const
         OPENVRML_THROW1(std::bad_alloc)
     {
-        return std::auto_ptr<counted_impl_base>(
-            new counted_impl<ValueType>(*this));
+        return std::auto_ptr<counted_impl_base>(new counted_impl(*this));
+    }
+
+    template <typename ValueType>
+    void field_value::counted_impl<ValueType, false>::lock() const
+        OPENVRML_NOTHROW
+    {
+        while (this->locked_.exchange(true, boost::memory_order_acquire)) {
+            boost::this_thread::yield();
+        }
+    }
+
+    template <typename ValueType>
+    void field_value::counted_impl<ValueType, false>::unlock() const
+        OPENVRML_NOTHROW
+    {
+        this->locked_.store(false, boost::memory_order_release);
+    }
+
+    template <typename ValueType>
+    typename field_value::counted_impl<ValueType, false>::buffer *
+    field_value::counted_impl<ValueType, false>::acquire() const
+        OPENVRML_NOTHROW
+    {
+        this->lock();
+        buffer * const b = this->buffer_.load(boost::memory_order_relaxed);
+        b->refs.fetch_add(1, boost::memory_order_relaxed);
+        this->unlock();
+        return b;
+    }
+
+    template <typename ValueType>
+    void field_value::counted_impl<ValueType, false>::release(buffer * const b)
+        OPENVRML_NOTHROW
+    {
+        if (b->refs.fetch_sub(1, boost::memory_order_acq_rel) == 1) {
+            delete b;
+        }
     }
 
     template <typename ValueType>
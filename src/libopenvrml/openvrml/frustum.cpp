@@ -223,3 +223,39 @@ void openvrml::frustum::update()
     bot_plane[2] = top_plane[2];
     bot_plane[3] = 0;
 }
+
+/**
+ * @brief Get the clip planes.
+ *
+ * The planes are given in the order left, right, top, bottom, near, far.  A
+ * point @e p is inside plane @e i if
+ * <code>plane[i][0] * p.x() + plane[i][1] * p.y() + plane[i][2] * p.z()
+ * + plane[i][3] >= 0</code>.
+ *
+ * @param[out] plane    the clip planes.
+ */
+void openvrml::frustum::planes(float (&plane)[6][4]) const
+{
+    const float * const side[4] = {
+        this->left_plane, this->right_plane, this->top_plane, this->bot_plane
+    };
+    for (std::size_t i = 0; i < 4; ++i) {
+        plane[i][0] = side[i][0];
+        plane[i][1] = side[i][1];
+        plane[i][2] = side[i][2];
+        plane[i][3] = -side[i][3];
+    }
+
+    //
+    // The near and far planes are parallel to the xy-plane.
+    //
+    plane[4][0] = 0.0f;
+    plane[4][1] = 0.0f;
+    plane[4][2] = -1.0f;
+    plane[4][3] = -float(this->z_near);
+
+    plane[5][0] = 0.0f;
+    plane[5][1] = 0.0f;
+    plane[5][2] = 1.0f;
+    plane[5][3] = float(this->z_far);
+}
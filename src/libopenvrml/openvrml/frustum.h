@@ -37,6 +37,8 @@ namespace openvrml {
         frustum();
         frustum(float fovy, float aspect, double z_near, double z_far);
 
+        void planes(float (&plane)[6][4]) const;
+
     private:
         void update();
     };
@@ -0,0 +1,315 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "avatar_collision.h"
+# include <algorithm>
+# include <cmath>
+# include <limits>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    using openvrml::vec3f;
+    using openvrml::grouping_node;
+    using openvrml::local::avatar;
+    using openvrml::local::collision_triangle;
+
+    //
+    // The most steps a move is divided into, and the most times the avatar
+    // is pushed out of the geometry after each step.
+    //
+    const std::size_t max_steps = 64;
+    const std::size_t max_iterations = 4;
+
+    const float epsilon = 1.0e-6f;
+
+    //
+    // The point of the triangle a, b, c closest to p.
+    //
+    OPENVRML_LOCAL const vec3f closest_point(const vec3f & p,
+                                             const vec3f & a,
+                                             const vec3f & b,
+                                             const vec3f & c)
+    {
+        const vec3f ab = b - a, ac = c - a, ap = p - a;
+        const float d1 = ab.dot(ap), d2 = ac.dot(ap);
+        if (d1 <= 0.0f && d2 <= 0.0f) { return a; }
+
+        const vec3f bp = p - b;
+        const float d3 = ab.dot(bp), d4 = ac.dot(bp);
+        if (d3 >= 0.0f && d4 <= d3) { return b; }
+
+        const float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+            return a + (d1 / (d1 - d3)) * ab;
+        }
+
+        const vec3f cp = p - c;
+        const float d5 = ab.dot(cp), d6 = ac.dot(cp);
+        if (d6 >= 0.0f && d5 <= d6) { return c; }
+
+        const float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+            return a + (d2 / (d2 - d6)) * ac;
+        }
+
+        const float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+            return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+        }
+
+        const float denominator = 1.0f / (va + vb + vc);
+        return a + (vb * denominator) * ab + (vc * denominator) * ac;
+    }
+
+    //
+    // Intersect a ray with either side of a triangle.
+    //
+    OPENVRML_LOCAL bool intersect(const vec3f & origin,
+                                  const vec3f & direction,
+                                  const collision_triangle & triangle,
+                                  float & t)
+    {
+        const vec3f edge1 = triangle.vertex[1] - triangle.vertex[0];
+        const vec3f edge2 = triangle.vertex[2] - triangle.vertex[0];
+        const vec3f p = direction * edge2;
+        const float det = edge1.dot(p);
+        if (std::fabs(det) < epsilon) { return false; }
+        const float inverse = 1.0f / det;
+        const vec3f s = origin - triangle.vertex[0];
+        const float u = s.dot(p) * inverse;
+        if (u < 0.0f || u > 1.0f) { return false; }
+        const vec3f q = s * edge1;
+        const float v = direction.dot(q) * inverse;
+        if (v < 0.0f || u + v > 1.0f) { return false; }
+        t = edge2.dot(q) * inverse;
+        return t >= 0.0f;
+    }
+
+    OPENVRML_LOCAL void collided(const collision_triangle & triangle,
+                                 std::vector<grouping_node *> & collisions)
+    {
+        if (triangle.collision
+            && std::find(collisions.begin(), collisions.end(),
+                         triangle.collision) == collisions.end()) {
+            collisions.push_back(triangle.collision);
+        }
+    }
+
+    //
+    // Push the spheres that make up the avatar's body out of the triangles.
+    // When following terrain, the avatar is pushed only horizontally; the
+    // ground holds it up.
+    //
+    OPENVRML_LOCAL void
+    push_out(const std::vector<collision_triangle> & triangles,
+             const avatar & a,
+             const std::vector<float> & body,
+             vec3f & position,
+             std::vector<grouping_node *> & collisions)
+    {
+        const float radius2 = a.radius * a.radius;
+        for (std::size_t iteration = 0;
+             iteration < max_iterations;
+             ++iteration) {
+            bool moved = false;
+            for (std::size_t i = 0; i < triangles.size(); ++i) {
+                const collision_triangle & triangle = triangles[i];
+                for (std::size_t j = 0; j < body.size(); ++j) {
+                    const vec3f center = position + body[j] * a.up;
+                    const vec3f offset =
+                        center - closest_point(center,
+                                               triangle.vertex[0],
+                                               triangle.vertex[1],
+                                               triangle.vertex[2]);
+                    const float distance2 = offset.dot(offset);
+                    if (distance2 >= radius2) { continue; }
+
+                    const float distance = std::sqrt(distance2);
+                    vec3f normal;
+                    if (distance > epsilon) {
+                        normal = (1.0f / distance) * offset;
+                    } else {
+                        normal = (triangle.vertex[1] - triangle.vertex[0])
+                            * (triangle.vertex[2] - triangle.vertex[0]);
+                        if (normal.length() < epsilon) { continue; }
+                        normal = normal.normalize();
+                    }
+                    vec3f push = (a.radius - distance) * normal;
+                    if (a.terrain_following) {
+                        push = push - push.dot(a.up) * a.up;
+                        if (push.length() < epsilon) { continue; }
+                    }
+                    position = position + push;
+                    moved = true;
+                    collided(triangle, collisions);
+                }
+            }
+            if (!moved) { break; }
+        }
+    }
+
+    //
+    // Keep the avatar's eye height above the ground beneath it.  Returns
+    // false if the ground is too high to step onto.
+    //
+    OPENVRML_LOCAL bool
+    follow_terrain(const std::vector<collision_triangle> & triangles,
+                   const avatar & a,
+                   vec3f & position,
+                   std::vector<grouping_node *> & collisions)
+    {
+        const vec3f down = -a.up;
+        float ground = std::numeric_limits<float>::max();
+        std::size_t hit = triangles.size();
+        for (std::size_t i = 0; i < triangles.size(); ++i) {
+            float t;
+            if (intersect(position, down, triangles[i], t) && t < ground) {
+                ground = t;
+                hit = i;
+            }
+        }
+        if (hit == triangles.size()) { return true; }
+        if (ground < a.height - a.step) {
+            collided(triangles[hit], collisions);
+            return false;
+        }
+        position = position + (a.height - ground) * a.up;
+        return true;
+    }
+}
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::avatar
+ *
+ * @brief The dimensions of the avatar, as given by the active
+ *        NavigationInfo.
+ */
+
+/**
+ * @var float openvrml::local::avatar::radius
+ *
+ * @brief The allowable distance between the avatar and geometry.
+ */
+
+/**
+ * @var float openvrml::local::avatar::height
+ *
+ * @brief The height of the eye above the ground.
+ */
+
+/**
+ * @var float openvrml::local::avatar::step
+ *
+ * @brief The height of the tallest object the avatar can step over.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::avatar::up
+ *
+ * @brief The unit up direction, in world coordinates.
+ */
+
+/**
+ * @var bool openvrml::local::avatar::terrain_following
+ *
+ * @brief Whether the avatar walks on the ground.
+ */
+
+/**
+ * @internal
+ *
+ * @brief Move the avatar as far toward a destination as the geometry lets
+ *        it.
+ *
+ * The avatar is a capsule: a column of spheres of @a avatar::radius running
+ * from the eye down to @a avatar::step above the feet.  The move is made in
+ * steps no longer than half the radius, so that thin geometry is not
+ * passed through; after each step, the spheres are pushed out of any
+ * triangle they intersect, which lets the avatar slide along walls.
+ *
+ * When following terrain, the eye is kept @a avatar::height above the
+ * ground beneath it: the avatar climbs onto anything no taller than
+ * @a avatar::step and falls onto anything lower.  A step onto anything
+ * taller is refused.
+ *
+ * @param[in] triangles     the triangles the avatar can collide with.
+ * @param[in] a             the avatar.
+ * @param[in] position      the eye position.
+ * @param[in] destination   the eye position the avatar is moving to.
+ * @param[in,out] collisions    the Collision nodes of the triangles the
+ *                              avatar collides with are appended, if they
+ *                              are not already present.
+ *
+ * @return the eye position the avatar reaches.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const openvrml::vec3f
+openvrml::local::move_avatar(const std::vector<collision_triangle> & triangles,
+                             const avatar & a,
+                             const vec3f & position,
+                             const vec3f & destination,
+                             std::vector<grouping_node *> & collisions)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (triangles.empty() || !(a.radius > 0.0f)) { return destination; }
+
+    //
+    // The offsets of the spheres from the eye along the up direction.
+    //
+    std::vector<float> body(1, 0.0f);
+    const float span = a.height - a.step - a.radius;
+    if (span > 0.0f) {
+        const std::size_t n =
+            static_cast<std::size_t>(std::ceil(span / a.radius));
+        for (std::size_t i = 1; i <= n; ++i) {
+            body.push_back(-span * float(i) / float(n));
+        }
+    }
+
+    const vec3f move = destination - position;
+    const std::size_t steps =
+        std::max(std::size_t(1),
+                 std::min(max_steps,
+                          static_cast<std::size_t>(
+                              std::ceil(move.length() / (0.5f * a.radius)))));
+    const vec3f step = (1.0f / float(steps)) * move;
+
+    vec3f result = position;
+    for (std::size_t i = 0; i < steps; ++i) {
+        const vec3f previous = result;
+        result = result + step;
+        push_out(triangles, a, body, result, collisions);
+        if (a.terrain_following) {
+            if (!follow_terrain(triangles, a, result, collisions)) {
+                result = previous;
+                break;
+            }
+            push_out(triangles, a, body, result, collisions);
+        }
+    }
+    return result;
+}
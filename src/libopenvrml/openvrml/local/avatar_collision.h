@@ -0,0 +1,48 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_AVATAR_COLLISION_H
+#   define OPENVRML_LOCAL_AVATAR_COLLISION_H
+
+#   include <openvrml/local/pick_engine.h>
+
+namespace openvrml {
+
+    namespace local {
+
+        struct OPENVRML_LOCAL avatar {
+            float radius;
+            float height;
+            float step;
+            vec3f up;
+            bool terrain_following;
+        };
+
+        OPENVRML_LOCAL const vec3f
+        move_avatar(const std::vector<collision_triangle> & triangles,
+                    const avatar & a,
+                    const vec3f & position,
+                    const vec3f & destination,
+                    std::vector<grouping_node *> & collisions)
+            OPENVRML_THROW1(std::bad_alloc);
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_AVATAR_COLLISION_H
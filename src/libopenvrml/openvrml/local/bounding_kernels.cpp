@@ -0,0 +1,467 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "bounding_kernels.h"
+# include <boost/static_assert.hpp>
+# include <limits>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+# if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OPENVRML_LOCAL_SSE2
+#   include <emmintrin.h>
+# endif
+
+/**
+ * @file openvrml/local/bounding_kernels.h
+ *
+ * @brief Batch computations over points and bounding volumes.
+ *
+ * These are the inner loops of @c openvrml::bounding_volume and its
+ * subclasses.  Where SSE2 is available they process four points or spheres
+ * at a time; the remainder, and builds without SSE2, use equivalent scalar
+ * code.  The vector and scalar paths perform the same floating point
+ * operations in the same order, so their results are identical.
+ */
+
+//
+// The kernels treat an array of vec3f as packed x, y, z triples.
+//
+BOOST_STATIC_ASSERT(sizeof (openvrml::vec3f) == 3 * sizeof (float));
+
+namespace {
+
+# ifdef OPENVRML_LOCAL_SSE2
+    //
+    // Load four packed vec3f into x, y, and z vectors.
+    //
+    OPENVRML_LOCAL inline void load4(const openvrml::vec3f * const p,
+                                     __m128 & x,
+                                     __m128 & y,
+                                     __m128 & z)
+    {
+        const float * const f = &p->vec[0];
+        const __m128 a = _mm_loadu_ps(f);     // x0 y0 z0 x1
+        const __m128 b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+        const __m128 c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+        x = _mm_shuffle_ps(a,
+                           _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+                           _MM_SHUFFLE(2, 0, 3, 0));
+        y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                           _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                           _MM_SHUFFLE(2, 0, 2, 0));
+        z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                           c,
+                           _MM_SHUFFLE(3, 0, 2, 0));
+    }
+
+    OPENVRML_LOCAL inline __m128i select(const __m128 mask,
+                                         const __m128i a,
+                                         const __m128i b)
+    {
+        const __m128i m = _mm_castps_si128(mask);
+        return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+    }
+
+    //
+    // Reduce per-lane extremes to the first point holding the extreme
+    // value.
+    //
+    template <typename Compare>
+    OPENVRML_LOCAL std::size_t reduce(const __m128 value,
+                                      const __m128i index,
+                                      const Compare & compare)
+    {
+        float v[4];
+        int i[4];
+        _mm_storeu_ps(v, value);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(i), index);
+        std::size_t best = 0;
+        for (std::size_t lane = 1; lane < 4; ++lane) {
+            if (compare(v[lane], v[best])
+                || (v[lane] == v[best] && i[lane] < i[best])) {
+                best = lane;
+            }
+        }
+        return std::size_t(i[best]);
+    }
+
+    struct OPENVRML_LOCAL less {
+        bool operator()(const float a, const float b) const
+        {
+            return a < b;
+        }
+    };
+
+    struct OPENVRML_LOCAL greater {
+        bool operator()(const float a, const float b) const
+        {
+            return a > b;
+        }
+    };
+# endif
+}
+
+/**
+ * @internal
+ *
+ * @brief Find the points with the least and greatest coordinates.
+ *
+ * Where several points share an extreme coordinate, the first is chosen.
+ *
+ * @param[in]  p            points.
+ * @param[in]  n            the number of points; must be nonzero.
+ * @param[out] min_index    the indices of the points with the least x, y,
+ *                          and z coordinates.
+ * @param[out] max_index    the indices of the points with the greatest x, y,
+ *                          and z coordinates.
+ */
+void openvrml::local::extreme_points(const vec3f * const p,
+                                     const std::size_t n,
+                                     std::size_t (&min_index)[3],
+                                     std::size_t (&max_index)[3])
+    OPENVRML_NOTHROW
+{
+    std::size_t i = 0;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+        min_index[axis] = max_index[axis] = 0;
+    }
+
+# ifdef OPENVRML_LOCAL_SSE2
+    //
+    // Indices are tracked in 32-bit lanes; larger arrays use the scalar
+    // loop.
+    //
+    if (n >= 4 && n <= std::size_t(std::numeric_limits<int>::max())) {
+        __m128 min_v[3], max_v[3];
+        load4(p, min_v[0], min_v[1], min_v[2]);
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            max_v[axis] = min_v[axis];
+        }
+        __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+        __m128i min_i[3] = { index, index, index };
+        __m128i max_i[3] = { index, index, index };
+        const __m128i four = _mm_set1_epi32(4);
+        for (i = 4; i + 4 <= n; i += 4) {
+            index = _mm_add_epi32(index, four);
+            __m128 v[3];
+            load4(p + i, v[0], v[1], v[2]);
+            for (std::size_t axis = 0; axis < 3; ++axis) {
+                const __m128 lt = _mm_cmplt_ps(v[axis], min_v[axis]);
+                min_v[axis] = _mm_min_ps(v[axis], min_v[axis]);
+                min_i[axis] = select(lt, index, min_i[axis]);
+                const __m128 gt = _mm_cmpgt_ps(v[axis], max_v[axis]);
+                max_v[axis] = _mm_max_ps(v[axis], max_v[axis]);
+                max_i[axis] = select(gt, index, max_i[axis]);
+            }
+        }
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            min_index[axis] = reduce(min_v[axis], min_i[axis], less());
+            max_index[axis] = reduce(max_v[axis], max_i[axis], greater());
+        }
+    }
+# endif
+
+    for (; i < n; ++i) {
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            if (p[i][axis] < p[min_index[axis]][axis]) {
+                min_index[axis] = i;
+            }
+            if (p[i][axis] > p[max_index[axis]][axis]) {
+                max_index[axis] = i;
+            }
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Find the least and greatest coordinates of some points.
+ *
+ * @param[in]  p        points.
+ * @param[in]  n        the number of points; must be nonzero.
+ * @param[out] minimum  the least coordinates.
+ * @param[out] maximum  the greatest coordinates.
+ */
+void openvrml::local::point_bounds(const vec3f * const p,
+                                   const std::size_t n,
+                                   vec3f & minimum,
+                                   vec3f & maximum)
+    OPENVRML_NOTHROW
+{
+    minimum = maximum = p[0];
+    std::size_t i = 1;
+
+# ifdef OPENVRML_LOCAL_SSE2
+    if (n >= 4) {
+        __m128 min_x, min_y, min_z;
+        load4(p, min_x, min_y, min_z);
+        __m128 max_x = min_x, max_y = min_y, max_z = min_z;
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m128 x, y, z;
+            load4(p + i, x, y, z);
+            min_x = _mm_min_ps(x, min_x);
+            min_y = _mm_min_ps(y, min_y);
+            min_z = _mm_min_ps(z, min_z);
+            max_x = _mm_max_ps(x, max_x);
+            max_y = _mm_max_ps(y, max_y);
+            max_z = _mm_max_ps(z, max_z);
+        }
+        float lo[3][4], hi[3][4];
+        _mm_storeu_ps(lo[0], min_x);
+        _mm_storeu_ps(lo[1], min_y);
+        _mm_storeu_ps(lo[2], min_z);
+        _mm_storeu_ps(hi[0], max_x);
+        _mm_storeu_ps(hi[1], max_y);
+        _mm_storeu_ps(hi[2], max_z);
+        for (std::size_t lane = 0; lane < 4; ++lane) {
+            for (std::size_t axis = 0; axis < 3; ++axis) {
+                if (lo[axis][lane] < minimum[axis]) {
+                    minimum.vec[axis] = lo[axis][lane];
+                }
+                if (hi[axis][lane] > maximum[axis]) {
+                    maximum.vec[axis] = hi[axis][lane];
+                }
+            }
+        }
+    }
+# endif
+
+    for (; i < n; ++i) {
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            if (p[i][axis] < minimum[axis]) {
+                minimum.vec[axis] = p[i][axis];
+            }
+            if (p[i][axis] > maximum[axis]) {
+                maximum.vec[axis] = p[i][axis];
+            }
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Find the first point that is not inside a sphere.
+ *
+ * @param[in] p                 points.
+ * @param[in] n                 the number of points.
+ * @param[in] center            the center of the sphere.
+ * @param[in] radius_squared    the square of the radius of the sphere.
+ *
+ * @return the index of the first point whose squared distance from
+ *         @p center is not less than @p radius_squared; or @p n if there is
+ *         no such point.
+ */
+std::size_t openvrml::local::find_outside(const vec3f * const p,
+                                          const std::size_t n,
+                                          const vec3f & center,
+                                          const float radius_squared)
+    OPENVRML_NOTHROW
+{
+    std::size_t i = 0;
+
+# ifdef OPENVRML_LOCAL_SSE2
+    const __m128 cx = _mm_set1_ps(center.x());
+    const __m128 cy = _mm_set1_ps(center.y());
+    const __m128 cz = _mm_set1_ps(center.z());
+    const __m128 r2 = _mm_set1_ps(radius_squared);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x, y, z;
+        load4(p + i, x, y, z);
+        x = _mm_sub_ps(x, cx);
+        y = _mm_sub_ps(y, cy);
+        z = _mm_sub_ps(z, cz);
+        const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+                                                _mm_mul_ps(y, y)),
+                                     _mm_mul_ps(z, z));
+        const int outside = _mm_movemask_ps(_mm_cmpge_ps(d2, r2));
+        if (outside) {
+            std::size_t lane = 0;
+            while (!(outside & (1 << lane))) { ++lane; }
+            return i + lane;
+        }
+    }
+# endif
+
+    for (; i < n; ++i) {
+        const float x = p[i].x() - center.x();
+        const float y = p[i].y() - center.y();
+        const float z = p[i].z() - center.z();
+        if (x * x + y * y + z * z >= radius_squared) { return i; }
+    }
+    return n;
+}
+
+/**
+ * @internal
+ *
+ * @brief Multiply points by a matrix.
+ *
+ * The result is the same as that of @c vec3f::operator*=(const mat4f &) for
+ * each point.
+ *
+ * @param[in]     m matrix.
+ * @param[in,out] x x coordinates.
+ * @param[in,out] y y coordinates.
+ * @param[in,out] z z coordinates.
+ * @param[in]     n the number of points.
+ */
+void openvrml::local::transform_points(const mat4f & m,
+                                       float * const x,
+                                       float * const y,
+                                       float * const z,
+                                       const std::size_t n)
+    OPENVRML_NOTHROW
+{
+    std::size_t i = 0;
+
+# ifdef OPENVRML_LOCAL_SSE2
+    __m128 col[4][4];
+    for (std::size_t r = 0; r < 4; ++r) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            col[r][c] = _mm_set1_ps(m[r][c]);
+        }
+    }
+    for (; i + 4 <= n; i += 4) {
+        const __m128 px = _mm_loadu_ps(x + i);
+        const __m128 py = _mm_loadu_ps(y + i);
+        const __m128 pz = _mm_loadu_ps(z + i);
+        __m128 v[4];
+        for (std::size_t c = 0; c < 4; ++c) {
+            v[c] = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, col[0][c]),
+                                      _mm_mul_ps(py, col[1][c])),
+                           _mm_mul_ps(pz, col[2][c])),
+                col[3][c]);
+        }
+        _mm_storeu_ps(x + i, _mm_div_ps(v[0], v[3]));
+        _mm_storeu_ps(y + i, _mm_div_ps(v[1], v[3]));
+        _mm_storeu_ps(z + i, _mm_div_ps(v[2], v[3]));
+    }
+# endif
+
+    for (; i < n; ++i) {
+        vec3f p = make_vec3f(x[i], y[i], z[i]);
+        p *= m;
+        x[i] = p.x();
+        y[i] = p.y();
+        z[i] = p.z();
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Intersect spheres with a view volume.
+ *
+ * A sphere with a radius of -1 (empty) or of the largest @c float
+ * (maximized) intersects the view volume partially.
+ *
+ * @param[in]  plane    the view volume planes, as given by
+ *                      @c frustum::planes.
+ * @param[in]  x        x coordinates of the centers.
+ * @param[in]  y        y coordinates of the centers.
+ * @param[in]  z        z coordinates of the centers.
+ * @param[in]  radius   radii.
+ * @param[in]  n        the number of spheres.
+ * @param[out] result   the intersection of each sphere with the view
+ *                      volume.
+ */
+void
+openvrml::local::
+intersect_spheres(const float (&plane)[6][4],
+                  const float * const x,
+                  const float * const y,
+                  const float * const z,
+                  const float * const radius,
+                  const std::size_t n,
+                  bounding_volume::intersection * const result)
+    OPENVRML_NOTHROW
+{
+    static const float empty = -1.0f;
+    static const float maximized = std::numeric_limits<float>::max();
+
+    std::size_t i = 0;
+
+# ifdef OPENVRML_LOCAL_SSE2
+    __m128 pv[6][4];
+    for (std::size_t k = 0; k < 6; ++k) {
+        for (std::size_t c = 0; c < 4; ++c) {
+            pv[k][c] = _mm_set1_ps(plane[k][c]);
+        }
+    }
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 cx = _mm_loadu_ps(x + i);
+        const __m128 cy = _mm_loadu_ps(y + i);
+        const __m128 cz = _mm_loadu_ps(z + i);
+        const __m128 r = _mm_loadu_ps(radius + i);
+        const __m128 neg_r = _mm_xor_ps(r, sign);
+        __m128 outside = _mm_setzero_ps(), partial = _mm_setzero_ps();
+        for (std::size_t k = 0; k < 6; ++k) {
+            const __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(pv[k][0], cx),
+                                      _mm_mul_ps(pv[k][1], cy)),
+                           _mm_mul_ps(pv[k][2], cz)),
+                pv[k][3]);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_r));
+            partial = _mm_or_ps(partial, _mm_cmplt_ps(d, r));
+        }
+        const __m128 unbounded =
+            _mm_or_ps(_mm_cmpeq_ps(r, _mm_set1_ps(empty)),
+                      _mm_cmpeq_ps(r, _mm_set1_ps(maximized)));
+        const int out_mask = _mm_movemask_ps(outside);
+        const int partial_mask = _mm_movemask_ps(partial);
+        const int unbounded_mask = _mm_movemask_ps(unbounded);
+        for (std::size_t lane = 0; lane < 4; ++lane) {
+            const int bit = 1 << lane;
+            result[i + lane] = (unbounded_mask & bit)
+                ? bounding_volume::partial
+                : (out_mask & bit)
+                    ? bounding_volume::outside
+                    : (partial_mask & bit)
+                        ? bounding_volume::partial
+                        : bounding_volume::inside;
+        }
+    }
+# endif
+
+    for (; i < n; ++i) {
+        if (radius[i] == empty || radius[i] == maximized) {
+            result[i] = bounding_volume::partial;
+            continue;
+        }
+        result[i] = bounding_volume::inside;
+        for (std::size_t k = 0; k < 6; ++k) {
+            const float d = plane[k][0] * x[i] + plane[k][1] * y[i]
+                + plane[k][2] * z[i] + plane[k][3];
+            if (d < -radius[i]) {
+                result[i] = bounding_volume::outside;
+                break;
+            }
+            if (d < radius[i]) { result[i] = bounding_volume::partial; }
+        }
+    }
+}
@@ -0,0 +1,68 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_BOUNDING_KERNELS_H
+#   define OPENVRML_LOCAL_BOUNDING_KERNELS_H
+
+#   include <openvrml/bounding_volume.h>
+#   include <cstddef>
+
+namespace openvrml {
+
+    namespace local {
+
+        OPENVRML_LOCAL void extreme_points(const vec3f * p,
+                                           std::size_t n,
+                                           std::size_t (&min_index)[3],
+                                           std::size_t (&max_index)[3])
+            OPENVRML_NOTHROW;
+
+        OPENVRML_LOCAL void point_bounds(const vec3f * p,
+                                         std::size_t n,
+                                         vec3f & minimum,
+                                         vec3f & maximum)
+            OPENVRML_NOTHROW;
+
+        OPENVRML_LOCAL std::size_t find_outside(const vec3f * p,
+                                                std::size_t n,
+                                                const vec3f & center,
+                                                float radius_squared)
+            OPENVRML_NOTHROW;
+
+        OPENVRML_LOCAL void transform_points(const mat4f & m,
+                                             float * x,
+                                             float * y,
+                                             float * z,
+                                             std::size_t n)
+            OPENVRML_NOTHROW;
+
+        OPENVRML_LOCAL void
+        intersect_spheres(const float (&plane)[6][4],
+                          const float * x,
+                          const float * y,
+                          const float * z,
+                          const float * radius,
+                          std::size_t n,
+                          bounding_volume::intersection * result)
+            OPENVRML_NOTHROW;
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_BOUNDING_KERNELS_H
@@ -0,0 +1,789 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "bounding_volume_hierarchy.h"
+# include <openvrml/frustum.h>
+# include <openvrml/node.h>
+# include <cassert>
+# include <cmath>
+# include <memory>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    //
+    // Pending changes beyond this many are not recorded individually; the
+    // next update invalidates the whole hierarchy instead.
+    //
+    const std::size_t max_pending = 4096;
+}
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::bvh_entry
+ *
+ * @brief An occurrence of a @c bounded_volume_node in the
+ *        @c bounding_volume_hierarchy.
+ *
+ * A node that is @c USE%d in several places has an entry for each place it
+ * is rendered.  The entry caches the world-space box around the node's
+ * bounding volume.
+ */
+
+/**
+ * @var openvrml::local::bvh_entry * const openvrml::local::bvh_entry::parent
+ *
+ * @brief The parent entry; 0 for the root.
+ */
+
+/**
+ * @var openvrml::node * const openvrml::local::bvh_entry::n
+ *
+ * @brief The node; 0 for the root.
+ */
+
+/**
+ * @var const bool openvrml::local::bvh_entry::transform
+ *
+ * @brief Whether @a n is a @c transform_node.
+ */
+
+/**
+ * @var std::vector<openvrml::local::bvh_entry *> openvrml::local::bvh_entry::children
+ *
+ * @brief The entries for the nodes rendered by @a n, in the order they were
+ *        last rendered.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::next_child
+ *
+ * @brief Where to start looking for the next child entered.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::visited
+ *
+ * @brief The last frame in which the entry was entered.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::explored
+ *
+ * @brief The last frame in which any of the entry's children was entered.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::culled
+ *
+ * @brief The last frame in which the entry was found to be outside the view
+ *        volume or hidden behind occluders.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::marked
+ *
+ * @brief The last update that invalidated the entry.
+ */
+
+/**
+ * @var bool openvrml::local::bvh_entry::frame_valid
+ *
+ * @brief Whether @a frame and @a child_frame are current.
+ */
+
+/**
+ * @var bool openvrml::local::bvh_entry::frame_known
+ *
+ * @brief Whether the world transformation of the node's coordinate system is
+ *        known.
+ *
+ * It is not known beneath nodes other than @c transform_node%s that change
+ * the modelview matrix, such as a @c Billboard; there the view volume test
+ * is made in eye space.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::parent_revision
+ *
+ * @brief The parent's @a revision when @a frame was computed.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::revision
+ *
+ * @brief Changes whenever @a child_frame is computed.
+ */
+
+/**
+ * @var openvrml::mat4f openvrml::local::bvh_entry::frame
+ *
+ * @brief The world transformation of the coordinate system of the node's
+ *        bounding volume.
+ */
+
+/**
+ * @var openvrml::mat4f openvrml::local::bvh_entry::child_frame
+ *
+ * @brief The world transformation of the coordinate system of the node's
+ *        children.
+ */
+
+/**
+ * @var bool openvrml::local::bvh_entry::bounds_valid
+ *
+ * @brief Whether @a center and @a extent are current.
+ */
+
+/**
+ * @var bool openvrml::local::bvh_entry::bounds_finite
+ *
+ * @brief Whether the node's bounding volume is finite.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::bvh_entry::center
+ *
+ * @brief The center of the world-space box.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::bvh_entry::extent
+ *
+ * @brief The half-size of the world-space box along each axis.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bvh_entry::plane
+ *
+ * @brief The view volume plane that last put the entry outside.
+ *
+ * An entry that was outside is usually outside the same plane in the next
+ * frame; so that plane is tested first.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * @param[in] parent    the parent entry.
+ * @param[in] n         the node.
+ */
+openvrml::local::bvh_entry::bvh_entry(bvh_entry * const parent,
+                                      node * const n)
+    OPENVRML_NOTHROW:
+    parent(parent),
+    n(n),
+    transform(n && node_cast<transform_node *>(n)),
+    next_child(0),
+    visited(0),
+    explored(0),
+    culled(0),
+    marked(0),
+    frame_valid(!parent),
+    frame_known(!parent),
+    parent_revision(0),
+    revision(0),
+    frame(make_mat4f()),
+    child_frame(make_mat4f()),
+    bounds_valid(false),
+    bounds_finite(false),
+    center(make_vec3f()),
+    extent(make_vec3f()),
+    plane(0)
+{}
+
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::bounding_volume_hierarchy
+ *
+ * @brief World-space bounding boxes for the nodes rendered by a @c browser.
+ *
+ * The hierarchy mirrors the render traversal: @c #enter is called as each
+ * @c child_node or @c geometry_node is rendered and @c #leave when it is
+ * done.  Each entry caches the world-space box around its node's bounding
+ * volume; the box is recomputed only when the node's bounding volume or the
+ * transformation above it changes.  Culling tests the cached box against
+ * the view volume planes in world space, skipping the planes an ancestor is
+ * known to be inside.
+ *
+ * Changes reported by @c #dirty are propagated to the ancestors of each of
+ * the node's entries by @c #update, so that their bounding volumes are
+ * recalculated.
+ */
+
+/**
+ * @var openvrml::local::bounding_volume_hierarchy::planes
+ *
+ * @brief The number of view volume planes.
+ */
+
+/**
+ * @var openvrml::local::bounding_volume_hierarchy::all_planes
+ *
+ * @brief Plane mask with a bit set for each view volume plane.
+ */
+
+/**
+ * @typedef std::multimap<const openvrml::node *, openvrml::local::bvh_entry *> openvrml::local::bounding_volume_hierarchy::index_t
+ *
+ * @brief Map of nodes to their entries.
+ */
+
+/**
+ * @var openvrml::local::bvh_entry openvrml::local::bounding_volume_hierarchy::root_
+ *
+ * @brief The root entry.
+ */
+
+/**
+ * @var openvrml::local::bounding_volume_hierarchy::index_t openvrml::local::bounding_volume_hierarchy::index_
+ *
+ * @brief The entries for each node.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bounding_volume_hierarchy::frame_
+ *
+ * @brief The current frame.
+ */
+
+/**
+ * @var std::size_t openvrml::local::bounding_volume_hierarchy::revision_
+ *
+ * @brief Source of @c bvh_entry::revision values and update stamps.
+ */
+
+/**
+ * @var bool openvrml::local::bounding_volume_hierarchy::planes_valid_
+ *
+ * @brief Whether the current view volume could be represented by
+ *        @a plane_.
+ */
+
+/**
+ * @var float openvrml::local::bounding_volume_hierarchy::plane_[planes][4]
+ *
+ * @brief The world-space view volume planes.
+ *
+ * A point @e p is inside plane @e i if
+ * <code>plane_[i][0] * p.x() + plane_[i][1] * p.y() + plane_[i][2] * p.z()
+ * + plane_[i][3] >= 0</code>.
+ */
+
+/**
+ * @var boost::mutex openvrml::local::bounding_volume_hierarchy::pending_mutex_
+ *
+ * @brief Mutex protecting @a active_, @a overflow_, @a dirty_, and
+ *        @a forgotten_.
+ */
+
+/**
+ * @var bool openvrml::local::bounding_volume_hierarchy::active_
+ *
+ * @brief Whether a frame has been begun.
+ *
+ * Changes are not recorded until the hierarchy is in use.
+ */
+
+/**
+ * @var bool openvrml::local::bounding_volume_hierarchy::overflow_
+ *
+ * @brief Whether more changes were reported than were recorded.
+ */
+
+/**
+ * @var std::vector<const openvrml::node *> openvrml::local::bounding_volume_hierarchy::dirty_
+ *
+ * @brief Nodes whose bounding volumes have changed since the last update.
+ */
+
+/**
+ * @var std::vector<const openvrml::node *> openvrml::local::bounding_volume_hierarchy::forgotten_
+ *
+ * @brief Nodes that have been destroyed since the last update.
+ */
+
+/**
+ * @brief Construct.
+ */
+openvrml::local::bounding_volume_hierarchy::bounding_volume_hierarchy()
+    OPENVRML_NOTHROW:
+    root_(0, 0),
+    frame_(0),
+    revision_(0),
+    planes_valid_(false),
+    active_(false),
+    overflow_(false)
+{}
+
+/**
+ * @brief Destroy.
+ */
+openvrml::local::bounding_volume_hierarchy::~bounding_volume_hierarchy()
+    OPENVRML_NOTHROW
+{
+    this->clear();
+}
+
+/**
+ * @brief Note that the bounding volume of @p n has changed.
+ *
+ * This function may be called from any thread.
+ *
+ * @param[in] n a node.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::bounding_volume_hierarchy::dirty(const node & n)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::mutex::scoped_lock lock(this->pending_mutex_);
+    if (!this->active_ || this->overflow_) { return; }
+    if (this->dirty_.size() == max_pending) {
+        this->overflow_ = true;
+        this->dirty_.clear();
+        return;
+    }
+    this->dirty_.push_back(&n);
+}
+
+/**
+ * @brief Note that @p n is being destroyed.
+ *
+ * This function may be called from any thread.  Entries for @p n are removed
+ * by the next @c #update; they are not used before then.
+ *
+ * @param[in] n a node.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::bounding_volume_hierarchy::forget(const node & n)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::mutex::scoped_lock lock(this->pending_mutex_);
+    if (!this->active_ || this->overflow_) { return; }
+    if (this->forgotten_.size() == max_pending) {
+        this->overflow_ = true;
+        this->forgotten_.clear();
+        return;
+    }
+    this->forgotten_.push_back(&n);
+}
+
+/**
+ * @brief Apply the changes noted since the last update.
+ *
+ * Entries for destroyed nodes are removed.  The entries for nodes whose
+ * bounding volumes have changed, and those of their ancestors, are
+ * invalidated; and the ancestors' bounding volumes are marked dirty.
+ *
+ * A change to a node that has no entry may be beneath an entry that was
+ * culled; so every entry culled in the last frame is invalidated.
+ *
+ * This function must be called from the rendering thread.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::bounding_volume_hierarchy::update()
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    std::vector<const node *> dirty, forgotten;
+    bool overflow;
+    {
+        boost::mutex::scoped_lock lock(this->pending_mutex_);
+        dirty.swap(this->dirty_);
+        forgotten.swap(this->forgotten_);
+        overflow = this->overflow_;
+        this->overflow_ = false;
+    }
+
+    if (overflow) {
+        this->clear();
+        return;
+    }
+
+    for (std::vector<const node *>::const_iterator n = forgotten.begin();
+         n != forgotten.end();
+         ++n) {
+        std::pair<index_t::iterator, index_t::iterator> range =
+            this->index_.equal_range(*n);
+        while (range.first != range.second) {
+            bvh_entry * const e = range.first->second;
+            std::vector<bvh_entry *> & siblings = e->parent->children;
+            for (std::vector<bvh_entry *>::iterator sibling =
+                     siblings.begin();
+                 sibling != siblings.end();
+                 ++sibling) {
+                if (*sibling == e) {
+                    siblings.erase(sibling);
+                    break;
+                }
+            }
+            e->parent->next_child = 0;
+            this->destroy(e);
+            range = this->index_.equal_range(*n);
+        }
+    }
+
+    ++this->revision_;
+    bool unplaced = false;
+    for (std::vector<const node *>::const_iterator n = dirty.begin();
+         n != dirty.end();
+         ++n) {
+        const std::pair<index_t::iterator, index_t::iterator> range =
+            this->index_.equal_range(*n);
+        if (range.first == range.second) { unplaced = true; }
+        for (index_t::iterator entry = range.first;
+             entry != range.second;
+             ++entry) {
+            this->mark(*entry->second);
+        }
+    }
+
+    if (unplaced) {
+        for (index_t::iterator entry = this->index_.begin();
+             entry != this->index_.end();
+             ++entry) {
+            if (entry->second->culled == this->frame_) {
+                this->mark(*entry->second);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Remove every entry.
+ */
+void openvrml::local::bounding_volume_hierarchy::clear() OPENVRML_NOTHROW
+{
+    for (std::vector<bvh_entry *>::const_iterator child =
+             this->root_.children.begin();
+         child != this->root_.children.end();
+         ++child) {
+        this->destroy(*child);
+    }
+    this->root_.children.clear();
+    this->root_.next_child = 0;
+    assert(this->index_.empty());
+}
+
+/**
+ * @brief Begin a frame.
+ *
+ * @param[in] f     the view frustum, in eye space.
+ * @param[in] view  the transformation from world to eye space.
+ *
+ * @return the root entry.
+ */
+openvrml::local::bvh_entry &
+openvrml::local::bounding_volume_hierarchy::begin_frame(const frustum & f,
+                                                        const mat4f & view)
+    OPENVRML_NOTHROW
+{
+    {
+        boost::mutex::scoped_lock lock(this->pending_mutex_);
+        this->active_ = true;
+    }
+    ++this->frame_;
+    this->root_.visited = this->frame_;
+
+    this->planes_valid_ = f.fovy > 0.0f && f.z_near > 0.0
+        && f.z_far > f.z_near;
+    if (!this->planes_valid_) { return this->root_; }
+
+    float eye[planes][4];
+    f.planes(eye);
+
+    //
+    // For a point p in world space, the eye-space point is p * view; so the
+    // world-space plane is view applied to the eye-space normal.
+    //
+    for (std::size_t i = 0; i < planes; ++i) {
+        for (std::size_t j = 0; j < 4; ++j) {
+            this->plane_[i][j] = view[j][0] * eye[i][0]
+                + view[j][1] * eye[i][1]
+                + view[j][2] * eye[i][2];
+        }
+        this->plane_[i][3] += eye[i][3];
+    }
+    return this->root_;
+}
+
+/**
+ * @brief Enter the entry for @p n.
+ *
+ * The entry is created if @p n has not been rendered beneath @p parent
+ * before.
+ *
+ * @param[in,out] parent        the entry of the node rendering @p n.
+ * @param[in]     n             the node being rendered.
+ * @param[in]     frame_changed whether the modelview matrix has changed
+ *                              since @p parent was entered.
+ *
+ * @return the entry for @p n.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::local::bvh_entry &
+openvrml::local::bounding_volume_hierarchy::enter(bvh_entry & parent,
+                                                  node & n,
+                                                  const bool frame_changed)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    //
+    // Children are normally rendered in the same order every frame; so the
+    // search starts just past the last child found.
+    //
+    bvh_entry * e = 0;
+    const std::size_t count = parent.children.size();
+    std::size_t i = parent.next_child;
+    for (std::size_t k = 0; k < count; ++k, ++i) {
+        if (i >= count) { i = 0; }
+        bvh_entry * const child = parent.children[i];
+        if (child->n == &n && child->visited != this->frame_) {
+            e = child;
+            parent.next_child = i + 1;
+            break;
+        }
+    }
+
+    if (!e) {
+        std::auto_ptr<bvh_entry> created(new bvh_entry(&parent, &n));
+        parent.children.push_back(created.get());
+        try {
+            this->index_.insert(index_t::value_type(&n, created.get()));
+        } catch (std::bad_alloc &) {
+            parent.children.pop_back();
+            throw;
+        }
+        e = created.release();
+        parent.next_child = parent.children.size();
+    }
+
+    e->visited = this->frame_;
+    parent.explored = this->frame_;
+    this->update_frame(*e,
+                       parent.frame_known
+                       && (!frame_changed || parent.transform));
+    return *e;
+}
+
+/**
+ * @brief Leave an entry.
+ *
+ * If any of the entry's children were rendered, the entries for the
+ * children that were not rendered are removed.
+ *
+ * @param[in,out] e an entry.
+ */
+void openvrml::local::bounding_volume_hierarchy::leave(bvh_entry & e)
+    OPENVRML_NOTHROW
+{
+    e.next_child = 0;
+    if (e.explored != this->frame_) { return; }
+    std::vector<bvh_entry *>::iterator end = e.children.begin();
+    for (std::vector<bvh_entry *>::iterator child = e.children.begin();
+         child != e.children.end();
+         ++child) {
+        if ((*child)->visited == this->frame_) {
+            *end++ = *child;
+        } else {
+            this->destroy(*child);
+        }
+    }
+    e.children.erase(end, e.children.end());
+}
+
+/**
+ * @brief Intersect the entry's world-space box with the view volume.
+ *
+ * @param[in,out] e     an entry with a known frame.
+ * @param[in]     bv    the bounding volume of the entry's node.
+ * @param[in,out] mask  the view volume planes to test; on return, the
+ *                      planes the box is entirely inside are cleared.
+ *
+ * @return @c bounding_volume::inside, @c bounding_volume::outside, or
+ *         @c bounding_volume::partial.
+ */
+openvrml::bounding_volume::intersection
+openvrml::local::bounding_volume_hierarchy::intersect(
+    bvh_entry & e,
+    const bounding_volume & bv,
+    unsigned int & mask)
+    OPENVRML_NOTHROW
+{
+    assert(e.frame_known);
+    if (!this->planes_valid_) { return bounding_volume::partial; }
+    if (!e.bounds_valid) { this->update_bounds(e, bv); }
+    if (!e.bounds_finite) { return bounding_volume::partial; }
+
+    for (std::size_t k = 0, i = e.plane; k < planes; ++k, ++i) {
+        if (i == planes) { i = 0; }
+        if (!(mask & (1U << i))) { continue; }
+        const float (&p)[4] = this->plane_[i];
+        const float distance = p[0] * e.center.x() + p[1] * e.center.y()
+            + p[2] * e.center.z() + p[3];
+        const float radius = std::fabs(p[0]) * e.extent.x()
+            + std::fabs(p[1]) * e.extent.y()
+            + std::fabs(p[2]) * e.extent.z();
+        if (distance < -radius) {
+            e.plane = i;
+            e.culled = this->frame_;
+            return bounding_volume::outside;
+        }
+        if (distance >= radius) { mask &= ~(1U << i); }
+    }
+    return mask ? bounding_volume::partial : bounding_volume::inside;
+}
+
+/**
+ * @brief Note that the entry's node was found hidden behind occluders.
+ *
+ * The node's children are not rendered; so, as for an entry outside the view
+ * volume, changes beneath it must invalidate it.
+ *
+ * @param[in,out] e an entry.
+ */
+void openvrml::local::bounding_volume_hierarchy::occluded(bvh_entry & e)
+    OPENVRML_NOTHROW
+{
+    e.culled = this->frame_;
+}
+
+/**
+ * @brief Invalidate @p e and its ancestors.
+ *
+ * @param[in,out] e an entry.
+ */
+void openvrml::local::bounding_volume_hierarchy::mark(bvh_entry & e)
+    OPENVRML_NOTHROW
+{
+    e.frame_valid = false;
+    for (bvh_entry * entry = &e;
+         entry->parent && entry->marked != this->revision_;
+         entry = entry->parent) {
+        entry->marked = this->revision_;
+        entry->bounds_valid = false;
+        bounded_volume_node * const bounded =
+            node_cast<bounded_volume_node *>(entry->n);
+        if (bounded) {
+            boost::unique_lock<boost::shared_mutex>
+                lock(bounded->bounding_volume_dirty_mutex_);
+            bounded->bounding_volume_dirty_ = true;
+        }
+    }
+}
+
+/**
+ * @brief Destroy @p e and its descendants.
+ *
+ * @p e is not removed from its parent's children.
+ *
+ * @param[in] e an entry.
+ */
+void openvrml::local::bounding_volume_hierarchy::destroy(bvh_entry * const e)
+    OPENVRML_NOTHROW
+{
+    for (std::vector<bvh_entry *>::const_iterator child =
+             e->children.begin();
+         child != e->children.end();
+         ++child) {
+        this->destroy(*child);
+    }
+    const std::pair<index_t::iterator, index_t::iterator> range =
+        this->index_.equal_range(e->n);
+    for (index_t::iterator entry = range.first;
+         entry != range.second;
+         ++entry) {
+        if (entry->second == e) {
+            this->index_.erase(entry);
+            break;
+        }
+    }
+    delete e;
+}
+
+/**
+ * @brief Recompute the frames of @p e if they are out of date.
+ *
+ * @param[in,out] e     an entry.
+ * @param[in]     known whether the frame of @p e can be known.
+ */
+void
+openvrml::local::bounding_volume_hierarchy::update_frame(bvh_entry & e,
+                                                         const bool known)
+    OPENVRML_NOTHROW
+{
+    if (e.frame_valid && e.frame_known == known
+        && e.parent_revision == e.parent->revision) {
+        return;
+    }
+    e.frame_valid = true;
+    e.frame_known = known;
+    e.parent_revision = e.parent->revision;
+    e.revision = ++this->revision_;
+    e.bounds_valid = false;
+    if (!known) { return; }
+
+    e.frame = e.parent->child_frame;
+    e.child_frame = e.transform
+        ? node_cast<transform_node *>(e.n)->transform() * e.frame
+        : e.frame;
+}
+
+/**
+ * @brief Recompute the world-space box of @p e.
+ *
+ * @param[in,out] e     an entry with a known frame.
+ * @param[in]     bv    the bounding volume of the entry's node.
+ */
+void
+openvrml::local::bounding_volume_hierarchy::
+update_bounds(bvh_entry & e, const bounding_volume & bv)
+    OPENVRML_NOTHROW
+{
+    e.bounds_valid = true;
+    const bounding_sphere * const bs =
+        dynamic_cast<const bounding_sphere *>(&bv);
+    e.bounds_finite = bs && !bs->maximized() && bs->radius() >= 0.0f;
+    if (!e.bounds_finite) { return; }
+
+    //
+    // The sphere is an ellipsoid in world space; its extent along each axis
+    // is the radius scaled by the length of the corresponding column of the
+    // frame's linear part.
+    //
+    const mat4f & m = e.frame;
+    const float r = bs->radius();
+    e.center = bs->center() * m;
+    e.extent = make_vec3f(
+        r * std::sqrt(m[0][0] * m[0][0] + m[1][0] * m[1][0]
+                      + m[2][0] * m[2][0]),
+        r * std::sqrt(m[0][1] * m[0][1] + m[1][1] * m[1][1]
+                      + m[2][1] * m[2][1]),
+        r * std::sqrt(m[0][2] * m[0][2] + m[1][2] * m[1][2]
+                      + m[2][2] * m[2][2]));
+}
@@ -0,0 +1,120 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_BOUNDING_VOLUME_HIERARCHY_H
+#   define OPENVRML_LOCAL_BOUNDING_VOLUME_HIERARCHY_H
+
+#   include <openvrml/bounding_volume.h>
+#   include <boost/thread.hpp>
+#   include <boost/utility.hpp>
+#   include <map>
+#   include <vector>
+
+namespace openvrml {
+
+    class node;
+    class frustum;
+
+    namespace local {
+
+        struct OPENVRML_LOCAL bvh_entry : boost::noncopyable {
+            bvh_entry * const parent;
+            node * const n;
+            const bool transform;
+            std::vector<bvh_entry *> children;
+            std::size_t next_child;
+
+            std::size_t visited;
+            std::size_t explored;
+            std::size_t culled;
+            std::size_t marked;
+
+            bool frame_valid;
+            bool frame_known;
+            std::size_t parent_revision;
+            std::size_t revision;
+            mat4f frame;
+            mat4f child_frame;
+
+            bool bounds_valid;
+            bool bounds_finite;
+            vec3f center;
+            vec3f extent;
+            std::size_t plane;
+
+            bvh_entry(bvh_entry * parent, node * n) OPENVRML_NOTHROW;
+        };
+
+
+        class OPENVRML_LOCAL bounding_volume_hierarchy : boost::noncopyable {
+        public:
+            enum { planes = 6, all_planes = (1 << planes) - 1 };
+
+        private:
+            typedef std::multimap<const node *, bvh_entry *> index_t;
+
+            bvh_entry root_;
+            index_t index_;
+            std::size_t frame_;
+            std::size_t revision_;
+            bool planes_valid_;
+            float plane_[planes][4];
+
+            boost::mutex pending_mutex_;
+            bool active_;
+            bool overflow_;
+            std::vector<const node *> dirty_;
+            std::vector<const node *> forgotten_;
+
+        public:
+            bounding_volume_hierarchy() OPENVRML_NOTHROW;
+            ~bounding_volume_hierarchy() OPENVRML_NOTHROW;
+
+            void dirty(const node & n) OPENVRML_THROW1(std::bad_alloc);
+            void forget(const node & n) OPENVRML_THROW1(std::bad_alloc);
+            void update() OPENVRML_THROW1(std::bad_alloc);
+            void clear() OPENVRML_NOTHROW;
+
+            bvh_entry & begin_frame(const openvrml::frustum & f,
+                                    const mat4f & view)
+                OPENVRML_NOTHROW;
+            bvh_entry & enter(bvh_entry & parent,
+                              node & n,
+                              bool frame_changed)
+                OPENVRML_THROW1(std::bad_alloc);
+            void leave(bvh_entry & e) OPENVRML_NOTHROW;
+            bounding_volume::intersection
+            intersect(bvh_entry & e,
+                      const bounding_volume & bv,
+                      unsigned int & mask)
+                OPENVRML_NOTHROW;
+            void occluded(bvh_entry & e) OPENVRML_NOTHROW;
+
+        private:
+            void mark(bvh_entry & e) OPENVRML_NOTHROW;
+            void destroy(bvh_entry * e) OPENVRML_NOTHROW;
+            void update_frame(bvh_entry & e, bool known) OPENVRML_NOTHROW;
+            void update_bounds(bvh_entry & e, const bounding_volume & bv)
+                OPENVRML_NOTHROW;
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_BOUNDING_VOLUME_HIERARCHY_H
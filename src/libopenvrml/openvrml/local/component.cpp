@@ -260,8 +260,16 @@ openvrml::local::component::add_scope_entry(
     using openvrml::node_metatype;
     using openvrml::node_type;
 
+    //
+    // A component may list node types for which no implementation has been
+    // loaded.  Skip those rather than failing to create the scope at all.
+    //
     const shared_ptr<node_metatype> class_ = b.node_metatype(urn);
-    assert(class_);
+    if (!class_) {
+        b.err(std::string(urn) + ": no implementation available for \""
+              + node_name + "\"");
+        return;
+    }
     const shared_ptr<node_type> type = class_->create_type(node_name,
                                                            interface_set);
     const std::pair<shared_ptr<node_type>, bool> add_type_result =
@@ -0,0 +1,288 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "event_queue.h"
+# include <openvrml/event.h>
+# include <boost/scope_exit.hpp>
+# include <boost/thread/tss.hpp>
+# include <algorithm>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    OPENVRML_LOCAL void no_cleanup(openvrml::local::event_queue *)
+    {}
+
+    //
+    // The queue installed for the calling thread by event_queue::scope.
+    //
+    boost::thread_specific_ptr<openvrml::local::event_queue>
+        current_event_queue(no_cleanup);
+}
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::event_queue
+ *
+ * @brief Deferred, breadth-first event cascade.
+ *
+ * While an @c event_queue is installed for a thread with
+ * @c event_queue::scope, @c node::emit_event enqueues the emitter instead of
+ * sending the event to its listeners immediately.  @c #drain then delivers
+ * the pending events in timestamp order, one generation at a time: events
+ * emitted in response to a generation are enqueued for the next one.
+ *
+ * Events are coalesced twice, as permitted by the VRML97 specification:
+ *
+ * - an emitter that is already pending for a timestamp is not enqueued
+ *   again; when it is drained, it sends its current (i.e., most recent)
+ *   value; and
+ * - within a generation, a listener (i.e., a node's eventIn) that more than
+ *   one pending emitter is routed to receives only the event from the
+ *   emitter that was enqueued last.
+ *
+ * As a result, a node downstream of a deep fan-in is evaluated once per
+ * generation rather than once per incoming path; and the stack depth no
+ * longer grows with the length of a ROUTE chain.
+ */
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::event_queue::scope
+ *
+ * @brief Install an @c event_queue for the current thread for the lifetime
+ *        of the @c scope.
+ *
+ * Any previously installed queue is restored when the @c scope is
+ * destroyed.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * @param[in] queue the @c event_queue to install; or null if events should
+ *                  be dispatched immediately.
+ */
+openvrml::local::event_queue::scope::scope(event_queue * const queue):
+    previous_(current_event_queue.get())
+{
+    current_event_queue.reset(queue);
+}
+
+/**
+ * @brief Destroy.
+ */
+openvrml::local::event_queue::scope::~scope() OPENVRML_NOTHROW
+{
+    current_event_queue.reset(this->previous_);
+}
+
+/**
+ * @brief The @c event_queue installed for the calling thread.
+ *
+ * @return the @c event_queue installed for the calling thread, or null if
+ *         events should be dispatched immediately.
+ */
+openvrml::local::event_queue * openvrml::local::event_queue::current()
+    OPENVRML_NOTHROW
+{
+    return current_event_queue.get();
+}
+
+/**
+ * @brief Construct.
+ */
+openvrml::local::event_queue::event_queue() OPENVRML_NOTHROW:
+    draining_(false),
+    enqueued_(0),
+    coalesced_(0),
+    delivered_(0)
+{}
+
+/**
+ * @brief Enqueue an event.
+ *
+ * @param[in] emitter   the emitter whose value should be sent.
+ * @param[in] timestamp the event timestamp.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::event_queue::enqueue(event_emitter & emitter,
+                                           const double timestamp)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    batch & b = this->batches_[timestamp];
+    ++this->enqueued_;
+    if (!b.pending.insert(&emitter).second) {
+        ++this->coalesced_;
+        return;
+    }
+    try {
+        b.emitters.push_back(&emitter);
+    } catch (std::bad_alloc &) {
+        b.pending.erase(&emitter);
+        throw;
+    }
+}
+
+/**
+ * @brief Deliver pending events until none remain.
+ *
+ * If called while the queue is already being drained (i.e., from within
+ * a listener), this function returns immediately; the outer call will
+ * deliver any events enqueued in the meantime.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::event_queue::drain() OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->draining_) { return; }
+    this->draining_ = true;
+    bool & draining = this->draining_;
+    BOOST_SCOPE_EXIT((&draining)) {
+        draining = false;
+    } BOOST_SCOPE_EXIT_END
+
+    std::vector<event_emitter *> & generation = this->generation_;
+    BOOST_SCOPE_EXIT((&generation)) {
+        generation.clear();
+    } BOOST_SCOPE_EXIT_END
+
+    while (!this->batches_.empty()) {
+        //
+        // Take the current generation for the earliest timestamp.  Events
+        // emitted while it is delivered go into a new batch.
+        //
+        const batch_map::iterator first = this->batches_.begin();
+        const double timestamp = first->first;
+        generation.swap(first->second.emitters);
+        this->batches_.erase(first);
+
+        event_emitter::delivery_map deliveries;
+        std::size_t targets = 0;
+        for (std::vector<event_emitter *>::const_iterator emitter =
+                 generation.begin();
+             emitter != generation.end();
+             ++emitter) {
+            targets += (*emitter)->collect_deliveries(deliveries);
+        }
+        this->coalesced_ += targets - deliveries.size();
+
+        //
+        // Delivering an event may destroy a node whose emitter is later in
+        // this generation; cancel nulls out its entry.
+        //
+        for (std::size_t i = 0; i < generation.size(); ++i) {
+            if (!generation[i]) { continue; }
+            this->delivered_ +=
+                generation[i]->emit_coalesced_event(timestamp, deliveries);
+        }
+        generation.clear();
+    }
+}
+
+/**
+ * @brief Discard any pending events for an emitter.
+ *
+ * This is called when @p emitter is destroyed.
+ *
+ * @param[in] emitter   an @c event_emitter.
+ */
+void openvrml::local::event_queue::cancel(event_emitter & emitter)
+    OPENVRML_NOTHROW
+{
+    using std::remove;
+    using std::replace;
+    for (batch_map::iterator b = this->batches_.begin();
+         b != this->batches_.end();
+         ++b) {
+        if (b->second.pending.erase(&emitter) > 0) {
+            std::vector<event_emitter *> & emitters = b->second.emitters;
+            emitters.erase(remove(emitters.begin(), emitters.end(), &emitter),
+                           emitters.end());
+        }
+    }
+    replace(this->generation_.begin(), this->generation_.end(),
+            &emitter, static_cast<event_emitter *>(0));
+}
+
+/**
+ * @brief The number of events enqueued since the counters were last reset.
+ *
+ * @return the number of events enqueued since the counters were last reset.
+ */
+std::size_t openvrml::local::event_queue::enqueued() const OPENVRML_NOTHROW
+{
+    return this->enqueued_;
+}
+
+/**
+ * @brief The number of events dropped by coalescing since the counters were
+ *        last reset.
+ *
+ * This includes both events for an emitter that was already pending and
+ * events superseded at a listener by a later emitter in the same
+ * generation.
+ *
+ * @return the number of events dropped by coalescing.
+ */
+std::size_t openvrml::local::event_queue::coalesced() const OPENVRML_NOTHROW
+{
+    return this->coalesced_;
+}
+
+/**
+ * @brief The number of events delivered to listeners since the counters
+ *        were last reset.
+ *
+ * @return the number of events delivered to listeners.
+ */
+std::size_t openvrml::local::event_queue::delivered() const OPENVRML_NOTHROW
+{
+    return this->delivered_;
+}
+
+/**
+ * @brief Reset the counters.
+ */
+void openvrml::local::event_queue::reset_counters() OPENVRML_NOTHROW
+{
+    this->enqueued_ = 0;
+    this->coalesced_ = 0;
+    this->delivered_ = 0;
+}
+
+/**
+ * @brief Add another queue's counters to this one's.
+ *
+ * @param[in] other an @c event_queue.
+ */
+void openvrml::local::event_queue::add_counters(const event_queue & other)
+    OPENVRML_NOTHROW
+{
+    this->enqueued_ += other.enqueued_;
+    this->coalesced_ += other.coalesced_;
+    this->delivered_ += other.delivered_;
+}
@@ -0,0 +1,80 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_EVENT_QUEUE_H
+#   define OPENVRML_LOCAL_EVENT_QUEUE_H
+
+#   include <openvrml-common.h>
+#   include <boost/utility.hpp>
+#   include <map>
+#   include <new>
+#   include <set>
+#   include <vector>
+
+namespace openvrml {
+
+    class event_emitter;
+
+    namespace local {
+
+        class OPENVRML_LOCAL event_queue : boost::noncopyable {
+            struct batch {
+                std::vector<event_emitter *> emitters;
+                std::set<event_emitter *> pending;
+            };
+
+            typedef std::map<double, batch> batch_map;
+
+            batch_map batches_;
+            std::vector<event_emitter *> generation_;
+            bool draining_;
+
+            std::size_t enqueued_;
+            std::size_t coalesced_;
+            std::size_t delivered_;
+
+        public:
+            class OPENVRML_LOCAL scope : boost::noncopyable {
+                event_queue * const previous_;
+
+            public:
+                explicit scope(event_queue * queue);
+                ~scope() OPENVRML_NOTHROW;
+            };
+
+            static event_queue * current() OPENVRML_NOTHROW;
+
+            event_queue() OPENVRML_NOTHROW;
+
+            void enqueue(event_emitter & emitter, double timestamp)
+                OPENVRML_THROW1(std::bad_alloc);
+            void drain() OPENVRML_THROW1(std::bad_alloc);
+            void cancel(event_emitter & emitter) OPENVRML_NOTHROW;
+
+            std::size_t enqueued() const OPENVRML_NOTHROW;
+            std::size_t coalesced() const OPENVRML_NOTHROW;
+            std::size_t delivered() const OPENVRML_NOTHROW;
+            void reset_counters() OPENVRML_NOTHROW;
+            void add_counters(const event_queue & other) OPENVRML_NOTHROW;
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_EVENT_QUEUE_H
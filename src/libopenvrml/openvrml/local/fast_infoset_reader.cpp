@@ -0,0 +1,958 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "fast_infoset_reader.h"
+# include <boost/cstdint.hpp>
+# include <boost/lexical_cast.hpp>
+# include <zlib.h>
+# include <algorithm>
+# include <cassert>
+# include <cstring>
+# include <limits>
+
+namespace {
+
+    OPENVRML_LOCAL boost::uint32_t read_uint32(const unsigned char * p)
+    {
+        return (boost::uint32_t(p[0]) << 24)
+            | (boost::uint32_t(p[1]) << 16)
+            | (boost::uint32_t(p[2]) << 8)
+            | boost::uint32_t(p[3]);
+    }
+
+    OPENVRML_LOCAL boost::uint64_t read_uint64(const unsigned char * p)
+    {
+        return (boost::uint64_t(read_uint32(p)) << 32) | read_uint32(p + 4);
+    }
+
+    OPENVRML_LOCAL float read_float(const unsigned char * p)
+    {
+        const boost::uint32_t bits = read_uint32(p);
+        float result;
+        std::memcpy(&result, &bits, sizeof result);
+        return result;
+    }
+
+    OPENVRML_LOCAL double read_double(const unsigned char * p)
+    {
+        const boost::uint64_t bits = read_uint64(p);
+        double result;
+        std::memcpy(&result, &bits, sizeof result);
+        return result;
+    }
+
+    OPENVRML_LOCAL void append_utf8(std::string & str, const unsigned long c)
+    {
+        if (c < 0x80) {
+            str += char(c);
+        } else if (c < 0x800) {
+            str += char(0xC0 | (c >> 6));
+            str += char(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            str += char(0xE0 | (c >> 12));
+            str += char(0x80 | ((c >> 6) & 0x3F));
+            str += char(0x80 | (c & 0x3F));
+        } else {
+            str += char(0xF0 | (c >> 18));
+            str += char(0x80 | ((c >> 12) & 0x3F));
+            str += char(0x80 | ((c >> 6) & 0x3F));
+            str += char(0x80 | (c & 0x3F));
+        }
+    }
+
+    //
+    // The built-in restricted alphabets.  Characters are encoded in four
+    // bits; the value 0xF pads the last octet.
+    //
+    const char numeric_alphabet[] = "0123456789-+.E ";
+    const char date_and_time_alphabet[] = "0123456789-:TZ ";
+
+    //
+    // Built-in encoding algorithms (X.891, 10.2).
+    //
+    enum encoding_algorithm {
+        short_algorithm   = 3,
+        int_algorithm     = 4,
+        long_algorithm    = 5,
+        boolean_algorithm = 6,
+        float_algorithm   = 7,
+        double_algorithm  = 8,
+        cdata_algorithm   = 10
+    };
+
+    OPENVRML_LOCAL bool inflate_exactly(const unsigned char * data,
+                                        const std::size_t size,
+                                        std::vector<unsigned char> & out)
+    {
+        uLongf out_size = uLongf(out.size());
+        if (out.empty()) { return size == 0; }
+        return uncompress(&out[0], &out_size, data, uLong(size)) == Z_OK
+            && out_size == out.size();
+    }
+}
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::encoded_array
+ *
+ * @brief Values decoded by a Fast Infoset encoding algorithm.
+ *
+ * Only the member that corresponds to @c kind is meaningful.
+ */
+
+/**
+ * @internal
+ *
+ * @brief Construct an empty value.
+ */
+openvrml::local::encoded_array::encoded_array() OPENVRML_NOTHROW:
+    kind(none_id)
+{}
+
+/**
+ * @internal
+ *
+ * @brief Swap with another @c encoded_array.
+ *
+ * @param[in,out] array an @c encoded_array.
+ */
+void openvrml::local::encoded_array::swap(encoded_array & array)
+    OPENVRML_NOTHROW
+{
+    std::swap(this->kind, array.kind);
+    this->bools.swap(array.bools);
+    this->int32s.swap(array.int32s);
+    this->floats.swap(array.floats);
+    this->doubles.swap(array.doubles);
+}
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::fast_infoset_reader
+ *
+ * Names and character data are decoded into the dynamic vocabulary tables
+ * as the document is read.  Documents that rely on an external or initial
+ * vocabulary are rejected.
+ *
+ * Attribute values encoded with the built-in @c short, @c int, @c long,
+ * @c boolean, @c float, and @c double algorithms are decoded directly into
+ * an @c encoded_array; so are the two X3D array algorithms:
+ *
+ * - @c x3d_delta_int_array_algorithm: a 32-bit big-endian element count
+ *   followed by a zlib stream of zig-zag base-128 varints, each the
+ *   difference from the previous element.
+ * - @c x3d_quantized_float_array_algorithm: an octet giving the number of
+ *   bits per value, an octet giving the number of components per tuple
+ *   (one to four), a 32-bit big-endian value count, a pair of big-endian
+ *   IEEE floats giving the range of each component, and a zlib stream of
+ *   the values packed most significant bit first.
+ */
+
+/**
+ * @var openvrml::local::fast_infoset_reader::x3d_delta_int_array_algorithm
+ *
+ * @brief Encoding algorithm index for delta-coded integer arrays.
+ */
+
+/**
+ * @var openvrml::local::fast_infoset_reader::x3d_quantized_float_array_algorithm
+ *
+ * @brief Encoding algorithm index for quantized float arrays.
+ */
+
+/**
+ * @internal
+ *
+ * @brief Construct.
+ *
+ * The document header is read immediately.
+ *
+ * @param[in] data  the document.
+ * @param[in] size  the size of @p data in octets.
+ *
+ * @exception std::runtime_error    if @p data does not begin with a Fast
+ *                                  Infoset document header that this
+ *                                  reader supports.
+ */
+openvrml::local::fast_infoset_reader::
+fast_infoset_reader(const char * const data, const std::size_t size)
+    OPENVRML_THROW1(std::runtime_error):
+    begin_(reinterpret_cast<const unsigned char *>(data)),
+    end_(reinterpret_cast<const unsigned char *>(data) + size),
+    p_(begin_),
+    bit_(0),
+    node_type_(none_id),
+    empty_element_(false),
+    depth_(0),
+    pending_terminations_(0),
+    element_count_(0),
+    done_(false)
+{
+    this->read_header();
+}
+
+/**
+ * @internal
+ *
+ * @brief Read the next item in the document.
+ *
+ * Comments and processing instructions are skipped.  As with
+ * @c xml_reader, no end element is reported for an empty element.
+ *
+ * @return 1 if an item was read; 0 at the end of the document.
+ *
+ * @exception std::runtime_error    if the document is malformed or uses a
+ *                                  feature this reader does not support.
+ * @exception std::bad_alloc        if memory allocation fails.
+ */
+int openvrml::local::fast_infoset_reader::read()
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    this->local_name_.clear();
+    this->value_.clear();
+    this->empty_element_ = false;
+
+    for (;;) {
+        if (this->pending_terminations_ > 0) {
+            --this->pending_terminations_;
+            if (this->depth_ == 0) {
+                this->done_ = true;
+                this->pending_terminations_ = 0;
+            } else {
+                --this->depth_;
+                this->node_type_ = end_element_id;
+                return 1;
+            }
+        }
+        if (this->done_) {
+            this->node_type_ = none_id;
+            return 0;
+        }
+
+        const unsigned octet = this->peek_octet();
+        if (!(octet & 0x80)) {
+            this->read_element();
+            this->node_type_ = element_id;
+            return 1;
+        } else if ((octet & 0xC0) == 0x80) {
+            this->read_character_chunk();
+            this->node_type_ = text_id;
+            return 1;
+        } else if (octet == 0xF0) {
+            ++this->p_;
+            this->pending_terminations_ += 1;
+        } else if (octet == 0xFF) {
+            ++this->p_;
+            this->pending_terminations_ += 2;
+        } else if (octet == 0xE1) {
+            this->skip_processing_instruction();
+        } else if (octet == 0xE2) {
+            this->skip_comment();
+        } else {
+            this->fail("unexpected octet in element content");
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief The type of the current item.
+ *
+ * @return the type of the current item.
+ */
+openvrml::local::fast_infoset_reader::node_type_id
+openvrml::local::fast_infoset_reader::node_type() const OPENVRML_NOTHROW
+{
+    return node_type_id(this->node_type_);
+}
+
+/**
+ * @internal
+ *
+ * @brief The local name of the current element.
+ *
+ * @return the local name of the current element.
+ */
+const std::string &
+openvrml::local::fast_infoset_reader::local_name() const OPENVRML_NOTHROW
+{
+    return this->local_name_;
+}
+
+/**
+ * @internal
+ *
+ * @brief The character data of the current text item.
+ *
+ * @return the character data of the current text item.
+ */
+const std::string &
+openvrml::local::fast_infoset_reader::value() const OPENVRML_NOTHROW
+{
+    return this->value_;
+}
+
+/**
+ * @internal
+ *
+ * @brief Take the attributes of the current element.
+ *
+ * @param[out] attributes   the attributes.
+ */
+void
+openvrml::local::fast_infoset_reader::
+take_attributes(std::vector<xml_attribute> & attributes) OPENVRML_NOTHROW
+{
+    attributes.swap(this->attributes_);
+    this->attributes_.clear();
+}
+
+/**
+ * @internal
+ *
+ * @brief Whether the current element is empty.
+ *
+ * @return @c true if the current element is empty; @c false otherwise.
+ */
+bool openvrml::local::fast_infoset_reader::is_empty_element() const
+    OPENVRML_NOTHROW
+{
+    return this->empty_element_;
+}
+
+/**
+ * @internal
+ *
+ * @brief The ordinal of the current element.
+ *
+ * A binary document has no lines; diagnostics use the position of the
+ * element in document order instead.
+ *
+ * @return the ordinal of the current element.
+ */
+std::size_t openvrml::local::fast_infoset_reader::line_number() const
+    OPENVRML_NOTHROW
+{
+    return this->element_count_;
+}
+
+void openvrml::local::fast_infoset_reader::fail(const std::string & message)
+    const
+    OPENVRML_THROW1(std::runtime_error)
+{
+    throw std::runtime_error(
+        "Fast Infoset: " + message + " at octet "
+        + boost::lexical_cast<std::string>(this->p_ - this->begin_));
+}
+
+unsigned openvrml::local::fast_infoset_reader::bits(unsigned n)
+    OPENVRML_THROW1(std::runtime_error)
+{
+    unsigned result = 0;
+    while (n > 0) {
+        if (this->p_ == this->end_) { this->fail("unexpected end of data"); }
+        const unsigned available = 8 - this->bit_;
+        const unsigned take = (n < available) ? n : available;
+        const unsigned shift = available - take;
+        result = (result << take)
+            | ((unsigned(*this->p_) >> shift) & ((1U << take) - 1));
+        this->bit_ += take;
+        n -= take;
+        if (this->bit_ == 8) {
+            ++this->p_;
+            this->bit_ = 0;
+        }
+    }
+    return result;
+}
+
+unsigned openvrml::local::fast_infoset_reader::peek_octet() const
+    OPENVRML_THROW1(std::runtime_error)
+{
+    this->expect_aligned();
+    if (this->p_ == this->end_) { this->fail("unexpected end of data"); }
+    return *this->p_;
+}
+
+void openvrml::local::fast_infoset_reader::expect_aligned() const
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (this->bit_ != 0) { this->fail("misaligned item"); }
+}
+
+const unsigned char *
+openvrml::local::fast_infoset_reader::octets(const std::size_t n)
+    OPENVRML_THROW1(std::runtime_error)
+{
+    this->expect_aligned();
+    if (std::size_t(this->end_ - this->p_) < n) {
+        this->fail("unexpected end of data");
+    }
+    const unsigned char * const result = this->p_;
+    this->p_ += n;
+    return result;
+}
+
+//
+// Length of a non-empty octet string starting on the second bit (C.22).
+//
+std::size_t openvrml::local::fast_infoset_reader::length_2nd_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(6) + 1; }
+    switch (this->bits(6)) {
+    case 0:
+        return this->bits(8) + 65;
+    case 1:
+        return std::size_t(this->bits(32)) + 321;
+    default:
+        this->fail("invalid length");
+    }
+    return 0;
+}
+
+//
+// Length of a non-empty octet string starting on the fifth bit (C.23).
+//
+std::size_t openvrml::local::fast_infoset_reader::length_5th_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(3) + 1; }
+    switch (this->bits(3)) {
+    case 0:
+        return this->bits(8) + 9;
+    case 4:
+        return std::size_t(this->bits(32)) + 265;
+    default:
+        this->fail("invalid length");
+    }
+    return 0;
+}
+
+//
+// Length of a non-empty octet string starting on the seventh bit (C.24).
+//
+std::size_t openvrml::local::fast_infoset_reader::length_7th_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(1) + 1; }
+    if (!this->bits(1)) { return this->bits(8) + 3; }
+    return std::size_t(this->bits(32)) + 259;
+}
+
+//
+// Integer in the range 1 to 2^20 starting on the second bit (C.25).
+//
+std::size_t openvrml::local::fast_infoset_reader::index_2nd_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(6) + 1; }
+    if (!this->bits(1)) { return this->bits(13) + 65; }
+    if (this->bits(1)) { this->fail("invalid index"); }
+    return this->bits(20) + 8257;
+}
+
+//
+// Integer in the range 1 to 2^20 starting on the third bit (C.27).
+//
+std::size_t openvrml::local::fast_infoset_reader::index_3rd_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(5) + 1; }
+    switch (this->bits(2)) {
+    case 0:
+        return this->bits(11) + 33;
+    case 1:
+        return this->bits(19) + 2081;
+    default:
+        this->fail("unsupported index");
+    }
+    return 0;
+}
+
+//
+// Integer in the range 0 to 2^20 starting on the second bit (C.26).
+//
+std::size_t openvrml::local::fast_infoset_reader::index_or_zero_2nd_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(6); }
+    if (!this->bits(1)) { return this->bits(13) + 64; }
+    if (this->bits(1)) { this->fail("invalid index"); }
+    return this->bits(20) + 8256;
+}
+
+//
+// Integer in the range 0 to 2^20 starting on the fourth bit (C.28).
+//
+std::size_t openvrml::local::fast_infoset_reader::index_or_zero_4th_bit()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (!this->bits(1)) { return this->bits(4); }
+    if (!this->bits(1)) { return this->bits(11) + 16; }
+    this->fail("unsupported index");
+    return 0;
+}
+
+const std::string &
+openvrml::local::fast_infoset_reader::
+table_entry(const std::vector<std::string> & table,
+            const std::size_t index) const
+    OPENVRML_THROW1(std::runtime_error)
+{
+    if (index == 0 || index > table.size()) {
+        this->fail("vocabulary table index out of range");
+    }
+    return table[index - 1];
+}
+
+//
+// Identifying string or index starting on the first bit (C.13).
+//
+const std::string
+openvrml::local::fast_infoset_reader::
+identifying_string(std::vector<std::string> & table)
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    this->expect_aligned();
+    if (this->bits(1)) {
+        return this->table_entry(table, this->index_2nd_bit());
+    }
+    const std::size_t length = this->length_2nd_bit();
+    const char * const data =
+        reinterpret_cast<const char *>(this->octets(length));
+    table.push_back(std::string(data, data + length));
+    return table.back();
+}
+
+//
+// Qualified name or index of an element (starting on the third bit, C.18)
+// or of an attribute (starting on the second bit, C.17).  Only the local
+// name is retained.
+//
+const std::string
+openvrml::local::fast_infoset_reader::
+qualified_name(std::vector<std::string> & names)
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    const bool element = (this->bit_ == 2);
+    if (this->p_ == this->end_) { this->fail("unexpected end of data"); }
+    const bool literal = element
+        ? ((*this->p_ >> 2) & 0x0F) == 0x0F
+        : ((*this->p_ >> 2) & 0x1F) == 0x1E;
+    if (!literal) {
+        return this->table_entry(names, element
+                                        ? this->index_3rd_bit()
+                                        : this->index_2nd_bit());
+    }
+    this->bits(element ? 4 : 5);
+    const bool prefix = this->bits(1);
+    const bool namespace_name = this->bits(1);
+    if (prefix) { this->identifying_string(this->prefixes_); }
+    if (namespace_name) { this->identifying_string(this->namespace_names_); }
+    const std::string local_name =
+        this->identifying_string(this->local_names_);
+    names.push_back(local_name);
+    return local_name;
+}
+
+//
+// Encoded character string (C.19, C.20), starting after the discriminant.
+//
+void
+openvrml::local::fast_infoset_reader::
+encoded_string(const unsigned discriminant,
+               std::size_t (fast_infoset_reader::*length)(),
+               std::string & text,
+               encoded_array & array)
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    text.clear();
+    switch (discriminant) {
+    case 0:
+    {
+        const std::size_t n = (this->*length)();
+        const char * const data =
+            reinterpret_cast<const char *>(this->octets(n));
+        text.assign(data, data + n);
+    }
+        break;
+    case 1:
+    {
+        const std::size_t n = (this->*length)();
+        if (n % 2 != 0) { this->fail("invalid UTF-16 string"); }
+        const unsigned char * const data = this->octets(n);
+        for (std::size_t i = 0; i < n; i += 2) {
+            unsigned long c = (unsigned long)(data[i]) << 8 | data[i + 1];
+            if (c >= 0xD800 && c < 0xDC00 && i + 3 < n) {
+                const unsigned long low =
+                    (unsigned long)(data[i + 2]) << 8 | data[i + 3];
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+            append_utf8(text, c);
+        }
+    }
+        break;
+    case 2:
+    {
+        const unsigned alphabet = this->bits(8) + 1;
+        const std::size_t n = (this->*length)();
+        const unsigned char * const data = this->octets(n);
+        const char * chars = 0;
+        if (alphabet == 1) {
+            chars = numeric_alphabet;
+        } else if (alphabet == 2) {
+            chars = date_and_time_alphabet;
+        } else {
+            this->fail("unsupported restricted alphabet");
+        }
+        for (std::size_t i = 0; i < 2 * n; ++i) {
+            const unsigned c = (i % 2 == 0)
+                ? data[i / 2] >> 4
+                : data[i / 2] & 0x0F;
+            if (c == 0x0F) { break; }
+            text += chars[c];
+        }
+    }
+        break;
+    case 3:
+    {
+        const unsigned algorithm = this->bits(8) + 1;
+        const std::size_t n = (this->*length)();
+        const unsigned char * const data = this->octets(n);
+        switch (algorithm) {
+        case short_algorithm:
+            if (n % 2 != 0) { this->fail("invalid short array"); }
+            array.kind = encoded_array::int32_id;
+            array.int32s.resize(n / 2);
+            for (std::size_t i = 0; i < n / 2; ++i) {
+                array.int32s[i] = boost::int16_t(
+                    (unsigned(data[2 * i]) << 8) | data[2 * i + 1]);
+            }
+            break;
+        case int_algorithm:
+            if (n % 4 != 0) { this->fail("invalid int array"); }
+            array.kind = encoded_array::int32_id;
+            array.int32s.resize(n / 4);
+            for (std::size_t i = 0; i < n / 4; ++i) {
+                array.int32s[i] = boost::int32_t(read_uint32(data + 4 * i));
+            }
+            break;
+        case long_algorithm:
+            if (n % 8 != 0) { this->fail("invalid long array"); }
+            array.kind = encoded_array::int32_id;
+            array.int32s.resize(n / 8);
+            for (std::size_t i = 0; i < n / 8; ++i) {
+                const boost::int64_t value =
+                    boost::int64_t(read_uint64(data + 8 * i));
+                if (value < std::numeric_limits<int32>::min()
+                    || value > std::numeric_limits<int32>::max()) {
+                    this->fail("long value out of range");
+                }
+                array.int32s[i] = int32(value);
+            }
+            break;
+        case boolean_algorithm:
+        {
+            const unsigned unused = data[0] >> 4;
+            const std::size_t count = n * 8 - 4 - unused;
+            if (unused > 7 || count > n * 8) {
+                this->fail("invalid boolean array");
+            }
+            array.kind = encoded_array::bool_id;
+            array.bools.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                const std::size_t bit = i + 4;
+                array.bools[i] = (data[bit / 8] >> (7 - bit % 8)) & 1;
+            }
+        }
+            break;
+        case float_algorithm:
+            if (n % 4 != 0) { this->fail("invalid float array"); }
+            array.kind = encoded_array::float_id;
+            array.floats.resize(n / 4);
+            for (std::size_t i = 0; i < n / 4; ++i) {
+                array.floats[i] = read_float(data + 4 * i);
+            }
+            break;
+        case double_algorithm:
+            if (n % 8 != 0) { this->fail("invalid double array"); }
+            array.kind = encoded_array::double_id;
+            array.doubles.resize(n / 8);
+            for (std::size_t i = 0; i < n / 8; ++i) {
+                array.doubles[i] = read_double(data + 8 * i);
+            }
+            break;
+        case cdata_algorithm:
+            text.assign(reinterpret_cast<const char *>(data),
+                        reinterpret_cast<const char *>(data) + n);
+            break;
+        case x3d_delta_int_array_algorithm:
+        {
+            if (n < 4) { this->fail("invalid delta-coded array"); }
+            const std::size_t count = read_uint32(data);
+            if (count > std::numeric_limits<std::size_t>::max() / 5) {
+                this->fail("invalid delta-coded array");
+            }
+            std::vector<unsigned char> buffer(count * 5);
+            uLongf size = uLongf(buffer.size());
+            if (count > 0
+                && uncompress(&buffer[0], &size, data + 4, uLong(n - 4))
+                   != Z_OK) {
+                this->fail("invalid delta-coded array");
+            }
+            array.kind = encoded_array::int32_id;
+            array.int32s.resize(count);
+            std::size_t pos = 0;
+            boost::uint32_t previous = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                boost::uint32_t zigzag = 0;
+                unsigned shift = 0;
+                unsigned char octet;
+                do {
+                    if (pos == size || shift > 28) {
+                        this->fail("invalid delta-coded array");
+                    }
+                    octet = buffer[pos++];
+                    zigzag |= boost::uint32_t(octet & 0x7F) << shift;
+                    shift += 7;
+                } while (octet & 0x80);
+                previous += (zigzag >> 1) ^ (0U - (zigzag & 1));
+                array.int32s[i] = boost::int32_t(previous);
+            }
+            if (pos != size) { this->fail("invalid delta-coded array"); }
+        }
+            break;
+        case x3d_quantized_float_array_algorithm:
+        {
+            if (n < 6) { this->fail("invalid quantized array"); }
+            const unsigned bits = data[0];
+            const unsigned components = data[1];
+            const std::size_t count = read_uint32(data + 2);
+            if (bits < 1 || bits > 32 || components < 1 || components > 4
+                || n < 6 + 8 * components) {
+                this->fail("invalid quantized array");
+            }
+            double min[4], scale[4];
+            const double steps = double((boost::uint64_t(1) << bits) - 1);
+            for (unsigned c = 0; c < components; ++c) {
+                min[c] = read_float(data + 6 + 8 * c);
+                scale[c] = (read_float(data + 10 + 8 * c) - min[c]) / steps;
+            }
+            const boost::uint64_t packed_bits =
+                boost::uint64_t(count) * bits;
+            std::vector<unsigned char> packed(
+                std::size_t((packed_bits + 7) / 8));
+            const std::size_t header = 6 + 8 * components;
+            if (!inflate_exactly(data + header, n - header, packed)) {
+                this->fail("invalid quantized array");
+            }
+            array.kind = encoded_array::float_id;
+            array.floats.resize(count);
+            boost::uint64_t bit = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                boost::uint32_t q = 0;
+                for (unsigned b = 0; b < bits; ++b, ++bit) {
+                    q = (q << 1)
+                        | ((packed[std::size_t(bit / 8)] >> (7 - bit % 8))
+                           & 1);
+                }
+                const unsigned c = unsigned(i % components);
+                array.floats[i] = float(min[c] + q * scale[c]);
+            }
+        }
+            break;
+        default:
+            this->fail("unsupported encoding algorithm "
+                       + boost::lexical_cast<std::string>(algorithm));
+        }
+    }
+        break;
+    default:
+        assert(false);
+    }
+}
+
+//
+// Non-identifying string or index starting on the first bit (C.14).
+//
+void
+openvrml::local::fast_infoset_reader::
+non_identifying_string(std::vector<std::string> & table,
+                       std::string & text,
+                       encoded_array & array)
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    this->expect_aligned();
+    if (this->bits(1)) {
+        const std::size_t index = this->index_or_zero_2nd_bit();
+        text = (index == 0) ? std::string() : this->table_entry(table, index);
+        return;
+    }
+    const bool add_to_table = this->bits(1);
+    const unsigned discriminant = this->bits(2);
+    this->encoded_string(discriminant,
+                         &fast_infoset_reader::length_5th_bit,
+                         text,
+                         array);
+    if (add_to_table) {
+        if (array.kind != encoded_array::none_id) {
+            this->fail("encoded value cannot be added to a table");
+        }
+        table.push_back(text);
+    }
+}
+
+void openvrml::local::fast_infoset_reader::read_header()
+    OPENVRML_THROW1(std::runtime_error)
+{
+    static const char xml_declaration[] = "<?xml";
+    const std::size_t declaration_size = sizeof xml_declaration - 1;
+    if (std::size_t(this->end_ - this->p_) > declaration_size
+        && std::equal(xml_declaration, xml_declaration + declaration_size,
+                      this->p_)) {
+        while (this->p_ + 1 < this->end_
+               && !(this->p_[0] == '?' && this->p_[1] == '>')) {
+            ++this->p_;
+        }
+        this->octets(2);
+    }
+
+    const unsigned char * const magic = this->octets(4);
+    if (magic[0] != 0xE0 || magic[1] != 0x00
+        || magic[2] != 0x00 || magic[3] != 0x01) {
+        this->fail("not a Fast Infoset document");
+    }
+
+    const unsigned optional = this->bits(8);
+    if (optional & 0x80) { this->fail("invalid document header"); }
+    if (optional & 0x78) {
+        this->fail("additional data, vocabularies, notations, and unparsed "
+                   "entities are not supported");
+    }
+    if (optional & 0x04) {
+        this->bits(1);
+        this->octets(this->length_2nd_bit());
+    }
+    if (optional & 0x02) { this->octets(1); }
+    if (optional & 0x01) {
+        std::string version;
+        encoded_array array;
+        this->non_identifying_string(this->other_strings_, version, array);
+    }
+}
+
+void openvrml::local::fast_infoset_reader::read_element()
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    ++this->element_count_;
+    this->attributes_.clear();
+
+    if ((*this->p_ & 0x3F) == 0x38) {
+        this->fail("namespace attributes are not supported");
+    }
+    this->bits(1);
+    const bool has_attributes = this->bits(1);
+    this->local_name_ = this->qualified_name(this->element_names_);
+
+    if (has_attributes) {
+        for (;;) {
+            const unsigned octet = this->peek_octet();
+            if (octet == 0xF0) {
+                ++this->p_;
+                break;
+            } else if (octet == 0xFF) {
+                ++this->p_;
+                this->empty_element_ = true;
+                return;
+            } else if (octet & 0x80) {
+                this->fail("expected an attribute");
+            }
+            this->bits(1);
+            this->attributes_.push_back(xml_attribute());
+            xml_attribute & attr = this->attributes_.back();
+            attr.name = this->qualified_name(this->attribute_names_);
+            this->non_identifying_string(this->attribute_values_,
+                                         attr.value,
+                                         attr.array);
+        }
+    }
+
+    if (this->at_termination()) {
+        this->empty_element_ = true;
+        if (*this->p_++ == 0xFF) { ++this->pending_terminations_; }
+        return;
+    }
+    ++this->depth_;
+}
+
+void openvrml::local::fast_infoset_reader::read_character_chunk()
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    this->bits(2);
+    if (this->bits(1)) {
+        const std::size_t index = this->index_or_zero_4th_bit();
+        this->value_ = (index == 0)
+            ? std::string()
+            : this->table_entry(this->character_chunks_, index);
+        return;
+    }
+    const bool add_to_table = this->bits(1);
+    const unsigned discriminant = this->bits(2);
+    encoded_array array;
+    this->encoded_string(discriminant,
+                         &fast_infoset_reader::length_7th_bit,
+                         this->value_,
+                         array);
+    if (array.kind != encoded_array::none_id) {
+        this->fail("encoded character data is not supported");
+    }
+    if (add_to_table) { this->character_chunks_.push_back(this->value_); }
+}
+
+void openvrml::local::fast_infoset_reader::skip_comment()
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    this->octets(1);
+    std::string text;
+    encoded_array array;
+    this->non_identifying_string(this->other_strings_, text, array);
+}
+
+void openvrml::local::fast_infoset_reader::skip_processing_instruction()
+    OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+{
+    this->octets(1);
+    this->identifying_string(this->other_ncnames_);
+    std::string text;
+    encoded_array array;
+    this->non_identifying_string(this->other_strings_, text, array);
+}
+
+bool openvrml::local::fast_infoset_reader::at_termination() const
+    OPENVRML_THROW1(std::runtime_error)
+{
+    const unsigned octet = this->peek_octet();
+    return octet == 0xF0 || octet == 0xFF;
+}
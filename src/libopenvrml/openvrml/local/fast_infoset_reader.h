@@ -0,0 +1,190 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_FAST_INFOSET_READER_H
+#   define OPENVRML_LOCAL_FAST_INFOSET_READER_H
+
+#   include <openvrml/basetypes.h>
+#   include <boost/noncopyable.hpp>
+#   include <cstddef>
+#   include <stdexcept>
+#   include <string>
+#   include <vector>
+
+namespace openvrml {
+
+    namespace local {
+
+        /**
+         * @brief An attribute value decoded by a Fast Infoset encoding
+         *        algorithm.
+         */
+        struct OPENVRML_LOCAL encoded_array {
+            enum kind_id {
+                none_id,
+                bool_id,
+                int32_id,
+                float_id,
+                double_id
+            };
+
+            kind_id kind;
+            std::vector<bool> bools;
+            std::vector<int32> int32s;
+            std::vector<float> floats;
+            std::vector<double> doubles;
+
+            encoded_array() OPENVRML_NOTHROW;
+
+            void swap(encoded_array & array) OPENVRML_NOTHROW;
+        };
+
+
+        /**
+         * @brief An attribute as read from an XML or Fast Infoset document.
+         *
+         * @c value holds the character data; if the attribute was encoded
+         * with an encoding algorithm, @c array holds the decoded values
+         * instead.
+         */
+        struct OPENVRML_LOCAL xml_attribute {
+            std::string name;
+            std::string value;
+            encoded_array array;
+        };
+
+
+        /**
+         * @brief A pull reader for Fast Infoset (ITU-T X.891) documents.
+         *
+         * The interface parallels that of @c xml_reader.
+         */
+        class OPENVRML_LOCAL fast_infoset_reader : boost::noncopyable {
+            const unsigned char * const begin_;
+            const unsigned char * const end_;
+            const unsigned char * p_;
+            unsigned bit_;
+
+            std::vector<std::string> prefixes_;
+            std::vector<std::string> namespace_names_;
+            std::vector<std::string> local_names_;
+            std::vector<std::string> element_names_;
+            std::vector<std::string> attribute_names_;
+            std::vector<std::string> attribute_values_;
+            std::vector<std::string> character_chunks_;
+            std::vector<std::string> other_ncnames_;
+            std::vector<std::string> other_strings_;
+
+            int node_type_;
+            std::string local_name_;
+            std::string value_;
+            std::vector<xml_attribute> attributes_;
+            bool empty_element_;
+            std::size_t depth_;
+            std::size_t pending_terminations_;
+            std::size_t element_count_;
+            bool done_;
+
+        public:
+            enum node_type_id {
+                none_id        = 0,
+                element_id     = 1,
+                text_id        = 3,
+                cdata_id       = 4,
+                end_element_id = 15
+            };
+
+            static const unsigned char x3d_delta_int_array_algorithm = 32;
+            static const unsigned char x3d_quantized_float_array_algorithm =
+                33;
+
+            fast_infoset_reader(const char * data, std::size_t size)
+                OPENVRML_THROW1(std::runtime_error);
+
+            int read() OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            node_type_id node_type() const OPENVRML_NOTHROW;
+            const std::string & local_name() const OPENVRML_NOTHROW;
+            const std::string & value() const OPENVRML_NOTHROW;
+            void take_attributes(std::vector<xml_attribute> & attributes)
+                OPENVRML_NOTHROW;
+            bool is_empty_element() const OPENVRML_NOTHROW;
+            std::size_t line_number() const OPENVRML_NOTHROW;
+
+        private:
+            void fail(const std::string & message) const
+                OPENVRML_THROW1(std::runtime_error);
+            unsigned bits(unsigned n) OPENVRML_THROW1(std::runtime_error);
+            unsigned peek_octet() const OPENVRML_THROW1(std::runtime_error);
+            void expect_aligned() const OPENVRML_THROW1(std::runtime_error);
+            const unsigned char * octets(std::size_t n)
+                OPENVRML_THROW1(std::runtime_error);
+
+            std::size_t length_2nd_bit()
+                OPENVRML_THROW1(std::runtime_error);
+            std::size_t length_5th_bit()
+                OPENVRML_THROW1(std::runtime_error);
+            std::size_t length_7th_bit()
+                OPENVRML_THROW1(std::runtime_error);
+            std::size_t index_2nd_bit()
+                OPENVRML_THROW1(std::runtime_error);
+            std::size_t index_3rd_bit()
+                OPENVRML_THROW1(std::runtime_error);
+            std::size_t index_or_zero_2nd_bit()
+                OPENVRML_THROW1(std::runtime_error);
+            std::size_t index_or_zero_4th_bit()
+                OPENVRML_THROW1(std::runtime_error);
+
+            const std::string &
+            table_entry(const std::vector<std::string> & table,
+                        std::size_t index) const
+                OPENVRML_THROW1(std::runtime_error);
+            const std::string
+            identifying_string(std::vector<std::string> & table)
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            const std::string
+            qualified_name(std::vector<std::string> & names)
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            void
+            encoded_string(unsigned discriminant,
+                           std::size_t (fast_infoset_reader::*length)(),
+                           std::string & text,
+                           encoded_array & array)
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            void
+            non_identifying_string(std::vector<std::string> & table,
+                                   std::string & text,
+                                   encoded_array & array)
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+
+            void read_header() OPENVRML_THROW1(std::runtime_error);
+            void read_element()
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            void read_character_chunk()
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            void skip_comment()
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            void skip_processing_instruction()
+                OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+            bool at_termination() const OPENVRML_THROW1(std::runtime_error);
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_FAST_INFOSET_READER_H
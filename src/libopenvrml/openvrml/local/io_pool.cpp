@@ -0,0 +1,542 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "io_pool.h"
+# include "thread_pool.h"
+# include <algorithm>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::io_pool
+ *
+ * @brief A bounded pool of threads that read resources.
+ *
+ * Tasks are run on a @c thread_pool of @c #threads() workers, which is
+ * created when the first task is submitted.  Tasks beyond that many wait in
+ * the pool's queues rather than each getting a thread of its own.
+ *
+ * Streams read by a @c #reader are delivered to their
+ * @c stream_listener in chunks of up to @c #chunk_size bytes.  The chunks
+ * are read directly into buffers that are reused from one chunk, and one
+ * stream, to the next.
+ */
+
+/**
+ * @var openvrml::local::io_pool::default_threads
+ *
+ * @brief The default number of threads.
+ */
+
+/**
+ * @var openvrml::local::io_pool::chunk_size
+ *
+ * @brief The largest chunk delivered to a @c stream_listener.
+ */
+
+/**
+ * @var openvrml::local::io_pool::history
+ *
+ * @brief The number of finished streams whose statistics are kept.
+ */
+
+/**
+ * @internal
+ *
+ * @typedef boost::function0<void> openvrml::local::io_pool::task
+ *
+ * @brief A unit of work.
+ */
+
+/**
+ * @internal
+ *
+ * @typedef std::vector<unsigned char> openvrml::local::io_pool::buffer
+ *
+ * @brief A chunk buffer.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::io_pool::stream_record
+ *
+ * @brief The statistics for a stream, and the time reading it started.
+ */
+
+/**
+ * @internal
+ *
+ * @typedef std::list<openvrml::local::io_pool::stream_record> openvrml::local::io_pool::stream_list
+ *
+ * @brief A list of @c stream_record%s, in the order the streams were
+ *        opened.
+ */
+
+/**
+ * @var boost::mutex openvrml::local::io_pool::mutex_
+ *
+ * @brief Mutex protecting the pool, the buffers and the statistics.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::threads_
+ *
+ * @brief The number of threads.
+ */
+
+/**
+ * @var boost::scoped_ptr<openvrml::local::thread_pool> openvrml::local::io_pool::pool_
+ *
+ * @brief The threads; or null if no task has been submitted since the
+ *        number of threads was set.
+ */
+
+/**
+ * @var std::vector<boost::shared_ptr<openvrml::local::io_pool::buffer> > openvrml::local::io_pool::buffers_
+ *
+ * @brief Chunk buffers that are not in use.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::queued_
+ *
+ * @brief The number of tasks waiting for a thread.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::max_queued_
+ *
+ * @brief The most tasks that have waited for a thread at once.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::active_
+ *
+ * @brief The number of tasks running.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::completed_
+ *
+ * @brief The number of tasks that have finished.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::bytes_
+ *
+ * @brief The number of bytes read by all streams.
+ */
+
+/**
+ * @var openvrml::local::io_pool::stream_list openvrml::local::io_pool::streams_
+ *
+ * @brief The streams being read, and the last @c #history streams that
+ *        have been read.
+ */
+
+/**
+ * @var std::size_t openvrml::local::io_pool::finished_streams_
+ *
+ * @brief The number of finished streams in @c #streams_.
+ */
+
+/**
+ * @internal
+ *
+ * @brief A task that keeps the <code>io_pool</code>'s queue depth.
+ */
+struct OPENVRML_LOCAL openvrml::local::io_pool::counted_task {
+    io_pool * pool;
+    mutable task t;
+    task done;
+
+    void operator()() const OPENVRML_NOTHROW
+    {
+        this->pool->started();
+        try {
+            this->t();
+        } catch (...) {}
+        //
+        // Release the task's resources before anyone is told it is done.
+        //
+        this->t.clear();
+        this->pool->finished();
+        if (this->done) { this->done(); }
+    }
+};
+
+/**
+ * @internal
+ *
+ * @brief Read a stream and deliver it to a @c stream_listener.
+ */
+class OPENVRML_LOCAL openvrml::local::io_pool::stream_reader {
+    io_pool * pool_;
+    boost::shared_ptr<resource_istream> in_;
+    boost::shared_ptr<stream_listener> listener_;
+
+public:
+    stream_reader(io_pool & pool,
+                  std::auto_ptr<resource_istream> in,
+                  std::auto_ptr<stream_listener> listener)
+        OPENVRML_THROW1(std::bad_alloc):
+        pool_(&pool),
+        in_(in),
+        listener_(listener)
+    {}
+
+    void operator()() const
+    {
+        typedef resource_istream::traits_type traits_type;
+
+        resource_istream & in = *this->in_;
+        const boost::shared_ptr<buffer> data =
+            this->pool_->acquire_buffer();
+        stream_list::iterator stream;
+        try {
+            stream = this->pool_->open_stream(in.url());
+        } catch (...) {
+            this->pool_->release_buffer(data);
+            throw;
+        }
+        try {
+            this->listener_->stream_available(in.url(), in.type());
+            while (in) {
+                //
+                // Block until at least one byte is available; and then take
+                // whatever else the stream already has buffered.
+                //
+                if (traits_type::eq_int_type(in.peek(), traits_type::eof())) {
+                    break;
+                }
+                data->resize(chunk_size);
+                std::streamsize n =
+                    in.readsome(reinterpret_cast<char *>(&data->front()),
+                                chunk_size);
+                if (n <= 0) {
+                    //
+                    // An unbuffered stream may not say how much is
+                    // available; but there is at least the byte we peeked.
+                    //
+                    data->front() = static_cast<unsigned char>(
+                        traits_type::to_char_type(in.get()));
+                    n = 1;
+                }
+                data->resize(static_cast<std::size_t>(n));
+                this->listener_->data_available(*data);
+                this->pool_->stream_read(stream, data->size());
+            }
+        } catch (...) {
+            this->pool_->close_stream(stream);
+            this->pool_->release_buffer(data);
+            throw;
+        }
+        this->pool_->close_stream(stream);
+        this->pool_->release_buffer(data);
+    }
+};
+
+/**
+ * @brief Construct.
+ */
+openvrml::local::io_pool::io_pool() OPENVRML_NOTHROW:
+    threads_(default_threads),
+    queued_(0),
+    max_queued_(0),
+    active_(0),
+    completed_(0),
+    bytes_(0),
+    finished_streams_(0)
+{}
+
+/**
+ * @brief Destroy.
+ *
+ * Any tasks still pending are run before the threads exit.
+ */
+openvrml::local::io_pool::~io_pool() OPENVRML_NOTHROW
+{}
+
+/**
+ * @brief Set the number of threads.
+ *
+ * Tasks that have already been submitted finish on the old threads; this
+ * function does not return until they have.
+ *
+ * @param[in] threads   the number of threads; 0 is taken as 1.
+ */
+void openvrml::local::io_pool::threads(std::size_t threads) OPENVRML_NOTHROW
+{
+    threads = (std::max)(threads, std::size_t(1));
+    boost::scoped_ptr<thread_pool> old;
+    {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        if (threads == this->threads_) { return; }
+        this->threads_ = threads;
+        old.swap(this->pool_);
+        if (this->buffers_.size() > threads) {
+            this->buffers_.resize(threads);
+        }
+    }
+}
+
+/**
+ * @brief The number of threads.
+ *
+ * @return the number of threads.
+ */
+std::size_t openvrml::local::io_pool::threads() const OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    return this->threads_;
+}
+
+/**
+ * @brief Submit a task.
+ *
+ * @p t should not throw; any exception that escapes it is discarded.  @p t
+ * is destroyed before @p done is called.
+ *
+ * @param[in] t     a task.
+ * @param[in] done  called when @p t has finished; may be empty.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if the threads cannot be
+ *                                          started.
+ */
+void openvrml::local::io_pool::submit(const task & t, const task & done)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error)
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    if (!this->pool_) { this->pool_.reset(new thread_pool(this->threads_)); }
+    const counted_task counted = { this, t, done };
+    this->pool_->submit(counted);
+    this->max_queued_ = (std::max)(++this->queued_, this->max_queued_);
+}
+
+/**
+ * @brief Make a task that reads a stream.
+ *
+ * The task calls @c stream_listener::stream_available and then passes the
+ * stream's data to @c stream_listener::data_available as it arrives.  The
+ * vector passed to @c stream_listener::data_available is reused once it
+ * returns.  The task releases @p in and @p listener when it is destroyed.
+ *
+ * @param[in] in        an input stream.
+ * @param[in] listener  a stream listener.
+ *
+ * @return a task that reads @p in.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const openvrml::local::io_pool::task
+openvrml::local::io_pool::reader(std::auto_ptr<resource_istream> in,
+                                 std::auto_ptr<stream_listener> listener)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    return stream_reader(*this, in, listener);
+}
+
+/**
+ * @brief The number of tasks and bytes read.
+ *
+ * @return the number of tasks and bytes read.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const openvrml::browser::io_statistics
+openvrml::local::io_pool::statistics() const OPENVRML_THROW1(std::bad_alloc)
+{
+    browser::io_statistics result;
+    const double now = browser::current_time();
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    result.threads = this->threads_;
+    result.queued = this->queued_;
+    result.max_queued = this->max_queued_;
+    result.active = this->active_;
+    result.completed = this->completed_;
+    result.bytes = this->bytes_;
+    result.streams.reserve(this->streams_.size());
+    for (stream_list::const_iterator stream = this->streams_.begin();
+         stream != this->streams_.end();
+         ++stream) {
+        result.streams.push_back(stream->statistics);
+        if (!stream->statistics.complete) {
+            result.streams.back().seconds = now - stream->start;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Reset the statistics.
+ *
+ * The statistics of finished streams are discarded; the high-water mark of
+ * the queue is reset to its current depth.
+ */
+void openvrml::local::io_pool::reset_statistics() OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    this->max_queued_ = this->queued_;
+    this->completed_ = 0;
+    this->bytes_ = 0;
+    for (stream_list::iterator stream = this->streams_.begin();
+         stream != this->streams_.end();) {
+        if (stream->statistics.complete) {
+            stream = this->streams_.erase(stream);
+        } else {
+            ++stream;
+        }
+    }
+    this->finished_streams_ = 0;
+}
+
+/**
+ * @brief Note that a task has been taken from the queue.
+ */
+void openvrml::local::io_pool::started() OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    --this->queued_;
+    ++this->active_;
+}
+
+/**
+ * @brief Note that a task has finished.
+ */
+void openvrml::local::io_pool::finished() OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    --this->active_;
+    ++this->completed_;
+}
+
+/**
+ * @brief Get a chunk buffer.
+ *
+ * @return a chunk buffer.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const boost::shared_ptr<openvrml::local::io_pool::buffer>
+openvrml::local::io_pool::acquire_buffer() OPENVRML_THROW1(std::bad_alloc)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        if (!this->buffers_.empty()) {
+            const boost::shared_ptr<buffer> result = this->buffers_.back();
+            this->buffers_.pop_back();
+            return result;
+        }
+    }
+    const boost::shared_ptr<buffer> result(new buffer);
+    result->reserve(chunk_size);
+    return result;
+}
+
+/**
+ * @brief Return a chunk buffer obtained with @c #acquire_buffer.
+ *
+ * At most one buffer per thread is kept.
+ *
+ * @param[in] b a chunk buffer.
+ */
+void
+openvrml::local::io_pool::release_buffer(const boost::shared_ptr<buffer> & b)
+    OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    if (this->buffers_.size() >= this->threads_) { return; }
+    try {
+        this->buffers_.push_back(b);
+    } catch (std::bad_alloc &) {}
+}
+
+/**
+ * @brief Start keeping statistics for a stream.
+ *
+ * @param[in] url   the stream's URI.
+ *
+ * @return the stream's record.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::local::io_pool::stream_list::iterator
+openvrml::local::io_pool::open_stream(const std::string & url)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    stream_record record;
+    record.statistics.url = url;
+    record.statistics.bytes = 0;
+    record.statistics.chunks = 0;
+    record.statistics.seconds = 0.0;
+    record.statistics.complete = false;
+    record.start = browser::current_time();
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    return this->streams_.insert(this->streams_.end(), record);
+}
+
+/**
+ * @brief Note that a chunk has been read from a stream.
+ *
+ * @param[in] stream    the stream's record.
+ * @param[in] bytes     the size of the chunk.
+ */
+void openvrml::local::io_pool::stream_read(const stream_list::iterator stream,
+                                           const std::size_t bytes)
+    OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    stream->statistics.bytes += bytes;
+    ++stream->statistics.chunks;
+    this->bytes_ += bytes;
+}
+
+/**
+ * @brief Note that a stream has been read.
+ *
+ * The statistics of the oldest finished stream are discarded if there are
+ * more than @c #history.
+ *
+ * @param[in] stream    the stream's record.
+ */
+void openvrml::local::io_pool::close_stream(const stream_list::iterator stream)
+    OPENVRML_NOTHROW
+{
+    const double now = browser::current_time();
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    stream->statistics.seconds = now - stream->start;
+    stream->statistics.complete = true;
+    if (++this->finished_streams_ <= history) { return; }
+    for (stream_list::iterator oldest = this->streams_.begin();
+         oldest != this->streams_.end();
+         ++oldest) {
+        if (oldest->statistics.complete) {
+            this->streams_.erase(oldest);
+            --this->finished_streams_;
+            break;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_IO_POOL_H
+#   define OPENVRML_LOCAL_IO_POOL_H
+
+#   include <openvrml/browser.h>
+#   include <boost/function.hpp>
+#   include <boost/scoped_ptr.hpp>
+#   include <boost/shared_ptr.hpp>
+#   include <boost/thread/mutex.hpp>
+#   include <list>
+#   include <memory>
+#   include <vector>
+
+namespace openvrml {
+
+    namespace local {
+
+        class thread_pool;
+
+        class OPENVRML_LOCAL io_pool : boost::noncopyable {
+        public:
+            enum {
+                default_threads = 8,
+                chunk_size = 65536,
+                history = 256
+            };
+
+            typedef boost::function0<void> task;
+
+        private:
+            typedef std::vector<unsigned char> buffer;
+
+            struct stream_record {
+                browser::stream_statistics statistics;
+                double start;
+            };
+
+            typedef std::list<stream_record> stream_list;
+
+            struct counted_task;
+            class stream_reader;
+
+            mutable boost::mutex mutex_;
+            std::size_t threads_;
+            boost::scoped_ptr<thread_pool> pool_;
+            std::vector<boost::shared_ptr<buffer> > buffers_;
+            std::size_t queued_;
+            std::size_t max_queued_;
+            std::size_t active_;
+            std::size_t completed_;
+            std::size_t bytes_;
+            stream_list streams_;
+            std::size_t finished_streams_;
+
+        public:
+            io_pool() OPENVRML_NOTHROW;
+            ~io_pool() OPENVRML_NOTHROW;
+
+            void threads(std::size_t threads) OPENVRML_NOTHROW;
+            std::size_t threads() const OPENVRML_NOTHROW;
+
+            void submit(const task & t, const task & done)
+                OPENVRML_THROW2(std::bad_alloc,
+                                boost::thread_resource_error);
+            const task reader(std::auto_ptr<resource_istream> in,
+                              std::auto_ptr<stream_listener> listener)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            const browser::io_statistics statistics() const
+                OPENVRML_THROW1(std::bad_alloc);
+            void reset_statistics() OPENVRML_NOTHROW;
+
+        private:
+            void started() OPENVRML_NOTHROW;
+            void finished() OPENVRML_NOTHROW;
+
+            const boost::shared_ptr<buffer> acquire_buffer()
+                OPENVRML_THROW1(std::bad_alloc);
+            void release_buffer(const boost::shared_ptr<buffer> & b)
+                OPENVRML_NOTHROW;
+
+            stream_list::iterator open_stream(const std::string & url)
+                OPENVRML_THROW1(std::bad_alloc);
+            void stream_read(stream_list::iterator stream, std::size_t bytes)
+                OPENVRML_NOTHROW;
+            void close_stream(stream_list::iterator stream) OPENVRML_NOTHROW;
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_IO_POOL_H
@@ -0,0 +1,528 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "occlusion_buffer.h"
+# include <openvrml/frustum.h>
+# include <algorithm>
+# include <cmath>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    //
+    // A bounding volume must be this much farther than the occluders in
+    // front of it to be considered hidden; this absorbs rounding in the
+    // rasterization.
+    //
+    const float depth_tolerance = 1e-4f;
+
+    //
+    // The vertices of a box's faces, as indices of its corners; corner i
+    // has the maximum x if bit 0 is set, y if bit 1 is set, and z if bit 2
+    // is set.
+    //
+    const unsigned char box_face[6][4] = {
+        { 0, 2, 6, 4 },
+        { 1, 5, 7, 3 },
+        { 0, 4, 5, 1 },
+        { 2, 3, 7, 6 },
+        { 0, 1, 3, 2 },
+        { 4, 6, 7, 5 }
+    };
+}
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::occlusion_buffer
+ *
+ * @brief A low-resolution software depth buffer used to reject nodes hidden
+ *        behind occluders.
+ *
+ * Occluders (boxes that are drawn opaque) are rasterized as they are
+ * rendered.  Only pixels the occluder covers entirely are written, with the
+ * farthest depth of the occluder over the pixel; so the buffer never claims
+ * more is hidden than really is.  The depth stored is the reciprocal of the
+ * eye-space distance, which varies linearly across a polygon in screen
+ * space; larger values are nearer.
+ *
+ * The pixels are grouped into tiles of @c #tile_size by @c #tile_size; each
+ * tile records the farthest depth of its pixels.  A bounding volume is
+ * hidden if its nearest point is behind every pixel its screen-space
+ * rectangle overlaps; most tiles are decided by their tile depth alone.
+ *
+ * A node is tested only against the occluders rendered before it.
+ */
+
+/**
+ * @var openvrml::local::occlusion_buffer::width
+ *
+ * @brief The width of the buffer in pixels.
+ */
+
+/**
+ * @var openvrml::local::occlusion_buffer::height
+ *
+ * @brief The height of the buffer in pixels.
+ */
+
+/**
+ * @var openvrml::local::occlusion_buffer::tile_size
+ *
+ * @brief The width and height of a tile in pixels.
+ */
+
+/**
+ * @var openvrml::local::occlusion_buffer::tiles_x
+ *
+ * @brief The number of tiles across the buffer.
+ */
+
+/**
+ * @var openvrml::local::occlusion_buffer::tiles_y
+ *
+ * @brief The number of tiles down the buffer.
+ */
+
+/**
+ * @var std::size_t openvrml::local::occlusion_buffer::culled
+ *
+ * @brief The number of bounding volumes found outside the view volume in the
+ *        current frame.
+ */
+
+/**
+ * @var std::size_t openvrml::local::occlusion_buffer::tested
+ *
+ * @brief The number of bounding volumes tested against the buffer in the
+ *        current frame.
+ */
+
+/**
+ * @var std::size_t openvrml::local::occlusion_buffer::occluded
+ *
+ * @brief The number of bounding volumes found hidden in the current frame.
+ */
+
+/**
+ * @var std::size_t openvrml::local::occlusion_buffer::occluders
+ *
+ * @brief The number of occluders rasterized in the current frame.
+ */
+
+/**
+ * @var bool openvrml::local::occlusion_buffer::valid_
+ *
+ * @brief Whether the view volume of the current frame can be represented.
+ */
+
+/**
+ * @var bool openvrml::local::occlusion_buffer::drawn_
+ *
+ * @brief Whether anything has been rasterized since the buffer was cleared.
+ */
+
+/**
+ * @var float openvrml::local::occlusion_buffer::scale_x_
+ *
+ * @brief The projection's horizontal scale: the cotangent of half the
+ *        horizontal field of view.
+ */
+
+/**
+ * @var float openvrml::local::occlusion_buffer::scale_y_
+ *
+ * @brief The projection's vertical scale: the cotangent of half the vertical
+ *        field of view.
+ */
+
+/**
+ * @var float openvrml::local::occlusion_buffer::z_near_
+ *
+ * @brief The distance to the near clipping plane.
+ */
+
+/**
+ * @var std::vector<float> openvrml::local::occlusion_buffer::depth_
+ *
+ * @brief The depth of each pixel, in rows from the bottom.
+ */
+
+/**
+ * @var std::vector<float> openvrml::local::occlusion_buffer::tile_depth_
+ *
+ * @brief The farthest depth of the pixels in each tile.
+ */
+
+/**
+ * @var std::vector<unsigned char> openvrml::local::occlusion_buffer::tile_dirty_
+ *
+ * @brief Whether the corresponding element of @a tile_depth_ is out of
+ *        date.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::local::occlusion_buffer::occlusion_buffer()
+    OPENVRML_THROW1(std::bad_alloc):
+    culled(0),
+    tested(0),
+    occluded(0),
+    occluders(0),
+    valid_(false),
+    drawn_(false),
+    scale_x_(0.0f),
+    scale_y_(0.0f),
+    z_near_(0.0f),
+    depth_(width * height, 0.0f),
+    tile_depth_(tiles_x * tiles_y, 0.0f),
+    tile_dirty_(tiles_x * tiles_y, 0)
+{}
+
+/**
+ * @brief Clear the buffer and the counts for a new frame.
+ *
+ * @param[in] f the view frustum.
+ */
+void
+openvrml::local::occlusion_buffer::begin_frame(const openvrml::frustum & f)
+    OPENVRML_NOTHROW
+{
+    this->culled = 0;
+    this->tested = 0;
+    this->occluded = 0;
+    this->occluders = 0;
+
+    this->valid_ = f.fovx > 0.0f && f.fovy > 0.0f && f.z_near > 0.0;
+    if (!this->valid_) { return; }
+    this->scale_x_ = 1.0f / float(std::tan(f.fovx / 2.0));
+    this->scale_y_ = 1.0f / float(std::tan(f.fovy / 2.0));
+    this->z_near_ = float(f.z_near);
+
+    if (this->drawn_) {
+        std::fill(this->depth_.begin(), this->depth_.end(), 0.0f);
+        std::fill(this->tile_depth_.begin(), this->tile_depth_.end(), 0.0f);
+        std::fill(this->tile_dirty_.begin(), this->tile_dirty_.end(), 0);
+        this->drawn_ = false;
+    }
+}
+
+/**
+ * @brief Whether the buffer can be used in the current frame.
+ *
+ * @return @c true if the view frustum passed to @c #begin_frame was a
+ *         perspective frustum; @c false otherwise.
+ */
+bool openvrml::local::occlusion_buffer::valid() const OPENVRML_NOTHROW
+{
+    return this->valid_;
+}
+
+/**
+ * @brief Rasterize an occluding box.
+ *
+ * @param[in] modelview the transformation from the box's coordinate system
+ *                      to eye space.
+ * @param[in] minimum   the minimum corner of the box.
+ * @param[in] maximum   the maximum corner of the box.
+ */
+void openvrml::local::occlusion_buffer::add_box(const mat4f & modelview,
+                                                const vec3f & minimum,
+                                                const vec3f & maximum)
+    OPENVRML_NOTHROW
+{
+    if (!this->valid_) { return; }
+    ++this->occluders;
+
+    vec3f corner[8];
+    for (std::size_t i = 0; i < 8; ++i) {
+        corner[i] = make_vec3f((i & 1) ? maximum.x() : minimum.x(),
+                               (i & 2) ? maximum.y() : minimum.y(),
+                               (i & 4) ? maximum.z() : minimum.z())
+            * modelview;
+    }
+
+    for (std::size_t face = 0; face < 6; ++face) {
+        const vec3f vertex[4] = {
+            corner[box_face[face][0]],
+            corner[box_face[face][1]],
+            corner[box_face[face][2]],
+            corner[box_face[face][3]]
+        };
+        this->add_polygon(vertex, 4);
+    }
+}
+
+/**
+ * @brief Rasterize a convex polygon.
+ *
+ * The part of the polygon in front of the near clipping plane is discarded.
+ *
+ * @param[in] vertex    the eye-space vertices.
+ * @param[in] n         the number of vertices; no more than 4.
+ */
+void
+openvrml::local::occlusion_buffer::add_polygon(const vec3f * const vertex,
+                                               const std::size_t n)
+    OPENVRML_NOTHROW
+{
+    //
+    // Clipping a quadrilateral against one plane yields at most five
+    // vertices.
+    //
+    float clipped[5][3];
+    std::size_t count = 0;
+    const float limit = -this->z_near_;
+    for (std::size_t i = 0; i < n; ++i) {
+        const vec3f & a = vertex[i];
+        const vec3f & b = vertex[(i + 1) % n];
+        const bool a_in = a.z() <= limit, b_in = b.z() <= limit;
+        if (a_in) {
+            clipped[count][0] = a.x();
+            clipped[count][1] = a.y();
+            clipped[count][2] = a.z();
+            ++count;
+        }
+        if (a_in != b_in) {
+            const float t = (limit - a.z()) / (b.z() - a.z());
+            clipped[count][0] = a.x() + t * (b.x() - a.x());
+            clipped[count][1] = a.y() + t * (b.y() - a.y());
+            clipped[count][2] = limit;
+            ++count;
+        }
+    }
+    if (count < 3) { return; }
+
+    //
+    // Project to pixel coordinates and reciprocal depth.
+    //
+    float screen[5][3];
+    for (std::size_t i = 0; i < count; ++i) {
+        const float q = -1.0f / clipped[i][2];
+        screen[i][0] = (clipped[i][0] * this->scale_x_ * q + 1.0f)
+            * (width / 2.0f);
+        screen[i][1] = (clipped[i][1] * this->scale_y_ * q + 1.0f)
+            * (height / 2.0f);
+        screen[i][2] = q;
+    }
+    this->rasterize(screen, count);
+}
+
+/**
+ * @brief Rasterize a convex polygon in screen space.
+ *
+ * Only pixels entirely inside the polygon are written.  The depth written
+ * is the farthest depth of the polygon's plane over the pixel.  The
+ * polygon is rasterized whole rather than as a fan of triangles, since
+ * pixels straddling the edges shared by the triangles would not be written.
+ *
+ * @param[in] vertex    the vertices: pixel coordinates and reciprocal
+ *                      depth.
+ * @param[in] n         the number of vertices; no more than 5.
+ */
+void
+openvrml::local::occlusion_buffer::rasterize(const float (*const vertex)[3],
+                                             const std::size_t n)
+    OPENVRML_NOTHROW
+{
+    using std::fabs;
+    using std::floor;
+    using std::ceil;
+
+    //
+    // The plane of the polygon in (x, y, q), by Newell's method; nz is
+    // twice the signed area.
+    //
+    float nx = 0.0f, ny = 0.0f, nz = 0.0f;
+    float min_x = vertex[0][0], max_x = vertex[0][0];
+    float min_y = vertex[0][1], max_y = vertex[0][1];
+    for (std::size_t i = 0; i < n; ++i) {
+        const float (&p)[3] = vertex[i];
+        const float (&r)[3] = vertex[(i + 1) % n];
+        nx += (p[1] - r[1]) * (p[2] + r[2]);
+        ny += (p[2] - r[2]) * (p[0] + r[0]);
+        nz += (p[0] - r[0]) * (p[1] + r[1]);
+        min_x = std::min(min_x, p[0]);
+        max_x = std::max(max_x, p[0]);
+        min_y = std::min(min_y, p[1]);
+        max_y = std::max(max_y, p[1]);
+    }
+    if (!(fabs(nz) > 1e-6f)) { return; }
+    if (max_x <= 0.0f || max_y <= 0.0f
+        || min_x >= float(width) || min_y >= float(height)) {
+        return;
+    }
+
+    //
+    // Orient the edges so that the inside is where every edge function is
+    // positive.
+    //
+    const float sign = nz > 0.0f ? 1.0f : -1.0f;
+    float a[5], b[5], c[5];
+    for (std::size_t e = 0; e < n; ++e) {
+        const float (&p)[3] = vertex[e];
+        const float (&r)[3] = vertex[(e + 1) % n];
+        a[e] = -sign * (r[1] - p[1]);
+        b[e] = sign * (r[0] - p[0]);
+        c[e] = -(a[e] * p[0] + b[e] * p[1]);
+        //
+        // The smallest value of the edge function over a pixel is at the
+        // corner farthest toward the outside; at the pixel center it is
+        // this much larger.
+        //
+        c[e] -= (fabs(a[e]) + fabs(b[e])) / 2.0f;
+    }
+
+    const float dqdx = -nx / nz;
+    const float dqdy = -ny / nz;
+    const float q0 = vertex[0][2] - dqdx * vertex[0][0]
+        - dqdy * vertex[0][1] - (fabs(dqdx) + fabs(dqdy)) / 2.0f;
+
+    const std::size_t x0 = std::size_t(std::max(floor(min_x), 0.0f));
+    const std::size_t x1 = std::size_t(std::min(ceil(max_x), float(width)));
+    const std::size_t y0 = std::size_t(std::max(floor(min_y), 0.0f));
+    const std::size_t y1 = std::size_t(std::min(ceil(max_y), float(height)));
+
+    for (std::size_t y = y0; y < y1; ++y) {
+        const float py = float(y) + 0.5f;
+        float * const row = &this->depth_[y * width];
+        for (std::size_t x = x0; x < x1; ++x) {
+            const float px = float(x) + 0.5f;
+            std::size_t e = 0;
+            while (e < n && a[e] * px + b[e] * py + c[e] >= 0.0f) { ++e; }
+            if (e < n) { continue; }
+            const float q = q0 + dqdx * px + dqdy * py;
+            if (q > row[x]) {
+                row[x] = q;
+                this->tile_dirty_[(y / tile_size) * tiles_x
+                                  + x / tile_size] = 1;
+                this->drawn_ = true;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Get the farthest depth in a tile.
+ *
+ * @param[in] tile  the index of a tile.
+ *
+ * @return the farthest depth of the pixels in the tile.
+ */
+float openvrml::local::occlusion_buffer::tile_depth(const std::size_t tile)
+    OPENVRML_NOTHROW
+{
+    if (this->tile_dirty_[tile]) {
+        const std::size_t tx = tile % tiles_x, ty = tile / tiles_x;
+        float farthest = this->depth_[ty * tile_size * width
+                                      + tx * tile_size];
+        for (std::size_t y = 0; y < tile_size; ++y) {
+            const float * const row =
+                &this->depth_[(ty * tile_size + y) * width + tx * tile_size];
+            for (std::size_t x = 0; x < tile_size; ++x) {
+                farthest = std::min(farthest, row[x]);
+            }
+        }
+        this->tile_depth_[tile] = farthest;
+        this->tile_dirty_[tile] = 0;
+    }
+    return this->tile_depth_[tile];
+}
+
+/**
+ * @brief Determine whether a bounding sphere is hidden by the occluders
+ *        rasterized so far.
+ *
+ * @param[in] bs    a bounding sphere in eye space.
+ *
+ * @return @c true if @p bs is entirely behind the occluders; @c false
+ *         otherwise.
+ */
+bool openvrml::local::occlusion_buffer::hides(const bounding_sphere & bs)
+    OPENVRML_NOTHROW
+{
+    if (!this->valid_ || !this->drawn_) { return false; }
+    const float r = bs.radius();
+    if (r < 0.0f || bs.maximized()) { return false; }
+    const vec3f & c = bs.center();
+
+    //
+    // The nearest point of the sphere must be beyond the near plane.
+    //
+    const float near_distance = -(c.z() + r);
+    if (!(near_distance >= this->z_near_)) { return false; }
+    const float far_distance = -(c.z() - r);
+    const float q = 1.0f / near_distance;
+
+    //
+    // The screen-space rectangle around the projection of the sphere's
+    // eye-space bounding box.
+    //
+    const float left = c.x() - r, right = c.x() + r;
+    const float bottom = c.y() - r, top = c.y() + r;
+    const float ndc[4] = {
+        this->scale_x_ * left / (left >= 0.0f ? far_distance : near_distance),
+        this->scale_x_ * right / (right >= 0.0f ? near_distance
+                                                : far_distance),
+        this->scale_y_ * bottom / (bottom >= 0.0f ? far_distance
+                                                  : near_distance),
+        this->scale_y_ * top / (top >= 0.0f ? near_distance : far_distance)
+    };
+    const float min_x = (ndc[0] + 1.0f) * (width / 2.0f);
+    const float max_x = (ndc[1] + 1.0f) * (width / 2.0f);
+    const float min_y = (ndc[2] + 1.0f) * (height / 2.0f);
+    const float max_y = (ndc[3] + 1.0f) * (height / 2.0f);
+    if (max_x < 0.0f || max_y < 0.0f
+        || min_x >= float(width) || min_y >= float(height)) {
+        return false;
+    }
+    const std::size_t x0 = std::size_t(std::max(min_x, 0.0f));
+    const std::size_t x1 = std::size_t(std::min(max_x, width - 1.0f));
+    const std::size_t y0 = std::size_t(std::max(min_y, 0.0f));
+    const std::size_t y1 = std::size_t(std::min(max_y, height - 1.0f));
+
+    const float threshold = q * (1.0f + depth_tolerance);
+    for (std::size_t ty = y0 / tile_size; ty <= y1 / tile_size; ++ty) {
+        for (std::size_t tx = x0 / tile_size; tx <= x1 / tile_size; ++tx) {
+            if (this->tile_depth(ty * tiles_x + tx) > threshold) {
+                continue;
+            }
+            const std::size_t py0 = std::max(y0, ty * tile_size);
+            const std::size_t py1 = std::min(y1, ty * tile_size
+                                             + tile_size - 1);
+            const std::size_t px0 = std::max(x0, tx * tile_size);
+            const std::size_t px1 = std::min(x1, tx * tile_size
+                                             + tile_size - 1);
+            for (std::size_t y = py0; y <= py1; ++y) {
+                const float * const row = &this->depth_[y * width];
+                for (std::size_t x = px0; x <= px1; ++x) {
+                    if (!(row[x] > threshold)) { return false; }
+                }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_OCCLUSION_BUFFER_H
+#   define OPENVRML_LOCAL_OCCLUSION_BUFFER_H
+
+#   include <openvrml/bounding_volume.h>
+#   include <boost/utility.hpp>
+#   include <vector>
+
+namespace openvrml {
+
+    class frustum;
+
+    namespace local {
+
+        class OPENVRML_LOCAL occlusion_buffer : boost::noncopyable {
+        public:
+            enum {
+                width = 256,
+                height = 256,
+                tile_size = 8,
+                tiles_x = width / tile_size,
+                tiles_y = height / tile_size
+            };
+
+            std::size_t culled;
+            std::size_t tested;
+            std::size_t occluded;
+            std::size_t occluders;
+
+        private:
+            bool valid_;
+            bool drawn_;
+            float scale_x_;
+            float scale_y_;
+            float z_near_;
+            std::vector<float> depth_;
+            std::vector<float> tile_depth_;
+            std::vector<unsigned char> tile_dirty_;
+
+        public:
+            occlusion_buffer() OPENVRML_THROW1(std::bad_alloc);
+
+            void begin_frame(const openvrml::frustum & f) OPENVRML_NOTHROW;
+            bool valid() const OPENVRML_NOTHROW;
+            void add_box(const mat4f & modelview,
+                         const vec3f & minimum,
+                         const vec3f & maximum)
+                OPENVRML_NOTHROW;
+            bool hides(const bounding_sphere & bs) OPENVRML_NOTHROW;
+
+        private:
+            void add_polygon(const vec3f * vertex, std::size_t n)
+                OPENVRML_NOTHROW;
+            void rasterize(const float (*vertex)[3], std::size_t n)
+                OPENVRML_NOTHROW;
+            float tile_depth(std::size_t tile) OPENVRML_NOTHROW;
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_OCCLUSION_BUFFER_H
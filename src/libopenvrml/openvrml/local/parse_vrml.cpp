@@ -19,8 +19,11 @@
 //
 
 # include "parse_vrml.h"
+# include "parse_x3d_xml.h"
+# include "scene_snapshot.h"
 # include <openvrml/x3d_vrml_grammar.h>
 # include <boost/algorithm/string/predicate.hpp>
+# include <algorithm>
 
 bool openvrml::local::anonymous_stream_id(const openvrml::local::uri & id)
 {
@@ -40,9 +43,48 @@ namespace {
         parse_error(): line(0), column(0) {}
     };
 
+    //
+    // Compute the line and column of where in the buffer starting at first.
+    //
+    // This follows the rules used by Spirit's position_iterator (with its
+    // default tab width of 4) so that diagnostics are the same as they were
+    // when the input was read through one.  It is only done when a
+    // diagnostic is actually issued.
+    //
+    OPENVRML_LOCAL void compute_position(const char * first,
+                                         const char * const where,
+                                         size_t & line,
+                                         size_t & column)
+    {
+        static const size_t tab_chars = 4;
+        line = 1;
+        column = 1;
+        while (first != where) {
+            const char c = *first++;
+            if (c == '\n') {
+                ++line;
+                column = 1;
+            } else if (c == '\r') {
+                if (first == where || *first != '\n') {
+                    ++line;
+                    column = 1;
+                }
+            } else if (c == '\t') {
+                column += tab_chars - (column - 1) % tab_chars;
+            } else {
+                ++column;
+            }
+        }
+    }
+
     struct OPENVRML_LOCAL error_handler {
-        error_handler(openvrml::browser & b, parse_error & error):
+        error_handler(openvrml::browser & b,
+                      const std::string & uri,
+                      const char * const begin,
+                      parse_error & error):
             browser_(b),
+            uri_(uri),
+            begin_(begin),
             error_(error)
         {}
 
@@ -53,9 +95,9 @@ namespace {
             using std::endl;
             using std::string;
             using boost::spirit::classic::error_status;
-            using boost::spirit::classic::file_position;
 
-            const file_position fpos = err.where.get_position();
+            size_t line, column;
+            compute_position(this->begin_, err.where, line, column);
 
             //
             // Warnings we want to spew directly to the browser.
@@ -66,7 +108,7 @@ namespace {
                 || err.descriptor == openvrml::exposedfield_deprecated
                 || err.descriptor == openvrml::field_deprecated) {
                 std::ostringstream warn;
-                warn << fpos.file << ':' << fpos.line << ':' << fpos.column
+                warn << this->uri_ << ':' << line << ':' << column
                      << ": warning: "
                      << x3d_vrml_parse_error_msg(err.descriptor);
                 this->browser_.err(warn.str());
@@ -79,8 +121,8 @@ namespace {
             // need enough information to create an invalid_vrml exception in
             // parse_vrml.
             //
-            this->error_.line = static_cast<size_t>(fpos.line);
-            this->error_.column = static_cast<size_t>(fpos.column);
+            this->error_.line = line;
+            this->error_.column = column;
             this->error_.message = x3d_vrml_parse_error_msg(err.descriptor);
 
             return error_status<>(error_status<>::fail);
@@ -88,8 +130,64 @@ namespace {
 
     private:
         openvrml::browser & browser_;
+        const std::string & uri_;
+        const char * const begin_;
         parse_error & error_;
     };
+
+    //
+    // Read the rest of in into buffer.
+    //
+    // This reads directly from the stream buffer in large blocks.  If the
+    // stream is seekable, the buffer is sized up front.
+    //
+    OPENVRML_LOCAL void read_all(std::istream & in, std::vector<char> & buffer)
+    {
+        using std::ios_base;
+        using std::streambuf;
+        using std::streamoff;
+        using std::streampos;
+        using std::streamsize;
+
+        static const size_t block_size = 64 * 1024;
+
+        buffer.clear();
+        streambuf * const buf = in.rdbuf();
+        if (!buf) {
+            in.setstate(ios_base::badbit);
+            return;
+        }
+
+        const streampos current = buf->pubseekoff(0, ios_base::cur,
+                                                  ios_base::in);
+        if (current != streampos(streamoff(-1))) {
+            const streampos end = buf->pubseekoff(0, ios_base::end,
+                                                  ios_base::in);
+            if (end != streampos(streamoff(-1))
+                && buf->pubseekpos(current, ios_base::in) == current
+                && end > current) {
+                //
+                // One more byte than the remaining size, so that the first
+                // read does not need to grow the buffer to discover the end.
+                //
+                buffer.resize(static_cast<size_t>(end - current) + 1);
+            }
+        }
+
+        size_t size = 0;
+        for (;;) {
+            if (buffer.size() - size < block_size / 4) {
+                buffer.resize(std::max(2 * buffer.size(), size + block_size));
+            }
+            const streamsize n =
+                buf->sgetn(&buffer[size],
+                           static_cast<streamsize>(buffer.size() - size));
+            if (n <= 0) { break; }
+            size += static_cast<size_t>(n);
+        }
+        buffer.resize(size);
+        in.setstate(ios_base::eofbit);
+    }
 }
 
 /**
@@ -97,6 +195,14 @@ namespace {
  *
  * @brief Parse a VRML stream.
  *
+ * The remainder of @p in is read into memory in large blocks and parsed by
+ * the overload that takes a character range.
+ *
+ * If the browser has a scene cache directory, VRML and X3D VRML-encoded
+ * data from a named resource is loaded from a current snapshot if there is
+ * one; otherwise a snapshot is recorded while it is parsed.
+ *
+ * @sa openvrml::browser::scene_cache_directory
  * @param[in,out] in    input stream.
  * @param[in]     uri   URI associated with @p in.
  * @param[in]     type  MIME media type of the data to be read from @p in.
@@ -116,32 +222,84 @@ parse_vrml(std::istream & in,
            std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
            std::map<std::string, std::string> & meta)
 {
-    using std::istream;
-    using std::istreambuf_iterator;
     using boost::algorithm::iequals;
-    using boost::spirit::classic::multi_pass;
-    using boost::spirit::classic::make_multi_pass;
-    using boost::spirit::classic::position_iterator;
+    using boost::algorithm::starts_with;
 
-    typedef multi_pass<istreambuf_iterator<char> > multi_pass_iterator_t;
-    typedef istream::char_type char_t;
+    std::vector<char> buffer;
+    read_all(in, buffer);
+    const char * const first = buffer.empty() ? 0 : &buffer[0];
+    const char * const last = first + buffer.size();
 
-    vrml97_skip_grammar skip_g;
+    const std::string cache_directory =
+        scene.browser().scene_cache_directory();
+    if (cache_directory.empty()
+        || starts_with(uri, anonymous_stream_id_prefix)
+        || !(iequals(type, vrml_media_type)
+             || iequals(type, x_vrml_media_type)
+             || iequals(type, x3d_vrml_media_type))) {
+        parse_vrml(first, last, uri, type, scene, nodes, meta);
+        return;
+    }
 
-    if (iequals(type, vrml_media_type) || iequals(type, x_vrml_media_type)) {
-        multi_pass_iterator_t
-            in_begin(make_multi_pass(istreambuf_iterator<char_t>(in))),
-            in_end(make_multi_pass(istreambuf_iterator<char_t>()));
+    const std::string path = scene_snapshot_path(cache_directory, uri);
+    if (load_scene_snapshot(path, first, last, uri, type, scene, nodes,
+                            meta)) {
+        return;
+    }
+    snapshot_writer snapshot(uri, type, first, last);
+    parse_vrml(first, last, uri, type, scene, nodes, meta, &snapshot);
+    try {
+        snapshot.commit(path);
+    } catch (std::runtime_error & ex) {
+        scene.browser().err(ex.what());
+    }
+}
 
-        typedef position_iterator<multi_pass_iterator_t> iterator_t;
+/**
+ * @internal
+ *
+ * @brief Parse VRML from a character range.
+ *
+ * The grammar is applied directly to @p begin and @p end; line and column
+ * numbers are computed only for diagnostics.
+ *
+ * @param[in]  begin    the beginning of the data.
+ * @param[in]  end      the end of the data.
+ * @param[in]  uri      URI associated with the data.
+ * @param[in]  type     MIME media type of the data.
+ * @param[in]  scene    a @c scene.
+ * @param[out] nodes    the root @c node%s.
+ * @param[out] meta     the @c scene metadata.
+ * @param[in]  snapshot if not null, the parse actions are recorded here.
+ *
+ * @exception openvrml::bad_media_type
+ * @exception openvrml::invalid_vrml
+ */
+void
+openvrml::local::
+parse_vrml(const char * const begin,
+           const char * const end,
+           const std::string & uri,
+           const std::string & type,
+           const openvrml::scene & scene,
+           std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+           std::map<std::string, std::string> & meta,
+           snapshot_writer * const snapshot)
+{
+    using boost::algorithm::iequals;
+
+    vrml97_skip_grammar skip_g;
 
-        iterator_t first(in_begin, in_end, uri), last;
+    const char * first = begin;
+    const char * const last = end;
 
+    if (iequals(type, vrml_media_type) || iequals(type, x_vrml_media_type)) {
         parse_error error;
-        error_handler handler(scene.browser(), error);
-        vrml97_parse_actions actions(uri, scene, nodes);
-        vrml97_grammar<vrml97_parse_actions, error_handler>
-            g(actions, handler);
+        error_handler handler(scene.browser(), uri, begin, error);
+        typedef vrml97_recording_parse_actions<vrml97_parse_actions>
+            actions_t;
+        actions_t actions(uri, scene, nodes, snapshot);
+        vrml97_grammar<actions_t, error_handler> g(actions, handler);
 
         BOOST_SPIRIT_DEBUG_NODE(skip_g);
         BOOST_SPIRIT_DEBUG_NODE(g);
@@ -153,18 +311,11 @@ parse_vrml(std::istream & in,
                                          error.message);
         }
     } else if (iequals(type, x3d_vrml_media_type)) {
-        multi_pass_iterator_t
-            in_begin(make_multi_pass(istreambuf_iterator<char_t>(in))),
-            in_end(make_multi_pass(istreambuf_iterator<char_t>()));
-
-        typedef position_iterator<multi_pass_iterator_t> iterator_t;
-
-        iterator_t first(in_begin, in_end, uri), last;
-
         parse_error error;
-        error_handler handler(scene.browser(), error);
-        x3d_vrml_parse_actions actions(uri, scene, nodes, meta);
-        x3d_vrml_grammar<x3d_vrml_parse_actions, error_handler>
+        error_handler handler(scene.browser(), uri, begin, error);
+        x3d_vrml_recording_parse_actions actions(uri, scene, nodes, meta,
+                                                 snapshot);
+        x3d_vrml_grammar<x3d_vrml_recording_parse_actions, error_handler>
             g(actions, handler);
 
         BOOST_SPIRIT_DEBUG_NODE(skip_g);
@@ -176,6 +327,10 @@ parse_vrml(std::istream & in,
                                          error.column,
                                          error.message);
         }
+    } else if (iequals(type, x3d_xml_media_type)) {
+        parse_x3d_xml(begin, end, uri, scene, nodes, meta);
+    } else if (iequals(type, x3d_fast_infoset_media_type)) {
+        parse_x3d_fast_infoset(begin, end, uri, scene, nodes, meta);
     } else {
         throw bad_media_type(type);
     }
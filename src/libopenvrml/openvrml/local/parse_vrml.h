@@ -39,6 +39,8 @@ namespace openvrml {
         OPENVRML_LOCAL
         bool anonymous_stream_id(const openvrml::local::uri & id);
 
+        class snapshot_writer;
+
         struct OPENVRML_LOCAL vrml97_parse_actions {
             vrml97_parse_actions(
                 const std::string & uri,
@@ -161,17 +163,23 @@ namespace openvrml {
 
                 void operator()() const
                 {
-                    using std::vector;
-                    using boost::intrusive_ptr;
-
-                    this->actions_.ps.push(parse_scope());
+                    (*this)(vrml97_profile::id);
+                }
 
+                //
+                // Start a scene whose root scope is that of the profile
+                // profile_id.
+                //
+                void operator()(const std::string & profile_id) const
+                {
                     const profile & p =
-                        local::profile_registry_.at(vrml97_profile::id);
+                        local::profile_registry_.at(profile_id);
                     std::auto_ptr<scope>
                         root_scope(
                             p.create_root_scope(this->actions_.scene_.browser(),
                                                 this->actions_.uri_));
+
+                    this->actions_.ps.push(parse_scope());
                     this->actions_.ps.top().scope = root_scope;
                     this->actions_.ps.top().children.push(
                         parse_scope::children_t());
@@ -1255,9 +1263,11 @@ namespace openvrml {
             //
             std::stack<parse_scope> ps;
 
-        private:
+        protected:
             const std::string uri_;
             const openvrml::scene & scene_;
+
+        private:
             std::vector<boost::intrusive_ptr<openvrml::node> > & nodes_;
         };
 
@@ -1291,8 +1301,10 @@ namespace openvrml {
                     actions_(actions)
                 {}
 
-                void operator()(const std::string & /* profile_id */) const
-                {}
+                void operator()(const std::string & profile_id) const
+                {
+                    this->actions_.on_scene_start(profile_id);
+                }
 
             private:
                 x3d_vrml_parse_actions & actions_;
@@ -1304,9 +1316,15 @@ namespace openvrml {
                     actions_(actions)
                 {}
 
-                void operator()(const std::string & /* component_id */,
-                                int32 /* level */) const
-                {}
+                void operator()(const std::string & component_id,
+                                int32 level) const
+                {
+                    assert(!this->actions_.ps.empty());
+                    local::component_registry_.at(component_id)
+                        .add_to_scope(this->actions_.scene_.browser(),
+                                      *this->actions_.ps.top().scope,
+                                      size_t(level));
+                }
 
             private:
                 x3d_vrml_parse_actions & actions_;
@@ -1523,6 +1541,16 @@ namespace openvrml {
                         const openvrml::scene & scene,
                         std::vector<boost::intrusive_ptr<node> > & nodes,
                         std::map<std::string, std::string> & meta);
+
+        OPENVRML_LOCAL
+        void parse_vrml(const char * begin,
+                        const char * end,
+                        const std::string & uri,
+                        const std::string & type,
+                        const openvrml::scene & scene,
+                        std::vector<boost::intrusive_ptr<node> > & nodes,
+                        std::map<std::string, std::string> & meta,
+                        snapshot_writer * snapshot = 0);
     }
 }
 
@@ -0,0 +1,1905 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "parse_x3d_xml.h"
+# include "parse_vrml.h"
+# include "xml_reader.h"
+# include "fast_infoset_reader.h"
+# include "float.h"
+# include <openvrml/x3d_vrml_grammar.h>
+# include <boost/algorithm/string/trim.hpp>
+# include <boost/cast.hpp>
+# include <boost/lexical_cast.hpp>
+# include <boost/noncopyable.hpp>
+# include <algorithm>
+# include <cstring>
+# include <sstream>
+
+namespace {
+
+    using openvrml::field_value;
+    using openvrml::node_interface;
+    using openvrml::node_interface_set;
+
+    //
+    // The default containerField of node types that are not usually
+    // children of a grouping node.  The table is sorted by node type
+    // identifier; anything not listed here defaults to "children".
+    //
+    struct container_field_entry {
+        const char * node_type_id;
+        const char * container_field;
+    };
+
+    const container_field_entry container_fields[] = {
+        { "Appearance",                 "appearance" },
+        { "Arc2D",                      "geometry" },
+        { "ArcClose2D",                 "geometry" },
+        { "AudioClip",                  "source" },
+        { "Box",                        "geometry" },
+        { "Circle2D",                   "geometry" },
+        { "Color",                      "color" },
+        { "ColorRGBA",                  "color" },
+        { "Cone",                       "geometry" },
+        { "Coordinate",                 "coord" },
+        { "CoordinateDouble",           "coord" },
+        { "Cylinder",                   "geometry" },
+        { "Disk2D",                     "geometry" },
+        { "ElevationGrid",              "geometry" },
+        { "Extrusion",                  "geometry" },
+        { "FillProperties",             "fillProperties" },
+        { "FogCoordinate",              "fogCoord" },
+        { "FontStyle",                  "fontStyle" },
+        { "GeoCoordinate",              "coord" },
+        { "GeoElevationGrid",           "geometry" },
+        { "GeoOrigin",                  "geoOrigin" },
+        { "ImageTexture",               "texture" },
+        { "IndexedFaceSet",             "geometry" },
+        { "IndexedLineSet",             "geometry" },
+        { "IndexedTriangleFanSet",      "geometry" },
+        { "IndexedTriangleSet",         "geometry" },
+        { "IndexedTriangleStripSet",    "geometry" },
+        { "LineProperties",             "lineProperties" },
+        { "LineSet",                    "geometry" },
+        { "Material",                   "material" },
+        { "MetadataDouble",             "metadata" },
+        { "MetadataFloat",              "metadata" },
+        { "MetadataInteger",            "metadata" },
+        { "MetadataSet",                "metadata" },
+        { "MetadataString",             "metadata" },
+        { "MovieTexture",               "texture" },
+        { "MultiTexture",               "texture" },
+        { "MultiTextureCoordinate",     "texCoord" },
+        { "MultiTextureTransform",      "textureTransform" },
+        { "Normal",                     "normal" },
+        { "PixelTexture",               "texture" },
+        { "PointSet",                   "geometry" },
+        { "Polyline2D",                 "geometry" },
+        { "Polypoint2D",                "geometry" },
+        { "Rectangle2D",                "geometry" },
+        { "Sphere",                     "geometry" },
+        { "Text",                       "geometry" },
+        { "TextureCoordinate",          "texCoord" },
+        { "TextureCoordinateGenerator", "texCoord" },
+        { "TextureTransform",           "textureTransform" },
+        { "TriangleFanSet",             "geometry" },
+        { "TriangleSet",                "geometry" },
+        { "TriangleSet2D",              "geometry" },
+        { "TriangleStripSet",           "geometry" },
+        { "TwoSidedMaterial",           "material" }
+    };
+
+    struct OPENVRML_LOCAL container_field_less {
+        bool operator()(const container_field_entry & entry,
+                        const std::string & node_type_id) const
+        {
+            return std::strcmp(entry.node_type_id, node_type_id.c_str()) < 0;
+        }
+    };
+
+    OPENVRML_LOCAL const char *
+    default_container_field(const std::string & node_type_id)
+    {
+        const container_field_entry * const end =
+            container_fields
+            + sizeof container_fields / sizeof container_fields[0];
+        const container_field_entry * const pos =
+            std::lower_bound(container_fields, end, node_type_id,
+                             container_field_less());
+        return (pos != end && node_type_id == pos->node_type_id)
+            ? pos->container_field
+            : "children";
+    }
+
+    //
+    // The interfaces every Script node has.  User-defined interfaces are
+    // accumulated in the node_data.
+    //
+    const node_interface built_in_script_interfaces[] = {
+        node_interface(node_interface::field_id,
+                       field_value::sfbool_id,
+                       "directOutput"),
+        node_interface(node_interface::exposedfield_id,
+                       field_value::sfnode_id,
+                       "metadata"),
+        node_interface(node_interface::field_id,
+                       field_value::sfbool_id,
+                       "mustEvaluate"),
+        node_interface(node_interface::exposedfield_id,
+                       field_value::mfstring_id,
+                       "url")
+    };
+
+    const node_interface_set script_interfaces(
+        built_in_script_interfaces,
+        built_in_script_interfaces
+        + sizeof built_in_script_interfaces
+          / sizeof built_in_script_interfaces[0]);
+
+    //
+    // The XML encoding spells SFBool values "true" and "false".
+    //
+    struct OPENVRML_LOCAL xml_bool_parser {
+        typedef bool result_t;
+
+        template <typename ScannerT>
+        std::ptrdiff_t operator()(const ScannerT & scan,
+                                  result_t & result) const
+        {
+            using namespace boost::spirit::classic;
+            using namespace phoenix;
+            typedef typename match_result<ScannerT, result_t>::type match_t;
+            match_t match
+                =   (   (str_p("false") | str_p("FALSE"))[var(result) = false]
+                    |   (str_p("true") | str_p("TRUE"))[var(result) = true]
+                    ).parse(scan);
+            return match.length();
+        }
+    };
+
+    const boost::spirit::classic::functor_parser<xml_bool_parser>
+        xml_bool_p;
+
+    struct OPENVRML_LOCAL xml_rotation_parser {
+        typedef openvrml::rotation result_t;
+
+        template <typename ScannerT>
+        std::ptrdiff_t operator()(const ScannerT & scan,
+                                  result_t & result) const
+        {
+            using namespace boost::spirit::classic;
+            using namespace phoenix;
+            using openvrml::float_p;
+            typedef typename match_result<ScannerT, result_t>::type match_t;
+            match_t match
+                =   (   float_p[var(result.rot[0]) = arg1]
+                        >> float_p[var(result.rot[1]) = arg1]
+                        >> float_p[var(result.rot[2]) = arg1]
+                        >> float_p[var(result.rot[3]) = arg1]
+                    ).parse(scan);
+            return match.length();
+        }
+    };
+
+    const boost::spirit::classic::functor_parser<xml_rotation_parser>
+        xml_rotation_p;
+
+    template <typename ParserT, typename T>
+    bool parse_value(const std::string & text, const ParserT & p, T & result)
+    {
+        using boost::spirit::classic::assign_a;
+        const char * const first = text.c_str();
+        return boost::spirit::classic::parse(first, first + text.size(),
+                                             p[assign_a(result)],
+                                             openvrml::vrml97_space_p).full;
+    }
+
+    template <typename ParserT, typename T>
+    bool parse_values(const std::string & text,
+                      const ParserT & p,
+                      std::vector<T> & result)
+    {
+        using boost::spirit::classic::push_back_a;
+        const char * const first = text.c_str();
+        return boost::spirit::classic::parse(first, first + text.size(),
+                                             *p[push_back_a(result)],
+                                             openvrml::vrml97_space_p).full;
+    }
+
+    //
+    // MF values in attributes are not bracketed; but otherwise large
+    // numeric arrays can be read with the same scanner the VRML grammar
+    // uses for bracketed lists.
+    //
+    template <typename Element, typename T>
+    bool parse_bulk(const std::string & text, std::vector<T> & result)
+    {
+        namespace mf_bulk = openvrml::mf_bulk;
+        const char * p = text.c_str();
+        const char * const end = p + text.size();
+        std::vector<T> values;
+        values.reserve(mf_bulk::count_tokens(p, end) / Element::components);
+        T value;
+        for (;;) {
+            p = mf_bulk::skip(p, end);
+            if (p == end) { break; }
+            if (!Element::parse(p, end, value)) { return false; }
+            values.push_back(value);
+        }
+        result.swap(values);
+        return true;
+    }
+
+    //
+    // MFString values are a sequence of quoted strings.  A value with no
+    // quotation marks at all is taken to be a single string; exporters
+    // commonly write url attributes that way.
+    //
+    OPENVRML_LOCAL bool parse_strings(const std::string & text,
+                                      std::vector<std::string> & result)
+    {
+        if (text.find('"') == std::string::npos) {
+            const std::string str = boost::algorithm::trim_copy(text);
+            if (!str.empty()) { result.push_back(str); }
+            return true;
+        }
+        return parse_values(text, openvrml::string_p, result);
+    }
+
+    typedef std::vector<openvrml::local::xml_attribute> attributes_t;
+
+    OPENVRML_LOCAL void read_attributes(openvrml::local::xml_reader & reader,
+                                        attributes_t & attributes)
+    {
+        attributes.clear();
+        for (int result = reader.move_to_first_attribute();
+             result > 0;
+             result = reader.move_to_next_attribute()) {
+            attributes.push_back(openvrml::local::xml_attribute());
+            attributes.back().name = reader.local_name();
+            attributes.back().value = reader.value();
+        }
+    }
+
+    OPENVRML_LOCAL void
+    read_attributes(openvrml::local::fast_infoset_reader & reader,
+                    attributes_t & attributes)
+    {
+        reader.take_attributes(attributes);
+    }
+
+    //
+    // Reader is either xml_reader or fast_infoset_reader; the X3D XML
+    // encoding and the compressed binary encoding describe the same
+    // document structure.
+    //
+    template <typename Reader>
+    class OPENVRML_LOCAL x3d_xml_parser : boost::noncopyable {
+
+        typedef openvrml::local::vrml97_parse_actions::node_data node_data;
+        typedef openvrml::local::vrml97_parse_actions::parse_scope
+            parse_scope;
+
+        struct element {
+            enum kind_id {
+                x3d_id,
+                head_id,
+                scene_id,
+                node_id,
+                script_field_id,
+                proto_declare_id,
+                proto_interface_id,
+                proto_field_id,
+                proto_body_id,
+                externproto_declare_id,
+                field_value_id,
+                is_id,
+                ignored_id
+            };
+
+            kind_id kind;
+            std::size_t line;
+
+            //
+            // For node_id, the SFNode or MFNode field currently receiving
+            // child nodes (if any).  For script_field_id, proto_field_id,
+            // and field_value_id, the type of the field if it can contain
+            // nodes; otherwise field_value::invalid_type_id.
+            //
+            std::string field_id;
+            field_value::type_id node_field_type;
+
+            bool script;
+            bool proto_instance;
+            std::string script_source;
+
+            bool default_value;
+            bool proto_body_read;
+
+            std::string node_type_id;
+            node_interface_set interfaces;
+            std::vector<std::string> url;
+
+            element(const kind_id kind, const std::size_t line):
+                kind(kind),
+                line(line),
+                node_field_type(field_value::invalid_type_id),
+                script(false),
+                proto_instance(false),
+                default_value(false),
+                proto_body_read(false)
+            {}
+        };
+
+        struct route {
+            std::string from, eventout, to, eventin;
+            std::size_t line;
+            std::size_t depth;
+        };
+
+        Reader & reader_;
+        const std::string & uri_;
+        const openvrml::scene & scene_;
+        openvrml::local::x3d_vrml_parse_actions actions_;
+        std::vector<element> elements_;
+        std::vector<route> routes_;
+        attributes_t attributes_;
+        bool scene_read_;
+
+    public:
+        x3d_xml_parser(Reader & reader,
+                       const std::string & uri,
+                       const openvrml::scene & scene,
+                       std::vector<boost::intrusive_ptr<openvrml::node> > &
+                           nodes,
+                       std::map<std::string, std::string> & meta);
+
+        void parse();
+
+    private:
+        void error(std::size_t line, const std::string & message) const;
+        void warn(std::size_t line, const std::string & message) const;
+        const std::string * attribute(const char * name) const;
+        openvrml::local::xml_attribute * find_attribute(const char * name);
+        const std::string & required_attribute(const char * name,
+                                               std::size_t line) const;
+
+        void start_element(std::size_t line);
+        void end_element();
+        void text();
+
+        void start_x3d(std::size_t line);
+        void start_component(std::size_t line);
+        void start_scene(std::size_t line);
+        void start_node(const std::string & name, std::size_t line);
+        void start_use(const std::string & node_name_id, std::size_t line);
+        void start_script_field(std::size_t line);
+        void start_field_value(std::size_t line);
+        void start_proto_declare(std::size_t line);
+        void start_proto_field(std::size_t line);
+        void start_externproto_declare(std::size_t line);
+        void start_externproto_field(std::size_t line);
+        void start_connect(std::size_t line);
+        void start_route(std::size_t line);
+
+        void add_child_node(const std::string & container_field,
+                            std::size_t line);
+        void open_field(element & e,
+                        const std::string & field_id,
+                        std::size_t line);
+        void close_field(element & e);
+        void close_node_value(field_value::type_id type);
+        void add_routes();
+
+        const node_interface * find_interface(const node_data & nd,
+                                              const std::string & id) const;
+        const node_interface read_interface_decl(std::size_t line) const;
+        std::auto_ptr<field_value>
+        attribute_value(field_value::type_id type,
+                        openvrml::local::xml_attribute & attr,
+                        std::size_t line) const;
+        std::auto_ptr<field_value>
+        parse_field_value(field_value::type_id type,
+                          const std::string & text,
+                          std::size_t line) const;
+        std::auto_ptr<field_value>
+        array_field_value(field_value::type_id type,
+                          openvrml::local::encoded_array & array,
+                          std::size_t line) const;
+    };
+
+    template <typename Reader>
+    x3d_xml_parser<Reader>::
+    x3d_xml_parser(Reader & reader,
+                   const std::string & uri,
+                   const openvrml::scene & scene,
+                   std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+                   std::map<std::string, std::string> & meta):
+        reader_(reader),
+        uri_(uri),
+        scene_(scene),
+        actions_(uri, scene, nodes, meta),
+        scene_read_(false)
+    {}
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::parse()
+    {
+        int result;
+        while ((result = this->reader_.read()) == 1) {
+            switch (this->reader_.node_type()) {
+            case Reader::element_id:
+                this->start_element(this->reader_.line_number());
+                break;
+            case Reader::end_element_id:
+                this->end_element();
+                break;
+            case Reader::text_id:
+            case Reader::cdata_id:
+                this->text();
+                break;
+            default:
+                break;
+            }
+        }
+        if (result != 0) {
+            this->error(this->reader_.line_number(),
+                        "document is not well-formed XML");
+        }
+        if (!this->scene_read_) {
+            this->error(this->reader_.line_number(), "expected a Scene");
+        }
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::error(const std::size_t line,
+                                       const std::string & message) const
+    {
+        throw openvrml::invalid_vrml(this->uri_, line, 0, message);
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::warn(const std::size_t line,
+                                      const std::string & message) const
+    {
+        std::ostringstream warning;
+        warning << this->uri_ << ':' << line << ": warning: " << message;
+        this->scene_.browser().err(warning.str());
+    }
+
+    template <typename Reader>
+    const std::string *
+    x3d_xml_parser<Reader>::attribute(const char * const name) const
+    {
+        for (attributes_t::const_iterator attr = this->attributes_.begin();
+             attr != this->attributes_.end();
+             ++attr) {
+            if (attr->name == name) { return &attr->value; }
+        }
+        return 0;
+    }
+
+    template <typename Reader>
+    openvrml::local::xml_attribute *
+    x3d_xml_parser<Reader>::find_attribute(const char * const name)
+    {
+        for (attributes_t::iterator attr = this->attributes_.begin();
+             attr != this->attributes_.end();
+             ++attr) {
+            if (attr->name == name) { return &*attr; }
+        }
+        return 0;
+    }
+
+    template <typename Reader>
+    const std::string &
+    x3d_xml_parser<Reader>::required_attribute(const char * const name,
+                                               const std::size_t line) const
+    {
+        const std::string * const value = this->attribute(name);
+        if (!value) {
+            this->error(line, "expected a " + std::string(name)
+                        + " attribute");
+        }
+        return *value;
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_element(const std::size_t line)
+    {
+        using std::string;
+
+        const string name = this->reader_.local_name();
+        const bool empty = this->reader_.is_empty_element();
+
+        read_attributes(this->reader_, this->attributes_);
+
+        const typename element::kind_id parent = this->elements_.empty()
+            ? element::ignored_id
+            : this->elements_.back().kind;
+
+        if (this->elements_.empty()) {
+            if (name != "X3D") { this->error(line, "expected X3D"); }
+            this->start_x3d(line);
+        } else if (parent == element::ignored_id) {
+            this->elements_.push_back(element(element::ignored_id, line));
+        } else if (parent == element::x3d_id) {
+            if (name == "head") {
+                this->elements_.push_back(element(element::head_id, line));
+            } else if (name == "Scene") {
+                this->start_scene(line);
+            } else {
+                this->error(line, "expected head or Scene");
+            }
+        } else if (parent == element::head_id) {
+            if (name == "component") {
+                this->start_component(line);
+            } else if (name == "meta") {
+                const string * const meta_name = this->attribute("name");
+                const string * const content = this->attribute("content");
+                if (meta_name && content) {
+                    this->actions_.on_meta_statement(*meta_name, *content);
+                }
+            }
+            this->elements_.push_back(element(element::ignored_id, line));
+        } else if (parent == element::proto_declare_id) {
+            element & proto = this->elements_.back();
+            if (proto.proto_body_read) {
+                this->error(line, "unexpected " + name + " after ProtoBody");
+            }
+            if (name == "ProtoInterface") {
+                this->elements_.push_back(
+                    element(element::proto_interface_id, line));
+            } else if (name == "ProtoBody") {
+                proto.proto_body_read = true;
+                this->actions_.on_proto_body_start();
+                this->elements_.push_back(
+                    element(element::proto_body_id, line));
+            } else {
+                this->error(line, "expected ProtoInterface or ProtoBody");
+            }
+        } else if (parent == element::proto_interface_id) {
+            if (name != "field") { this->error(line, "expected field"); }
+            this->start_proto_field(line);
+        } else if (parent == element::externproto_declare_id) {
+            if (name != "field") { this->error(line, "expected field"); }
+            this->start_externproto_field(line);
+        } else if (parent == element::is_id) {
+            if (name != "connect") { this->error(line, "expected connect"); }
+            this->start_connect(line);
+        } else if (name == "ROUTE") {
+            if (parent != element::scene_id
+                && parent != element::proto_body_id
+                && parent != element::node_id) {
+                this->error(line, "unexpected ROUTE");
+            }
+            this->start_route(line);
+        } else if (name == "ProtoDeclare") {
+            if (parent != element::scene_id
+                && parent != element::proto_body_id) {
+                this->error(line, "unexpected ProtoDeclare");
+            }
+            this->start_proto_declare(line);
+        } else if (name == "ExternProtoDeclare") {
+            if (parent != element::scene_id
+                && parent != element::proto_body_id) {
+                this->error(line, "unexpected ExternProtoDeclare");
+            }
+            this->start_externproto_declare(line);
+        } else if (name == "IMPORT" || name == "EXPORT") {
+            this->elements_.push_back(element(element::ignored_id, line));
+        } else if (name == "IS") {
+            if (parent != element::node_id) {
+                this->error(line, "unexpected IS");
+            }
+            if (this->actions_.ps.top().proto_node_type_id.empty()) {
+                this->error(line, "IS is only valid in a ProtoBody");
+            }
+            this->elements_.push_back(element(element::is_id, line));
+        } else if (name == "field" && parent == element::node_id
+                   && this->elements_.back().script) {
+            this->start_script_field(line);
+        } else if (name == "fieldValue" && parent == element::node_id
+                   && this->elements_.back().proto_instance) {
+            this->start_field_value(line);
+        } else if (parent == element::head_id
+                   || parent == element::proto_interface_id) {
+            this->error(line, "unexpected " + name);
+        } else {
+            this->start_node(name, line);
+        }
+
+        if (empty) { this->end_element(); }
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::end_element()
+    {
+        assert(!this->elements_.empty());
+        element & e = this->elements_.back();
+        switch (e.kind) {
+        case element::scene_id:
+            this->add_routes();
+            this->actions_.on_scene_finish();
+            this->scene_read_ = true;
+            break;
+        case element::node_id:
+            this->close_field(e);
+            if (e.script) {
+                const std::string source =
+                    boost::algorithm::trim_copy(e.script_source);
+                node_data & nd = this->actions_.ps.top().node_data_.top();
+                if (!source.empty()
+                    && nd.initial_values.find("url")
+                    == nd.initial_values.end()) {
+                    nd.initial_values.insert(
+                        std::make_pair("url",
+                                  boost::shared_ptr<field_value>(
+                                      new openvrml::mfstring(
+                                          std::vector<std::string>(
+                                              1, source)))));
+                }
+            }
+            this->actions_.on_node_finish();
+            break;
+        case element::script_field_id:
+            if (e.node_field_type != field_value::invalid_type_id) {
+                this->close_node_value(e.node_field_type);
+            }
+            break;
+        case element::proto_field_id:
+            if (e.default_value) {
+                this->add_routes();
+                this->close_node_value(e.node_field_type);
+                this->actions_.on_proto_default_value_finish();
+            }
+            break;
+        case element::proto_body_id:
+            if (this->actions_.ps.top().children.top().empty()) {
+                this->error(e.line, "expected a node in ProtoBody");
+            }
+            this->add_routes();
+            break;
+        case element::proto_declare_id:
+            if (!e.proto_body_read) {
+                this->error(e.line, "expected ProtoBody");
+            }
+            this->actions_.on_proto_finish();
+            break;
+        case element::externproto_declare_id:
+            this->actions_.on_externproto(e.node_type_id,
+                                          e.interfaces,
+                                          e.url);
+            break;
+        case element::field_value_id:
+            if (e.node_field_type != field_value::invalid_type_id) {
+                this->close_field(
+                    this->elements_[this->elements_.size() - 2]);
+            }
+            break;
+        default:
+            break;
+        }
+        this->elements_.pop_back();
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::text()
+    {
+        if (this->elements_.empty()) { return; }
+        element & e = this->elements_.back();
+        if (e.kind == element::node_id && e.script) {
+            e.script_source += this->reader_.value();
+        }
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_x3d(const std::size_t line)
+    {
+        const std::string * const profile_id = this->attribute("profile");
+        if (!profile_id) {
+            this->error(line, "expected a profile attribute");
+        }
+        try {
+            this->actions_.on_profile_statement(*profile_id);
+        } catch (boost::bad_ptr_container_operation &) {
+            this->error(line, "unrecognized profile \"" + *profile_id + '"');
+        }
+        this->elements_.push_back(element(element::x3d_id, line));
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_component(const std::size_t line)
+    {
+        const std::string & id = this->required_attribute("name", line);
+        const std::string * const level_str = this->attribute("level");
+        size_t level = 1;
+        if (level_str) {
+            try {
+                level = boost::lexical_cast<size_t>(
+                    boost::algorithm::trim_copy(*level_str));
+            } catch (boost::bad_lexical_cast &) {
+                this->error(line, "invalid component level");
+            }
+        }
+        try {
+            this->actions_.on_component_statement(id, openvrml::int32(level));
+        } catch (boost::bad_ptr_container_operation &) {
+            this->error(line, "unrecognized component \"" + id + '"');
+        } catch (std::invalid_argument &) {
+            this->error(line, "unsupported component level");
+        }
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_scene(const std::size_t line)
+    {
+        if (this->scene_read_) { this->error(line, "unexpected Scene"); }
+        this->elements_.push_back(element(element::scene_id, line));
+    }
+
+    //
+    // Prepare to add a node to the enclosing element: for a node element,
+    // make container_field the field that receives children.
+    //
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::
+    add_child_node(const std::string & container_field,
+                   const std::size_t line)
+    {
+        element & parent = this->elements_.back();
+        field_value::type_id type = field_value::invalid_type_id;
+        switch (parent.kind) {
+        case element::scene_id:
+        case element::proto_body_id:
+            return;
+        case element::node_id:
+            this->open_field(parent, container_field, line);
+            type = parent.node_field_type;
+            break;
+        case element::script_field_id:
+        case element::proto_field_id:
+        case element::field_value_id:
+            type = parent.node_field_type;
+            if (type == field_value::invalid_type_id) {
+                this->error(line, "field cannot contain nodes");
+            }
+            break;
+        default:
+            this->error(line, "unexpected node");
+        }
+        if (type == field_value::sfnode_id
+            && !this->actions_.ps.top().children.top().empty()) {
+            this->error(line, "SFNode field already has a value");
+        }
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::open_field(element & e,
+                                            const std::string & field_id,
+                                            const std::size_t line)
+    {
+        using openvrml::mfnode;
+        using openvrml::sfnode;
+        using openvrml::initial_value_map;
+
+        if (e.field_id == field_id) { return; }
+        this->close_field(e);
+
+        node_data & nd = this->actions_.ps.top().node_data_.top();
+        const node_interface * const interface_ =
+            this->find_interface(nd, field_id);
+        if (!interface_
+            || (interface_->type != node_interface::field_id
+                && interface_->type != node_interface::exposedfield_id)
+            || (interface_->field_type != field_value::sfnode_id
+                && interface_->field_type != field_value::mfnode_id)) {
+            this->error(line, "no SFNode or MFNode field \"" + field_id
+                        + "\" for containerField");
+        }
+
+        //
+        // Children for a field need not be contiguous; so pick up where we
+        // left off if the field already has a value.
+        //
+        typename parse_scope::children_t children;
+        const initial_value_map::iterator pos =
+            nd.initial_values.find(interface_->id);
+        if (pos != nd.initial_values.end()) {
+            if (interface_->field_type == field_value::mfnode_id) {
+                children =
+                    boost::polymorphic_downcast<mfnode *>(pos->second.get())
+                    ->value();
+            } else if (boost::polymorphic_downcast<sfnode *>(
+                           pos->second.get())->value()) {
+                this->error(line, "SFNode field already has a value");
+            }
+            nd.initial_values.erase(pos);
+        }
+        this->actions_.on_field_start(interface_->id,
+                                      interface_->field_type);
+        this->actions_.ps.top().children.top().swap(children);
+        e.field_id = interface_->id;
+        e.node_field_type = interface_->field_type;
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::close_field(element & e)
+    {
+        if (e.field_id.empty()) { return; }
+        this->close_node_value(e.node_field_type);
+        e.field_id.clear();
+        e.node_field_type = field_value::invalid_type_id;
+    }
+
+    template <typename Reader>
+    void
+    x3d_xml_parser<Reader>::close_node_value(const field_value::type_id type)
+    {
+        if (type == field_value::sfnode_id) {
+            this->actions_.on_sfnode(
+                this->actions_.ps.top().children.top().empty());
+        } else {
+            assert(type == field_value::mfnode_id);
+            this->actions_.on_mfnode();
+        }
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_node(const std::string & name,
+                                            const std::size_t line)
+    {
+        using std::string;
+
+        const bool proto_instance = (name == "ProtoInstance");
+        const string * const container_field =
+            this->attribute("containerField");
+        this->add_child_node(container_field
+                             ? *container_field
+                             : proto_instance
+                                 ? string("children")
+                                 : string(default_container_field(name)),
+                             line);
+
+        const string * const use = this->attribute("USE");
+        const string * const def = this->attribute("DEF");
+        if (use) {
+            if (def) { this->error(line, "cannot both DEF and USE a node"); }
+            this->start_use(*use, line);
+            return;
+        }
+
+        const string & node_type_id = proto_instance
+            ? this->required_attribute("name", line)
+            : name;
+        const bool script = !proto_instance && node_type_id == "Script";
+        if (!script
+            && !this->actions_.ps.top().scope->find_type(node_type_id)) {
+            this->error(line, "unknown node type \"" + node_type_id + '"');
+        }
+
+        this->actions_.on_node_start(def ? *def : string(), node_type_id);
+
+        element e(element::node_id, line);
+        e.script = script;
+        e.proto_instance = proto_instance;
+
+        node_data & nd = this->actions_.ps.top().node_data_.top();
+        for (attributes_t::iterator attr = this->attributes_.begin();
+             attr != this->attributes_.end();
+             ++attr) {
+            if (attr->name == "DEF" || attr->name == "containerField"
+                || attr->name == "class"
+                || (proto_instance && attr->name == "name")) {
+                continue;
+            }
+            const node_interface * const interface_ =
+                this->find_interface(nd, attr->name);
+            if (!interface_
+                || (interface_->type != node_interface::field_id
+                    && interface_->type != node_interface::exposedfield_id)) {
+                this->error(line, "unknown field \"" + attr->name
+                            + "\" for node type \"" + node_type_id + '"');
+            }
+            if (interface_->field_type == field_value::sfnode_id
+                || interface_->field_type == field_value::mfnode_id) {
+                this->error(line, "value of node field \"" + attr->name
+                            + "\" must be given as child elements");
+            }
+            nd.initial_values.insert(
+                std::make_pair(interface_->id,
+                               boost::shared_ptr<field_value>(
+                                   this->attribute_value(
+                                       interface_->field_type,
+                                       *attr,
+                                       line))));
+        }
+
+        this->elements_.push_back(e);
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_use(const std::string & node_name_id,
+                                           const std::size_t line)
+    {
+        parse_scope & ps = this->actions_.ps.top();
+
+        //
+        // A Script node may refer to itself.
+        //
+        openvrml::node * n = 0;
+        if (!ps.node_data_.empty()
+            && !ps.node_data_.top().type
+            && ps.node_data_.top().node_name_id == node_name_id) {
+            n = openvrml::node::self_tag.get();
+        } else {
+            n = ps.scope->find_node(node_name_id);
+        }
+        if (!n) {
+            this->error(line, "unknown node name \"" + node_name_id + '"');
+        }
+        ps.children.top().push_back(boost::intrusive_ptr<openvrml::node>(n));
+        this->elements_.push_back(element(element::ignored_id, line));
+    }
+
+    template <typename Reader>
+    const node_interface
+    x3d_xml_parser<Reader>::read_interface_decl(const std::size_t line) const
+    {
+        using std::istringstream;
+
+        node_interface interface_;
+        interface_.id = this->required_attribute("name", line);
+        {
+            istringstream in(this->required_attribute("accessType", line));
+            if (!(in >> interface_.type)) {
+                this->error(line, "invalid accessType");
+            }
+        }
+        {
+            istringstream in(this->required_attribute("type", line));
+            if (!(in >> interface_.field_type)) {
+                this->error(line, "invalid field type");
+            }
+        }
+        return interface_;
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_script_field(const std::size_t line)
+    {
+        element & script = this->elements_.back();
+        node_data & nd = this->actions_.ps.top().node_data_.top();
+
+        const node_interface interface_ = this->read_interface_decl(line);
+        if (interface_.type == node_interface::exposedfield_id) {
+            this->error(line,
+                        "Script nodes cannot have inputOutput fields");
+        }
+        if (script_interfaces.find(interface_) != script_interfaces.end()
+            || nd.script_interfaces.find(interface_)
+               != nd.script_interfaces.end()) {
+            this->error(line, "interface \"" + interface_.id
+                        + "\" conflicts with previous declaration");
+        }
+
+        this->close_field(script);
+        this->actions_.on_script_interface_decl(interface_);
+
+        element e(element::script_field_id, line);
+        openvrml::local::xml_attribute * const value =
+            this->find_attribute("value");
+        if (interface_.type == node_interface::field_id) {
+            if (interface_.field_type == field_value::sfnode_id
+                || interface_.field_type == field_value::mfnode_id) {
+                if (value) {
+                    this->error(line, "value of node field \"" + interface_.id
+                                + "\" must be given as child elements");
+                }
+                e.node_field_type = interface_.field_type;
+            } else if (value) {
+                nd.current_field_value->second->assign(
+                    *this->attribute_value(interface_.field_type,
+                                           *value,
+                                           line));
+            }
+        } else if (value) {
+            this->error(line, "inputOnly and outputOnly fields cannot have "
+                        "a value");
+        }
+        this->elements_.push_back(e);
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_field_value(const std::size_t line)
+    {
+        element & instance = this->elements_.back();
+        node_data & nd = this->actions_.ps.top().node_data_.top();
+
+        const std::string & id = this->required_attribute("name", line);
+        const node_interface * const interface_ =
+            this->find_interface(nd, id);
+        if (!interface_
+            || (interface_->type != node_interface::field_id
+                && interface_->type != node_interface::exposedfield_id)) {
+            this->error(line, "unknown field \"" + id + "\" for node type \""
+                        + nd.type->id() + '"');
+        }
+
+        element e(element::field_value_id, line);
+        if (interface_->field_type == field_value::sfnode_id
+            || interface_->field_type == field_value::mfnode_id) {
+            this->open_field(instance, interface_->id, line);
+            e.node_field_type = interface_->field_type;
+        } else {
+            if (instance.field_id == interface_->id) {
+                this->close_field(instance);
+            }
+            openvrml::local::xml_attribute * const value =
+                this->find_attribute("value");
+            if (value) {
+                nd.initial_values.erase(interface_->id);
+                nd.initial_values.insert(
+                    std::make_pair(interface_->id,
+                                   boost::shared_ptr<field_value>(
+                                       this->attribute_value(
+                                           interface_->field_type,
+                                           *value,
+                                           line))));
+            }
+        }
+        this->elements_.push_back(e);
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_proto_declare(const std::size_t line)
+    {
+        const std::string & id = this->required_attribute("name", line);
+        if (this->actions_.ps.top().scope->find_type(id)) {
+            this->error(line, "node type \"" + id + "\" already exists");
+        }
+        this->actions_.on_proto_start(id);
+        this->elements_.push_back(element(element::proto_declare_id, line));
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_proto_field(const std::size_t line)
+    {
+        const node_interface interface_ = this->read_interface_decl(line);
+        parse_scope & ps = this->actions_.ps.top();
+        if (ps.proto_interfaces.find(interface_)
+            != ps.proto_interfaces.end()) {
+            this->error(line, "interface \"" + interface_.id
+                        + "\" conflicts with previous declaration");
+        }
+        this->actions_.on_proto_interface(interface_);
+
+        element e(element::proto_field_id, line);
+        openvrml::local::xml_attribute * const value =
+            this->find_attribute("value");
+        if (interface_.type == node_interface::field_id
+            || interface_.type == node_interface::exposedfield_id) {
+            if (interface_.field_type == field_value::sfnode_id
+                || interface_.field_type == field_value::mfnode_id) {
+                if (value) {
+                    this->error(line, "value of node field \"" + interface_.id
+                                + "\" must be given as child elements");
+                }
+                if (!this->reader_.is_empty_element()) {
+                    this->actions_.on_proto_default_value_start();
+                    e.node_field_type = interface_.field_type;
+                    e.default_value = true;
+                }
+            } else if (value) {
+                ps.node_data_.top().current_field_value->second->assign(
+                    *this->attribute_value(interface_.field_type,
+                                           *value,
+                                           line));
+            }
+        } else if (value) {
+            this->error(line, "inputOnly and outputOnly fields cannot have "
+                        "a value");
+        }
+        this->elements_.push_back(e);
+    }
+
+    template <typename Reader>
+    void
+    x3d_xml_parser<Reader>::start_externproto_declare(const std::size_t line)
+    {
+        element e(element::externproto_declare_id, line);
+        e.node_type_id = this->required_attribute("name", line);
+        if (this->actions_.ps.top().scope->find_type(e.node_type_id)) {
+            this->error(line, "node type \"" + e.node_type_id
+                        + "\" already exists");
+        }
+        if (!parse_strings(this->required_attribute("url", line), e.url)) {
+            this->error(line, "invalid MFString value");
+        }
+        this->elements_.push_back(e);
+    }
+
+    template <typename Reader>
+    void
+    x3d_xml_parser<Reader>::start_externproto_field(const std::size_t line)
+    {
+        element & externproto = this->elements_.back();
+        const node_interface interface_ = this->read_interface_decl(line);
+        if (!externproto.interfaces.insert(interface_).second) {
+            this->error(line, "interface \"" + interface_.id
+                        + "\" conflicts with previous declaration");
+        }
+        this->elements_.push_back(element(element::ignored_id, line));
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_connect(const std::size_t line)
+    {
+        element & node_element = this->elements_[this->elements_.size() - 2];
+        parse_scope & ps = this->actions_.ps.top();
+        node_data & nd = ps.node_data_.top();
+
+        const std::string & node_field =
+            this->required_attribute("nodeField", line);
+        const std::string & proto_field =
+            this->required_attribute("protoField", line);
+
+        const node_interface * const impl_interface =
+            this->find_interface(nd, node_field);
+        if (!impl_interface) {
+            this->error(line, "unknown field \"" + node_field + '"');
+        }
+        const node_interface_set::const_iterator proto_interface =
+            openvrml::find_interface(ps.proto_interfaces, proto_field);
+        if (proto_interface == ps.proto_interfaces.end()) {
+            this->error(line, "unknown ProtoInterface field \""
+                        + proto_field + '"');
+        }
+
+        //
+        // An exposedField in the PROTO implementation can be IS'd to any
+        // type of interface; otherwise the interface types must agree.  See
+        // 4.8.3; particularly table 4.4.
+        //
+        if (proto_interface->field_type != impl_interface->field_type
+            || (impl_interface->type != node_interface::exposedfield_id
+                && proto_interface->type != impl_interface->type)) {
+            this->error(line, openvrml::vrml97_parse_error_msg(
+                            openvrml::incompatible_proto_interface));
+        }
+
+        if (node_element.field_id == impl_interface->id) {
+            this->close_field(node_element);
+        }
+        nd.is_map.insert(std::make_pair(impl_interface->id,
+                                        proto_interface->id));
+
+        //
+        // Script nodes keep the value for the interface declaration.
+        //
+        if (nd.type) { nd.initial_values.erase(impl_interface->id); }
+
+        this->elements_.push_back(element(element::ignored_id, line));
+    }
+
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::start_route(const std::size_t line)
+    {
+        route r;
+        r.from = this->required_attribute("fromNode", line);
+        r.eventout = this->required_attribute("fromField", line);
+        r.to = this->required_attribute("toNode", line);
+        r.eventin = this->required_attribute("toField", line);
+        r.line = line;
+        r.depth = this->actions_.ps.size();
+        this->routes_.push_back(r);
+        this->elements_.push_back(element(element::ignored_id, line));
+    }
+
+    //
+    // ROUTEs are checked and handed to the parse actions when the scope
+    // they were declared in ends, at which point every node they may refer
+    // to has been created.
+    //
+    template <typename Reader>
+    void x3d_xml_parser<Reader>::add_routes()
+    {
+        using std::bind2nd;
+        using std::find_if;
+        using openvrml::node_interface_matches_eventin;
+        using openvrml::node_interface_matches_eventout;
+
+        const std::size_t depth = this->actions_.ps.size();
+        typename std::vector<route>::iterator first = this->routes_.end();
+        while (first != this->routes_.begin()
+               && boost::prior(first)->depth == depth) {
+            --first;
+        }
+
+        const openvrml::scope & scope = *this->actions_.ps.top().scope;
+        for (typename std::vector<route>::const_iterator r = first;
+             r != this->routes_.end();
+             ++r) {
+            openvrml::node * const from = scope.find_node(r->from);
+            if (!from) {
+                this->error(r->line, "unknown node name \"" + r->from + '"');
+            }
+            openvrml::node * const to = scope.find_node(r->to);
+            if (!to) {
+                this->error(r->line, "unknown node name \"" + r->to + '"');
+            }
+            const node_interface_set & from_interfaces =
+                from->type().interfaces();
+            const node_interface_set::const_iterator eventout =
+                find_if(from_interfaces.begin(), from_interfaces.end(),
+                        bind2nd(node_interface_matches_eventout(),
+                                r->eventout));
+            if (eventout == from_interfaces.end()) {
+                this->error(r->line, "no outputOnly or inputOutput field \""
+                            + r->eventout + "\" for node \"" + r->from
+                            + '"');
+            }
+            const node_interface_set & to_interfaces =
+                to->type().interfaces();
+            const node_interface_set::const_iterator eventin =
+                find_if(to_interfaces.begin(), to_interfaces.end(),
+                        bind2nd(node_interface_matches_eventin(),
+                                r->eventin));
+            if (eventin == to_interfaces.end()) {
+                this->error(r->line, "no inputOnly or inputOutput field \""
+                            + r->eventin + "\" for node \"" + r->to + '"');
+            }
+            if (eventout->field_type != eventin->field_type) {
+                this->error(r->line, openvrml::vrml97_parse_error_msg(
+                                openvrml::event_value_type_mismatch));
+            }
+            this->actions_.on_route(r->from, *eventout, r->to, *eventin);
+        }
+        this->routes_.erase(first, this->routes_.end());
+    }
+
+    template <typename Reader>
+    const node_interface *
+    x3d_xml_parser<Reader>::find_interface(const node_data & nd,
+                                           const std::string & id) const
+    {
+        const node_interface_set & interfaces = nd.type
+            ? nd.type->interfaces()
+            : script_interfaces;
+        node_interface_set::const_iterator pos =
+            openvrml::find_interface(interfaces, id);
+        if (pos != interfaces.end()) { return &*pos; }
+        if (!nd.type) {
+            pos = openvrml::find_interface(nd.script_interfaces, id);
+            if (pos != nd.script_interfaces.end()) { return &*pos; }
+        }
+        return 0;
+    }
+
+    template <typename Reader>
+    std::auto_ptr<field_value>
+    x3d_xml_parser<Reader>::
+    attribute_value(const field_value::type_id type,
+                    openvrml::local::xml_attribute & attr,
+                    const std::size_t line) const
+    {
+        return (attr.array.kind == openvrml::local::encoded_array::none_id)
+            ? this->parse_field_value(type, attr.value, line)
+            : this->array_field_value(type, attr.array, line);
+    }
+
+    template <typename Reader>
+    std::auto_ptr<field_value>
+    x3d_xml_parser<Reader>::parse_field_value(const field_value::type_id type,
+                                              const std::string & text,
+                                              const std::size_t line) const
+    {
+        using std::vector;
+        using boost::spirit::classic::real_p;
+        using namespace openvrml;
+        namespace mf_bulk = openvrml::mf_bulk;
+
+        std::auto_ptr<field_value> result;
+        bool succeeded = false;
+        bool normalized = true;
+        switch (type) {
+        case field_value::sfbool_id:
+        {
+            bool val = false;
+            succeeded = parse_value(text, xml_bool_p, val);
+            result.reset(new sfbool(val));
+        }
+            break;
+        case field_value::sfcolor_id:
+        {
+            color val = make_color();
+            succeeded = parse_value(text, color_p, val);
+            result.reset(new sfcolor(val));
+        }
+            break;
+        case field_value::sfcolorrgba_id:
+        {
+            color_rgba val = make_color_rgba();
+            succeeded = parse_value(text, color_rgba_p, val);
+            result.reset(new sfcolorrgba(val));
+        }
+            break;
+        case field_value::sffloat_id:
+        {
+            float val = 0.0f;
+            succeeded = parse_value(text, float_p, val);
+            result.reset(new sffloat(val));
+        }
+            break;
+        case field_value::sfdouble_id:
+        {
+            double val = 0.0;
+            succeeded = parse_value(text, real_p, val);
+            result.reset(new sfdouble(val));
+        }
+            break;
+        case field_value::sfimage_id:
+        {
+            image val;
+            succeeded = parse_value(text, image_p, val);
+            result.reset(new sfimage(val));
+        }
+            break;
+        case field_value::sfint32_id:
+        {
+            int32 val = 0;
+            succeeded = parse_value(text, int32_p, val);
+            result.reset(new sfint32(val));
+        }
+            break;
+        case field_value::sfrotation_id:
+        {
+            rotation val = make_rotation();
+            succeeded = parse_value(text, xml_rotation_p, val);
+            normalized = local::fequal(1.0f, val.axis().length());
+            result.reset(new sfrotation(val));
+        }
+            break;
+        case field_value::sfstring_id:
+            succeeded = true;
+            result.reset(new sfstring(text));
+            break;
+        case field_value::sftime_id:
+        {
+            double val = 0.0;
+            succeeded = parse_value(text, real_p, val);
+            result.reset(new sftime(val));
+        }
+            break;
+        case field_value::sfvec2f_id:
+        {
+            vec2f val = make_vec2f();
+            succeeded = parse_value(text, vec2f_p, val);
+            result.reset(new sfvec2f(val));
+        }
+            break;
+        case field_value::sfvec2d_id:
+        {
+            vec2d val = make_vec2d();
+            succeeded = parse_value(text, vec2d_p, val);
+            result.reset(new sfvec2d(val));
+        }
+            break;
+        case field_value::sfvec3f_id:
+        {
+            vec3f val = make_vec3f();
+            succeeded = parse_value(text, vec3f_p, val);
+            result.reset(new sfvec3f(val));
+        }
+            break;
+        case field_value::sfvec3d_id:
+        {
+            vec3d val = make_vec3d();
+            succeeded = parse_value(text, vec3d_p, val);
+            result.reset(new sfvec3d(val));
+        }
+            break;
+        case field_value::mfbool_id:
+        {
+            vector<bool> val;
+            succeeded = parse_values(text, xml_bool_p, val);
+            result.reset(new mfbool(val));
+        }
+            break;
+        case field_value::mfcolor_id:
+        {
+            vector<color> val;
+            succeeded = parse_values(text, color_p, val);
+            result.reset(new mfcolor(val));
+        }
+            break;
+        case field_value::mfcolorrgba_id:
+        {
+            vector<color_rgba> val;
+            succeeded = parse_values(text, color_rgba_p, val);
+            result.reset(new mfcolorrgba(val));
+        }
+            break;
+        case field_value::mffloat_id:
+        {
+            vector<float> val;
+            succeeded = parse_bulk<mf_bulk::float_element>(text, val);
+            result.reset(new mffloat(val));
+        }
+            break;
+        case field_value::mfdouble_id:
+        {
+            vector<double> val;
+            succeeded = parse_values(text, real_p, val);
+            result.reset(new mfdouble(val));
+        }
+            break;
+        case field_value::mfimage_id:
+        {
+            vector<image> val;
+            succeeded = parse_values(text, image_p, val);
+            result.reset(new mfimage(val));
+        }
+            break;
+        case field_value::mfint32_id:
+        {
+            vector<int32> val;
+            succeeded = parse_bulk<mf_bulk::int32_element>(text, val);
+            result.reset(new mfint32(val));
+        }
+            break;
+        case field_value::mfrotation_id:
+        {
+            vector<rotation> val;
+            succeeded = parse_values(text, xml_rotation_p, val);
+            for (vector<rotation>::const_iterator r = val.begin();
+                 r != val.end();
+                 ++r) {
+                normalized = normalized
+                    && local::fequal(1.0f, r->axis().length());
+            }
+            result.reset(new mfrotation(val));
+        }
+            break;
+        case field_value::mfstring_id:
+        {
+            vector<std::string> val;
+            succeeded = parse_strings(text, val);
+            result.reset(new mfstring(val));
+        }
+            break;
+        case field_value::mftime_id:
+        {
+            vector<double> val;
+            succeeded = parse_values(text, real_p, val);
+            result.reset(new mftime(val));
+        }
+            break;
+        case field_value::mfvec2f_id:
+        {
+            vector<vec2f> val;
+            succeeded =
+                parse_bulk<mf_bulk::vec_element<vec2f, 2> >(text, val);
+            result.reset(new mfvec2f(val));
+        }
+            break;
+        case field_value::mfvec2d_id:
+        {
+            vector<vec2d> val;
+            succeeded = parse_values(text, vec2d_p, val);
+            result.reset(new mfvec2d(val));
+        }
+            break;
+        case field_value::mfvec3f_id:
+        {
+            vector<vec3f> val;
+            succeeded =
+                parse_bulk<mf_bulk::vec_element<vec3f, 3> >(text, val);
+            result.reset(new mfvec3f(val));
+        }
+            break;
+        case field_value::mfvec3d_id:
+        {
+            vector<vec3d> val;
+            succeeded = parse_values(text, vec3d_p, val);
+            result.reset(new mfvec3d(val));
+        }
+            break;
+        default:
+            assert(false);
+        }
+
+        if (!succeeded) {
+            std::ostringstream msg;
+            msg << "invalid " << type << " value";
+            this->error(line, msg.str());
+        }
+        if (!normalized) {
+            this->warn(line, vrml97_parse_error_msg(
+                           rotation_axis_not_normalized));
+        }
+        return result;
+    }
+
+    //
+    // Group the decoded numbers of an encoded array into N-component values.
+    //
+    template <typename Value, typename Component, std::size_t N,
+              typename Source>
+    OPENVRML_LOCAL bool
+    group_components(const std::vector<Source> & source,
+                     const Value (*make)(const Component (&)[N]),
+                     std::vector<Value> & result)
+    {
+        if (source.size() % N != 0) { return false; }
+        result.reserve(source.size() / N);
+        Component c[N];
+        for (std::size_t i = 0; i < source.size(); i += N) {
+            for (std::size_t j = 0; j < N; ++j) {
+                c[j] = static_cast<Component>(source[i + j]);
+            }
+            result.push_back(make(c));
+        }
+        return true;
+    }
+
+    template <typename Value, typename Component, std::size_t N>
+    OPENVRML_LOCAL bool
+    group_components(const openvrml::local::encoded_array & array,
+                     const Value (*make)(const Component (&)[N]),
+                     std::vector<Value> & result)
+    {
+        using openvrml::local::encoded_array;
+        switch (array.kind) {
+        case encoded_array::float_id:
+            return group_components(array.floats, make, result);
+        case encoded_array::double_id:
+            return group_components(array.doubles, make, result);
+        default:
+            return false;
+        }
+    }
+
+    template <typename Value, typename Component, std::size_t N>
+    OPENVRML_LOCAL bool
+    single_value(const openvrml::local::encoded_array & array,
+                 const Value (*make)(const Component (&)[N]),
+                 Value & result)
+    {
+        std::vector<Value> values;
+        if (!group_components(array, make, values) || values.size() != 1) {
+            return false;
+        }
+        result = values.front();
+        return true;
+    }
+
+    OPENVRML_LOCAL const float make_float(const float (&f)[1])
+    {
+        return f[0];
+    }
+
+    OPENVRML_LOCAL const double make_double(const double (&d)[1])
+    {
+        return d[0];
+    }
+
+    //
+    // Convert an attribute value decoded by a binary encoding algorithm
+    // directly to a field value, without a round trip through text.
+    //
+    template <typename Reader>
+    std::auto_ptr<field_value>
+    x3d_xml_parser<Reader>::
+    array_field_value(const field_value::type_id type,
+                      openvrml::local::encoded_array & array,
+                      const std::size_t line) const
+    {
+        using std::vector;
+        using namespace openvrml;
+        using openvrml::local::encoded_array;
+
+        std::auto_ptr<field_value> result;
+        bool succeeded = false;
+        bool normalized = true;
+        switch (type) {
+        case field_value::sfbool_id:
+            succeeded = array.kind == encoded_array::bool_id
+                && array.bools.size() == 1;
+            if (succeeded) { result.reset(new sfbool(array.bools.front())); }
+            break;
+        case field_value::sfint32_id:
+            succeeded = array.kind == encoded_array::int32_id
+                && array.int32s.size() == 1;
+            if (succeeded) {
+                result.reset(new sfint32(array.int32s.front()));
+            }
+            break;
+        case field_value::sffloat_id:
+        {
+            float val = 0.0f;
+            succeeded = single_value(array, &make_float, val);
+            result.reset(new sffloat(val));
+        }
+            break;
+        case field_value::sfdouble_id:
+        {
+            double val = 0.0;
+            succeeded = single_value(array, &make_double, val);
+            result.reset(new sfdouble(val));
+        }
+            break;
+        case field_value::sftime_id:
+        {
+            double val = 0.0;
+            succeeded = single_value(array, &make_double, val);
+            result.reset(new sftime(val));
+        }
+            break;
+        case field_value::sfcolor_id:
+        {
+            color val = make_color();
+            succeeded = single_value(array, &make_color, val);
+            result.reset(new sfcolor(val));
+        }
+            break;
+        case field_value::sfcolorrgba_id:
+        {
+            color_rgba val = make_color_rgba();
+            succeeded = single_value(array, &make_color_rgba, val);
+            result.reset(new sfcolorrgba(val));
+        }
+            break;
+        case field_value::sfrotation_id:
+        {
+            rotation val = make_rotation();
+            succeeded = single_value(array, &make_rotation, val);
+            normalized = local::fequal(1.0f, val.axis().length());
+            result.reset(new sfrotation(val));
+        }
+            break;
+        case field_value::sfvec2f_id:
+        {
+            vec2f val = make_vec2f();
+            succeeded = single_value(array, &make_vec2f, val);
+            result.reset(new sfvec2f(val));
+        }
+            break;
+        case field_value::sfvec2d_id:
+        {
+            vec2d val = make_vec2d();
+            succeeded = single_value(array, &make_vec2d, val);
+            result.reset(new sfvec2d(val));
+        }
+            break;
+        case field_value::sfvec3f_id:
+        {
+            vec3f val = make_vec3f();
+            succeeded = single_value(array, &make_vec3f, val);
+            result.reset(new sfvec3f(val));
+        }
+            break;
+        case field_value::sfvec3d_id:
+        {
+            vec3d val = make_vec3d();
+            succeeded = single_value(array, &make_vec3d, val);
+            result.reset(new sfvec3d(val));
+        }
+            break;
+        case field_value::mfbool_id:
+            succeeded = array.kind == encoded_array::bool_id;
+            result.reset(new mfbool(array.bools));
+            break;
+        case field_value::mfint32_id:
+            succeeded = array.kind == encoded_array::int32_id;
+            result.reset(new mfint32(array.int32s));
+            break;
+        case field_value::mffloat_id:
+            if (array.kind == encoded_array::float_id) {
+                succeeded = true;
+                result.reset(new mffloat(array.floats));
+            } else {
+                vector<float> val;
+                succeeded = group_components(array, &make_float, val);
+                result.reset(new mffloat(val));
+            }
+            break;
+        case field_value::mfdouble_id:
+        {
+            vector<double> val;
+            succeeded = group_components(array, &make_double, val);
+            result.reset(new mfdouble(val));
+        }
+            break;
+        case field_value::mftime_id:
+        {
+            vector<double> val;
+            succeeded = group_components(array, &make_double, val);
+            result.reset(new mftime(val));
+        }
+            break;
+        case field_value::mfcolor_id:
+        {
+            vector<color> val;
+            succeeded = group_components(array, &make_color, val);
+            result.reset(new mfcolor(val));
+        }
+            break;
+        case field_value::mfcolorrgba_id:
+        {
+            vector<color_rgba> val;
+            succeeded = group_components(array, &make_color_rgba, val);
+            result.reset(new mfcolorrgba(val));
+        }
+            break;
+        case field_value::mfrotation_id:
+        {
+            vector<rotation> val;
+            succeeded = group_components(array, &make_rotation, val);
+            for (vector<rotation>::const_iterator r = val.begin();
+                 r != val.end();
+                 ++r) {
+                normalized = normalized
+                    && local::fequal(1.0f, r->axis().length());
+            }
+            result.reset(new mfrotation(val));
+        }
+            break;
+        case field_value::mfvec2f_id:
+        {
+            vector<vec2f> val;
+            succeeded = group_components(array, &make_vec2f, val);
+            result.reset(new mfvec2f(val));
+        }
+            break;
+        case field_value::mfvec2d_id:
+        {
+            vector<vec2d> val;
+            succeeded = group_components(array, &make_vec2d, val);
+            result.reset(new mfvec2d(val));
+        }
+            break;
+        case field_value::mfvec3f_id:
+        {
+            vector<vec3f> val;
+            succeeded = group_components(array, &make_vec3f, val);
+            result.reset(new mfvec3f(val));
+        }
+            break;
+        case field_value::mfvec3d_id:
+        {
+            vector<vec3d> val;
+            succeeded = group_components(array, &make_vec3d, val);
+            result.reset(new mfvec3d(val));
+        }
+            break;
+        default:
+            break;
+        }
+
+        if (!succeeded) {
+            std::ostringstream msg;
+            msg << "encoded value does not match field type " << type;
+            this->error(line, msg.str());
+        }
+        if (!normalized) {
+            this->warn(line, vrml97_parse_error_msg(
+                           rotation_axis_not_normalized));
+        }
+        return result;
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Parse the X3D XML encoding.
+ *
+ * The document is read with a streaming @c xml_reader; no document tree is
+ * built.  Nodes are created with the same parse actions used for the
+ * classic VRML encoding as their elements end.
+ *
+ * Diagnostics carry a line number but no column.
+ *
+ * @param[in]  begin    the beginning of the data.
+ * @param[in]  end      the end of the data.
+ * @param[in]  uri      URI associated with the data.
+ * @param[in]  scene    a @c scene.
+ * @param[out] nodes    the root @c node%s.
+ * @param[out] meta     the @c scene metadata.
+ *
+ * @exception openvrml::invalid_vrml    if the data is not well-formed XML
+ *                                      or is not a valid X3D scene.
+ * @exception std::bad_alloc            if memory allocation fails.
+ */
+void
+openvrml::local::
+parse_x3d_xml(const char * const begin,
+              const char * const end,
+              const std::string & uri,
+              const openvrml::scene & scene,
+              std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+              std::map<std::string, std::string> & meta)
+{
+    std::auto_ptr<xml_reader> reader;
+    try {
+        reader.reset(new xml_reader(begin, end - begin, uri));
+    } catch (std::runtime_error & ex) {
+        throw openvrml::invalid_vrml(uri, 0, 0, ex.what());
+    }
+    x3d_xml_parser<xml_reader> parser(*reader, uri, scene, nodes, meta);
+    parser.parse();
+}
+
+/**
+ * @internal
+ *
+ * @brief Parse the X3D compressed binary encoding.
+ *
+ * The compressed binary encoding is a Fast Infoset serialization of the X3D
+ * XML encoding; the document structure is interpreted exactly as for
+ * @c parse_x3d_xml.  Numeric arrays encoded with an encoding algorithm are
+ * converted directly to field values.
+ *
+ * Diagnostics carry the ordinal of the element being read in place of a
+ * line number.
+ *
+ * @param[in]  begin    the beginning of the data.
+ * @param[in]  end      the end of the data.
+ * @param[in]  uri      URI associated with the data.
+ * @param[in]  scene    a @c scene.
+ * @param[out] nodes    the root @c node%s.
+ * @param[out] meta     the @c scene metadata.
+ *
+ * @exception openvrml::invalid_vrml    if the data is not a valid Fast
+ *                                      Infoset document or is not a valid
+ *                                      X3D scene.
+ * @exception std::bad_alloc            if memory allocation fails.
+ */
+void
+openvrml::local::
+parse_x3d_fast_infoset(
+    const char * const begin,
+    const char * const end,
+    const std::string & uri,
+    const openvrml::scene & scene,
+    std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+    std::map<std::string, std::string> & meta)
+{
+    std::auto_ptr<fast_infoset_reader> reader;
+    try {
+        reader.reset(new fast_infoset_reader(begin, end - begin));
+    } catch (std::runtime_error & ex) {
+        throw openvrml::invalid_vrml(uri, 0, 0, ex.what());
+    }
+    x3d_xml_parser<fast_infoset_reader> parser(*reader,
+                                               uri,
+                                               scene,
+                                               nodes,
+                                               meta);
+    try {
+        parser.parse();
+    } catch (openvrml::invalid_vrml &) {
+        throw;
+    } catch (std::runtime_error & ex) {
+        throw openvrml::invalid_vrml(uri, reader->line_number(), 0,
+                                     ex.what());
+    }
+}
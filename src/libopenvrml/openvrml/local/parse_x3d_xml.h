@@ -0,0 +1,49 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_PARSE_X3D_XML_H
+#   define OPENVRML_LOCAL_PARSE_X3D_XML_H
+
+#   include <openvrml/scene.h>
+
+namespace openvrml {
+
+    namespace local {
+
+        OPENVRML_LOCAL
+        void parse_x3d_xml(const char * begin,
+                           const char * end,
+                           const std::string & uri,
+                           const openvrml::scene & scene,
+                           std::vector<boost::intrusive_ptr<node> > & nodes,
+                           std::map<std::string, std::string> & meta);
+
+        OPENVRML_LOCAL
+        void parse_x3d_fast_infoset(
+            const char * begin,
+            const char * end,
+            const std::string & uri,
+            const openvrml::scene & scene,
+            std::vector<boost::intrusive_ptr<node> > & nodes,
+            std::map<std::string, std::string> & meta);
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_PARSE_X3D_XML_H
@@ -0,0 +1,1503 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "pick_engine.h"
+# include <openvrml/compiled_mesh.h>
+# include <openvrml/node.h>
+# include <openvrml/viewer.h>
+# include <algorithm>
+# include <cmath>
+# include <cstring>
+# include <limits>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    using openvrml::vec3f;
+    using openvrml::vec2f;
+    using openvrml::mat4f;
+    using openvrml::local::pick_bvh_node;
+    using openvrml::local::pick_mesh;
+
+    //
+    // Leaves hold at most this many primitives.
+    //
+    const std::size_t leaf_size = 4;
+
+    //
+    // Facets around the axis of a Cone, Cylinder, or Sphere; and rows from
+    // pole to pole of a Sphere.
+    //
+    const std::size_t facets = 24;
+    const std::size_t rows = 12;
+
+    const float pi = 3.14159265358979323846f;
+
+    //
+    // Order primitives by the center of their boxes along one axis.
+    //
+    class OPENVRML_LOCAL center_less {
+        const std::vector<vec3f> & minimum_;
+        const std::vector<vec3f> & maximum_;
+        const std::size_t axis_;
+
+    public:
+        center_less(const std::vector<vec3f> & minimum,
+                    const std::vector<vec3f> & maximum,
+                    const std::size_t axis):
+            minimum_(minimum),
+            maximum_(maximum),
+            axis_(axis)
+        {}
+
+        bool operator()(const std::size_t lhs, const std::size_t rhs) const
+        {
+            return this->minimum_[lhs][this->axis_]
+                + this->maximum_[lhs][this->axis_]
+                < this->minimum_[rhs][this->axis_]
+                + this->maximum_[rhs][this->axis_];
+        }
+    };
+
+    //
+    // Build the hierarchy over the primitives order[begin, end) at
+    // nodes[index].  A node with a nonzero count is a leaf holding
+    // order[first, first + count); otherwise its children are at
+    // nodes[first] and nodes[first + 1].
+    //
+    OPENVRML_LOCAL void build_bvh(const std::vector<vec3f> & minimum,
+                                  const std::vector<vec3f> & maximum,
+                                  std::vector<std::size_t> & order,
+                                  std::vector<pick_bvh_node> & nodes,
+                                  const std::size_t index,
+                                  const std::size_t begin,
+                                  const std::size_t end)
+    {
+        vec3f lo = minimum[order[begin]], hi = maximum[order[begin]];
+        vec3f center_lo, center_hi;
+        for (std::size_t i = begin; i < end; ++i) {
+            const vec3f & min = minimum[order[i]];
+            const vec3f & max = maximum[order[i]];
+            for (std::size_t axis = 0; axis < 3; ++axis) {
+                const float center = min[axis] + max[axis];
+                if (i == begin) {
+                    center_lo.vec[axis] = center_hi.vec[axis] = center;
+                }
+                lo.vec[axis] = std::min(lo[axis], min[axis]);
+                hi.vec[axis] = std::max(hi[axis], max[axis]);
+                center_lo.vec[axis] = std::min(center_lo[axis], center);
+                center_hi.vec[axis] = std::max(center_hi[axis], center);
+            }
+        }
+        nodes[index].minimum = lo;
+        nodes[index].maximum = hi;
+
+        if (end - begin <= leaf_size) {
+            nodes[index].first = begin;
+            nodes[index].count = end - begin;
+            return;
+        }
+
+        std::size_t axis = 0;
+        for (std::size_t i = 1; i < 3; ++i) {
+            if (center_hi[i] - center_lo[i]
+                > center_hi[axis] - center_lo[axis]) {
+                axis = i;
+            }
+        }
+        const std::size_t middle = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin,
+                         order.begin() + middle,
+                         order.begin() + end,
+                         center_less(minimum, maximum, axis));
+
+        const std::size_t children = nodes.size();
+        nodes.resize(children + 2);
+        nodes[index].first = children;
+        nodes[index].count = 0;
+        build_bvh(minimum, maximum, order, nodes, children, begin, middle);
+        build_bvh(minimum, maximum, order, nodes, children + 1, middle, end);
+    }
+
+    OPENVRML_LOCAL void build_bvh(const std::vector<vec3f> & minimum,
+                                  const std::vector<vec3f> & maximum,
+                                  std::vector<std::size_t> & order,
+                                  std::vector<pick_bvh_node> & nodes)
+    {
+        order.resize(minimum.size());
+        for (std::size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+        nodes.clear();
+        if (order.empty()) { return; }
+        nodes.reserve(2 * (order.size() / leaf_size + 1));
+        nodes.resize(1);
+        build_bvh(minimum, maximum, order, nodes, 0, 0, order.size());
+    }
+
+    //
+    // Intersect the ray origin + t * direction with a box; t_max is the
+    // nearest hit found so far.
+    //
+    OPENVRML_LOCAL inline bool hits_box(const float (&origin)[3],
+                                        const float (&inverse)[3],
+                                        const pick_bvh_node & n,
+                                        const float t_max)
+    {
+        float t0 = 0.0f, t1 = t_max;
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            float enter = (n.minimum[axis] - origin[axis]) * inverse[axis];
+            float leave = (n.maximum[axis] - origin[axis]) * inverse[axis];
+            if (enter > leave) { std::swap(enter, leave); }
+            if (enter > t0) { t0 = enter; }
+            if (leave < t1) { t1 = leave; }
+            if (t0 > t1) { return false; }
+        }
+        return true;
+    }
+
+    OPENVRML_LOCAL inline bool overlaps(const pick_bvh_node & n,
+                                        const vec3f & minimum,
+                                        const vec3f & maximum)
+    {
+        return n.minimum.x() <= maximum.x() && minimum.x() <= n.maximum.x()
+            && n.minimum.y() <= maximum.y() && minimum.y() <= n.maximum.y()
+            && n.minimum.z() <= maximum.z() && minimum.z() <= n.maximum.z();
+    }
+
+    //
+    // The box around the box minimum, maximum transformed by m.
+    //
+    OPENVRML_LOCAL void transform_box(const vec3f & minimum,
+                                      const vec3f & maximum,
+                                      const mat4f & m,
+                                      vec3f & result_minimum,
+                                      vec3f & result_maximum)
+    {
+        using openvrml::make_vec3f;
+        for (std::size_t corner = 0; corner < 8; ++corner) {
+            const vec3f p =
+                make_vec3f((corner & 1) ? maximum.x() : minimum.x(),
+                           (corner & 2) ? maximum.y() : minimum.y(),
+                           (corner & 4) ? maximum.z() : minimum.z()) * m;
+            if (corner == 0) { result_minimum = result_maximum = p; }
+            for (std::size_t axis = 0; axis < 3; ++axis) {
+                result_minimum.vec[axis] =
+                    std::min(result_minimum[axis], p[axis]);
+                result_maximum.vec[axis] =
+                    std::max(result_maximum[axis], p[axis]);
+            }
+        }
+    }
+
+    OPENVRML_LOCAL inline void reciprocal(const vec3f & direction,
+                                          float (&inverse)[3])
+    {
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            inverse[axis] = (direction[axis] != 0.0f)
+                ? 1.0f / direction[axis]
+                : std::numeric_limits<float>::max();
+        }
+    }
+
+    OPENVRML_LOCAL void add_vertex(pick_mesh & mesh,
+                                   const float x, const float y,
+                                   const float z,
+                                   const float nx, const float ny,
+                                   const float nz,
+                                   const float s, const float t)
+    {
+        using openvrml::make_vec3f;
+        using openvrml::make_vec2f;
+        mesh.coord.push_back(make_vec3f(x, y, z));
+        mesh.normal.push_back(make_vec3f(nx, ny, nz));
+        mesh.tex_coord.push_back(make_vec2f(s, t));
+    }
+
+    OPENVRML_LOCAL void add_triangle(pick_mesh & mesh,
+                                     const std::size_t a,
+                                     const std::size_t b,
+                                     const std::size_t c)
+    {
+        mesh.index.push_back(a);
+        mesh.index.push_back(b);
+        mesh.index.push_back(c);
+    }
+
+    //
+    // Two triangles for the quad a, b, d, c, counterclockwise; a and b
+    // along the bottom edge.
+    //
+    OPENVRML_LOCAL void add_quad(pick_mesh & mesh,
+                                 const std::size_t a,
+                                 const std::size_t b,
+                                 const std::size_t c,
+                                 const std::size_t d)
+    {
+        add_triangle(mesh, a, b, c);
+        add_triangle(mesh, b, d, c);
+    }
+
+    //
+    // The side of a Cone or Cylinder: a band from the circle of the given
+    // radius at y = -height / 2 to the circle of top_radius at
+    // y = height / 2.  The texture wraps counterclockwise (seen from above)
+    // from the back, as for a Sphere.
+    //
+    OPENVRML_LOCAL void add_side(pick_mesh & mesh,
+                                 const float height,
+                                 const float radius,
+                                 const float top_radius)
+    {
+        const float h = height / 2;
+        const float slope = (radius - top_radius) / height;
+        const float length = std::sqrt(1.0f + slope * slope);
+        const std::size_t first = mesh.coord.size();
+        for (std::size_t j = 0; j <= facets; ++j) {
+            const float angle = 2 * pi * j / facets;
+            const float x = -std::sin(angle), z = -std::cos(angle);
+            const float s = float(j) / facets;
+            add_vertex(mesh, radius * x, -h, radius * z,
+                       x / length, slope / length, z / length, s, 0.0f);
+            add_vertex(mesh, top_radius * x, h, top_radius * z,
+                       x / length, slope / length, z / length, s, 1.0f);
+        }
+        for (std::size_t j = 0; j < facets; ++j) {
+            const std::size_t a = first + 2 * j;
+            add_quad(mesh, a, a + 2, a + 1, a + 3);
+        }
+    }
+
+    //
+    // A cap of a Cone or Cylinder at the given y, facing up or down.
+    //
+    OPENVRML_LOCAL void add_cap(pick_mesh & mesh,
+                                const float y,
+                                const float radius,
+                                const bool up)
+    {
+        const float ny = up ? 1.0f : -1.0f;
+        const std::size_t center = mesh.coord.size();
+        add_vertex(mesh, 0.0f, y, 0.0f, 0.0f, ny, 0.0f, 0.5f, 0.5f);
+        for (std::size_t j = 0; j <= facets; ++j) {
+            const float angle = 2 * pi * j / facets;
+            const float x = -std::sin(angle), z = -std::cos(angle);
+            add_vertex(mesh, radius * x, y, radius * z, 0.0f, ny, 0.0f,
+                       0.5f + x / 2, 0.5f - ny * z / 2);
+        }
+        for (std::size_t j = 0; j < facets; ++j) {
+            if (up) {
+                add_triangle(mesh, center, center + 1 + j, center + 2 + j);
+            } else {
+                add_triangle(mesh, center, center + 2 + j, center + 1 + j);
+            }
+        }
+    }
+
+    OPENVRML_LOCAL void copy_mesh(const openvrml::compiled_mesh & source,
+                                  pick_mesh & mesh)
+    {
+        mesh.coord = source.coord();
+        mesh.normal = source.normal();
+        mesh.tex_coord = source.tex_coord();
+        mesh.index.assign(source.index().begin(), source.index().end());
+        mesh.ccw = (source.mask() & openvrml::viewer::mask_ccw) != 0;
+        mesh.solid = (source.mask() & openvrml::viewer::mask_solid) != 0;
+    }
+}
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::pick_bvh_node
+ *
+ * @brief A node of a bounding volume hierarchy used for picking.
+ *
+ * A node with a nonzero @a count is a leaf, holding the primitives
+ * <code>order[first, first + count)</code> of the structure it belongs to.
+ * Otherwise, its children are at <code>nodes[first]</code> and
+ * <code>nodes[first + 1]</code>.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::pick_bvh_node::minimum
+ *
+ * @brief The minimum corner of the box around the node's primitives.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::pick_bvh_node::maximum
+ *
+ * @brief The maximum corner of the box around the node's primitives.
+ */
+
+/**
+ * @var std::size_t openvrml::local::pick_bvh_node::first
+ *
+ * @brief The first primitive of a leaf; or the first child of an interior
+ *        node.
+ */
+
+/**
+ * @var std::size_t openvrml::local::pick_bvh_node::count
+ *
+ * @brief The number of primitives in a leaf; 0 for an interior node.
+ */
+
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::pick_mesh
+ *
+ * @brief Triangles for picking, in the coordinate system of a
+ *        @c geometry_node.
+ */
+
+/**
+ * @var std::vector<openvrml::vec3f> openvrml::local::pick_mesh::coord
+ *
+ * @brief Vertex coordinates.
+ */
+
+/**
+ * @var std::vector<openvrml::vec3f> openvrml::local::pick_mesh::normal
+ *
+ * @brief Vertex normals; or empty, if the normal of each triangle is used.
+ */
+
+/**
+ * @var std::vector<openvrml::vec2f> openvrml::local::pick_mesh::tex_coord
+ *
+ * @brief Vertex texture coordinates; or empty.
+ */
+
+/**
+ * @var std::vector<std::size_t> openvrml::local::pick_mesh::index
+ *
+ * @brief Vertex indices, three for each triangle.
+ */
+
+/**
+ * @var bool openvrml::local::pick_mesh::ccw
+ *
+ * @brief Whether the front of each triangle is the side from which its
+ *        vertices appear counterclockwise.
+ */
+
+/**
+ * @var bool openvrml::local::pick_mesh::solid
+ *
+ * @brief Whether only the front of each triangle can be hit.
+ */
+
+/**
+ * @var std::vector<openvrml::local::pick_bvh_node> openvrml::local::pick_mesh::nodes_
+ *
+ * @brief The hierarchy over the triangles.
+ */
+
+/**
+ * @var std::vector<std::size_t> openvrml::local::pick_mesh::order_
+ *
+ * @brief The triangles, in the order of the leaves of @a nodes_.
+ */
+
+/**
+ * @brief Construct an empty mesh.
+ */
+openvrml::local::pick_mesh::pick_mesh() OPENVRML_NOTHROW:
+    ccw(true),
+    solid(true)
+{}
+
+/**
+ * @brief Build the hierarchy over the triangles.
+ *
+ * Triangles that refer to vertices that do not exist are dropped.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_mesh::build() OPENVRML_THROW1(std::bad_alloc)
+{
+    std::vector<std::size_t> valid;
+    valid.reserve(this->index.size());
+    for (std::size_t i = 0; i + 2 < this->index.size(); i += 3) {
+        if (this->index[i] < this->coord.size()
+            && this->index[i + 1] < this->coord.size()
+            && this->index[i + 2] < this->coord.size()) {
+            valid.insert(valid.end(),
+                         this->index.begin() + i,
+                         this->index.begin() + i + 3);
+        }
+    }
+    this->index.swap(valid);
+    if (this->normal.size() != this->coord.size()) { this->normal.clear(); }
+    if (this->tex_coord.size() != this->coord.size()) {
+        this->tex_coord.clear();
+    }
+
+    const std::size_t triangles = this->index.size() / 3;
+    std::vector<vec3f> minimum(triangles), maximum(triangles);
+    for (std::size_t i = 0; i < triangles; ++i) {
+        const vec3f & a = this->coord[this->index[3 * i]];
+        const vec3f & b = this->coord[this->index[3 * i + 1]];
+        const vec3f & c = this->coord[this->index[3 * i + 2]];
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            minimum[i].vec[axis] = std::min(a[axis], std::min(b[axis],
+                                                              c[axis]));
+            maximum[i].vec[axis] = std::max(a[axis], std::max(b[axis],
+                                                              c[axis]));
+        }
+    }
+    build_bvh(minimum, maximum, this->order_, this->nodes_);
+}
+
+/**
+ * @brief Whether the mesh has no triangles.
+ *
+ * @return @c true if the mesh has no triangles; @c false otherwise.
+ */
+bool openvrml::local::pick_mesh::empty() const OPENVRML_NOTHROW
+{
+    return this->nodes_.empty();
+}
+
+/**
+ * @brief The minimum corner of the box around the mesh.
+ *
+ * @return the minimum corner of the box around the mesh.
+ *
+ * @pre The mesh is not @c #empty.
+ */
+const openvrml::vec3f & openvrml::local::pick_mesh::minimum() const
+    OPENVRML_NOTHROW
+{
+    return this->nodes_.front().minimum;
+}
+
+/**
+ * @brief The maximum corner of the box around the mesh.
+ *
+ * @return the maximum corner of the box around the mesh.
+ *
+ * @pre The mesh is not @c #empty.
+ */
+const openvrml::vec3f & openvrml::local::pick_mesh::maximum() const
+    OPENVRML_NOTHROW
+{
+    return this->nodes_.front().maximum;
+}
+
+/**
+ * @brief Find the nearest triangle hit by a ray.
+ *
+ * The ray is <code>origin + t * direction</code> for <var>t</var> &gt; 0.
+ *
+ * @param[in] origin        the origin of the ray.
+ * @param[in] direction     the direction of the ray.
+ * @param[in,out] t         on input, the nearest hit already found; on
+ *                          output, the ray parameter of the hit, if it is
+ *                          nearer.
+ * @param[out] triangle     the triangle hit.
+ * @param[out] u            the barycentric weight of the triangle's second
+ *                          vertex at the hit.
+ * @param[out] v            the barycentric weight of the triangle's third
+ *                          vertex at the hit.
+ *
+ * @return @c true if a triangle nearer than @p t was hit; @c false
+ *         otherwise.
+ */
+bool openvrml::local::pick_mesh::intersect(const vec3f & origin,
+                                           const vec3f & direction,
+                                           float & t,
+                                           std::size_t & triangle,
+                                           float & u,
+                                           float & v) const
+    OPENVRML_NOTHROW
+{
+    if (this->nodes_.empty()) { return false; }
+
+    const float o[3] = { origin[0], origin[1], origin[2] };
+    const float d[3] = { direction[0], direction[1], direction[2] };
+    float inverse[3];
+    reciprocal(direction, inverse);
+
+    bool found = false;
+    std::size_t stack[64];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const pick_bvh_node & n = this->nodes_[stack[--depth]];
+        if (!hits_box(o, inverse, n, t)) { continue; }
+        if (n.count == 0) {
+            if (depth + 2 > sizeof stack / sizeof stack[0]) { continue; }
+            stack[depth++] = n.first + 1;
+            stack[depth++] = n.first;
+            continue;
+        }
+        for (std::size_t i = n.first; i < n.first + n.count; ++i) {
+            const std::size_t tri = this->order_[i];
+            const float * const a = this->coord[this->index[3 * tri]].vec;
+            const float * const b =
+                this->coord[this->index[3 * tri + 1]].vec;
+            const float * const c =
+                this->coord[this->index[3 * tri + 2]].vec;
+            const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            const float p[3] = { d[1] * e2[2] - d[2] * e2[1],
+                                 d[2] * e2[0] - d[0] * e2[2],
+                                 d[0] * e2[1] - d[1] * e2[0] };
+            //
+            // det is positive if the ray hits the side from which the
+            // vertices appear counterclockwise.
+            //
+            const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+            if (det == 0.0f
+                || (this->solid && ((det > 0.0f) != this->ccw))) {
+                continue;
+            }
+            const float inv_det = 1.0f / det;
+            const float s[3] = { o[0] - a[0], o[1] - a[1], o[2] - a[2] };
+            const float hit_u =
+                (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+            if (hit_u < 0.0f || hit_u > 1.0f) { continue; }
+            const float q[3] = { s[1] * e1[2] - s[2] * e1[1],
+                                 s[2] * e1[0] - s[0] * e1[2],
+                                 s[0] * e1[1] - s[1] * e1[0] };
+            const float hit_v =
+                (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+            if (hit_v < 0.0f || hit_u + hit_v > 1.0f) { continue; }
+            const float hit_t =
+                (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+            if (hit_t <= 0.0f || hit_t >= t) { continue; }
+            t = hit_t;
+            triangle = tri;
+            u = hit_u;
+            v = hit_v;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Find the triangles whose boxes overlap a box.
+ *
+ * @param[in] minimum       the minimum corner of the box.
+ * @param[in] maximum       the maximum corner of the box.
+ * @param[out] triangles    the triangles found are appended.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_mesh::overlap(const vec3f & minimum,
+                                         const vec3f & maximum,
+                                         std::vector<std::size_t> & triangles)
+    const OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->nodes_.empty()) { return; }
+
+    std::size_t stack[64];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const pick_bvh_node & n = this->nodes_[stack[--depth]];
+        if (!overlaps(n, minimum, maximum)) { continue; }
+        if (n.count == 0) {
+            if (depth + 2 > sizeof stack / sizeof stack[0]) { continue; }
+            stack[depth++] = n.first + 1;
+            stack[depth++] = n.first;
+            continue;
+        }
+        triangles.insert(triangles.end(),
+                         this->order_.begin() + n.first,
+                         this->order_.begin() + n.first + n.count);
+    }
+}
+
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::collision_triangle
+ *
+ * @brief A triangle the avatar can collide with, in world coordinates.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::collision_triangle::vertex[3]
+ *
+ * @brief The vertices.
+ */
+
+/**
+ * @var openvrml::grouping_node * openvrml::local::collision_triangle::collision
+ *
+ * @brief The innermost Collision node the triangle was drawn under; or 0.
+ */
+
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::pick_engine
+ *
+ * @brief Find the geometry under the pointing device by casting a ray.
+ *
+ * Triangles for each @c geometry_node are built when the node is first
+ * inserted into the @c viewer (and again after it is removed because it has
+ * changed), and cached with a bounding volume hierarchy over them in the
+ * node's coordinate system.  Each frame records where the geometry was
+ * drawn: its world transformation and the sensitive node (see
+ * @c viewer::set_sensitive) in effect.  A hierarchy over the world-space
+ * boxes of these instances is built for the first pick after a frame that
+ * changed them.
+ *
+ * A ray is tested against the instances' boxes; and, in the coordinate
+ * system of the geometry, against the triangles of each instance it may
+ * hit.  Only geometry drawn in the last frame can be picked; and geometry
+ * that has no triangles (such as a PointSet or IndexedLineSet) cannot be
+ * picked at all.
+ *
+ * The same instances serve collision detection: geometry near the avatar
+ * is recorded even when it is not drawn (see
+ * @c rendering_context::collision_only), and the triangles of collidable
+ * instances near the avatar are found by @c #collidable_triangles.
+ */
+
+/**
+ * @var openvrml::local::pick_engine::pickable
+ *
+ * @brief The instance can be picked; it was drawn.
+ */
+
+/**
+ * @var openvrml::local::pick_engine::collidable
+ *
+ * @brief The avatar can collide with the instance.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::pick_engine::hit
+ *
+ * @brief The nearest geometry hit by a ray.
+ */
+
+/**
+ * @var openvrml::node * openvrml::local::pick_engine::hit::sensitive
+ *
+ * @brief The sensitive node the geometry was drawn under; or 0.
+ */
+
+/**
+ * @var const openvrml::geometry_node * openvrml::local::pick_engine::hit::geometry
+ *
+ * @brief The geometry hit.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::pick_engine::hit::point
+ *
+ * @brief The point hit, in world coordinates.
+ */
+
+/**
+ * @var openvrml::vec3f openvrml::local::pick_engine::hit::normal
+ *
+ * @brief The unit surface normal at the point hit, in world coordinates.
+ */
+
+/**
+ * @var openvrml::vec2f openvrml::local::pick_engine::hit::tex_coord
+ *
+ * @brief The texture coordinate at the point hit.
+ */
+
+/**
+ * @var float openvrml::local::pick_engine::hit::distance
+ *
+ * @brief The distance from the origin of the ray to the point hit.
+ */
+
+/**
+ * @typedef openvrml::local::pick_engine::mesh_map_t
+ *
+ * @brief Map of @c geometry_node%s to their triangles.
+ */
+
+/**
+ * @struct openvrml::local::pick_engine::instance
+ *
+ * @brief Geometry, where it was drawn.
+ */
+
+/**
+ * @var boost::shared_ptr<const openvrml::local::pick_mesh> openvrml::local::pick_engine::instance::mesh
+ *
+ * @brief The triangles of the geometry.
+ */
+
+/**
+ * @var const openvrml::geometry_node * openvrml::local::pick_engine::instance::geometry
+ *
+ * @brief The geometry.
+ */
+
+/**
+ * @var openvrml::node * openvrml::local::pick_engine::instance::sensitive
+ *
+ * @brief The sensitive node the geometry was drawn under; or 0.
+ */
+
+/**
+ * @var openvrml::grouping_node * openvrml::local::pick_engine::instance::collision
+ *
+ * @brief The innermost Collision node the geometry was drawn under; or 0.
+ */
+
+/**
+ * @var unsigned int openvrml::local::pick_engine::instance::flags
+ *
+ * @brief A combination of @c pickable and @c collidable.
+ */
+
+/**
+ * @var openvrml::mat4f openvrml::local::pick_engine::instance::transform
+ *
+ * @brief The transformation from the geometry's coordinate system to the
+ *        world.
+ */
+
+/**
+ * @var boost::mutex openvrml::local::pick_engine::mutex_
+ *
+ * @brief Serializes access to the engine.
+ */
+
+/**
+ * @var openvrml::local::pick_engine::mesh_map_t openvrml::local::pick_engine::meshes_
+ *
+ * @brief The triangles of each @c geometry_node inserted.
+ */
+
+/**
+ * @var std::vector<openvrml::node *> openvrml::local::pick_engine::sensitive_
+ *
+ * @brief The sensitive nodes in effect during the frame being recorded,
+ *        innermost last.
+ */
+
+/**
+ * @var openvrml::mat4f openvrml::local::pick_engine::camera_
+ *
+ * @brief The transformation from the eye coordinates of the frame being
+ *        recorded to the world.
+ */
+
+/**
+ * @var std::vector<openvrml::local::pick_engine::instance> openvrml::local::pick_engine::recorded_
+ *
+ * @brief The instances of the frame being recorded.
+ */
+
+/**
+ * @var std::vector<openvrml::local::pick_engine::instance> openvrml::local::pick_engine::instances_
+ *
+ * @brief The instances of the last frame.
+ */
+
+/**
+ * @var std::vector<openvrml::mat4f> openvrml::local::pick_engine::inverse_
+ *
+ * @brief The inverse of each instance's transformation.
+ */
+
+/**
+ * @var std::vector<openvrml::local::pick_bvh_node> openvrml::local::pick_engine::nodes_
+ *
+ * @brief The hierarchy over the instances.
+ */
+
+/**
+ * @var std::vector<std::size_t> openvrml::local::pick_engine::order_
+ *
+ * @brief The instances, in the order of the leaves of @a nodes_.
+ */
+
+/**
+ * @var bool openvrml::local::pick_engine::built_
+ *
+ * @brief Whether @a nodes_ and @a inverse_ are current for @a instances_.
+ */
+
+/**
+ * @brief Construct.
+ */
+openvrml::local::pick_engine::pick_engine() OPENVRML_NOTHROW:
+    built_(false)
+{}
+
+/**
+ * @brief Begin recording a frame.
+ *
+ * @param[in] camera    the transformation from eye coordinates to the world.
+ */
+void openvrml::local::pick_engine::begin_frame(const mat4f & camera)
+    OPENVRML_NOTHROW
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    this->camera_ = camera;
+    this->sensitive_.clear();
+    this->recorded_.clear();
+}
+
+/**
+ * @brief Finish recording a frame.
+ *
+ * The recorded instances replace those of the last frame.  If they are the
+ * same, the hierarchy over them is kept.
+ */
+void openvrml::local::pick_engine::end_frame() OPENVRML_NOTHROW
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    bool same = this->recorded_.size() == this->instances_.size();
+    for (std::size_t i = 0; same && i < this->recorded_.size(); ++i) {
+        const instance & lhs = this->recorded_[i];
+        const instance & rhs = this->instances_[i];
+        same = lhs.mesh == rhs.mesh
+            && lhs.sensitive == rhs.sensitive
+            && lhs.collision == rhs.collision
+            && lhs.flags == rhs.flags
+            && std::memcmp(&lhs.transform, &rhs.transform,
+                           sizeof lhs.transform) == 0;
+    }
+    if (!same) {
+        this->instances_.swap(this->recorded_);
+        this->built_ = false;
+    }
+    this->recorded_.clear();
+}
+
+/**
+ * @brief Note the sensitive node for the geometry that follows.
+ *
+ * @param[in] n a sensitive node; or 0 to restore the enclosing one.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::sensitive(node * const n)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    if (n) {
+        this->sensitive_.push_back(n);
+    } else if (!this->sensitive_.empty()) {
+        this->sensitive_.pop_back();
+    }
+}
+
+/**
+ * @brief Record that geometry has been rendered.
+ *
+ * Does nothing if @p n has no triangles, or if @p flags is 0.
+ *
+ * @param[in] n         a @c geometry_node that has just been rendered.
+ * @param[in] modelview the modelview matrix @p n was rendered with.
+ * @param[in] flags     a combination of @c pickable and @c collidable.
+ * @param[in] collision the innermost Collision node @p n was rendered under;
+ *                      or 0.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::record(const geometry_node & n,
+                                          const mat4f & modelview,
+                                          const unsigned int flags,
+                                          grouping_node * const collision)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (!flags) { return; }
+    boost::mutex::scoped_lock lock(this->mutex_);
+    const mesh_map_t::const_iterator mesh =
+        this->meshes_.find(static_cast<const node *>(&n));
+    if (mesh == this->meshes_.end() || mesh->second->empty()) { return; }
+    const instance i = {
+        mesh->second,
+        &n,
+        this->sensitive_.empty() ? 0 : this->sensitive_.back(),
+        collision,
+        flags,
+        modelview * this->camera_
+    };
+    this->recorded_.push_back(i);
+}
+
+/**
+ * @brief Build the triangles of a Box, if they are not cached.
+ *
+ * @param[in] n     the @c geometry_node corresponding to the box.
+ * @param[in] size  box dimensions.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::insert_box(const geometry_node & n,
+                                              const vec3f & size)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    //
+    // Each face, counterclockwise from the outside, starting at the corner
+    // where the texture's origin is.
+    //
+    static const float face[6][4][3] = {
+        { { -1, -1,  1 }, {  1, -1,  1 }, {  1,  1,  1 }, { -1,  1,  1 } },
+        { {  1, -1, -1 }, { -1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 } },
+        { {  1, -1,  1 }, {  1, -1, -1 }, {  1,  1, -1 }, {  1,  1,  1 } },
+        { { -1, -1, -1 }, { -1, -1,  1 }, { -1,  1,  1 }, { -1,  1, -1 } },
+        { { -1,  1,  1 }, {  1,  1,  1 }, {  1,  1, -1 }, { -1,  1, -1 } },
+        { { -1, -1, -1 }, {  1, -1, -1 }, {  1, -1,  1 }, { -1, -1,  1 } }
+    };
+    static const float normal[6][3] = {
+        { 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 },
+        { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }
+    };
+    static const float tex_coord[4][2] = { { 0, 0 }, { 1, 0 },
+                                           { 1, 1 }, { 0, 1 } };
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    for (std::size_t f = 0; f < 6; ++f) {
+        const std::size_t first = mesh->coord.size();
+        for (std::size_t i = 0; i < 4; ++i) {
+            add_vertex(*mesh,
+                       face[f][i][0] * size.x() / 2,
+                       face[f][i][1] * size.y() / 2,
+                       face[f][i][2] * size.z() / 2,
+                       normal[f][0], normal[f][1], normal[f][2],
+                       tex_coord[i][0], tex_coord[i][1]);
+        }
+        add_triangle(*mesh, first, first + 1, first + 2);
+        add_triangle(*mesh, first, first + 2, first + 3);
+    }
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Build the triangles of a Cone, if they are not cached.
+ *
+ * @param[in] n         the @c geometry_node corresponding to the cone.
+ * @param[in] height    height.
+ * @param[in] radius    radius at the bottom.
+ * @param[in] bottom    show the bottom.
+ * @param[in] side      show the side.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::insert_cone(const geometry_node & n,
+                                               const float height,
+                                               const float radius,
+                                               const bool bottom,
+                                               const bool side)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    if (height > 0.0f && radius > 0.0f) {
+        if (side) { add_side(*mesh, height, radius, 0.0f); }
+        if (bottom) { add_cap(*mesh, -height / 2, radius, false); }
+    }
+    mesh->solid = bottom && side;
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Build the triangles of a Cylinder, if they are not cached.
+ *
+ * @param[in] n         the @c geometry_node corresponding to the cylinder.
+ * @param[in] height    height.
+ * @param[in] radius    radius.
+ * @param[in] bottom    show the bottom.
+ * @param[in] side      show the side.
+ * @param[in] top       show the top.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::insert_cylinder(const geometry_node & n,
+                                                   const float height,
+                                                   const float radius,
+                                                   const bool bottom,
+                                                   const bool side,
+                                                   const bool top)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    if (height > 0.0f && radius > 0.0f) {
+        if (side) { add_side(*mesh, height, radius, radius); }
+        if (bottom) { add_cap(*mesh, -height / 2, radius, false); }
+        if (top) { add_cap(*mesh, height / 2, radius, true); }
+    }
+    mesh->solid = bottom && side && top;
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Build the triangles of an ElevationGrid, if they are not cached.
+ *
+ * @param[in] n             the @c geometry_node corresponding to the
+ *                          elevation grid.
+ * @param[in] mask          flags.
+ * @param[in] height        height field.
+ * @param[in] x_dimension   vertices in the x direction.
+ * @param[in] z_dimension   vertices in the z direction.
+ * @param[in] x_spacing     distance between vertices in the x direction.
+ * @param[in] z_spacing     distance between vertices in the z direction.
+ * @param[in] tex_coord     texture coordinates; or empty, for the default
+ *                          mapping of the texture over the whole grid.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::pick_engine::
+insert_elevation_grid(const geometry_node & n,
+                      const unsigned int mask,
+                      const std::vector<float> & height,
+                      const int32 x_dimension,
+                      const int32 z_dimension,
+                      const float x_spacing,
+                      const float z_spacing,
+                      const std::vector<vec2f> & tex_coord)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    mesh->ccw = (mask & viewer::mask_ccw) != 0;
+    mesh->solid = (mask & viewer::mask_solid) != 0;
+    if (x_dimension > 1 && z_dimension > 1
+        && height.size() >= std::size_t(x_dimension) * z_dimension) {
+        const std::size_t nx = x_dimension, nz = z_dimension;
+        const bool default_tex_coord = tex_coord.size() < nx * nz;
+        mesh->coord.reserve(nx * nz);
+        mesh->tex_coord.reserve(nx * nz);
+        for (std::size_t j = 0; j < nz; ++j) {
+            for (std::size_t i = 0; i < nx; ++i) {
+                mesh->coord.push_back(make_vec3f(i * x_spacing,
+                                                 height[j * nx + i],
+                                                 j * z_spacing));
+                mesh->tex_coord.push_back(
+                    default_tex_coord
+                    ? make_vec2f(float(i) / (nx - 1), float(j) / (nz - 1))
+                    : tex_coord[j * nx + i]);
+            }
+        }
+        mesh->index.reserve(6 * (nx - 1) * (nz - 1));
+        for (std::size_t j = 0; j + 1 < nz; ++j) {
+            for (std::size_t i = 0; i + 1 < nx; ++i) {
+                const std::size_t a = j * nx + i;
+                add_triangle(*mesh, a, a + nx, a + nx + 1);
+                add_triangle(*mesh, a, a + nx + 1, a + 1);
+            }
+        }
+    }
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Build the triangles of an Extrusion, if they are not cached.
+ *
+ * @param[in] n             the @c geometry_node corresponding to the
+ *                          extrusion.
+ * @param[in] mask          flags.
+ * @param[in] spine         spine points.
+ * @param[in] cross_section cross-sections.
+ * @param[in] orientation   cross-section orientations.
+ * @param[in] scale         cross-section scales.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::pick_engine::
+insert_extrusion(const geometry_node & n,
+                 const unsigned int mask,
+                 const std::vector<vec3f> & spine,
+                 const std::vector<vec2f> & cross_section,
+                 const std::vector<rotation> & orientation,
+                 const std::vector<vec2f> & scale)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    copy_mesh(make_extrusion_mesh(mask, spine, cross_section,
+                                  orientation, scale),
+              *mesh);
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Build the triangles of a shell, if they are not cached.
+ *
+ * @param[in] n                 the @c geometry_node corresponding to the
+ *                              shell.
+ * @param[in] mask              flags.
+ * @param[in] coord             coordinates.
+ * @param[in] coord_index       coordinate indices.
+ * @param[in] normal            normals.
+ * @param[in] normal_index      normal indices.
+ * @param[in] tex_coord         texture coordinates.
+ * @param[in] tex_coord_index   texture coordinate indices.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::pick_engine::
+insert_shell(const geometry_node & n,
+             const unsigned int mask,
+             const std::vector<vec3f> & coord,
+             const std::vector<int32> & coord_index,
+             const std::vector<vec3f> & normal,
+             const std::vector<int32> & normal_index,
+             const std::vector<vec2f> & tex_coord,
+             const std::vector<int32> & tex_coord_index)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    copy_mesh(compiled_mesh(mask,
+                            coord, coord_index,
+                            std::vector<color>(), std::vector<int32>(),
+                            normal, normal_index,
+                            tex_coord, tex_coord_index),
+              *mesh);
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Copy the triangles of a compiled mesh, if they are not cached.
+ *
+ * @param[in] n     the @c geometry_node corresponding to the mesh.
+ * @param[in] mesh  a compiled mesh.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::insert_mesh(const geometry_node & n,
+                                               const compiled_mesh & mesh)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> triangles(new pick_mesh);
+    copy_mesh(mesh, *triangles);
+    this->insert(n, triangles);
+}
+
+/**
+ * @brief Build the triangles of a Sphere, if they are not cached.
+ *
+ * The texture wraps counterclockwise (seen from above) from the back.
+ *
+ * @param[in] n         the @c geometry_node corresponding to the sphere.
+ * @param[in] radius    radius.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::insert_sphere(const geometry_node & n,
+                                                 const float radius)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    if (this->cached(n)) { return; }
+
+    std::auto_ptr<pick_mesh> mesh(new pick_mesh);
+    if (radius > 0.0f) {
+        for (std::size_t i = 0; i <= rows; ++i) {
+            const float latitude = pi * i / rows - pi / 2;
+            const float y = std::sin(latitude), r = std::cos(latitude);
+            for (std::size_t j = 0; j <= facets; ++j) {
+                const float angle = 2 * pi * j / facets;
+                const float x = -std::sin(angle) * r;
+                const float z = -std::cos(angle) * r;
+                add_vertex(*mesh, radius * x, radius * y, radius * z,
+                           x, y, z,
+                           float(j) / facets, float(i) / rows);
+            }
+        }
+        for (std::size_t i = 0; i < rows; ++i) {
+            for (std::size_t j = 0; j < facets; ++j) {
+                const std::size_t a = i * (facets + 1) + j;
+                add_quad(*mesh, a, a + 1, a + facets + 1, a + facets + 2);
+            }
+        }
+    }
+    this->insert(n, mesh);
+}
+
+/**
+ * @brief Discard the cached triangles of a node that has changed.
+ *
+ * Instances already recorded keep the triangles they were drawn with.
+ *
+ * @param[in] n a node.
+ */
+void openvrml::local::pick_engine::remove(const node & n) OPENVRML_NOTHROW
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    this->meshes_.erase(&n);
+}
+
+/**
+ * @brief Discard everything that refers to a node being destroyed.
+ *
+ * Nothing can be picked until the next frame is recorded.
+ *
+ * @param[in] n a node being destroyed.
+ */
+void openvrml::local::pick_engine::forget(const node & n) OPENVRML_NOTHROW
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    this->meshes_.erase(&n);
+    this->sensitive_.clear();
+    this->recorded_.clear();
+    this->instances_.clear();
+    this->built_ = false;
+}
+
+/**
+ * @brief Find the nearest geometry hit by a ray.
+ *
+ * The ray is <code>origin + t * direction</code> for <var>t</var> &gt; 0,
+ * in world coordinates.
+ *
+ * @param[in] origin        the origin of the ray.
+ * @param[in] direction     the direction of the ray.
+ * @param[out] result       the nearest hit, if any.
+ *
+ * @return @c true if any geometry drawn in the last frame was hit; @c false
+ *         otherwise.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+bool openvrml::local::pick_engine::pick(const vec3f & origin,
+                                        const vec3f & direction,
+                                        hit & result)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    if (!this->built_) { this->build(); }
+    if (this->nodes_.empty()) { return false; }
+
+    const float o[3] = { origin[0], origin[1], origin[2] };
+    float inverse[3];
+    reciprocal(direction, inverse);
+
+    float t = std::numeric_limits<float>::max();
+    std::size_t nearest = 0, triangle = 0;
+    float u = 0.0f, v = 0.0f;
+    bool found = false;
+
+    std::size_t stack[64];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const pick_bvh_node & n = this->nodes_[stack[--depth]];
+        if (!hits_box(o, inverse, n, t)) { continue; }
+        if (n.count == 0) {
+            if (depth + 2 > sizeof stack / sizeof stack[0]) { continue; }
+            stack[depth++] = n.first + 1;
+            stack[depth++] = n.first;
+            continue;
+        }
+        for (std::size_t i = n.first; i < n.first + n.count; ++i) {
+            const std::size_t k = this->order_[i];
+            if (!(this->instances_[k].flags & pickable)) { continue; }
+            //
+            // An affine transformation preserves the ray parameter; so hits
+            // in different instances can be compared by t.
+            //
+            const vec3f local_origin = origin * this->inverse_[k];
+            const vec3f local_direction =
+                (origin + direction) * this->inverse_[k] - local_origin;
+            if (this->instances_[k].mesh->intersect(local_origin,
+                                                    local_direction,
+                                                    t, triangle, u, v)) {
+                nearest = k;
+                found = true;
+            }
+        }
+    }
+    if (!found) { return false; }
+
+    const instance & i = this->instances_[nearest];
+    const pick_mesh & mesh = *i.mesh;
+    const std::size_t a = mesh.index[3 * triangle];
+    const std::size_t b = mesh.index[3 * triangle + 1];
+    const std::size_t c = mesh.index[3 * triangle + 2];
+    const float w = 1.0f - u - v;
+
+    vec3f normal;
+    if (!mesh.normal.empty()) {
+        normal = w * mesh.normal[a] + u * mesh.normal[b] + v * mesh.normal[c];
+    } else {
+        normal = (mesh.coord[b] - mesh.coord[a])
+            * (mesh.coord[c] - mesh.coord[a]);
+        if (!mesh.ccw) { normal = -normal; }
+    }
+
+    //
+    // Normals are transformed by the transpose of the inverse.
+    //
+    const mat4f & inv = this->inverse_[nearest];
+    result.normal =
+        make_vec3f(inv[0][0] * normal.x() + inv[0][1] * normal.y()
+                   + inv[0][2] * normal.z(),
+                   inv[1][0] * normal.x() + inv[1][1] * normal.y()
+                   + inv[1][2] * normal.z(),
+                   inv[2][0] * normal.x() + inv[2][1] * normal.y()
+                   + inv[2][2] * normal.z()).normalize();
+    result.point = origin + t * direction;
+    result.tex_coord = mesh.tex_coord.empty()
+        ? make_vec2f()
+        : w * mesh.tex_coord[a] + u * mesh.tex_coord[b]
+          + v * mesh.tex_coord[c];
+    result.distance = t * direction.length();
+    result.sensitive = i.sensitive;
+    result.geometry = i.geometry;
+    return true;
+}
+
+/**
+ * @brief Find the collidable triangles near a box.
+ *
+ * The triangles of collidable instances whose boxes overlap the box are
+ * found, in world coordinates.  Some may not overlap the box themselves.
+ *
+ * @param[in] minimum       the minimum corner of the box, in world
+ *                          coordinates.
+ * @param[in] maximum       the maximum corner of the box, in world
+ *                          coordinates.
+ * @param[out] triangles    the triangles found are appended.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::pick_engine::
+collidable_triangles(const vec3f & minimum,
+                     const vec3f & maximum,
+                     std::vector<collision_triangle> & triangles)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    if (!this->built_) { this->build(); }
+    if (this->nodes_.empty()) { return; }
+
+    std::vector<std::size_t> found;
+    std::size_t stack[64];
+    std::size_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const pick_bvh_node & n = this->nodes_[stack[--depth]];
+        if (!overlaps(n, minimum, maximum)) { continue; }
+        if (n.count == 0) {
+            if (depth + 2 > sizeof stack / sizeof stack[0]) { continue; }
+            stack[depth++] = n.first + 1;
+            stack[depth++] = n.first;
+            continue;
+        }
+        for (std::size_t i = n.first; i < n.first + n.count; ++i) {
+            const std::size_t k = this->order_[i];
+            const instance & inst = this->instances_[k];
+            if (!(inst.flags & collidable)) { continue; }
+            vec3f local_minimum, local_maximum;
+            transform_box(minimum, maximum, this->inverse_[k],
+                          local_minimum, local_maximum);
+            found.clear();
+            inst.mesh->overlap(local_minimum, local_maximum, found);
+            for (std::size_t j = 0; j < found.size(); ++j) {
+                collision_triangle t;
+                for (std::size_t v = 0; v < 3; ++v) {
+                    t.vertex[v] =
+                        inst.mesh->coord[inst.mesh->index[3 * found[j] + v]]
+                        * inst.transform;
+                }
+                t.collision = inst.collision;
+                triangles.push_back(t);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Whether the triangles of a node are cached.
+ *
+ * @param[in] n a @c geometry_node.
+ *
+ * @return @c true if the triangles of @p n are cached; @c false otherwise.
+ */
+bool openvrml::local::pick_engine::cached(const geometry_node & n) const
+    OPENVRML_NOTHROW
+{
+    boost::mutex::scoped_lock lock(this->mutex_);
+    return this->meshes_.find(static_cast<const node *>(&n))
+        != this->meshes_.end();
+}
+
+/**
+ * @brief Build the hierarchy over a node's triangles and cache them.
+ *
+ * @param[in] n     a @c geometry_node.
+ * @param[in] mesh  the triangles of @p n.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::insert(const geometry_node & n,
+                                          std::auto_ptr<pick_mesh> mesh)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    mesh->build();
+    const boost::shared_ptr<const pick_mesh> triangles(mesh);
+    boost::mutex::scoped_lock lock(this->mutex_);
+    this->meshes_[static_cast<const node *>(&n)] = triangles;
+}
+
+/**
+ * @brief Build the hierarchy over the instances of the last frame.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::pick_engine::build() OPENVRML_THROW1(std::bad_alloc)
+{
+    const std::size_t n = this->instances_.size();
+    std::vector<vec3f> minimum(n), maximum(n);
+    std::vector<mat4f> inverse(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const instance & inst = this->instances_[i];
+        inverse[i] = inst.transform.inverse();
+        transform_box(inst.mesh->minimum(), inst.mesh->maximum(),
+                      inst.transform, minimum[i], maximum[i]);
+    }
+    build_bvh(minimum, maximum, this->order_, this->nodes_);
+    this->inverse_.swap(inverse);
+    this->built_ = true;
+}
@@ -0,0 +1,204 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_PICK_ENGINE_H
+#   define OPENVRML_LOCAL_PICK_ENGINE_H
+
+#   include <openvrml/basetypes.h>
+#   include <boost/shared_ptr.hpp>
+#   include <boost/thread/mutex.hpp>
+#   include <boost/utility.hpp>
+#   include <map>
+#   include <memory>
+#   include <vector>
+
+namespace openvrml {
+
+    class node;
+    class geometry_node;
+    class grouping_node;
+    class compiled_mesh;
+
+    namespace local {
+
+        struct OPENVRML_LOCAL pick_bvh_node {
+            vec3f minimum;
+            vec3f maximum;
+            std::size_t first;
+            std::size_t count;
+        };
+
+
+        struct OPENVRML_LOCAL collision_triangle {
+            vec3f vertex[3];
+            grouping_node * collision;
+        };
+
+
+        class OPENVRML_LOCAL pick_mesh : boost::noncopyable {
+        public:
+            std::vector<vec3f> coord;
+            std::vector<vec3f> normal;
+            std::vector<vec2f> tex_coord;
+            std::vector<std::size_t> index;
+            bool ccw;
+            bool solid;
+
+        private:
+            std::vector<pick_bvh_node> nodes_;
+            std::vector<std::size_t> order_;
+
+        public:
+            pick_mesh() OPENVRML_NOTHROW;
+
+            void build() OPENVRML_THROW1(std::bad_alloc);
+            bool empty() const OPENVRML_NOTHROW;
+            const vec3f & minimum() const OPENVRML_NOTHROW;
+            const vec3f & maximum() const OPENVRML_NOTHROW;
+            bool intersect(const vec3f & origin,
+                           const vec3f & direction,
+                           float & t,
+                           std::size_t & triangle,
+                           float & u,
+                           float & v) const
+                OPENVRML_NOTHROW;
+            void overlap(const vec3f & minimum,
+                         const vec3f & maximum,
+                         std::vector<std::size_t> & triangles) const
+                OPENVRML_THROW1(std::bad_alloc);
+        };
+
+
+        class OPENVRML_LOCAL pick_engine : boost::noncopyable {
+        public:
+            enum {
+                pickable   = 0x1,
+                collidable = 0x2
+            };
+
+            struct hit {
+                node * sensitive;
+                const geometry_node * geometry;
+                vec3f point;
+                vec3f normal;
+                vec2f tex_coord;
+                float distance;
+            };
+
+        private:
+            typedef std::map<const node *,
+                             boost::shared_ptr<const pick_mesh> >
+                mesh_map_t;
+
+            struct instance {
+                boost::shared_ptr<const pick_mesh> mesh;
+                const geometry_node * geometry;
+                node * sensitive;
+                grouping_node * collision;
+                unsigned int flags;
+                mat4f transform;
+            };
+
+            mutable boost::mutex mutex_;
+            mesh_map_t meshes_;
+            std::vector<node *> sensitive_;
+            mat4f camera_;
+            std::vector<instance> recorded_;
+            std::vector<instance> instances_;
+            std::vector<mat4f> inverse_;
+            std::vector<pick_bvh_node> nodes_;
+            std::vector<std::size_t> order_;
+            bool built_;
+
+        public:
+            pick_engine() OPENVRML_NOTHROW;
+
+            void begin_frame(const mat4f & camera) OPENVRML_NOTHROW;
+            void end_frame() OPENVRML_NOTHROW;
+            void sensitive(node * n) OPENVRML_THROW1(std::bad_alloc);
+            void record(const geometry_node & n, const mat4f & modelview,
+                        unsigned int flags, grouping_node * collision)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            void insert_box(const geometry_node & n, const vec3f & size)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_cone(const geometry_node & n,
+                             float height, float radius,
+                             bool bottom, bool side)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_cylinder(const geometry_node & n,
+                                 float height, float radius,
+                                 bool bottom, bool side, bool top)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_elevation_grid(const geometry_node & n,
+                                       unsigned int mask,
+                                       const std::vector<float> & height,
+                                       int32 x_dimension,
+                                       int32 z_dimension,
+                                       float x_spacing,
+                                       float z_spacing,
+                                       const std::vector<vec2f> & tex_coord)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_extrusion(const geometry_node & n,
+                                  unsigned int mask,
+                                  const std::vector<vec3f> & spine,
+                                  const std::vector<vec2f> & cross_section,
+                                  const std::vector<rotation> & orientation,
+                                  const std::vector<vec2f> & scale)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_shell(const geometry_node & n,
+                              unsigned int mask,
+                              const std::vector<vec3f> & coord,
+                              const std::vector<int32> & coord_index,
+                              const std::vector<vec3f> & normal,
+                              const std::vector<int32> & normal_index,
+                              const std::vector<vec2f> & tex_coord,
+                              const std::vector<int32> & tex_coord_index)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_mesh(const geometry_node & n,
+                             const compiled_mesh & mesh)
+                OPENVRML_THROW1(std::bad_alloc);
+            void insert_sphere(const geometry_node & n, float radius)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            void remove(const node & n) OPENVRML_NOTHROW;
+            void forget(const node & n) OPENVRML_NOTHROW;
+
+            bool pick(const vec3f & origin,
+                      const vec3f & direction,
+                      hit & result)
+                OPENVRML_THROW1(std::bad_alloc);
+            void collidable_triangles(
+                const vec3f & minimum,
+                const vec3f & maximum,
+                std::vector<collision_triangle> & triangles)
+                OPENVRML_THROW1(std::bad_alloc);
+
+        private:
+            bool cached(const geometry_node & n) const OPENVRML_NOTHROW;
+            void insert(const geometry_node & n,
+                        std::auto_ptr<pick_mesh> mesh)
+                OPENVRML_THROW1(std::bad_alloc);
+            void build() OPENVRML_THROW1(std::bad_alloc);
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_PICK_ENGINE_H
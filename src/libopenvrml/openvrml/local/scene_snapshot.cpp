@@ -0,0 +1,1069 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "scene_snapshot.h"
+# include <boost/algorithm/string/predicate.hpp>
+# include <boost/filesystem.hpp>
+# include <boost/interprocess/file_mapping.hpp>
+# include <boost/interprocess/mapped_region.hpp>
+# include <zlib.h>
+# include <algorithm>
+# include <fstream>
+# include <iomanip>
+# include <sstream>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    //
+    // Snapshot layout:
+    //
+    //   magic              8 octets
+    //   format version     uint32
+    //   byte order mark    uint32
+    //   source size        uint64
+    //   source CRC-32      uint32
+    //   source Adler-32    uint32
+    //   library version    string
+    //   media type         string
+    //   URI                string
+    //   events             ...
+    //   end event
+    //
+    // Values are written in native byte order and aligned to their natural
+    // alignment from the start of the file; arrays are aligned to 8 octets.
+    // A snapshot written on a machine with a different byte order or by a
+    // different library version is not used.
+    //
+    const char snapshot_magic[8] = {
+        'O', 'V', 'S', 'N', 'A', 'P', '\r', '\n'
+    };
+    const boost::uint32_t snapshot_format_version = 1;
+    const boost::uint32_t snapshot_byte_order_mark = 0x01020304;
+
+    OPENVRML_LOCAL void checksum(const char * const begin,
+                                 const char * const end,
+                                 boost::uint32_t & crc,
+                                 boost::uint32_t & adler)
+    {
+        static const std::size_t block_size = 1 << 30;
+        uLong c = crc32(0L, Z_NULL, 0), a = adler32(0L, Z_NULL, 0);
+        for (const char * p = begin; p != end; ) {
+            const uInt n =
+                uInt(std::min(std::size_t(end - p), block_size));
+            c = crc32(c, reinterpret_cast<const Bytef *>(p), n);
+            a = adler32(a, reinterpret_cast<const Bytef *>(p), n);
+            p += n;
+        }
+        crc = boost::uint32_t(c);
+        adler = boost::uint32_t(a);
+    }
+
+    struct OPENVRML_LOCAL invalid_snapshot : std::runtime_error {
+        explicit invalid_snapshot(const std::string & msg):
+            std::runtime_error(msg)
+        {}
+
+        virtual ~invalid_snapshot() throw ()
+        {}
+    };
+
+    //
+    // Reads values from a mapped snapshot.  Fixed-size arrays are not
+    // copied out of the mapping until they are given to the parse actions.
+    //
+    class OPENVRML_LOCAL snapshot_reader {
+        const char * const begin_;
+        const char * pos_;
+        const char * const end_;
+
+    public:
+        snapshot_reader(const char * const begin, const char * const end):
+            begin_(begin),
+            pos_(begin),
+            end_(end)
+        {}
+
+        const char * take(const std::size_t alignment, const std::size_t n)
+        {
+            const std::size_t offset = std::size_t(this->pos_ - this->begin_);
+            const std::size_t pad = (alignment - offset % alignment)
+                                  % alignment;
+            if (std::size_t(this->end_ - this->pos_) < pad
+                || std::size_t(this->end_ - this->pos_) - pad < n) {
+                throw invalid_snapshot("truncated scene snapshot");
+            }
+            const char * const result = this->pos_ + pad;
+            this->pos_ = result + n;
+            return result;
+        }
+
+        template <typename T>
+        const T get()
+        {
+            T value;
+            std::memcpy(&value,
+                        this->take(boost::alignment_of<T>::value,
+                                   sizeof value),
+                        sizeof value);
+            return value;
+        }
+
+        std::size_t size()
+        {
+            return this->get<boost::uint32_t>();
+        }
+
+        //
+        // The number of elements in a sequence of values that each occupy
+        // at least one octet.
+        //
+        std::size_t count()
+        {
+            const std::size_t n = this->size();
+            if (n > std::size_t(this->end_ - this->pos_)) {
+                throw invalid_snapshot("truncated scene snapshot");
+            }
+            return n;
+        }
+
+        bool boolean()
+        {
+            return this->get<unsigned char>() != 0;
+        }
+
+        const std::string string()
+        {
+            const std::size_t n = this->size();
+            const char * const data = this->take(1, n);
+            return std::string(data, data + n);
+        }
+
+        template <typename T>
+        const std::vector<T> array()
+        {
+            const std::size_t n = this->size();
+            if (n > std::size_t(this->end_ - this->pos_) / sizeof (T)) {
+                throw invalid_snapshot("truncated scene snapshot");
+            }
+            const T * const data = reinterpret_cast<const T *>(
+                this->take(sizeof (boost::uint64_t), n * sizeof (T)));
+            return std::vector<T>(data, data + n);
+        }
+
+        const openvrml::image image()
+        {
+            const std::size_t x = this->size();
+            const std::size_t y = this->size();
+            const std::size_t comp = this->size();
+            const std::vector<unsigned char> array =
+                this->array<unsigned char>();
+            if (array.size() != x * y * comp) {
+                throw invalid_snapshot("invalid image in scene snapshot");
+            }
+            return openvrml::image(x, y, comp, array);
+        }
+
+        openvrml::field_value::type_id field_type()
+        {
+            return openvrml::field_value::type_id(
+                this->get<unsigned char>());
+        }
+
+        const openvrml::node_interface interface_()
+        {
+            const openvrml::node_interface::type_id type =
+                openvrml::node_interface::type_id(this->get<unsigned char>());
+            const openvrml::field_value::type_id field_type =
+                this->field_type();
+            return openvrml::node_interface(type, field_type, this->string());
+        }
+
+        const openvrml::node_interface_set interfaces()
+        {
+            openvrml::node_interface_set result;
+            for (std::size_t n = this->count(); n > 0; --n) {
+                result.insert(this->interface_());
+            }
+            return result;
+        }
+
+        const std::vector<bool> bools()
+        {
+            std::vector<bool> result(this->count());
+            for (std::size_t i = 0; i < result.size(); ++i) {
+                result[i] = this->boolean();
+            }
+            return result;
+        }
+
+        const std::vector<std::string> strings()
+        {
+            std::vector<std::string> result(this->count());
+            for (std::size_t i = 0; i < result.size(); ++i) {
+                result[i] = this->string();
+            }
+            return result;
+        }
+
+        const std::vector<openvrml::image> images()
+        {
+            std::vector<openvrml::image> result(this->count());
+            for (std::size_t i = 0; i < result.size(); ++i) {
+                result[i] = this->image();
+            }
+            return result;
+        }
+    };
+
+    OPENVRML_LOCAL bool
+    replay_vrml97_event(const openvrml::local::snapshot_event e,
+                        snapshot_reader & in,
+                        openvrml::local::vrml97_parse_actions & actions)
+    {
+        using namespace openvrml;
+        using namespace openvrml::local;
+        using std::string;
+
+        switch (e) {
+        case snapshot_scene_start_event:
+            actions.on_scene_start();
+            break;
+        case snapshot_scene_finish_event:
+            actions.on_scene_finish();
+            break;
+        case snapshot_externproto_event:
+        {
+            const string node_type_id = in.string();
+            const node_interface_set interfaces = in.interfaces();
+            actions.on_externproto(node_type_id, interfaces, in.strings());
+            break;
+        }
+        case snapshot_proto_start_event:
+            actions.on_proto_start(in.string());
+            break;
+        case snapshot_proto_interface_event:
+            actions.on_proto_interface(in.interface_());
+            break;
+        case snapshot_proto_default_value_start_event:
+            actions.on_proto_default_value_start();
+            break;
+        case snapshot_proto_default_value_finish_event:
+            actions.on_proto_default_value_finish();
+            break;
+        case snapshot_proto_body_start_event:
+            actions.on_proto_body_start();
+            break;
+        case snapshot_proto_finish_event:
+            actions.on_proto_finish();
+            break;
+        case snapshot_node_start_event:
+        {
+            const string node_name_id = in.string();
+            actions.on_node_start(node_name_id, in.string());
+            break;
+        }
+        case snapshot_node_finish_event:
+            actions.on_node_finish();
+            break;
+        case snapshot_script_interface_decl_event:
+            actions.on_script_interface_decl(in.interface_());
+            break;
+        case snapshot_route_event:
+        {
+            const string from = in.string();
+            const node_interface eventout = in.interface_();
+            const string to = in.string();
+            actions.on_route(from, eventout, to, in.interface_());
+            break;
+        }
+        case snapshot_use_event:
+            actions.on_use(in.string());
+            break;
+        case snapshot_is_mapping_event:
+            actions.on_is_mapping(in.string());
+            break;
+        case snapshot_field_start_event:
+        {
+            const string field_name_id = in.string();
+            actions.on_field_start(field_name_id, in.field_type());
+            break;
+        }
+        case snapshot_sfnode_event:
+            actions.on_sfnode(in.boolean());
+            break;
+        case snapshot_mfnode_event:
+            actions.on_mfnode();
+            break;
+        case snapshot_sfbool_event:
+            actions.on_sfbool(in.boolean());
+            break;
+        case snapshot_sfcolor_event:
+            actions.on_sfcolor(in.get<color>());
+            break;
+        case snapshot_mfcolor_event:
+            actions.on_mfcolor(in.array<color>());
+            break;
+        case snapshot_sffloat_event:
+            actions.on_sffloat(in.get<float>());
+            break;
+        case snapshot_mffloat_event:
+            actions.on_mffloat(in.array<float>());
+            break;
+        case snapshot_sfimage_event:
+            actions.on_sfimage(in.image());
+            break;
+        case snapshot_sfint32_event:
+            actions.on_sfint32(in.get<int32>());
+            break;
+        case snapshot_mfint32_event:
+            actions.on_mfint32(in.array<int32>());
+            break;
+        case snapshot_sfrotation_event:
+            actions.on_sfrotation(in.get<rotation>());
+            break;
+        case snapshot_mfrotation_event:
+            actions.on_mfrotation(in.array<rotation>());
+            break;
+        case snapshot_sfstring_event:
+            actions.on_sfstring(in.string());
+            break;
+        case snapshot_mfstring_event:
+            actions.on_mfstring(in.strings());
+            break;
+        case snapshot_sftime_event:
+            actions.on_sftime(in.get<double>());
+            break;
+        case snapshot_mftime_event:
+            actions.on_mftime(in.array<double>());
+            break;
+        case snapshot_sfvec2f_event:
+            actions.on_sfvec2f(in.get<vec2f>());
+            break;
+        case snapshot_mfvec2f_event:
+            actions.on_mfvec2f(in.array<vec2f>());
+            break;
+        case snapshot_sfvec3f_event:
+            actions.on_sfvec3f(in.get<vec3f>());
+            break;
+        case snapshot_mfvec3f_event:
+            actions.on_mfvec3f(in.array<vec3f>());
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    OPENVRML_LOCAL bool
+    replay_x3d_vrml_event(const openvrml::local::snapshot_event e,
+                          snapshot_reader & in,
+                          openvrml::local::x3d_vrml_parse_actions & actions)
+    {
+        using namespace openvrml;
+        using namespace openvrml::local;
+        using std::string;
+
+        switch (e) {
+        case snapshot_profile_statement_event:
+            actions.on_profile_statement(in.string());
+            break;
+        case snapshot_component_statement_event:
+        {
+            const string component_id = in.string();
+            actions.on_component_statement(component_id, in.get<int32>());
+            break;
+        }
+        case snapshot_meta_statement_event:
+        {
+            const string name = in.string();
+            actions.on_meta_statement(name, in.string());
+            break;
+        }
+        case snapshot_sfcolorrgba_event:
+            actions.on_sfcolorrgba(in.get<color_rgba>());
+            break;
+        case snapshot_sfdouble_event:
+            actions.on_sfdouble(in.get<double>());
+            break;
+        case snapshot_sfvec2d_event:
+            actions.on_sfvec2d(in.get<vec2d>());
+            break;
+        case snapshot_sfvec3d_event:
+            actions.on_sfvec3d(in.get<vec3d>());
+            break;
+        case snapshot_mfbool_event:
+            actions.on_mfbool(in.bools());
+            break;
+        case snapshot_mfcolorrgba_event:
+            actions.on_mfcolorrgba(in.array<color_rgba>());
+            break;
+        case snapshot_mfdouble_event:
+            actions.on_mfdouble(in.array<double>());
+            break;
+        case snapshot_mfimage_event:
+            actions.on_mfimage(in.images());
+            break;
+        case snapshot_mfvec2d_event:
+            actions.on_mfvec2d(in.array<vec2d>());
+            break;
+        case snapshot_mfvec3d_event:
+            actions.on_mfvec3d(in.array<vec3d>());
+            break;
+        default:
+            return replay_vrml97_event(e, in, actions);
+        }
+        return true;
+    }
+
+    template <typename Actions>
+    OPENVRML_LOCAL void
+    replay(snapshot_reader & in,
+           Actions & actions,
+           bool (*replay_event)(openvrml::local::snapshot_event,
+                                snapshot_reader &,
+                                Actions &))
+    {
+        using openvrml::local::snapshot_event;
+        using openvrml::local::snapshot_end_event;
+        for (;;) {
+            const snapshot_event e = snapshot_event(in.get<unsigned char>());
+            if (e == snapshot_end_event) { break; }
+            //
+            // Event order is checked by the parse actions only with
+            // assertions; a snapshot that is internally consistent was
+            // written by the same parse actions.
+            //
+            if (!replay_event(e, in, actions)) {
+                throw invalid_snapshot("unexpected event in scene snapshot");
+            }
+        }
+    }
+}
+
+/**
+ * @internal
+ *
+ * @enum openvrml::local::snapshot_event
+ *
+ * @brief Identifies a parse action recorded in a scene snapshot.
+ */
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::snapshot_writer
+ *
+ * @brief Accumulates a scene snapshot.
+ *
+ * A scene snapshot is the sequence of parse actions invoked while parsing
+ * a VRML or X3D VRML-encoded world, with their arguments in a compact
+ * binary form.  Replaying the actions recreates the scene, including PROTO
+ * and EXTERNPROTO definitions, DEF names, IS mappings and ROUTEs, without
+ * running the grammar.
+ */
+
+/**
+ * @internal
+ *
+ * @var std::vector<char> openvrml::local::snapshot_writer::data_
+ *
+ * @brief The snapshot data.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * Writes the snapshot header.  @p source_begin and @p source_end delimit
+ * the data from which the snapshot is generated; its size and checksums
+ * are used to determine whether the snapshot is current.
+ *
+ * @param[in] uri           the URI of the source data.
+ * @param[in] type          the media type of the source data.
+ * @param[in] source_begin  the beginning of the source data.
+ * @param[in] source_end    the end of the source data.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::local::snapshot_writer::
+snapshot_writer(const std::string & uri,
+                const std::string & type,
+                const char * const source_begin,
+                const char * const source_end)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->data_.assign(snapshot_magic,
+                       snapshot_magic + sizeof snapshot_magic);
+    this->put(snapshot_format_version);
+    this->put(snapshot_byte_order_mark);
+    this->put(boost::uint64_t(source_end - source_begin));
+    boost::uint32_t crc, adler;
+    checksum(source_begin, source_end, crc, adler);
+    this->put(crc);
+    this->put(adler);
+    this->write(std::string(PACKAGE_VERSION));
+    this->write(type);
+    this->write(uri);
+}
+
+/**
+ * @brief Begin recording a parse action.
+ *
+ * @param[in] e the parse action.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::event(const snapshot_event e)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(static_cast<unsigned char>(e));
+}
+
+/**
+ * @brief Write a boolean value.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const bool value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(static_cast<unsigned char>(value));
+}
+
+/**
+ * @brief Write an integer value.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const int32 value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a single precision floating point value.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const float value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a double precision floating point value.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const double value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c color.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const color & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c color_rgba.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const color_rgba & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c rotation.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const rotation & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c vec2f.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const vec2f & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c vec2d.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const vec2d & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c vec3f.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const vec3f & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a @c vec3d.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const vec3d & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(value);
+}
+
+/**
+ * @brief Write a string.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const std::string & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->write_size(value.size());
+    this->data_.insert(this->data_.end(), value.begin(), value.end());
+}
+
+/**
+ * @brief Write an @c image.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const image & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->write_size(value.x());
+    this->write_size(value.y());
+    this->write_size(value.comp());
+    this->write(value.array());
+}
+
+/**
+ * @brief Write a field value type identifier.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const field_value::type_id value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(static_cast<unsigned char>(value));
+}
+
+/**
+ * @brief Write a @c node_interface.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write(const node_interface & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(static_cast<unsigned char>(value.type));
+    this->write(value.field_type);
+    this->write(value.id);
+}
+
+/**
+ * @brief Write a @c node_interface_set.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::snapshot_writer::write(const node_interface_set & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->write_size(value.size());
+    for (node_interface_set::const_iterator interface_ = value.begin();
+         interface_ != value.end();
+         ++interface_) {
+        this->write(*interface_);
+    }
+}
+
+/**
+ * @brief Write an array of boolean values.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::snapshot_writer::write(const std::vector<bool> & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->write_size(value.size());
+    for (std::vector<bool>::const_iterator b = value.begin();
+         b != value.end();
+         ++b) {
+        this->write(bool(*b));
+    }
+}
+
+/**
+ * @brief Write an array of strings.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::snapshot_writer::
+write(const std::vector<std::string> & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->write_size(value.size());
+    for (std::vector<std::string>::const_iterator str = value.begin();
+         str != value.end();
+         ++str) {
+        this->write(*str);
+    }
+}
+
+/**
+ * @brief Write an array of @c image%s.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::snapshot_writer::write(const std::vector<image> & value)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->write_size(value.size());
+    for (std::vector<image>::const_iterator img = value.begin();
+         img != value.end();
+         ++img) {
+        this->write(*img);
+    }
+}
+
+/**
+ * @fn void openvrml::local::snapshot_writer::write(const std::vector<T> &)
+ *
+ * @brief Write an array of fixed-size values.
+ *
+ * The array is written in its in-memory representation, aligned so that
+ * it can be addressed directly in a mapped snapshot.
+ *
+ * @tparam T    a type that can be copied with @c std::memcpy.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+
+/**
+ * @brief Write the snapshot to a file.
+ *
+ * The snapshot is written to a temporary file in the same directory and
+ * renamed to @p path, so that a reader never sees a partially written
+ * snapshot.  The directory is created if it does not exist.
+ *
+ * @param[in] path  the file name.
+ *
+ * @exception std::runtime_error    if the file cannot be written.
+ */
+void openvrml::local::snapshot_writer::commit(const std::string & path) const
+    OPENVRML_THROW1(std::runtime_error)
+{
+    namespace fs = boost::filesystem;
+
+    std::vector<char> data = this->data_;
+    data.push_back(char(snapshot_end_event));
+
+    const fs::path target(path);
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path());
+    }
+    const fs::path temp =
+        fs::unique_path(target.string() + ".%%%%-%%%%-%%%%");
+    {
+        std::ofstream out(temp.string().c_str(),
+                          std::ios_base::out | std::ios_base::binary);
+        out.write(&data[0], std::streamsize(data.size()));
+        out.close();
+        if (!out) {
+            boost::system::error_code ec;
+            fs::remove(temp, ec);
+            throw std::runtime_error("could not write scene snapshot \""
+                                     + path + "\"");
+        }
+    }
+    try {
+        fs::rename(temp, target);
+    } catch (fs::filesystem_error &) {
+        boost::system::error_code ec;
+        fs::remove(temp, ec);
+        throw;
+    }
+}
+
+/**
+ * @fn void openvrml::local::snapshot_writer::put(const T & value)
+ *
+ * @brief Write @p value in its in-memory representation at its natural
+ *        alignment.
+ *
+ * @param[in] value the value to write.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+
+/**
+ * @brief Pad the snapshot to a multiple of @p alignment.
+ *
+ * @param[in] alignment the alignment.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::align(const std::size_t alignment)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    const std::size_t size = this->data_.size();
+    this->data_.resize(size + (alignment - size % alignment) % alignment);
+}
+
+/**
+ * @brief Write a length.
+ *
+ * @param[in] n the length.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::snapshot_writer::write_size(const std::size_t n)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    this->put(boost::uint32_t(n));
+}
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::snapshot_recorder
+ *
+ * @brief A parse action that records its invocation in a
+ *        @c snapshot_writer before delegating to another parse action.
+ *
+ * @tparam Functor  the type of the parse action.
+ */
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::vrml97_recording_parse_actions
+ *
+ * @brief Parse actions that record a scene snapshot.
+ *
+ * Each VRML97 parse action of @p Base is replaced by a
+ * @c snapshot_recorder.  If the @c snapshot_writer is null, nothing is
+ * recorded.
+ *
+ * @tparam Base @c vrml97_parse_actions or @c x3d_vrml_parse_actions.
+ */
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::x3d_vrml_recording_parse_actions
+ *
+ * @brief X3D VRML-encoding parse actions that record a scene snapshot.
+ */
+
+/**
+ * @internal
+ *
+ * @brief The file name of the snapshot for @p uri in @p cache_directory.
+ *
+ * @param[in] cache_directory   the snapshot directory.
+ * @param[in] uri               the URI of a world.
+ *
+ * @return the file name of the snapshot for @p uri.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const std::string
+openvrml::local::scene_snapshot_path(const std::string & cache_directory,
+                                     const std::string & uri)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    boost::uint32_t crc, adler;
+    const char * const first = uri.empty() ? 0 : uri.data();
+    checksum(first, first + uri.size(), crc, adler);
+    std::ostringstream name;
+    name << std::hex << std::setfill('0')
+         << std::setw(8) << crc << std::setw(8) << adler << ".snapshot";
+    return (boost::filesystem::path(cache_directory) / name.str()).string();
+}
+
+/**
+ * @internal
+ *
+ * @brief Load a scene from a snapshot.
+ *
+ * The snapshot file is mapped into memory and its parse actions are
+ * replayed; arrays of fixed-size values are copied directly from the
+ * mapping into the field values.
+ *
+ * A snapshot is used only if it was written by this version of the
+ * library on a machine with the same byte order and if the size and
+ * checksums of the source data it was generated from match those of
+ * [@p source_begin, @p source_end).  A snapshot that cannot be replayed is
+ * reported to the browser's error stream and ignored.
+ *
+ * @param[in]  path         the snapshot file name.
+ * @param[in]  source_begin the beginning of the source data.
+ * @param[in]  source_end   the end of the source data.
+ * @param[in]  uri          URI associated with the source data.
+ * @param[in]  type         media type of the source data.
+ * @param[in]  scene        a @c scene.
+ * @param[out] nodes        the root @c node%s.
+ * @param[out] meta         the @c scene metadata.
+ *
+ * @return @c true if the scene was loaded from the snapshot; @c false
+ *         otherwise.
+ */
+bool
+openvrml::local::
+load_scene_snapshot(const std::string & path,
+                    const char * const source_begin,
+                    const char * const source_end,
+                    const std::string & uri,
+                    const std::string & type,
+                    const openvrml::scene & scene,
+                    std::vector<boost::intrusive_ptr<node> > & nodes,
+                    std::map<std::string, std::string> & meta)
+{
+    using boost::algorithm::iequals;
+    namespace ip = boost::interprocess;
+
+    ip::mapped_region region;
+    try {
+        const ip::file_mapping mapping(path.c_str(), ip::read_only);
+        ip::mapped_region(mapping, ip::read_only).swap(region);
+    } catch (ip::interprocess_exception &) {
+        return false;
+    }
+
+    const char * const begin =
+        static_cast<const char *>(region.get_address());
+    snapshot_reader in(begin, begin + region.get_size());
+    try {
+        if (!std::equal(snapshot_magic,
+                        snapshot_magic + sizeof snapshot_magic,
+                        in.take(1, sizeof snapshot_magic))
+            || in.get<boost::uint32_t>() != snapshot_format_version
+            || in.get<boost::uint32_t>() != snapshot_byte_order_mark
+            || in.get<boost::uint64_t>()
+               != boost::uint64_t(source_end - source_begin)) {
+            return false;
+        }
+        boost::uint32_t crc, adler;
+        checksum(source_begin, source_end, crc, adler);
+        if (in.get<boost::uint32_t>() != crc
+            || in.get<boost::uint32_t>() != adler
+            || in.string() != PACKAGE_VERSION
+            || in.string() != type
+            || in.string() != uri) {
+            return false;
+        }
+    } catch (invalid_snapshot &) {
+        return false;
+    }
+
+    try {
+        if (iequals(type, x3d_vrml_media_type)) {
+            x3d_vrml_parse_actions actions(uri, scene, nodes, meta);
+            replay(in, actions, replay_x3d_vrml_event);
+        } else {
+            vrml97_parse_actions actions(uri, scene, nodes);
+            replay(in, actions, replay_vrml97_event);
+        }
+    } catch (std::exception & ex) {
+        nodes.clear();
+        meta.clear();
+        scene.browser().err(path + ": ignoring scene snapshot: "
+                            + ex.what());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,417 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_SCENE_SNAPSHOT_H
+#   define OPENVRML_LOCAL_SCENE_SNAPSHOT_H
+
+#   include <openvrml/local/parse_vrml.h>
+#   include <boost/cstdint.hpp>
+#   include <boost/noncopyable.hpp>
+#   include <boost/type_traits/alignment_of.hpp>
+#   include <cstring>
+#   include <stdexcept>
+
+namespace openvrml {
+
+    namespace local {
+
+        enum snapshot_event {
+            snapshot_end_event,
+            snapshot_scene_start_event,
+            snapshot_scene_finish_event,
+            snapshot_externproto_event,
+            snapshot_proto_start_event,
+            snapshot_proto_interface_event,
+            snapshot_proto_default_value_start_event,
+            snapshot_proto_default_value_finish_event,
+            snapshot_proto_body_start_event,
+            snapshot_proto_finish_event,
+            snapshot_node_start_event,
+            snapshot_node_finish_event,
+            snapshot_script_interface_decl_event,
+            snapshot_route_event,
+            snapshot_use_event,
+            snapshot_is_mapping_event,
+            snapshot_field_start_event,
+            snapshot_sfnode_event,
+            snapshot_mfnode_event,
+            snapshot_sfbool_event,
+            snapshot_sfcolor_event,
+            snapshot_mfcolor_event,
+            snapshot_sffloat_event,
+            snapshot_mffloat_event,
+            snapshot_sfimage_event,
+            snapshot_sfint32_event,
+            snapshot_mfint32_event,
+            snapshot_sfrotation_event,
+            snapshot_mfrotation_event,
+            snapshot_sfstring_event,
+            snapshot_mfstring_event,
+            snapshot_sftime_event,
+            snapshot_mftime_event,
+            snapshot_sfvec2f_event,
+            snapshot_mfvec2f_event,
+            snapshot_sfvec3f_event,
+            snapshot_mfvec3f_event,
+            snapshot_profile_statement_event,
+            snapshot_component_statement_event,
+            snapshot_meta_statement_event,
+            snapshot_sfcolorrgba_event,
+            snapshot_sfdouble_event,
+            snapshot_sfvec2d_event,
+            snapshot_sfvec3d_event,
+            snapshot_mfbool_event,
+            snapshot_mfcolorrgba_event,
+            snapshot_mfdouble_event,
+            snapshot_mfimage_event,
+            snapshot_mfvec2d_event,
+            snapshot_mfvec3d_event
+        };
+
+        class OPENVRML_LOCAL snapshot_writer : boost::noncopyable {
+            std::vector<char> data_;
+
+        public:
+            snapshot_writer(const std::string & uri,
+                            const std::string & type,
+                            const char * source_begin,
+                            const char * source_end)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            void event(snapshot_event e) OPENVRML_THROW1(std::bad_alloc);
+
+            void write(bool value) OPENVRML_THROW1(std::bad_alloc);
+            void write(int32 value) OPENVRML_THROW1(std::bad_alloc);
+            void write(float value) OPENVRML_THROW1(std::bad_alloc);
+            void write(double value) OPENVRML_THROW1(std::bad_alloc);
+            void write(const color & value) OPENVRML_THROW1(std::bad_alloc);
+            void write(const color_rgba & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const rotation & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const vec2f & value) OPENVRML_THROW1(std::bad_alloc);
+            void write(const vec2d & value) OPENVRML_THROW1(std::bad_alloc);
+            void write(const vec3f & value) OPENVRML_THROW1(std::bad_alloc);
+            void write(const vec3d & value) OPENVRML_THROW1(std::bad_alloc);
+            void write(const std::string & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const image & value) OPENVRML_THROW1(std::bad_alloc);
+            void write(field_value::type_id value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const node_interface & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const node_interface_set & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const std::vector<bool> & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const std::vector<std::string> & value)
+                OPENVRML_THROW1(std::bad_alloc);
+            void write(const std::vector<image> & value)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            template <typename T>
+            void write(const std::vector<T> & value)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            void commit(const std::string & path) const
+                OPENVRML_THROW1(std::runtime_error);
+
+        private:
+            template <typename T>
+            void put(const T & value) OPENVRML_THROW1(std::bad_alloc);
+            void align(std::size_t alignment) OPENVRML_THROW1(std::bad_alloc);
+            void write_size(std::size_t n) OPENVRML_THROW1(std::bad_alloc);
+        };
+
+        template <typename T>
+        void snapshot_writer::put(const T & value)
+            OPENVRML_THROW1(std::bad_alloc)
+        {
+            this->align(boost::alignment_of<T>::value);
+            const std::size_t offset = this->data_.size();
+            this->data_.resize(offset + sizeof value);
+            std::memcpy(&this->data_[offset], &value, sizeof value);
+        }
+
+        //
+        // Arrays of fixed-size values are written in their in-memory
+        // representation, aligned so that a reader can address them
+        // directly in a mapped file.
+        //
+        template <typename T>
+        void snapshot_writer::write(const std::vector<T> & value)
+            OPENVRML_THROW1(std::bad_alloc)
+        {
+            this->write_size(value.size());
+            this->align(sizeof (boost::uint64_t));
+            if (value.empty()) { return; }
+            const std::size_t offset = this->data_.size();
+            const std::size_t n = value.size() * sizeof (T);
+            this->data_.resize(offset + n);
+            std::memcpy(&this->data_[offset], &value[0], n);
+        }
+
+
+        template <typename Functor>
+        class snapshot_recorder {
+            const Functor & action_;
+            snapshot_writer * writer_;
+            snapshot_event event_;
+
+        public:
+            snapshot_recorder(const Functor & action,
+                              snapshot_writer * writer,
+                              const snapshot_event e):
+                action_(action),
+                writer_(writer),
+                event_(e)
+            {}
+
+            void operator()() const
+            {
+                if (this->writer_) { this->writer_->event(this->event_); }
+                this->action_();
+            }
+
+            template <typename A1>
+            void operator()(const A1 & a1) const
+            {
+                if (this->writer_) {
+                    this->writer_->event(this->event_);
+                    this->writer_->write(a1);
+                }
+                this->action_(a1);
+            }
+
+            template <typename A1, typename A2>
+            void operator()(const A1 & a1, const A2 & a2) const
+            {
+                if (this->writer_) {
+                    this->writer_->event(this->event_);
+                    this->writer_->write(a1);
+                    this->writer_->write(a2);
+                }
+                this->action_(a1, a2);
+            }
+
+            template <typename A1, typename A2, typename A3>
+            void operator()(const A1 & a1, const A2 & a2, const A3 & a3) const
+            {
+                if (this->writer_) {
+                    this->writer_->event(this->event_);
+                    this->writer_->write(a1);
+                    this->writer_->write(a2);
+                    this->writer_->write(a3);
+                }
+                this->action_(a1, a2, a3);
+            }
+
+            template <typename A1, typename A2, typename A3, typename A4>
+            void operator()(const A1 & a1, const A2 & a2, const A3 & a3,
+                            const A4 & a4) const
+            {
+                if (this->writer_) {
+                    this->writer_->event(this->event_);
+                    this->writer_->write(a1);
+                    this->writer_->write(a2);
+                    this->writer_->write(a3);
+                    this->writer_->write(a4);
+                }
+                this->action_(a1, a2, a3, a4);
+            }
+        };
+
+
+#   define OPENVRML_SNAPSHOT_RECORD_(event_) \
+        on_##event_(Base::on_##event_, writer, snapshot_##event_##_event)
+
+#   define OPENVRML_VRML97_SNAPSHOT_RECORDS_ \
+        OPENVRML_SNAPSHOT_RECORD_(scene_start), \
+        OPENVRML_SNAPSHOT_RECORD_(scene_finish), \
+        OPENVRML_SNAPSHOT_RECORD_(externproto), \
+        OPENVRML_SNAPSHOT_RECORD_(proto_start), \
+        OPENVRML_SNAPSHOT_RECORD_(proto_interface), \
+        OPENVRML_SNAPSHOT_RECORD_(proto_default_value_start), \
+        OPENVRML_SNAPSHOT_RECORD_(proto_default_value_finish), \
+        OPENVRML_SNAPSHOT_RECORD_(proto_body_start), \
+        OPENVRML_SNAPSHOT_RECORD_(proto_finish), \
+        OPENVRML_SNAPSHOT_RECORD_(node_start), \
+        OPENVRML_SNAPSHOT_RECORD_(node_finish), \
+        OPENVRML_SNAPSHOT_RECORD_(script_interface_decl), \
+        OPENVRML_SNAPSHOT_RECORD_(route), \
+        OPENVRML_SNAPSHOT_RECORD_(use), \
+        OPENVRML_SNAPSHOT_RECORD_(is_mapping), \
+        OPENVRML_SNAPSHOT_RECORD_(field_start), \
+        OPENVRML_SNAPSHOT_RECORD_(sfnode), \
+        OPENVRML_SNAPSHOT_RECORD_(mfnode), \
+        OPENVRML_SNAPSHOT_RECORD_(sfbool), \
+        OPENVRML_SNAPSHOT_RECORD_(sfcolor), \
+        OPENVRML_SNAPSHOT_RECORD_(mfcolor), \
+        OPENVRML_SNAPSHOT_RECORD_(sffloat), \
+        OPENVRML_SNAPSHOT_RECORD_(mffloat), \
+        OPENVRML_SNAPSHOT_RECORD_(sfimage), \
+        OPENVRML_SNAPSHOT_RECORD_(sfint32), \
+        OPENVRML_SNAPSHOT_RECORD_(mfint32), \
+        OPENVRML_SNAPSHOT_RECORD_(sfrotation), \
+        OPENVRML_SNAPSHOT_RECORD_(mfrotation), \
+        OPENVRML_SNAPSHOT_RECORD_(sfstring), \
+        OPENVRML_SNAPSHOT_RECORD_(mfstring), \
+        OPENVRML_SNAPSHOT_RECORD_(sftime), \
+        OPENVRML_SNAPSHOT_RECORD_(mftime), \
+        OPENVRML_SNAPSHOT_RECORD_(sfvec2f), \
+        OPENVRML_SNAPSHOT_RECORD_(mfvec2f), \
+        OPENVRML_SNAPSHOT_RECORD_(sfvec3f), \
+        OPENVRML_SNAPSHOT_RECORD_(mfvec3f)
+
+        template <typename Base>
+        struct OPENVRML_LOCAL vrml97_recording_parse_actions : Base {
+            vrml97_recording_parse_actions(
+                const std::string & uri,
+                const openvrml::scene & scene,
+                std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+                snapshot_writer * writer):
+                Base(uri, scene, nodes),
+                OPENVRML_VRML97_SNAPSHOT_RECORDS_
+            {}
+
+            vrml97_recording_parse_actions(
+                const std::string & uri,
+                const openvrml::scene & scene,
+                std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+                std::map<std::string, std::string> & meta,
+                snapshot_writer * writer):
+                Base(uri, scene, nodes, meta),
+                OPENVRML_VRML97_SNAPSHOT_RECORDS_
+            {}
+
+            snapshot_recorder<typename Base::on_scene_start_t> on_scene_start;
+            snapshot_recorder<typename Base::on_scene_finish_t>
+                on_scene_finish;
+            snapshot_recorder<typename Base::on_externproto_t> on_externproto;
+            snapshot_recorder<typename Base::on_proto_start_t> on_proto_start;
+            snapshot_recorder<typename Base::on_proto_interface_t>
+                on_proto_interface;
+            snapshot_recorder<typename Base::on_proto_default_value_start_t>
+                on_proto_default_value_start;
+            snapshot_recorder<typename Base::on_proto_default_value_finish_t>
+                on_proto_default_value_finish;
+            snapshot_recorder<typename Base::on_proto_body_start_t>
+                on_proto_body_start;
+            snapshot_recorder<typename Base::on_proto_finish_t>
+                on_proto_finish;
+            snapshot_recorder<typename Base::on_node_start_t> on_node_start;
+            snapshot_recorder<typename Base::on_node_finish_t> on_node_finish;
+            snapshot_recorder<typename Base::on_script_interface_decl_t>
+                on_script_interface_decl;
+            snapshot_recorder<typename Base::on_route_t> on_route;
+            snapshot_recorder<typename Base::on_use_t> on_use;
+            snapshot_recorder<typename Base::on_is_mapping_t> on_is_mapping;
+            snapshot_recorder<typename Base::on_field_start_t> on_field_start;
+            snapshot_recorder<typename Base::on_sfnode_t> on_sfnode;
+            snapshot_recorder<typename Base::on_mfnode_t> on_mfnode;
+            snapshot_recorder<typename Base::on_sfbool_t> on_sfbool;
+            snapshot_recorder<typename Base::on_sfcolor_t> on_sfcolor;
+            snapshot_recorder<typename Base::on_mfcolor_t> on_mfcolor;
+            snapshot_recorder<typename Base::on_sffloat_t> on_sffloat;
+            snapshot_recorder<typename Base::on_mffloat_t> on_mffloat;
+            snapshot_recorder<typename Base::on_sfimage_t> on_sfimage;
+            snapshot_recorder<typename Base::on_sfint32_t> on_sfint32;
+            snapshot_recorder<typename Base::on_mfint32_t> on_mfint32;
+            snapshot_recorder<typename Base::on_sfrotation_t> on_sfrotation;
+            snapshot_recorder<typename Base::on_mfrotation_t> on_mfrotation;
+            snapshot_recorder<typename Base::on_sfstring_t> on_sfstring;
+            snapshot_recorder<typename Base::on_mfstring_t> on_mfstring;
+            snapshot_recorder<typename Base::on_sftime_t> on_sftime;
+            snapshot_recorder<typename Base::on_mftime_t> on_mftime;
+            snapshot_recorder<typename Base::on_sfvec2f_t> on_sfvec2f;
+            snapshot_recorder<typename Base::on_mfvec2f_t> on_mfvec2f;
+            snapshot_recorder<typename Base::on_sfvec3f_t> on_sfvec3f;
+            snapshot_recorder<typename Base::on_mfvec3f_t> on_mfvec3f;
+        };
+
+        struct OPENVRML_LOCAL x3d_vrml_recording_parse_actions :
+            vrml97_recording_parse_actions<x3d_vrml_parse_actions> {
+
+            typedef x3d_vrml_parse_actions Base;
+
+            x3d_vrml_recording_parse_actions(
+                const std::string & uri,
+                const openvrml::scene & scene,
+                std::vector<boost::intrusive_ptr<openvrml::node> > & nodes,
+                std::map<std::string, std::string> & meta,
+                snapshot_writer * writer):
+                vrml97_recording_parse_actions<x3d_vrml_parse_actions>(
+                    uri, scene, nodes, meta, writer),
+                OPENVRML_SNAPSHOT_RECORD_(profile_statement),
+                OPENVRML_SNAPSHOT_RECORD_(component_statement),
+                OPENVRML_SNAPSHOT_RECORD_(meta_statement),
+                OPENVRML_SNAPSHOT_RECORD_(sfcolorrgba),
+                OPENVRML_SNAPSHOT_RECORD_(sfdouble),
+                OPENVRML_SNAPSHOT_RECORD_(sfvec2d),
+                OPENVRML_SNAPSHOT_RECORD_(sfvec3d),
+                OPENVRML_SNAPSHOT_RECORD_(mfbool),
+                OPENVRML_SNAPSHOT_RECORD_(mfcolorrgba),
+                OPENVRML_SNAPSHOT_RECORD_(mfdouble),
+                OPENVRML_SNAPSHOT_RECORD_(mfimage),
+                OPENVRML_SNAPSHOT_RECORD_(mfvec2d),
+                OPENVRML_SNAPSHOT_RECORD_(mfvec3d)
+            {}
+
+            snapshot_recorder<Base::on_profile_statement_t>
+                on_profile_statement;
+            snapshot_recorder<Base::on_component_statement_t>
+                on_component_statement;
+            snapshot_recorder<Base::on_meta_statement_t> on_meta_statement;
+            snapshot_recorder<Base::on_sfcolorrgba_t> on_sfcolorrgba;
+            snapshot_recorder<Base::on_sfdouble_t> on_sfdouble;
+            snapshot_recorder<Base::on_sfvec2d_t> on_sfvec2d;
+            snapshot_recorder<Base::on_sfvec3d_t> on_sfvec3d;
+            snapshot_recorder<Base::on_mfbool_t> on_mfbool;
+            snapshot_recorder<Base::on_mfcolorrgba_t> on_mfcolorrgba;
+            snapshot_recorder<Base::on_mfdouble_t> on_mfdouble;
+            snapshot_recorder<Base::on_mfimage_t> on_mfimage;
+            snapshot_recorder<Base::on_mfvec2d_t> on_mfvec2d;
+            snapshot_recorder<Base::on_mfvec3d_t> on_mfvec3d;
+        };
+
+#   undef OPENVRML_VRML97_SNAPSHOT_RECORDS_
+#   undef OPENVRML_SNAPSHOT_RECORD_
+
+
+        OPENVRML_LOCAL
+        const std::string
+        scene_snapshot_path(const std::string & cache_directory,
+                            const std::string & uri)
+            OPENVRML_THROW1(std::bad_alloc);
+
+        OPENVRML_LOCAL
+        bool load_scene_snapshot(const std::string & path,
+                                 const char * source_begin,
+                                 const char * source_end,
+                                 const std::string & uri,
+                                 const std::string & type,
+                                 const openvrml::scene & scene,
+                                 std::vector<boost::intrusive_ptr<node> > &
+                                     nodes,
+                                 std::map<std::string, std::string> & meta);
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_SCENE_SNAPSHOT_H
@@ -0,0 +1,302 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "thread_pool.h"
+# include <boost/bind.hpp>
+# include <cassert>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::thread_pool
+ *
+ * @brief A fixed-size, work-stealing pool of threads.
+ *
+ * Each worker has its own queue of tasks.  A worker takes tasks from the back
+ * of its own queue; when that is empty, it steals from the front of the
+ * other workers' queues.  Tasks submitted from outside the pool are
+ * distributed among the workers' queues round-robin.
+ *
+ * A thread that calls @c #wait helps execute the pending tasks rather than
+ * blocking while they are run.
+ *
+ * Tasks must not throw; any exception that escapes a task is discarded.
+ */
+
+/**
+ * @internal
+ *
+ * @typedef boost::function0<void> openvrml::local::thread_pool::task
+ *
+ * @brief A unit of work.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::thread_pool::worker_queue
+ *
+ * @brief The tasks pending for a worker.
+ */
+
+/**
+ * @var boost::ptr_vector<openvrml::local::thread_pool::worker_queue> openvrml::local::thread_pool::queues_
+ *
+ * @brief The task queue for each worker.
+ */
+
+/**
+ * @var boost::thread_group openvrml::local::thread_pool::threads_
+ *
+ * @brief The worker threads.
+ */
+
+/**
+ * @var boost::mutex openvrml::local::thread_pool::mutex_
+ *
+ * @brief Mutex protecting the counters and @c #shutdown_.
+ */
+
+/**
+ * @var boost::condition_variable openvrml::local::thread_pool::work_available_
+ *
+ * @brief Signaled when a task is submitted or the pool is shut down.
+ */
+
+/**
+ * @var boost::condition_variable openvrml::local::thread_pool::work_done_
+ *
+ * @brief Signaled when the last outstanding task completes.
+ */
+
+/**
+ * @var std::size_t openvrml::local::thread_pool::queued_
+ *
+ * @brief The number of tasks waiting in the queues.
+ */
+
+/**
+ * @var std::size_t openvrml::local::thread_pool::outstanding_
+ *
+ * @brief The number of tasks that have been submitted and not yet completed.
+ */
+
+/**
+ * @var std::size_t openvrml::local::thread_pool::next_queue_
+ *
+ * @brief The queue that will receive the next task submitted from outside
+ *        the pool.
+ */
+
+/**
+ * @var bool openvrml::local::thread_pool::shutdown_
+ *
+ * @brief Whether the pool is being destroyed.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * @param[in] threads   the number of worker threads; must be greater than 0.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if a thread cannot be started.
+ */
+openvrml::local::thread_pool::thread_pool(const std::size_t threads)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error):
+    queued_(0),
+    outstanding_(0),
+    next_queue_(0),
+    shutdown_(false)
+{
+    assert(threads > 0);
+    for (std::size_t i = 0; i < threads; ++i) {
+        this->queues_.push_back(new worker_queue);
+    }
+    try {
+        for (std::size_t i = 0; i < threads; ++i) {
+            this->threads_.create_thread(
+                boost::bind(&thread_pool::run, this, i));
+        }
+    } catch (...) {
+        {
+            boost::lock_guard<boost::mutex> lock(this->mutex_);
+            this->shutdown_ = true;
+        }
+        this->work_available_.notify_all();
+        this->threads_.join_all();
+        throw;
+    }
+}
+
+/**
+ * @brief Destroy.
+ *
+ * Any tasks still pending are run before the workers exit.
+ */
+openvrml::local::thread_pool::~thread_pool() OPENVRML_NOTHROW
+{
+    {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        this->shutdown_ = true;
+    }
+    this->work_available_.notify_all();
+    this->threads_.join_all();
+}
+
+/**
+ * @brief The number of worker threads.
+ *
+ * @return the number of worker threads.
+ */
+std::size_t openvrml::local::thread_pool::size() const OPENVRML_NOTHROW
+{
+    return this->queues_.size();
+}
+
+/**
+ * @brief Submit a task.
+ *
+ * @param[in] t the task.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::local::thread_pool::submit(const task & t)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        worker_queue & q = this->queues_[this->next_queue_];
+        {
+            boost::lock_guard<boost::mutex> queue_lock(q.mutex);
+            q.tasks.push_back(t);
+        }
+        this->next_queue_ = (this->next_queue_ + 1) % this->queues_.size();
+        ++this->queued_;
+        ++this->outstanding_;
+    }
+    this->work_available_.notify_one();
+}
+
+/**
+ * @brief Wait for all submitted tasks to complete.
+ *
+ * The calling thread executes pending tasks until none remain, and then
+ * waits for those still running on the workers.  This must not be called
+ * from a task.
+ */
+void openvrml::local::thread_pool::wait() OPENVRML_NOTHROW
+{
+    task t;
+    while (this->take(this->queues_.size(), t)) {
+        this->execute(t);
+    }
+    boost::unique_lock<boost::mutex> lock(this->mutex_);
+    while (this->outstanding_ > 0) { this->work_done_.wait(lock); }
+}
+
+/**
+ * @brief The body of a worker thread.
+ *
+ * @param[in] index the index of the worker's queue.
+ */
+void openvrml::local::thread_pool::run(const std::size_t index)
+    OPENVRML_NOTHROW
+{
+    task t;
+    for (;;) {
+        if (this->take(index, t)) {
+            this->execute(t);
+            continue;
+        }
+        boost::unique_lock<boost::mutex> lock(this->mutex_);
+        while (this->queued_ == 0 && !this->shutdown_) {
+            this->work_available_.wait(lock);
+        }
+        if (this->queued_ == 0 && this->shutdown_) { return; }
+    }
+}
+
+/**
+ * @brief Take a task.
+ *
+ * A worker takes the most recently queued task from its own queue; failing
+ * that, it steals the least recently queued task from another queue.
+ *
+ * @param[in] index the index of the calling worker's queue, or
+ *                  @c #size() if the calling thread is not a worker.
+ * @param[out] t    the task, if one was taken.
+ *
+ * @return @c true if a task was taken; @c false otherwise.
+ */
+bool openvrml::local::thread_pool::take(const std::size_t index, task & t)
+    OPENVRML_NOTHROW
+{
+    const std::size_t size = this->queues_.size();
+    bool taken = false;
+    if (index < size) {
+        worker_queue & own = this->queues_[index];
+        boost::lock_guard<boost::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            t.swap(own.tasks.back());
+            own.tasks.pop_back();
+            taken = true;
+        }
+    }
+    for (std::size_t i = 1; !taken && i <= size; ++i) {
+        worker_queue & victim = this->queues_[(index + i) % size];
+        boost::lock_guard<boost::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            t.swap(victim.tasks.front());
+            victim.tasks.pop_front();
+            taken = true;
+        }
+    }
+    if (taken) {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        --this->queued_;
+    }
+    return taken;
+}
+
+/**
+ * @brief Execute a task and account for its completion.
+ *
+ * @param[in,out] t the task; it is cleared after it has been run.
+ */
+void openvrml::local::thread_pool::execute(task & t) OPENVRML_NOTHROW
+{
+    try {
+        t();
+    } catch (...) {
+        assert(!"exception escaped a thread_pool task");
+    }
+    t.clear();
+    bool done;
+    {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        done = (--this->outstanding_ == 0);
+    }
+    if (done) { this->work_done_.notify_all(); }
+}
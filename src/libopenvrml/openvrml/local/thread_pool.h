@@ -0,0 +1,73 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_THREAD_POOL_H
+#   define OPENVRML_LOCAL_THREAD_POOL_H
+
+#   include <openvrml-common.h>
+#   include <boost/function.hpp>
+#   include <boost/ptr_container/ptr_vector.hpp>
+#   include <boost/thread.hpp>
+#   include <deque>
+
+namespace openvrml {
+
+    namespace local {
+
+        class OPENVRML_LOCAL thread_pool : boost::noncopyable {
+        public:
+            typedef boost::function0<void> task;
+
+        private:
+            struct worker_queue {
+                boost::mutex mutex;
+                std::deque<task> tasks;
+            };
+
+            boost::ptr_vector<worker_queue> queues_;
+            boost::thread_group threads_;
+
+            boost::mutex mutex_;
+            boost::condition_variable work_available_;
+            boost::condition_variable work_done_;
+            std::size_t queued_;
+            std::size_t outstanding_;
+            std::size_t next_queue_;
+            bool shutdown_;
+
+        public:
+            explicit thread_pool(std::size_t threads)
+                OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error);
+            ~thread_pool() OPENVRML_NOTHROW;
+
+            std::size_t size() const OPENVRML_NOTHROW;
+
+            void submit(const task & t) OPENVRML_THROW1(std::bad_alloc);
+            void wait() OPENVRML_NOTHROW;
+
+        private:
+            void run(std::size_t index) OPENVRML_NOTHROW;
+            bool take(std::size_t index, task & t) OPENVRML_NOTHROW;
+            void execute(task & t) OPENVRML_NOTHROW;
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_THREAD_POOL_H
@@ -0,0 +1,425 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "timer_scheduler.h"
+# include "event_queue.h"
+# include "thread_pool.h"
+# include <openvrml/node.h>
+# include <openvrml/event.h>
+# include <boost/atomic.hpp>
+# include <boost/scoped_array.hpp>
+# include <algorithm>
+# include <map>
+# include <set>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+namespace {
+
+    //
+    // Incremented whenever a ROUTE is added or deleted anywhere.
+    //
+    boost::atomic<std::size_t> route_revision(0);
+
+    //
+    // Disjoint sets of nodes connected by ROUTEs.
+    //
+    class OPENVRML_LOCAL node_sets {
+        std::map<openvrml::node *, openvrml::node *> parent_;
+
+    public:
+        bool insert(openvrml::node & n) OPENVRML_THROW1(std::bad_alloc)
+        {
+            return this->parent_.insert(std::make_pair(&n, &n)).second;
+        }
+
+        openvrml::node * find(openvrml::node & n) OPENVRML_NOTHROW
+        {
+            openvrml::node * root = &n;
+            while (this->parent_[root] != root) {
+                root = this->parent_[root];
+            }
+            //
+            // Path compression.
+            //
+            openvrml::node * current = &n;
+            while (current != root) {
+                openvrml::node * const next = this->parent_[current];
+                this->parent_[current] = root;
+                current = next;
+            }
+            return root;
+        }
+
+        void join(openvrml::node & lhs, openvrml::node & rhs)
+            OPENVRML_NOTHROW
+        {
+            openvrml::node * const lhs_root = this->find(lhs);
+            openvrml::node * const rhs_root = this->find(rhs);
+            if (lhs_root != rhs_root) { this->parent_[rhs_root] = lhs_root; }
+        }
+    };
+
+    //
+    // Nodes whose event processing has effects beyond the nodes they are
+    // routed to: Script nodes; PROTO instances, whose implementations are
+    // connected by IS mappings rather than ROUTEs; bindable nodes, which
+    // share a bind stack with all the other nodes of their type; and Inline
+    // nodes, which load new scenes.
+    //
+    OPENVRML_LOCAL bool requires_serial_update(openvrml::node & n)
+        OPENVRML_NOTHROW
+    {
+        using openvrml::node_cast;
+        using openvrml::script_node;
+        if (node_cast<script_node *>(&n)) { return true; }
+        if (openvrml::is_proto_instance(n)) { return true; }
+        const openvrml::node_interface_set & interfaces =
+            n.type().interfaces();
+        if (openvrml::find_interface(interfaces, "set_bind")
+            != interfaces.end()) {
+            return true;
+        }
+        try {
+            static const openvrml::node_metatype_id
+                inline_id("urn:X-openvrml:node:Inline");
+            return n.type().metatype().id() == inline_id;
+        } catch (std::bad_alloc &) {
+            return true;
+        }
+    }
+
+    struct OPENVRML_LOCAL update_component {
+        update_component(
+            const openvrml::local::timer_scheduler::component & c,
+            const double current_time,
+            openvrml::local::event_queue * const queue,
+            bool & failed):
+            component_(&c),
+            current_time_(current_time),
+            queue_(queue),
+            failed_(&failed)
+        {}
+
+        void operator()() const OPENVRML_NOTHROW
+        {
+            using openvrml::local::event_queue;
+            try {
+                typedef std::vector<openvrml::time_dependent_node *>
+                    timer_list;
+                event_queue::scope queue_scope(this->queue_);
+                const timer_list & timers = this->component_->timers;
+                for (timer_list::const_iterator timer = timers.begin();
+                     timer != timers.end();
+                     ++timer) {
+                    (*timer)->update(this->current_time_);
+                }
+                if (this->queue_) { this->queue_->drain(); }
+            } catch (std::bad_alloc &) {
+                *this->failed_ = true;
+            }
+        }
+
+    private:
+        const openvrml::local::timer_scheduler::component * component_;
+        double current_time_;
+        openvrml::local::event_queue * queue_;
+        bool * failed_;
+    };
+}
+
+/**
+ * @internal
+ *
+ * @class openvrml::local::timer_scheduler
+ *
+ * @brief Update independent time-dependent nodes concurrently.
+ *
+ * The @c time_dependent_node%s are partitioned into components that are not
+ * connected by ROUTEs, directly or indirectly; the nodes in one component
+ * cannot send events to those in another.  Each component is updated as a
+ * task on a @c thread_pool, with its timers updated in the order in which
+ * they appear in the @c browser's list; @c #update returns only once every
+ * component has been updated.
+ *
+ * A component that includes a node whose event processing can affect nodes
+ * it is not routed to (see @c requires_serial_update), or an eventOut with
+ * a listener that does not belong to a node, is updated on the calling
+ * thread instead.
+ *
+ * The partition is cached; it is recomputed when the list of timers changes
+ * or when a ROUTE is added or deleted.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::local::timer_scheduler::component
+ *
+ * @brief A set of @c time_dependent_node%s that may be connected by ROUTEs.
+ */
+
+/**
+ * @var std::vector<openvrml::time_dependent_node *> openvrml::local::timer_scheduler::component::timers
+ *
+ * @brief The timers in the component, in update order.
+ */
+
+/**
+ * @var bool openvrml::local::timer_scheduler::component::serial
+ *
+ * @brief Whether the component must be updated on the calling thread.
+ */
+
+/**
+ * @var std::vector<openvrml::time_dependent_node *> openvrml::local::timer_scheduler::timers_
+ *
+ * @brief The timers for which @c #components_ was computed.
+ */
+
+/**
+ * @var std::size_t openvrml::local::timer_scheduler::route_revision_
+ *
+ * @brief The ROUTE revision for which @c #components_ was computed.
+ */
+
+/**
+ * @var bool openvrml::local::timer_scheduler::valid_
+ *
+ * @brief Whether @c #components_ has been computed.
+ */
+
+/**
+ * @var openvrml::local::timer_scheduler::component_list openvrml::local::timer_scheduler::components_
+ *
+ * @brief The cached partition.
+ */
+
+/**
+ * @var boost::ptr_vector<openvrml::local::event_queue> openvrml::local::timer_scheduler::queues_
+ *
+ * @brief An @c event_queue for each component, used when the queued event
+ *        cascade is enabled.
+ */
+
+/**
+ * @brief Note that a ROUTE has been added or deleted.
+ */
+void openvrml::local::timer_scheduler::routes_changed() OPENVRML_NOTHROW
+{
+    ++route_revision;
+}
+
+/**
+ * @brief Construct.
+ */
+openvrml::local::timer_scheduler::timer_scheduler() OPENVRML_NOTHROW:
+    route_revision_(0),
+    valid_(false)
+{}
+
+/**
+ * @brief Destroy.
+ */
+openvrml::local::timer_scheduler::~timer_scheduler() OPENVRML_NOTHROW
+{}
+
+/**
+ * @brief Partition @p timers into independent components.
+ *
+ * @param[in] timers    the @c time_dependent_node%s to partition.
+ *
+ * @return the components, ordered by the position of their first timer in
+ *         @p timers.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+const openvrml::local::timer_scheduler::component_list &
+openvrml::local::timer_scheduler::
+partition(const std::list<time_dependent_node *> & timers)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    const std::size_t revision = route_revision.load();
+    if (this->valid_
+        && this->route_revision_ == revision
+        && this->timers_.size() == timers.size()
+        && std::equal(timers.begin(), timers.end(), this->timers_.begin())) {
+        return this->components_;
+    }
+    this->valid_ = false;
+
+    node_sets sets;
+    std::vector<node *> pending, visited;
+    std::set<node *> serial_nodes;
+
+    for (std::list<time_dependent_node *>::const_iterator timer =
+             timers.begin();
+         timer != timers.end();
+         ++timer) {
+        node & n = **timer;
+        if (sets.insert(n)) { pending.push_back(&n); }
+    }
+
+    while (!pending.empty()) {
+        node & n = *pending.back();
+        pending.pop_back();
+        visited.push_back(&n);
+        if (requires_serial_update(n)) { serial_nodes.insert(&n); }
+
+        const node_interface_set & interfaces = n.type().interfaces();
+        for (node_interface_set::const_iterator interface_ =
+                 interfaces.begin();
+             interface_ != interfaces.end();
+             ++interface_) {
+            if (interface_->type != node_interface::eventout_id
+                && interface_->type != node_interface::exposedfield_id) {
+                continue;
+            }
+            openvrml::event_emitter * emitter;
+            try {
+                emitter = &n.event_emitter(interface_->id);
+            } catch (unsupported_interface &) {
+                continue;
+            }
+            boost::shared_lock<boost::shared_mutex>
+                lock(emitter->listeners_mutex_);
+            for (event_emitter::listener_set::const_iterator listener =
+                     emitter->listeners_.begin();
+                 listener != emitter->listeners_.end();
+                 ++listener) {
+                node_event_listener * const node_listener =
+                    dynamic_cast<node_event_listener *>(*listener);
+                if (!node_listener) {
+                    serial_nodes.insert(&n);
+                    continue;
+                }
+                node & target = node_listener->node();
+                if (sets.insert(target)) { pending.push_back(&target); }
+                sets.join(n, target);
+            }
+        }
+    }
+
+    std::set<node *> serial_roots;
+    for (std::set<node *>::const_iterator n = serial_nodes.begin();
+         n != serial_nodes.end();
+         ++n) {
+        serial_roots.insert(sets.find(**n));
+    }
+
+    component_list components;
+    std::map<node *, std::size_t> component_index;
+    for (std::list<time_dependent_node *>::const_iterator timer =
+             timers.begin();
+         timer != timers.end();
+         ++timer) {
+        node * const root = sets.find(**timer);
+        const std::pair<std::map<node *, std::size_t>::iterator, bool>
+            result = component_index.insert(
+                std::make_pair(root, components.size()));
+        if (result.second) {
+            components.push_back(component());
+            components.back().serial =
+                serial_roots.find(root) != serial_roots.end();
+        }
+        components[result.first->second].timers.push_back(*timer);
+    }
+
+    boost::ptr_vector<event_queue> queues;
+    for (std::size_t i = 0; i < components.size(); ++i) {
+        queues.push_back(new event_queue);
+    }
+
+    this->timers_.assign(timers.begin(), timers.end());
+    this->components_.swap(components);
+    this->queues_.swap(queues);
+    this->route_revision_ = revision;
+    this->valid_ = true;
+    return this->components_;
+}
+
+/**
+ * @brief Update @p timers.
+ *
+ * Components that can be updated concurrently are submitted to @p pool;
+ * the rest are updated on the calling thread.  If @p queue is not null, each
+ * concurrently updated component gets its own @c event_queue, which is
+ * drained before the task completes; its counters are added to those of
+ * @p queue.
+ *
+ * @param[in] timers        the @c time_dependent_node%s to update.
+ * @param[in] current_time  the current time.
+ * @param[in] pool          the @c thread_pool.
+ * @param[in] queue         the calling thread's @c event_queue, or null if
+ *                          events are dispatched immediately.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::local::timer_scheduler::
+update(const std::list<time_dependent_node *> & timers,
+       const double current_time,
+       thread_pool & pool,
+       event_queue * const queue)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    const component_list & components = this->partition(timers);
+
+    //
+    // std::vector<bool> is not safe for concurrent writes to distinct
+    // elements.
+    //
+    boost::scoped_array<bool> failed(new bool[components.size()]);
+    std::fill(failed.get(), failed.get() + components.size(), false);
+
+    //
+    // Submit the concurrent components first so that the workers can start
+    // on them while the serial ones are updated here.
+    //
+    try {
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            if (components[i].serial) { continue; }
+            event_queue * const component_queue =
+                queue ? &this->queues_[i] : 0;
+            if (component_queue) { component_queue->reset_counters(); }
+            pool.submit(update_component(components[i],
+                                         current_time,
+                                         component_queue,
+                                         failed[i]));
+        }
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            if (!components[i].serial) { continue; }
+            update_component(components[i], current_time, queue, failed[i])();
+        }
+    } catch (...) {
+        pool.wait();
+        throw;
+    }
+    pool.wait();
+
+    for (std::size_t i = 0; i < components.size(); ++i) {
+        if (failed[i]) { throw std::bad_alloc(); }
+        if (queue && !components[i].serial) {
+            queue->add_counters(this->queues_[i]);
+        }
+    }
+}
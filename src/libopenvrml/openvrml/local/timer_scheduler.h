@@ -0,0 +1,75 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_LOCAL_TIMER_SCHEDULER_H
+#   define OPENVRML_LOCAL_TIMER_SCHEDULER_H
+
+#   include <openvrml-common.h>
+#   include <boost/ptr_container/ptr_vector.hpp>
+#   include <boost/utility.hpp>
+#   include <list>
+#   include <new>
+#   include <vector>
+
+namespace openvrml {
+
+    class time_dependent_node;
+
+    namespace local {
+
+        class event_queue;
+        class thread_pool;
+
+        class OPENVRML_LOCAL timer_scheduler : boost::noncopyable {
+        public:
+            struct component {
+                std::vector<time_dependent_node *> timers;
+                bool serial;
+            };
+
+            typedef std::vector<component> component_list;
+
+        private:
+            std::vector<time_dependent_node *> timers_;
+            std::size_t route_revision_;
+            bool valid_;
+            component_list components_;
+            boost::ptr_vector<event_queue> queues_;
+
+        public:
+            static void routes_changed() OPENVRML_NOTHROW;
+
+            timer_scheduler() OPENVRML_NOTHROW;
+            ~timer_scheduler() OPENVRML_NOTHROW;
+
+            const component_list &
+            partition(const std::list<time_dependent_node *> & timers)
+                OPENVRML_THROW1(std::bad_alloc);
+
+            void update(const std::list<time_dependent_node *> & timers,
+                        double current_time,
+                        thread_pool & pool,
+                        event_queue * queue)
+                OPENVRML_THROW1(std::bad_alloc);
+        };
+    }
+}
+
+# endif // ifndef OPENVRML_LOCAL_TIMER_SCHEDULER_H
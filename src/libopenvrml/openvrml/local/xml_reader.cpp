@@ -161,6 +161,76 @@ openvrml::local::xml_reader::xml_reader(const std::string & filename)
 # endif
 }
 
+/**
+ * @brief Construct from a buffer.
+ *
+ * The buffer is not copied; it must remain valid for the lifetime of the
+ * @c xml_reader.  External entities and DTDs are not fetched.
+ *
+ * @param[in] data  the document data.
+ * @param[in] size  the number of bytes in @p data.
+ * @param[in] uri   the URI associated with the document, used to resolve
+ *                  relative references and in diagnostics.
+ *
+ * @exception std::runtime_error    if creating the underlying XML reader
+ *                                  fails.
+ */
+openvrml::local::xml_reader::xml_reader(const char * const data,
+                                        const std::size_t size,
+                                        const std::string & uri)
+    OPENVRML_THROW1(std::runtime_error):
+# ifdef _WIN32
+    input(0),
+# endif
+    reader(0)
+{
+# ifdef _WIN32
+    HRESULT hr;
+    bool succeeded = false;
+
+    this->input = SHCreateMemStream(reinterpret_cast<const BYTE *>(data),
+                                    UINT(size));
+    BOOST_SCOPE_EXIT((&succeeded)(&input)) {
+        if (!succeeded && input) { input->Release(); }
+    } BOOST_SCOPE_EXIT_END
+    if (!this->input) {
+        throw std::runtime_error("failed to create a stream for \"" + uri
+                                 + '\"');
+    }
+
+    hr = CreateXmlReader(__uuidof(IXmlReader),
+                         reinterpret_cast<void **>(&this->reader),
+                         0);
+    BOOST_SCOPE_EXIT((&succeeded)(&reader)) {
+        if (!succeeded && reader) { reader->Release(); }
+    } BOOST_SCOPE_EXIT_END
+    if (FAILED(hr)) {
+        throw std::runtime_error("failed to create XML reader");
+    }
+
+    hr = this->reader->SetProperty(XmlReaderProperty_DtdProcessing,
+                                   DtdProcessing_Prohibit);
+    if (FAILED(hr)) {
+        throw std::runtime_error("failed to configure XML reader");
+    }
+
+    hr = this->reader->SetInput(this->input);
+    if (FAILED(hr)) {
+        throw std::runtime_error("failed to set input for XML reader");
+    }
+
+    succeeded = true;
+# else
+    static const char * const encoding = 0;
+    static const int options = XML_PARSE_NONET | XML_PARSE_HUGE;
+    this->reader = xmlReaderForMemory(data, int(size), uri.c_str(),
+                                      encoding, options);
+    if (!this->reader) {
+        throw std::runtime_error("failed to create XML reader");
+    }
+# endif
+}
+
 /**
  * @brief Destroy.
  */
@@ -301,3 +371,42 @@ int openvrml::local::xml_reader::move_to_next_attribute() OPENVRML_NOTHROW
     return xmlTextReaderMoveToNextAttribute(this->reader);
 # endif
 }
+
+/**
+ * @brief Whether the current node is an empty element.
+ *
+ * No @c #end_element_id node is reported for an empty element (i.e., one
+ * written as <code>&lt;foo/&gt;</code>).  This must be called before moving
+ * to the element's attributes.
+ *
+ * @return @c true if the current node is an empty element; @c false
+ *         otherwise.
+ */
+bool openvrml::local::xml_reader::is_empty_element() const OPENVRML_NOTHROW
+{
+# ifdef _WIN32
+    return !!this->reader->IsEmptyElement();
+# else
+    return xmlTextReaderIsEmptyElement(this->reader) == 1;
+# endif
+}
+
+/**
+ * @brief The line number of the current node.
+ *
+ * @return the line number of the current node, or 0 if it is not known.
+ */
+std::size_t openvrml::local::xml_reader::line_number() const OPENVRML_NOTHROW
+{
+# ifdef _WIN32
+    UINT line = 0;
+    this->reader->GetLineNumber(&line);
+    return line;
+# else
+    const xmlNodePtr node = xmlTextReaderCurrentNode(this->reader);
+    const long line = node ? xmlGetLineNo(node) : -1;
+    return (line > 0)
+        ? std::size_t(line)
+        : std::size_t(xmlTextReaderGetParserLineNumber(this->reader));
+# endif
+}
@@ -27,6 +27,7 @@
 #   else
 #     include <libxml/xmlreader.h>
 #   endif
+#   include <cstddef>
 #   include <string>
 #   include <stdexcept>
 
@@ -70,6 +71,10 @@ namespace openvrml {
 
             explicit xml_reader(const std::string & filename)
                 OPENVRML_THROW1(std::runtime_error);
+            xml_reader(const char * data,
+                       std::size_t size,
+                       const std::string & uri)
+                OPENVRML_THROW1(std::runtime_error);
             ~xml_reader() OPENVRML_NOTHROW;
 
             int read() OPENVRML_NOTHROW;
@@ -80,6 +85,8 @@ namespace openvrml {
                 OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
             int move_to_first_attribute() OPENVRML_NOTHROW;
             int move_to_next_attribute() OPENVRML_NOTHROW;
+            bool is_empty_element() const OPENVRML_NOTHROW;
+            std::size_t line_number() const OPENVRML_NOTHROW;
         };
     }
 }
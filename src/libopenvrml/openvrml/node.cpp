@@ -25,6 +25,9 @@
 # include <openvrml/local/node_metatype_registry_impl.h>
 # include <openvrml/local/uri.h>
 # include <openvrml/local/field_value_types.h>
+# include <openvrml/local/event_queue.h>
+# include <openvrml/local/bounding_volume_hierarchy.h>
+# include <openvrml/local/pick_engine.h>
 # include <boost/array.hpp>
 # include <boost/lexical_cast.hpp>
 # include <boost/mpl/for_each.hpp>
@@ -2432,6 +2435,12 @@ bool openvrml::node::do_modified() const
 /**
  * @brief Emit an event.
  *
+ * If a @c local::event_queue is installed for the calling thread (i.e.,
+ * this function is called during @c browser::update with
+ * @c browser::queued_event_cascade enabled), the event is enqueued and
+ * delivered when the queue is drained.  Otherwise it is sent to the
+ * listeners immediately.
+ *
  * @param[in,out] emitter   an @c event_emitter.
  * @param[in]     timestamp the current time.
  *
@@ -2441,6 +2450,10 @@ void openvrml::node::emit_event(openvrml::event_emitter & emitter,
                                 const double timestamp)
     OPENVRML_THROW1(std::bad_alloc)
 {
+    if (local::event_queue * const queue = local::event_queue::current()) {
+        queue->enqueue(emitter, timestamp);
+        return;
+    }
     emitter.emit_event(timestamp);
 }
 
@@ -3124,7 +3137,18 @@ bounded_volume_node(const node_type & type,
  * @brief Destroy.
  */
 openvrml::bounded_volume_node::~bounded_volume_node() OPENVRML_NOTHROW
-{}
+{
+    openvrml::browser & b = this->type().metatype().browser();
+    b.pick_engine_->forget(*this);
+    try {
+        b.bounding_volume_hierarchy_->forget(*this);
+    } catch (std::bad_alloc &) {
+        //
+        // The hierarchy is rebuilt when its pending changes overflow; so
+        // the hierarchy will not be left referring to this node.
+        //
+    }
+}
 
 /**
  * @brief Get this node's bounding volume.
@@ -3185,10 +3209,14 @@ void openvrml::bounded_volume_node::bounding_volume_dirty(const bool value)
 {
     using boost::unique_lock;
     using boost::shared_mutex;
-    unique_lock<shared_mutex> lock(this->bounding_volume_dirty_mutex_);
-    this->bounding_volume_dirty_ = value;
+    {
+        unique_lock<shared_mutex> lock(this->bounding_volume_dirty_mutex_);
+        this->bounding_volume_dirty_ = value;
+    }
     if (value) { // only if dirtying, not clearing
-        this->type().metatype().browser().flags_need_updating = true;
+        openvrml::browser & b = this->type().metatype().browser();
+        b.bounding_volume_hierarchy_->dirty(*this);
+        b.flags_need_updating = true;
     }
 }
 
@@ -3203,10 +3231,6 @@ bool openvrml::bounded_volume_node::bounding_volume_dirty() const
     using boost::shared_lock;
     using boost::shared_mutex;
     shared_lock<shared_mutex> lock(this->bounding_volume_dirty_mutex_);
-    if (this->type().metatype().browser().flags_need_updating) {
-        this->type().metatype().browser().update_flags();
-        this->type().metatype().browser().flags_need_updating = false;
-    }
     return this->bounding_volume_dirty_;
 }
 
@@ -3291,10 +3315,16 @@ void openvrml::child_node::relocate() OPENVRML_THROW1(std::bad_alloc)
  *
  * This function delegates to @c #do_render_child.
  *
+ * When @p context is gathering collidable geometry, only nodes that have
+ * bounds (grouping nodes and Shapes) are rendered; sensors, lights, and
+ * the like are skipped.
+ *
  * @param[in,out] v         viewer implementation responsible for actually
  *                          doing the drawing.
  * @param[in]     context   generic context argument; holds things like the
  *                          accumulated modelview transform.
+ *
+ * @see rendering_context::collision_only
  */
 void openvrml::child_node::render_child(viewer & v,
                                         const rendering_context context)
@@ -3302,8 +3332,14 @@ void openvrml::child_node::render_child(viewer & v,
     using boost::shared_lock;
     using boost::shared_mutex;
     shared_lock<shared_mutex> lock(this->scene_mutex());
+    if (context.collision_only() && !node_cast<bounded_volume_node *>(this)) {
+        return;
+    }
     if (this->scene()) {
-        this->do_render_child(v, context);
+        rendering_context child_context(context);
+        child_context.enter(*this);
+        this->do_render_child(v, child_context);
+        child_context.leave();
         this->modified(false);
     }
 }
@@ -4050,9 +4086,24 @@ void openvrml::geometry_node::render_geometry(viewer & v,
 
     if (!this->scene()) { return; }
 
+    //
+    // Geometry gathered for collision may not have been drawn; the viewer
+    // that draws it must still see that it has been modified.
+    //
+    if (context.collision_only()) {
+        if (this->modified()) { context.forget_pick_target(*this); }
+        this->do_render_geometry(v, context);
+        context.pick_target(*this);
+        return;
+    }
+
     if (this->modified()) { v.remove_object(*this); }
 
+    context.enter(*this);
     this->do_render_geometry(v, context);
+    context.occlude(*this);
+    context.pick_target(*this);
+    context.leave();
     this->modified(false);
 }
 
@@ -4115,6 +4166,41 @@ const openvrml::color_node * openvrml::geometry_node::do_color() const
     return 0;
 }
 
+/**
+ * @brief Get the box this geometry fills, if it can act as an occluder.
+ *
+ * Geometry that entirely fills a box in its coordinate system, such as a
+ * Box, hides whatever is behind that box when it is drawn opaque.  The
+ * renderer uses such boxes to skip nodes that cannot be seen.
+ *
+ * @param[out] minimum  the minimum corner of the box.
+ * @param[out] maximum  the maximum corner of the box.
+ *
+ * @return @c true if the geometry fills the box given by @p minimum and
+ *         @p maximum; @c false if it cannot act as an occluder.
+ *
+ * @sa rendering_context::occlusion_culling
+ */
+bool openvrml::geometry_node::occluder(vec3f & minimum, vec3f & maximum) const
+    OPENVRML_NOTHROW
+{
+    return this->do_occluder(minimum, maximum);
+}
+
+/**
+ * @brief @c #occluder implementation.
+ *
+ * @param[out] minimum  the minimum corner of the box.
+ * @param[out] maximum  the maximum corner of the box.
+ *
+ * @return @c false.
+ */
+bool openvrml::geometry_node::do_occluder(vec3f &, vec3f &) const
+    OPENVRML_NOTHROW
+{
+    return false;
+}
+
 
 /**
  * @class openvrml::grouping_node openvrml/node.h
@@ -4216,6 +4302,31 @@ activate_pointing_device_sensors(const double timestamp,
     }
 }
 
+/**
+ * @brief Called when the avatar collides with geometry the node groups.
+ *
+ * This function delegates to @c #do_collide.
+ *
+ * @param[in] timestamp the current time.
+ *
+ * @see browser::move_avatar
+ */
+void openvrml::grouping_node::collide(const double timestamp)
+{
+    this->do_collide(timestamp);
+}
+
+/**
+ * @brief @c #collide implementation.
+ *
+ * A Collision node overrides this function to emit its @c collideTime
+ * event.  The default implementation does nothing.
+ *
+ * @param[in] timestamp the current time.
+ */
+void openvrml::grouping_node::do_collide(double)
+{}
+
 
 /**
  * @class openvrml::light_node openvrml/node.h
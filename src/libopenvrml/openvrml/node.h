@@ -403,6 +403,7 @@ namespace openvrml {
     namespace local {
         class proto_node;
         class externproto_node;
+        class bounding_volume_hierarchy;
     }
 
     class OPENVRML_API node : boost::noncopyable {
@@ -901,6 +902,8 @@ namespace openvrml {
 
 
     class OPENVRML_API bounded_volume_node : public virtual node {
+        friend class local::bounding_volume_hierarchy;
+
         mutable boost::shared_mutex bounding_volume_dirty_mutex_;
         mutable bool bounding_volume_dirty_;
 
@@ -1086,6 +1089,8 @@ namespace openvrml {
         void render_geometry(viewer & v, rendering_context context);
         bool emissive() const OPENVRML_NOTHROW;
         const color_node * color() const OPENVRML_NOTHROW;
+        bool occluder(vec3f & minimum, vec3f & maximum) const
+            OPENVRML_NOTHROW;
 
     protected:
         geometry_node(const node_type & type,
@@ -1096,6 +1101,8 @@ namespace openvrml {
         virtual void do_render_geometry(viewer & v, rendering_context context);
         virtual bool do_emissive() const OPENVRML_NOTHROW;
         virtual const color_node * do_color() const OPENVRML_NOTHROW;
+        virtual bool do_occluder(vec3f & minimum, vec3f & maximum) const
+            OPENVRML_NOTHROW;
 
         virtual geometry_node * to_geometry() OPENVRML_NOTHROW;
     };
@@ -1111,6 +1118,7 @@ namespace openvrml {
                                               bool over,
                                               bool active,
                                               const double (&p)[3]);
+        void collide(double timestamp);
 
     protected:
         grouping_node(const node_type & type,
@@ -1123,6 +1131,7 @@ namespace openvrml {
         virtual
         const std::vector<boost::intrusive_ptr<node> > do_children() const
             OPENVRML_THROW1(std::bad_alloc) = 0;
+        virtual void do_collide(double timestamp);
     };
 
 
@@ -23,6 +23,12 @@
 # endif
 
 # include "rendering_context.h"
+# include "viewer.h"
+# include "node.h"
+# include "local/bounding_volume_hierarchy.h"
+# include "local/occlusion_buffer.h"
+# include "local/pick_engine.h"
+# include <boost/cast.hpp>
 
 /**
  * @file openvrml/rendering_context.h
@@ -95,6 +101,85 @@
  * The current modelview matrix.
  */
 
+/**
+ * @var openvrml::local::bounding_volume_hierarchy * openvrml::rendering_context::hierarchy_
+ *
+ * @brief The @c browser's bounding volume hierarchy; 0 if the traversal is
+ *        not tracked.
+ */
+
+/**
+ * @var openvrml::local::bvh_entry * openvrml::rendering_context::entry_
+ *
+ * @brief The hierarchy entry for the node being rendered.
+ */
+
+/**
+ * @var const openvrml::mat4f * openvrml::rendering_context::entered_modelview_
+ *
+ * @brief The modelview matrix when @a entry_ was entered.
+ */
+
+/**
+ * @var unsigned int openvrml::rendering_context::planes_
+ *
+ * @brief The view volume planes the current node's ancestors are not known
+ *        to be inside.
+ */
+
+/**
+ * @var openvrml::local::occlusion_buffer * openvrml::rendering_context::occlusion_
+ *
+ * @brief The @c browser's occlusion buffer; 0 if the traversal is not
+ *        tracked.
+ */
+
+/**
+ * @var bool openvrml::rendering_context::occlusion_culling_
+ *
+ * @brief Whether nodes are tested against @a occlusion_ and opaque
+ *        occluders are added to it.
+ */
+
+/**
+ * @var openvrml::local::pick_engine * openvrml::rendering_context::picks_
+ *
+ * @brief The @c browser's pick engine; 0 if the traversal is not recorded
+ *        for picking.
+ */
+
+/**
+ * @var openvrml::grouping_node * openvrml::rendering_context::collision_
+ *
+ * @brief The innermost Collision node being rendered; or 0.
+ */
+
+/**
+ * @var bool openvrml::rendering_context::collision_only_
+ *
+ * @brief Whether the traversal gathers collidable geometry rather than
+ *        drawing.
+ */
+
+/**
+ * @var float openvrml::rendering_context::collision_reach_
+ *
+ * @brief How far from the eye geometry is gathered for collision.
+ */
+
+/**
+ * @var bool openvrml::rendering_context::opaque
+ *
+ * @brief Whether the geometry being rendered is drawn opaque.
+ *
+ * Only opaque geometry hides what is behind it; so a @c geometry_node
+ * rendered with this flag set may be used as an occluder.  A node that sets
+ * the appearance of geometry (such as a Shape) sets this flag when the
+ * appearance has no transparency.
+ *
+ * @see occlusion_culling
+ */
+
 /**
  * @var bool openvrml::rendering_context::draw_bounding_spheres;
  *
@@ -113,8 +198,19 @@
  */
 openvrml::rendering_context::rendering_context():
     modelview(0),
+    hierarchy_(0),
+    entry_(0),
+    entered_modelview_(0),
+    planes_(local::bounding_volume_hierarchy::all_planes),
+    occlusion_(0),
+    occlusion_culling_(false),
+    picks_(0),
+    collision_(0),
+    collision_only_(false),
+    collision_reach_(0.0f),
     cull_flag(bounding_volume::partial),
-    draw_bounding_spheres(false)
+    draw_bounding_spheres(false),
+    opaque(false)
 {}
 
 /**
@@ -132,8 +228,19 @@ openvrml::rendering_context::rendering_context(
     const bounding_volume::intersection cull_flag,
     mat4f & modelview):
     modelview(&modelview),
+    hierarchy_(0),
+    entry_(0),
+    entered_modelview_(0),
+    planes_(local::bounding_volume_hierarchy::all_planes),
+    occlusion_(0),
+    occlusion_culling_(false),
+    picks_(0),
+    collision_(0),
+    collision_only_(false),
+    collision_reach_(0.0f),
     cull_flag(cull_flag),
-    draw_bounding_spheres(false)
+    draw_bounding_spheres(false),
+    opaque(false)
 {}
 
 /**
@@ -162,3 +269,231 @@ const openvrml::mat4f & openvrml::rendering_context::matrix() const
     assert(this->modelview);
     return *this->modelview;
 }
+
+/**
+ * @brief Intersect a node's bounding volume with the view volume and test
+ *        it against the occluders rendered so far.
+ *
+ * If @a cull_flag is @c bounding_volume::inside, the view volume test is
+ * skipped.  Otherwise, when @p n is the node being rendered by the
+ * @c browser and its world transformation is known, its cached world-space
+ * bounds are tested against only those view volume planes its ancestors
+ * straddle; else the bounding volume is transformed by the modelview matrix
+ * and tested with @c viewer::intersect_view_volume.
+ *
+ * If the bounding volume is not outside the view volume and occlusion
+ * culling is enabled, it is tested against the occluders rendered before
+ * it; if it is entirely behind them, the result is
+ * @c bounding_volume::outside.
+ *
+ * If the result is @c bounding_volume::inside, @a cull_flag is set so that
+ * the node's descendants are not tested against the view volume.
+ *
+ * When the traversal gathers collidable geometry, the view volume and the
+ * occluders are ignored: the node is culled only if its bounding volume is
+ * out of the avatar's reach.
+ *
+ * @param[in,out] v viewer.
+ * @param[in]     n a node whose bounding volume is in the coordinate system
+ *                  of the modelview matrix.
+ *
+ * @return @c bounding_volume::inside, @c bounding_volume::outside, or
+ *         @c bounding_volume::partial.
+ *
+ * @see occlusion_culling
+ */
+openvrml::bounding_volume::intersection
+openvrml::rendering_context::cull(viewer & v, const bounded_volume_node & n)
+{
+    using boost::polymorphic_downcast;
+
+    if (this->collision_only_) {
+        bounding_sphere eye(
+            *polymorphic_downcast<const bounding_sphere *>(
+                &n.bounding_volume()));
+        if (eye.maximized()) { return bounding_volume::partial; }
+        if (eye.radius() < 0.0f) { return bounding_volume::outside; }
+        eye.transform(this->matrix());
+        return eye.center().length() - eye.radius() > this->collision_reach_
+            ? bounding_volume::outside
+            : bounding_volume::partial;
+    }
+
+    const bool occlusion = this->occlusion_ && this->occlusion_culling_
+        && this->occlusion_->valid();
+    if (this->cull_flag == bounding_volume::inside && !occlusion) {
+        return bounding_volume::inside;
+    }
+
+    const bounding_sphere & bs =
+        *polymorphic_downcast<const bounding_sphere *>(&n.bounding_volume());
+    const bool entered = this->hierarchy_ && this->entry_
+        && this->entry_->n == static_cast<const node *>(&n);
+    bounding_volume::intersection r = bounding_volume::inside;
+    if (this->cull_flag != bounding_volume::inside) {
+        if (entered && this->entry_->frame_known
+            && this->modelview == this->entered_modelview_) {
+            r = this->hierarchy_->intersect(*this->entry_, bs,
+                                            this->planes_);
+        } else {
+            bounding_sphere bv_copy(bs);
+            bv_copy.transform(this->matrix());
+            r = v.intersect_view_volume(bv_copy);
+        }
+        if (this->draw_bounding_spheres) { v.draw_bounding_sphere(bs, r); }
+        if (r == bounding_volume::outside) {
+            if (this->occlusion_) { ++this->occlusion_->culled; }
+            return r;
+        }
+    }
+
+    if (occlusion) {
+        bounding_sphere eye(bs);
+        eye.transform(this->matrix());
+        ++this->occlusion_->tested;
+        if (this->occlusion_->hides(eye)) {
+            ++this->occlusion_->occluded;
+            if (entered) { this->hierarchy_->occluded(*this->entry_); }
+            return bounding_volume::outside;
+        }
+    }
+
+    if (r == bounding_volume::inside) {
+        this->cull_flag = bounding_volume::inside;
+    }
+    return r;
+}
+
+/**
+ * @brief Whether occlusion culling is enabled.
+ *
+ * @return @c true if occlusion culling is enabled; @c false otherwise.
+ */
+bool openvrml::rendering_context::occlusion_culling() const
+{
+    return this->occlusion_ && this->occlusion_culling_;
+}
+
+/**
+ * @brief Enable or disable occlusion culling.
+ *
+ * When occlusion culling is enabled, @c #cull rejects nodes hidden behind
+ * opaque occluders rendered earlier in the traversal; and opaque
+ * @c geometry_node%s that can act as occluders are added as they are
+ * rendered.  The setting applies to the context and the copies made of it
+ * for the descendants of the node being rendered; a node whose children are
+ * not drawn in depth order can disable it for its subtree.
+ *
+ * The @c browser enables occlusion culling for the traversal if
+ * @c browser::occlusion_culling is set; it cannot be enabled in a context
+ * that the @c browser did not create.
+ *
+ * @param[in] enable    @c true to enable occlusion culling; @c false to
+ *                      disable it.
+ */
+void openvrml::rendering_context::occlusion_culling(const bool enable)
+{
+    this->occlusion_culling_ = enable;
+}
+
+/**
+ * @brief Whether the traversal gathers collidable geometry.
+ *
+ * The @c browser renders the world a second time, to a viewer that draws
+ * nothing, to find the geometry near the avatar that it can collide with.
+ * Nodes that change how the avatar collides with their children (such as
+ * Collision) behave differently in that traversal; and nodes that draw
+ * nothing else may skip it.
+ *
+ * @return @c true if the traversal gathers collidable geometry; @c false
+ *         otherwise.
+ *
+ * @see browser::move_avatar
+ */
+bool openvrml::rendering_context::collision_only() const
+{
+    return this->collision_only_;
+}
+
+/**
+ * @brief Set the Collision node that geometry rendered in the context
+ *        belongs to.
+ *
+ * When the avatar collides with the geometry, @c grouping_node::collide is
+ * called for @p group.
+ *
+ * @param[in] group a Collision node whose children are being rendered.
+ */
+void openvrml::rendering_context::collision(grouping_node & group)
+{
+    this->collision_ = &group;
+}
+
+/**
+ * @brief Enter the bounding volume hierarchy entry for @p n.
+ *
+ * Does nothing if the traversal is not tracked.
+ *
+ * @param[in] n the node about to be rendered.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void openvrml::rendering_context::enter(node & n)
+{
+    if (!this->hierarchy_ || !this->entry_) { return; }
+    this->entry_ =
+        &this->hierarchy_->enter(*this->entry_,
+                                 n,
+                                 this->modelview != this->entered_modelview_);
+    this->entered_modelview_ = this->modelview;
+}
+
+/**
+ * @brief Leave the current bounding volume hierarchy entry.
+ */
+void openvrml::rendering_context::leave()
+{
+    if (!this->hierarchy_ || !this->entry_) { return; }
+    this->hierarchy_->leave(*this->entry_);
+}
+
+/**
+ * @brief Add @p n to the occluders if it is opaque and can act as one.
+ *
+ * @param[in] n a @c geometry_node that has just been rendered.
+ */
+void openvrml::rendering_context::occlude(const geometry_node & n)
+{
+    if (!this->opaque || !this->occlusion_culling()) { return; }
+    vec3f minimum, maximum;
+    if (!n.occluder(minimum, maximum)) { return; }
+    this->occlusion_->add_box(this->matrix(), minimum, maximum);
+}
+
+/**
+ * @brief Record where @p n was drawn, so that it can be picked; or, if the
+ *        traversal gathers collidable geometry, collided with.
+ *
+ * @param[in] n a @c geometry_node that has just been rendered.
+ */
+void openvrml::rendering_context::pick_target(const geometry_node & n)
+{
+    if (!this->picks_) { return; }
+    this->picks_->record(n,
+                         this->matrix(),
+                         this->collision_only_
+                         ? local::pick_engine::collidable
+                         : local::pick_engine::pickable,
+                         this->collision_);
+}
+
+/**
+ * @brief Discard the triangles recorded for @p n.
+ *
+ * @param[in] n a @c geometry_node that has been modified.
+ */
+void openvrml::rendering_context::forget_pick_target(const geometry_node & n)
+{
+    if (!this->picks_) { return; }
+    this->picks_->remove(n);
+}
@@ -25,12 +25,42 @@
 
 namespace openvrml {
 
+    class browser;
+    class child_node;
+    class geometry_node;
+    class grouping_node;
+    class bounded_volume_node;
+    class node;
+    class viewer;
+
+    namespace local {
+        struct bvh_entry;
+        class bounding_volume_hierarchy;
+        class occlusion_buffer;
+        class pick_engine;
+    }
+
     class OPENVRML_API rendering_context {
+        friend class browser;
+        friend class child_node;
+        friend class geometry_node;
+
         mat4f * modelview;
+        local::bounding_volume_hierarchy * hierarchy_;
+        local::bvh_entry * entry_;
+        const mat4f * entered_modelview_;
+        unsigned int planes_;
+        local::occlusion_buffer * occlusion_;
+        bool occlusion_culling_;
+        local::pick_engine * picks_;
+        grouping_node * collision_;
+        bool collision_only_;
+        float collision_reach_;
 
     public:
         bounding_volume::intersection cull_flag;
         bool draw_bounding_spheres;
+        bool opaque;
 
         rendering_context();
         rendering_context(bounding_volume::intersection cull_flag,
@@ -40,6 +70,22 @@ namespace openvrml {
 
         const mat4f & matrix() const;
         void matrix(mat4f & modelview);
+
+        bounding_volume::intersection cull(viewer & v,
+                                           const bounded_volume_node & n);
+
+        bool occlusion_culling() const;
+        void occlusion_culling(bool enable);
+
+        bool collision_only() const;
+        void collision(grouping_node & group);
+
+    private:
+        void enter(node & n);
+        void leave();
+        void occlude(const geometry_node & n);
+        void pick_target(const geometry_node & n);
+        void forget_pick_target(const geometry_node & n);
     };
 }
 
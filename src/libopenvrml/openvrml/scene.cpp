@@ -23,7 +23,9 @@
 # include "browser.h"
 # include <openvrml/local/uri.h>
 # include <openvrml/local/parse_vrml.h>
+# include <openvrml/local/io_pool.h>
 # include <private.h>
+# include <boost/bind.hpp>
 # include <boost/function.hpp>
 # include <boost/scope_exit.hpp>
 
@@ -114,9 +116,69 @@
 /**
  * @internal
  *
- * @var boost::thread_group openvrml::scene::stream_reader_threads_
+ * @var boost::mutex openvrml::scene::io_mutex_
  *
- * @brief Stream reader thread group.
+ * @brief Mutex protecting @c #io_pending_.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::condition_variable openvrml::scene::io_done_
+ *
+ * @brief Signaled when the last pending read has finished.
+ */
+
+/**
+ * @internal
+ *
+ * @var std::size_t openvrml::scene::io_pending_
+ *
+ * @brief The number of reads submitted by @c #read_stream and
+ *        @c #create_vrml_from_url that have not finished.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::mutex openvrml::scene::load_mutex_
+ *
+ * @brief Mutex protecting @c #loading_, @c #loaded_nodes_, and
+ *        @c #loaded_meta_.
+ */
+
+/**
+ * @internal
+ *
+ * @var boost::condition_variable openvrml::scene::load_done_
+ *
+ * @brief Signaled when an asynchronous load has finished.
+ */
+
+/**
+ * @internal
+ *
+ * @var bool openvrml::scene::loading_
+ *
+ * @brief Whether an asynchronous load is in progress.
+ */
+
+/**
+ * @internal
+ *
+ * @var std::vector<boost::intrusive_ptr<openvrml::node> > openvrml::scene::loaded_nodes_
+ *
+ * @brief Root nodes parsed by an asynchronous load that have yet to be
+ *        committed.
+ */
+
+/**
+ * @internal
+ *
+ * @var std::map<std::string, std::string> openvrml::scene::loaded_meta_
+ *
+ * @brief Metadata parsed by an asynchronous load that has yet to be
+ *        committed.
  */
 
 /**
@@ -128,7 +190,9 @@
 openvrml::scene::scene(openvrml::browser & browser, scene * parent)
     OPENVRML_NOTHROW:
     browser_(&browser),
-    parent_(parent)
+    parent_(parent),
+    io_pending_(0),
+    loading_(false)
 {}
 
 /**
@@ -136,7 +200,16 @@ openvrml::scene::scene(openvrml::browser & browser, scene * parent)
  */
 openvrml::scene::~scene() OPENVRML_NOTHROW
 {
-    this->stream_reader_threads_.join_all();
+    {
+        boost::unique_lock<boost::mutex> lock(this->io_mutex_);
+        while (this->io_pending_ > 0) { this->io_done_.wait(lock); }
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(this->load_mutex_);
+        while (this->loading_) { this->load_done_.wait(lock); }
+    }
+    this->browser_->discard_loaded_scene(*this);
 }
 
 /**
@@ -169,8 +242,10 @@ openvrml::scene * openvrml::scene::parent() const OPENVRML_NOTHROW
  *
  * @exception bad_media_type    if @p in.type() is not
  *                              &ldquo;model/vrml&rdquo;,
- *                              &ldquo;x-world/x-vrml&rdquo;, or
- *                              &ldquo;model/x3d-vrml&rdquo;.
+ *                              &ldquo;x-world/x-vrml&rdquo;,
+ *                              &ldquo;model/x3d-vrml&rdquo;,
+ *                              &ldquo;model/x3d+xml&rdquo;, or
+ *                              &ldquo;model/x3d+fastinfoset&rdquo;.
  * @exception invalid_vrml      if @p in has invalid syntax.
  */
 void openvrml::scene::load(resource_istream & in)
@@ -183,19 +258,157 @@ void openvrml::scene::load(resource_istream & in)
         self.scene_loaded();
     } BOOST_SCOPE_EXIT_END
 
+    using boost::unique_lock;
+    using boost::shared_mutex;
+
     {
-        using boost::unique_lock;
-        using boost::shared_mutex;
         unique_lock<shared_mutex>
             nodes_lock(this->nodes_mutex_),
             url_lock(this->url_mutex_),
             meta_lock(this->meta_mutex_);
-
         this->nodes_.clear();
         this->meta_.clear();
         this->url_ = in.url();
-        local::parse_vrml(in, in.url(), in.type(),
-                          *this, this->nodes_, this->meta_);
+    }
+
+    //
+    // Parse without holding the locks so that the scene can be rendered
+    // while it is loading.
+    //
+    std::vector<boost::intrusive_ptr<node> > nodes;
+    std::map<std::string, std::string> meta;
+    local::parse_vrml(in, in.url(), in.type(), *this, nodes, meta);
+
+    unique_lock<shared_mutex>
+        nodes_lock(this->nodes_mutex_),
+        meta_lock(this->meta_mutex_);
+    this->nodes_.swap(nodes);
+    this->meta_.swap(meta);
+}
+
+struct OPENVRML_LOCAL openvrml::scene::async_loader {
+    async_loader(scene & s, const std::vector<std::string> & url):
+        scene_(&s),
+        url_(url)
+    {}
+
+    void operator()() const OPENVRML_NOTHROW
+    {
+        using boost::unique_lock;
+        using boost::shared_mutex;
+
+        scene & s = *this->scene_;
+        std::vector<boost::intrusive_ptr<node> > nodes;
+        std::map<std::string, std::string> meta;
+        try {
+            //
+            // Any relative URLs passed here will be relative to the parent
+            // scene (if there is one); so we call get_resource on the
+            // parent.
+            //
+            const scene & resolver = s.parent() ? *s.parent() : s;
+            std::auto_ptr<resource_istream> in =
+                resolver.get_resource(this->url_);
+            if (!(*in)) { throw unreachable_url(); }
+            {
+                unique_lock<shared_mutex> url_lock(s.url_mutex_);
+                s.url_ = in->url();
+            }
+            local::parse_vrml(*in, in->url(), in->type(), s, nodes, meta);
+        } catch (std::exception & ex) {
+            nodes.clear();
+            meta.clear();
+            s.browser().err(ex.what());
+        }
+
+        boost::unique_lock<boost::mutex> lock(s.load_mutex_);
+        s.loaded_nodes_.swap(nodes);
+        s.loaded_meta_.swap(meta);
+        try {
+            s.browser_->scene_parsed(s);
+        } catch (std::bad_alloc & ex) {
+            s.browser().err(ex.what());
+        }
+        s.loading_ = false;
+        s.load_done_.notify_all();
+    }
+
+private:
+    scene * const scene_;
+    const std::vector<std::string> url_;
+};
+
+/**
+ * @brief Load the @c scene asynchronously.
+ *
+ * The first resource in @p url that can be retrieved is fetched and parsed
+ * on one of the @c browser&rsquo;s loader threads; so any number of scenes
+ * may be loading concurrently.  Relative URLs are resolved against the
+ * parent @c scene, if there is one.
+ *
+ * Parsing builds the new root @c node%s without touching the @c scene's
+ * current ones.  They replace the current root @c node%s at the beginning
+ * of the next call to @c browser::update, which then calls
+ * @c #scene_loaded.  Errors are reported through @c browser::err; the
+ * @c scene is then committed empty.
+ *
+ * Calling this function while an asynchronous load of the @c scene is in
+ * progress has no effect.
+ *
+ * @param[in] url   an ordered list of alternative URLs.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+void
+openvrml::scene::load_async(const std::vector<std::string> & url)
+    OPENVRML_THROW1(std::bad_alloc)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(this->load_mutex_);
+        if (this->loading_) { return; }
+        this->loading_ = true;
+    }
+    try {
+        this->browser_->load_async(async_loader(*this, url));
+    } catch (...) {
+        boost::lock_guard<boost::mutex> lock(this->load_mutex_);
+        this->loading_ = false;
+        this->load_done_.notify_all();
+        throw;
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Replace the root @c node%s and metadata with those from the last
+ *        asynchronous load.
+ *
+ * This function calls @c #scene_loaded.
+ */
+void openvrml::scene::commit_load() OPENVRML_NOTHROW
+{
+    using boost::unique_lock;
+    using boost::shared_mutex;
+
+    std::vector<boost::intrusive_ptr<node> > nodes;
+    std::map<std::string, std::string> meta;
+    {
+        boost::lock_guard<boost::mutex> lock(this->load_mutex_);
+        nodes.swap(this->loaded_nodes_);
+        meta.swap(this->loaded_meta_);
+    }
+    {
+        unique_lock<shared_mutex>
+            nodes_lock(this->nodes_mutex_),
+            meta_lock(this->meta_mutex_);
+        this->nodes_.swap(nodes);
+        this->meta_.swap(meta);
+    }
+    try {
+        this->scene_loaded();
+    } catch (std::exception & ex) {
+        this->browser_->err(ex.what());
     }
 }
 
@@ -340,9 +553,13 @@ void openvrml::scene::nodes(const std::vector<boost::intrusive_ptr<node> > & n)
     } check_uninitialized;
     check_uninitialized.traverse(n);
 
-    unique_lock<shared_mutex> lock(this->nodes_mutex_);
+    //
+    // shutdown acquires nodes_mutex_ itself; so it must be called before
+    // the exclusive lock is taken.
+    //
     const double now = browser::current_time();
     this->shutdown(now);
+    unique_lock<shared_mutex> lock(this->nodes_mutex_);
     this->nodes_ = n;
 }
 
@@ -403,59 +620,99 @@ void openvrml::scene::render(openvrml::viewer & viewer,
     }
 }
 
-namespace {
-
-    struct OPENVRML_LOCAL stream_reader {
-        stream_reader(std::auto_ptr<openvrml::resource_istream> in,
-                      std::auto_ptr<openvrml::stream_listener> listener):
-            in_(in),
-            listener_(listener)
-        {}
+/**
+ * @internal
+ *
+ * @brief A read submitted to the <code>browser</code>'s I/O threads.
+ */
+struct OPENVRML_LOCAL openvrml::scene::io_task {
+    openvrml::scene * scene;
+    boost::function0<void> t;
 
-        void operator()() const
-        {
-            this->listener_->stream_available(this->in_->url(),
-                                              this->in_->type());
-            while (*this->in_) {
-                std::vector<unsigned char> data;
-                while (this->in_->data_available()) {
-                    using openvrml::resource_istream;
-                    const resource_istream::int_type c = this->in_->get();
-                    if (c != resource_istream::traits_type::eof()) {
-                        data.push_back(
-                            static_cast<unsigned char>(
-                                resource_istream::traits_type::
-                                    to_char_type(c)));
-                    } else {
-                        break;
-                    }
-                }
-                if (!data.empty()) {
-                    this->listener_->data_available(data);
-                }
-            }
+    void operator()() const OPENVRML_NOTHROW
+    {
+        try {
+            this->t();
+        } catch (std::exception & ex) {
+            this->scene->browser().err(ex.what());
+        } catch (...) {
+            //
+            // The implementations of resource_istream and stream_listener
+            // are provided by the user; and unfortunately, operations on
+            // them could throw anything.
+            //
         }
+    }
+};
 
-    private:
-        boost::shared_ptr<openvrml::resource_istream> in_;
-        boost::shared_ptr<openvrml::stream_listener> listener_;
-    };
+/**
+ * @internal
+ *
+ * @brief Run @p t on the <code>browser</code>'s I/O threads.
+ *
+ * The @c scene is not destroyed until @p t has finished.
+ *
+ * @param[in] t a task.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if the threads cannot be
+ *                                          started.
+ */
+void openvrml::scene::submit_io(const boost::function0<void> & t)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(this->io_mutex_);
+        ++this->io_pending_;
+    }
+    try {
+        const io_task task = { this, t };
+        this->browser_->io_pool_->submit(
+            task, boost::bind(&scene::io_finished, this));
+    } catch (...) {
+        boost::lock_guard<boost::mutex> lock(this->io_mutex_);
+        --this->io_pending_;
+        throw;
+    }
 }
 
 /**
- * @brief Read a stream in a new thread.
+ * @internal
+ *
+ * @brief Note that a task submitted with @c #submit_io has finished.
+ */
+void openvrml::scene::io_finished() OPENVRML_NOTHROW
+{
+    //
+    // Notify while holding the lock: once io_pending_ reaches 0, the scene
+    // may be destroyed as soon as the lock is released.
+    //
+    boost::lock_guard<boost::mutex> lock(this->io_mutex_);
+    if (--this->io_pending_ == 0) { this->io_done_.notify_all(); }
+}
+
+/**
+ * @brief Read a stream on one of the <code>browser</code>'s I/O threads.
  *
  * @c #read_stream takes ownership of its arguments; the resources are released
- * when reading the stream completes and the thread terminates.
+ * when reading the stream completes.
+ *
+ * The stream's data is passed to @c stream_listener::data_available in
+ * chunks as it arrives.  The vector passed to
+ * @c stream_listener::data_available is reused for later chunks; so the
+ * listener must copy any data it needs to keep.
+ *
+ * If all of the threads are busy, the stream is read when one becomes free.
  *
  * @param[in] in        an input stream.
  * @param[in] listener  a stream listener.
+ *
+ * @sa browser::io_threads(std::size_t)
  */
 void openvrml::scene::read_stream(std::auto_ptr<resource_istream> in,
                                   std::auto_ptr<stream_listener> listener)
 {
-    boost::function0<void> f = stream_reader(in, listener);
-    this->stream_reader_threads_.create_thread(f);
+    this->submit_io(this->browser_->io_pool_->reader(in, listener));
 }
 
 struct OPENVRML_LOCAL openvrml::scene::vrml_from_url_creator {
@@ -520,7 +777,8 @@ private:
  * @exception unsupported_interface         if @p node has no eventIn @p event.
  * @exception std::bad_cast                 if the @p event eventIn of @p node
  *                                          is not an MFNode.
- * @exception boost::thread_resource_error  if thread creation fails.
+ * @exception boost::thread_resource_error  if the I/O threads cannot be
+ *                                          started.
  */
 void
 openvrml::scene::
@@ -530,8 +788,7 @@ create_vrml_from_url(const std::vector<std::string> & url,
     OPENVRML_THROW3(unsupported_interface, std::bad_cast,
                     boost::thread_resource_error)
 {
-    boost::function0<void> f = vrml_from_url_creator(*this, url, node, event);
-    this->stream_reader_threads_.create_thread(f);
+    this->submit_io(vrml_from_url_creator(*this, url, node, event));
 }
 
 /**
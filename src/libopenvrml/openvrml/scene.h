@@ -25,6 +25,7 @@
 #   include <openvrml-common.h>
 #   include <openvrml/bad_url.h>
 #   include <openvrml/node.h>
+#   include <boost/function.hpp>
 
 namespace openvrml {
 
@@ -33,6 +34,8 @@ namespace openvrml {
     class stream_listener;
 
     class OPENVRML_API scene : boost::noncopyable {
+        friend class browser;
+
         struct vrml_from_url_creator;
 
         openvrml::browser * const browser_;
@@ -47,7 +50,19 @@ namespace openvrml {
         mutable boost::shared_mutex meta_mutex_;
         std::map<std::string, std::string> meta_;
 
-        boost::thread_group stream_reader_threads_;
+        struct io_task;
+
+        boost::mutex io_mutex_;
+        boost::condition_variable io_done_;
+        std::size_t io_pending_;
+
+        struct async_loader;
+
+        boost::mutex load_mutex_;
+        boost::condition_variable load_done_;
+        bool loading_;
+        std::vector<boost::intrusive_ptr<node> > loaded_nodes_;
+        std::map<std::string, std::string> loaded_meta_;
 
     public:
         explicit scene(openvrml::browser & browser, scene * parent = 0)
@@ -57,6 +72,8 @@ namespace openvrml {
         openvrml::browser & browser() const OPENVRML_NOTHROW;
         scene * parent() const OPENVRML_NOTHROW;
         void load(resource_istream & in);
+        void load_async(const std::vector<std::string> & url)
+            OPENVRML_THROW1(std::bad_alloc);
         void initialize(double timestamp) OPENVRML_THROW1(std::bad_alloc);
         const std::string meta(const std::string & key) const
             OPENVRML_THROW2(std::invalid_argument, std::bad_alloc);
@@ -87,6 +104,10 @@ namespace openvrml {
         void shutdown(double timestamp) OPENVRML_NOTHROW;
 
     private:
+        void submit_io(const boost::function0<void> & t)
+            OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error);
+        void io_finished() OPENVRML_NOTHROW;
+        void commit_load() OPENVRML_NOTHROW;
         virtual void scene_loaded();
     };
 }
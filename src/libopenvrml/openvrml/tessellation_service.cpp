@@ -0,0 +1,656 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# include "tessellation_service.h"
+# include "browser.h"
+# include <openvrml/local/thread_pool.h>
+# include <algorithm>
+
+# ifdef HAVE_CONFIG_H
+#   include <config.h>
+# endif
+
+/**
+ * @file openvrml/tessellation_service.h
+ *
+ * @brief Definition of @c openvrml::tessellation_service and
+ *        @c openvrml::async_mesh.
+ */
+
+namespace {
+
+    OPENVRML_LOCAL void
+    add_latency(openvrml::tessellation_service::statistics & s,
+                const double latency)
+    {
+        ++s.completed;
+        s.total_latency += latency;
+        s.max_latency = (std::max)(s.max_latency, latency);
+        ++s.histogram[
+            openvrml::tessellation_service::histogram_bucket(latency)];
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief A compilation job queued on the @c tessellation_service's threads.
+ */
+struct openvrml::tessellation_service::task {
+    tessellation_service * service;
+    boost::shared_ptr<async_mesh::state> state;
+    std::size_t revision;
+    job compile;
+    double submitted;
+
+    void operator()() const OPENVRML_NOTHROW;
+};
+
+/**
+ * @internal
+ *
+ * @brief Compile the mesh, unless a later revision has been requested in
+ *        the meantime.
+ */
+void openvrml::tessellation_service::task::operator()() const
+    OPENVRML_NOTHROW
+{
+    {
+        boost::lock_guard<boost::mutex> lock(this->state->mutex);
+        if (this->state->requested != this->revision) {
+            this->service->finished(0.0, false, false);
+            return;
+        }
+    }
+
+    bool failed = false;
+    boost::shared_ptr<compiled_mesh> result;
+    try {
+        result.reset(new compiled_mesh);
+        this->compile(*result);
+    } catch (std::exception &) {
+        failed = true;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(this->state->mutex);
+        if (this->revision > this->state->completed) {
+            this->state->completed = this->revision;
+            if (!failed) { this->state->result = result; }
+        }
+    }
+    this->service->finished(browser::current_time() - this->submitted,
+                            !failed,
+                            failed);
+}
+
+
+/**
+ * @class openvrml::tessellation_service openvrml/tessellation_service.h
+ *
+ * @brief Compiles meshes on a pool of worker threads.
+ *
+ * Triangulating a large shell, Extrusion or Text string can take much longer
+ * than a frame.  A @c geometry_node that keeps its mesh in an @c async_mesh
+ * passes the compilation to the @c browser's @c tessellation_service when
+ * its fields change, and continues to draw its previous mesh (or a proxy for
+ * it) until the new one is ready.  The @c browser picks up finished meshes
+ * in @c browser::update and marks itself modified so that the scene is
+ * redrawn.
+ *
+ * Jobs whose cost falls below the @c #async_threshold are cheaper to compile
+ * than to hand off; they are compiled immediately on the calling thread.
+ *
+ * The time from submission to completion of each job is recorded in a
+ * histogram; see @c #latency_statistics.
+ *
+ * @sa openvrml::browser::tessellation_service
+ */
+
+/**
+ * @typedef boost::function1<void, openvrml::compiled_mesh &> openvrml::tessellation_service::job
+ *
+ * @brief A function that compiles a mesh.
+ *
+ * A job is run on a worker thread; so it must own (copies of) the data it
+ * compiles and must not touch the scene.
+ */
+
+/**
+ * @struct openvrml::tessellation_service::statistics
+ *
+ * @brief Latency statistics for the jobs run by a @c tessellation_service.
+ *
+ * Latencies are measured from when a job is submitted to when its mesh is
+ * ready, in seconds.  @c histogram[0] counts the jobs that completed in
+ * less than 1&nbsp;ms; @c histogram[i] counts those that took at least
+ * 2<sup>i-1</sup>&nbsp;ms and less than 2<sup>i</sup>&nbsp;ms; and the last
+ * bucket counts all those that took longer.
+ */
+
+/**
+ * @var std::size_t openvrml::tessellation_service::statistics::completed
+ *
+ * @brief The number of meshes compiled.
+ */
+
+/**
+ * @var std::size_t openvrml::tessellation_service::statistics::superseded
+ *
+ * @brief The number of jobs skipped because a later revision of the same
+ *        mesh was submitted before they started.
+ */
+
+/**
+ * @var std::size_t openvrml::tessellation_service::statistics::failed
+ *
+ * @brief The number of jobs that threw an exception.
+ */
+
+/**
+ * @var double openvrml::tessellation_service::statistics::total_latency
+ *
+ * @brief The sum of the latencies of the completed jobs.
+ */
+
+/**
+ * @var double openvrml::tessellation_service::statistics::max_latency
+ *
+ * @brief The longest latency of a completed job.
+ */
+
+/**
+ * @var std::size_t openvrml::tessellation_service::statistics::histogram[openvrml::tessellation_service::statistics::buckets]
+ *
+ * @brief Completed jobs by latency.
+ */
+
+/**
+ * @var const std::size_t openvrml::tessellation_service::threads_
+ *
+ * @brief The number of worker threads to start.
+ */
+
+/**
+ * @var boost::mutex openvrml::tessellation_service::mutex_
+ *
+ * @brief Mutex protecting the other members.
+ */
+
+/**
+ * @var boost::scoped_ptr<openvrml::local::thread_pool> openvrml::tessellation_service::pool_
+ *
+ * @brief The worker threads; created when the first job is submitted.
+ */
+
+/**
+ * @var std::size_t openvrml::tessellation_service::async_threshold_
+ *
+ * @brief The cost at or above which jobs are compiled asynchronously.
+ */
+
+/**
+ * @var std::size_t openvrml::tessellation_service::pending_
+ *
+ * @brief The number of jobs submitted and not yet finished.
+ */
+
+/**
+ * @var bool openvrml::tessellation_service::ready_
+ *
+ * @brief Whether a mesh has been compiled since the last call to
+ *        @c #take_ready.
+ */
+
+/**
+ * @var openvrml::tessellation_service::statistics openvrml::tessellation_service::statistics_
+ *
+ * @brief Latency statistics.
+ */
+
+/**
+ * @brief The histogram bucket for a latency.
+ *
+ * @param[in] latency   a latency in seconds.
+ *
+ * @return the index of the @c statistics::histogram bucket that counts
+ *         @p latency.
+ */
+std::size_t
+openvrml::tessellation_service::histogram_bucket(const double latency)
+    OPENVRML_NOTHROW
+{
+    std::size_t bucket = 0;
+    for (double limit = 0.001;
+         latency >= limit && bucket + 1 < statistics::buckets;
+         limit *= 2.0) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+/**
+ * @brief Construct.
+ *
+ * No threads are started until the first job is submitted.
+ *
+ * @param[in] threads   the number of worker threads; if 0, one fewer than
+ *                      the number of hardware threads (but at least one).
+ */
+openvrml::tessellation_service::tessellation_service(const std::size_t threads)
+    OPENVRML_NOTHROW:
+    threads_(threads > 0
+             ? threads
+             : (std::max)(boost::thread::hardware_concurrency(), 2U) - 1),
+    async_threshold_(16384),
+    pending_(0),
+    ready_(false)
+{
+    this->reset_statistics();
+}
+
+/**
+ * @brief Destroy.
+ *
+ * Jobs that have not started are skipped if their @c async_mesh no longer
+ * exists; the others are finished before the threads exit.
+ */
+openvrml::tessellation_service::~tessellation_service() OPENVRML_NOTHROW
+{
+    //
+    // The workers report to this object as they finish; so they must be
+    // joined while the rest of it still exists.
+    //
+    this->pool_.reset();
+}
+
+/**
+ * @brief Set the cost at or above which jobs are compiled asynchronously.
+ *
+ * The cost of a job is roughly the number of face corners it compiles.  A
+ * threshold of 0 makes all jobs asynchronous; the largest @c std::size_t
+ * value makes them all synchronous.
+ *
+ * @param[in] cost  the threshold.
+ */
+void openvrml::tessellation_service::async_threshold(const std::size_t cost)
+    OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    this->async_threshold_ = cost;
+}
+
+/**
+ * @brief The cost at or above which jobs are compiled asynchronously.
+ *
+ * The default is 16384.
+ *
+ * @return the cost at or above which jobs are compiled asynchronously.
+ */
+std::size_t openvrml::tessellation_service::async_threshold() const
+    OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    return this->async_threshold_;
+}
+
+/**
+ * @brief The number of jobs that have been submitted and have not finished.
+ *
+ * @return the number of jobs that have been submitted and have not
+ *         finished.
+ */
+std::size_t openvrml::tessellation_service::pending() const OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    return this->pending_;
+}
+
+/**
+ * @brief Whether any mesh has been compiled asynchronously since the last
+ *        call.
+ *
+ * @return @c true if any mesh has been compiled asynchronously since the
+ *         last call; @c false otherwise.
+ */
+bool openvrml::tessellation_service::take_ready() OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    const bool ready = this->ready_;
+    this->ready_ = false;
+    return ready;
+}
+
+/**
+ * @brief Wait for the jobs that have been submitted to finish.
+ *
+ * The calling thread helps to run them.
+ */
+void openvrml::tessellation_service::wait() OPENVRML_NOTHROW
+{
+    local::thread_pool * pool;
+    {
+        boost::lock_guard<boost::mutex> lock(this->mutex_);
+        pool = this->pool_.get();
+    }
+    if (pool) { pool->wait(); }
+}
+
+/**
+ * @brief Latency statistics for the jobs run since the statistics were last
+ *        reset.
+ *
+ * Meshes compiled synchronously are included; their latency is the time
+ * taken to compile them.
+ *
+ * @return latency statistics.
+ */
+const openvrml::tessellation_service::statistics
+openvrml::tessellation_service::latency_statistics() const OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    return this->statistics_;
+}
+
+/**
+ * @brief Reset the latency statistics.
+ */
+void openvrml::tessellation_service::reset_statistics() OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    this->statistics_.completed = 0;
+    this->statistics_.superseded = 0;
+    this->statistics_.failed = 0;
+    this->statistics_.total_latency = 0.0;
+    this->statistics_.max_latency = 0.0;
+    std::fill(this->statistics_.histogram,
+              this->statistics_.histogram + statistics::buckets,
+              std::size_t(0));
+}
+
+/**
+ * @internal
+ *
+ * @brief Queue a job on the worker threads.
+ *
+ * @param[in] t a job.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if the worker threads cannot be
+ *                                          started.
+ */
+void openvrml::tessellation_service::submit(const task & t)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error)
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    if (!this->pool_) {
+        this->pool_.reset(new local::thread_pool(this->threads_));
+    }
+    this->pool_->submit(t);
+    ++this->pending_;
+}
+
+/**
+ * @internal
+ *
+ * @brief Record the outcome of a job.
+ *
+ * @param[in] latency   the time taken, in seconds.
+ * @param[in] compiled  whether a mesh was compiled.
+ * @param[in] failed    whether the job threw an exception.
+ */
+void openvrml::tessellation_service::finished(const double latency,
+                                              const bool compiled,
+                                              const bool failed)
+    OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    if (this->pending_ > 0) { --this->pending_; }
+    if (failed) {
+        ++this->statistics_.failed;
+    } else if (!compiled) {
+        ++this->statistics_.superseded;
+    } else {
+        this->ready_ = true;
+        add_latency(this->statistics_, latency);
+    }
+}
+
+/**
+ * @internal
+ *
+ * @brief Record the latency of a mesh compiled synchronously.
+ *
+ * @param[in] latency   the time taken, in seconds.
+ */
+void openvrml::tessellation_service::compiled(const double latency)
+    OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->mutex_);
+    add_latency(this->statistics_, latency);
+}
+
+
+/**
+ * @class openvrml::async_mesh openvrml/tessellation_service.h
+ *
+ * @brief The mesh of a @c geometry_node, compiled by a
+ *        @c tessellation_service.
+ *
+ * Each call to @c #compile starts a new revision of the mesh.  The mesh of
+ * the previous revision remains current until @c #update finds that a later
+ * one is ready; if there is no previous mesh, a proxy is current instead.
+ * An @c async_mesh is meant to be used from the rendering thread.
+ */
+
+/**
+ * @internal
+ *
+ * @struct openvrml::async_mesh::state
+ *
+ * @brief The part of an @c async_mesh shared with its pending jobs.
+ */
+
+/**
+ * @var boost::mutex openvrml::async_mesh::state::mutex
+ *
+ * @brief Mutex protecting the other members.
+ */
+
+/**
+ * @var std::size_t openvrml::async_mesh::state::requested
+ *
+ * @brief The latest revision submitted.
+ */
+
+/**
+ * @var std::size_t openvrml::async_mesh::state::completed
+ *
+ * @brief The latest revision compiled.
+ */
+
+/**
+ * @var boost::shared_ptr<const openvrml::compiled_mesh> openvrml::async_mesh::state::result
+ *
+ * @brief A mesh that has been compiled and not yet taken by @c #update.
+ */
+
+/**
+ * @brief Construct.
+ */
+openvrml::async_mesh::state::state() OPENVRML_NOTHROW:
+    requested(0),
+    completed(0)
+{}
+
+/**
+ * @var const boost::shared_ptr<openvrml::async_mesh::state> openvrml::async_mesh::state_
+ *
+ * @brief The state shared with pending jobs.
+ */
+
+/**
+ * @var std::size_t openvrml::async_mesh::revision_
+ *
+ * @brief The latest revision.
+ */
+
+/**
+ * @var boost::shared_ptr<const openvrml::compiled_mesh> openvrml::async_mesh::mesh_
+ *
+ * @brief The current mesh.
+ */
+
+/**
+ * @var boost::shared_ptr<const openvrml::compiled_mesh> openvrml::async_mesh::proxy_
+ *
+ * @brief The mesh drawn until the first revision is ready.
+ */
+
+/**
+ * @brief Construct.
+ *
+ * @exception std::bad_alloc    if memory allocation fails.
+ */
+openvrml::async_mesh::async_mesh() OPENVRML_THROW1(std::bad_alloc):
+    state_(new state),
+    revision_(0)
+{}
+
+/**
+ * @brief Destroy.
+ *
+ * Jobs for this mesh that have not started are skipped.
+ */
+openvrml::async_mesh::~async_mesh() OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->state_->mutex);
+    this->state_->requested = 0;
+}
+
+/**
+ * @brief Start a new revision of the mesh.
+ *
+ * If @p cost is less than the @p service's
+ * @c tessellation_service::async_threshold, @p j is run immediately and its
+ * result becomes the current mesh.  Otherwise, @p j is queued; and, if
+ * there is no current mesh, @p proxy is drawn until it is ready.
+ *
+ * @param[in,out] service   a @c tessellation_service.
+ * @param[in] j             a job that compiles the mesh.
+ * @param[in] cost          the approximate number of face corners @p j
+ *                          compiles.
+ * @param[in] proxy         a mesh to draw while there is no other.
+ *
+ * @exception std::bad_alloc                if memory allocation fails.
+ * @exception boost::thread_resource_error  if the worker threads cannot be
+ *                                          started.
+ */
+void openvrml::async_mesh::compile(tessellation_service & service,
+                                   const tessellation_service::job & j,
+                                   const std::size_t cost,
+                                   const compiled_mesh & proxy)
+    OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error)
+{
+    const std::size_t revision = ++this->revision_;
+
+    if (cost < service.async_threshold()) {
+        const double start = browser::current_time();
+        boost::shared_ptr<compiled_mesh> mesh(new compiled_mesh);
+        j(*mesh);
+        {
+            boost::lock_guard<boost::mutex> lock(this->state_->mutex);
+            this->state_->requested = revision;
+            this->state_->completed = revision;
+            this->state_->result.reset();
+        }
+        this->mesh_ = mesh;
+        this->proxy_.reset();
+        service.compiled(browser::current_time() - start);
+        return;
+    }
+
+    if (!this->mesh_ && !proxy.empty()) {
+        this->proxy_.reset(new compiled_mesh(proxy));
+    }
+    {
+        boost::lock_guard<boost::mutex> lock(this->state_->mutex);
+        this->state_->requested = revision;
+    }
+    tessellation_service::task t;
+    t.service = &service;
+    t.state = this->state_;
+    t.revision = revision;
+    t.compile = j;
+    t.submitted = browser::current_time();
+    service.submit(t);
+}
+
+/**
+ * @brief Make the latest compiled revision current.
+ *
+ * @return @c true if the current mesh has changed; @c false otherwise.
+ */
+bool openvrml::async_mesh::update() OPENVRML_NOTHROW
+{
+    boost::shared_ptr<const compiled_mesh> result;
+    {
+        boost::lock_guard<boost::mutex> lock(this->state_->mutex);
+        result.swap(this->state_->result);
+    }
+    if (!result) { return false; }
+    this->mesh_ = result;
+    this->proxy_.reset();
+    return true;
+}
+
+/**
+ * @brief The latest revision.
+ *
+ * @return the number of times @c #compile has been called.
+ */
+std::size_t openvrml::async_mesh::revision() const OPENVRML_NOTHROW
+{
+    return this->revision_;
+}
+
+/**
+ * @brief Whether a revision is being compiled.
+ *
+ * @return @c true if the latest revision has not been compiled; @c false
+ *         otherwise.
+ */
+bool openvrml::async_mesh::pending() const OPENVRML_NOTHROW
+{
+    boost::lock_guard<boost::mutex> lock(this->state_->mutex);
+    return this->state_->requested > this->state_->completed;
+}
+
+/**
+ * @brief The current mesh.
+ *
+ * @return the current mesh; its proxy, if no revision has been compiled; or
+ *         0 if there is neither.
+ */
+const openvrml::compiled_mesh * openvrml::async_mesh::mesh() const
+    OPENVRML_NOTHROW
+{
+    return this->mesh_ ? this->mesh_.get() : this->proxy_.get();
+}
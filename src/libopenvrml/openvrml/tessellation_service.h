@@ -0,0 +1,127 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// OpenVRML
+//
+// Copyright 2012  Braden McDaniel
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or (at your
+// option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_TESSELLATION_SERVICE_H
+#   define OPENVRML_TESSELLATION_SERVICE_H
+
+#   include <openvrml/compiled_mesh.h>
+#   include <boost/function.hpp>
+#   include <boost/scoped_ptr.hpp>
+#   include <boost/shared_ptr.hpp>
+#   include <boost/thread.hpp>
+#   include <boost/utility.hpp>
+
+namespace openvrml {
+
+    namespace local {
+        class thread_pool;
+    }
+
+    class async_mesh;
+
+    class OPENVRML_API tessellation_service : boost::noncopyable {
+        friend class async_mesh;
+
+    public:
+        typedef boost::function1<void, compiled_mesh &> job;
+
+        struct statistics {
+            enum { buckets = 12 };
+
+            std::size_t completed;
+            std::size_t superseded;
+            std::size_t failed;
+            double total_latency;
+            double max_latency;
+            std::size_t histogram[buckets];
+        };
+
+    private:
+        const std::size_t threads_;
+
+        mutable boost::mutex mutex_;
+        boost::scoped_ptr<local::thread_pool> pool_;
+        std::size_t async_threshold_;
+        std::size_t pending_;
+        bool ready_;
+        statistics statistics_;
+
+    public:
+        static std::size_t histogram_bucket(double latency) OPENVRML_NOTHROW;
+
+        explicit tessellation_service(std::size_t threads = 0)
+            OPENVRML_NOTHROW;
+        ~tessellation_service() OPENVRML_NOTHROW;
+
+        void async_threshold(std::size_t cost) OPENVRML_NOTHROW;
+        std::size_t async_threshold() const OPENVRML_NOTHROW;
+
+        std::size_t pending() const OPENVRML_NOTHROW;
+        bool take_ready() OPENVRML_NOTHROW;
+        void wait() OPENVRML_NOTHROW;
+
+        const statistics latency_statistics() const OPENVRML_NOTHROW;
+        void reset_statistics() OPENVRML_NOTHROW;
+
+    private:
+        struct task;
+
+        void submit(const task & t)
+            OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error);
+        void finished(double latency, bool compiled, bool failed)
+            OPENVRML_NOTHROW;
+        void compiled(double latency) OPENVRML_NOTHROW;
+    };
+
+
+    class OPENVRML_API async_mesh : boost::noncopyable {
+        friend struct tessellation_service::task;
+
+        struct state {
+            boost::mutex mutex;
+            std::size_t requested;
+            std::size_t completed;
+            boost::shared_ptr<const compiled_mesh> result;
+
+            state() OPENVRML_NOTHROW;
+        };
+
+        const boost::shared_ptr<state> state_;
+        std::size_t revision_;
+        boost::shared_ptr<const compiled_mesh> mesh_;
+        boost::shared_ptr<const compiled_mesh> proxy_;
+
+    public:
+        async_mesh() OPENVRML_THROW1(std::bad_alloc);
+        ~async_mesh() OPENVRML_NOTHROW;
+
+        void compile(tessellation_service & service,
+                     const tessellation_service::job & j,
+                     std::size_t cost,
+                     const compiled_mesh & proxy = compiled_mesh())
+            OPENVRML_THROW2(std::bad_alloc, boost::thread_resource_error);
+        bool update() OPENVRML_NOTHROW;
+        std::size_t revision() const OPENVRML_NOTHROW;
+        bool pending() const OPENVRML_NOTHROW;
+        const compiled_mesh * mesh() const OPENVRML_NOTHROW;
+    };
+}
+
+# endif // OPENVRML_TESSELLATION_SERVICE_H
@@ -31,6 +31,9 @@
 
 # include <private.h>
 # include "viewer.h"
+# include "compiled_mesh.h"
+# include "browser.h"
+# include "local/pick_engine.h"
 
 /**
  * @class openvrml::viewer openvrml/viewer.h
@@ -131,6 +134,23 @@ openvrml::browser * openvrml::viewer::browser() const OPENVRML_NOTHROW
     return this->browser_;
 }
 
+/**
+ * @internal
+ *
+ * @brief The pick engine of the associated @c browser.
+ *
+ * The @c insert_* functions give it the triangles of each geometry, so that
+ * @c browser::pick does not need the viewer.
+ *
+ * @return the pick engine of the associated @c browser; or 0 if the
+ *         @c viewer is not associated with a @c browser.
+ */
+openvrml::local::pick_engine * openvrml::viewer::picks() const
+    OPENVRML_NOTHROW
+{
+    return this->browser_ ? this->browser_->pick_engine_.get() : 0;
+}
+
 /**
  * @brief Get the rendering mode.
  *
@@ -248,7 +268,8 @@ void openvrml::viewer::insert_background(const background_node & n)
 /**
  * @brief Insert a box into a display list.
  *
- * This function delegates to @c viewer::do_insert_box.
+ * This function delegates to @c viewer::do_insert_box; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n     the @c geometry_node corresponding to the box.
  * @param[in] size  box dimensions.
@@ -256,6 +277,9 @@ void openvrml::viewer::insert_background(const background_node & n)
 void openvrml::viewer::insert_box(const geometry_node & n, const vec3f & size)
 {
     this->do_insert_box(n, size);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_box(n, size);
+    }
 }
 
 /**
@@ -270,7 +294,8 @@ void openvrml::viewer::insert_box(const geometry_node & n, const vec3f & size)
 /**
  * @brief Insert a cone into a display list.
  *
- * This function delegates to @c viewer::do_insert_cone.
+ * This function delegates to @c viewer::do_insert_cone; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n         the @c geometry_node corresponding to the cone.
  * @param[in] height    height.
@@ -285,6 +310,9 @@ void openvrml::viewer::insert_cone(const geometry_node & n,
                                    const bool side)
 {
     this->do_insert_cone(n, height, radius, bottom, side);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_cone(n, height, radius, bottom, side);
+    }
 }
 
 /**
@@ -302,7 +330,8 @@ void openvrml::viewer::insert_cone(const geometry_node & n,
 /**
  * @brief Insert a cylinder into a display list.
  *
- * This function delegates to @c viewer::do_insert_cylinder.
+ * This function delegates to @c viewer::do_insert_cylinder; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n         the @c geometry_node corresponding to the cylinder.
  * @param[in] height    height.
@@ -319,6 +348,9 @@ void openvrml::viewer::insert_cylinder(const geometry_node & n,
                                        const bool top)
 {
     this->do_insert_cylinder(n, height, radius, bottom, side, top);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_cylinder(n, height, radius, bottom, side, top);
+    }
 }
 
 /**
@@ -337,7 +369,8 @@ void openvrml::viewer::insert_cylinder(const geometry_node & n,
 /**
  * @brief Insert an elevation grid into a display list.
  *
- * This function delegates to @c viewer::do_insert_elevation_grid.
+ * This function delegates to @c viewer::do_insert_elevation_grid; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n             the @c geometry_node corresponding to the elevation
  *                          grid.
@@ -367,6 +400,12 @@ openvrml::viewer::insert_elevation_grid(const geometry_node & n,
                                    x_dimension, z_dimension,
                                    x_spacing, z_spacing,
                                    color, normal, tex_coord);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_elevation_grid(n, mask, height,
+                                     x_dimension, z_dimension,
+                                     x_spacing, z_spacing,
+                                     tex_coord);
+    }
 }
 
 /**
@@ -390,7 +429,8 @@ openvrml::viewer::insert_elevation_grid(const geometry_node & n,
 /**
  * @brief Insert an extrusion into a display list.
  *
- * This function delegates to @c viewer::do_insert_extrusion.
+ * This function delegates to @c viewer::do_insert_extrusion; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n             the @c geometry_node corresponding to the extrusion.
  * @param[in] mask
@@ -409,6 +449,10 @@ openvrml::viewer::insert_extrusion(const geometry_node & n,
 {
     this->do_insert_extrusion(n, mask,
                               spine, cross_section, orientation, scale);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_extrusion(n, mask,
+                                spine, cross_section, orientation, scale);
+    }
 }
 
 /**
@@ -494,7 +538,8 @@ openvrml::viewer::insert_point_set(const geometry_node & n,
 /**
  * @brief Insert a shell into a display list.
  *
- * This function delegates to @c viewer::do_insert_shell.
+ * This function delegates to @c viewer::do_insert_shell; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n               the @c geometry_node corresponding to the shell.
  * @param[in] mask
@@ -524,6 +569,12 @@ openvrml::viewer::insert_shell(const geometry_node & n,
                           color, color_index,
                           normal, normal_index,
                           tex_coord, tex_coord_index);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_shell(n, mask,
+                            coord, coord_index,
+                            normal, normal_index,
+                            tex_coord, tex_coord_index);
+    }
 }
 
 /**
@@ -543,10 +594,61 @@ openvrml::viewer::insert_shell(const geometry_node & n,
  * @param[in] tex_coord_index texture coordinate indices.
  */
 
+/**
+ * @brief Insert a compiled mesh into a display list.
+ *
+ * This function delegates to @c viewer::do_insert_mesh; the
+ * triangles are also cached for @c browser::pick.
+ *
+ * @param[in] n     the @c geometry_node corresponding to the mesh.
+ * @param[in] mesh  a compiled mesh.
+ */
+void openvrml::viewer::insert_mesh(const geometry_node & n,
+                                   const compiled_mesh & mesh)
+{
+    this->do_insert_mesh(n, mesh);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_mesh(n, mesh);
+    }
+}
+
+/**
+ * @brief Insert a compiled mesh into a display list.
+ *
+ * The default implementation passes the triangles of @p mesh to
+ * @c viewer::do_insert_shell; each triangle is a face, and colors and
+ * normals are given per vertex.  Viewers that can use the vertex streams of
+ * @p mesh directly should override this function.
+ *
+ * @param[in] n     the @c geometry_node corresponding to the mesh.
+ * @param[in] mesh  a compiled mesh.
+ */
+void openvrml::viewer::do_insert_mesh(const geometry_node & n,
+                                      const compiled_mesh & mesh)
+{
+    const std::vector<int32> & index = mesh.index();
+    std::vector<int32> coord_index;
+    coord_index.reserve(index.size() + index.size() / 3);
+    for (size_t i = 0; i < index.size(); i += 3) {
+        coord_index.insert(coord_index.end(),
+                           index.begin() + i, index.begin() + i + 3);
+        coord_index.push_back(-1);
+    }
+    const unsigned int mask =
+        (mesh.mask() & (mask_ccw | mask_solid))
+        | mask_convex | mask_color_per_vertex | mask_normal_per_vertex;
+    this->do_insert_shell(n, mask,
+                          mesh.coord(), coord_index,
+                          mesh.color(), std::vector<int32>(),
+                          mesh.normal(), std::vector<int32>(),
+                          mesh.tex_coord(), std::vector<int32>());
+}
+
 /**
  * @brief Insert a sphere into a display list.
  *
- * This function delegates to @c viewer::do_insert_sphere.
+ * This function delegates to @c viewer::do_insert_sphere; the
+ * triangles are also cached for @c browser::pick.
  *
  * @param[in] n         the @c geometry_node corresponding to the sphere.
  * @param[in] radius    sphere radius.
@@ -555,6 +657,9 @@ void openvrml::viewer::insert_sphere(const geometry_node & n,
                                      const float radius)
 {
     this->do_insert_sphere(n, radius);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->insert_sphere(n, radius);
+    }
 }
 
 /**
@@ -693,13 +798,17 @@ void openvrml::viewer::insert_spot_light(const float ambient_intensity,
 /**
  * @brief Remove an object from the display list.
  *
- * This function delegates to @c viewer::do_remove_object.
+ * This function delegates to @c viewer::do_remove_object; cached
+ * triangles for @c browser::pick are discarded.
  *
  * @param[in] ref   object handle.
  */
 void openvrml::viewer::remove_object(const node & ref)
 {
     this->do_remove_object(ref);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->remove(ref);
+    }
 }
 
 /**
@@ -846,13 +955,18 @@ void openvrml::viewer::set_material_mode(const size_t tex_components,
 /**
  * @brief Indicate that a node should be sensitive to the pointing device.
  *
- * This function delegates to @c viewer::do_set_sensitive.
+ * This function delegates to @c viewer::do_set_sensitive.  Geometry
+ * drawn until the next call is picked on behalf of @p object; 0 restores
+ * the enclosing sensitive node.
  *
  * @param[in] object    a node.
  */
 void openvrml::viewer::set_sensitive(node * const object)
 {
     this->do_set_sensitive(object);
+    if (local::pick_engine * const picks = this->picks()) {
+        picks->sensitive(object);
+    }
 }
 
 /**
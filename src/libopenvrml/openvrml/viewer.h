@@ -29,16 +29,23 @@
 namespace openvrml {
 
     class browser;
+    class compiled_mesh;
     class node;
     class background_node;
     class geometry_node;
     class texture_node;
 
+    namespace local {
+        class pick_engine;
+    }
+
     class OPENVRML_API viewer : boost::noncopyable {
         friend class browser;
 
         openvrml::browser * browser_;
 
+        OPENVRML_LOCAL local::pick_engine * picks() const OPENVRML_NOTHROW;
+
     protected:
         openvrml::frustum frustum_;
 
@@ -111,6 +118,7 @@ namespace openvrml {
                           const std::vector<int32> & normal_index,
                           const std::vector<vec2f> & tex_coord,
                           const std::vector<int32> & tex_coord_index);
+        void insert_mesh(const geometry_node & n, const compiled_mesh & mesh);
         void insert_sphere(const geometry_node & n, float radius);
         void insert_dir_light(float ambient_intensity,
                               float intensity,
@@ -253,6 +261,8 @@ namespace openvrml {
                              const std::vector<int32> & normal_index,
                              const std::vector<vec2f> & tex_coord,
                              const std::vector<int32> & tex_coord_index) = 0;
+        virtual void do_insert_mesh(const geometry_node & n,
+                                    const compiled_mesh & mesh);
         virtual
         void do_insert_sphere(const geometry_node & n, float radius) = 0;
 
@@ -27,7 +27,13 @@
 #   include <boost/spirit/include/classic_dynamic.hpp>
 #   include <boost/spirit/include/phoenix1.hpp>
 #   include <boost/test/floating_point_comparison.hpp>
+#   include <cstring>
 #   include <stack>
+#   if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#     include <emmintrin.h>
+#     define OPENVRML_VRML97_GRAMMAR_SSE2 1
+#   endif
 
 namespace openvrml {
 
@@ -551,6 +557,281 @@ namespace openvrml {
     };
 
 
+    //
+    // Bulk parsing of numeric MF values.
+    //
+    // When the input is contiguous (i.e., the scanner iterator is a const
+    // char *), bracketed MFFloat, MFInt32, MFVec2f, and MFVec3f values are
+    // scanned by hand directly into the result vector rather than element by
+    // element through the rules in mftype_parser.  Separators are skipped 16
+    // bytes at a time where SSE2 is available.  Individual numbers are still
+    // converted by float_p and int32_p so that the values are identical to
+    // those produced by the rules.
+    //
+    // Anything the bulk scanner does not expect causes it to give up and
+    // leave the scanner where it was; mftype_parser then parses the value as
+    // before, so diagnostics are unchanged.
+    //
+    namespace mf_bulk {
+
+        inline bool is_separator(const char c)
+        {
+            return c == ' ' || c == ',' || c == '\n' || c == '\r'
+                || c == '\t' || c == '\v' || c == '\f';
+        }
+
+#   ifdef OPENVRML_VRML97_GRAMMAR_SSE2
+        //
+        // Set bit i in the result if p[i] is a separator.
+        //
+        inline unsigned separator_mask(const char * const p)
+        {
+            const __m128i c =
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i m = _mm_or_si128(
+                _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')),
+                _mm_cmpeq_epi8(c, _mm_set1_epi8(',')));
+            //
+            // '\t', '\n', '\v', '\f', and '\r' are 9 through 13.
+            //
+            const __m128i ws = _mm_sub_epi8(c, _mm_set1_epi8('\t'));
+            m = _mm_or_si128(
+                m,
+                _mm_cmpeq_epi8(_mm_min_epu8(ws, _mm_set1_epi8(4)), ws));
+            return static_cast<unsigned>(_mm_movemask_epi8(m));
+        }
+#   endif
+
+        inline unsigned count_bits(unsigned x)
+        {
+            unsigned n = 0;
+            for (; x; x &= x - 1) { ++n; }
+            return n;
+        }
+
+        inline unsigned trailing_ones(unsigned x)
+        {
+            unsigned n = 0;
+            for (; x & 1; x >>= 1) { ++n; }
+            return n;
+        }
+
+        //
+        // Skip separators and comments.
+        //
+        inline const char * skip(const char * p, const char * const end)
+        {
+            while (p != end) {
+#   ifdef OPENVRML_VRML97_GRAMMAR_SSE2
+                if (end - p >= 16) {
+                    const unsigned mask = separator_mask(p);
+                    p += trailing_ones(mask);
+                    if (mask == 0xffff) { continue; }
+                }
+#   endif
+                if (is_separator(*p)) {
+                    ++p;
+                } else if (*p == '#') {
+                    while (p != end && *p != '\n' && *p != '\r') { ++p; }
+                } else {
+                    break;
+                }
+            }
+            return p;
+        }
+
+        //
+        // Count the whitespace-delimited tokens in [p, end).  This is used
+        // only to size the result, so comments are not given any special
+        // treatment.
+        //
+        inline std::size_t count_tokens(const char * p,
+                                        const char * const end)
+        {
+            std::size_t count = 0;
+            bool after_separator = true;
+#   ifdef OPENVRML_VRML97_GRAMMAR_SSE2
+            for (; end - p >= 16; p += 16) {
+                const unsigned sep = separator_mask(p);
+                const unsigned prev = ((sep << 1) | (after_separator ? 1 : 0))
+                                      & 0xffff;
+                count += count_bits(~sep & prev & 0xffff);
+                after_separator = (sep & 0x8000) != 0;
+            }
+#   endif
+            for (; p != end; ++p) {
+                const bool sep = is_separator(*p);
+                if (!sep && after_separator) { ++count; }
+                after_separator = sep;
+            }
+            return count;
+        }
+
+        template <typename T, typename ElementParser>
+        inline bool parse_number(const ElementParser & parser,
+                                 const char * & p,
+                                 const char * const end,
+                                 T & result)
+        {
+            using boost::spirit::classic::match;
+            using boost::spirit::classic::scanner;
+            const char * first = p;
+            const scanner<const char *> scan(first, end);
+            const match<T> m = parser.parse(scan);
+            if (!m) { return false; }
+            result = m.value();
+            p = first;
+            return true;
+        }
+
+        struct float_element {
+            static const std::size_t components = 1;
+
+            static bool parse(const char * & p, const char * const end,
+                              float & result)
+            {
+                return parse_number(float_p, p, end, result);
+            }
+        };
+
+        struct int32_element {
+            static const std::size_t components = 1;
+
+            static bool parse(const char * & p, const char * const end,
+                              int32 & result)
+            {
+                return parse_number(int32_p, p, end, result);
+            }
+        };
+
+        template <typename Vec, std::size_t N>
+        struct vec_element {
+            static const std::size_t components = N;
+
+            static bool parse(const char * & p, const char * const end,
+                              Vec & result)
+            {
+                for (std::size_t i = 0; i < N; ++i) {
+                    if (i > 0) { p = skip(p, end); }
+                    if (!parse_number(float_p, p, end, result.vec[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
+
+        //
+        // Parse a bracketed list of elements starting at first.  Returns
+        // false (leaving first and result alone) if anything unexpected is
+        // encountered.
+        //
+        template <typename Element, typename T>
+        bool parse_list(const char * & first,
+                        const char * const end,
+                        std::vector<T> & result)
+        {
+            const char * p = skip(first, end);
+            if (p == end || *p != '[') { return false; }
+            ++p;
+
+            const char * const rbracket =
+                static_cast<const char *>(std::memchr(p, ']', end - p));
+            if (!rbracket) { return false; }
+
+            std::vector<T> values;
+            values.reserve(count_tokens(p, rbracket) / Element::components);
+            T value;
+            for (;;) {
+                p = skip(p, end);
+                if (p == end) { return false; }
+                if (*p == ']') { ++p; break; }
+                if (!Element::parse(p, end, value)) { return false; }
+                values.push_back(value);
+            }
+            result.swap(values);
+            first = p;
+            return true;
+        }
+    }
+
+    template <typename ScannerT, typename ElementParser, typename T>
+    bool bulk_parse_mf(const ScannerT &,
+                       const ElementParser &,
+                       std::vector<T> &,
+                       std::ptrdiff_t &)
+    {
+        return false;
+    }
+
+    template <typename PoliciesT>
+    bool bulk_parse_mf(
+        const boost::spirit::classic::scanner<const char *, PoliciesT> & scan,
+        const boost::spirit::classic::real_parser<
+            float,
+            boost::spirit::classic::real_parser_policies<float> > &,
+        std::vector<float> & result,
+        std::ptrdiff_t & length)
+    {
+        const char * const start = scan.first;
+        if (!mf_bulk::parse_list<mf_bulk::float_element>(
+                scan.first, scan.last, result)) {
+            return false;
+        }
+        length = scan.first - start;
+        return true;
+    }
+
+    template <typename PoliciesT>
+    bool bulk_parse_mf(
+        const boost::spirit::classic::scanner<const char *, PoliciesT> & scan,
+        const boost::spirit::classic::functor_parser<int32_parser> &,
+        std::vector<int32> & result,
+        std::ptrdiff_t & length)
+    {
+        const char * const start = scan.first;
+        if (!mf_bulk::parse_list<mf_bulk::int32_element>(scan.first,
+                                                         scan.last,
+                                                         result)) {
+            return false;
+        }
+        length = scan.first - start;
+        return true;
+    }
+
+    template <typename PoliciesT>
+    bool bulk_parse_mf(
+        const boost::spirit::classic::scanner<const char *, PoliciesT> & scan,
+        const boost::spirit::classic::functor_parser<vec2f_parser> &,
+        std::vector<vec2f> & result,
+        std::ptrdiff_t & length)
+    {
+        const char * const start = scan.first;
+        if (!mf_bulk::parse_list<mf_bulk::vec_element<vec2f, 2> >(
+                scan.first, scan.last, result)) {
+            return false;
+        }
+        length = scan.first - start;
+        return true;
+    }
+
+    template <typename PoliciesT>
+    bool bulk_parse_mf(
+        const boost::spirit::classic::scanner<const char *, PoliciesT> & scan,
+        const boost::spirit::classic::functor_parser<vec3f_parser> &,
+        std::vector<vec3f> & result,
+        std::ptrdiff_t & length)
+    {
+        const char * const start = scan.first;
+        if (!mf_bulk::parse_list<mf_bulk::vec_element<vec3f, 3> >(
+                scan.first, scan.last, result)) {
+            return false;
+        }
+        length = scan.first - start;
+        return true;
+    }
+
+
     struct image_parser {
 
         struct set_pixel {
@@ -1342,6 +1623,11 @@ namespace openvrml {
                         expect_element_or_rbracket(
                             get_mftype_parse_error<ElementParser>::element_or_rbracket_value);
 
+                    std::ptrdiff_t length;
+                    if (bulk_parse_mf(scan, this->parser_, result, length)) {
+                        return length;
+                    }
+
                     rule_t rule
                         =   this->parser_[push_back_a(result)]
                         |   expect_element_or_lbracket(ch_p('['))
@@ -1582,7 +1868,8 @@ namespace openvrml {
                         const defs_t::const_iterator pos =
                             this->scope_stack_.top().defs.find(node_name_id);
                         if (pos == this->scope_stack_.top().defs.end()) {
-                            throw_(first, unknown_node_name_id);
+                            boost::spirit::classic::throw_(
+                                first, unknown_node_name_id);
                         }
                         this->node_type_ = &(*pos);
                     }
@@ -1671,7 +1958,8 @@ namespace openvrml {
                         this->node_type_ =
                             find_node_type(this->scope_stack_, node_type_id);
                         if (!this->node_type_) {
-                            throw_(first, unknown_node_type_id);
+                            boost::spirit::classic::throw_(
+                                first, unknown_node_type_id);
                         }
                     }
 
@@ -1926,7 +2214,8 @@ namespace openvrml {
                 void operator()(const IteratorT & first, IteratorT) const
                 {
                     if (this->exists_) {
-                        throw_(first, openvrml::node_type_already_exists);
+                        boost::spirit::classic::throw_(
+                            first, openvrml::node_type_already_exists);
                     }
                 }
 
@@ -839,7 +839,7 @@ namespace openvrml {
                     profile_statement[on_profile_statement]
                     >> *component_statement[on_component_statement]
                     >> *meta_statement[on_meta_statement]
-                    >> *statement >> end_p
+                    >> *statement >> eps_p[base_t::on_scene_finish] >> end_p
                 )[self.vrml97_g.error_handler]
             ;
 
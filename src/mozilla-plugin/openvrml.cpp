@@ -384,6 +384,8 @@ OPENVRML_NP_GETMIMEDESCRIPTION_CONST char * NPP_GetMIMEDescription()
 {
     static const char mimeDescription[] =
         "model/x3d-vrml:x3dv:X3D world;"
+        "model/x3d+xml:x3d:X3D world;"
+        "model/x3d+fastinfoset:x3db:X3D world;"
         "model/vrml:wrl:VRML world;"
         "x-world/x-vrml:wrl:VRML world";
     return &mimeDescription[0];
@@ -44,6 +44,15 @@
  * @brief The bound Background node stack.
  */
 
+/**
+ * @var const boost::scoped_ptr<openvrml_node_vrml97::background_node> openvrml_node_vrml97::background_metatype::default_background_
+ *
+ * @brief The Background rendered when no Background node is bound.
+ *
+ * This is destroyed with the @c background_metatype, before the
+ * @c browser is.
+ */
+
 /**
  * @brief @c node_metatype identifier.
  */
@@ -60,7 +69,10 @@ background_metatype(openvrml::browser & browser):
     node_metatype(background_metatype::id, browser),
     first(0),
     default_background_node_metatype_(browser),
-    default_background_node_type_(this->default_background_node_metatype_)
+    default_background_node_type_(this->default_background_node_metatype_),
+    default_background_(
+        new background_node(this->default_background_node_type_,
+                            boost::shared_ptr<openvrml::scope>()))
 {}
 
 /**
@@ -200,11 +212,7 @@ do_render(openvrml::viewer & v) const
         //
         // Default background.
         //
-        static const boost::shared_ptr<openvrml::scope> null_scope_ptr;
-        static const background_node
-            default_background(this->default_background_node_type_,
-                               null_scope_ptr);
-        v.insert_background(default_background);
+        v.insert_background(*this->default_background_);
     } else {
         assert(this->bound_nodes.top());
         background_node & background = *this->bound_nodes.top();
@@ -21,6 +21,7 @@
 //
 
 # include <openvrml/node_impl_util.h>
+# include <boost/scoped_ptr.hpp>
 
 namespace openvrml_node_vrml97 {
 
@@ -34,6 +35,7 @@ namespace openvrml_node_vrml97 {
         openvrml::node_impl_util::bound_node_stack<background_node> bound_nodes;
         openvrml::null_node_metatype default_background_node_metatype_;
         openvrml::null_node_type default_background_node_type_;
+        const boost::scoped_ptr<background_node> default_background_;
 
     public:
         static const char * const id;
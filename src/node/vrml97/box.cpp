@@ -51,6 +51,9 @@ namespace {
         virtual const openvrml::bounding_volume & do_bounding_volume() const;
         virtual void do_render_geometry(openvrml::viewer & viewer,
                                         openvrml::rendering_context context);
+        virtual bool do_occluder(openvrml::vec3f & minimum,
+                                 openvrml::vec3f & maximum) const
+            OPENVRML_NOTHROW;
     };
 
 
@@ -115,6 +118,23 @@ namespace {
         viewer.insert_box(*this, this->size.value());
     }
 
+    /**
+     * @brief The box filled by the geometry.
+     *
+     * @param[out] minimum  the minimum corner of the box.
+     * @param[out] maximum  the maximum corner of the box.
+     *
+     * @return @c true.
+     */
+    bool box_node::do_occluder(openvrml::vec3f & minimum,
+                               openvrml::vec3f & maximum) const
+        OPENVRML_NOTHROW
+    {
+        maximum = this->size.value() / 2.0f;
+        minimum = -maximum;
+        return true;
+    }
+
     /**
      * @brief Get the bounding volume.
      *
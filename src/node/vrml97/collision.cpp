@@ -51,6 +51,9 @@ namespace {
     private:
         virtual bool do_modified() const
             OPENVRML_THROW1(boost::thread_resource_error);
+        virtual void do_render_child(openvrml::viewer & viewer,
+                                     openvrml::rendering_context context);
+        virtual void do_collide(double timestamp);
     };
 
 
@@ -128,6 +131,51 @@ namespace {
             || (this->openvrml_node_vrml97::grouping_node_base<collision_node>::
                 do_modified());
     }
+
+    /**
+     * @brief Render the node.
+     *
+     * When the @c browser gathers the geometry the avatar can collide with,
+     * nothing is rendered if @a collide_ is @c FALSE; and the proxy, if
+     * any, is rendered in place of the children.
+     *
+     * @param viewer    a Viewer.
+     * @param context   the rendering context.
+     */
+    void collision_node::do_render_child(openvrml::viewer & viewer,
+                                         openvrml::rendering_context context)
+    {
+        using openvrml::node_cast;
+        using openvrml_node_vrml97::grouping_node_base;
+
+        if (!context.collision_only()) {
+            this->grouping_node_base<collision_node>::do_render_child(
+                viewer, context);
+            return;
+        }
+
+        if (!this->collide_.sfbool::value()) { return; }
+        context.collision(*this);
+        openvrml::child_node * const proxy =
+            node_cast<openvrml::child_node *>(this->proxy_.value().get());
+        if (proxy) {
+            proxy->render_child(viewer, context);
+        } else {
+            this->grouping_node_base<collision_node>::do_render_child(
+                viewer, context);
+        }
+    }
+
+    /**
+     * @brief Emit @c collideTime.
+     *
+     * @param timestamp the current time.
+     */
+    void collision_node::do_collide(const double timestamp)
+    {
+        this->collide_time_.value(timestamp);
+        node::emit_event(this->collide_time_emitter_, timestamp);
+    }
 }
 
 /**
@@ -23,7 +23,13 @@
 # include <private.h>
 # include <openvrml/node_impl_util.h>
 # include <openvrml/viewer.h>
+# include <openvrml/browser.h>
+# include <openvrml/scene.h>
+# include <openvrml/tessellation_service.h>
 # include <boost/array.hpp>
+# include <boost/bind.hpp>
+# include <algorithm>
+# include <cmath>
 
 # ifdef HAVE_CONFIG_H
 #   include <config.h>
@@ -31,6 +37,29 @@
 
 namespace {
 
+    //
+    // The field values an Extrusion's mesh is compiled from; they are copied
+    // so that the mesh can be compiled on another thread.
+    //
+    struct OPENVRML_LOCAL extrusion_data {
+        unsigned int mask;
+        openvrml::mfvec3f spine;
+        openvrml::mfvec2f cross_section;
+        openvrml::mfrotation orientation;
+        openvrml::mfvec2f scale;
+        float crease_angle;
+
+        void compile(openvrml::compiled_mesh & mesh) const
+        {
+            openvrml::make_extrusion_mesh(this->mask,
+                                          this->spine.value(),
+                                          this->cross_section.value(),
+                                          this->orientation.value(),
+                                          this->scale.value(),
+                                          this->crease_angle).swap(mesh);
+        }
+    };
+
     class OPENVRML_LOCAL extrusion_node :
         public openvrml::node_impl_util::abstract_node<extrusion_node>,
         public openvrml::geometry_node {
@@ -101,6 +130,8 @@ namespace {
         openvrml::sfbool solid_;
         openvrml::mfvec3f spine_;
 
+        openvrml::async_mesh mesh_;
+
     public:
         extrusion_node(const openvrml::node_type & type,
                        const boost::shared_ptr<openvrml::scope> & scope);
@@ -109,6 +140,9 @@ namespace {
     private:
         virtual void do_render_geometry(openvrml::viewer & viewer,
                                         openvrml::rendering_context context);
+
+        openvrml::compiled_mesh bounding_box_mesh() const
+            OPENVRML_THROW1(std::bad_alloc);
     };
 
     /**
@@ -405,6 +439,16 @@ namespace {
      * @brief spine field.
      */
 
+    /**
+     * @var openvrml::async_mesh extrusion_node::mesh_
+     *
+     * @brief The mesh compiled from the field values.
+     *
+     * Large extrusions are compiled by the browser's
+     * @c openvrml::tessellation_service; until a new mesh is ready, the
+     * previous one (or a bounding box) is drawn.
+     */
+
     const openvrml::vec2f extrusionDefaultCrossSection_[] =
     {
         openvrml::make_vec2f(1.0, 1.0),
@@ -479,10 +523,15 @@ namespace {
     void extrusion_node::do_render_geometry(openvrml::viewer & v,
                                             openvrml::rendering_context)
     {
-        using openvrml::viewer;
+        using std::vector;
+        using namespace openvrml;
 
-        if (!this->cross_section_.value().empty()
-            && this->spine_.value().size() > 1) {
+        //
+        // A mesh compiled in the background replaces the one the viewer has.
+        //
+        if (this->mesh_.update()) { v.remove_object(*this); }
+
+        if (this->modified() || this->mesh_.revision() == 0) {
             unsigned int optMask = 0;
             if (this->ccw_.value())       { optMask |= viewer::mask_ccw; }
             if (this->convex_.value())    { optMask |= viewer::mask_convex; }
@@ -490,13 +539,76 @@ namespace {
             if (this->begin_cap_.value()) { optMask |= viewer::mask_bottom; }
             if (this->end_cap_.value())   { optMask |= viewer::mask_top; }
 
-            v.insert_extrusion(*this,
-                               optMask,
-                               this->spine_.value(),
-                               this->cross_section_.value(),
-                               this->orientation_.value(),
-                               this->scale_.value());
+            const boost::shared_ptr<extrusion_data> data(new extrusion_data);
+            data->mask = optMask;
+            data->spine = this->spine_;
+            data->cross_section = this->cross_section_;
+            data->orientation = this->orientation_;
+            data->scale = this->scale_;
+            data->crease_angle = this->crease_angle_.value();
+
+            const vector<vec3f> & spine = this->spine_.value();
+            const vector<vec2f> & cross_section =
+                this->cross_section_.value();
+            this->mesh_.compile(
+                this->scene()->browser().tessellation_service(),
+                boost::bind(&extrusion_data::compile, data, _1),
+                4 * spine.size() * cross_section.size(),
+                this->mesh_.mesh() ? compiled_mesh()
+                                   : this->bounding_box_mesh());
+        }
+        if (const compiled_mesh * const mesh = this->mesh_.mesh()) {
+            v.insert_mesh(*this, *mesh);
+        }
+    }
+
+    /**
+     * @brief A box enclosing the extrusion.
+     *
+     * The box encloses the spine, grown by the largest distance of a
+     * scaled cross-section point from the spine.
+     *
+     * @return a box enclosing the extrusion.
+     *
+     * @exception std::bad_alloc    if memory allocation fails.
+     */
+    openvrml::compiled_mesh extrusion_node::bounding_box_mesh() const
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        using std::vector;
+        using openvrml::vec2f;
+        using openvrml::vec3f;
+
+        const vector<vec3f> & spine = this->spine_.value();
+        if (spine.empty()) { return openvrml::compiled_mesh(); }
+
+        float radius = 0.0f;
+        for (vector<vec2f>::const_iterator point =
+                 this->cross_section_.value().begin();
+             point != this->cross_section_.value().end();
+             ++point) {
+            radius = (std::max)(radius, point->length());
+        }
+        float scale = this->scale_.value().empty() ? 1.0f : 0.0f;
+        for (vector<vec2f>::const_iterator s = this->scale_.value().begin();
+             s != this->scale_.value().end();
+             ++s) {
+            scale = (std::max)(scale,
+                               (std::max)(std::fabs(s->x()),
+                                          std::fabs(s->y())));
+        }
+        radius *= scale;
+
+        const vec3f grow = openvrml::make_vec3f(radius, radius, radius);
+        vector<vec3f> corners;
+        corners.reserve(2 * spine.size());
+        for (vector<vec3f>::const_iterator point = spine.begin();
+             point != spine.end();
+             ++point) {
+            corners.push_back(*point - grow);
+            corners.push_back(*point + grow);
         }
+        return openvrml::make_bounding_box_mesh(corners);
     }
 }
 
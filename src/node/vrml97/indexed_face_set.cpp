@@ -23,7 +23,11 @@
 # include "abstract_indexed_set.h"
 # include <private.h>
 # include <openvrml/viewer.h>
+# include <openvrml/browser.h>
+# include <openvrml/scene.h>
+# include <openvrml/tessellation_service.h>
 # include <boost/array.hpp>
+# include <boost/bind.hpp>
 
 # ifdef HAVE_CONFIG_H
 #   include <config.h>
@@ -31,6 +35,37 @@
 
 namespace {
 
+    //
+    // The field values an IndexedFaceSet's mesh is compiled from; they are
+    // copied so that the mesh can be compiled on another thread.
+    //
+    struct OPENVRML_LOCAL shell_data {
+        unsigned int mask;
+        std::vector<openvrml::vec3f> coord;
+        openvrml::mfint32 coord_index;
+        std::vector<openvrml::color> color;
+        openvrml::mfint32 color_index;
+        std::vector<openvrml::vec3f> normal;
+        openvrml::mfint32 normal_index;
+        std::vector<openvrml::vec2f> tex_coord;
+        openvrml::mfint32 tex_coord_index;
+        float crease_angle;
+
+        void compile(openvrml::compiled_mesh & mesh) const
+        {
+            openvrml::compiled_mesh(this->mask,
+                                    this->coord,
+                                    this->coord_index.value(),
+                                    this->color,
+                                    this->color_index.value(),
+                                    this->normal,
+                                    this->normal_index.value(),
+                                    this->tex_coord,
+                                    this->tex_coord_index.value(),
+                                    this->crease_angle).swap(mesh);
+        }
+    };
+
     class OPENVRML_LOCAL indexed_face_set_node :
         public openvrml_node_vrml97::abstract_indexed_set_node<indexed_face_set_node> {
 
@@ -77,6 +112,7 @@ namespace {
         openvrml::mfint32 tex_coord_index_;
 
         openvrml::bounding_sphere bsphere;
+        openvrml::async_mesh mesh_;
 
     public:
         indexed_face_set_node(
@@ -281,6 +317,18 @@ namespace {
      * @brief Bounding volume.
      */
 
+    /**
+     * @var openvrml::async_mesh indexed_face_set_node::mesh_
+     *
+     * @brief The mesh compiled from the field values.
+     *
+     * The mesh is compiled when the node is first rendered and again only
+     * when the node (or one of its children) has been modified; all of the
+     * USEs of the node share it.  Large meshes are compiled by the
+     * browser's @c openvrml::tessellation_service; until a new mesh is
+     * ready, the previous one (or a bounding box) is drawn.
+     */
+
     /**
      * @brief Construct.
      *
@@ -334,8 +382,6 @@ namespace {
      *
      * @param v         a viewer.
      * @param context   the rendering context.
-     *
-     * @todo stripify, crease angle, generate normals ...
      */
     void
     indexed_face_set_node::
@@ -401,12 +447,33 @@ namespace {
             optMask |= viewer::mask_normal_per_vertex;
         }
 
-        v.insert_shell(*this,
-                       optMask,
-                       coord, this->coord_index_.value(),
-                       color, this->color_index_.value(),
-                       normal, this->normal_index_.value(),
-                       texCoord, this->tex_coord_index_.value());
+        //
+        // A mesh compiled in the background replaces the one the viewer has.
+        //
+        if (this->mesh_.update()) { v.remove_object(*this); }
+
+        if (this->modified() || this->mesh_.revision() == 0) {
+            const boost::shared_ptr<shell_data> data(new shell_data);
+            data->mask = optMask;
+            data->coord = coord;
+            data->coord_index = this->coord_index_;
+            data->color = color;
+            data->color_index = this->color_index_;
+            data->normal = normal;
+            data->normal_index = this->normal_index_;
+            data->tex_coord = texCoord;
+            data->tex_coord_index = this->tex_coord_index_;
+            data->crease_angle = this->crease_angle_.value();
+            this->mesh_.compile(
+                this->scene()->browser().tessellation_service(),
+                boost::bind(&shell_data::compile, data, _1),
+                this->coord_index_.value().size(),
+                this->mesh_.mesh() ? compiled_mesh()
+                                   : make_bounding_box_mesh(coord));
+        }
+        if (const compiled_mesh * const mesh = this->mesh_.mesh()) {
+            v.insert_mesh(*this, *mesh);
+        }
 
         if (colorNode) { colorNode->modified(false); }
         if (coordinateNode) { coordinateNode->modified(false); }
@@ -29,7 +29,6 @@
 # include <openvrml/scene.h>
 # include <private.h>
 # include <boost/array.hpp>
-# include <boost/function.hpp>
 
 namespace {
 
@@ -39,8 +38,6 @@ namespace {
 
         friend class openvrml_node_vrml97::inline_metatype;
 
-        struct load_inline_scene;
-
         exposedfield<openvrml::mfstring> url_;
         exposedfield<openvrml::sfbool> load_;
         openvrml::sfvec3f bbox_center_;
@@ -48,7 +45,6 @@ namespace {
 
         openvrml::scene * inline_scene_;
         bool loaded_;
-        boost::scoped_ptr<boost::thread> load_inline_scene_thread_;
 
     public:
         inline_node(const openvrml::node_type & type,
@@ -56,6 +52,8 @@ namespace {
         virtual ~inline_node() OPENVRML_NOTHROW;
 
     private:
+        virtual void do_initialize(double timestamp)
+            OPENVRML_THROW1(std::bad_alloc);
         virtual void do_render_child(openvrml::viewer & viewer,
                                      openvrml::rendering_context context);
         virtual const std::vector<boost::intrusive_ptr<openvrml::node> >
@@ -132,10 +130,23 @@ namespace {
      * @brief Destroy.
      */
     inline_node::~inline_node() OPENVRML_NOTHROW
+    {}
+
+    /**
+     * @brief Initialize.
+     *
+     * If the load field is @c TRUE, start loading the contained scene right
+     * away rather than waiting for the node to be rendered; so all of the
+     * Inlines in a newly loaded scene are fetched and parsed concurrently.
+     *
+     * @param timestamp the current time.
+     *
+     * @exception std::bad_alloc    if memory allocation fails.
+     */
+    void inline_node::do_initialize(double)
+        OPENVRML_THROW1(std::bad_alloc)
     {
-        if (this->load_inline_scene_thread_) {
-            this->load_inline_scene_thread_->join();
-        }
+        if (this->load_.sfbool::value()) { this->load(); }
     }
 
     /**
@@ -169,56 +180,12 @@ namespace {
             : empty;
     }
 
-    struct OPENVRML_LOCAL inline_node::load_inline_scene {
-
-        load_inline_scene(openvrml::scene & scene,
-                          const std::vector<std::string> & url):
-            inline_scene_(&scene),
-            url_(&url)
-        {}
-
-        void operator()() const OPENVRML_NOTHROW
-        {
-            try {
-                using std::endl;
-                using std::string;
-                using std::vector;
-                using openvrml::unreachable_url;
-
-                openvrml::scene & inline_scene = *this->inline_scene_;
-                const vector<string> & url = *this->url_;
-
-                assert(inline_scene.url().empty());
-
-                vector<boost::intrusive_ptr<node> > nodes;
-                try {
-                    //
-                    // Any relative URLs passed here will be relative to the
-                    // *parent* scene; so we call get_resource on the parent.
-                    //
-                    assert(inline_scene.parent());
-                    std::auto_ptr<openvrml::resource_istream> in =
-                        inline_scene.parent()->get_resource(url);
-                    if (!(*in)) { throw unreachable_url(); }
-                    inline_scene.load(*in);
-                } catch (std::exception & ex) {
-                    inline_scene.browser().err(ex.what());
-                    throw unreachable_url();
-                } catch (...) {
-                    throw unreachable_url();
-                }
-            } catch (std::exception & ex) {
-                this->inline_scene_->browser().err(ex.what());
-            }
-        }
-
-    private:
-        openvrml::scene * const inline_scene_;
-        const std::vector<std::string> * const url_;
-    };
-
     /**
      * @brief Load the children from the URL.
+     *
+     * The contained scene is fetched and parsed on one of the browser's
+     * loader threads; its nodes are attached and initialized by the next
+     * call to @c openvrml::browser::update.
      */
     void inline_node::load()
     {
@@ -246,10 +213,7 @@ namespace {
         assert(this->scene());
         this->inline_scene_ = new inline_scene(this->scene()->browser(),
                                                this->scene());
-        boost::function0<void> f =
-            load_inline_scene(*this->inline_scene_,
-                              this->url_.mfstring::value());
-        this->load_inline_scene_thread_.reset(new boost::thread(f));
+        this->inline_scene_->load_async(this->url_.mfstring::value());
     }
 }
 
@@ -177,6 +177,8 @@ namespace {
         if (geometry) {
             v.begin_object(this->id().c_str());
 
+            openvrml::rendering_context geometry_context(context);
+
             // Don't care what color it is if we are picking
             bool picking = (viewer::pick_mode == v.mode());
             if (!picking) {
@@ -218,9 +220,16 @@ namespace {
                     transparency = material->transparency();
                 }
                 v.set_color(c, transparency);
+
+                //
+                // Geometry hides what is behind it only if neither the
+                // material nor the texture lets anything show through.
+                //
+                geometry_context.opaque = transparency == 0.0
+                    && texture_components != 2 && texture_components != 4;
             }
 
-            geometry->render_geometry(v, context);
+            geometry->render_geometry(v, geometry_context);
 
             v.end_object();
         }
@@ -26,6 +26,8 @@
 # include <openvrml/node_impl_util.h>
 # include <openvrml/browser.h>
 # include <openvrml/viewer.h>
+# include <openvrml/scene.h>
+# include <openvrml/tessellation_service.h>
 # ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
 #   include <ft2build.h>
 #   include FT_FREETYPE_H
@@ -42,8 +44,11 @@
 #   endif
 # endif
 # include <boost/array.hpp>
+# include <boost/bind.hpp>
 # include <boost/ptr_container/ptr_vector.hpp>
 # include <boost/scope_exit.hpp>
+# include <boost/thread/mutex.hpp>
+# include <list>
 
 # ifdef HAVE_CONFIG_H
 #   include <config.h>
@@ -56,6 +61,8 @@ namespace {
                              wchar_t,
                              openvrml::int32>::type
         char32_t;
+
+    class font_face;
 # endif
 
     class OPENVRML_LOCAL text_node :
@@ -63,6 +70,9 @@ namespace {
         public openvrml::geometry_node {
 
         friend class openvrml_node_vrml97::text_metatype;
+# ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
+        friend class glyph_cache;
+# endif
 
         class string_exposedfield : public exposedfield<openvrml::mfstring> {
         public:
@@ -206,6 +216,9 @@ namespace {
             const std::vector<openvrml::vec2f> & tex_coord() const
                 OPENVRML_NOTHROW;
 
+            void compile(openvrml::compiled_mesh & mesh) const
+                OPENVRML_THROW1(std::bad_alloc);
+
         private:
             void add(const line_geometry & line,
                      const std::string & major_alignment,
@@ -224,14 +237,13 @@ namespace {
                 OPENVRML_THROW1(std::bad_alloc);
         };
 
-        boost::scoped_ptr<text_geometry> text_geometry_;
+        boost::shared_ptr<const text_geometry> text_geometry_;
+        openvrml::async_mesh mesh_;
 
         typedef std::vector<std::vector<char32_t> > ucs4_string_t;
-        typedef std::map<FT_UInt, glyph_geometry> glyph_geometry_map_t;
 
         ucs4_string_t ucs4_string;
-        FT_Face face;
-        glyph_geometry_map_t glyph_geometry_map;
+        boost::shared_ptr<font_face> face;
 # endif
 
     public:
@@ -1714,6 +1726,33 @@ namespace {
         return this->tex_coord_;
     }
 
+    /**
+     * @brief Compile the text geometry into a mesh.
+     *
+     * The text geometry is not modified once constructed; so this may be
+     * called on a tessellation thread.
+     *
+     * @param[out] mesh the compiled mesh.
+     *
+     * @exception std::bad_alloc    if memory allocation fails.
+     */
+    void
+    text_node::text_geometry::compile(openvrml::compiled_mesh & mesh) const
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        using openvrml::int32;
+        openvrml::compiled_mesh(openvrml::viewer::mask_ccw,
+                                this->coord_,
+                                this->coord_index_,
+                                std::vector<openvrml::color>(), // color
+                                std::vector<int32>(), // colorIndex
+                                this->normal_,
+                                std::vector<int32>(), // normalIndex
+                                this->tex_coord_,
+                                std::vector<int32>()) // texCoordIndex
+            .swap(mesh);
+    }
+
     /**
      * @brief Add a line of text.
      *
@@ -1888,14 +1927,6 @@ namespace {
      * @brief A vector of FcChar32 vectors.
      */
 
-    /**
-     * @typedef text_node::glyph_geometry_map_t
-     *
-     * @brief Maps FT_UInts to glyph_geometry.
-     *
-     * @see http://freetype.org/freetype2/docs/reference/ft2-basic_types.html#FT_UInt
-     */
-
     /**
      * @var text_node::ucs4_string_t text_node::ucs4_string
      *
@@ -1903,29 +1934,28 @@ namespace {
      */
 
     /**
-     * @var FT_Face text_node::face
-     *
-     * @brief Handle to the font face.
+     * @var boost::shared_ptr<font_face> text_node::face
      *
-     * @see http://freetype.org/freetype2/docs/reference/ft2-base_interface.html#FT_Face
+     * @brief The font face, shared through the @c glyph_cache.
      */
+# endif // OPENVRML_ENABLE_RENDER_TEXT_NODE
 
     /**
-     * @var text_node::glyph_geometry_map_t text_node::glyph_geometry_map
+     * @var boost::shared_ptr<const text_node::text_geometry> text_node::text_geometry_
      *
-     * @brief Map of glyph indices to glyph_geometry.
+     * @brief The text geometry.
      *
-     * glyph_geometry instances are created as needed as new glyphs are
-     * encountered. Once they are created, they are cached in the
-     * glyph_geometry_map for rapid retrieval the next time the glyph is
-     * encountered.
+     * The geometry is shared with any pending tessellation job.
      */
-# endif // OPENVRML_ENABLE_RENDER_TEXT_NODE
 
     /**
-     * @var text_node::text_geometry text_node::text_geometry_
+     * @var openvrml::async_mesh text_node::mesh_
      *
-     * @brief The text geometry.
+     * @brief The mesh compiled from @a text_geometry_.
+     *
+     * Text with many glyphs is compiled by the browser's
+     * @c tessellation_service; its bounding rectangle is drawn until the
+     * mesh is ready.
      */
 
     /**
@@ -1946,9 +1976,6 @@ namespace {
         length_(*this),
         max_extent_(*this),
         solid_(true)
-# ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-        ,face(0)
-# endif
     {}
 
     /**
@@ -1957,8 +1984,8 @@ namespace {
     text_node::~text_node() OPENVRML_NOTHROW
     {
 # ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-        // shutdown sets this->face to 0.
-        assert(this->face == 0);
+        // shutdown releases this->face.
+        assert(!this->face);
 # endif
     }
 
@@ -1985,18 +2012,26 @@ namespace {
                                        openvrml::rendering_context)
     {
 # ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-        using openvrml::int32;
-        if (this->text_geometry_) {
-            v.insert_shell(*this,
-                           openvrml::viewer::mask_ccw,
-                           this->text_geometry_->coord(),
-                           this->text_geometry_->coord_index(),
-                           std::vector<openvrml::color>(), // color
-                           std::vector<int32>(), // colorIndex
-                           this->text_geometry_->normal(),
-                           std::vector<int32>(), // normalIndex
-                           this->text_geometry_->tex_coord(),
-                           std::vector<int32>()); // texCoordIndex
+        using openvrml::compiled_mesh;
+        //
+        // A mesh compiled in the background replaces the one the viewer has.
+        //
+        if (this->mesh_.update()) { v.remove_object(*this); }
+
+        if (this->text_geometry_
+            && (this->modified() || this->mesh_.revision() == 0)) {
+            this->mesh_.compile(
+                this->scene()->browser().tessellation_service(),
+                boost::bind(&text_geometry::compile,
+                            this->text_geometry_,
+                            _1),
+                this->text_geometry_->coord_index().size(),
+                this->mesh_.mesh()
+                ? compiled_mesh()
+                : make_bounding_box_mesh(this->text_geometry_->coord()));
+        }
+        if (const compiled_mesh * const mesh = this->mesh_.mesh()) {
+            v.insert_mesh(*this, *mesh);
         }
 # endif
         if (this->font_style_.value()) {
@@ -2026,11 +2061,7 @@ namespace {
     void text_node::do_shutdown(double) OPENVRML_NOTHROW
     {
 # ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-        if (this->face) {
-            FT_Error ftError = FT_Done_Face(this->face);
-            assert(ftError == FT_Err_Ok); // Surely this can't fail.
-            this->face = 0;
-        }
+        this->face.reset();
 # endif // OPENVRML_ENABLE_RENDER_TEXT_NODE
     }
 
@@ -2544,6 +2575,482 @@ namespace {
 # endif
     }
 
+    //
+    // A map that remembers the order its entries were last used in.
+    //
+    template <typename Key, typename Value>
+    class OPENVRML_LOCAL lru_map {
+        typedef std::list<Key> order_t;
+        typedef std::map<Key, std::pair<Value, typename order_t::iterator> >
+            map_t;
+
+        order_t order_;
+        map_t map_;
+
+    public:
+        std::size_t size() const
+        {
+            return this->map_.size();
+        }
+
+        Value * find(const Key & key)
+        {
+            const typename map_t::iterator entry = this->map_.find(key);
+            if (entry == this->map_.end()) { return 0; }
+            this->order_.splice(this->order_.begin(),
+                                this->order_,
+                                entry->second.second);
+            return &entry->second.first;
+        }
+
+        void insert(const Key & key, const Value & value)
+        {
+            this->order_.push_front(key);
+            this->map_.insert(
+                std::make_pair(key, std::make_pair(value,
+                                                   this->order_.begin())));
+        }
+
+        //
+        // Remove the least recently used entries that keep does not hold on
+        // to, until at most limit remain.  Returns the number removed.
+        //
+        template <typename Keep>
+        std::size_t evict(const std::size_t limit, Keep keep)
+        {
+            std::size_t evicted = 0;
+            typename order_t::iterator key = this->order_.end();
+            while (this->map_.size() > limit && key != this->order_.begin()) {
+                --key;
+                const typename map_t::iterator entry = this->map_.find(*key);
+                if (keep(entry->second.first)) { continue; }
+                this->map_.erase(entry);
+                key = this->order_.erase(key);
+                ++evicted;
+            }
+            return evicted;
+        }
+
+        void clear()
+        {
+            this->map_.clear();
+            this->order_.clear();
+        }
+    };
+
+    struct OPENVRML_LOCAL keep_none {
+        template <typename Value>
+        bool operator()(const Value &) const
+        {
+            return false;
+        }
+    };
+
+    //
+    // Faces are kept while a Text node uses them.
+    //
+    struct OPENVRML_LOCAL keep_used {
+        bool operator()(const boost::shared_ptr<font_face> & face) const
+        {
+            return !face.unique();
+        }
+    };
+
+
+    class OPENVRML_LOCAL font_face : boost::noncopyable {
+        friend class glyph_cache;
+
+        const FT_Face face_;
+        const std::size_t serial_;
+
+    public:
+        font_face(FT_Face face, std::size_t serial) OPENVRML_NOTHROW;
+        ~font_face() OPENVRML_NOTHROW;
+    };
+
+    /**
+     * @internal
+     *
+     * @class font_face
+     *
+     * @brief A FreeType face owned by the @c glyph_cache.
+     *
+     * Text nodes hold a reference to the face they use.  The face is
+     * closed by the @c glyph_cache, with the FreeType library locked, once
+     * no Text node holds it.
+     */
+
+    /**
+     * @var FT_Face font_face::face_
+     *
+     * @brief Handle to the font face.
+     *
+     * @see http://freetype.org/freetype2/docs/reference/ft2-base_interface.html#FT_Face
+     */
+
+    /**
+     * @var std::size_t font_face::serial_
+     *
+     * @brief Identifies the face among those the @c glyph_cache has opened.
+     *
+     * Glyphs are cached by serial number rather than by address, since a
+     * closed face's address may be reused.
+     */
+
+    /**
+     * @brief Construct.
+     *
+     * @param[in] face      a FreeType face.
+     * @param[in] serial    the serial number.
+     */
+    font_face::font_face(const FT_Face face, const std::size_t serial)
+        OPENVRML_NOTHROW:
+        face_(face),
+        serial_(serial)
+    {}
+
+    /**
+     * @brief Destroy.
+     */
+    font_face::~font_face() OPENVRML_NOTHROW
+    {
+        const FT_Error error = FT_Done_Face(this->face_);
+        assert(error == FT_Err_Ok); // Surely this can't fail.
+    }
+
+
+    class OPENVRML_LOCAL glyph_cache : boost::noncopyable {
+    public:
+        struct statistics {
+            std::size_t lookup_hits;
+            std::size_t lookup_misses;
+            std::size_t face_hits;
+            std::size_t face_misses;
+            std::size_t face_evictions;
+            std::size_t glyph_hits;
+            std::size_t glyph_misses;
+            std::size_t glyph_evictions;
+        };
+
+        static const std::size_t default_max_lookups = 64;
+        static const std::size_t default_max_faces = 16;
+        static const std::size_t default_max_glyphs = 8192;
+
+        static glyph_cache & instance() OPENVRML_THROW1(std::bad_alloc);
+
+        ~glyph_cache() OPENVRML_NOTHROW;
+
+        const boost::shared_ptr<font_face>
+        face(const std::vector<std::string> & family,
+             const std::string & style,
+             const unsigned_char_string & language)
+            OPENVRML_THROW2(std::runtime_error, std::bad_alloc);
+        const boost::shared_ptr<const text_node::glyph_geometry>
+        glyph(const font_face & face, char32_t character, float size)
+            OPENVRML_THROW1(std::bad_alloc);
+
+        bool initialized() const OPENVRML_NOTHROW;
+        void limits(std::size_t lookups, std::size_t faces,
+                    std::size_t glyphs)
+            OPENVRML_NOTHROW;
+        const statistics cache_statistics() const OPENVRML_NOTHROW;
+
+    private:
+        struct font_request {
+            std::vector<std::string> family;
+            std::string style;
+            unsigned_char_string language;
+
+            bool operator<(const font_request & rhs) const
+            {
+                if (this->family != rhs.family) {
+                    return this->family < rhs.family;
+                }
+                if (this->style != rhs.style) {
+                    return this->style < rhs.style;
+                }
+                return this->language < rhs.language;
+            }
+        };
+
+        typedef std::pair<std::string, FT_Long> font_location;
+
+        struct glyph_key {
+            std::size_t face;
+            FT_UInt index;
+            float size;
+
+            bool operator<(const glyph_key & rhs) const
+            {
+                if (this->face != rhs.face) { return this->face < rhs.face; }
+                if (this->index != rhs.index) {
+                    return this->index < rhs.index;
+                }
+                return this->size < rhs.size;
+            }
+        };
+
+        static boost::mutex instance_mutex_;
+        static boost::scoped_ptr<glyph_cache> instance_;
+
+        mutable boost::mutex mutex_;
+        FT_Library library_;
+        std::size_t serial_;
+        lru_map<font_request, font_location> lookups_;
+        lru_map<font_location, boost::shared_ptr<font_face> > faces_;
+        lru_map<glyph_key,
+                boost::shared_ptr<const text_node::glyph_geometry> >
+            glyphs_;
+        std::size_t max_lookups_;
+        std::size_t max_faces_;
+        std::size_t max_glyphs_;
+        statistics statistics_;
+
+        glyph_cache() OPENVRML_THROW1(std::bad_alloc);
+    };
+
+    /**
+     * @internal
+     *
+     * @class glyph_cache
+     *
+     * @brief Process-wide cache of font lookups, font faces, and
+     *        tessellated glyphs, shared by all Text nodes.
+     *
+     * Resolving a FontStyle to a font file with fontconfig, opening the
+     * face, and decomposing and tessellating glyph outlines are each done
+     * once for all the Text nodes that use the same font, rather than
+     * once per node.  Glyphs are cached by face, glyph index, and size;
+     * the family and style select the face.
+     *
+     * Each cache is bounded; when a limit is exceeded, the least recently
+     * used entries are evicted.  Faces that a Text node still uses are not
+     * evicted; glyphs are reference counted, so evicting one does not
+     * affect the nodes whose geometry was built from it.
+     *
+     * The cache owns its FreeType library, and every call into FreeType is
+     * made with the cache locked; so Text nodes may be initialized
+     * concurrently.
+     */
+
+    /**
+     * @internal
+     *
+     * @struct glyph_cache::statistics
+     *
+     * @brief Hit, miss, and eviction counts, since the cache was created.
+     */
+
+    /**
+     * @var boost::mutex glyph_cache::instance_mutex_
+     *
+     * @brief Guards the creation of @a instance_.
+     */
+
+    boost::mutex glyph_cache::instance_mutex_;
+
+    /**
+     * @var boost::scoped_ptr<glyph_cache> glyph_cache::instance_
+     *
+     * @brief The cache.
+     */
+
+    boost::scoped_ptr<glyph_cache> glyph_cache::instance_;
+
+    /**
+     * @brief The cache.
+     *
+     * @return the cache.
+     *
+     * @exception std::bad_alloc    if memory allocation fails.
+     */
+    glyph_cache & glyph_cache::instance() OPENVRML_THROW1(std::bad_alloc)
+    {
+        boost::mutex::scoped_lock lock(glyph_cache::instance_mutex_);
+        if (!glyph_cache::instance_) {
+            glyph_cache::instance_.reset(new glyph_cache);
+        }
+        return *glyph_cache::instance_;
+    }
+
+    /**
+     * @brief Construct.
+     *
+     * @exception std::bad_alloc    if memory allocation fails.
+     */
+    glyph_cache::glyph_cache() OPENVRML_THROW1(std::bad_alloc):
+        library_(0),
+        serial_(0),
+        max_lookups_(default_max_lookups),
+        max_faces_(default_max_faces),
+        max_glyphs_(default_max_glyphs)
+    {
+        const FT_Error error = FT_Init_FreeType(&this->library_);
+        if (error == FT_Err_Out_Of_Memory) { throw std::bad_alloc(); }
+        if (error) { this->library_ = 0; }
+        const statistics none = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        this->statistics_ = none;
+    }
+
+    /**
+     * @brief Destroy.
+     *
+     * The faces are closed before the FreeType library.
+     */
+    glyph_cache::~glyph_cache() OPENVRML_NOTHROW
+    {
+        this->glyphs_.clear();
+        this->faces_.clear();
+        if (this->library_) { FT_Done_FreeType(this->library_); }
+    }
+
+    /**
+     * @brief Get the face for a font.
+     *
+     * @param[in] family    the FontStyle family.
+     * @param[in] style     the FontStyle style.
+     * @param[in] language  the FontStyle language.
+     *
+     * @return the face.
+     *
+     * @exception std::runtime_error    if the font cannot be found or
+     *                                  opened.
+     * @exception std::bad_alloc        if memory allocation fails.
+     */
+    const boost::shared_ptr<font_face>
+    glyph_cache::face(const std::vector<std::string> & family,
+                      const std::string & style,
+                      const unsigned_char_string & language)
+        OPENVRML_THROW2(std::runtime_error, std::bad_alloc)
+    {
+        boost::mutex::scoped_lock lock(this->mutex_);
+        if (!this->library_) { throw FreeTypeError(FT_Err_Ok); }
+
+        font_request request;
+        request.family = family;
+        request.style = style;
+        request.language = language;
+        font_location location;
+        if (const font_location * const found =
+            this->lookups_.find(request)) {
+            ++this->statistics_.lookup_hits;
+            location = *found;
+        } else {
+            ++this->statistics_.lookup_misses;
+            std::vector<char> filename;
+            get_font_filename(family, style, language,
+                              filename, location.second);
+            location.first = &filename[0];
+            this->lookups_.insert(request, location);
+            this->lookups_.evict(this->max_lookups_, keep_none());
+        }
+
+        if (const boost::shared_ptr<font_face> * const found =
+            this->faces_.find(location)) {
+            ++this->statistics_.face_hits;
+            return *found;
+        }
+        ++this->statistics_.face_misses;
+        FT_Face face = 0;
+        const FT_Error error = FT_New_Face(this->library_,
+                                           location.first.c_str(),
+                                           location.second,
+                                           &face);
+        if (error) { throw FreeTypeError(error); }
+        const boost::shared_ptr<font_face>
+            result(new font_face(face, ++this->serial_));
+        this->faces_.insert(location, result);
+        this->statistics_.face_evictions +=
+            this->faces_.evict(this->max_faces_, keep_used());
+        return result;
+    }
+
+    /**
+     * @brief Get the geometry of a character's glyph.
+     *
+     * @param[in] face      a face returned by @c #face.
+     * @param[in] character a UCS-4 character.
+     * @param[in] size      the FontStyle size.
+     *
+     * @return the geometry of the glyph for @p character in @p face.
+     *
+     * @exception std::bad_alloc    if memory allocation fails.
+     */
+    const boost::shared_ptr<const text_node::glyph_geometry>
+    glyph_cache::glyph(const font_face & face,
+                       const char32_t character,
+                       const float size)
+        OPENVRML_THROW1(std::bad_alloc)
+    {
+        boost::mutex::scoped_lock lock(this->mutex_);
+        const glyph_key key = {
+            face.serial_,
+#   ifdef _WIN32
+            FT_Get_Char_Index(face.face_, character),
+#   else
+            FcFreeTypeCharIndex(face.face_, character),
+#   endif
+            size
+        };
+        typedef boost::shared_ptr<const text_node::glyph_geometry>
+            glyph_ptr;
+        if (const glyph_ptr * const found = this->glyphs_.find(key)) {
+            ++this->statistics_.glyph_hits;
+            return *found;
+        }
+        ++this->statistics_.glyph_misses;
+        const glyph_ptr result(
+            new text_node::glyph_geometry(face.face_, key.index, size));
+        this->glyphs_.insert(key, result);
+        this->statistics_.glyph_evictions +=
+            this->glyphs_.evict(this->max_glyphs_, keep_none());
+        return result;
+    }
+
+    /**
+     * @brief Whether the FreeType library was initialized.
+     *
+     * @return @c true if the FreeType library was initialized; @c false
+     *         otherwise.
+     */
+    bool glyph_cache::initialized() const OPENVRML_NOTHROW
+    {
+        return this->library_ != 0;
+    }
+
+    /**
+     * @brief Set the limits on the number of entries cached.
+     *
+     * The limits take effect as entries are added.
+     *
+     * @param[in] lookups   the number of FontStyle lookups.
+     * @param[in] faces     the number of faces; faces in use by Text nodes
+     *                      are kept even if this is exceeded.
+     * @param[in] glyphs    the number of glyphs.
+     */
+    void glyph_cache::limits(const std::size_t lookups,
+                             const std::size_t faces,
+                             const std::size_t glyphs)
+        OPENVRML_NOTHROW
+    {
+        boost::mutex::scoped_lock lock(this->mutex_);
+        this->max_lookups_ = lookups;
+        this->max_faces_ = faces;
+        this->max_glyphs_ = glyphs;
+    }
+
+    /**
+     * @brief Hit, miss, and eviction counts.
+     *
+     * @return hit, miss, and eviction counts since the cache was created.
+     */
+    const glyph_cache::statistics glyph_cache::cache_statistics() const
+        OPENVRML_NOTHROW
+    {
+        boost::mutex::scoped_lock lock(this->mutex_);
+        return this->statistics_;
+    }
+
 # endif // OPENVRML_ENABLE_RENDER_TEXT_NODE
 
     /**
@@ -2556,7 +3063,6 @@ namespace {
 # ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
         using std::string;
         using openvrml::node_cast;
-        using openvrml_node_vrml97::text_metatype;
 
         unsigned_char_string language;
 
@@ -2578,29 +3084,8 @@ namespace {
         }
 
         try {
-            std::vector<char> ftFilename;
-            FT_Long face_index;
-            get_font_filename(family, style, language, ftFilename, face_index);
-
-            text_metatype & nodeClass =
-                const_cast<text_metatype &>(
-                    static_cast<const text_metatype &>(
-                        this->type().metatype()));
-
-            FT_Face newFace = 0;
-            FT_Error ftError = FT_Err_Ok;
-            ftError = FT_New_Face(nodeClass.freeTypeLibrary,
-                                  &ftFilename[0], FT_Long(face_index),
-                                  &newFace);
-            if (ftError) { throw FreeTypeError(ftError); }
-
-            if (this->face) {
-                ftError = FT_Done_Face(this->face);
-                assert(ftError == FT_Err_Ok); // Surely this can't fail.
-            }
-
-            this->face = newFace;
-            this->glyph_geometry_map.clear();
+            this->face =
+                glyph_cache::instance().face(family, style, language);
         } catch (std::runtime_error & ex) {
             OPENVRML_PRINT_EXCEPTION_(ex);
         }
@@ -2635,7 +3120,6 @@ namespace {
 # ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
         using std::auto_ptr;
         using std::max;
-        using std::pair;
         using std::string;
         using std::vector;
         using boost::ptr_vector;
@@ -2668,6 +3152,7 @@ namespace {
             spacing = fontStyle->spacing();
         }
 
+        glyph_cache & glyphs = glyph_cache::instance();
         ptr_vector<line_geometry> lines(this->ucs4_string.size());
         const ucs4_string_t::const_iterator stringBegin =
             this->ucs4_string.begin();
@@ -2691,29 +3176,7 @@ namespace {
             for (vector<char32_t>::const_iterator character = string->begin();
                  character != string->end(); ++character) {
                 assert(this->face);
-                const FT_UInt glyphIndex =
-#   ifdef _WIN32
-                    FT_Get_Char_Index(this->face, *character);
-#   else
-                    FcFreeTypeCharIndex(this->face, *character);
-#   endif
-
-                const glyph_geometry * glyphGeometry = 0;
-                const glyph_geometry_map_t::iterator pos =
-                    this->glyph_geometry_map.find(glyphIndex);
-                if (pos != this->glyph_geometry_map.end()) {
-                    glyphGeometry = &pos->second;
-                } else {
-                    const glyph_geometry_map_t::value_type
-                        value(glyphIndex,
-                              glyph_geometry(this->face, glyphIndex, size));
-                    const pair<glyph_geometry_map_t::iterator, bool> result =
-                        this->glyph_geometry_map.insert(value);
-                    assert(result.second);
-                    glyphGeometry = &result.first->second;
-                }
-                assert(glyphGeometry);
-                line_geom->add(*glyphGeometry);
+                line_geom->add(*glyphs.glyph(*this->face, *character, size));
             }
 
             //
@@ -2746,14 +3209,6 @@ namespace {
 const char * const openvrml_node_vrml97::text_metatype::id =
     "urn:X-openvrml:node:Text";
 
-/**
- * @var FT_Library text_metatype::freeTypeLibrary
- *
- * @brief FreeType library handle.
- *
- * @see http://freetype.org/freetype2/docs/reference/ft2-base_interface.html#FT_Library
- */
-
 /**
  * @brief Construct.
  *
@@ -2771,9 +3226,7 @@ text_metatype(openvrml::browser & browser):
     }
 #   endif
 
-    FT_Error ft_error = 0;
-    ft_error = FT_Init_FreeType(&this->freeTypeLibrary);
-    if (ft_error) {
+    if (!glyph_cache::instance().initialized()) {
         browser.err("error initializing FreeType library");
     }
 # endif // OPENVRML_ENABLE_RENDER_TEXT_NODE
@@ -2783,14 +3236,7 @@ text_metatype(openvrml::browser & browser):
  * @brief Destroy.
  */
 openvrml_node_vrml97::text_metatype::~text_metatype() OPENVRML_NOTHROW
-{
-# ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-    FT_Error ft_error = FT_Done_FreeType(this->freeTypeLibrary);
-    if (ft_error) {
-        this->browser().err("error shutting down FreeType library");
-    }
-# endif // OPENVRML_ENABLE_RENDER_TEXT_NODE
-}
+{}
 
 # define TEXT_INTERFACE_SEQ                              \
     ((exposedfield, mfstring, "string", string_))        \
@@ -27,10 +27,6 @@
 #   ifdef HAVE_CONFIG_H
 #     include <config.h>
 #   endif
-#   ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-#     include <ft2build.h>
-#     include FT_FREETYPE_H
-#   endif
 
 namespace openvrml_node_vrml97 {
 
@@ -41,10 +37,6 @@ namespace openvrml_node_vrml97 {
     public:
         static const char * const id;
 
-# ifdef OPENVRML_ENABLE_RENDER_TEXT_NODE
-        FT_Library freeTypeLibrary;
-# endif
-
         explicit text_metatype(openvrml::browser & browser);
         virtual ~text_metatype() OPENVRML_NOTHROW;
 
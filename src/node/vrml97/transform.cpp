@@ -648,24 +648,8 @@ namespace {
                                          openvrml::rendering_context context)
     {
         using openvrml::bounding_volume;
-        if (context.cull_flag != bounding_volume::inside) {
-            using boost::polymorphic_downcast;
-            using openvrml::bounding_sphere;
-            const bounding_sphere & bs =
-                *polymorphic_downcast<const bounding_sphere *>(
-                    &this->bounding_volume());
-            bounding_sphere bv_copy(bs);
-            bv_copy.transform(context.matrix());
-            bounding_volume::intersection r =
-                viewer.intersect_view_volume(bv_copy);
-            if (context.draw_bounding_spheres) {
-                viewer.draw_bounding_sphere(bs, r);
-            }
-
-            if (r == bounding_volume::outside) { return; }
-            if (r == bounding_volume::inside) {
-                context.cull_flag = bounding_volume::inside;
-            }
+        if (context.cull(viewer, *this) == bounding_volume::outside) {
+            return;
         }
 
         openvrml::mat4f new_LM = this->transform_ * context.matrix();
@@ -0,0 +1,270 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE avatar_collision
+
+# include <iostream>
+# include <sstream>
+# include <boost/test/unit_test.hpp>
+# include <openvrml/browser.h>
+# include <openvrml/scene.h>
+# include <openvrml/viewer.h>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    //
+    // A viewer that draws nothing.
+    //
+    class null_viewer : public viewer {
+    private:
+        virtual rendering_mode do_mode() { return draw_mode; }
+        virtual double do_frame_rate() { return 0.0; }
+        virtual void do_reset_user_navigation() {}
+        virtual void do_begin_object(const char *, bool) {}
+        virtual void do_end_object() {}
+        virtual void do_insert_background(const background_node &) {}
+
+        virtual void do_insert_box(const geometry_node &, const vec3f &) {}
+
+        virtual void do_insert_cone(const geometry_node &,
+                                    float, float, bool, bool)
+        {}
+        virtual void do_insert_cylinder(const geometry_node &,
+                                        float, float, bool, bool, bool)
+        {}
+        virtual void do_insert_elevation_grid(const geometry_node &,
+                                              unsigned int,
+                                              const std::vector<float> &,
+                                              int32, int32, float, float,
+                                              const std::vector<color> &,
+                                              const std::vector<vec3f> &,
+                                              const std::vector<vec2f> &)
+        {}
+        virtual void do_insert_extrusion(const geometry_node &,
+                                         unsigned int,
+                                         const std::vector<vec3f> &,
+                                         const std::vector<vec2f> &,
+                                         const std::vector<rotation> &,
+                                         const std::vector<vec2f> &)
+        {}
+        virtual void do_insert_line_set(const geometry_node &,
+                                        const std::vector<vec3f> &,
+                                        const std::vector<int32> &,
+                                        bool,
+                                        const std::vector<color> &,
+                                        const std::vector<int32> &)
+        {}
+        virtual void do_insert_point_set(const geometry_node &,
+                                         const std::vector<vec3f> &,
+                                         const std::vector<color> &)
+        {}
+        virtual void do_insert_shell(const geometry_node &,
+                                     unsigned int,
+                                     const std::vector<vec3f> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<color> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<vec3f> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<vec2f> &,
+                                     const std::vector<int32> &)
+        {}
+        virtual void do_insert_sphere(const geometry_node &, float) {}
+        virtual void do_insert_dir_light(float, float, const color &,
+                                         const vec3f &)
+        {}
+        virtual void do_insert_point_light(float, const vec3f &,
+                                           const color &, float,
+                                           const vec3f &, float)
+        {}
+        virtual void do_insert_spot_light(float, const vec3f &, float,
+                                          const color &, float,
+                                          const vec3f &, float,
+                                          const vec3f &, float)
+        {}
+        virtual void do_remove_object(const node &) {}
+        virtual void do_enable_lighting(bool) {}
+        virtual void do_set_fog(const color &, float, const char *) {}
+        virtual void do_set_color(const color &, float) {}
+        virtual void do_set_material(float, const color &, const color &,
+                                     float, const color &, float)
+        {}
+        virtual void do_set_material_mode(size_t, bool) {}
+        virtual void do_set_sensitive(node *) {}
+        virtual void do_insert_texture(const texture_node &, bool) {}
+        virtual void do_remove_texture_object(const texture_node &) {}
+        virtual void do_set_texture_transform(const vec2f &, float,
+                                              const vec2f &, const vec2f &)
+        {}
+
+        virtual void do_set_frustum(const float field_of_view,
+                                    const float avatar_size,
+                                    const float visibility_limit)
+        {
+            this->frustum(
+                openvrml::frustum(field_of_view * 180.0f / 3.14159265f,
+                                  1.0f,
+                                  avatar_size > 0.0f ? avatar_size / 2 : 0.01,
+                                  visibility_limit > 0.0f
+                                  ? visibility_limit
+                                  : 30000.0));
+        }
+
+        virtual void do_set_viewpoint(const vec3f &, const rotation &,
+                                      float, float)
+        {}
+        virtual void do_transform(const mat4f &) {}
+        virtual void do_transform_points(size_t, vec3f *) const {}
+        virtual void do_draw_bounding_sphere(const bounding_sphere &,
+                                             bounding_volume::intersection)
+        {}
+    };
+
+    //
+    // A wall 0.2 thick in the plane z = 0, filling the view from the
+    // default viewpoint.
+    //
+    const string wall = "Shape { geometry Box { size 10 10 0.2 } }\n";
+
+    struct fixture {
+        test_resource_fetcher fetcher;
+        browser b;
+        null_viewer v;
+
+        fixture():
+            b(fetcher, std::cout, std::cerr)
+        {
+            b.viewer(&v);
+        }
+
+        ~fixture()
+        {
+            b.viewer(0);
+        }
+
+        void load(const string & world)
+        {
+            stringstream in("#VRML V2.0 utf8\n" + world);
+            b.replace_world(b.create_vrml_from_stream(in));
+            b.render();
+        }
+
+        const vec3f move(const float x0, const float y0, const float z0,
+                         const float x1, const float y1, const float z1)
+        {
+            return b.move_avatar(make_vec3f(x0, y0, z0),
+                                 make_vec3f(x1, y1, z1));
+        }
+
+        double collide_time() const
+        {
+            const node & collision = *b.root_scene()->nodes().back();
+            return dynamic_cast<const sftime &>(
+                const_cast<node &>(collision)
+                .event_emitter("collideTime").value()).value();
+        }
+    };
+
+    //
+    // The avatar stops avatarSize[0] (0.25 by default) from the wall.
+    //
+    const float stop = 0.1f + 0.25f;
+    const float tolerance = 1.0e-3f;
+}
+
+BOOST_FIXTURE_TEST_CASE(wall_stops_the_avatar, fixture)
+{
+    load("NavigationInfo { type \"FLY\" }\n" + wall);
+    const vec3f p = move(0, 0, 10, 0, 0, -5);
+    BOOST_CHECK_CLOSE(p.z(), stop, 0.1f);
+    BOOST_CHECK_SMALL(p.x(), tolerance);
+    BOOST_CHECK_SMALL(p.y(), tolerance);
+}
+
+BOOST_FIXTURE_TEST_CASE(avatar_slides_along_the_wall, fixture)
+{
+    load("NavigationInfo { type \"FLY\" }\n" + wall);
+    const vec3f p = move(0, 0, 1, 2, 0, -1);
+    BOOST_CHECK_CLOSE(p.x(), 2.0f, 0.1f);
+    BOOST_CHECK_CLOSE(p.z(), stop, 0.1f);
+}
+
+BOOST_FIXTURE_TEST_CASE(examine_does_not_collide, fixture)
+{
+    load("NavigationInfo { type \"EXAMINE\" }\n" + wall);
+    const vec3f p = move(0, 0, 10, 0, 0, -5);
+    BOOST_CHECK_CLOSE(p.z(), -5.0f, tolerance);
+}
+
+BOOST_FIXTURE_TEST_CASE(walking_climbs_steps_and_stops_at_walls, fixture)
+{
+    //
+    // A floor at y = 0; a step 0.5 high; and, to the right, a ledge 1.0
+    // high, taller than avatarSize[2] (0.75 by default).
+    //
+    load("NavigationInfo { type \"WALK\" }\n"
+         "Viewpoint { position 0 1.6 0 }\n"
+         "Transform { translation 0 -0.1 0\n"
+         "  children Shape { geometry Box { size 20 0.2 20 } } }\n"
+         "Transform { translation 0 0.25 -2\n"
+         "  children Shape { geometry Box { size 2 0.5 1 } } }\n"
+         "Transform { translation 3 0.5 -2\n"
+         "  children Shape { geometry Box { size 2 1 1 } } }\n");
+
+    const vec3f up = move(0, 1.6f, 0, 0, 1.6f, -2);
+    BOOST_CHECK_CLOSE(up.y(), 2.1f, 0.1f);
+    BOOST_CHECK_CLOSE(up.z(), -2.0f, 0.1f);
+
+    const vec3f blocked = move(3, 1.6f, 0, 3, 1.6f, -2);
+    BOOST_CHECK_CLOSE(blocked.y(), 1.6f, 0.1f);
+    BOOST_CHECK_GT(blocked.z(), -1.5f);
+}
+
+BOOST_FIXTURE_TEST_CASE(collision_emits_collide_time, fixture)
+{
+    load("NavigationInfo { type \"FLY\" }\n"
+         "Collision { children " + wall + "}\n");
+    BOOST_CHECK_EQUAL(collide_time(), 0.0);
+    move(0, 0, 10, 0, 0, 5);
+    BOOST_CHECK_EQUAL(collide_time(), 0.0);
+    move(0, 0, 10, 0, 0, -5);
+    BOOST_CHECK_GT(collide_time(), 0.0);
+}
+
+BOOST_FIXTURE_TEST_CASE(collide_false_and_proxy, fixture)
+{
+    load("NavigationInfo { type \"FLY\" }\n"
+         "Viewpoint { position 0 0 2 }\n"
+         "Collision { collide FALSE children " + wall + "}\n");
+    BOOST_CHECK_CLOSE(move(0, 0, 2, 0, 0, -5).z(), -5.0f, tolerance);
+
+    //
+    // The proxy, behind the wall, is collided with instead of the wall.
+    //
+    load("NavigationInfo { type \"FLY\" }\n"
+         "Viewpoint { position 0 0 2 }\n"
+         "Collision {\n"
+         "  proxy Transform { translation 0 0 -3 children " + wall + "}\n"
+         "  children " + wall + "}\n");
+    BOOST_CHECK_CLOSE(move(0, 0, 2, 0, 0, -5).z(), -3.0f + stop, 0.1f);
+}
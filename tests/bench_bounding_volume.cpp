@@ -0,0 +1,224 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Compare the batch bounding volume operations with the one-at-a-time
+// loops they replace:
+//
+//   enclose    bounding_sphere::enclose against the previous scalar
+//              extreme point scan followed by an extend per point;
+//   box        axis_aligned_bounding_box::enclose against a scalar
+//              minimum/maximum loop;
+//   transform  bounding_sphere::transform_all against a transform per
+//              sphere;
+//   frustum    bounding_sphere::intersect_frustum_all against an
+//              intersect_frustum per sphere.
+//
+// usage: bench-bounding-volume [points [iterations]]
+//
+
+# include <cmath>
+# include <cstdlib>
+# include <iomanip>
+# include <iostream>
+# include <boost/lexical_cast.hpp>
+# include <openvrml/bounding_volume.h>
+# include <openvrml/browser.h>
+# include <openvrml/frustum.h>
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    const vector<vec3f> points(const size_t n)
+    {
+        vector<vec3f> result;
+        result.reserve(n);
+        unsigned int seed = 12345;
+        for (size_t i = 0; i < n; ++i) {
+            float c[3];
+            for (size_t axis = 0; axis < 3; ++axis) {
+                seed = seed * 1103515245 + 12345;
+                c[axis] = float((seed >> 8) % 20000) / 100.0f - 100.0f;
+            }
+            result.push_back(make_vec3f(c[0], c[1], c[2] - 100.0f));
+        }
+        return result;
+    }
+
+    const vector<bounding_sphere> spheres(const vector<vec3f> & centers)
+    {
+        vector<bounding_sphere> result(centers.size());
+        for (size_t i = 0; i < centers.size(); ++i) {
+            result[i].center(centers[i]);
+            result[i].radius(float(i % 17));
+        }
+        return result;
+    }
+
+    //
+    // The scalar algorithm bounding_sphere::enclose used previously.
+    //
+    const bounding_sphere scalar_enclose(const vector<vec3f> & p)
+    {
+        const vec3f * min_p[3] = { &p[0], &p[0], &p[0] };
+        const vec3f * max_p[3] = { &p[0], &p[0], &p[0] };
+        for (size_t i = 1; i < p.size(); ++i) {
+            for (size_t axis = 0; axis < 3; ++axis) {
+                if (p[i][axis] < (*min_p[axis])[axis]) {
+                    min_p[axis] = &p[i];
+                }
+                if (p[i][axis] > (*max_p[axis])[axis]) {
+                    max_p[axis] = &p[i];
+                }
+            }
+        }
+        size_t widest = 0;
+        float widest_dist = -1.0f;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            const vec3f span = *max_p[axis] - *min_p[axis];
+            if (span.dot(span) > widest_dist) {
+                widest = axis;
+                widest_dist = span.dot(span);
+            }
+        }
+        bounding_sphere result;
+        result.center((*min_p[widest] + *max_p[widest]) / 2.0f);
+        result.radius(float(sqrt(widest_dist)) / 2.0f);
+        for (size_t i = 0; i < p.size(); ++i) { result.extend(p[i]); }
+        return result;
+    }
+
+    void report(const char * const name,
+                const size_t n,
+                const double scalar,
+                const double batch)
+    {
+        cout << setw(10) << name
+             << setw(12) << n
+             << setw(12) << fixed << setprecision(3) << scalar
+             << setw(12) << batch
+             << setw(10) << setprecision(2) << scalar / batch << endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+
+    try {
+        const size_t n =
+            (argc > 1) ? lexical_cast<size_t>(argv[1]) : 4000000;
+        const size_t iterations =
+            (argc > 2) ? lexical_cast<size_t>(argv[2]) : 10;
+
+        const vector<vec3f> p = points(n);
+        float sum = 0.0f;
+
+        cout << iterations << " iterations" << endl
+             << setw(10) << "operation"
+             << setw(12) << "count"
+             << setw(12) << "scalar sec"
+             << setw(12) << "batch sec"
+             << setw(10) << "speedup" << endl;
+
+        double start = browser::current_time();
+        for (size_t i = 0; i < iterations; ++i) {
+            sum += scalar_enclose(p).radius();
+        }
+        double scalar = browser::current_time() - start;
+        start = browser::current_time();
+        for (size_t i = 0; i < iterations; ++i) {
+            bounding_sphere bs;
+            bs.enclose(p);
+            sum += bs.radius();
+        }
+        report("enclose", n, scalar, browser::current_time() - start);
+
+        start = browser::current_time();
+        for (size_t i = 0; i < iterations; ++i) {
+            vec3f lo = p[0], hi = p[0];
+            for (size_t j = 1; j < n; ++j) {
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    if (p[j][axis] < lo[axis]) { lo.vec[axis] = p[j][axis]; }
+                    if (p[j][axis] > hi[axis]) { hi.vec[axis] = p[j][axis]; }
+                }
+            }
+            sum += hi.x() - lo.x();
+        }
+        scalar = browser::current_time() - start;
+        start = browser::current_time();
+        for (size_t i = 0; i < iterations; ++i) {
+            axis_aligned_bounding_box box;
+            box.enclose(p);
+            sum += box.maximum().x() - box.minimum().x();
+        }
+        report("box", n, scalar, browser::current_time() - start);
+
+        const size_t spheres_n = n / 4;
+        const vector<bounding_sphere> s =
+            spheres(vector<vec3f>(p.begin(), p.begin() + spheres_n));
+        const mat4f m =
+            make_rotation_mat4f(make_rotation(make_vec3f(0, 1, 0), 0.3f))
+            * make_scale_mat4f(make_vec3f(1, 2, 1))
+            * make_translation_mat4f(make_vec3f(0, 0, -50));
+
+        vector<bounding_sphere> t;
+        scalar = 0.0;
+        double batch = 0.0;
+        for (size_t i = 0; i < iterations; ++i) {
+            t = s;
+            start = browser::current_time();
+            for (size_t j = 0; j < spheres_n; ++j) { t[j].transform(m); }
+            scalar += browser::current_time() - start;
+            sum += t.back().radius();
+
+            t = s;
+            start = browser::current_time();
+            bounding_sphere::transform_all(m, t);
+            batch += browser::current_time() - start;
+            sum += t.back().radius();
+        }
+        report("transform", spheres_n, scalar, batch);
+
+        const frustum f(45.0f, 1.0f, 0.1, 100.0);
+        vector<bounding_volume::intersection> result(spheres_n);
+        start = browser::current_time();
+        for (size_t i = 0; i < iterations; ++i) {
+            for (size_t j = 0; j < spheres_n; ++j) {
+                result[j] = t[j].intersect_frustum(f);
+            }
+            sum += float(result.back());
+        }
+        scalar = browser::current_time() - start;
+        start = browser::current_time();
+        for (size_t i = 0; i < iterations; ++i) {
+            bounding_sphere::intersect_frustum_all(f, t, result);
+            sum += float(result.back());
+        }
+        report("frustum", spheres_n, scalar,
+               browser::current_time() - start);
+
+        if (sum == 0.0f) { cerr << sum; }
+    } catch (std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
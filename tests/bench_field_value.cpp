@@ -0,0 +1,216 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Compare the memory use and throughput of field_value with those of the
+// previous representation, in which every field_value owned a
+// counted_impl holding a shared_mutex and a shared_ptr to its value.
+//
+// usage: bench-field-value [fields [iterations]]
+//
+
+# include <cstdlib>
+# include <iomanip>
+# include <iostream>
+# include <new>
+# include <boost/lexical_cast.hpp>
+# include <boost/ptr_container/ptr_vector.hpp>
+# include <boost/scoped_ptr.hpp>
+# include <boost/shared_ptr.hpp>
+# include <boost/thread.hpp>
+# include <openvrml/browser.h>
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    //
+    // Heap bytes currently allocated through operator new.
+    //
+    size_t allocated = 0;
+}
+
+void * operator new(const size_t size) throw (std::bad_alloc)
+{
+    size_t * const p = static_cast<size_t *>(malloc(size + sizeof (size_t)));
+    if (!p) { throw std::bad_alloc(); }
+    *p = size;
+    allocated += size;
+    return p + 1;
+}
+
+void operator delete(void * const ptr) throw ()
+{
+    if (!ptr) { return; }
+    size_t * const p = static_cast<size_t *>(ptr) - 1;
+    allocated -= *p;
+    free(p);
+}
+
+namespace {
+
+    //
+    // The previous representation.
+    //
+    template <typename ValueType>
+    class legacy_field {
+        struct counted_impl {
+            mutable boost::shared_mutex mutex;
+            boost::shared_ptr<ValueType> value;
+        };
+
+        boost::scoped_ptr<counted_impl> impl_;
+
+    public:
+        explicit legacy_field(const ValueType & value = ValueType()):
+            impl_(new counted_impl)
+        {
+            this->impl_->value.reset(new ValueType(value));
+        }
+
+        legacy_field(const legacy_field & f):
+            impl_(new counted_impl)
+        {
+            boost::shared_lock<boost::shared_mutex> lock(f.impl_->mutex);
+            this->impl_->value = f.impl_->value;
+        }
+
+        const ValueType & value() const
+        {
+            boost::shared_lock<boost::shared_mutex> lock(this->impl_->mutex);
+            return *this->impl_->value;
+        }
+
+        void value(const ValueType & val)
+        {
+            boost::unique_lock<boost::shared_mutex> lock(this->impl_->mutex);
+            if (!this->impl_->value.unique()) {
+                this->impl_->value.reset(new ValueType(val));
+            } else {
+                *this->impl_->value = val;
+            }
+        }
+    };
+
+    struct sample {
+        size_t bytes;
+        double seconds;
+    };
+
+    template <typename Field>
+    const sample run_sf(const size_t fields, const size_t iterations)
+    {
+        boost::ptr_vector<Field> v;
+        v.reserve(fields);
+        const size_t before = allocated;
+        for (size_t i = 0; i < fields; ++i) {
+            v.push_back(new Field(make_vec3f(float(i), 0.0f, 0.0f)));
+        }
+        sample result;
+        result.bytes = allocated - before;
+
+        const double start = browser::current_time();
+        float sum = 0.0f;
+        for (size_t n = 0; n < iterations; ++n) {
+            for (size_t i = 0; i < fields; ++i) {
+                sum += v[i].value().x();
+                v[i].value(make_vec3f(sum, 0.0f, 0.0f));
+            }
+        }
+        result.seconds = browser::current_time() - start;
+        if (sum < 0.0f) { cerr << sum; }
+        return result;
+    }
+
+    template <typename Field>
+    const sample run_mf(const size_t fields, const size_t iterations)
+    {
+        const vector<vec3f> points(64);
+        boost::ptr_vector<Field> v;
+        v.reserve(fields);
+        const size_t before = allocated;
+        for (size_t i = 0; i < fields; ++i) {
+            v.push_back(new Field(points));
+        }
+        sample result;
+        result.bytes = allocated - before;
+
+        //
+        // Copy (as when an event is sent) and read.
+        //
+        const double start = browser::current_time();
+        size_t total = 0;
+        for (size_t n = 0; n < iterations; ++n) {
+            for (size_t i = 0; i < fields; ++i) {
+                const Field copy(v[i]);
+                total += copy.value().size();
+            }
+        }
+        result.seconds = browser::current_time() - start;
+        if (total == 0) { cerr << total; }
+        return result;
+    }
+
+    void report(const char * const name,
+                const size_t fields,
+                const sample & legacy,
+                const sample & current)
+    {
+        cout << setw(10) << name
+             << setw(14) << double(legacy.bytes) / fields
+             << setw(14) << double(current.bytes) / fields
+             << setw(12) << fixed << setprecision(3) << legacy.seconds
+             << setw(12) << current.seconds
+             << setw(10) << setprecision(2)
+             << legacy.seconds / current.seconds << endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+
+    try {
+        const size_t fields =
+            (argc > 1) ? lexical_cast<size_t>(argv[1]) : 1000000;
+        const size_t iterations =
+            (argc > 2) ? lexical_cast<size_t>(argv[2]) : 10;
+
+        cout << fields << " fields, " << iterations << " iterations" << endl
+             << setw(10) << "field"
+             << setw(14) << "old bytes"
+             << setw(14) << "new bytes"
+             << setw(12) << "old sec"
+             << setw(12) << "new sec"
+             << setw(10) << "speedup" << endl;
+
+        report("sfvec3f", fields,
+               run_sf<legacy_field<vec3f> >(fields, iterations),
+               run_sf<sfvec3f>(fields, iterations));
+
+        const size_t mf_fields = fields / 10;
+        report("mfvec3f", mf_fields,
+               run_mf<legacy_field<vector<vec3f> > >(mf_fields, iterations),
+               run_mf<mfvec3f>(mf_fields, iterations));
+    } catch (std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
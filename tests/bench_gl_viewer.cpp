@@ -0,0 +1,462 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Measure openvrml::gl::viewer frame times off screen.  A synthetic CAD-like
+// world (a number of large IndexedFaceSet meshes) is rendered to an EGL
+// pbuffer:
+//
+//   first   the first frame (geometry is built and uploaded);
+//   steady  subsequent frames with no changes;
+//   edit    frames after a single coordinate of one mesh changes.
+//
+// A second world, a grid of cells of small Shapes in nested Transforms
+// viewed from one corner, measures view volume culling:
+//
+//   cull    frames with no changes, most of the grid outside the view.
+//
+// A third world of small Shapes whose Appearances alternate among a few
+// textures and materials measures state sorting:
+//
+//   state   frames with no changes; the texture and material changes made
+//           and elided are reported.
+//
+// usage: bench-gl-viewer [-t triangles] [-m meshes] [-n frames] [-c cells]
+//                        [-s shapes]
+//
+
+# include <cstdlib>
+# include <cstring>
+# include <iomanip>
+# include <iostream>
+# include <sstream>
+# include <EGL/egl.h>
+# include <EGL/eglext.h>
+# include <boost/lexical_cast.hpp>
+# include <openvrml/gl/viewer.h>
+# include <openvrml/tessellation_service.h>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    class offscreen_viewer : public gl::viewer {
+        virtual void do_post_redraw() {}
+        virtual void do_set_cursor(cursor_style) {}
+        virtual void do_swap_buffers() { glFinish(); }
+        virtual void do_set_timer(double) {}
+    };
+
+    //
+    // Each mesh is a grid of quads, split into triangles, with per-vertex
+    // colors; rows is chosen so that the grid has about the requested
+    // number of triangles.
+    //
+    const string world(const size_t triangles, const size_t meshes)
+    {
+        const size_t columns = 100;
+        const size_t rows = triangles / meshes / (2 * columns) + 1;
+        ostringstream out;
+        out << "#VRML V2.0 utf8\n"
+            << "Viewpoint { position 50 " << rows / 2 << ' '
+            << 4 * (rows + columns) << " }\n"
+            << "DirectionalLight { direction 0 0 -1 }\n";
+        for (size_t m = 0; m < meshes; ++m) {
+            out << "Transform { translation 0 0 " << -float(m) << "\n"
+                << "  children Shape {\n"
+                << "    appearance Appearance { material Material {} }\n"
+                << "    geometry IndexedFaceSet {\n"
+                << "      creaseAngle 0.5\n"
+                << "      coord Coordinate { point [\n";
+            for (size_t j = 0; j <= rows; ++j) {
+                for (size_t i = 0; i <= columns; ++i) {
+                    out << "        " << i << ' ' << j << ' '
+                        << 0.25f * float((i * 7 + j * 3 + m) % 5)
+                        << ",\n";
+                }
+            }
+            out << "      ] }\n"
+                << "      color Color { color [\n";
+            for (size_t j = 0; j <= rows; ++j) {
+                for (size_t i = 0; i <= columns; ++i) {
+                    out << "        " << float(i) / columns << ' '
+                        << float(j) / rows << " 0.5,\n";
+                }
+            }
+            out << "      ] }\n"
+                << "      coordIndex [\n";
+            for (size_t j = 0; j < rows; ++j) {
+                for (size_t i = 0; i < columns; ++i) {
+                    const size_t v = j * (columns + 1) + i;
+                    out << "        " << v << ", " << v + 1 << ", "
+                        << v + columns + 2 << ", -1, "
+                        << v << ", " << v + columns + 2 << ", "
+                        << v + columns + 1 << ", -1,\n";
+                }
+            }
+            out << "      ]\n    }\n  }\n}\n";
+        }
+        return out.str();
+    }
+
+    //
+    // A cells x cells grid of Transforms, each holding a 4 x 4 grid of
+    // Boxes; the viewpoint is at one corner, looking along the diagonal.
+    //
+    const string grid_world(const size_t cells)
+    {
+        ostringstream out;
+        out << "#VRML V2.0 utf8\n"
+            << "Viewpoint { position -4 2 4 "
+            << "orientation 0 1 0 -0.785 fieldOfView 0.5 }\n"
+            << "DirectionalLight { direction 0 -1 -1 }\n"
+            << "DEF CELL Group { children [\n";
+        for (size_t j = 0; j < 4; ++j) {
+            for (size_t i = 0; i < 4; ++i) {
+                out << "  Transform { translation " << 2 * i << " 0 "
+                    << -2 * float(j) << "\n"
+                    << "    children Shape {\n"
+                    << "      appearance Appearance { material Material {} }"
+                    << "\n      geometry Box {}\n    }\n  }\n";
+            }
+        }
+        out << "] }\n";
+        for (size_t j = 0; j < cells; ++j) {
+            out << "Transform { translation 0 0 " << -10 * float(j)
+                << "\n  children [\n";
+            for (size_t i = 0; i < cells; ++i) {
+                if (i == 0 && j == 0) { continue; }
+                out << "    Transform { translation " << 10 * i
+                    << " 0 0 children USE CELL }\n";
+            }
+            out << "  ]\n}\n";
+        }
+        return out.str();
+    }
+
+    //
+    // A row of Spheres, each USEing one of four PixelTextures and one of
+    // three Materials in turn; one Material is transparent.
+    //
+    const string state_world(const size_t shapes)
+    {
+        ostringstream out;
+        out << "#VRML V2.0 utf8\n"
+            << "Viewpoint { position 0 0 " << shapes / 4 + 10 << " }\n"
+            << "DirectionalLight { direction 0 0 -1 }\n"
+            << "Group { children [\n";
+        static const char * const materials[] = {
+            "diffuseColor 1 0 0",
+            "diffuseColor 0 1 0",
+            "diffuseColor 0 0 1 transparency 0.5"
+        };
+        for (size_t i = 0; i < shapes; ++i) {
+            out << "  Transform { translation "
+                << float(i % 20) - 10 << ' ' << float(i / 20 % 20) - 10
+                << ' ' << -float(i / 400) << "\n"
+                << "    children Shape {\n      appearance Appearance {\n";
+            if (i < 4) {
+                out << "        texture DEF T" << i
+                    << " PixelTexture { image 2 2 3 0xFF0000 0x00FF00 "
+                    << "0x0000FF 0x" << hex << (0x111111 * (i + 1)) << dec
+                    << " }\n";
+            } else {
+                out << "        texture USE T" << i % 4 << '\n';
+            }
+            if (i < 3) {
+                out << "        material DEF M" << i << " Material { "
+                    << materials[i] << " }\n";
+            } else {
+                out << "        material USE M" << i % 3 << '\n';
+            }
+            out << "      }\n      geometry Sphere { radius 0.4 }\n"
+                << "    }\n  }\n";
+        }
+        out << "] }\n";
+        return out.str();
+    }
+
+    //
+    // Find the Coordinate node of the first mesh.
+    //
+    const boost::intrusive_ptr<node>
+    first_coordinate(const vector<boost::intrusive_ptr<node> > & nodes)
+    {
+        for (vector<boost::intrusive_ptr<node> >::const_iterator n =
+                 nodes.begin();
+             n != nodes.end();
+             ++n) {
+            if ((*n)->type().id() != "Transform") { continue; }
+            const mfnode children = (*n)->field<mfnode>("children");
+            const sfnode geometry =
+                children.value().front()->field<sfnode>("geometry");
+            return geometry.value()->field<sfnode>("coord").value();
+        }
+        return boost::intrusive_ptr<node>();
+    }
+
+    struct egl_context {
+        EGLDisplay display;
+        EGLSurface surface;
+        EGLContext context;
+
+        egl_context(const EGLint width, const EGLint height):
+            display(EGL_NO_DISPLAY),
+            surface(EGL_NO_SURFACE),
+            context(EGL_NO_CONTEXT)
+        {
+# ifdef EGL_PLATFORM_SURFACELESS_MESA
+            PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+                reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (get_platform_display) {
+                this->display =
+                    get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                         EGL_DEFAULT_DISPLAY, 0);
+            }
+# endif
+            if (this->display == EGL_NO_DISPLAY) {
+                this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            }
+            EGLint major, minor;
+            if (!eglInitialize(this->display, &major, &minor)
+                || !eglBindAPI(EGL_OPENGL_API)) {
+                throw runtime_error("could not initialize EGL");
+            }
+            const EGLint config_attribs[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8,
+                EGL_GREEN_SIZE, 8,
+                EGL_BLUE_SIZE, 8,
+                EGL_DEPTH_SIZE, 24,
+                EGL_NONE
+            };
+            EGLConfig config;
+            EGLint configs = 0;
+            if (!eglChooseConfig(this->display, config_attribs,
+                                 &config, 1, &configs)
+                || configs < 1) {
+                throw runtime_error("no EGL pbuffer configuration");
+            }
+            const EGLint surface_attribs[] = {
+                EGL_WIDTH, width,
+                EGL_HEIGHT, height,
+                EGL_NONE
+            };
+            this->surface = eglCreatePbufferSurface(this->display, config,
+                                                    surface_attribs);
+            this->context = eglCreateContext(this->display, config,
+                                             EGL_NO_CONTEXT, 0);
+            if (this->surface == EGL_NO_SURFACE
+                || this->context == EGL_NO_CONTEXT
+                || !eglMakeCurrent(this->display, this->surface,
+                                   this->surface, this->context)) {
+                throw runtime_error("could not create an EGL context");
+            }
+        }
+
+        ~egl_context()
+        {
+            eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                           EGL_NO_CONTEXT);
+            if (this->context != EGL_NO_CONTEXT) {
+                eglDestroyContext(this->display, this->context);
+            }
+            if (this->surface != EGL_NO_SURFACE) {
+                eglDestroySurface(this->display, this->surface);
+            }
+            eglTerminate(this->display);
+        }
+    };
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+
+    try {
+        size_t triangles = 2000000;
+        size_t meshes = 20;
+        size_t frames = 10;
+        size_t cells = 30;
+        size_t shapes = 1000;
+        for (int arg = 1; arg + 1 < argc; arg += 2) {
+            if (strcmp(argv[arg], "-t") == 0) {
+                triangles = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-m") == 0) {
+                meshes = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-n") == 0) {
+                frames = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-c") == 0) {
+                cells = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-s") == 0) {
+                shapes = lexical_cast<size_t>(argv[arg + 1]);
+            } else {
+                cerr << "usage: " << argv[0]
+                     << " [-t triangles] [-m meshes] [-n frames]"
+                     << " [-c cells] [-s shapes]" << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        if (meshes == 0 || frames == 0) {
+            cerr << argv[0] << ": meshes and frames must be nonzero"
+                 << endl;
+            return EXIT_FAILURE;
+        }
+
+        const size_t width = 512, height = 512;
+        egl_context context(width, height);
+        cout << glGetString(GL_RENDERER) << " | "
+             << glGetString(GL_VERSION) << endl;
+
+        test_resource_fetcher fetcher;
+        browser b(fetcher, cout, cerr);
+        offscreen_viewer v;
+        b.viewer(&v);
+
+        stringstream in(world(triangles, meshes));
+        const vector<boost::intrusive_ptr<node> > nodes =
+            b.create_vrml_from_stream(in);
+        b.replace_world(nodes);
+        const boost::intrusive_ptr<node> coord = first_coordinate(nodes);
+        if (!coord) {
+            throw runtime_error("no Coordinate node in the world");
+        }
+        v.resize(width, height);
+
+        double start = browser::current_time();
+        b.update(start);
+        v.redraw();
+        const double first = browser::current_time() - start;
+
+        //
+        // Meshes over the tessellation_service's threshold are drawn as
+        // bounding boxes until they have been compiled.
+        //
+        b.tessellation_service().wait();
+        b.update(browser::current_time());
+        v.redraw();
+        const double ready = browser::current_time() - start;
+
+        start = browser::current_time();
+        for (size_t n = 0; n < frames; ++n) {
+            b.update(browser::current_time());
+            v.redraw();
+        }
+        const double steady = (browser::current_time() - start) / frames;
+
+        mfvec3f point = coord->field<mfvec3f>("point");
+        field_value_listener<mfvec3f> & set_point =
+            coord->event_listener<mfvec3f>("set_point");
+        start = browser::current_time();
+        for (size_t n = 0; n < frames; ++n) {
+            vector<vec3f> value = point.value();
+            value[value.size() / 2].z(float(n % 2));
+            point.value(value);
+            set_point.process_event(point, browser::current_time());
+            b.update(browser::current_time());
+            v.redraw();
+        }
+        const double edit = (browser::current_time() - start) / frames;
+        b.tessellation_service().wait();
+
+        const tessellation_service::statistics stats =
+            b.tessellation_service().latency_statistics();
+        b.viewer(0);
+
+        double cull = 0.0;
+        if (cells > 0) {
+            browser grid(fetcher, cout, cerr);
+            offscreen_viewer grid_viewer;
+            grid.viewer(&grid_viewer);
+            stringstream grid_in(grid_world(cells));
+            grid.replace_world(grid.create_vrml_from_stream(grid_in));
+            grid_viewer.resize(width, height);
+            grid.update(browser::current_time());
+            grid_viewer.redraw();
+            start = browser::current_time();
+            for (size_t n = 0; n < frames; ++n) {
+                grid.update(browser::current_time());
+                grid_viewer.redraw();
+            }
+            cull = (browser::current_time() - start) / frames;
+            grid.viewer(0);
+        }
+
+        double state = 0.0;
+        gl::viewer::state_statistics state_stats =
+            gl::viewer::state_statistics();
+        if (shapes > 0) {
+            browser sorted(fetcher, cout, cerr);
+            offscreen_viewer sorted_viewer;
+            sorted.viewer(&sorted_viewer);
+            stringstream sorted_in(state_world(shapes));
+            sorted.replace_world(sorted.create_vrml_from_stream(sorted_in));
+            sorted_viewer.resize(width, height);
+            sorted.update(browser::current_time());
+            sorted_viewer.redraw();
+            start = browser::current_time();
+            for (size_t n = 0; n < frames; ++n) {
+                sorted.update(browser::current_time());
+                sorted_viewer.redraw();
+            }
+            state = (browser::current_time() - start) / frames;
+            state_stats = sorted_viewer.frame_state_statistics();
+            sorted.viewer(0);
+        }
+
+        cout << fixed << setprecision(2)
+             << "triangles " << triangles << ", meshes " << meshes << '\n'
+             << "first   " << setw(10) << first * 1000.0 << " ms\n"
+             << "steady  " << setw(10) << steady * 1000.0 << " ms/frame\n"
+             << "edit    " << setw(10) << edit * 1000.0 << " ms/frame\n"
+             << "ready   " << setw(10) << ready * 1000.0 << " ms\n"
+             << "cull    " << setw(10) << cull * 1000.0 << " ms/frame ("
+             << cells * cells * 16 << " shapes)\n"
+             << "state   " << setw(10) << state * 1000.0 << " ms/frame ("
+             << state_stats.draws << " draws, " << state_stats.blended
+             << " blended, " << state_stats.flushes << " flushes)\n"
+             << "  texture changes " << state_stats.texture_changes
+             << ", elided " << state_stats.texture_changes_elided << '\n'
+             << "  material changes " << state_stats.material_changes
+             << ", elided " << state_stats.material_changes_elided << '\n'
+             << "  mode changes " << state_stats.mode_changes
+             << ", elided " << state_stats.mode_changes_elided << '\n'
+             << "tessellation: " << stats.completed << " compiled, "
+             << stats.superseded << " superseded, " << stats.failed
+             << " failed; mean "
+             << (stats.completed
+                 ? stats.total_latency / stats.completed * 1000.0
+                 : 0.0)
+             << " ms, max " << stats.max_latency * 1000.0 << " ms\n"
+             << "latency (ms)";
+        const size_t last = tessellation_service::statistics::buckets - 1;
+        for (size_t i = 0; i <= last; ++i) {
+            cout << ' ' << (i < last ? "<" : ">=")
+                 << (1 << (i < last ? i : i - 1)) << ':'
+                 << stats.histogram[i];
+        }
+        cout << endl;
+    } catch (const std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,128 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Time browser::update for a world of independent TimeSensor/interpolator
+// chains with increasing numbers of update threads.
+//
+// usage: bench-parallel-timers [chains [frames [max-threads]]]
+//
+
+# include <cstdlib>
+# include <iomanip>
+# include <iostream>
+# include <sstream>
+# include <boost/lexical_cast.hpp>
+# include <boost/thread.hpp>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    const size_t interpolator_keys = 512;
+
+    const string chains_world(const size_t chains)
+    {
+        ostringstream out;
+        for (size_t i = 0; i < chains; ++i) {
+            out << "DEF T" << i
+                << " TimeSensor { startTime 1 cycleInterval 10 loop TRUE }\n"
+                << "DEF P" << i << " PositionInterpolator {\n  key [";
+            for (size_t k = 0; k < interpolator_keys; ++k) {
+                out << ' ' << float(k) / (interpolator_keys - 1);
+            }
+            out << " ]\n  keyValue [";
+            for (size_t k = 0; k < interpolator_keys; ++k) {
+                out << ' ' << k << ' ' << i << ' ' << k % 7 << ',';
+            }
+            out << " ]\n}\n"
+                << "DEF O" << i << " OrientationInterpolator {\n  key [";
+            for (size_t k = 0; k < interpolator_keys; ++k) {
+                out << ' ' << float(k) / (interpolator_keys - 1);
+            }
+            out << " ]\n  keyValue [";
+            for (size_t k = 0; k < interpolator_keys; ++k) {
+                out << " 0 1 0 " << 0.01 * k << ',';
+            }
+            out << " ]\n}\n"
+                << "DEF X" << i << " Transform {}\n"
+                << "ROUTE T" << i << ".fraction_changed TO P" << i
+                << ".set_fraction\n"
+                << "ROUTE T" << i << ".fraction_changed TO O" << i
+                << ".set_fraction\n"
+                << "ROUTE P" << i << ".value_changed TO X" << i
+                << ".set_translation\n"
+                << "ROUTE O" << i << ".value_changed TO X" << i
+                << ".set_rotation\n";
+        }
+        return out.str();
+    }
+
+    double run(const string & world,
+               const size_t frames,
+               const size_t threads)
+    {
+        test_resource_fetcher fetcher;
+        browser b(fetcher, cout, cerr);
+        istringstream in(world);
+        b.replace_world(b.create_vrml_from_stream(in));
+        b.update_threads(threads);
+
+        const double start_time = browser::current_time();
+        for (size_t frame = 0; frame < frames; ++frame) {
+            b.update(1.0 + 0.01 * frame);
+        }
+        return browser::current_time() - start_time;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+
+    try {
+        const size_t chains =
+            (argc > 1) ? lexical_cast<size_t>(argv[1]) : 256;
+        const size_t frames =
+            (argc > 2) ? lexical_cast<size_t>(argv[2]) : 200;
+        size_t max_threads =
+            (argc > 3) ? lexical_cast<size_t>(argv[3])
+                       : boost::thread::hardware_concurrency();
+        if (max_threads < 1) { max_threads = 1; }
+
+        const string world = chains_world(chains);
+
+        cout << chains << " chains, " << frames << " frames" << endl
+             << setw(8) << "threads" << setw(12) << "seconds"
+             << setw(10) << "speedup" << endl;
+        double serial = 0.0;
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            const double seconds = run(world, frames, threads);
+            if (threads == 1) { serial = seconds; }
+            cout << setw(8) << threads
+                 << setw(12) << fixed << setprecision(3) << seconds
+                 << setw(10) << setprecision(2) << serial / seconds << endl;
+        }
+    } catch (std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
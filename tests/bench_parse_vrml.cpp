@@ -0,0 +1,187 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Measure VRML97 parse throughput for a synthetic mesh and for any files
+// named on the command line.  Each input is parsed with a
+// position_iterator (which parses MF values element by element) and with
+// plain character pointers (which uses the bulk MF scanner).
+//
+// usage: bench-parse-vrml [-p points] [-n iterations] [file ...]
+//
+
+# include <cstdlib>
+# include <cstring>
+# include <fstream>
+# include <iomanip>
+# include <iostream>
+# include <iterator>
+# include <sstream>
+# include <boost/lexical_cast.hpp>
+# include <openvrml/vrml97_grammar.h>
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    struct bench_error_handler {
+        template <typename ScannerT, typename ErrorT>
+        boost::spirit::classic::error_status<>
+        operator()(const ScannerT & scan, const ErrorT & err) const
+        {
+            using boost::spirit::classic::error_status;
+            if (err.descriptor == rotation_axis_not_normalized) {
+                scan.first = err.where;
+                return error_status<>(error_status<>::accept, 0);
+            }
+            return error_status<>(error_status<>::fail);
+        }
+    };
+
+    const string mesh_world(const size_t points)
+    {
+        ostringstream out;
+        out << "#VRML V2.0 utf8\n"
+            << "Shape {\n  geometry IndexedFaceSet {\n"
+            << "    coord Coordinate { point [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      " << 0.001f * i << ' ' << 0.5f * (i % 97) << ' '
+                << -0.25f * (i % 13) << ",\n";
+        }
+        out << "    ] }\n    normal Normal { vector [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      0 " << (i % 2 ? "1" : "-1") << " 0,\n";
+        }
+        out << "    ] }\n    texCoord TextureCoordinate { point [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      " << float(i % 100) / 100 << ' '
+                << float(i % 37) / 37 << ",\n";
+        }
+        out << "    ] }\n    coordIndex [\n";
+        for (size_t i = 0; i + 2 < points; i += 3) {
+            out << "      " << i << ", " << i + 1 << ", " << i + 2
+                << ", -1,\n";
+        }
+        out << "    ]\n  }\n}\n";
+        return out.str();
+    }
+
+    template <typename IteratorT>
+    bool parse_range(IteratorT first, const IteratorT & last)
+    {
+        vrml97_skip_grammar skip_g;
+        vrml97_grammar<null_vrml97_parse_actions, bench_error_handler> g;
+        return boost::spirit::classic::parse(first, last, g, skip_g).full;
+    }
+
+    bool time_parse(const string & data,
+                    const size_t iterations,
+                    double & element_seconds,
+                    double & bulk_seconds)
+    {
+        using boost::spirit::classic::position_iterator;
+
+        const char * const begin = data.data();
+        const char * const end = begin + data.size();
+        typedef position_iterator<const char *> position_iterator_t;
+
+        double start = browser::current_time();
+        for (size_t n = 0; n < iterations; ++n) {
+            if (!parse_range(position_iterator_t(begin, end),
+                             position_iterator_t())) {
+                return false;
+            }
+        }
+        element_seconds = browser::current_time() - start;
+
+        start = browser::current_time();
+        for (size_t n = 0; n < iterations; ++n) {
+            if (!parse_range(begin, end)) { return false; }
+        }
+        bulk_seconds = browser::current_time() - start;
+        return true;
+    }
+
+    void report(const string & name,
+                const string & data,
+                const size_t iterations)
+    {
+        double element_seconds, bulk_seconds;
+        if (!time_parse(data, iterations, element_seconds, bulk_seconds)) {
+            cerr << name << ": parse failed" << endl;
+            return;
+        }
+        const double mb = double(data.size()) * iterations / (1024 * 1024);
+        cout << setw(24) << name
+             << setw(10) << fixed << setprecision(2)
+             << double(data.size()) / (1024 * 1024)
+             << setw(12) << mb / element_seconds
+             << setw(12) << mb / bulk_seconds
+             << setw(10) << element_seconds / bulk_seconds << endl;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+
+    try {
+        size_t points = 200000;
+        size_t iterations = 3;
+        int arg = 1;
+        for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+            if (strcmp(argv[arg], "-p") == 0) {
+                points = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-n") == 0) {
+                iterations = lexical_cast<size_t>(argv[arg + 1]);
+            } else {
+                break;
+            }
+        }
+
+        cout << iterations << " iterations" << endl
+             << setw(24) << "input"
+             << setw(10) << "MB"
+             << setw(12) << "elem MB/s"
+             << setw(12) << "bulk MB/s"
+             << setw(10) << "speedup" << endl;
+
+        report("mesh-" + lexical_cast<string>(points),
+               mesh_world(points),
+               iterations);
+
+        for (; arg < argc; ++arg) {
+            ifstream file(argv[arg], ios_base::binary);
+            if (!file) {
+                cerr << argv[0] << ": could not open " << argv[arg] << endl;
+                continue;
+            }
+            const string data((istreambuf_iterator<char>(file)),
+                              istreambuf_iterator<char>());
+            string name(argv[arg]);
+            const string::size_type slash = name.find_last_of('/');
+            if (slash != string::npos) { name.erase(0, slash + 1); }
+            report(name, data, iterations);
+        }
+    } catch (std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Measure load time and memory for a synthetic mesh in the X3D classic VRML
+// encoding (.x3dv) and in the compressed binary encoding (.x3db).  Only one
+// encoding is loaded per run so that the peak resident set size reflects
+// that encoding alone; "make bench" runs both.
+//
+// The binary scene uses 16-bit quantized coordinates, normals, and texture
+// coordinates and delta-coded index arrays.
+//
+// usage: bench-parse-x3db [-p points] [-n iterations] x3dv|x3db
+//
+
+# include <cstdlib>
+# include <cstring>
+# include <iomanip>
+# include <iostream>
+# include <sstream>
+# include <sys/resource.h>
+# include <boost/lexical_cast.hpp>
+# include "fast_infoset_writer.h"
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    float coord(const size_t i, const size_t c)
+    {
+        switch (c) {
+        case 0: return 0.001f * i;
+        case 1: return 0.5f * (i % 97);
+        default: return -0.25f * (i % 13);
+        }
+    }
+
+    const string mesh_x3dv(const size_t points)
+    {
+        ostringstream out;
+        out << "#X3D V3.2 utf8\nPROFILE Interchange\n"
+            << "Shape {\n  geometry IndexedFaceSet {\n"
+            << "    coord Coordinate { point [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      " << coord(i, 0) << ' ' << coord(i, 1) << ' '
+                << coord(i, 2) << ",\n";
+        }
+        out << "    ] }\n    normal Normal { vector [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      0 " << (i % 2 ? "1" : "-1") << " 0,\n";
+        }
+        out << "    ] }\n    texCoord TextureCoordinate { point [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      " << float(i % 100) / 100 << ' '
+                << float(i % 37) / 37 << ",\n";
+        }
+        out << "    ] }\n    coordIndex [\n";
+        for (size_t i = 0; i + 2 < points; i += 3) {
+            out << "      " << i << ", " << i + 1 << ", " << i + 2
+                << ", -1,\n";
+        }
+        out << "    ]\n  }\n}\n";
+        return out.str();
+    }
+
+    const string mesh_x3db(const size_t points)
+    {
+        vector<float> point, normal, tex_coord;
+        vector<boost::int32_t> coord_index;
+        point.reserve(3 * points);
+        normal.reserve(3 * points);
+        tex_coord.reserve(2 * points);
+        for (size_t i = 0; i < points; ++i) {
+            for (size_t c = 0; c < 3; ++c) { point.push_back(coord(i, c)); }
+            normal.push_back(0.0f);
+            normal.push_back(i % 2 ? 1.0f : -1.0f);
+            normal.push_back(0.0f);
+            tex_coord.push_back(float(i % 100) / 100);
+            tex_coord.push_back(float(i % 37) / 37);
+        }
+        for (size_t i = 0; i + 2 < points; i += 3) {
+            coord_index.push_back(boost::int32_t(i));
+            coord_index.push_back(boost::int32_t(i + 1));
+            coord_index.push_back(boost::int32_t(i + 2));
+            coord_index.push_back(-1);
+        }
+
+        fast_infoset_writer w;
+        w.start_element("X3D");
+        w.attribute("profile", "Interchange");
+        w.attribute("version", "3.2");
+        w.start_element("Scene");
+        w.start_element("Shape");
+        w.start_element("IndexedFaceSet");
+        w.delta_int_attribute("coordIndex", coord_index);
+        w.start_element("Coordinate");
+        w.quantized_float_attribute("point", point, 3, 16);
+        w.end_element();
+        w.start_element("Normal");
+        w.quantized_float_attribute("vector", normal, 3, 16);
+        w.end_element();
+        w.start_element("TextureCoordinate");
+        w.quantized_float_attribute("point", tex_coord, 2, 16);
+        w.end_element();
+        w.end_element();
+        w.end_element();
+        w.end_element();
+        w.end_element();
+        return w.finish();
+    }
+
+    long max_rss_kb()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+
+    try {
+        size_t points = 200000;
+        size_t iterations = 3;
+        int arg = 1;
+        for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+            if (strcmp(argv[arg], "-p") == 0) {
+                points = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-n") == 0) {
+                iterations = lexical_cast<size_t>(argv[arg + 1]);
+            } else {
+                break;
+            }
+        }
+        if (arg != argc - 1
+            || (strcmp(argv[arg], "x3dv") != 0
+                && strcmp(argv[arg], "x3db") != 0)) {
+            cerr << "usage: " << argv[0]
+                 << " [-p points] [-n iterations] x3dv|x3db" << endl;
+            return EXIT_FAILURE;
+        }
+        const bool binary = strcmp(argv[arg], "x3db") == 0;
+
+        const string data = binary ? mesh_x3db(points) : mesh_x3dv(points);
+        const char * const type = binary
+                                ? x3d_fast_infoset_media_type
+                                : x3d_vrml_media_type;
+
+        test_resource_fetcher fetcher;
+        browser b(fetcher, cout, cerr);
+        const long base_rss = max_rss_kb();
+        const double start = browser::current_time();
+        for (size_t n = 0; n < iterations; ++n) {
+            stringstream in(data);
+            b.create_vrml_from_stream(in, type);
+        }
+        const double seconds =
+            (browser::current_time() - start) / double(iterations);
+
+        cout << setw(6) << argv[arg]
+             << setw(10) << points << " points"
+             << setw(10) << fixed << setprecision(2)
+             << double(data.size()) / (1024 * 1024) << " MB"
+             << setw(10) << setprecision(3) << seconds << " s/load"
+             << setw(10) << (max_rss_kb() - base_rss) / 1024
+             << " MB peak RSS growth" << endl;
+    } catch (std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
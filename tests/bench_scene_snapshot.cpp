@@ -0,0 +1,180 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Measure world load time with and without a scene snapshot.  A synthetic
+// world (a mesh and a number of PROTO instances connected by ROUTEs) is
+// written to a file and loaded with browser::set_world:
+//
+//   parse     without a scene cache directory;
+//   record    with an empty scene cache directory (parse and write the
+//             snapshot);
+//   snapshot  from the snapshot written by the previous load.
+//
+// usage: bench-scene-snapshot [-p points] [-n iterations] wrl|x3dv
+//
+
+# include <cstdlib>
+# include <cstring>
+# include <fstream>
+# include <iomanip>
+# include <iostream>
+# include <sstream>
+# include <boost/filesystem/operations.hpp>
+# include <boost/lexical_cast.hpp>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    const string world(const size_t points, const bool x3d)
+    {
+        ostringstream out;
+        out << (x3d ? "#X3D V3.2 utf8\nPROFILE Interchange\n"
+                    : "#VRML V2.0 utf8\n")
+            << "PROTO Mover [ "
+            << (x3d ? "inputOnly" : "eventIn") << " SFFloat set_fraction\n"
+            << "              "
+            << (x3d ? "outputOnly" : "eventOut") << " SFVec3f value_changed\n"
+            << "              "
+            << (x3d ? "initializeOnly" : "field") << " MFVec3f keyValue [] ]"
+            << " {\n"
+            << "  PositionInterpolator {\n"
+            << "    key [ 0, 1 ] keyValue IS keyValue\n"
+            << "    set_fraction IS set_fraction\n"
+            << "    value_changed IS value_changed\n"
+            << "  }\n}\n"
+            << "DEF T TimeSensor { loop TRUE }\n"
+            << "Shape {\n  geometry IndexedFaceSet {\n"
+            << "    coord Coordinate { point [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      " << 0.001f * i << ' ' << 0.5f * (i % 97) << ' '
+                << -0.25f * (i % 13) << ",\n";
+        }
+        out << "    ] }\n    texCoord TextureCoordinate { point [\n";
+        for (size_t i = 0; i < points; ++i) {
+            out << "      " << float(i % 100) / 100 << ' '
+                << float(i % 37) / 37 << ",\n";
+        }
+        out << "    ] }\n    coordIndex [\n";
+        for (size_t i = 0; i + 2 < points; i += 3) {
+            out << "      " << i << ", " << i + 1 << ", " << i + 2
+                << ", -1,\n";
+        }
+        out << "    ]\n  }\n}\n";
+        for (size_t i = 0; i < points / 100; ++i) {
+            out << "DEF M" << i << " Mover { keyValue [ 0 0 0, " << i
+                << " 0 0 ] }\n"
+                << "DEF X" << i << " Transform { children USE T }\n"
+                << "ROUTE T.fraction_changed TO M" << i << ".set_fraction\n"
+                << "ROUTE M" << i << ".value_changed TO X" << i
+                << ".set_translation\n";
+        }
+        return out.str();
+    }
+
+    double time_load(browser & b, resource_fetcher & fetcher,
+                     const string & uri, const size_t iterations)
+    {
+        const double start = browser::current_time();
+        for (size_t n = 0; n < iterations; ++n) {
+            const std::auto_ptr<resource_istream> in =
+                fetcher.get_resource(uri);
+            b.set_world(*in);
+        }
+        return (browser::current_time() - start) / double(iterations);
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using boost::lexical_cast;
+    namespace fs = boost::filesystem;
+
+    const fs::path cache_dir("bench-scene-cache");
+    string file;
+    try {
+        size_t points = 200000;
+        size_t iterations = 3;
+        int arg = 1;
+        for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+            if (strcmp(argv[arg], "-p") == 0) {
+                points = lexical_cast<size_t>(argv[arg + 1]);
+            } else if (strcmp(argv[arg], "-n") == 0) {
+                iterations = lexical_cast<size_t>(argv[arg + 1]);
+            } else {
+                break;
+            }
+        }
+        if (arg != argc - 1
+            || (strcmp(argv[arg], "wrl") != 0
+                && strcmp(argv[arg], "x3dv") != 0)) {
+            cerr << "usage: " << argv[0]
+                 << " [-p points] [-n iterations] wrl|x3dv" << endl;
+            return EXIT_FAILURE;
+        }
+        const bool x3d = strcmp(argv[arg], "x3dv") == 0;
+
+        file = string("bench-scene-snapshot.") + argv[arg];
+        const string data = world(points, x3d);
+        {
+            ofstream out(file.c_str());
+            out << data;
+        }
+        const string uri = "file://" + (fs::current_path() / file).string();
+
+        test_resource_fetcher fetcher;
+        browser b(fetcher, cout, cerr);
+        const double parse = time_load(b, fetcher, uri, iterations);
+
+        fs::remove_all(cache_dir);
+        b.scene_cache_directory(cache_dir.string());
+        const double record = time_load(b, fetcher, uri, 1);
+        const double snapshot = time_load(b, fetcher, uri, iterations);
+
+        boost::uintmax_t snapshot_size = 0;
+        for (fs::directory_iterator entry(cache_dir);
+             entry != fs::directory_iterator();
+             ++entry) {
+            snapshot_size += fs::file_size(entry->path());
+        }
+
+        cout << setw(6) << argv[arg]
+             << setw(10) << points << " points"
+             << setw(8) << fixed << setprecision(2)
+             << double(data.size()) / (1024 * 1024) << " MB"
+             << setw(8) << double(snapshot_size) / (1024 * 1024)
+             << " MB snapshot" << endl
+             << setw(14) << "parse" << setw(10) << setprecision(3)
+             << parse << " s/load" << endl
+             << setw(14) << "record" << setw(10) << record << " s/load"
+             << endl
+             << setw(14) << "snapshot" << setw(10) << snapshot << " s/load"
+             << endl;
+    } catch (std::exception & ex) {
+        cerr << argv[0] << ": " << ex.what() << endl;
+        fs::remove_all(cache_dir);
+        if (!file.empty()) { fs::remove(file); }
+        return EXIT_FAILURE;
+    }
+    fs::remove_all(cache_dir);
+    fs::remove(file);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE bounding_volume
+
+# include <boost/test/unit_test.hpp>
+# include <openvrml/bounding_volume.h>
+# include <openvrml/frustum.h>
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    //
+    // A deterministic spread of points; n is not a multiple of four so
+    // that the batch code's remainder is exercised.
+    //
+    const vector<vec3f> points(const size_t n = 1003)
+    {
+        vector<vec3f> result;
+        unsigned int seed = 12345;
+        for (size_t i = 0; i < n; ++i) {
+            float c[3];
+            for (size_t axis = 0; axis < 3; ++axis) {
+                seed = seed * 1103515245 + 12345;
+                c[axis] = float((seed >> 8) % 20000) / 100.0f - 100.0f;
+            }
+            result.push_back(make_vec3f(c[0], c[1] + 50.0f, c[2]));
+        }
+        return result;
+    }
+
+    const vector<bounding_sphere> spheres()
+    {
+        const vector<vec3f> centers = points(203);
+        vector<bounding_sphere> result;
+        for (size_t i = 0; i < centers.size(); ++i) {
+            bounding_sphere bs;
+            bs.center(centers[i]);
+            bs.radius(float(i % 17));
+            result.push_back(bs);
+        }
+        result[5] = bounding_sphere();
+        result[6].maximize();
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sphere_enclose_contains_points)
+{
+    const vector<vec3f> p = points();
+    bounding_sphere bs;
+    bs.enclose(p);
+    for (size_t i = 0; i < p.size(); ++i) {
+        BOOST_CHECK_LE((p[i] - bs.center()).length(),
+                       bs.radius() * 1.0001f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sphere_enclose_single_point)
+{
+    bounding_sphere bs;
+    bs.enclose(vector<vec3f>(7, make_vec3f(1, 2, 3)));
+    BOOST_CHECK_EQUAL(bs.center(), make_vec3f(1, 2, 3));
+    BOOST_CHECK_EQUAL(bs.radius(), 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(box_enclose)
+{
+    const vector<vec3f> p = points();
+    axis_aligned_bounding_box box;
+    box.enclose(p);
+    vec3f lo = p[0], hi = p[0];
+    for (size_t i = 1; i < p.size(); ++i) {
+        for (size_t axis = 0; axis < 3; ++axis) {
+            lo.vec[axis] = std::min(lo[axis], p[i][axis]);
+            hi.vec[axis] = std::max(hi[axis], p[i][axis]);
+        }
+    }
+    BOOST_CHECK_EQUAL(box.minimum(), lo);
+    BOOST_CHECK_EQUAL(box.maximum(), hi);
+}
+
+BOOST_AUTO_TEST_CASE(box_transform_encloses_corners)
+{
+    axis_aligned_bounding_box box;
+    box.extend(make_vec3f(-1, -2, -3));
+    box.extend(make_vec3f(1, 2, 3));
+    const mat4f m =
+        make_rotation_mat4f(make_rotation(make_vec3f(0, 1, 0), 0.5f))
+        * make_translation_mat4f(make_vec3f(10, 0, 0));
+    axis_aligned_bounding_box transformed = box;
+    transformed.transform(m);
+    for (int i = 0; i < 8; ++i) {
+        const vec3f corner = make_vec3f((i & 1) ? 1.0f : -1.0f,
+                                        (i & 2) ? 2.0f : -2.0f,
+                                        (i & 4) ? 3.0f : -3.0f) * m;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            BOOST_CHECK_LE(transformed.minimum()[axis], corner[axis] + 1e-4f);
+            BOOST_CHECK_GE(transformed.maximum()[axis], corner[axis] - 1e-4f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(box_intersect_frustum)
+{
+    const frustum f(45.0f, 1.0f, 0.1, 100.0);
+    axis_aligned_bounding_box box;
+    box.extend(make_vec3f(-1, -1, -11));
+    box.extend(make_vec3f(1, 1, -9));
+    BOOST_CHECK_EQUAL(box.intersect_frustum(f), bounding_volume::inside);
+    box.extend(make_vec3f(0, 0, 1));
+    BOOST_CHECK_EQUAL(box.intersect_frustum(f), bounding_volume::partial);
+
+    axis_aligned_bounding_box behind;
+    behind.extend(make_vec3f(-1, -1, 1));
+    behind.extend(make_vec3f(1, 1, 3));
+    BOOST_CHECK_EQUAL(behind.intersect_frustum(f), bounding_volume::outside);
+}
+
+BOOST_AUTO_TEST_CASE(sphere_transform_all)
+{
+    const mat4f m =
+        make_rotation_mat4f(make_rotation(make_vec3f(1, 0, 0), 0.3f))
+        * make_scale_mat4f(make_vec3f(1, 2, 3))
+        * make_translation_mat4f(make_vec3f(1, -2, 3));
+    vector<bounding_sphere> batch = spheres();
+    bounding_sphere::transform_all(m, batch);
+    const vector<bounding_sphere> expected = spheres();
+    for (size_t i = 0; i < expected.size(); ++i) {
+        bounding_sphere bs = expected[i];
+        bs.transform(m);
+        BOOST_CHECK_EQUAL(batch[i].center(), bs.center());
+        BOOST_CHECK_EQUAL(batch[i].radius(), bs.radius());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sphere_intersect_frustum_all)
+{
+    const frustum f(45.0f, 1.0f, 0.1, 100.0);
+    const mat4f view = make_translation_mat4f(make_vec3f(0, -50, -20));
+    vector<bounding_sphere> s = spheres();
+    bounding_sphere::transform_all(view, s);
+    vector<bounding_volume::intersection> result;
+    bounding_sphere::intersect_frustum_all(f, s, result);
+    BOOST_REQUIRE_EQUAL(result.size(), s.size());
+    size_t counts[3] = { 0, 0, 0 };
+    for (size_t i = 0; i < s.size(); ++i) {
+        BOOST_CHECK_EQUAL(result[i], s[i].intersect_frustum(f));
+        ++counts[result[i] + 1];
+    }
+    BOOST_CHECK(counts[0] > 0);
+    BOOST_CHECK(counts[1] > 0);
+    BOOST_CHECK(counts[2] > 0);
+}
@@ -26,6 +26,7 @@
 # include <boost/scope_exit.hpp>
 # include <boost/thread.hpp>
 # include <boost/test/unit_test.hpp>
+# include <openvrml/scene.h>
 # include "test_resource_fetcher.h"
 
 using namespace std;
@@ -47,6 +48,26 @@ BOOST_AUTO_TEST_CASE(create_vrml_from_stream)
     BOOST_CHECK_EQUAL(nodes[0]->type().id(), "Group");
 }
 
+BOOST_AUTO_TEST_CASE(create_vrml_from_stream_x3dv)
+{
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+
+    const char x3dvstring[] =
+        "#X3D V3.0 utf8\n"
+        "PROFILE Core\n"
+        "COMPONENT Grouping:1\n"
+        "Group {}";
+    stringstream x3dvstream(x3dvstring);
+
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(x3dvstream, x3d_vrml_media_type);
+
+    BOOST_REQUIRE(nodes.size() == 1);
+    BOOST_REQUIRE(nodes[0] != boost::intrusive_ptr<node>(0));
+    BOOST_CHECK_EQUAL(nodes[0]->type().id(), "Group");
+}
+
 BOOST_AUTO_TEST_CASE(create_vrml_from_stream_with_externproto)
 {
     {
@@ -72,6 +93,63 @@ BOOST_AUTO_TEST_CASE(create_vrml_from_stream_with_externproto)
     BOOST_CHECK_EQUAL(nodes[0]->type().id(), "Node");
 }
 
+BOOST_AUTO_TEST_CASE(create_vrml_from_stream_error_position)
+{
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+
+    const char vrmlstring[] = "Group {\r\n\t#\r\n\t\tbogus 1\r\n}";
+    stringstream vrmlstream(vrmlstring);
+
+    try {
+        b.create_vrml_from_stream(vrmlstream);
+        BOOST_ERROR("expected invalid_vrml");
+    } catch (invalid_vrml & ex) {
+        BOOST_CHECK_EQUAL(ex.line, 3U);
+        BOOST_CHECK_EQUAL(ex.column, 9U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(create_vrml_from_stream_mf_numeric_values)
+{
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+
+    const char vrmlstring[] =
+        "Coordinate { point [ 1 2 3, 4.5 -6e2 .25 # 10 11 12 ]\n"
+        "                     7,8,9 ] }\n"
+        "IndexedFaceSet { coordIndex [ 0, 0x1 2 -1 ] }\n"
+        "ScalarInterpolator { key [ 0 0.5 1 ] keyValue [] }\n"
+        "TextureCoordinate { point [ 0 1, 1 0 ] }";
+    stringstream vrmlstream(vrmlstring);
+
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(vrmlstream);
+    BOOST_REQUIRE(nodes.size() == 4);
+
+    const vector<vec3f> point = nodes[0]->field<mfvec3f>("point").value();
+    BOOST_REQUIRE_EQUAL(point.size(), 3U);
+    BOOST_CHECK(point[0] == make_vec3f(1, 2, 3));
+    BOOST_CHECK(point[1] == make_vec3f(4.5, -600, 0.25));
+    BOOST_CHECK(point[2] == make_vec3f(7, 8, 9));
+
+    const vector<int32> coord_index =
+        nodes[1]->field<mfint32>("coordIndex").value();
+    BOOST_REQUIRE_EQUAL(coord_index.size(), 4U);
+    BOOST_CHECK_EQUAL(coord_index[1], 1);
+    BOOST_CHECK_EQUAL(coord_index[3], -1);
+
+    const vector<float> key = nodes[2]->field<mffloat>("key").value();
+    BOOST_REQUIRE_EQUAL(key.size(), 3U);
+    BOOST_CHECK_EQUAL(key[1], 0.5f);
+    BOOST_CHECK(nodes[2]->field<mffloat>("keyValue").value().empty());
+
+    const vector<vec2f> tex_point =
+        nodes[3]->field<mfvec2f>("point").value();
+    BOOST_REQUIRE_EQUAL(tex_point.size(), 2U);
+    BOOST_CHECK(tex_point[1] == make_vec2f(1, 0));
+}
+
 BOOST_AUTO_TEST_CASE(create_vrml_from_url)
 {
     class children_listener : public openvrml::mfnode_listener {
@@ -146,3 +224,408 @@ BOOST_AUTO_TEST_CASE(create_vrml_from_url)
     BOOST_REQUIRE(children.size() == 1);
     BOOST_CHECK_EQUAL(children[0]->type().id(), "Shape");
 }
+
+BOOST_AUTO_TEST_CASE(event_emitter_add_remove_listener)
+{
+    class counting_listener : public openvrml::mfnode_listener {
+        size_t events_;
+
+    public:
+        counting_listener():
+            events_(0)
+        {}
+
+        size_t events() const
+        {
+            return this->events_;
+        }
+
+    private:
+        virtual void do_process_event(const openvrml::mfnode &, double)
+            throw (std::bad_alloc)
+        {
+            ++this->events_;
+        }
+    };
+
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    const char vrmlstring[] = "Group {}";
+    stringstream vrmlstream(vrmlstring);
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(vrmlstream);
+    BOOST_REQUIRE(nodes.size() == 1);
+
+    counting_listener first, second;
+    mfnode_emitter & emitter =
+        nodes[0]->event_emitter<mfnode>("children_changed");
+    BOOST_CHECK(emitter.add(first));
+    BOOST_CHECK(!emitter.add(first));
+    BOOST_CHECK(emitter.add(second));
+    BOOST_CHECK_EQUAL(emitter.listeners().size(), 2U);
+
+    mfnode_listener & set_children =
+        nodes[0]->event_listener<mfnode>("set_children");
+    set_children.process_event(mfnode(), 1.0);
+    BOOST_CHECK_EQUAL(first.events(), 1U);
+    BOOST_CHECK_EQUAL(second.events(), 1U);
+    BOOST_CHECK_EQUAL(emitter.last_time(), 1.0);
+
+    BOOST_CHECK(emitter.remove(first));
+    BOOST_CHECK(!emitter.remove(first));
+    set_children.process_event(mfnode(), 2.0);
+    BOOST_CHECK_EQUAL(first.events(), 1U);
+    BOOST_CHECK_EQUAL(second.events(), 2U);
+
+    BOOST_CHECK(emitter.remove(second));
+    BOOST_CHECK(emitter.listeners().empty());
+    set_children.process_event(mfnode(), 3.0);
+    BOOST_CHECK_EQUAL(second.events(), 2U);
+    BOOST_CHECK_EQUAL(emitter.last_time(), 3.0);
+}
+
+namespace {
+
+    const char fan_in_world[] =
+        "DEF T TimeSensor { startTime 1 cycleInterval 10 loop TRUE }\n"
+        "DEF P1 PositionInterpolator { key [ 0, 1 ] keyValue [ 0 0 0, 1 1 1 ] }\n"
+        "DEF P2 PositionInterpolator { key [ 0, 1 ] keyValue [ 0 0 0, 2 2 2 ] }\n"
+        "DEF X Transform {}\n"
+        "ROUTE T.fraction_changed TO P1.set_fraction\n"
+        "ROUTE T.fraction_changed TO P2.set_fraction\n"
+        "ROUTE P1.value_changed TO X.set_translation\n"
+        "ROUTE P2.value_changed TO X.set_translation\n";
+
+    class translation_listener : public openvrml::sfvec3f_listener {
+        size_t events_;
+        openvrml::vec3f last_;
+
+    public:
+        translation_listener():
+            events_(0)
+        {}
+
+        size_t events() const
+        {
+            return this->events_;
+        }
+
+        const openvrml::vec3f & last() const
+        {
+            return this->last_;
+        }
+
+    private:
+        virtual void do_process_event(const openvrml::sfvec3f & value, double)
+            throw (std::bad_alloc)
+        {
+            ++this->events_;
+            this->last_ = value.value();
+        }
+    };
+}
+
+BOOST_AUTO_TEST_CASE(immediate_event_cascade)
+{
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    stringstream vrmlstream(fan_in_world);
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(vrmlstream);
+    BOOST_REQUIRE(nodes.size() == 4);
+    b.replace_world(nodes);
+    BOOST_CHECK(!b.queued_event_cascade());
+
+    translation_listener listener;
+    nodes[3]->event_emitter<sfvec3f>("translation_changed").add(listener);
+
+    b.update(1.0);
+    b.update(6.0);
+    BOOST_CHECK_EQUAL(listener.events(), 4U);
+    BOOST_CHECK_CLOSE(listener.last().x(), 1.0f, 0.0001f);
+    BOOST_CHECK_EQUAL(b.frame_event_statistics().delivered, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(queued_event_cascade)
+{
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    stringstream vrmlstream(fan_in_world);
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(vrmlstream);
+    BOOST_REQUIRE(nodes.size() == 4);
+    b.replace_world(nodes);
+    b.queued_event_cascade(true);
+    BOOST_CHECK(b.queued_event_cascade());
+
+    translation_listener listener;
+    nodes[3]->event_emitter<sfvec3f>("translation_changed").add(listener);
+
+    b.update(1.0);
+    b.update(6.0);
+    BOOST_CHECK_EQUAL(listener.events(), 2U);
+    BOOST_CHECK_CLOSE(listener.last().x(), 1.0f, 0.0001f);
+
+    const browser::event_statistics stats = b.frame_event_statistics();
+    BOOST_CHECK(stats.enqueued > 0);
+    BOOST_CHECK(stats.coalesced > 0);
+    BOOST_CHECK(stats.delivered > 0);
+
+    b.queued_event_cascade(false);
+    BOOST_CHECK(!b.queued_event_cascade());
+}
+
+namespace {
+
+    const string independent_chains_world(const size_t chains)
+    {
+        ostringstream out;
+        for (size_t i = 0; i < chains; ++i) {
+            out << "DEF T" << i
+                << " TimeSensor { startTime 1 cycleInterval 10 loop TRUE }\n"
+                << "DEF P" << i
+                << " PositionInterpolator { key [ 0, 1 ] keyValue [ 0 0 0, "
+                << i << ' ' << i << ' ' << i << " ] }\n"
+                << "DEF X" << i << " Transform {}\n"
+                << "ROUTE T" << i << ".fraction_changed TO P" << i
+                << ".set_fraction\n"
+                << "ROUTE P" << i << ".value_changed TO X" << i
+                << ".set_translation\n";
+        }
+        return out.str();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_timer_update)
+{
+    const size_t chains = 8;
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    stringstream vrmlstream(independent_chains_world(chains));
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(vrmlstream);
+    BOOST_REQUIRE(nodes.size() == 3 * chains);
+    b.replace_world(nodes);
+    BOOST_CHECK_EQUAL(b.update_threads(), 1U);
+    b.update_threads(4);
+    BOOST_CHECK_EQUAL(b.update_threads(), 4U);
+
+    b.update(1.0);
+    b.update(6.0);
+    for (size_t i = 0; i < chains; ++i) {
+        transform_node * const transform =
+            node_cast<transform_node *>(nodes[3 * i + 2].get());
+        BOOST_REQUIRE(transform);
+        BOOST_CHECK_CLOSE(transform->transform()[3][0] + 1.0f,
+                          0.5f * i + 1.0f,
+                          0.0001f);
+    }
+
+    b.update_threads(1);
+    BOOST_CHECK_EQUAL(b.update_threads(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(inline_scenes_committed_by_update)
+{
+    {
+        ofstream file("inline-a.wrl");
+        file << "#VRML V2.0 utf8" << endl
+             << "Group {}" << endl
+             << "Inline { url \"inline-b.wrl\" }" << endl;
+    }
+    {
+        ofstream file("inline-b.wrl");
+        file << "#VRML V2.0 utf8" << endl
+             << "Group {}" << endl;
+    }
+    BOOST_SCOPE_EXIT() {
+        remove(boost::filesystem::path("inline-a.wrl"));
+        remove(boost::filesystem::path("inline-b.wrl"));
+    } BOOST_SCOPE_EXIT_END
+
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    stringstream vrmlstream("Inline { url \"inline-a.wrl\" }\n"
+                            "Inline { url \"inline-b.wrl\" }");
+    vector<boost::intrusive_ptr<node> > nodes =
+        b.create_vrml_from_stream(vrmlstream);
+    BOOST_REQUIRE(nodes.size() == 2);
+    grouping_node * const a = node_cast<grouping_node *>(nodes[0].get());
+    grouping_node * const b_inline =
+        node_cast<grouping_node *>(nodes[1].get());
+    BOOST_REQUIRE(a);
+    BOOST_REQUIRE(b_inline);
+
+    //
+    // Initializing the world starts the loads; but nothing is attached
+    // until the browser is updated.
+    //
+    b.replace_world(nodes);
+    BOOST_CHECK(a->children().empty());
+    BOOST_CHECK(b_inline->children().empty());
+
+    grouping_node * nested = 0;
+    for (size_t i = 0; i < 1000; ++i) {
+        b.update();
+        const vector<boost::intrusive_ptr<node> > a_children =
+            a->children();
+        if (a_children.size() == 2) {
+            nested = node_cast<grouping_node *>(a_children[1].get());
+            if (nested && nested->children().size() == 1
+                && b_inline->children().size() == 1) {
+                break;
+            }
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    BOOST_REQUIRE(nested);
+    BOOST_CHECK_EQUAL(nested->children().size(), 1U);
+    BOOST_CHECK_EQUAL(b_inline->children().size(), 1U);
+}
+
+namespace {
+
+    const char snapshot_world[] =
+        "#VRML V2.0 utf8\n"
+        "PROTO Mover [ eventIn SFFloat set_fraction\n"
+        "              eventOut SFVec3f value_changed\n"
+        "              field MFVec3f keyValue [ 0 0 0, 1 1 1 ] ] {\n"
+        "  PositionInterpolator { key [ 0, 1 ] keyValue IS keyValue\n"
+        "                         set_fraction IS set_fraction\n"
+        "                         value_changed IS value_changed }\n"
+        "}\n"
+        "DEF T TimeSensor { startTime 1 cycleInterval 10 loop TRUE }\n"
+        "DEF P Mover { keyValue [ 0 0 0, 4 4 4 ] }\n"
+        "DEF X Transform {\n"
+        "  children Shape {\n"
+        "    geometry IndexedFaceSet {\n"
+        "      coord Coordinate { point [ 0 0 0, 1 0 0, 0 1 0 ] }\n"
+        "      coordIndex [ 0 1 2 -1 ]\n"
+        "    }\n"
+        "  }\n"
+        "}\n"
+        "Group { children USE X }\n"
+        "ROUTE T.fraction_changed TO P.set_fraction\n"
+        "ROUTE P.value_changed TO X.set_translation\n";
+
+    void load_world(browser & b, resource_fetcher & fetcher,
+                    const string & path)
+    {
+        const string uri =
+            "file://" + (boost::filesystem::current_path() / path).string();
+        const std::auto_ptr<resource_istream> in = fetcher.get_resource(uri);
+        BOOST_REQUIRE(*in);
+        b.set_world(*in);
+    }
+
+    //
+    // Check the world loaded from snapshot_world, including that the PROTO
+    // instance and the ROUTEs work.
+    //
+    void check_snapshot_world(browser & b, const float translation)
+    {
+        const vector<boost::intrusive_ptr<node> > nodes =
+            b.root_scene()->nodes();
+        BOOST_REQUIRE_EQUAL(nodes.size(), 4U);
+        BOOST_CHECK_EQUAL(nodes[1]->type().id(), "Mover");
+        BOOST_CHECK_EQUAL(nodes[2]->id(), "X");
+        const vector<boost::intrusive_ptr<node> > group_children =
+            nodes[3]->field<mfnode>("children").value();
+        BOOST_REQUIRE_EQUAL(group_children.size(), 1U);
+        BOOST_CHECK(group_children[0] == nodes[2]);
+
+        const boost::intrusive_ptr<node> shape =
+            nodes[2]->field<mfnode>("children").value().at(0);
+        const boost::intrusive_ptr<node> geometry =
+            shape->field<sfnode>("geometry").value();
+        BOOST_REQUIRE(geometry);
+        BOOST_CHECK_EQUAL(geometry->field<mfint32>("coordIndex").value()
+                          .size(), 4U);
+        const boost::intrusive_ptr<node> coord =
+            geometry->field<sfnode>("coord").value();
+        BOOST_REQUIRE(coord);
+        const vector<vec3f> point = coord->field<mfvec3f>("point").value();
+        BOOST_REQUIRE_EQUAL(point.size(), 3U);
+        BOOST_CHECK(point[2] == make_vec3f(0, 1, 0));
+
+        //
+        // set_world initializes the world at the current time; so update
+        // it at times after that.  The TimeSensor's cycles begin at
+        // multiples of 10 seconds (plus its startTime).
+        //
+        const double cycle_start = 4.0e9 + 1.0;
+        translation_listener listener;
+        nodes[2]->event_emitter<sfvec3f>("translation_changed").add(listener);
+        b.update(cycle_start);
+        b.update(cycle_start + 5.0);
+        BOOST_CHECK(listener.events() > 0);
+        BOOST_CHECK_CLOSE(listener.last().x(), translation, 0.0001f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(scene_cache_directory)
+{
+    using boost::filesystem::directory_iterator;
+    using boost::filesystem::file_size;
+    using boost::filesystem::last_write_time;
+    using boost::filesystem::path;
+    using boost::filesystem::resize_file;
+
+    {
+        ofstream file("snapshot.wrl");
+        file << snapshot_world;
+    }
+    BOOST_SCOPE_EXIT() {
+        remove(boost::filesystem::path("snapshot.wrl"));
+        remove_all(boost::filesystem::path("scene-cache"));
+    } BOOST_SCOPE_EXIT_END
+
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    BOOST_CHECK(b.scene_cache_directory().empty());
+    b.scene_cache_directory("scene-cache");
+    BOOST_CHECK_EQUAL(b.scene_cache_directory(), "scene-cache");
+
+    //
+    // The first load writes a snapshot.
+    //
+    load_world(b, fetcher, "snapshot.wrl");
+    check_snapshot_world(b, 2.0f);
+    BOOST_REQUIRE(exists(path("scene-cache")));
+    directory_iterator entry = directory_iterator(path("scene-cache"));
+    BOOST_REQUIRE(entry != directory_iterator());
+    const path snapshot = entry->path();
+    BOOST_CHECK(++entry == directory_iterator());
+
+    //
+    // A current snapshot is used and is not rewritten.
+    //
+    last_write_time(snapshot, 0);
+    load_world(b, fetcher, "snapshot.wrl");
+    check_snapshot_world(b, 2.0f);
+    BOOST_CHECK_EQUAL(last_write_time(snapshot), 0);
+
+    //
+    // A damaged snapshot is ignored and replaced.
+    //
+    const boost::uintmax_t snapshot_size = file_size(snapshot);
+    resize_file(snapshot, snapshot_size / 2);
+    load_world(b, fetcher, "snapshot.wrl");
+    check_snapshot_world(b, 2.0f);
+    BOOST_CHECK_EQUAL(file_size(snapshot), snapshot_size);
+
+    //
+    // Changing the source invalidates the snapshot.
+    //
+    {
+        ofstream file("snapshot.wrl");
+        string world = snapshot_world;
+        const string::size_type pos = world.find("4 4 4");
+        world.replace(pos, 5, "8 8 8");
+        file << world;
+    }
+    last_write_time(snapshot, 0);
+    load_world(b, fetcher, "snapshot.wrl");
+    check_snapshot_world(b, 4.0f);
+    BOOST_CHECK(last_write_time(snapshot) != 0);
+}
@@ -0,0 +1,200 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE compiled_mesh
+
+# include <boost/test/unit_test.hpp>
+# include <openvrml/compiled_mesh.h>
+# include <openvrml/viewer.h>
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    const vector<vec3f> cube_coord()
+    {
+        vector<vec3f> coord;
+        for (int i = 0; i < 8; ++i) {
+            coord.push_back(make_vec3f(float(i & 1),
+                                       float((i >> 1) & 1),
+                                       float((i >> 2) & 1)));
+        }
+        return coord;
+    }
+
+    const vector<int32> cube_coord_index()
+    {
+        static const int32 index[] = {
+            0, 2, 3, 1, -1,
+            4, 5, 7, 6, -1,
+            0, 1, 5, 4, -1,
+            2, 6, 7, 3, -1,
+            0, 4, 6, 2, -1,
+            1, 3, 7, 5, -1
+        };
+        return vector<int32>(index, index + sizeof index / sizeof index[0]);
+    }
+
+    //
+    // Twice the signed area of the triangles in the xy-plane.
+    //
+    float area(const compiled_mesh & mesh)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < mesh.index().size(); i += 3) {
+            const vec3f & a = mesh.coord()[mesh.index()[i]];
+            const vec3f & b = mesh.coord()[mesh.index()[i + 1]];
+            const vec3f & c = mesh.coord()[mesh.index()[i + 2]];
+            sum += (b.x() - a.x()) * (c.y() - a.y())
+                - (b.y() - a.y()) * (c.x() - a.x());
+        }
+        return sum;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(convex_quad)
+{
+    vector<vec3f> coord;
+    coord.push_back(make_vec3f(0, 0, 0));
+    coord.push_back(make_vec3f(1, 0, 0));
+    coord.push_back(make_vec3f(1, 1, 0));
+    coord.push_back(make_vec3f(0, 1, 0));
+    static const int32 index[] = { 0, 1, 2, 3, -1 };
+    const compiled_mesh mesh(viewer::mask_ccw | viewer::mask_convex,
+                             coord, vector<int32>(index, index + 5),
+                             vector<color>(), vector<int32>(),
+                             vector<vec3f>(), vector<int32>(),
+                             vector<vec2f>(), vector<int32>());
+    BOOST_REQUIRE_EQUAL(mesh.coord().size(), 4U);
+    BOOST_REQUIRE_EQUAL(mesh.index().size(), 6U);
+    BOOST_CHECK(mesh.color().empty());
+    BOOST_CHECK_EQUAL(mesh.normal()[0], make_vec3f(0, 0, 1));
+    BOOST_CHECK_EQUAL(mesh.tex_coord()[2], make_vec2f(1, 1));
+    BOOST_CHECK_CLOSE(area(mesh), 2.0f, 0.0001f);
+}
+
+BOOST_AUTO_TEST_CASE(nonconvex_face)
+{
+    //
+    // An L-shaped face; a fan from its first corner would cover the notch.
+    //
+    vector<vec3f> coord;
+    coord.push_back(make_vec3f(0, 0, 0));
+    coord.push_back(make_vec3f(2, 0, 0));
+    coord.push_back(make_vec3f(2, 1, 0));
+    coord.push_back(make_vec3f(1, 1, 0));
+    coord.push_back(make_vec3f(1, 2, 0));
+    coord.push_back(make_vec3f(0, 2, 0));
+    static const int32 index[] = { 3, 4, 5, 0, 1, 2, -1 };
+    const compiled_mesh mesh(viewer::mask_ccw,
+                             coord, vector<int32>(index, index + 7),
+                             vector<color>(), vector<int32>(),
+                             vector<vec3f>(), vector<int32>(),
+                             vector<vec2f>(), vector<int32>());
+    BOOST_REQUIRE_EQUAL(mesh.index().size(), 12U);
+    for (size_t i = 0; i < mesh.index().size(); i += 3) {
+        const vec3f & a = mesh.coord()[mesh.index()[i]];
+        const vec3f & b = mesh.coord()[mesh.index()[i + 1]];
+        const vec3f & c = mesh.coord()[mesh.index()[i + 2]];
+        BOOST_CHECK((b.x() - a.x()) * (c.y() - a.y())
+                    - (b.y() - a.y()) * (c.x() - a.x()) > 0.0f);
+    }
+    BOOST_CHECK_CLOSE(area(mesh), 6.0f, 0.0001f);
+}
+
+BOOST_AUTO_TEST_CASE(crease_angle)
+{
+    const vector<vec3f> coord = cube_coord();
+    const vector<int32> coord_index = cube_coord_index();
+
+    const compiled_mesh faceted(viewer::mask_ccw | viewer::mask_solid,
+                                coord, coord_index,
+                                vector<color>(), vector<int32>(),
+                                vector<vec3f>(), vector<int32>(),
+                                vector<vec2f>(), vector<int32>(),
+                                0.5f);
+    BOOST_CHECK_EQUAL(faceted.index().size(), 36U);
+    BOOST_CHECK_EQUAL(faceted.coord().size(), 24U);
+
+    const compiled_mesh smooth(viewer::mask_ccw | viewer::mask_solid,
+                               coord, coord_index,
+                               vector<color>(), vector<int32>(),
+                               vector<vec3f>(), vector<int32>(),
+                               vector<vec2f>(), vector<int32>(),
+                               3.14f);
+    BOOST_CHECK_EQUAL(smooth.index().size(), 36U);
+    BOOST_REQUIRE_EQUAL(smooth.coord().size(), 8U);
+    for (size_t i = 0; i < smooth.coord().size(); ++i) {
+        const vec3f expected =
+            (smooth.coord()[i] - make_vec3f(0.5f, 0.5f, 0.5f)).normalize();
+        BOOST_CHECK_EQUAL(smooth.normal()[i], expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(color_per_face)
+{
+    const vector<vec3f> coord = cube_coord();
+    const vector<int32> coord_index = cube_coord_index();
+    vector<color> colors;
+    colors.push_back(make_color(1, 0, 0));
+    colors.push_back(make_color(0, 1, 0));
+    static const int32 color_index[] = { 0, 0, 0, 1, 1, 1 };
+
+    const compiled_mesh mesh(viewer::mask_ccw | viewer::mask_convex,
+                             coord, coord_index,
+                             colors, vector<int32>(color_index,
+                                                   color_index + 6),
+                             vector<vec3f>(), vector<int32>(),
+                             vector<vec2f>(), vector<int32>(),
+                             3.14f);
+    BOOST_REQUIRE_EQUAL(mesh.color().size(), mesh.coord().size());
+    for (size_t i = 0; i < mesh.index().size(); ++i) {
+        const size_t face = i / 6;
+        BOOST_CHECK_EQUAL(mesh.color()[mesh.index()[i]],
+                          colors[color_index[face]]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(default_extrusion)
+{
+    //
+    // The default Extrusion is a unit cube.
+    //
+    vector<vec3f> spine;
+    spine.push_back(make_vec3f(0, 0, 0));
+    spine.push_back(make_vec3f(0, 1, 0));
+    vector<vec2f> cross_section;
+    cross_section.push_back(make_vec2f(1, 1));
+    cross_section.push_back(make_vec2f(1, -1));
+    cross_section.push_back(make_vec2f(-1, -1));
+    cross_section.push_back(make_vec2f(-1, 1));
+    cross_section.push_back(make_vec2f(1, 1));
+    const compiled_mesh mesh =
+        make_extrusion_mesh(viewer::mask_ccw | viewer::mask_convex
+                            | viewer::mask_solid | viewer::mask_bottom
+                            | viewer::mask_top,
+                            spine, cross_section,
+                            vector<rotation>(1, make_rotation()),
+                            vector<vec2f>(1, make_vec2f(1, 1)));
+    BOOST_CHECK_EQUAL(mesh.index().size(), 36U);
+    for (size_t i = 0; i < mesh.coord().size(); ++i) {
+        BOOST_CHECK_CLOSE(mesh.normal()[i].length(), 1.0f, 0.001f);
+    }
+}
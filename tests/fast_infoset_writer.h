@@ -0,0 +1,321 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# ifndef OPENVRML_TEST_FAST_INFOSET_WRITER_H
+#   define OPENVRML_TEST_FAST_INFOSET_WRITER_H
+
+#   include <cassert>
+#   include <cmath>
+#   include <cstring>
+#   include <map>
+#   include <stdexcept>
+#   include <string>
+#   include <vector>
+#   include <boost/cstdint.hpp>
+#   include <zlib.h>
+
+//
+// A minimal Fast Infoset serializer for producing X3D compressed binary
+// encoding test input.  Names are written literally the first time they are
+// used and by vocabulary table index thereafter; numeric attribute values
+// may be written with the built-in int and float algorithms or with the
+// delta-coded integer and quantized float algorithms read by
+// openvrml::local::fast_infoset_reader.
+//
+class fast_infoset_writer {
+    std::string out_;
+    std::map<std::string, std::size_t> element_names_;
+    std::map<std::string, std::size_t> attribute_names_;
+    bool termination_pending_;
+    bool start_pending_;
+    std::string element_;
+    std::string attributes_;
+
+public:
+    enum { delta_int_algorithm = 32, quantized_float_algorithm = 33 };
+
+    fast_infoset_writer():
+        termination_pending_(false),
+        start_pending_(false)
+    {
+        static const unsigned char header[] = {
+            0xE0, 0x00, 0x00, 0x01, 0x00
+        };
+        this->out_.assign(header, header + sizeof header);
+    }
+
+    void start_element(const std::string & name)
+    {
+        this->flush();
+        this->element_ = name;
+        this->attributes_.clear();
+        this->start_pending_ = true;
+    }
+
+    void end_element()
+    {
+        this->write_start();
+        this->terminate();
+    }
+
+    void attribute(const std::string & name, const std::string & value)
+    {
+        this->attribute_name(name);
+        if (value.empty()) {
+            this->attributes_ += char(0x80);
+            return;
+        }
+        const std::size_t n = value.size();
+        if (n <= 8) {
+            this->attributes_ += char(n - 1);
+        } else if (n <= 264) {
+            this->attributes_ += char(0x08);
+            this->attributes_ += char(n - 9);
+        } else {
+            this->attributes_ += char(0x0C);
+            put_uint32(this->attributes_, boost::uint32_t(n - 265));
+        }
+        this->attributes_ += value;
+    }
+
+    void int_attribute(const std::string & name,
+                       const std::vector<boost::int32_t> & values)
+    {
+        std::string data;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            put_uint32(data, boost::uint32_t(values[i]));
+        }
+        this->algorithm_attribute(name, 4, data);
+    }
+
+    void float_attribute(const std::string & name,
+                         const std::vector<float> & values)
+    {
+        std::string data;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            boost::uint32_t bits;
+            std::memcpy(&bits, &values[i], sizeof bits);
+            put_uint32(data, bits);
+        }
+        this->algorithm_attribute(name, 7, data);
+    }
+
+    void delta_int_attribute(const std::string & name,
+                             const std::vector<boost::int32_t> & values)
+    {
+        std::string varints;
+        boost::uint32_t previous = 0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            const boost::int32_t delta =
+                boost::int32_t(boost::uint32_t(values[i]) - previous);
+            previous = boost::uint32_t(values[i]);
+            boost::uint32_t zigzag =
+                (boost::uint32_t(delta) << 1) ^ boost::uint32_t(delta >> 31);
+            do {
+                unsigned char octet = zigzag & 0x7F;
+                zigzag >>= 7;
+                if (zigzag) { octet |= 0x80; }
+                varints += char(octet);
+            } while (zigzag);
+        }
+        std::string data;
+        put_uint32(data, boost::uint32_t(values.size()));
+        data += deflate(varints);
+        this->algorithm_attribute(name, delta_int_algorithm, data);
+    }
+
+    void quantized_float_attribute(const std::string & name,
+                                   const std::vector<float> & values,
+                                   const unsigned components,
+                                   const unsigned bits)
+    {
+        assert(components >= 1 && components <= 4);
+        assert(bits >= 1 && bits <= 32);
+        assert(values.size() % components == 0);
+        std::vector<float> min(components), max(components);
+        for (unsigned c = 0; c < components; ++c) {
+            min[c] = max[c] = values.empty() ? 0.0f : values[c];
+        }
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            const unsigned c = unsigned(i % components);
+            if (values[i] < min[c]) { min[c] = values[i]; }
+            if (values[i] > max[c]) { max[c] = values[i]; }
+        }
+
+        std::string data;
+        data += char(bits);
+        data += char(components);
+        put_uint32(data, boost::uint32_t(values.size()));
+        for (unsigned c = 0; c < components; ++c) {
+            put_float(data, min[c]);
+            put_float(data, max[c]);
+        }
+
+        const double steps = double((boost::uint64_t(1) << bits) - 1);
+        std::string packed((values.size() * bits + 7) / 8, '\0');
+        boost::uint64_t bit = 0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            const unsigned c = unsigned(i % components);
+            const double range = max[c] - min[c];
+            const boost::uint32_t q = (range > 0.0)
+                ? boost::uint32_t(std::floor((values[i] - min[c]) / range
+                                             * steps + 0.5))
+                : 0;
+            for (unsigned b = bits; b > 0; --b, ++bit) {
+                if ((q >> (b - 1)) & 1) {
+                    packed[std::size_t(bit / 8)] |= char(0x80 >> (bit % 8));
+                }
+            }
+        }
+        data += deflate(packed);
+        this->algorithm_attribute(name, quantized_float_algorithm, data);
+    }
+
+    const std::string & finish()
+    {
+        this->write_start();
+        this->terminate();
+        this->flush();
+        return this->out_;
+    }
+
+private:
+    static void put_uint32(std::string & out, const boost::uint32_t value)
+    {
+        out += char(value >> 24);
+        out += char(value >> 16);
+        out += char(value >> 8);
+        out += char(value);
+    }
+
+    static void put_float(std::string & out, const float value)
+    {
+        boost::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        put_uint32(out, bits);
+    }
+
+    static const std::string deflate(const std::string & data)
+    {
+        if (data.empty()) { return std::string(); }
+        uLongf size = compressBound(uLong(data.size()));
+        std::vector<Bytef> buffer(size);
+        if (compress(&buffer[0], &size,
+                     reinterpret_cast<const Bytef *>(data.data()),
+                     uLong(data.size())) != Z_OK) {
+            throw std::runtime_error("compress failed");
+        }
+        return std::string(buffer.begin(), buffer.begin() + size);
+    }
+
+    static void put_identifying_string(std::string & out,
+                                       const std::string & str)
+    {
+        assert(!str.empty() && str.size() <= 64);
+        out += char(str.size() - 1);
+        out += str;
+    }
+
+    void attribute_name(const std::string & name)
+    {
+        const std::map<std::string, std::size_t>::const_iterator pos =
+            this->attribute_names_.find(name);
+        if (pos == this->attribute_names_.end()) {
+            this->attributes_ += char(0x78);
+            put_identifying_string(this->attributes_, name);
+            const std::size_t index = this->attribute_names_.size() + 1;
+            this->attribute_names_[name] = index;
+        } else if (pos->second <= 64) {
+            this->attributes_ += char(pos->second - 1);
+        } else {
+            assert(pos->second <= 8256);
+            const std::size_t i = pos->second - 65;
+            this->attributes_ += char(0x40 | (i >> 8));
+            this->attributes_ += char(i);
+        }
+    }
+
+    void algorithm_attribute(const std::string & name,
+                             const unsigned algorithm,
+                             const std::string & data)
+    {
+        assert(!data.empty());
+        this->attribute_name(name);
+        const unsigned index = algorithm - 1;
+        this->attributes_ += char(0x30 | (index >> 4));
+        const std::size_t n = data.size();
+        if (n <= 8) {
+            this->attributes_ += char(((index & 0x0F) << 4) | (n - 1));
+        } else if (n <= 264) {
+            this->attributes_ += char(((index & 0x0F) << 4) | 0x08);
+            this->attributes_ += char(n - 9);
+        } else {
+            this->attributes_ += char(((index & 0x0F) << 4) | 0x0C);
+            put_uint32(this->attributes_, boost::uint32_t(n - 265));
+        }
+        this->attributes_ += data;
+    }
+
+    void write_start()
+    {
+        if (!this->start_pending_) { return; }
+        this->start_pending_ = false;
+        const bool has_attributes = !this->attributes_.empty();
+        const unsigned char a = has_attributes ? 0x40 : 0x00;
+        const std::map<std::string, std::size_t>::const_iterator pos =
+            this->element_names_.find(this->element_);
+        if (pos == this->element_names_.end()) {
+            this->out_ += char(a | 0x3C);
+            put_identifying_string(this->out_, this->element_);
+            const std::size_t index = this->element_names_.size() + 1;
+            this->element_names_[this->element_] = index;
+        } else if (pos->second <= 32) {
+            this->out_ += char(a | (pos->second - 1));
+        } else {
+            assert(pos->second <= 2080);
+            const std::size_t i = pos->second - 33;
+            this->out_ += char(a | 0x20 | (i >> 8));
+            this->out_ += char(i);
+        }
+        if (has_attributes) {
+            this->out_ += this->attributes_;
+            this->terminate();
+        }
+    }
+
+    void terminate()
+    {
+        if (this->termination_pending_) {
+            this->out_ += char(0xFF);
+            this->termination_pending_ = false;
+        } else {
+            this->termination_pending_ = true;
+        }
+    }
+
+    void flush()
+    {
+        this->write_start();
+        if (this->termination_pending_) {
+            this->out_ += char(0xF0);
+            this->termination_pending_ = false;
+        }
+    }
+};
+
+# endif // ifndef OPENVRML_TEST_FAST_INFOSET_WRITER_H
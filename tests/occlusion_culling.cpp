@@ -0,0 +1,246 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE occlusion_culling
+
+# include <iostream>
+# include <sstream>
+# include <boost/test/unit_test.hpp>
+# include <openvrml/browser.h>
+# include <openvrml/viewer.h>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    //
+    // A viewer that draws nothing; it counts the boxes inserted.
+    //
+    class counting_viewer : public viewer {
+    public:
+        size_t boxes;
+
+        counting_viewer(): boxes(0) {}
+
+    private:
+        virtual rendering_mode do_mode() { return draw_mode; }
+        virtual double do_frame_rate() { return 0.0; }
+        virtual void do_reset_user_navigation() {}
+        virtual void do_begin_object(const char *, bool) {}
+        virtual void do_end_object() {}
+        virtual void do_insert_background(const background_node &) {}
+
+        virtual void do_insert_box(const geometry_node &, const vec3f &)
+        {
+            ++this->boxes;
+        }
+
+        virtual void do_insert_cone(const geometry_node &,
+                                    float, float, bool, bool)
+        {}
+        virtual void do_insert_cylinder(const geometry_node &,
+                                        float, float, bool, bool, bool)
+        {}
+        virtual void do_insert_elevation_grid(const geometry_node &,
+                                              unsigned int,
+                                              const std::vector<float> &,
+                                              int32, int32, float, float,
+                                              const std::vector<color> &,
+                                              const std::vector<vec3f> &,
+                                              const std::vector<vec2f> &)
+        {}
+        virtual void do_insert_extrusion(const geometry_node &,
+                                         unsigned int,
+                                         const std::vector<vec3f> &,
+                                         const std::vector<vec2f> &,
+                                         const std::vector<rotation> &,
+                                         const std::vector<vec2f> &)
+        {}
+        virtual void do_insert_line_set(const geometry_node &,
+                                        const std::vector<vec3f> &,
+                                        const std::vector<int32> &,
+                                        bool,
+                                        const std::vector<color> &,
+                                        const std::vector<int32> &)
+        {}
+        virtual void do_insert_point_set(const geometry_node &,
+                                         const std::vector<vec3f> &,
+                                         const std::vector<color> &)
+        {}
+        virtual void do_insert_shell(const geometry_node &,
+                                     unsigned int,
+                                     const std::vector<vec3f> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<color> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<vec3f> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<vec2f> &,
+                                     const std::vector<int32> &)
+        {}
+        virtual void do_insert_sphere(const geometry_node &, float) {}
+        virtual void do_insert_dir_light(float, float, const color &,
+                                         const vec3f &)
+        {}
+        virtual void do_insert_point_light(float, const vec3f &,
+                                           const color &, float,
+                                           const vec3f &, float)
+        {}
+        virtual void do_insert_spot_light(float, const vec3f &, float,
+                                          const color &, float,
+                                          const vec3f &, float,
+                                          const vec3f &, float)
+        {}
+        virtual void do_remove_object(const node &) {}
+        virtual void do_enable_lighting(bool) {}
+        virtual void do_set_fog(const color &, float, const char *) {}
+        virtual void do_set_color(const color &, float) {}
+        virtual void do_set_material(float, const color &, const color &,
+                                     float, const color &, float)
+        {}
+        virtual void do_set_material_mode(size_t, bool) {}
+        virtual void do_set_sensitive(node *) {}
+        virtual void do_insert_texture(const texture_node &, bool) {}
+        virtual void do_remove_texture_object(const texture_node &) {}
+        virtual void do_set_texture_transform(const vec2f &, float,
+                                              const vec2f &, const vec2f &)
+        {}
+
+        virtual void do_set_frustum(const float field_of_view,
+                                    const float avatar_size,
+                                    const float visibility_limit)
+        {
+            this->frustum(
+                openvrml::frustum(field_of_view * 180.0f / 3.14159265f,
+                                  1.0f,
+                                  avatar_size > 0.0f ? avatar_size / 2 : 0.01,
+                                  visibility_limit > 0.0f
+                                  ? visibility_limit
+                                  : 30000.0));
+        }
+
+        virtual void do_set_viewpoint(const vec3f &, const rotation &,
+                                      float, float)
+        {}
+        virtual void do_transform(const mat4f &) {}
+        virtual void do_transform_points(size_t, vec3f *) const {}
+        virtual void do_draw_bounding_sphere(const bounding_sphere &,
+                                             bounding_volume::intersection)
+        {}
+    };
+
+    //
+    // A wall filling the view at the origin, seen from the default
+    // viewpoint.  One box is behind the wall but listed before it; ten
+    // more are behind the wall and listed after it; and one is in front of
+    // it.
+    //
+    const string world(const string & wall_material)
+    {
+        ostringstream out;
+        out << "#VRML V2.0 utf8\n"
+            << "Transform { translation -6 0 -10 "
+            << "children Shape { geometry Box {} } }\n"
+            << "Shape {\n"
+            << "  appearance Appearance { material Material { "
+            << wall_material << " } }\n"
+            << "  geometry Box { size 20 20 1 }\n"
+            << "}\n";
+        for (int i = 0; i < 10; ++i) {
+            out << "Transform { translation " << i - 4.5 << " 0 -10 "
+                << "children Transform { translation 0 1 0 "
+                << "children Shape { geometry Box {} } } }\n";
+        }
+        out << "Transform { translation 0 0 5 "
+            << "children Shape { geometry Box {} } }\n";
+        return out.str();
+    }
+
+    struct frame {
+        size_t boxes;
+        browser::render_statistics statistics;
+    };
+
+    const frame render(const string & vrml, const bool occlusion_culling)
+    {
+        test_resource_fetcher fetcher;
+        browser b(fetcher, std::cout, std::cerr);
+        counting_viewer v;
+        b.viewer(&v);
+        b.occlusion_culling(occlusion_culling);
+        stringstream in(vrml);
+        b.replace_world(b.create_vrml_from_stream(in));
+
+        //
+        // The second frame is counted, to check that the buffer is
+        // cleared between frames.
+        //
+        b.render();
+        v.boxes = 0;
+        b.render();
+        frame result = { v.boxes, b.frame_render_statistics() };
+        b.viewer(0);
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hidden_nodes_are_skipped)
+{
+    const frame f = render(world(""), true);
+    BOOST_CHECK_EQUAL(f.boxes, 3U);
+    BOOST_CHECK_EQUAL(f.statistics.occluded, 10U);
+    BOOST_CHECK_EQUAL(f.statistics.tested, 12U);
+    BOOST_CHECK_EQUAL(f.statistics.occluders, 3U);
+}
+
+BOOST_AUTO_TEST_CASE(disabled_by_default)
+{
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    BOOST_CHECK(!b.occlusion_culling());
+
+    const frame f = render(world(""), false);
+    BOOST_CHECK_EQUAL(f.boxes, 13U);
+    BOOST_CHECK_EQUAL(f.statistics.occluded, 0U);
+    BOOST_CHECK_EQUAL(f.statistics.tested, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(transparent_geometry_does_not_occlude)
+{
+    const frame f = render(world("transparency 0.5"), true);
+    BOOST_CHECK_EQUAL(f.boxes, 13U);
+    BOOST_CHECK_EQUAL(f.statistics.occluded, 0U);
+    BOOST_CHECK_EQUAL(f.statistics.occluders, 12U);
+}
+
+BOOST_AUTO_TEST_CASE(view_volume_culling_is_counted)
+{
+    const frame f =
+        render("#VRML V2.0 utf8\n"
+               "Transform { translation 0 0 20 "
+               "children Shape { geometry Box {} } }\n"
+               "Transform { translation 0 0 0 "
+               "children Shape { geometry Box {} } }\n",
+               true);
+    BOOST_CHECK_EQUAL(f.boxes, 1U);
+    BOOST_CHECK_EQUAL(f.statistics.culled, 1U);
+    BOOST_CHECK_EQUAL(f.statistics.occluded, 0U);
+}
@@ -0,0 +1,223 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE parse_x3db
+
+# include <iostream>
+# include <sstream>
+# include <boost/test/unit_test.hpp>
+# include "fast_infoset_writer.h"
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    //
+    // Nodes belong to the browser's scene; the browser must outlive them.
+    //
+    struct x3db_browser {
+        test_resource_fetcher fetcher;
+        browser b;
+
+        x3db_browser():
+            b(fetcher, std::cout, std::cerr)
+        {}
+
+        const vector<boost::intrusive_ptr<node> >
+        parse(const string & data)
+        {
+            stringstream in(data);
+            return b.create_vrml_from_stream(in,
+                                             x3d_fast_infoset_media_type);
+        }
+    };
+
+    void start_scene(fast_infoset_writer & w, const string & profile)
+    {
+        w.start_element("X3D");
+        w.attribute("profile", profile);
+        w.attribute("version", "3.2");
+        w.start_element("Scene");
+    }
+
+    void end_scene(fast_infoset_writer & w)
+    {
+        w.end_element();
+        w.end_element();
+    }
+
+    const boost::intrusive_ptr<node>
+    sfnode_field(const node & n, const string & id)
+    {
+        const std::auto_ptr<field_value> value = n.field(id);
+        return dynamic_cast<sfnode &>(*value).value();
+    }
+
+    template <typename FieldValue>
+    const typename FieldValue::value_type
+    field(const node & n, const string & id)
+    {
+        const std::auto_ptr<field_value> value = n.field(id);
+        return dynamic_cast<FieldValue &>(*value).value();
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(minimal, x3db_browser)
+{
+    fast_infoset_writer w;
+    start_scene(w, "Core");
+    end_scene(w);
+
+    BOOST_CHECK(parse(w.finish()).empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(encoded_geometry, x3db_browser)
+{
+    static const boost::int32_t index_values[] = {
+        0, 1, 2, -1, 2, 1, 3, -1, 100000, -100000, 3, -1
+    };
+    const vector<boost::int32_t> index(
+        index_values,
+        index_values + sizeof index_values / sizeof index_values[0]);
+
+    static const float point_values[] = {
+        0.0f, 0.0f, 0.0f,
+        1.0f, 0.0f, -2.0f,
+        0.5f, 4.0f, 2.0f,
+        -3.0f, 1.0f, 0.25f
+    };
+    const vector<float> point(
+        point_values,
+        point_values + sizeof point_values / sizeof point_values[0]);
+
+    fast_infoset_writer w;
+    start_scene(w, "Interchange");
+    w.start_element("Shape");
+    w.start_element("IndexedFaceSet");
+    w.delta_int_attribute("coordIndex", index);
+    w.attribute("solid", "false");
+    w.start_element("Coordinate");
+    w.quantized_float_attribute("point", point, 3, 16);
+    w.end_element();
+    w.end_element();
+    w.end_element();
+    w.start_element("Transform");
+    w.float_attribute("translation", vector<float>(3, 2.5f));
+    w.end_element();
+    end_scene(w);
+
+    const vector<boost::intrusive_ptr<node> > nodes = parse(w.finish());
+    BOOST_REQUIRE_EQUAL(nodes.size(), 2U);
+
+    const boost::intrusive_ptr<node> ifs =
+        sfnode_field(*nodes[0], "geometry");
+    BOOST_REQUIRE(ifs);
+    BOOST_CHECK_EQUAL(ifs->type().id(), "IndexedFaceSet");
+    const vector<int32> coord_index = field<mfint32>(*ifs, "coordIndex");
+    BOOST_CHECK_EQUAL_COLLECTIONS(coord_index.begin(), coord_index.end(),
+                                  index.begin(), index.end());
+    BOOST_CHECK(!field<sfbool>(*ifs, "solid"));
+
+    const boost::intrusive_ptr<node> coord = sfnode_field(*ifs, "coord");
+    BOOST_REQUIRE(coord);
+    const vector<vec3f> coords = field<mfvec3f>(*coord, "point");
+    BOOST_REQUIRE_EQUAL(coords.size(), point.size() / 3);
+    for (size_t i = 0; i < coords.size(); ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            BOOST_CHECK_SMALL(coords[i][j] - point[3 * i + j], 1.0e-3f);
+        }
+    }
+
+    BOOST_CHECK_EQUAL(field<sfvec3f>(*nodes[1], "translation"),
+                      make_vec3f(2.5f, 2.5f, 2.5f));
+}
+
+BOOST_FIXTURE_TEST_CASE(def_use_and_route, x3db_browser)
+{
+    fast_infoset_writer w;
+    start_scene(w, "Interactive");
+    w.start_element("TimeSensor");
+    w.attribute("DEF", "Clock");
+    w.attribute("loop", "true");
+    w.end_element();
+    w.start_element("PositionInterpolator");
+    w.attribute("DEF", "Path");
+    w.float_attribute("key", vector<float>(2, 0.0f));
+    w.quantized_float_attribute("keyValue", vector<float>(6, 1.0f), 3, 8);
+    w.end_element();
+    w.start_element("Transform");
+    w.attribute("DEF", "Target");
+    w.end_element();
+    w.start_element("Group");
+    w.start_element("Transform");
+    w.attribute("USE", "Target");
+    w.end_element();
+    w.end_element();
+    w.start_element("ROUTE");
+    w.attribute("fromNode", "Clock");
+    w.attribute("fromField", "fraction_changed");
+    w.attribute("toNode", "Path");
+    w.attribute("toField", "set_fraction");
+    w.end_element();
+    end_scene(w);
+
+    const vector<boost::intrusive_ptr<node> > nodes = parse(w.finish());
+    BOOST_REQUIRE_EQUAL(nodes.size(), 4U);
+    BOOST_CHECK(field<sfbool>(*nodes[0], "loop"));
+    BOOST_CHECK_EQUAL(field<mffloat>(*nodes[1], "key").size(), 2U);
+    BOOST_CHECK_EQUAL(field<mfvec3f>(*nodes[1], "keyValue").size(), 2U);
+
+    const vector<boost::intrusive_ptr<node> > children =
+        field<mfnode>(*nodes[3], "children");
+    BOOST_REQUIRE_EQUAL(children.size(), 1U);
+    BOOST_CHECK(children[0] == nodes[2]);
+}
+
+BOOST_FIXTURE_TEST_CASE(encoded_value_type_mismatch, x3db_browser)
+{
+    fast_infoset_writer w;
+    start_scene(w, "Interchange");
+    w.start_element("Transform");
+    w.int_attribute("translation", vector<boost::int32_t>(3, 1));
+    w.end_element();
+    end_scene(w);
+
+    BOOST_CHECK_THROW(parse(w.finish()), invalid_vrml);
+}
+
+BOOST_FIXTURE_TEST_CASE(truncated_document, x3db_browser)
+{
+    fast_infoset_writer w;
+    start_scene(w, "Interchange");
+    w.start_element("Transform");
+    w.float_attribute("translation", vector<float>(3, 1.0f));
+    w.end_element();
+    end_scene(w);
+    const string data = w.finish();
+
+    BOOST_CHECK_THROW(parse(data.substr(0, data.size() - 8)), invalid_vrml);
+}
+
+BOOST_FIXTURE_TEST_CASE(not_fast_infoset, x3db_browser)
+{
+    BOOST_CHECK_THROW(parse("<X3D profile=\"Core\"><Scene/></X3D>"),
+                      invalid_vrml);
+}
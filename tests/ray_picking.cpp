@@ -0,0 +1,253 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE ray_picking
+
+# include <cmath>
+# include <iostream>
+# include <sstream>
+# include <boost/test/unit_test.hpp>
+# include <openvrml/browser.h>
+# include <openvrml/scene.h>
+# include <openvrml/viewer.h>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    //
+    // A viewer that draws nothing.
+    //
+    class null_viewer : public viewer {
+    private:
+        virtual rendering_mode do_mode() { return draw_mode; }
+        virtual double do_frame_rate() { return 0.0; }
+        virtual void do_reset_user_navigation() {}
+        virtual void do_begin_object(const char *, bool) {}
+        virtual void do_end_object() {}
+        virtual void do_insert_background(const background_node &) {}
+
+        virtual void do_insert_box(const geometry_node &, const vec3f &) {}
+
+        virtual void do_insert_cone(const geometry_node &,
+                                    float, float, bool, bool)
+        {}
+        virtual void do_insert_cylinder(const geometry_node &,
+                                        float, float, bool, bool, bool)
+        {}
+        virtual void do_insert_elevation_grid(const geometry_node &,
+                                              unsigned int,
+                                              const std::vector<float> &,
+                                              int32, int32, float, float,
+                                              const std::vector<color> &,
+                                              const std::vector<vec3f> &,
+                                              const std::vector<vec2f> &)
+        {}
+        virtual void do_insert_extrusion(const geometry_node &,
+                                         unsigned int,
+                                         const std::vector<vec3f> &,
+                                         const std::vector<vec2f> &,
+                                         const std::vector<rotation> &,
+                                         const std::vector<vec2f> &)
+        {}
+        virtual void do_insert_line_set(const geometry_node &,
+                                        const std::vector<vec3f> &,
+                                        const std::vector<int32> &,
+                                        bool,
+                                        const std::vector<color> &,
+                                        const std::vector<int32> &)
+        {}
+        virtual void do_insert_point_set(const geometry_node &,
+                                         const std::vector<vec3f> &,
+                                         const std::vector<color> &)
+        {}
+        virtual void do_insert_shell(const geometry_node &,
+                                     unsigned int,
+                                     const std::vector<vec3f> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<color> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<vec3f> &,
+                                     const std::vector<int32> &,
+                                     const std::vector<vec2f> &,
+                                     const std::vector<int32> &)
+        {}
+        virtual void do_insert_sphere(const geometry_node &, float) {}
+        virtual void do_insert_dir_light(float, float, const color &,
+                                         const vec3f &)
+        {}
+        virtual void do_insert_point_light(float, const vec3f &,
+                                           const color &, float,
+                                           const vec3f &, float)
+        {}
+        virtual void do_insert_spot_light(float, const vec3f &, float,
+                                          const color &, float,
+                                          const vec3f &, float,
+                                          const vec3f &, float)
+        {}
+        virtual void do_remove_object(const node &) {}
+        virtual void do_enable_lighting(bool) {}
+        virtual void do_set_fog(const color &, float, const char *) {}
+        virtual void do_set_color(const color &, float) {}
+        virtual void do_set_material(float, const color &, const color &,
+                                     float, const color &, float)
+        {}
+        virtual void do_set_material_mode(size_t, bool) {}
+        virtual void do_set_sensitive(node *) {}
+        virtual void do_insert_texture(const texture_node &, bool) {}
+        virtual void do_remove_texture_object(const texture_node &) {}
+        virtual void do_set_texture_transform(const vec2f &, float,
+                                              const vec2f &, const vec2f &)
+        {}
+
+        virtual void do_set_frustum(const float field_of_view,
+                                    const float avatar_size,
+                                    const float visibility_limit)
+        {
+            this->frustum(
+                openvrml::frustum(field_of_view * 180.0f / 3.14159265f,
+                                  1.0f,
+                                  avatar_size > 0.0f ? avatar_size / 2 : 0.01,
+                                  visibility_limit > 0.0f
+                                  ? visibility_limit
+                                  : 30000.0));
+        }
+
+        virtual void do_set_viewpoint(const vec3f &, const rotation &,
+                                      float, float)
+        {}
+        virtual void do_transform(const mat4f &) {}
+        virtual void do_transform_points(size_t, vec3f *) const {}
+        virtual void do_draw_bounding_sphere(const bounding_sphere &,
+                                             bounding_volume::intersection)
+        {}
+    };
+
+    //
+    // A sensitive Sphere at the origin, an ordinary Box to its right, and a
+    // scaled Box behind the Sphere to its left; seen from the default
+    // viewpoint.
+    //
+    const char world[] =
+        "#VRML V2.0 utf8\n"
+        "Group { children [ TouchSensor {} Shape { geometry Sphere {} } ] }\n"
+        "Transform { translation 3 0 0 children Shape { geometry Box {} } }\n"
+        "Transform { translation -3 0 -5 scale 1 4 1\n"
+        "  children Shape { geometry Box {} } }\n";
+
+    struct fixture {
+        test_resource_fetcher fetcher;
+        browser b;
+        null_viewer v;
+
+        fixture():
+            b(fetcher, std::cout, std::cerr)
+        {
+            b.viewer(&v);
+            stringstream in(world);
+            b.replace_world(b.create_vrml_from_stream(in));
+        }
+
+        ~fixture()
+        {
+            b.viewer(0);
+        }
+
+        node * group() const
+        {
+            return this->b.root_scene()->nodes().front().get();
+        }
+
+        bool pick(const float x, const float y,
+                  browser::pick_result & result) const
+        {
+            return this->b.pick(make_vec3f(x, y, 10.0f),
+                                make_vec3f(0.0f, 0.0f, -1.0f),
+                                result);
+        }
+    };
+
+    const float tolerance = 1.0e-4f;
+}
+
+BOOST_FIXTURE_TEST_CASE(nothing_is_picked_before_rendering, fixture)
+{
+    browser::pick_result result;
+    BOOST_CHECK(!this->pick(0.0f, 0.0f, result));
+}
+
+BOOST_FIXTURE_TEST_CASE(box_hit_point_normal_and_tex_coord, fixture)
+{
+    b.render();
+    browser::pick_result result;
+    BOOST_REQUIRE(this->pick(3.25f, 0.5f, result));
+    BOOST_CHECK(!result.sensitive);
+    BOOST_CHECK(result.geometry);
+    BOOST_CHECK_CLOSE(result.point.x(), 3.25f, tolerance);
+    BOOST_CHECK_CLOSE(result.point.y(), 0.5f, tolerance);
+    BOOST_CHECK_CLOSE(result.point.z(), 1.0f, tolerance);
+    BOOST_CHECK_SMALL(result.normal.x(), tolerance);
+    BOOST_CHECK_SMALL(result.normal.y(), tolerance);
+    BOOST_CHECK_CLOSE(result.normal.z(), 1.0f, tolerance);
+    BOOST_CHECK_CLOSE(result.tex_coord.x(), 0.625f, tolerance);
+    BOOST_CHECK_CLOSE(result.tex_coord.y(), 0.75f, tolerance);
+    BOOST_CHECK_CLOSE(result.distance, 9.0f, tolerance);
+}
+
+BOOST_FIXTURE_TEST_CASE(sensitive_group_is_reported, fixture)
+{
+    b.render();
+    browser::pick_result result;
+    BOOST_REQUIRE(this->pick(0.0f, 0.0f, result));
+    BOOST_CHECK_EQUAL(result.sensitive, this->group());
+    //
+    // The Sphere is tessellated; its surface is within a few percent of
+    // the unit sphere.
+    //
+    BOOST_CHECK_CLOSE(result.point.z(), 1.0f, 5.0f);
+    BOOST_CHECK_CLOSE(result.normal.z(), 1.0f, 5.0f);
+    BOOST_CHECK_CLOSE(result.tex_coord.x(), 0.5f, 5.0f);
+    BOOST_CHECK_CLOSE(result.tex_coord.y(), 0.5f, 5.0f);
+}
+
+BOOST_FIXTURE_TEST_CASE(transformed_geometry_is_hit, fixture)
+{
+    b.render();
+    browser::pick_result result;
+    BOOST_REQUIRE(this->pick(-3.0f, 1.5f, result));
+    BOOST_CHECK(!result.sensitive);
+    BOOST_CHECK_CLOSE(result.point.y(), 1.5f, tolerance);
+    BOOST_CHECK_CLOSE(result.point.z(), -4.0f, tolerance);
+    BOOST_CHECK_CLOSE(result.normal.z(), 1.0f, tolerance);
+    BOOST_CHECK_CLOSE(result.tex_coord.y(), 0.6875f, tolerance);
+    BOOST_CHECK_CLOSE(result.distance, 14.0f, tolerance);
+}
+
+BOOST_FIXTURE_TEST_CASE(rays_that_miss_find_nothing, fixture)
+{
+    b.render();
+    browser::pick_result result;
+    BOOST_CHECK(!this->pick(10.0f, 10.0f, result));
+    BOOST_CHECK(!this->pick(1.5f, 0.0f, result));
+    BOOST_CHECK(!b.pick(make_vec3f(0.0f, 0.0f, 10.0f),
+                        make_vec3f(0.0f, 0.0f, 1.0f),
+                        result));
+}
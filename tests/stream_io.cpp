@@ -0,0 +1,227 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE stream_io
+
+# include <iostream>
+# include <sstream>
+# include <boost/test/unit_test.hpp>
+# include <boost/thread.hpp>
+# include <openvrml/browser.h>
+# include <openvrml/scene.h>
+# include "test_resource_fetcher.h"
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    class string_resource_istream : public resource_istream {
+        const std::string url_;
+        std::stringbuf buf_;
+
+    public:
+        string_resource_istream(const std::string & url,
+                                const std::string & data):
+            resource_istream(&this->buf_),
+            url_(url),
+            buf_(data, ios_base::in)
+        {}
+
+    private:
+        virtual const std::string do_url() const throw ()
+        {
+            return this->url_;
+        }
+
+        virtual const std::string do_type() const throw ()
+        {
+            return "application/octet-stream";
+        }
+
+        virtual bool do_data_available() const throw ()
+        {
+            return !!(*this);
+        }
+    };
+
+    //
+    // Shared by the listeners of a test.  Listeners wait in
+    // stream_available until the gate is opened.
+    //
+    struct streams {
+        boost::mutex mutex;
+        boost::condition_variable gate_opened;
+        bool open;
+        std::size_t reading;
+        std::size_t max_reading;
+        std::size_t max_chunk;
+
+        streams():
+            open(true),
+            reading(0),
+            max_reading(0),
+            max_chunk(0)
+        {}
+
+        void open_gate()
+        {
+            {
+                boost::lock_guard<boost::mutex> lock(this->mutex);
+                this->open = true;
+            }
+            this->gate_opened.notify_all();
+        }
+    };
+
+    class collecting_listener : public stream_listener {
+        streams & streams_;
+        std::string & data_;
+
+    public:
+        collecting_listener(streams & s, std::string & data):
+            streams_(s),
+            data_(data)
+        {}
+
+        virtual ~collecting_listener() throw ()
+        {
+            boost::lock_guard<boost::mutex> lock(this->streams_.mutex);
+            --this->streams_.reading;
+        }
+
+    private:
+        virtual void do_stream_available(const std::string &,
+                                         const std::string &)
+        {
+            boost::unique_lock<boost::mutex> lock(this->streams_.mutex);
+            this->streams_.max_reading =
+                (std::max)(++this->streams_.reading,
+                           this->streams_.max_reading);
+            while (!this->streams_.open) {
+                this->streams_.gate_opened.wait(lock);
+            }
+        }
+
+        virtual void do_data_available(const std::vector<unsigned char> & data)
+        {
+            this->data_.append(data.begin(), data.end());
+            boost::lock_guard<boost::mutex> lock(this->streams_.mutex);
+            this->streams_.max_chunk =
+                (std::max)(data.size(), this->streams_.max_chunk);
+        }
+    };
+
+    const std::string make_data(const std::size_t size, const char seed)
+    {
+        std::string result(size, '\0');
+        for (std::size_t i = 0; i < size; ++i) {
+            result[i] = char(seed + i % 251);
+        }
+        return result;
+    }
+
+    void read(scene & s, streams & shared, const std::string & url,
+              const std::string & data, std::string & received)
+    {
+        s.read_stream(
+            std::auto_ptr<resource_istream>(
+                new string_resource_istream(url, data)),
+            std::auto_ptr<stream_listener>(
+                new collecting_listener(shared, received)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(streams_are_delivered_in_chunks)
+{
+    streams shared;
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    BOOST_CHECK_EQUAL(b.io_threads(), 8U);
+
+    const std::size_t size = 150000;
+    const std::string data[3] = {
+        make_data(size, 'a'), make_data(size, 'b'), make_data(size, 'c')
+    };
+    std::string received[3];
+    {
+        //
+        // Destroying the scene waits for its streams to be read.
+        //
+        scene s(b);
+        for (std::size_t i = 0; i < 3; ++i) {
+            ostringstream url;
+            url << "urn:stream:" << i;
+            read(s, shared, url.str(), data[i], received[i]);
+        }
+    }
+    for (std::size_t i = 0; i < 3; ++i) {
+        BOOST_CHECK(received[i] == data[i]);
+    }
+    BOOST_CHECK(shared.max_chunk > 0);
+    BOOST_CHECK(shared.max_chunk <= 65536);
+
+    const browser::io_statistics stats = b.stream_io_statistics();
+    BOOST_CHECK_EQUAL(stats.queued, 0U);
+    BOOST_CHECK_EQUAL(stats.active, 0U);
+    BOOST_CHECK_EQUAL(stats.completed, 3U);
+    BOOST_CHECK_EQUAL(stats.bytes, 3 * size);
+    BOOST_REQUIRE_EQUAL(stats.streams.size(), 3U);
+    for (std::size_t i = 0; i < stats.streams.size(); ++i) {
+        BOOST_CHECK(stats.streams[i].complete);
+        BOOST_CHECK_EQUAL(stats.streams[i].bytes, size);
+        BOOST_CHECK(stats.streams[i].chunks >= size / 65536);
+    }
+
+    b.reset_io_statistics();
+    const browser::io_statistics reset = b.stream_io_statistics();
+    BOOST_CHECK_EQUAL(reset.completed, 0U);
+    BOOST_CHECK_EQUAL(reset.bytes, 0U);
+    BOOST_CHECK(reset.streams.empty());
+}
+
+BOOST_AUTO_TEST_CASE(requests_beyond_the_thread_limit_are_queued)
+{
+    streams shared;
+    shared.open = false;
+    test_resource_fetcher fetcher;
+    browser b(fetcher, std::cout, std::cerr);
+    b.io_threads(1);
+    BOOST_CHECK_EQUAL(b.io_threads(), 1U);
+
+    const std::string data = make_data(1000, 'x');
+    std::string received[4];
+    {
+        scene s(b);
+        for (std::size_t i = 0; i < 4; ++i) {
+            read(s, shared, "urn:stream", data, received[i]);
+        }
+        const browser::io_statistics stats = b.stream_io_statistics();
+        BOOST_CHECK_EQUAL(stats.threads, 1U);
+        BOOST_CHECK(stats.queued >= 3);
+        BOOST_CHECK(stats.max_queued >= 3);
+        BOOST_CHECK(stats.active <= 1);
+        shared.open_gate();
+    }
+    BOOST_CHECK_EQUAL(shared.max_reading, 1U);
+    for (std::size_t i = 0; i < 4; ++i) {
+        BOOST_CHECK(received[i] == data);
+    }
+    BOOST_CHECK_EQUAL(b.stream_io_statistics().completed, 4U);
+}
@@ -0,0 +1,123 @@
+// -*- mode: c++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2012  Braden McDaniel
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 3 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this library; if not, see <http://www.gnu.org/licenses/>.
+//
+
+# define BOOST_TEST_MAIN
+# define BOOST_TEST_MODULE tessellation_service
+
+# include <boost/test/unit_test.hpp>
+# include <boost/bind.hpp>
+# include <openvrml/tessellation_service.h>
+
+using namespace std;
+using namespace openvrml;
+
+namespace {
+
+    boost::barrier * const no_gate = 0;
+
+    //
+    // A unit square scaled by size.  If there is a gate, the job meets the
+    // test there once when it starts and again before it finishes.
+    //
+    void square(const float size,
+                boost::barrier * const gate,
+                compiled_mesh & mesh)
+    {
+        if (gate) {
+            gate->wait();
+            gate->wait();
+        }
+        vector<vec3f> corner;
+        corner.push_back(make_vec3f(0, 0, 0));
+        corner.push_back(make_vec3f(size, size, 0));
+        make_bounding_box_mesh(corner).swap(mesh);
+    }
+
+    float size(const compiled_mesh * const mesh)
+    {
+        BOOST_REQUIRE(mesh);
+        float result = 0.0f;
+        for (size_t i = 0; i < mesh->coord().size(); ++i) {
+            result = max(result, mesh->coord()[i].x());
+        }
+        return result;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(histogram_bucket)
+{
+    BOOST_CHECK_EQUAL(tessellation_service::histogram_bucket(0.0), 0U);
+    BOOST_CHECK_EQUAL(tessellation_service::histogram_bucket(0.0005), 0U);
+    BOOST_CHECK_EQUAL(tessellation_service::histogram_bucket(0.0015), 1U);
+    BOOST_CHECK_EQUAL(tessellation_service::histogram_bucket(0.003), 2U);
+    BOOST_CHECK_EQUAL(tessellation_service::histogram_bucket(1000.0),
+                      size_t(tessellation_service::statistics::buckets - 1));
+}
+
+BOOST_AUTO_TEST_CASE(synchronous_compile)
+{
+    tessellation_service service(1);
+    async_mesh mesh;
+    BOOST_CHECK(!mesh.mesh());
+
+    mesh.compile(service, boost::bind(square, 2.0f, no_gate, _1),
+                 service.async_threshold() - 1);
+    BOOST_CHECK_EQUAL(mesh.revision(), 1U);
+    BOOST_CHECK(!mesh.pending());
+    BOOST_CHECK_EQUAL(size(mesh.mesh()), 2.0f);
+    BOOST_CHECK(!mesh.update());
+    BOOST_CHECK_EQUAL(service.latency_statistics().completed, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(asynchronous_compile)
+{
+    tessellation_service service(1);
+    service.async_threshold(0);
+    async_mesh mesh;
+
+    vector<vec3f> corner(1, make_vec3f(0, 0, 0));
+    corner.push_back(make_vec3f(5, 5, 0));
+    boost::barrier gate(2);
+    mesh.compile(service, boost::bind(square, 1.0f, &gate, _1), 1,
+                 make_bounding_box_mesh(corner));
+    BOOST_CHECK(mesh.pending());
+    BOOST_CHECK_EQUAL(size(mesh.mesh()), 5.0f);
+    gate.wait();
+
+    //
+    // The first job is running; the second is superseded by the third
+    // before it can start.
+    //
+    mesh.compile(service, boost::bind(square, 2.0f, no_gate, _1), 1);
+    mesh.compile(service, boost::bind(square, 3.0f, no_gate, _1), 1);
+    BOOST_CHECK_EQUAL(size(mesh.mesh()), 5.0f);
+    gate.wait();
+
+    service.wait();
+    BOOST_CHECK_EQUAL(service.pending(), 0U);
+    BOOST_CHECK(service.take_ready());
+    BOOST_CHECK(mesh.update());
+    BOOST_CHECK(!mesh.pending());
+    BOOST_CHECK_EQUAL(size(mesh.mesh()), 3.0f);
+
+    const tessellation_service::statistics stats =
+        service.latency_statistics();
+    BOOST_CHECK_EQUAL(stats.completed, 2U);
+    BOOST_CHECK_EQUAL(stats.superseded, 1U);
+    BOOST_CHECK_EQUAL(stats.failed, 0U);
+}
@@ -72,7 +72,11 @@ test_resource_fetcher::do_get_resource(const std::string & uri)
             if (iequals(ext, "wrl")) {
                 media_type = "model/vrml";
             } else if (iequals(ext, "x3dv")) {
-                media_type = "model/x3d+vrml";
+                media_type = "model/x3d-vrml";
+            } else if (iequals(ext, "x3d")) {
+                media_type = "model/x3d+xml";
+            } else if (iequals(ext, "x3db")) {
+                media_type = "model/x3d+fastinfoset";
             } else if (iequals(ext, "png")) {
                 media_type = "image/png";
             } else if (iequals(ext, "jpg") || iequals(ext, "jpeg")) {